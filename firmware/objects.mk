@@ -13,12 +13,21 @@ firmware-cflags-y +=
 firmware-asflags-y +=
 firmware-ldflags-y +=
 
+# Pack the relative relocations in the compact RELR format when possible
+ifeq ($(OPENSBI_LD_RELR),y)
+firmware-ldflags-y += -Wl,-z,pack-relative-relocs
+endif
+
 ifdef FW_TEXT_START
 firmware-genflags-y += -DFW_TEXT_START=$(FW_TEXT_START)
 else
 firmware-genflags-y += -DFW_TEXT_START=0x0
 endif
 
+ifdef FW_FDT_OVERLAY_PATH
+firmware-genflags-y += -DFW_FDT_OVERLAY_PATH=\"$(FW_FDT_OVERLAY_PATH)\"
+endif
+
 ifdef FW_FDT_PATH
 firmware-genflags-y += -DFW_FDT_PATH=\"$(FW_FDT_PATH)\"
 ifdef FW_FDT_PADDING
@@ -48,7 +57,13 @@ FW_PAYLOAD_PATH_FINAL=$(FW_PAYLOAD_PATH)
 else
 FW_PAYLOAD_PATH_FINAL=$(platform_build_dir)/firmware/payloads/test.bin
 endif
+ifeq ($(FW_PAYLOAD_COMPRESS),lz4)
+FW_PAYLOAD_PATH_LZ4=$(platform_build_dir)/firmware/payload.lz4
+firmware-genflags-$(FW_PAYLOAD) += -DFW_PAYLOAD_PATH=\"$(FW_PAYLOAD_PATH_LZ4)\"
+firmware-genflags-$(FW_PAYLOAD) += -DFW_PAYLOAD_LZ4
+else
 firmware-genflags-$(FW_PAYLOAD) += -DFW_PAYLOAD_PATH=\"$(FW_PAYLOAD_PATH_FINAL)\"
+endif
 ifdef FW_PAYLOAD_OFFSET
 firmware-genflags-$(FW_PAYLOAD) += -DFW_PAYLOAD_OFFSET=$(FW_PAYLOAD_OFFSET)
 endif
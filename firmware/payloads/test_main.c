@@ -7,9 +7,16 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_barrier.h>
 #include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_string.h>
 
+#define BENCH_ITERATIONS		256
+#define BENCH_DBCN_ITERATIONS		8
+#define BENCH_MAX_HARTS			128
+#define BENCH_STACK_SIZE		0x2000
+
 struct sbiret {
 	unsigned long error;
 	unsigned long value;
@@ -46,15 +53,312 @@ static inline void sbi_ecall_console_puts(const char *str)
 		  sbi_strlen(str), (unsigned long)str, 0, 0, 0, 0);
 }
 
+static void print_ulong(unsigned long val)
+{
+	char buf[sizeof(unsigned long) * 3 + 1];
+	int pos = sizeof(buf) - 1;
+
+	buf[pos] = '\0';
+	do {
+		buf[--pos] = '0' + val % 10;
+		val /= 10;
+	} while (val);
+
+	sbi_ecall_console_puts(&buf[pos]);
+}
+
 #define wfi()                                             \
 	do {                                              \
 		__asm__ __volatile__("wfi" ::: "memory"); \
 	} while (0)
 
+extern char _start_secondary[];
+extern char test_sse_handler[];
+
+static char bench_dbcn_buf[256];
+static char bench_secondary_stack[BENCH_STACK_SIZE] __aligned(16);
+static volatile unsigned long bench_secondary_done;
+
+struct bench_state {
+	unsigned long hartid;
+	unsigned long pmu_ctr;
+	unsigned long size;
+};
+
+struct bench {
+	const char *name;
+	unsigned long iterations;
+	/* Optional, a non-zero SBI error skips the benchmark */
+	long (*setup)(struct bench_state *s);
+	long (*run)(struct bench_state *s);
+	void (*cleanup)(struct bench_state *s);
+};
+
+static long bench_probe(struct bench_state *s)
+{
+	return sbi_ecall(SBI_EXT_BASE, SBI_EXT_BASE_PROBE_EXT,
+			 SBI_EXT_TIME, 0, 0, 0, 0, 0).error;
+}
+
+static long bench_set_timer(struct bench_state *s)
+{
+	return sbi_ecall(SBI_EXT_TIME, SBI_EXT_TIME_SET_TIMER,
+			 -1UL, -1UL, 0, 0, 0, 0).error;
+}
+
+static long bench_ipi_self(struct bench_state *s)
+{
+	long err = sbi_ecall(SBI_EXT_IPI, SBI_EXT_IPI_SEND_IPI,
+			     1, s->hartid, 0, 0, 0, 0).error;
+
+	csr_clear(CSR_SIP, SIP_SSIP);
+	return err;
+}
+
+static long bench_rfence_all(struct bench_state *s)
+{
+	return sbi_ecall(SBI_EXT_RFENCE, SBI_EXT_RFENCE_REMOTE_FENCE_I,
+			 0, -1UL, 0, 0, 0, 0).error;
+}
+
+static long bench_dbcn_write(struct bench_state *s)
+{
+	return sbi_ecall(SBI_EXT_DBCN, SBI_EXT_DBCN_CONSOLE_WRITE,
+			 s->size, (unsigned long)&bench_dbcn_buf[
+				sizeof(bench_dbcn_buf) - s->size],
+			 0, 0, 0, 0).error;
+}
+
+static long bench_suspend_setup(struct bench_state *s)
+{
+	/* A pending and enabled SSIP wakes the retentive suspend up */
+	csr_set(CSR_SIE, SIP_SSIP);
+	return SBI_SUCCESS;
+}
+
+static long bench_suspend(struct bench_state *s)
+{
+	long err;
+
+	csr_set(CSR_SIP, SIP_SSIP);
+	err = sbi_ecall(SBI_EXT_HSM, SBI_EXT_HSM_HART_SUSPEND,
+			SBI_HSM_SUSPEND_RET_DEFAULT, 0, 0, 0, 0, 0).error;
+	csr_clear(CSR_SIP, SIP_SSIP);
+
+	return err;
+}
+
+static void bench_suspend_cleanup(struct bench_state *s)
+{
+	csr_clear(CSR_SIE, SIP_SSIP);
+}
+
+static long bench_pmu_setup(struct bench_state *s)
+{
+	struct sbiret ret;
+
+	ret = sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_CFG_MATCH, 0, -1UL,
+			SBI_PMU_CFG_FLAG_CLEAR_VALUE |
+			SBI_PMU_CFG_FLAG_AUTO_START,
+			(SBI_PMU_EVENT_TYPE_FW << 16) | SBI_PMU_FW_SET_TIMER,
+			0, 0);
+	s->pmu_ctr = ret.value;
+
+	return ret.error;
+}
+
+static long bench_pmu_fw_read(struct bench_state *s)
+{
+	return sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_FW_READ,
+			 s->pmu_ctr, 0, 0, 0, 0, 0).error;
+}
+
+static void bench_pmu_cleanup(struct bench_state *s)
+{
+	sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_STOP, s->pmu_ctr, 1,
+		  SBI_PMU_STOP_FLAG_RESET, 0, 0, 0);
+}
+
+static long bench_sse_setup(struct bench_state *s)
+{
+	long err;
+
+	err = sbi_ecall(SBI_EXT_SSE, SBI_EXT_SSE_REGISTER,
+			SBI_SSE_EVENT_LOCAL_SOFTWARE,
+			(unsigned long)test_sse_handler, 0, 0, 0, 0).error;
+	if (err)
+		return err;
+
+	return sbi_ecall(SBI_EXT_SSE, SBI_EXT_SSE_ENABLE,
+			 SBI_SSE_EVENT_LOCAL_SOFTWARE, 0, 0, 0, 0, 0).error;
+}
+
+static long bench_sse_inject(struct bench_state *s)
+{
+	return sbi_ecall(SBI_EXT_SSE, SBI_EXT_SSE_INJECT,
+			 SBI_SSE_EVENT_LOCAL_SOFTWARE, s->hartid,
+			 0, 0, 0, 0).error;
+}
+
+static void bench_sse_cleanup(struct bench_state *s)
+{
+	sbi_ecall(SBI_EXT_SSE, SBI_EXT_SSE_DISABLE,
+		  SBI_SSE_EVENT_LOCAL_SOFTWARE, 0, 0, 0, 0, 0);
+	sbi_ecall(SBI_EXT_SSE, SBI_EXT_SSE_UNREGISTER,
+		  SBI_SSE_EVENT_LOCAL_SOFTWARE, 0, 0, 0, 0, 0);
+}
+
+static const struct bench benches[] = {
+	{ "base probe_extension", BENCH_ITERATIONS,
+	  NULL, bench_probe, NULL },
+	{ "time set_timer", BENCH_ITERATIONS,
+	  NULL, bench_set_timer, NULL },
+	{ "ipi send to self", BENCH_ITERATIONS,
+	  NULL, bench_ipi_self, NULL },
+	{ "rfence fence_i all harts", BENCH_ITERATIONS,
+	  NULL, bench_rfence_all, NULL },
+	{ "hsm suspend/resume", BENCH_ITERATIONS,
+	  bench_suspend_setup, bench_suspend, bench_suspend_cleanup },
+	{ "pmu counter_fw_read", BENCH_ITERATIONS,
+	  bench_pmu_setup, bench_pmu_fw_read, bench_pmu_cleanup },
+	{ "sse inject local", BENCH_ITERATIONS,
+	  bench_sse_setup, bench_sse_inject, bench_sse_cleanup },
+};
+
+static const unsigned long bench_dbcn_sizes[] = { 1, 16, 64, 256 };
+
+static void bench_report(struct bench_state *s, const char *name,
+			 unsigned long size, long err, unsigned long cycles)
+{
+	sbi_ecall_console_puts("hart");
+	print_ulong(s->hartid);
+	sbi_ecall_console_puts(": ");
+	sbi_ecall_console_puts(name);
+	if (size) {
+		sbi_ecall_console_puts(" ");
+		print_ulong(size);
+		sbi_ecall_console_puts(" bytes");
+	}
+	if (err) {
+		sbi_ecall_console_puts(": skipped, error -");
+		print_ulong(-err);
+	} else {
+		sbi_ecall_console_puts(": ");
+		print_ulong(cycles);
+		sbi_ecall_console_puts(" cycles/op");
+	}
+	sbi_ecall_console_puts("\n");
+}
+
+static void bench_one(struct bench_state *s, const char *name,
+		      unsigned long iterations,
+		      long (*run)(struct bench_state *s))
+{
+	unsigned long i, start, end;
+	long err;
+
+	/* Warm up the caches and catch unsupported calls */
+	err = run(s);
+	if (err) {
+		bench_report(s, name, s->size, err, 0);
+		return;
+	}
+
+	start = csr_read(CSR_CYCLE);
+	for (i = 0; i < iterations; i++)
+		run(s);
+	end = csr_read(CSR_CYCLE);
+
+	bench_report(s, name, s->size, 0, (end - start) / iterations);
+}
+
+static void bench_run_all(unsigned long hartid)
+{
+	struct bench_state s = { .hartid = hartid };
+	const struct bench *b;
+	unsigned int i;
+	long err;
+
+	for (i = 0; i < array_size(benches); i++) {
+		b = &benches[i];
+
+		err = b->setup ? b->setup(&s) : SBI_SUCCESS;
+		if (err) {
+			bench_report(&s, b->name, 0, err, 0);
+			continue;
+		}
+
+		bench_one(&s, b->name, b->iterations, b->run);
+
+		if (b->cleanup)
+			b->cleanup(&s);
+	}
+
+	/*
+	 * The console output of the writes is made of spaces followed by a
+	 * carriage return so it doesn't disturb the report.
+	 */
+	for (i = 0; i < array_size(bench_dbcn_sizes); i++) {
+		s.size = bench_dbcn_sizes[i];
+		bench_one(&s, "dbcn write", BENCH_DBCN_ITERATIONS,
+			  bench_dbcn_write);
+	}
+}
+
+static long hart_get_status(unsigned long hartid)
+{
+	struct sbiret ret = sbi_ecall(SBI_EXT_HSM, SBI_EXT_HSM_HART_GET_STATUS,
+				      hartid, 0, 0, 0, 0, 0);
+
+	return ret.error ? (long)ret.error : (long)ret.value;
+}
+
+/* Run the benchmarks on the other HARTs one after the other */
+static void bench_secondaries(unsigned long boot_hartid)
+{
+	unsigned long hartid;
+
+	for (hartid = 0; hartid < BENCH_MAX_HARTS; hartid++) {
+		if (hartid == boot_hartid ||
+		    hart_get_status(hartid) != SBI_HSM_STATE_STOPPED)
+			continue;
+
+		bench_secondary_done = 0;
+		if (sbi_ecall(SBI_EXT_HSM, SBI_EXT_HSM_HART_START, hartid,
+			      (unsigned long)_start_secondary,
+			      (unsigned long)&bench_secondary_stack[
+					BENCH_STACK_SIZE], 0, 0, 0).error)
+			continue;
+
+		while (!bench_secondary_done)
+			;
+		while (hart_get_status(hartid) != SBI_HSM_STATE_STOPPED)
+			;
+	}
+}
+
+void test_secondary(unsigned long hartid)
+{
+	bench_run_all(hartid);
+
+	RISCV_FENCE(rw, w);
+	bench_secondary_done = 1;
+
+	sbi_ecall(SBI_EXT_HSM, SBI_EXT_HSM_HART_STOP, 0, 0, 0, 0, 0, 0);
+}
+
 void test_main(unsigned long a0, unsigned long a1)
 {
 	sbi_ecall_console_puts("\nTest payload running\n");
 
+	sbi_memset(bench_dbcn_buf, ' ', sizeof(bench_dbcn_buf) - 1);
+	bench_dbcn_buf[sizeof(bench_dbcn_buf) - 1] = '\r';
+
+	bench_run_all(a0);
+	bench_secondaries(a0);
+
+	sbi_ecall_console_puts("Test payload done\n");
+
 	while (1)
 		wfi();
 }
@@ -26,19 +26,35 @@
 #define FW_DYNAMIC_INFO_OPTIONS_OFFSET		(4 * __SIZEOF_LONG__)
 /** Offset of boot_hart member in fw_dynamic_info  (version >= 2) */
 #define FW_DYNAMIC_INFO_BOOT_HART_OFFSET	(5 * __SIZEOF_LONG__)
+/** Offset of platform_info member in fw_dynamic_info  (version >= 3) */
+#define FW_DYNAMIC_INFO_PLATFORM_INFO_OFFSET	(6 * __SIZEOF_LONG__)
+/** Offset of fdt_overlays member in fw_dynamic_info  (version >= 4) */
+#define FW_DYNAMIC_INFO_FDT_OVERLAYS_OFFSET	(7 * __SIZEOF_LONG__)
 
 /** Expected value of info magic ('OSBI' ascii string in hex) */
 #define FW_DYNAMIC_INFO_MAGIC_VALUE		0x4942534f
 
 /** Maximum supported info version */
 #define FW_DYNAMIC_INFO_VERSION_2		0x2
-#define FW_DYNAMIC_INFO_VERSION_MAX		FW_DYNAMIC_INFO_VERSION_2
+#define FW_DYNAMIC_INFO_VERSION_3		0x3
+#define FW_DYNAMIC_INFO_VERSION_4		0x4
+#define FW_DYNAMIC_INFO_VERSION_MAX		FW_DYNAMIC_INFO_VERSION_4
 
 /** Possible next mode values */
 #define FW_DYNAMIC_INFO_NEXT_MODE_U		0x0
 #define FW_DYNAMIC_INFO_NEXT_MODE_S		0x1
 #define FW_DYNAMIC_INFO_NEXT_MODE_M		0x3
 
+/** Expected value of platform info magic ('OSPI' ascii string in hex) */
+#define FW_DYNAMIC_PLATFORM_INFO_MAGIC_VALUE	0x4950534f
+
+/** Maximum supported platform info version */
+#define FW_DYNAMIC_PLATFORM_INFO_VERSION_1	0x1
+#define FW_DYNAMIC_PLATFORM_INFO_VERSION_MAX	FW_DYNAMIC_PLATFORM_INFO_VERSION_1
+
+/** Platform info flags */
+#define FW_DYNAMIC_PLATFORM_INFO_FLAG_MLEVEL_IMSIC	(1U << 0)
+
 /* clang-format on */
 
 #ifndef __ASSEMBLER__
@@ -73,6 +89,46 @@ struct fw_dynamic_info {
 	 * to use the relocation lottery mechanism.
 	 */
 	unsigned long boot_hart;
+	/**
+	 * Address of a struct fw_dynamic_platform_info or zero
+	 *
+	 * The previous booting stage may have parsed the device tree
+	 * already and can pass the results needed very early by the
+	 * generic platform so that it does not parse them again.
+	 */
+	unsigned long platform_info;
+	/**
+	 * Address of the FDT overlays to apply or zero
+	 *
+	 * The overlays are placed one after the other and the list ends
+	 * with a word which is not the FDT magic.
+	 */
+	unsigned long fdt_overlays;
+} __packed;
+
+/**
+ * Pre-parsed platform details passed by previous booting stage
+ *
+ * The hart_ids[] array holds hart_count HART ids followed by
+ * coldboot_hart_count ids of the HARTs allowed to do the cold boot.
+ * A zero coldboot_hart_count allows all HARTs. The total size
+ * includes the hart_ids[] array.
+ */
+struct fw_dynamic_platform_info {
+	/** Platform info magic */
+	u32 magic;
+	/** Platform info version */
+	u32 version;
+	/** Total size in bytes */
+	u32 size;
+	/** FW_DYNAMIC_PLATFORM_INFO_FLAG_xyz flags */
+	u32 flags;
+	/** Number of enabled HARTs */
+	u32 hart_count;
+	/** Number of HARTs allowed to do the cold boot */
+	u32 coldboot_hart_count;
+	/** HART ids */
+	u32 hart_ids[];
 } __packed;
 
 /**
@@ -109,6 +165,48 @@ _Static_assert(
 		== FW_DYNAMIC_INFO_BOOT_HART_OFFSET,
 	"struct fw_dynamic_info definition has changed, please redefine "
 	"FW_DYNAMIC_INFO_BOOT_HART_OFFSET");
+_Static_assert(
+	offsetof(struct fw_dynamic_info, platform_info)
+		== FW_DYNAMIC_INFO_PLATFORM_INFO_OFFSET,
+	"struct fw_dynamic_info definition has changed, please redefine "
+	"FW_DYNAMIC_INFO_PLATFORM_INFO_OFFSET");
+_Static_assert(
+	offsetof(struct fw_dynamic_info, fdt_overlays)
+		== FW_DYNAMIC_INFO_FDT_OVERLAYS_OFFSET,
+	"struct fw_dynamic_info definition has changed, please redefine "
+	"FW_DYNAMIC_INFO_FDT_OVERLAYS_OFFSET");
+
+/**
+ * Get the platform info passed by the previous booting stage
+ *
+ * This is provided by the OpenSBI reference firmwares and returns
+ * zero unless the FW_DYNAMIC firmware got a version 3 info.
+ */
+unsigned long fw_prev_platform_info(void);
+
+/**
+ * Get the FDT overlays passed by the previous booting stage
+ *
+ * This is provided by the OpenSBI reference firmwares and returns
+ * zero unless the FW_DYNAMIC firmware got a version 4 info.
+ */
+unsigned long fw_prev_fdt_overlays(void);
+
+/**
+ * Get the FDT overlays embedded in the firmware image
+ *
+ * This is provided by the OpenSBI reference firmwares and returns
+ * zero unless the firmware was built with FW_FDT_OVERLAY_PATH.
+ */
+unsigned long fw_embedded_fdt_overlays(void);
+
+/**
+ * Get the firmware options, a mask of enum sbi_scratch_options
+ *
+ * This is provided by the OpenSBI reference firmwares and can be used
+ * before the scratch space is set up.
+ */
+unsigned long fw_boot_options(void);
 
 #endif
 
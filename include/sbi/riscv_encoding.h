@@ -241,6 +241,18 @@
 #define CSR_FRM				0x002
 #define CSR_FCSR			0x003
 
+/* User Table Jump CSR */
+#define CSR_JVT				0x017
+
+/* User Vector CSRs */
+#define CSR_VSTART			0x008
+#define CSR_VXSAT			0x009
+#define CSR_VXRM			0x00a
+#define CSR_VCSR			0x00f
+#define CSR_VL				0xc20
+#define CSR_VTYPE			0xc21
+#define CSR_VLENB			0xc22
+
 /* User Counters/Timers */
 #define CSR_CYCLE			0xc00
 #define CSR_TIME			0xc01
@@ -774,6 +786,8 @@
 #define SMSTATEEN0_CS			(_ULL(1) << SMSTATEEN0_CS_SHIFT)
 #define SMSTATEEN0_FCSR_SHIFT		1
 #define SMSTATEEN0_FCSR			(_ULL(1) << SMSTATEEN0_FCSR_SHIFT)
+#define SMSTATEEN0_JVT_SHIFT		2
+#define SMSTATEEN0_JVT			(_ULL(1) << SMSTATEEN0_JVT_SHIFT)
 #define SMSTATEEN0_CONTEXT_SHIFT	57
 #define SMSTATEEN0_CONTEXT		(_ULL(1) << SMSTATEEN0_CONTEXT_SHIFT)
 #define SMSTATEEN0_IMSIC_SHIFT		58
@@ -872,6 +886,26 @@
 #define INSN_MASK_FENCE_TSO		0xffffffff
 #define INSN_MATCH_FENCE_TSO		0x8330000f
 
+/* CSRRS with rs1 == x0 (i.e. pure CSR read such as rdtime) */
+#define INSN_MASK_CSRR			0x000ff07f
+#define INSN_MATCH_CSRR			0x00002073
+
+/* Vector loads and stores share the LOAD-FP and STORE-FP opcodes */
+#define INSN_MASK_VECTOR_LDST_OPCODE	0x7f
+#define INSN_MATCH_VECTOR_LOAD		0x07
+#define INSN_MATCH_VECTOR_STORE		0x27
+
+#define INSN_VECTOR_LDST_WIDTH(insn)	(((insn) >> 12) & 0x7)
+#define INSN_IS_VECTOR_LDST_WIDTH(insn)	\
+	(INSN_VECTOR_LDST_WIDTH(insn) == 0 || INSN_VECTOR_LDST_WIDTH(insn) >= 5)
+
+#define IS_VECTOR_LOAD(insn)		\
+	((((insn) & INSN_MASK_VECTOR_LDST_OPCODE) == INSN_MATCH_VECTOR_LOAD) && \
+	 INSN_IS_VECTOR_LDST_WIDTH(insn))
+#define IS_VECTOR_STORE(insn)		\
+	((((insn) & INSN_MASK_VECTOR_LDST_OPCODE) == INSN_MATCH_VECTOR_STORE) && \
+	 INSN_IS_VECTOR_LDST_WIDTH(insn))
+
 #if __riscv_xlen == 64
 
 /* 64-bit read for VS-stage address translation (RV64) */
@@ -10,6 +10,21 @@
 
 #include <sbi/sbi_types.h>
 
+#ifdef CONFIG_SBI_QUEUED_SPINLOCK
+
+/*
+ * Queued spinlock: bit 0 of the lock word is the locked bit and the
+ * remaining bits point to the queue node of the last waiting HART.
+ */
+typedef struct {
+	unsigned long val;
+} __aligned(__SIZEOF_POINTER__) spinlock_t;
+
+#define __SPIN_LOCK_UNLOCKED	\
+	(spinlock_t) { 0 }
+
+#else
+
 #define TICKET_SHIFT	16
 
 typedef struct {
@@ -25,6 +40,8 @@ typedef struct {
 #define __SPIN_LOCK_UNLOCKED	\
 	(spinlock_t) { 0, 0 }
 
+#endif
+
 #define SPIN_LOCK_INIT(x)	\
 	x = __SPIN_LOCK_UNLOCKED
 
@@ -42,4 +59,63 @@ void spin_lock(spinlock_t *lock);
 
 void spin_unlock(spinlock_t *lock);
 
+/*
+ * Fair reader-writer lock: readers and writers which can't get the lock
+ * right away are serialized through the wait_lock spinlock in arrival
+ * order and a waiting writer stops new readers from entering.
+ */
+typedef struct {
+	u32 cnts;
+	spinlock_t wait_lock;
+} rwlock_t;
+
+#define __RW_LOCK_UNLOCKED	\
+	(rwlock_t) { 0, __SPIN_LOCK_UNLOCKED }
+
+#define RW_LOCK_INIT(x)	\
+	x = __RW_LOCK_UNLOCKED
+
+#define RW_LOCK_INITIALIZER	\
+	__RW_LOCK_UNLOCKED
+
+void read_lock(rwlock_t *lock);
+
+void read_unlock(rwlock_t *lock);
+
+void write_lock(rwlock_t *lock);
+
+void write_unlock(rwlock_t *lock);
+
+/*
+ * Sequence lock for small records: writers are serialized by a spinlock
+ * while readers never write the lock and retry if a writer was active.
+ */
+typedef struct {
+	u32 sequence;
+	spinlock_t lock;
+} seqlock_t;
+
+#define __SEQ_LOCK_UNLOCKED	\
+	(seqlock_t) { 0, __SPIN_LOCK_UNLOCKED }
+
+#define SEQ_LOCK_INIT(x)	\
+	x = __SEQ_LOCK_UNLOCKED
+
+#define SEQ_LOCK_INITIALIZER	\
+	__SEQ_LOCK_UNLOCKED
+
+u32 read_seqbegin(const seqlock_t *sl);
+
+bool read_seqretry(const seqlock_t *sl, u32 start);
+
+void write_seqlock(seqlock_t *sl);
+
+void write_sequnlock(seqlock_t *sl);
+
+#ifdef CONFIG_SBI_QUEUED_SPINLOCK
+int spin_lock_queue_init(void);
+#else
+static inline int spin_lock_queue_init(void) { return 0; }
+#endif
+
 #endif
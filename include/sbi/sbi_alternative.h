@@ -0,0 +1,84 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_ALTERNATIVE_H__
+#define __SBI_ALTERNATIVE_H__
+
+#include <sbi/sbi_types.h>
+
+/** Patch site taken when all HARTs have the feature */
+#define SBI_ALT_ALL			0
+/** Patch site taken when no HART has the feature */
+#define SBI_ALT_NONE			1
+
+/**
+ * Patch site emitted by sbi_alternative()
+ *
+ * The site and target are relative to the address of the field so the
+ * table needs no relocation. The flag is one of the SBI_HART_HOT_xyz
+ * flags and the kind is SBI_ALT_ALL or SBI_ALT_NONE.
+ */
+struct sbi_alt_entry {
+	s32 site;
+	s32 target;
+	u32 flag;
+	u32 kind;
+};
+
+#ifdef CONFIG_SBI_ALTERNATIVES
+
+/*
+ * Each site is a 4-byte nop which falls through to the runtime check.
+ * Once the state of the feature is known for all HARTs, the nop is
+ * rewritten into a jump to the label returning true.
+ */
+static __always_inline bool sbi_alternative(unsigned long flag,
+					    unsigned long kind)
+{
+	__asm__ goto(
+		"	.align 2\n"
+		"	.option push\n"
+		"	.option norvc\n"
+		"	.option norelax\n"
+		"1:	nop\n"
+		"	.option pop\n"
+		"	.pushsection .sbi_alternatives, \"a\"\n"
+		"	.balign 4\n"
+		"	.long 1b - ., %l[patched] - ., %0, %1\n"
+		"	.popsection\n"
+		: : "i"(flag), "i"(kind) : : patched);
+
+	return false;
+patched:
+	return true;
+}
+
+/**
+ * Patch all the sites on the coldboot HART
+ *
+ * @param hot SBI_HART_HOT_xyz flags of the coldboot HART
+ */
+void sbi_alternative_apply(unsigned long hot);
+
+/**
+ * Revert the sites which don't match the features of the current HART
+ *
+ * @param hot SBI_HART_HOT_xyz flags of the current HART
+ */
+void sbi_alternative_check(unsigned long hot);
+
+#else
+
+static inline bool sbi_alternative(unsigned long flag, unsigned long kind)
+{
+	return false;
+}
+
+static inline void sbi_alternative_apply(unsigned long hot) { }
+
+static inline void sbi_alternative_check(unsigned long hot) { }
+
+#endif
+
+#endif
@@ -36,6 +36,10 @@ void __bitmap_or(unsigned long *dst, const unsigned long *bitmap1,
 		 const unsigned long *bitmap2, int bits);
 void __bitmap_xor(unsigned long *dst, const unsigned long *bitmap1,
 		  const unsigned long *bitmap2, int bits);
+void __bitmap_andnot(unsigned long *dst, const unsigned long *bitmap1,
+		     const unsigned long *bitmap2, int bits);
+int __bitmap_weight(const unsigned long *bitmap, int bits);
+bool __bitmap_empty(const unsigned long *bitmap, int bits);
 
 static inline void bitmap_set(unsigned long *bmap, int start, int len)
 {
@@ -130,4 +134,27 @@ static inline void bitmap_xor(unsigned long *dst, const unsigned long *src1,
 		__bitmap_xor(dst, src1, src2, nbits);
 }
 
+static inline void bitmap_andnot(unsigned long *dst, const unsigned long *src1,
+				 const unsigned long *src2, int nbits)
+{
+	if (small_const_nbits(nbits))
+		*dst = *src1 & ~*src2;
+	else
+		__bitmap_andnot(dst, src1, src2, nbits);
+}
+
+static inline int bitmap_weight(const unsigned long *src, int nbits)
+{
+	if (small_const_nbits(nbits))
+		return sbi_popcount(*src & BITMAP_LAST_WORD_MASK(nbits));
+	return __bitmap_weight(src, nbits);
+}
+
+static inline bool bitmap_empty(const unsigned long *src, int nbits)
+{
+	if (small_const_nbits(nbits))
+		return !(*src & BITMAP_LAST_WORD_MASK(nbits));
+	return __bitmap_empty(src, nbits);
+}
+
 #endif
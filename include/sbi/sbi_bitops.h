@@ -31,6 +31,17 @@
 #define GENMASK(h, l) \
 	(((~0UL) - (1UL << (l)) + 1) & (~0UL >> (BITS_PER_LONG - 1 - (h))))
 
+#if BITS_PER_LONG == 64
+#define SBI_BITOPS_DEBRUIJN		0x03f79d71b4cb0a89UL
+#define SBI_BITOPS_DEBRUIJN_SHIFT	58
+#else
+#define SBI_BITOPS_DEBRUIJN		0x077cb531UL
+#define SBI_BITOPS_DEBRUIJN_SHIFT	27
+#endif
+
+/* Bit index of each isolated bit multiplied by SBI_BITOPS_DEBRUIJN */
+extern const unsigned char sbi_bitops_debruijn_table[BITS_PER_LONG];
+
 /**
  * sbi_ffs - find first (less-significant) set bit in a long word.
  * @word: The word to search
@@ -39,33 +50,15 @@
  */
 static inline int sbi_ffs(unsigned long word)
 {
-	int num = 0;
-
-#if BITS_PER_LONG == 64
-	if ((word & 0xffffffff) == 0) {
-		num += 32;
-		word >>= 32;
-	}
+#ifdef __riscv_zbb
+	/* Compiles to a single ctz instruction */
+	return __builtin_ctzl(word);
+#else
+	/* Branch-free: isolate the lowest set bit and look it up */
+	return sbi_bitops_debruijn_table[((word & -word) *
+					  SBI_BITOPS_DEBRUIJN) >>
+					 SBI_BITOPS_DEBRUIJN_SHIFT];
 #endif
-	if ((word & 0xffff) == 0) {
-		num += 16;
-		word >>= 16;
-	}
-	if ((word & 0xff) == 0) {
-		num += 8;
-		word >>= 8;
-	}
-	if ((word & 0xf) == 0) {
-		num += 4;
-		word >>= 4;
-	}
-	if ((word & 0x3) == 0) {
-		num += 2;
-		word >>= 2;
-	}
-	if ((word & 0x1) == 0)
-		num += 1;
-	return num;
 }
 
 /*
@@ -77,56 +70,46 @@ static inline int sbi_ffs(unsigned long word)
 #define sbi_ffz(x) sbi_ffs(~(x))
 
 /**
- * sbi_fls - find last (most-significant) set bit in a long word
+ * sbi_popcount - find the number of set bit in a long word
  * @word: the word to search
- *
- * Undefined if no set bit exists, so code should check against 0 first.
  */
-static inline unsigned long sbi_fls(unsigned long word)
+static inline unsigned long sbi_popcount(unsigned long word)
 {
-	int num = BITS_PER_LONG - 1;
-
-#if BITS_PER_LONG == 64
-	if (!(word & (~0ul << 32))) {
-		num -= 32;
-		word <<= 32;
-	}
+#ifdef __riscv_zbb
+	/* Compiles to a single cpop instruction */
+	return __builtin_popcountl(word);
+#else
+	/* Branch-free bit-slice count, summing the bytes with a multiply */
+	word = word - ((word >> 1) & (~0UL / 3));
+	word = (word & (~0UL / 5)) + ((word >> 2) & (~0UL / 5));
+	word = (word + (word >> 4)) & (~0UL / 17);
+	return (word * (~0UL / 255)) >> (BITS_PER_LONG - 8);
 #endif
-	if (!(word & (~0ul << (BITS_PER_LONG-16)))) {
-		num -= 16;
-		word <<= 16;
-	}
-	if (!(word & (~0ul << (BITS_PER_LONG-8)))) {
-		num -= 8;
-		word <<= 8;
-	}
-	if (!(word & (~0ul << (BITS_PER_LONG-4)))) {
-		num -= 4;
-		word <<= 4;
-	}
-	if (!(word & (~0ul << (BITS_PER_LONG-2)))) {
-		num -= 2;
-		word <<= 2;
-	}
-	if (!(word & (~0ul << (BITS_PER_LONG-1))))
-		num -= 1;
-	return num;
 }
 
 /**
- * sbi_popcount - find the number of set bit in a long word
+ * sbi_fls - find last (most-significant) set bit in a long word
  * @word: the word to search
+ *
+ * Undefined if no set bit exists, so code should check against 0 first.
  */
-static inline unsigned long sbi_popcount(unsigned long word)
+static inline unsigned long sbi_fls(unsigned long word)
 {
-	unsigned long count = 0;
-
-	while (word) {
-		word &= word - 1;
-		count++;
-	}
-
-	return count;
+#ifdef __riscv_zbb
+	/* Compiles to a single clz instruction */
+	return BITS_PER_LONG - 1 - __builtin_clzl(word);
+#else
+	/* Branch-free: set all bits below the last one and count them */
+	word |= word >> 1;
+	word |= word >> 2;
+	word |= word >> 4;
+	word |= word >> 8;
+	word |= word >> 16;
+#if BITS_PER_LONG == 64
+	word |= word >> 32;
+#endif
+	return sbi_popcount(word) - 1;
+#endif
 }
 
 #define for_each_set_bit(bit, addr, size) \
@@ -0,0 +1,80 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_BOOT_PROFILE_H__
+#define __SBI_BOOT_PROFILE_H__
+
+#include <sbi/sbi_types.h>
+
+struct sbi_scratch;
+
+/** Maximum number of coldboot phases recorded */
+#define SBI_BOOT_PROFILE_MAX_PHASES	32
+
+/** Duration of one coldboot phase */
+struct sbi_boot_profile_phase {
+	const char *name;
+	unsigned long cycles;
+};
+
+#ifdef CONFIG_SBI_BOOT_PROFILE
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+
+static inline unsigned long sbi_boot_profile_cycles(void)
+{
+	return csr_read(CSR_MCYCLE);
+}
+
+/**
+ * Record the end of a coldboot phase
+ *
+ * The phase lasts from the previous call, or from reset for the first
+ * call, until now. This is only called by the coldboot HART.
+ *
+ * @param name name of the phase which has just completed
+ */
+void sbi_boot_profile_mark(const char *name);
+
+/**
+ * Get the coldboot phases recorded so far
+ *
+ * @param phases pointer filled with the array of recorded phases
+ *
+ * @return number of recorded phases
+ */
+u32 sbi_boot_profile_phases(const struct sbi_boot_profile_phase **phases);
+
+/** Record the cycles spent by a HART in the warmboot path */
+void sbi_boot_profile_warmboot(struct sbi_scratch *scratch,
+			       unsigned long cycles);
+
+/** Print the recorded coldboot phases and warmboot durations */
+void sbi_boot_profile_dump(void);
+
+int sbi_boot_profile_init(void);
+
+#else
+
+static inline unsigned long sbi_boot_profile_cycles(void) { return 0; }
+
+static inline void sbi_boot_profile_mark(const char *name) { }
+
+static inline u32 sbi_boot_profile_phases(
+				const struct sbi_boot_profile_phase **phases)
+{
+	return 0;
+}
+
+static inline void sbi_boot_profile_warmboot(struct sbi_scratch *scratch,
+					     unsigned long cycles) { }
+
+static inline void sbi_boot_profile_dump(void) { }
+
+static inline int sbi_boot_profile_init(void) { return 0; }
+
+#endif
+
+#endif
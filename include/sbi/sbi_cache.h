@@ -0,0 +1,51 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_CACHE_H__
+#define __SBI_CACHE_H__
+
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_types.h>
+
+/** Cache block operations on a physical address range */
+enum sbi_cache_op {
+	/** Write back dirty blocks */
+	SBI_CACHE_OP_CLEAN = 0,
+	/** Discard blocks without writing them back */
+	SBI_CACHE_OP_INVAL,
+	/** Write back dirty blocks and discard them */
+	SBI_CACHE_OP_FLUSH,
+	SBI_CACHE_OP_MAX,
+};
+
+/** Platform cache maintenance device */
+struct sbi_cache_device {
+	/** Name of the cache device */
+	char name[32];
+
+	/** Apply a cache operation to a physical address range */
+	int (*cache_range_op)(enum sbi_cache_op op, unsigned long addr,
+			      unsigned long size);
+
+	/** Restrict the cache ways allocated by a HART, zero for all ways */
+	void (*set_way_mask)(u32 hartid, unsigned long mask);
+};
+
+const struct sbi_cache_device *sbi_cache_get_device(void);
+
+void sbi_cache_set_device(const struct sbi_cache_device *dev);
+
+/** Restrict the cache ways allocated by current HART, zero for all ways */
+void sbi_cache_set_way_mask(unsigned long mask);
+
+#ifdef CONFIG_SBI_CACHE_OPS
+/**
+ * Apply a cache operation to a range of S-mode memory with the platform
+ * cache device or with Zicbom instructions otherwise.
+ */
+int sbi_cache_range_op(unsigned long addr_lo, unsigned long addr_hi,
+		       unsigned long size, unsigned long op);
+#endif
+
+#endif
@@ -24,6 +24,18 @@ struct sbi_console_device {
 
 	/** Read a character from the console input */
 	int (*console_getc)(void);
+
+	/** Enable or disable the TX empty interrupt (optional) */
+	void (*console_tx_irq_enable)(bool enable);
+
+	/** Interrupt controller source of the TX empty interrupt */
+	u32 console_tx_hwirq;
+
+	/** Enable or disable the RX data available interrupt (optional) */
+	void (*console_rx_irq_enable)(bool enable);
+
+	/** Interrupt controller source of the RX data available interrupt */
+	u32 console_rx_hwirq;
 };
 
 #define __printf(a, b) __attribute__((format(printf, a, b)))
@@ -56,6 +68,44 @@ const struct sbi_console_device *sbi_console_get_device(void);
 
 void sbi_console_set_device(const struct sbi_console_device *dev);
 
+#ifdef CONFIG_SBI_CONSOLE_RING
+/** Write buffered console output unless another HART is doing it */
+void sbi_console_drain(void);
+
+/** Wait until all buffered console output has been written */
+void sbi_console_flush(void);
+#else
+static inline void sbi_console_drain(void) { }
+
+static inline void sbi_console_flush(void) { }
+#endif
+
+#ifdef CONFIG_SBI_CONSOLE_TX_IRQ
+/**
+ * Start using the TX empty interrupt of the console device
+ *
+ * Called by the interrupt controller driver once the console TX empty
+ * interrupt is routed to M-mode of some HART.
+ */
+void sbi_console_tx_irq_init(void);
+
+/** Handle the console TX empty interrupt */
+void sbi_console_tx_irq_process(void);
+#endif
+
+#ifdef CONFIG_SBI_CONSOLE_RX_IRQ
+/**
+ * Start buffering console input from the RX data available interrupt
+ *
+ * Called by the interrupt controller driver once the console RX
+ * interrupt is routed to M-mode of some HART.
+ */
+void sbi_console_rx_irq_init(void);
+
+/** Handle the console RX data available interrupt */
+void sbi_console_rx_irq_process(void);
+#endif
+
 struct sbi_scratch;
 
 int sbi_console_init(struct sbi_scratch *scratch);
@@ -32,4 +32,19 @@ int sbi_cppc_write(unsigned long reg, uint64_t val);
 const struct sbi_cppc_device *sbi_cppc_get_device(void);
 void sbi_cppc_set_device(const struct sbi_cppc_device *dev);
 
+/** Value of both shared memory address halves to disable the channel */
+#define SBI_CPPC_SHMEM_DISABLE		(-1UL)
+
+/**
+ * Set or clear the shared memory used by S-mode of the calling HART to
+ * request a desired performance level without an ecall. The request is
+ * applied from a periodic firmware timer event or when the platform calls
+ * sbi_cppc_shmem_process().
+ */
+int sbi_cppc_set_shmem(unsigned long shmem_lo, unsigned long shmem_hi,
+		       unsigned long flags);
+
+/** Apply a pending shared memory performance request of current HART */
+void sbi_cppc_shmem_process(void);
+
 #endif
@@ -14,6 +14,7 @@
 #include <sbi/sbi_types.h>
 
 struct sbi_domain;
+struct sbi_scratch;
 
 enum {
 	RV_DBTR_DECLARE_BIT(TS, MAPPED, 0), /* trigger mapped to hw trigger */
@@ -68,9 +69,18 @@ struct sbi_dbtr_id_msg {
 	unsigned long idx;
 };
 
+/* Number of trigger types encodable in tdata1 */
+#define SBI_DBTR_TRIG_TYPE_MAX		16
+
 struct sbi_dbtr_hart_triggers_state {
 	struct sbi_dbtr_trigger triggers[RV_MAX_TRIGGERS];
 	struct sbi_dbtr_shmem shmem;
+	/* Bitmap of triggers not installed */
+	unsigned long free_trigs;
+	/* Bitmap of triggers supporting each type */
+	unsigned long type_trigs[SBI_DBTR_TRIG_TYPE_MAX];
+	/* Number of trigger allocations which failed */
+	unsigned long alloc_failures;
 	u32 total_trigs;
 	u32 available_trigs;
 	u32 hartid;
@@ -119,6 +129,9 @@ int sbi_dbtr_update_trig(unsigned long smode,
 			 unsigned long trig_idx_mask);
 int sbi_dbtr_disable_trig(unsigned long trig_idx_base,
 			  unsigned long trig_idx_mask);
+int sbi_dbtr_apply_trig(unsigned long trig_idx_base,
+			unsigned long trig_idx_mask, unsigned long *out);
+int sbi_dbtr_alloc_failures(unsigned long flags, unsigned long *out);
 
 int sbi_dbtr_get_total_triggers(void);
 
@@ -162,9 +162,25 @@ struct sbi_domain_memregion {
 };
 
 /** Maximum number of domains */
+#ifdef CONFIG_SBI_DOMAIN_MAX_INDEX
+#define SBI_DOMAIN_MAX_INDEX			CONFIG_SBI_DOMAIN_MAX_INDEX
+#else
 #define SBI_DOMAIN_MAX_INDEX			32
+#endif
 
 /** Representation of OpenSBI domain */
+struct sbi_hart_pmp_cache;
+
+/** Flattened address interval of the domain memory region index */
+struct sbi_domain_memregion_interval {
+	/** First address of the interval */
+	unsigned long start;
+	/** Last address of the interval (inclusive) */
+	unsigned long end;
+	/** Highest priority memory region covering the interval */
+	const struct sbi_domain_memregion *reg;
+};
+
 struct sbi_domain {
 	/**
 	 * Logical index of this domain
@@ -177,16 +193,27 @@ struct sbi_domain {
 	 * in the coldboot path
 	 */
 	struct sbi_hartmask assigned_harts;
-	/** Spinlock for accessing assigned_harts */
-	spinlock_t assigned_harts_lock;
+	/** Reader-writer lock for accessing assigned_harts */
+	rwlock_t assigned_harts_lock;
 	/** Name of this domain */
 	char name[64];
 	/** Possible HARTs in this domain */
 	const struct sbi_hartmask *possible_harts;
 	/** Contexts for possible HARTs indexed by hartindex */
-	struct sbi_context *hartindex_to_context_table[SBI_HARTMASK_MAX_BITS];
+	struct sbi_context **hartindex_to_context_table;
+	/** Array of the contexts of the possible HARTs, one per cache line */
+	struct sbi_context *contexts;
 	/** Array of memory regions terminated by a region with order zero */
 	struct sbi_domain_memregion *regions;
+	/**
+	 * Sorted non-overlapping intervals of the memory regions
+	 * Note: This set by sbi_domain_finalize() in the coldboot path
+	 */
+	struct sbi_domain_memregion_interval *region_index;
+	/** Number of entries in region_index */
+	u32 region_index_count;
+	/** PMP programming cached by sbi_hart_pmp_configure() */
+	struct sbi_hart_pmp_cache *pmp_cache;
 	/** HART id of the HART booting this domain */
 	u32 boot_hartid;
 	/** Arg1 (or 'a1' register) of next booting stage for this domain */
@@ -199,6 +226,12 @@ struct sbi_domain {
 	bool system_reset_allowed;
 	/** Is domain allowed to suspend the system */
 	bool system_suspend_allowed;
+	/** Cache ways allocated by the domain HARTs, zero for all ways */
+	unsigned long cache_way_mask;
+	/** Bits of mstateen0 cleared while the domain runs */
+	u64 stateen0_deny;
+	/** Time slice in microseconds before preemption, zero for none */
+	u32 time_slice;
 	/** Identifies whether to include the firmware region */
 	bool fw_region_inited;
 };
@@ -216,13 +249,16 @@ void sbi_update_hartindex_to_domain(u32 hartindex, struct sbi_domain *dom);
 #define sbi_domain_thishart_ptr() \
 	sbi_hartindex_to_domain(sbi_hartid_to_hartindex(current_hartid()))
 
-/** Index to domain table */
-extern struct sbi_domain *domidx_to_domain_table[];
+/** Index to domain table (null-terminated, grown on registration) */
+extern struct sbi_domain **domidx_to_domain_table;
 
 /** Get pointer to sbi_domain from index */
 #define sbi_index_to_domain(__index) \
 	domidx_to_domain_table[__index]
 
+/** Get pointer to sbi_domain from index with bounds check */
+struct sbi_domain *sbi_domain_find_index(unsigned long index);
+
 /** Iterate over each domain */
 #define sbi_domain_for_each(__i, __d) \
 	for ((__i) = 0; ((__d) = sbi_index_to_domain(__i)); (__i)++)
@@ -295,6 +331,22 @@ bool sbi_domain_check_addr_range(const struct sbi_domain *dom,
 				 unsigned long mode,
 				 unsigned long access_flags);
 
+/**
+ * Check whether S-mode shared memory can be accessed by the current HART
+ * under its domain
+ *
+ * Like sbi_domain_check_addr_range() for PRV_S but the last ranges found
+ * accessible are remembered per HART, so repeated checks of the same
+ * shared memory are cheap. The remembered ranges are dropped when the
+ * HART switches to another domain.
+ * @param addr the start of the address range to be checked
+ * @param size the size of the address range to be checked
+ * @param access_flags bitmask of domain access types (enum sbi_domain_access)
+ * @return TRUE if access allowed otherwise FALSE
+ */
+bool sbi_domain_check_shmem(unsigned long addr, unsigned long size,
+			    unsigned long access_flags);
+
 /** Dump domain details on the console */
 void sbi_domain_dump(const struct sbi_domain *dom, const char *suffix);
 
@@ -321,6 +373,20 @@ int sbi_domain_register(struct sbi_domain *dom,
  */
 int sbi_domain_root_add_memregion(const struct sbi_domain_memregion *reg);
 
+/**
+ * Add several memory regions to the root domain
+ * @param regs pointer to the array of memory regions to be added
+ * @param count number of memory regions in the array
+ *
+ * The root regions are sorted and merged once before they are used
+ * instead of after every single region.
+ *
+ * @return 0 on success
+ * @return SBI_EINVAL otherwise
+ */
+int sbi_domain_root_add_memregions(const struct sbi_domain_memregion *regs,
+				   u32 count);
+
 /**
  * Add a memory range with its flags to the root domain
  * @param addr start physical address of memory range
@@ -10,6 +10,9 @@
 #include <sbi/sbi_types.h>
 #include <sbi/sbi_trap.h>
 #include <sbi/sbi_domain.h>
+#include <sbi/sbi_fwft.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_sta.h>
 
 /** Context representation for a hart within a domain */
 struct sbi_context {
@@ -38,6 +41,23 @@ struct sbi_context {
 	unsigned long scounteren;
 	/** Supervisor environment configuration register */
 	unsigned long senvcfg;
+	/** Supervisor state enable register */
+	unsigned long sstateen0;
+
+	/** PMP configuration of the domain on this hart */
+	struct sbi_hart_pmp_image pmp;
+	/** FWFT feature state of the domain on this hart */
+	struct sbi_fwft_context fwft;
+	/** Steal-time accounting state of the domain on this hart */
+	struct sbi_sta_context sta;
+#ifdef CONFIG_SBI_DOMAIN_CONTEXT_BENCH
+	/** Number of switches into this context */
+	unsigned long switch_count;
+	/** Total cycles spent switching into this context */
+	unsigned long switch_cycles;
+	/** Worst case cycles spent switching into this context */
+	unsigned long switch_cycles_max;
+#endif
 
 	/** Reference to the owning domain */
 	struct sbi_domain *dom;
@@ -45,6 +65,10 @@ struct sbi_context {
 	struct sbi_context *prev_ctx;
 	/** Is context initialized and runnable */
 	bool initialized;
+	/** Is context waiting for a domain call to return */
+	bool calling;
+	/** Is context switched out by the scheduler in the middle of its run */
+	bool preempted;
 };
 
 /** Get the context pointer for a given hart index and domain */
@@ -61,6 +85,9 @@ struct sbi_context {
  * Enter a specific domain context synchronously
  * @param dom pointer to domain
  *
+ * A context preempted by the scheduler can't be entered, it is only
+ * resumed by the scheduler.
+ *
  * @return 0 on success and negative error code on failure
  */
 int sbi_domain_context_enter(struct sbi_domain *dom);
@@ -74,4 +101,51 @@ int sbi_domain_context_enter(struct sbi_domain *dom);
  */
 int sbi_domain_context_exit(void);
 
+/**
+ * Call into a domain context synchronously passing a register payload
+ *
+ * The payload is taken from a1-a5 of the caller trap registers and is
+ * delivered in a1-a5 of the callee along with the index of the calling
+ * domain in a0. The callee gets the payload as return values of its
+ * pending sbi_domain_context_return() call. A domain which has not run
+ * yet on the current hart is started from its boot address instead.
+ *
+ * @param dom pointer to the target domain
+ * @param regs pointer to the trap registers of the caller which are
+ * replaced by the trap registers of the callee on success
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_domain_context_call(struct sbi_domain *dom,
+			    struct sbi_trap_regs *regs);
+
+/**
+ * Return from a domain call passing a0-a5 of the callee trap registers
+ * as the result of the pending sbi_domain_context_call() of the caller
+ *
+ * @param regs pointer to the trap registers of the callee which are
+ * replaced by the trap registers of the caller on success
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_domain_context_return(struct sbi_trap_regs *regs);
+
+#ifdef CONFIG_SBI_DOMAIN_SCHED
+/**
+ * Start the time slice of the domain of the current hart
+ *
+ * @param scratch pointer to the scratch space of the current hart
+ * @param cold_boot true on the coldboot hart
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_domain_sched_start(struct sbi_scratch *scratch, bool cold_boot);
+#else
+static inline int sbi_domain_sched_start(struct sbi_scratch *scratch,
+					 bool cold_boot)
+{
+	return 0;
+}
+#endif
+
 #endif // __SBI_DOMAIN_CONTEXT_H__
@@ -89,6 +89,15 @@ void sbi_ecall_unregister_extension(struct sbi_ecall_extension *ext);
 
 int sbi_ecall_handler(struct sbi_trap_context *tcntx);
 
+/** Maximum number of SBI calls in one multicall request */
+#define SBI_ECALL_MULTICALL_MAX		64
+
+int sbi_ecall_multicall(struct sbi_trap_regs *regs, unsigned long addr_lo,
+			unsigned long addr_hi, unsigned long count);
+
+/* Only caller-saved registers, SP, MEPC and MSTATUS are valid in regs */
+void sbi_ecall_fast_handler(struct sbi_trap_regs *regs);
+
 int sbi_ecall_init(void);
 
 #endif
@@ -35,6 +35,11 @@
 #define SBI_EXT_DBTR				0x44425452
 #define SBI_EXT_SSE				0x535345
 #define SBI_EXT_FWFT				0x46574654
+#define SBI_EXT_NACL				0x4E41434C
+#define SBI_EXT_STA				0x535441
+
+/* OpenSBI firmware specific extension (low bits are the SBI impid) */
+#define SBI_EXT_OPENSBI				(SBI_EXT_FIRMWARE_START | 0x1)
 
 /* SBI function IDs for BASE extension*/
 #define SBI_EXT_BASE_GET_SPEC_VERSION		0x0
@@ -118,10 +123,99 @@
 #define SBI_EXT_DBTR_TRIGGER_ENABLE	0x6
 #define SBI_EXT_DBTR_TRIGGER_DISABLE	0x7
 
+/* SBI function IDs for OpenSBI firmware specific extension */
+#define SBI_EXT_OPENSBI_ECALL_STATS_READ	0x0
+#define SBI_EXT_OPENSBI_RFENCE_BATCH		0x1
+#define SBI_EXT_OPENSBI_MISALIGNED_STATS_READ	0x2
+#define SBI_EXT_OPENSBI_IDLE_STATS_READ		0x3
+#define SBI_EXT_OPENSBI_DBTR_APPLY		0x4
+#define SBI_EXT_OPENSBI_DBTR_ALLOC_FAILURES	0x5
+#define SBI_EXT_OPENSBI_DOMAIN_CALL		0x6
+#define SBI_EXT_OPENSBI_DOMAIN_RETURN		0x7
+#define SBI_EXT_OPENSBI_PMU_MUX_SET		0x8
+#define SBI_EXT_OPENSBI_CPPC_SET_SHMEM		0x9
+#define SBI_EXT_OPENSBI_CACHE_RANGE_OP		0xA
+#define SBI_EXT_OPENSBI_TRACE_READ		0xB
+#define SBI_EXT_OPENSBI_MULTICALL		0xC
+#define SBI_EXT_OPENSBI_LOCKSTAT_READ		0xD
+#define SBI_EXT_OPENSBI_HSM_START_MANY		0xE
+#define SBI_EXT_OPENSBI_HSM_GET_STATES		0xF
+
+#define SBI_EXT_OPENSBI_ECALL_STATS_FLAG_CLEAR	(1 << 0)
+#define SBI_EXT_OPENSBI_MISALIGNED_STATS_FLAG_CLEAR	(1 << 0)
+#define SBI_EXT_OPENSBI_IDLE_STATS_FLAG_CLEAR	(1 << 0)
+#define SBI_EXT_OPENSBI_DBTR_FLAG_CLEAR		(1 << 0)
+#define SBI_EXT_OPENSBI_TRACE_FLAG_CLEAR	(1 << 0)
+#define SBI_EXT_OPENSBI_LOCKSTAT_FLAG_CLEAR	(1 << 0)
+
+/* State reported for a HART which isn't assigned to the domain */
+#define SBI_EXT_OPENSBI_HSM_STATE_NONE		0xff
+
+/* SBI function IDs for NACL extension */
+#define SBI_EXT_NACL_PROBE_FEATURE		0x0
+#define SBI_EXT_NACL_SET_SHMEM			0x1
+#define SBI_EXT_NACL_SYNC_CSR			0x2
+#define SBI_EXT_NACL_SYNC_HFENCE		0x3
+#define SBI_EXT_NACL_SYNC_SRET			0x4
+
+#define SBI_NACL_FEAT_SYNC_CSR			0x0
+#define SBI_NACL_FEAT_SYNC_HFENCE		0x1
+#define SBI_NACL_FEAT_SYNC_SRET			0x2
+#define SBI_NACL_FEAT_AUTOSWAP_CSR		0x3
+
+/* NACL shared memory layout, offsets are in bytes */
+#define SBI_NACL_SHMEM_ADDR_SHIFT		12
+#define SBI_NACL_SHMEM_SRET_OFFSET		0x0000
+#define SBI_NACL_SHMEM_SRET_X(__i)		((__riscv_xlen / 8) * (__i))
+#define SBI_NACL_SHMEM_SRET_X_LAST		31
+#define SBI_NACL_SHMEM_AUTOSWAP_OFFSET		0x0200
+#define SBI_NACL_SHMEM_AUTOSWAP_FLAG_HSTATUS	(1 << 0)
+#define SBI_NACL_SHMEM_AUTOSWAP_HSTATUS		\
+	(SBI_NACL_SHMEM_AUTOSWAP_OFFSET + (__riscv_xlen / 8))
+#define SBI_NACL_SHMEM_HFENCE_OFFSET		0x0800
+#define SBI_NACL_SHMEM_HFENCE_SIZE		0x0780
+#define SBI_NACL_SHMEM_DBITMAP_OFFSET		0x0F80
+#define SBI_NACL_SHMEM_CSR_OFFSET		0x1000
+#define SBI_NACL_SHMEM_CSR_SIZE			((__riscv_xlen / 8) * 1024)
+#define SBI_NACL_SHMEM_SIZE			\
+	(SBI_NACL_SHMEM_CSR_OFFSET + SBI_NACL_SHMEM_CSR_SIZE)
+#define SBI_NACL_SHMEM_CSR_INDEX(__csr)		\
+	((((__csr) & 0xc00) >> 2) | ((__csr) & 0xff))
+
+/* NACL shared memory HFENCE entry is config, pnum and pcount words */
+#define SBI_NACL_SHMEM_HFENCE_ENTRY_SZ		((__riscv_xlen / 8) * 4)
+#define SBI_NACL_SHMEM_HFENCE_ENTRY_MAX		\
+	(SBI_NACL_SHMEM_HFENCE_SIZE / SBI_NACL_SHMEM_HFENCE_ENTRY_SZ)
+#define SBI_NACL_SHMEM_HFENCE_CONFIG_PEND	(1UL << (__riscv_xlen - 1))
+#define SBI_NACL_SHMEM_HFENCE_CONFIG_TYPE_SHIFT	(__riscv_xlen - 8)
+#define SBI_NACL_SHMEM_HFENCE_CONFIG_TYPE_MASK	0xf
+#define SBI_NACL_SHMEM_HFENCE_CONFIG_ORDER_SHIFT (__riscv_xlen - 16)
+#define SBI_NACL_SHMEM_HFENCE_CONFIG_ORDER_MASK	0x7f
+#define SBI_NACL_SHMEM_HFENCE_ORDER_BASE	12
+#if __riscv_xlen == 32
+#define SBI_NACL_SHMEM_HFENCE_CONFIG_VMID_SHIFT	9
+#define SBI_NACL_SHMEM_HFENCE_CONFIG_VMID_MASK	0x7f
+#define SBI_NACL_SHMEM_HFENCE_CONFIG_ASID_MASK	0x1ff
+#else
+#define SBI_NACL_SHMEM_HFENCE_CONFIG_VMID_SHIFT	32
+#define SBI_NACL_SHMEM_HFENCE_CONFIG_VMID_MASK	0x3fff
+#define SBI_NACL_SHMEM_HFENCE_CONFIG_ASID_MASK	0xffff
+#endif
+
+#define SBI_NACL_SHMEM_HFENCE_TYPE_GVMA		0x0
+#define SBI_NACL_SHMEM_HFENCE_TYPE_GVMA_ALL	0x1
+#define SBI_NACL_SHMEM_HFENCE_TYPE_GVMA_VMID	0x2
+#define SBI_NACL_SHMEM_HFENCE_TYPE_GVMA_VMID_ALL 0x3
+#define SBI_NACL_SHMEM_HFENCE_TYPE_VVMA		0x4
+#define SBI_NACL_SHMEM_HFENCE_TYPE_VVMA_ALL	0x5
+#define SBI_NACL_SHMEM_HFENCE_TYPE_VVMA_ASID	0x6
+#define SBI_NACL_SHMEM_HFENCE_TYPE_VVMA_ASID_ALL 0x7
+
 /* SBI function IDs for FW feature extension */
 #define SBI_EXT_FWFT_SET		0x0
 #define SBI_EXT_FWFT_GET		0x1
 
+#ifndef __ASSEMBLER__
 enum sbi_fwft_feature_t {
 	SBI_FWFT_MISALIGNED_EXC_DELEG		= 0x0,
 	SBI_FWFT_LANDING_PAD			= 0x1,
@@ -138,13 +232,22 @@ enum sbi_fwft_feature_t {
 	SBI_FWFT_GLOBAL_PLATFORM_START		= 0xc0000000,
 	SBI_FWFT_GLOBAL_PLATFORM_END		= 0xffffffff,
 };
+#endif
 
 #define SBI_FWFT_GLOBAL_FEATURE_BIT		(1 << 31)
 #define SBI_FWFT_PLATFORM_FEATURE_BIT		(1 << 30)
 
 #define SBI_FWFT_SET_FLAG_LOCK			(1 << 0)
 
+/* SBI function IDs for STA extension */
+#define SBI_EXT_STA_STEAL_TIME_SET_SHMEM	0x0
+
+/* STA shared memory is one 64 byte aligned record per HART */
+#define SBI_STA_SHMEM_DISABLE			-1UL
+#define SBI_STA_SHMEM_SIZE			64
+
 /** General pmu event codes specified in SBI PMU extension */
+#ifndef __ASSEMBLER__
 enum sbi_pmu_hw_generic_events_t {
 	SBI_PMU_HW_NO_EVENT			= 0,
 	SBI_PMU_HW_CPU_CYCLES			= 1,
@@ -160,6 +263,7 @@ enum sbi_pmu_hw_generic_events_t {
 
 	SBI_PMU_HW_GENERAL_MAX,
 };
+#endif
 
 /**
  * Generalized hardware cache events:
@@ -168,6 +272,7 @@ enum sbi_pmu_hw_generic_events_t {
  *       { read, write, prefetch } x
  *       { accesses, misses }
  */
+#ifndef __ASSEMBLER__
 enum sbi_pmu_hw_cache_id {
 	SBI_PMU_HW_CACHE_L1D		= 0,
 	SBI_PMU_HW_CACHE_L1I		= 1,
@@ -179,7 +284,9 @@ enum sbi_pmu_hw_cache_id {
 
 	SBI_PMU_HW_CACHE_MAX,
 };
+#endif
 
+#ifndef __ASSEMBLER__
 enum sbi_pmu_hw_cache_op_id {
 	SBI_PMU_HW_CACHE_OP_READ	= 0,
 	SBI_PMU_HW_CACHE_OP_WRITE	= 1,
@@ -187,19 +294,23 @@ enum sbi_pmu_hw_cache_op_id {
 
 	SBI_PMU_HW_CACHE_OP_MAX,
 };
+#endif
 
+#ifndef __ASSEMBLER__
 enum sbi_pmu_hw_cache_op_result_id {
 	SBI_PMU_HW_CACHE_RESULT_ACCESS	= 0,
 	SBI_PMU_HW_CACHE_RESULT_MISS	= 1,
 
 	SBI_PMU_HW_CACHE_RESULT_MAX,
 };
+#endif
 
 /**
  * Special "firmware" events provided by the OpenSBI, even if the hardware
  * does not support performance events. These events are encoded as a raw
  * event type in Linux kernel perf framework.
  */
+#ifndef __ASSEMBLER__
 enum sbi_pmu_fw_event_code_id {
 	SBI_PMU_FW_MISALIGNED_LOAD	= 0,
 	SBI_PMU_FW_MISALIGNED_STORE	= 1,
@@ -231,6 +342,28 @@ enum sbi_pmu_fw_event_code_id {
 	 * Event codes 256 to 65534 are reserved for SBI implementation
 	 * specific custom firmware events.
 	 */
+	SBI_PMU_FW_CUSTOM_START		= 256,
+	SBI_PMU_FW_ECALL_FASTPATH	= SBI_PMU_FW_CUSTOM_START,
+	SBI_PMU_FW_TRAP_IRQ_TIMER	= 257,
+	SBI_PMU_FW_TRAP_IRQ_SOFT	= 258,
+	SBI_PMU_FW_TRAP_IRQ_EXT		= 259,
+	SBI_PMU_FW_TRAP_IRQ_OTHER	= 260,
+	SBI_PMU_FW_TRAP_ECALL		= 261,
+	SBI_PMU_FW_TRAP_REDIRECT	= 262,
+	SBI_PMU_FW_TRAP_IRQ_CYCLES	= 263,
+	SBI_PMU_FW_TRAP_ECALL_CYCLES	= 264,
+	SBI_PMU_FW_TRAP_EXCEPTION_CYCLES = 265,
+	SBI_PMU_FW_TRAP_IRQ_PASS	= 266,
+	SBI_PMU_FW_TRAP_IRQ_BATCH	= 267,
+	SBI_PMU_FW_TRAP_IRQ_BUDGET_EXHAUSTED = 268,
+	SBI_PMU_FW_TLB_SYNC_CYCLES	= 269,
+	SBI_PMU_FW_IPI_SEND_CYCLES	= 270,
+	SBI_PMU_FW_TRAP_REDIRECT_ILLEGAL_INSN = 271,
+	SBI_PMU_FW_TRAP_REDIRECT_PAGE_FAULT = 272,
+	SBI_PMU_FW_TRAP_REDIRECT_GUEST_PAGE_FAULT = 273,
+	SBI_PMU_FW_TRAP_REDIRECT_OTHER	= 274,
+	SBI_PMU_FW_TRAP_REDIRECT_VS	= 275,
+	SBI_PMU_FW_CUSTOM_MAX,
 	SBI_PMU_FW_RESERVED_MAX = 0xFFFE,
 	/*
 	 * Event code 0xFFFF is used for platform specific firmware
@@ -238,8 +371,10 @@ enum sbi_pmu_fw_event_code_id {
 	 */
 	SBI_PMU_FW_PLATFORM = 0xFFFF,
 };
+#endif
 
 /** SBI PMU event idx type */
+#ifndef __ASSEMBLER__
 enum sbi_pmu_event_type_id {
 	SBI_PMU_EVENT_TYPE_HW				= 0x0,
 	SBI_PMU_EVENT_TYPE_HW_CACHE			= 0x1,
@@ -247,12 +382,15 @@ enum sbi_pmu_event_type_id {
 	SBI_PMU_EVENT_TYPE_FW				= 0xf,
 	SBI_PMU_EVENT_TYPE_MAX,
 };
+#endif
 
 /** SBI PMU counter type */
+#ifndef __ASSEMBLER__
 enum sbi_pmu_ctr_type {
 	SBI_PMU_CTR_TYPE_HW = 0,
 	SBI_PMU_CTR_TYPE_FW,
 };
+#endif
 
 /* Helper macros to decode event idx */
 #define SBI_PMU_EVENT_IDX_MASK 0xFFFFF
@@ -287,6 +425,9 @@ enum sbi_pmu_ctr_type {
 #define SBI_PMU_STOP_FLAG_RESET (1 << 0)
 #define SBI_PMU_STOP_FLAG_TAKE_SNAPSHOT (1 << 1)
 
+/* Shared memory address used to disable counter snapshots */
+#define SBI_PMU_SNAPSHOT_DISABLE	(-1UL)
+
 /* SBI function IDs for DBCN extension */
 #define SBI_EXT_DBCN_CONSOLE_WRITE		0x0
 #define SBI_EXT_DBCN_CONSOLE_READ		0x1
@@ -305,6 +446,7 @@ enum sbi_pmu_ctr_type {
 #define SBI_EXT_CPPC_READ_HI			0x2
 #define SBI_EXT_CPPC_WRITE			0x3
 
+#ifndef __ASSEMBLER__
 enum sbi_cppc_reg_id {
 	SBI_CPPC_HIGHEST_PERF		= 0x00000000,
 	SBI_CPPC_NOMINAL_PERF		= 0x00000001,
@@ -331,6 +473,7 @@ enum sbi_cppc_reg_id {
 	SBI_CPPC_TRANSITION_LATENCY	= 0x80000000,
 	SBI_CPPC_NON_ACPI_LAST		= SBI_CPPC_TRANSITION_LATENCY,
 };
+#endif
 
 /* SBI Function IDs for SSE extension */
 #define SBI_EXT_SSE_READ_ATTR		0x00000000
@@ -343,6 +486,7 @@ enum sbi_cppc_reg_id {
 #define SBI_EXT_SSE_INJECT		0x00000007
 
 /* SBI SSE Event Attributes. */
+#ifndef __ASSEMBLER__
 enum sbi_sse_attr_id {
 	SBI_SSE_ATTR_STATUS		= 0x00000000,
 	SBI_SSE_ATTR_PRIO		= 0x00000001,
@@ -357,6 +501,7 @@ enum sbi_sse_attr_id {
 
 	SBI_SSE_ATTR_MAX		= 0x0000000A
 };
+#endif
 
 #define SBI_SSE_ATTR_STATUS_STATE_OFFSET	0
 #define SBI_SSE_ATTR_STATUS_STATE_MASK		0x3
@@ -370,12 +515,14 @@ enum sbi_sse_attr_id {
 #define SBI_SSE_ATTR_INTERRUPTED_FLAGS_HSTATUS_SPV	BIT(2)
 #define SBI_SSE_ATTR_INTERRUPTED_FLAGS_HSTATUS_SPVP	BIT(3)
 
+#ifndef __ASSEMBLER__
 enum sbi_sse_state {
 	SBI_SSE_STATE_UNUSED		= 0,
 	SBI_SSE_STATE_REGISTERED	= 1,
 	SBI_SSE_STATE_ENABLED		= 2,
 	SBI_SSE_STATE_RUNNING		= 3,
 };
+#endif
 
 /* SBI SSE Event IDs. */
 #define SBI_SSE_EVENT_LOCAL_RAS			0x00000000
@@ -0,0 +1,69 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_ECALL_STATS_H__
+#define __SBI_ECALL_STATS_H__
+
+#include <sbi/sbi_types.h>
+
+struct sbi_scratch;
+
+/** Number of log2 latency buckets per (extid, funcid) pair */
+#define SBI_ECALL_STATS_HIST_BUCKETS	24
+
+/** Maximum number of (extid, funcid) pairs tracked per HART */
+#define SBI_ECALL_STATS_MAX_ENTRIES	32
+
+/**
+ * Ecall latency statistics of one (extid, funcid) pair
+ *
+ * Bucket N of the histogram counts ecalls which took between 2^N and
+ * 2^(N+1) - 1 cycles whereas the last bucket also counts all slower
+ * ecalls. This layout is also used for the shared memory snapshot.
+ */
+struct sbi_ecall_stats_entry {
+	u32 extid;
+	u32 funcid;
+	u64 count;
+	u64 total_cycles;
+	u64 max_cycles;
+	u32 hist[SBI_ECALL_STATS_HIST_BUCKETS];
+} __packed;
+
+#ifdef CONFIG_SBI_ECALL_STATS
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+
+static inline unsigned long sbi_ecall_stats_begin(void)
+{
+	return csr_read(CSR_MCYCLE);
+}
+
+void sbi_ecall_stats_end(unsigned long extid, unsigned long funcid,
+			 unsigned long start_cycle);
+
+int sbi_ecall_stats_read(u32 hartid, unsigned long addr_lo,
+			 unsigned long addr_hi, unsigned long size,
+			 unsigned long flags, unsigned long *out_count);
+
+void sbi_ecall_stats_dump(struct sbi_scratch *scratch);
+
+int sbi_ecall_stats_init(void);
+
+#else
+
+static inline unsigned long sbi_ecall_stats_begin(void) { return 0; }
+
+static inline void sbi_ecall_stats_end(unsigned long extid,
+				       unsigned long funcid,
+				       unsigned long start_cycle) { }
+
+static inline void sbi_ecall_stats_dump(struct sbi_scratch *scratch) { }
+
+static inline int sbi_ecall_stats_init(void) { return 0; }
+
+#endif
+
+#endif
@@ -0,0 +1,34 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_EMULATE_BITMANIP_H__
+#define __SBI_EMULATE_BITMANIP_H__
+
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_types.h>
+
+struct sbi_trap_regs;
+
+#ifdef CONFIG_SBI_EMULATE_BITMANIP
+
+/**
+ * Emulate a Zba, Zbb, Zbs or Zicond instruction
+ *
+ * @param insn the trapped instruction
+ * @param regs trap registers of the HART
+ *
+ * @return 0 if emulated and SBI_ENOTSUPP if not a known instruction
+ */
+int sbi_emulate_bitmanip(ulong insn, struct sbi_trap_regs *regs);
+
+#else
+
+static inline int sbi_emulate_bitmanip(ulong insn, struct sbi_trap_regs *regs)
+{
+	return SBI_ENOTSUPP;
+}
+
+#endif
+
+#endif
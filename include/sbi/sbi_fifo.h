@@ -11,6 +11,7 @@
 #ifndef __SBI_FIFO_H__
 #define __SBI_FIFO_H__
 
+#include <sbi/riscv_atomic.h>
 #include <sbi/riscv_locks.h>
 #include <sbi/sbi_types.h>
 
@@ -21,8 +22,21 @@ struct sbi_fifo {
 	u16 num_entries;
 	u16 avail;
 	u16 tail;
+	/*
+	 * Per-entry sequence numbers and positions used only by the
+	 * lock-free multi-producer/single-consumer backend. The fifo
+	 * uses this backend when seq is not NULL.
+	 */
+	atomic_t *seq;
+	atomic_t head_pos;
+	atomic_t tail_pos;
+	unsigned long pos_wrap;
 };
 
+/** Size of queue memory required by sbi_fifo_mpsc_init() */
+#define SBI_FIFO_MPSC_MEM_SIZE(__entries, __entry_size)	\
+	((unsigned long)(__entries) * (sizeof(atomic_t) + (__entry_size)))
+
 enum sbi_fifo_inplace_update_types {
 	SBI_FIFO_SKIP,
 	SBI_FIFO_UPDATED,
@@ -31,12 +45,61 @@ enum sbi_fifo_inplace_update_types {
 
 int sbi_fifo_dequeue(struct sbi_fifo *fifo, void *data);
 int sbi_fifo_enqueue(struct sbi_fifo *fifo, void *data);
+int sbi_fifo_enqueue_start(struct sbi_fifo *fifo, void **entry,
+			   unsigned long *pos);
+void sbi_fifo_enqueue_finish(struct sbi_fifo *fifo, unsigned long pos);
+int sbi_fifo_dequeue_start(struct sbi_fifo *fifo, void **entry,
+			   unsigned long *pos);
+void sbi_fifo_dequeue_finish(struct sbi_fifo *fifo, unsigned long pos);
 void sbi_fifo_init(struct sbi_fifo *fifo, void *queue_mem, u16 entries,
 		   u16 entry_size);
+void sbi_fifo_mpsc_init(struct sbi_fifo *fifo, void *queue_mem, u16 entries,
+			u16 entry_size);
 int sbi_fifo_is_empty(struct sbi_fifo *fifo);
 int sbi_fifo_is_full(struct sbi_fifo *fifo);
 int sbi_fifo_inplace_update(struct sbi_fifo *fifo, void *in,
 			    int (*fptr)(void *in, void *data));
+int sbi_fifo_inplace_update_pos(struct sbi_fifo *fifo, unsigned long pos,
+				void *in, int (*fptr)(void *in, void *data));
 u16 sbi_fifo_avail(struct sbi_fifo *fifo);
 
+/**
+ * Define <name>_enqueue() and <name>_dequeue() for a fifo holding entries
+ * of a fixed type. The entry is copied in place using a struct assignment
+ * of known size and alignment instead of sbi_memcpy().
+ *
+ * The fifo must be initialized with an entry size of sizeof(type).
+ */
+#define SBI_FIFO_DEFINE_TYPED(__name, __type)				\
+static inline int __name##_enqueue(struct sbi_fifo *fifo,		\
+				   const __type *data)			\
+{									\
+	unsigned long pos;						\
+	void *entry;							\
+	int ret;							\
+									\
+	ret = sbi_fifo_enqueue_start(fifo, &entry, &pos);		\
+	if (ret)							\
+		return ret;						\
+	*(__type *)entry = *data;					\
+	sbi_fifo_enqueue_finish(fifo, pos);				\
+									\
+	return 0;							\
+}									\
+									\
+static inline int __name##_dequeue(struct sbi_fifo *fifo, __type *data) \
+{									\
+	unsigned long pos;						\
+	void *entry;							\
+	int ret;							\
+									\
+	ret = sbi_fifo_dequeue_start(fifo, &entry, &pos);		\
+	if (ret)							\
+		return ret;						\
+	*data = *(const __type *)entry;					\
+	sbi_fifo_dequeue_finish(fifo, pos);				\
+									\
+	return 0;							\
+}
+
 #endif
@@ -14,10 +14,30 @@
 
 struct sbi_scratch;
 
+/**
+ * FWFT state of one HART in one supervisor domain. Bits are indexed by
+ * the position of the feature in the firmware feature table.
+ */
+struct sbi_fwft_context {
+	/** Features currently set to one */
+	unsigned long values;
+	/** Features locked by SBI_FWFT_SET_FLAG_LOCK */
+	unsigned long locked;
+	/** Is the state captured at least once */
+	bool valid;
+};
+
 int sbi_fwft_set(enum sbi_fwft_feature_t feature, unsigned long value,
 		 unsigned long flags);
 int sbi_fwft_get(enum sbi_fwft_feature_t feature, unsigned long *out_val);
 
+/**
+ * Save the FWFT state of current HART to out and apply the state in.
+ * Features are reset when in was never saved.
+ */
+void sbi_fwft_context_switch(struct sbi_fwft_context *out,
+			     const struct sbi_fwft_context *in);
+
 int sbi_fwft_init(struct sbi_scratch *scratch, bool cold_boot);
 
 #endif
@@ -10,8 +10,11 @@
 #ifndef __SBI_HART_H__
 #define __SBI_HART_H__
 
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_alternative.h>
 #include <sbi/sbi_types.h>
 #include <sbi/sbi_bitops.h>
+#include <sbi/sbi_scratch.h>
 
 /** Possible privileged specification versions of a hart */
 enum sbi_hart_priv_versions {
@@ -67,11 +70,34 @@ enum sbi_hart_extensions {
 	SBI_HART_EXT_SVADE,
 	/** Hart has Svadu extension */
 	SBI_HART_EXT_SVADU,
+	/** Hart has Zawrs extension */
+	SBI_HART_EXT_ZAWRS,
+	/** Hart has Zihintpause extension */
+	SBI_HART_EXT_ZIHINTPAUSE,
+	/** Hart has Svinval extension */
+	SBI_HART_EXT_SVINVAL,
+	/** Hart has Zcmt extension */
+	SBI_HART_EXT_ZCMT,
 
 	/** Maximum index of Hart extension */
 	SBI_HART_EXT_MAX,
 };
 
+/*
+ * Extensions tested on every trap or timer event are mirrored in a
+ * per-HART flags word which is updated whenever the HART extensions
+ * change so that hot paths avoid the bitmap lookup.
+ */
+#define SBI_HART_HOT_SMAIA		(1UL << 0)
+#define SBI_HART_HOT_SSTC		(1UL << 1)
+/* MISA.H is mirrored as well since reading MISA may itself trap */
+#define SBI_HART_HOT_H			(1UL << 2)
+#define SBI_HART_HOT_SVINVAL		(1UL << 3)
+/* Privileged spec versions tested on every domain context switch */
+#define SBI_HART_HOT_PRIV_1_10		(1UL << 4)
+#define SBI_HART_HOT_PRIV_1_12		(1UL << 5)
+#define SBI_HART_HOT_SMSTATEEN		(1UL << 6)
+
 struct sbi_hart_ext_data {
 	const unsigned int id;
 	const char *name;
@@ -96,6 +122,9 @@ extern const struct sbi_hart_ext_data sbi_hart_ext[];
 
 struct sbi_hart_features {
 	bool detected;
+	unsigned long mvendorid;
+	unsigned long marchid;
+	unsigned long mimpid;
 	int priv_version;
 	unsigned long extensions[BITS_TO_LONGS(SBI_HART_EXT_MAX)];
 	unsigned int pmp_count;
@@ -105,6 +134,20 @@ struct sbi_hart_features {
 	unsigned int mhpm_bits;
 };
 
+/** Number of PMP entries held by one pmpcfg CSR */
+#define SBI_HART_PMP_CFG_PER_CSR	(__riscv_xlen / 8)
+
+/** Snapshot of the PMP CSRs of a HART */
+struct sbi_hart_pmp_image {
+	/** Is the snapshot populated */
+	bool valid;
+	/** Values of the pmpcfg CSRs */
+	unsigned long cfg[PMP_COUNT / SBI_HART_PMP_CFG_PER_CSR];
+	/** Values of the pmpaddr CSRs */
+	unsigned long addr[PMP_COUNT];
+};
+
+struct sbi_domain;
 struct sbi_scratch;
 
 int sbi_hart_reinit(struct sbi_scratch *scratch);
@@ -116,14 +159,51 @@ static inline ulong sbi_hart_expected_trap_addr(void)
 	return (ulong)sbi_hart_expected_trap;
 }
 
-unsigned int sbi_hart_mhpm_mask(struct sbi_scratch *scratch);
 void sbi_hart_delegation_dump(struct sbi_scratch *scratch,
 			      const char *prefix, const char *suffix);
+#ifdef CONFIG_SBI_HART_FIXED_GEOMETRY
+/* The geometry is known at build time so the callers can fold it */
+static inline unsigned int sbi_hart_mhpm_mask(struct sbi_scratch *scratch)
+{
+	return CONFIG_SBI_HART_MHPM_MASK;
+}
+
+static inline unsigned int sbi_hart_pmp_count(struct sbi_scratch *scratch)
+{
+	return CONFIG_SBI_HART_PMP_COUNT;
+}
+
+static inline unsigned int sbi_hart_pmp_log2gran(struct sbi_scratch *scratch)
+{
+	return CONFIG_SBI_HART_PMP_LOG2GRAN;
+}
+
+static inline unsigned int sbi_hart_pmp_addrbits(struct sbi_scratch *scratch)
+{
+	return CONFIG_SBI_HART_PMP_ADDR_BITS;
+}
+
+static inline unsigned int sbi_hart_mhpm_bits(struct sbi_scratch *scratch)
+{
+	return CONFIG_SBI_HART_MHPM_BITS;
+}
+#else
+unsigned int sbi_hart_mhpm_mask(struct sbi_scratch *scratch);
 unsigned int sbi_hart_pmp_count(struct sbi_scratch *scratch);
 unsigned int sbi_hart_pmp_log2gran(struct sbi_scratch *scratch);
 unsigned int sbi_hart_pmp_addrbits(struct sbi_scratch *scratch);
 unsigned int sbi_hart_mhpm_bits(struct sbi_scratch *scratch);
+#endif
+unsigned int sbi_hart_mhpm_deleg_mask(struct sbi_scratch *scratch);
+u64 sbi_hart_mstateen0(struct sbi_scratch *scratch);
+void sbi_hart_mstateen_configure(struct sbi_scratch *scratch, u64 deny);
 int sbi_hart_pmp_configure(struct sbi_scratch *scratch);
+void sbi_hart_pmp_cache_invalidate(struct sbi_domain *dom);
+void sbi_hart_pmp_save(struct sbi_scratch *scratch,
+		       struct sbi_hart_pmp_image *img);
+unsigned int sbi_hart_pmp_switch(struct sbi_scratch *scratch,
+				 const struct sbi_hart_pmp_image *cur,
+				 const struct sbi_hart_pmp_image *next);
 int sbi_hart_map_saddr(unsigned long base, unsigned long size);
 int sbi_hart_unmap_saddr(void);
 int sbi_hart_priv_version(struct sbi_scratch *scratch);
@@ -134,6 +214,27 @@ void sbi_hart_update_extension(struct sbi_scratch *scratch,
 			       bool enable);
 bool sbi_hart_has_extension(struct sbi_scratch *scratch,
 			    enum sbi_hart_extensions ext);
+
+extern unsigned long sbi_hart_hot_features_offset;
+
+/** Check SBI_HART_HOT_xyz flags of a HART */
+static __always_inline bool sbi_hart_has_hot_feature(struct sbi_scratch *scratch,
+						     unsigned long flag)
+{
+	/* Patched at boot when the flag is known to be the same on all HARTs */
+	if (sbi_alternative(flag, SBI_ALT_ALL))
+		return true;
+	if (sbi_alternative(flag, SBI_ALT_NONE))
+		return false;
+
+	/* HART features are not yet allocated early in coldboot */
+	if (!sbi_hart_hot_features_offset)
+		return false;
+
+	return (sbi_scratch_read_type(scratch, unsigned long,
+				      sbi_hart_hot_features_offset) & flag) ?
+		true : false;
+}
 void sbi_hart_get_extensions_str(struct sbi_scratch *scratch,
 				 char *extension_str, int nestr);
 
@@ -20,7 +20,20 @@
  * also represents the maximum number of HART ids generic OpenSBI
  * can handle.
  */
+#ifdef CONFIG_SBI_HARTMASK_MAX_BITS
+#define SBI_HARTMASK_MAX_BITS		CONFIG_SBI_HARTMASK_MAX_BITS
+#else
 #define SBI_HARTMASK_MAX_BITS		128
+#endif
+
+/**
+ * Number of bits of a hartmask which can be set
+ *
+ * Hartmasks are indexed using HART index so only the bits below the
+ * number of HARTs of the platform can be set. Iterators only look at
+ * these bits.
+ */
+#define sbi_hartmask_used_bits()	(sbi_scratch_last_hartindex() + 1)
 
 /** Representation of hartmask */
 struct sbi_hartmask {
@@ -65,6 +78,23 @@ static inline void sbi_hartmask_set_hartid(u32 h, struct sbi_hartmask *m)
 	sbi_hartmask_set_hartindex(sbi_hartid_to_hartindex(h), m);
 }
 
+/**
+ * Set the HART ids of a scalar HART mask in hartmask
+ * @param hmask scalar mask of HART ids relative to hbase
+ * @param hbase HART id of bit zero of hmask
+ * @param m the hartmask pointer
+ */
+static inline void sbi_hartmask_set_hartid_mask(unsigned long hmask,
+						unsigned long hbase,
+						struct sbi_hartmask *m)
+{
+	/* Only visit the set bits of the scalar mask */
+	while (hmask) {
+		sbi_hartmask_set_hartid(hbase + sbi_ffs(hmask), m);
+		hmask &= hmask - 1;
+	}
+}
+
 /**
  * Clear a HART index in hartmask
  * @param i HART index to clear
@@ -169,14 +199,47 @@ static inline void sbi_hartmask_xor(struct sbi_hartmask *dstp,
 		   sbi_hartmask_bits(src2p), SBI_HARTMASK_MAX_BITS);
 }
 
+/**
+ * *dstp = *src1p & ~*src2p
+ * @param dstp the hartmask result
+ * @param src1p the first input
+ * @param src2p the second input
+ */
+static inline void sbi_hartmask_andnot(struct sbi_hartmask *dstp,
+				       const struct sbi_hartmask *src1p,
+				       const struct sbi_hartmask *src2p)
+{
+	bitmap_andnot(sbi_hartmask_bits(dstp), sbi_hartmask_bits(src1p),
+		      sbi_hartmask_bits(src2p), SBI_HARTMASK_MAX_BITS);
+}
+
+/**
+ * Count the HARTs in a hartmask
+ * @param srcp the hartmask pointer
+ */
+static inline int sbi_hartmask_weight(const struct sbi_hartmask *srcp)
+{
+	return bitmap_weight(sbi_hartmask_bits(srcp), sbi_hartmask_used_bits());
+}
+
+/**
+ * Check whether a hartmask has no HARTs
+ * @param srcp the hartmask pointer
+ */
+static inline bool sbi_hartmask_empty(const struct sbi_hartmask *srcp)
+{
+	return bitmap_empty(sbi_hartmask_bits(srcp), sbi_hartmask_used_bits());
+}
+
 /**
  * Iterate over each HART index in hartmask
  * __i hart index
  * __m hartmask
 */
 #define sbi_hartmask_for_each_hartindex(__i, __m) \
-	for((__i) = find_first_bit((__m)->bits, SBI_HARTMASK_MAX_BITS); \
-		(__i) < SBI_HARTMASK_MAX_BITS; \
-		(__i) = find_next_bit((__m)->bits, SBI_HARTMASK_MAX_BITS, (__i) + 1))
+	for((__i) = find_first_bit((__m)->bits, sbi_hartmask_used_bits()); \
+		(__i) < sbi_hartmask_used_bits(); \
+		(__i) = find_next_bit((__m)->bits, sbi_hartmask_used_bits(), \
+				      (__i) + 1))
 
 #endif
@@ -29,9 +29,40 @@ static inline void *sbi_calloc(size_t nitems, size_t size)
 	return sbi_zalloc(nitems * size);
 }
 
+/**
+ * Allocate from the heap arena of the current HART
+ *
+ * Meant for per-HART state which is mostly accessed by the allocating
+ * HART. Falls back to the shared heap area if the arena is exhausted.
+ */
+/**
+ * Allocate size bytes starting at a multiple of align, a power of 2.
+ * The size is rounded up to the alignment as well.
+ */
+void *sbi_aligned_alloc(size_t size, unsigned long align);
+
+void *sbi_zalloc_aligned(size_t size, unsigned long align);
+
+/* HART-local allocations are cache line aligned */
+void *sbi_malloc_local(size_t size);
+
+/** Zero allocate from the heap arena of the current HART */
+void *sbi_zalloc_local(size_t size);
+
 /** Free-up to heap area */
 void sbi_free(void *ptr);
 
+/** Raise the cache line size used to keep per-HART data apart */
+void sbi_heap_set_cacheline_size(unsigned long size);
+
+unsigned long sbi_heap_cacheline_size(void);
+
+/** Allocate zeroed memory which shares no cache line with other data */
+static inline void *sbi_zalloc_cacheline(size_t size)
+{
+	return sbi_zalloc_aligned(size, sbi_heap_cacheline_size());
+}
+
 /** Amount (in bytes) of free space in the heap area */
 unsigned long sbi_heap_free_space(void);
 
@@ -41,6 +72,65 @@ unsigned long sbi_heap_used_space(void);
 /** Amount (in bytes) of reserved space in the heap area */
 unsigned long sbi_heap_reserved_space(void);
 
+/** Maximum number of allocation call sites tracked in heap statistics */
+#define SBI_HEAP_STATS_MAX_CALLERS	16
+
+/** Heap allocation totals of one call site */
+struct sbi_heap_caller_stats {
+	unsigned long caller;
+	unsigned long count;
+	unsigned long bytes;
+};
+
+/** Heap allocation statistics */
+struct sbi_heap_stats {
+	unsigned long alloc_count;
+	unsigned long alloc_failed;
+	unsigned long free_count;
+	unsigned long used_bytes;
+	unsigned long peak_bytes;
+	unsigned long largest_free;
+	unsigned long free_blocks;
+	struct sbi_heap_caller_stats callers[SBI_HEAP_STATS_MAX_CALLERS];
+};
+
+#ifdef CONFIG_SBI_HEAP_STATS
+/** Get a snapshot of heap allocation statistics */
+void sbi_heap_get_stats(struct sbi_heap_stats *stats);
+
+/** Print heap allocation statistics */
+void sbi_heap_dump_stats(void);
+#else
+static inline void sbi_heap_get_stats(struct sbi_heap_stats *stats) { }
+
+static inline void sbi_heap_dump_stats(void) { }
+#endif
+
+/** Heap space needed by a subsystem (in bytes) */
+struct sbi_heap_need {
+	const char *name;
+	unsigned long global;
+	unsigned long per_hart;
+};
+
+/**
+ * Declare the heap space needed by a subsystem
+ *
+ * The needs of all the subsystems built into the firmware are added up
+ * by sbi_heap_size_estimate() so a platform can size the heap for the
+ * number of HARTs it finds at boot time.
+ */
+#define SBI_HEAP_NEED(__name, __global, __per_hart)			\
+	static const struct sbi_heap_need __heap_need_##__name		\
+	__attribute__((used, section(".sbi_heap_needs"))) = {		\
+		.name = #__name,					\
+		.global = (__global),					\
+		.per_hart = (__per_hart),				\
+	}
+
+/** Heap size (in bytes) needed by the built-in subsystems for a HART count */
+unsigned long sbi_heap_size_estimate(u32 hart_count);
+
 /** Initialize heap area */
 int sbi_heap_init(struct sbi_scratch *scratch);
 
@@ -36,4 +36,30 @@ void __sbi_hfence_vvma_va(unsigned long va);
 /** Invalidate all possible Stage2 TLBs */
 void __sbi_hfence_vvma_all(void);
 
+/*
+ * Svinval based invalidation of all pages in [start, start + size) using
+ * a single pair of SFENCE.W.INVAL and SFENCE.INVAL.IR
+ */
+
+/** Invalidate TLB entries of all ASIDs for given virtual address range */
+void __sbi_sinval_vma_range(unsigned long start, unsigned long size);
+
+/** Invalidate TLB entries for given ASID and virtual address range */
+void __sbi_sinval_vma_asid_range(unsigned long start, unsigned long size,
+				 unsigned long asid);
+
+/** Invalidate unified TLB entries for given guest virtual address range */
+void __sbi_hinval_vvma_range(unsigned long start, unsigned long size);
+
+/** Invalidate unified TLB entries for given ASID and guest virtual range */
+void __sbi_hinval_vvma_asid_range(unsigned long start, unsigned long size,
+				  unsigned long asid);
+
+/** Invalidate Stage2 TLBs for given guest physical address range */
+void __sbi_hinval_gvma_range(unsigned long start, unsigned long size);
+
+/** Invalidate Stage2 TLBs for given VMID and guest physical address range */
+void __sbi_hinval_gvma_vmid_range(unsigned long start, unsigned long size,
+				  unsigned long vmid);
+
 #endif
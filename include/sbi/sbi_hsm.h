@@ -49,6 +49,48 @@ struct sbi_hsm_device {
 	 * non-retentive suspend.
 	 */
 	void (*hart_resume)(void);
+
+	/**
+	 * Get the cluster (or power domain) of the given hart.
+	 *
+	 * Clusters are numbered from zero. This is required for the cluster
+	 * suspend callbacks below.
+	 */
+	u32 (*hart_cluster)(u32 hartid);
+
+	/**
+	 * Put the cluster of the current hart in a platform specific
+	 * non-retentive suspend state.
+	 *
+	 * This is called instead of hart_suspend() on the last hart of a
+	 * cluster entering non-retentive suspend, when all other harts of
+	 * the cluster are already in non-retentive suspend. The platform
+	 * must abort the cluster power down if any hart of the cluster is
+	 * running again (for example, woken up by an interrupt).
+	 */
+	int (*cluster_suspend)(u32 suspend_type);
+
+	/**
+	 * Restore the cluster state lost during cluster suspend.
+	 *
+	 * This is called on the first hart of a cluster resuming from
+	 * non-retentive suspend after cluster_suspend() was attempted.
+	 */
+	void (*cluster_resume)(void);
+
+	/**
+	 * Park the current stopped hart in a platform specific deep idle
+	 * state, such as clock or power gated with only a dedicated wake
+	 * source armed.
+	 *
+	 * This replaces the WFI loop of stopped harts which are not powered
+	 * down by hart_stop(), with IPIs left disabled. The call returns when
+	 * hart_unpark() wakes up the hart and may also return spuriously.
+	 */
+	void (*hart_park)(void);
+
+	/** Wake up the given hart from hart_park() */
+	int (*hart_unpark)(u32 hartid);
 };
 
 struct sbi_domain;
@@ -64,6 +106,10 @@ void __noreturn sbi_hsm_exit(struct sbi_scratch *scratch);
 int sbi_hsm_hart_start(struct sbi_scratch *scratch,
 		       const struct sbi_domain *dom,
 		       u32 hartid, ulong saddr, ulong smode, ulong arg1);
+int sbi_hsm_hart_start_many(struct sbi_scratch *scratch,
+			    const struct sbi_domain *dom,
+			    ulong hmask, ulong hbase, ulong saddr,
+			    ulong smode, ulong arg1, ulong *out_started);
 int sbi_hsm_hart_stop(struct sbi_scratch *scratch, bool exitnow);
 void sbi_hsm_hart_resume_start(struct sbi_scratch *scratch);
 void __noreturn sbi_hsm_hart_resume_finish(struct sbi_scratch *scratch,
@@ -74,6 +120,9 @@ bool sbi_hsm_hart_change_state(struct sbi_scratch *scratch, long oldstate,
 			       long newstate);
 int __sbi_hsm_hart_get_state(u32 hartid);
 int sbi_hsm_hart_get_state(const struct sbi_domain *dom, u32 hartid);
+int sbi_hsm_hart_get_states(const struct sbi_domain *dom, ulong hbase,
+			    ulong count, unsigned long addr_lo,
+			    unsigned long addr_hi, unsigned long *out_count);
 int sbi_hsm_hart_interruptible_mask(const struct sbi_domain *dom,
 				    ulong hbase, ulong *out_hmask);
 void __sbi_hsm_suspend_non_ret_save(struct sbi_scratch *scratch);
@@ -0,0 +1,70 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_HSM_IDLE_STATS_H__
+#define __SBI_HSM_IDLE_STATS_H__
+
+#include <sbi/sbi_types.h>
+
+struct sbi_scratch;
+
+/** Maximum number of suspend types tracked per HART */
+#define SBI_HSM_IDLE_STATS_MAX_ENTRIES		8
+
+/**
+ * Idle statistics of one suspend type
+ *
+ * All times are in timer ticks. The entry latency is the time from the
+ * suspend call to the platform suspend and the exit latency is the time
+ * from wake-up (return of the platform suspend or warm boot entry) to
+ * the return to S-mode. The residency is the time spent in between.
+ * This layout is also used for the shared memory snapshot.
+ */
+struct sbi_hsm_idle_stats_entry {
+	u32 suspend_type;
+	u32 reserved;
+	u64 count;
+	u64 residency;
+	u64 entry_latency;
+	u64 exit_latency;
+	u64 max_exit_latency;
+} __packed;
+
+#ifdef CONFIG_SBI_HSM_IDLE_STATS
+
+void sbi_hsm_idle_stats_enter(struct sbi_scratch *scratch, u32 suspend_type);
+
+void sbi_hsm_idle_stats_suspend(struct sbi_scratch *scratch);
+
+void sbi_hsm_idle_stats_wake(struct sbi_scratch *scratch);
+
+void sbi_hsm_idle_stats_exit(struct sbi_scratch *scratch, bool resumed);
+
+int sbi_hsm_idle_stats_read(u32 hartid, unsigned long addr_lo,
+			    unsigned long addr_hi, unsigned long size,
+			    unsigned long flags, unsigned long *out_count);
+
+void sbi_hsm_idle_stats_dump(struct sbi_scratch *scratch);
+
+int sbi_hsm_idle_stats_init(void);
+
+#else
+
+static inline void sbi_hsm_idle_stats_enter(struct sbi_scratch *scratch,
+					    u32 suspend_type) { }
+
+static inline void sbi_hsm_idle_stats_suspend(struct sbi_scratch *scratch) { }
+
+static inline void sbi_hsm_idle_stats_wake(struct sbi_scratch *scratch) { }
+
+static inline void sbi_hsm_idle_stats_exit(struct sbi_scratch *scratch,
+					   bool resumed) { }
+
+static inline void sbi_hsm_idle_stats_dump(struct sbi_scratch *scratch) { }
+
+static inline int sbi_hsm_idle_stats_init(void) { return 0; }
+
+#endif
+
+#endif
@@ -13,6 +13,21 @@
 #include <sbi/sbi_types.h>
 
 struct sbi_trap_context;
+struct sbi_trap_regs;
+
+/** Register a hook for every funct3 value of a major opcode */
+#define SBI_ILLEGAL_INSN_FUNCT3_ANY	-1
+
+/**
+ * Platform specific illegal instruction emulation hook
+ *
+ * The hook must return SBI_ENOTSUPP if it does not handle given
+ * instruction so that the default emulation is used instead.
+ */
+typedef int (*sbi_illegal_insn_hook)(ulong insn, struct sbi_trap_regs *regs);
+
+int sbi_illegal_insn_register(u32 opcode, int funct3,
+			      sbi_illegal_insn_hook hook);
 
 int sbi_illegal_insn_handler(struct sbi_trap_context *tcntx);
 
@@ -10,10 +10,36 @@
 #ifndef __SBI_INIT_H__
 #define __SBI_INIT_H__
 
+#include <sbi/riscv_atomic.h>
 #include <sbi/sbi_types.h>
 
 struct sbi_scratch;
 
+/** Coldboot work split over the HARTs waiting for the coldboot HART */
+struct sbi_init_work {
+	/** Process one item of the work, returns 0 on success */
+	int (*process)(struct sbi_init_work *work, u32 index);
+	/** Number of items of the work */
+	u32 count;
+	/** Private data of the work owner */
+	void *priv;
+	/* Internal state of sbi_init_work_run() */
+	atomic_t next;
+	atomic_t done;
+	int error;
+};
+
+/**
+ * Process all items of a coldboot work
+ *
+ * The items are processed in any order by the coldboot HART and by the
+ * non-coldboot HARTs which already finished their early initialization.
+ * Only the coldboot HART may call this before the domains are finalized.
+ *
+ * @return 0 on success and the error of a failed item otherwise
+ */
+int sbi_init_work_run(struct sbi_init_work *work);
+
 void __noreturn sbi_init(struct sbi_scratch *scratch);
 
 unsigned long sbi_entry_count(u32 hartid);
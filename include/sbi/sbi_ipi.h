@@ -18,6 +18,8 @@
 
 /* clang-format on */
 
+struct sbi_hartmask;
+
 /** IPI hardware device */
 struct sbi_ipi_device {
 	/** Name of the IPI device */
@@ -26,6 +28,24 @@ struct sbi_ipi_device {
 	/** Send IPI to a target HART index */
 	void (*ipi_send)(u32 hart_index);
 
+	/**
+	 * Send IPI to all HART indexes in a hartmask
+	 * Note: This is an optional callback, ipi_send() is called
+	 * for each HART index when it is not provided.
+	 */
+	void (*ipi_send_mask)(const struct sbi_hartmask *mask);
+
+	/**
+	 * Number of IPI events which have a dedicated doorbell on the
+	 * device. IPI events below this number are sent using the
+	 * ipi_send_event() callback and the receiving HART handles
+	 * them by calling sbi_ipi_process_event().
+	 */
+	u32 ipi_event_count;
+
+	/** Send a dedicated IPI event to a target HART index */
+	void (*ipi_send_event)(u32 hart_index, u32 event);
+
 	/** Clear IPI for a target HART index */
 	void (*ipi_clear)(u32 hart_index);
 };
@@ -85,10 +105,24 @@ int sbi_ipi_send_halt(ulong hmask, ulong hbase);
 
 void sbi_ipi_process(void);
 
+void sbi_ipi_process_event(u32 event);
+
 int sbi_ipi_raw_send(u32 hartindex);
 
+int sbi_ipi_raw_send_mask(const struct sbi_hartmask *mask);
+
 void sbi_ipi_raw_clear(u32 hartindex);
 
+#ifdef CONFIG_SBI_IPI_FORWARD
+void sbi_ipi_set_forward_cluster(u32 harts);
+
+void sbi_ipi_forward_process(void);
+#else
+static inline void sbi_ipi_set_forward_cluster(u32 harts) { }
+
+static inline void sbi_ipi_forward_process(void) { }
+#endif
+
 const struct sbi_ipi_device *sbi_ipi_get_device(void);
 
 void sbi_ipi_set_device(const struct sbi_ipi_device *dev);
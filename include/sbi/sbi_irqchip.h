@@ -10,10 +10,52 @@
 #ifndef __SBI_IRQCHIP_H__
 #define __SBI_IRQCHIP_H__
 
+#include <sbi/sbi_list.h>
 #include <sbi/sbi_types.h>
 
 struct sbi_scratch;
 
+/** Number of external interrupt identities which can have a handler */
+#define SBI_IRQCHIP_MAX_HWIRQ		1024
+
+/**
+ * Handler of an M-mode external interrupt
+ *
+ * @param hwirq interrupt identity of the M-mode interrupt controller
+ * @param priv private data given at registration
+ * @return 0 on success and negative error code on failure
+ */
+typedef int (*sbi_irqchip_handler)(u32 hwirq, void *priv);
+
+/**
+ * Register a handler for an M-mode external interrupt
+ *
+ * The interrupt identity is the one of the M-mode interrupt controller
+ * (PLIC source or IMSIC identity). Enabling the source on the interrupt
+ * controller is left to the caller.
+ *
+ * @param hwirq interrupt identity
+ * @param handler handler function
+ * @param priv private data passed to the handler
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_irqchip_register_handler(u32 hwirq, sbi_irqchip_handler handler,
+				 void *priv);
+
+/** Unregister the handler of an M-mode external interrupt */
+void sbi_irqchip_unregister_handler(u32 hwirq);
+
+/**
+ * Call the handler registered for an M-mode external interrupt
+ *
+ * This function is called by interrupt controller drivers from their
+ * claim loop for every claimed interrupt.
+ *
+ * @param hwirq interrupt identity
+ * @return SBI_ENOENT if no handler is registered otherwise handler result
+ */
+int sbi_irqchip_handle_hwirq(u32 hwirq);
+
 /**
  * Set external interrupt handling function
  *
@@ -34,6 +76,25 @@ void sbi_irqchip_set_irqfn(int (*fn)(void));
  */
 int sbi_irqchip_process(void);
 
+/** Interrupt controller instance whose state can be lost in system suspend */
+struct sbi_irqchip_pm {
+	/** List head for the registration */
+	struct sbi_dlist node;
+	/** Save the state before the system suspends (optional) */
+	void (*suspend)(struct sbi_irqchip_pm *pm);
+	/** Restore the state after the system resumes, if lost */
+	void (*resume)(struct sbi_irqchip_pm *pm);
+};
+
+/** Register an interrupt controller instance for system suspend */
+void sbi_irqchip_add_pm(struct sbi_irqchip_pm *pm);
+
+/** Called on the suspending HART right before the system suspends */
+void sbi_irqchip_system_suspend(void);
+
+/** Called on the resuming HART right after the system resumed */
+void sbi_irqchip_system_resume(void);
+
 /** Initialize interrupt controllers */
 int sbi_irqchip_init(struct sbi_scratch *scratch, bool cold_boot);
 
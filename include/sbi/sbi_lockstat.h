@@ -0,0 +1,85 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_LOCKSTAT_H__
+#define __SBI_LOCKSTAT_H__
+
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_types.h>
+
+/**
+ * Contention statistics of a named spinlock
+ *
+ * The statistics of several locks of the same kind, such as the per-HART
+ * instances of a lock, can be accumulated under one name. The spin cycles
+ * only count contended acquisitions.
+ */
+struct sbi_lockstat {
+	const char *name;
+	/* Lock known at build time, the others are added at runtime */
+	spinlock_t *lock;
+	unsigned long acquired;
+	unsigned long contended;
+	u64 spin_cycles;
+	u64 max_spin_cycles;
+};
+
+/** Length of the lock names in the shared memory copy */
+#define SBI_LOCKSTAT_NAME_LEN		32
+
+/** Layout of the statistics of one lock in shared memory */
+struct sbi_lockstat_entry {
+	char name[SBI_LOCKSTAT_NAME_LEN];
+	u64 acquired;
+	u64 contended;
+	u64 spin_cycles;
+	u64 max_spin_cycles;
+} __packed;
+
+#ifdef CONFIG_SBI_LOCKSTAT
+
+/**
+ * Define the statistics of a named lock
+ *
+ * @param __name name of the statistics
+ * @param __lock address of the lock or NULL for locks which are added
+ * with sbi_lockstat_track() once they exist
+ */
+#define SBI_LOCKSTAT_DEFINE(__name, __lock)				\
+	static struct sbi_lockstat __lockstat_##__name			\
+	__attribute__((used, section("sbi_lockstats"))) = {		\
+		.name = #__name,					\
+		.lock = (__lock),					\
+	}
+
+/** Account a lock to the statistics defined with SBI_LOCKSTAT_DEFINE() */
+#define sbi_lockstat_track(__name, __lock)				\
+	__sbi_lockstat_track(&__lockstat_##__name, (__lock))
+
+void __sbi_lockstat_track(struct sbi_lockstat *stat, spinlock_t *lock);
+
+void sbi_lockstat_acquired(spinlock_t *lock, bool contended, u64 cycles);
+
+int sbi_lockstat_read(unsigned long addr_lo, unsigned long addr_hi,
+		      unsigned long size, unsigned long flags,
+		      unsigned long *out_count);
+
+void sbi_lockstat_dump(void);
+
+int sbi_lockstat_init(void);
+
+#else
+
+#define SBI_LOCKSTAT_DEFINE(__name, __lock)				\
+	extern struct sbi_lockstat __lockstat_##__name
+
+#define sbi_lockstat_track(__name, __lock)	do { } while (0)
+
+static inline void sbi_lockstat_dump(void) { }
+
+static inline int sbi_lockstat_init(void) { return 0; }
+
+#endif
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_MISALIGNED_STATS_H__
+#define __SBI_MISALIGNED_STATS_H__
+
+#include <sbi/sbi_types.h>
+
+struct sbi_scratch;
+
+/** Maximum number of faulting mepc values tracked per HART */
+#define SBI_MISALIGNED_STATS_MAX_ENTRIES	16
+
+#define SBI_MISALIGNED_STATS_TYPE_LOAD		0
+#define SBI_MISALIGNED_STATS_TYPE_STORE		1
+
+/**
+ * Misaligned trap count of one mepc
+ *
+ * The count is an upper bound of the real count because the least
+ * frequent mepc is evicted and its count inherited when the table is
+ * full. This layout is also used for the shared memory snapshot.
+ */
+struct sbi_misaligned_stats_entry {
+	u64 mepc;
+	u64 count;
+	u32 type;
+	u32 reserved;
+} __packed;
+
+#ifdef CONFIG_SBI_MISALIGNED_STATS
+
+void sbi_misaligned_stats_record(unsigned long mepc, u32 type);
+
+int sbi_misaligned_stats_read(u32 hartid, unsigned long addr_lo,
+			      unsigned long addr_hi, unsigned long size,
+			      unsigned long flags, unsigned long *out_count);
+
+void sbi_misaligned_stats_dump(struct sbi_scratch *scratch);
+
+int sbi_misaligned_stats_init(void);
+
+#else
+
+static inline void sbi_misaligned_stats_record(unsigned long mepc,
+					       u32 type) { }
+
+static inline void sbi_misaligned_stats_dump(struct sbi_scratch *scratch) { }
+
+static inline int sbi_misaligned_stats_init(void) { return 0; }
+
+#endif
+
+#endif
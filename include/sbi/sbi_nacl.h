@@ -0,0 +1,38 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_NACL_H__
+#define __SBI_NACL_H__
+
+#include <sbi/sbi_types.h>
+
+struct sbi_scratch;
+struct sbi_trap_regs;
+
+#ifdef CONFIG_SBI_ECALL_NACL
+
+int sbi_nacl_probe_feature(unsigned long feature, unsigned long *out_val);
+
+int sbi_nacl_set_shmem(unsigned long addr_lo, unsigned long addr_hi,
+		       unsigned long flags);
+
+int sbi_nacl_sync_csr(unsigned long csr_num);
+
+int sbi_nacl_sync_hfence(unsigned long entry_index);
+
+/* Returns with the trap registers set up for the emulated SRET */
+int sbi_nacl_sync_sret(struct sbi_trap_regs *regs);
+
+int sbi_nacl_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#else
+
+static inline int sbi_nacl_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	return 0;
+}
+
+#endif
+
+#endif
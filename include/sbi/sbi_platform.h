@@ -31,14 +31,16 @@
 #define SBI_PLATFORM_HART_STACK_SIZE_OFFSET (0x54)
 /** Offset of heap_size in struct sbi_platform */
 #define SBI_PLATFORM_HEAP_SIZE_OFFSET (0x58)
-/** Offset of reserved in struct sbi_platform */
-#define SBI_PLATFORM_RESERVED_OFFSET (0x5c)
+/** Offset of hart_scratch_size in struct sbi_platform */
+#define SBI_PLATFORM_HART_SCRATCH_SIZE_OFFSET (0x5c)
 /** Offset of platform_ops_addr in struct sbi_platform */
 #define SBI_PLATFORM_OPS_OFFSET (0x60)
 /** Offset of firmware_context in struct sbi_platform */
 #define SBI_PLATFORM_FIRMWARE_CONTEXT_OFFSET (0x60 + __SIZEOF_POINTER__)
 /** Offset of hart_index2id in struct sbi_platform */
 #define SBI_PLATFORM_HART_INDEX2ID_OFFSET (0x60 + (__SIZEOF_POINTER__ * 2))
+/** Offset of hart_index2stack in struct sbi_platform */
+#define SBI_PLATFORM_HART_INDEX2STACK_OFFSET (0x60 + (__SIZEOF_POINTER__ * 3))
 
 #define SBI_PLATFORM_TLB_RANGE_FLUSH_LIMIT_DEFAULT		(1UL << 12)
 
@@ -74,6 +76,9 @@ struct sbi_platform_operations {
 	/* Check if specified HART is allowed to do cold boot */
 	bool (*cold_boot_allowed)(u32 hartid);
 
+	/* Get preferred cold boot HART id or -1U to use the lottery */
+	u32 (*cold_boot_hart)(void);
+
 	/* Platform nascent initialization */
 	int (*nascent_init)(void);
 
@@ -151,6 +156,11 @@ struct sbi_platform_operations {
 	/** platform specific handler to fixup store fault */
 	int (*emulate_store)(int wlen, unsigned long addr,
 			     union sbi_ldst_data in_val);
+
+	/** Set platform specific FWFT feature for current HART */
+	int (*fwft_set)(u32 feature, unsigned long value, unsigned long flags);
+	/** Get platform specific FWFT feature for current HART */
+	int (*fwft_get)(u32 feature, unsigned long *value);
 };
 
 /** Platform default per-HART stack size for exception/interrupt handling */
@@ -184,8 +194,8 @@ struct sbi_platform {
 	u32 hart_stack_size;
 	/** Size of heap shared by all HARTs */
 	u32 heap_size;
-	/** Reserved for future use */
-	u32 reserved;
+	/** Per-HART scratch space size (zero means SBI_SCRATCH_SIZE) */
+	u32 hart_scratch_size;
 	/** Pointer to sbi platform operations */
 	unsigned long platform_ops_addr;
 	/** Pointer to system firmware specific context */
@@ -206,6 +216,19 @@ struct sbi_platform {
 	 * 2. HART id < SBI_HARTMASK_MAX_BITS
 	 */
 	const u32 *hart_index2id;
+	/**
+	 * HART index to HART stack end address table
+	 *
+	 * For HART index <abc> placed by the platform:
+	 *     hart_index2stack[<abc>] = end address of the HART stack
+	 * For HART index <abc> in the default location:
+	 *     hart_index2stack[<abc>] = 0
+	 *
+	 * The scratch space of a HART is the last hart_scratch_size bytes
+	 * of its hart_stack_size sized stack. If hart_index2stack == NULL
+	 * then all HART stacks are placed right after the firmware.
+	 */
+	const unsigned long *hart_index2stack;
 };
 
 /**
@@ -242,6 +265,11 @@ _Static_assert(
 		== SBI_PLATFORM_HART_STACK_SIZE_OFFSET,
 	"struct sbi_platform definition has changed, please redefine "
 	"SBI_PLATFORM_HART_STACK_SIZE_OFFSET");
+_Static_assert(
+	offsetof(struct sbi_platform, hart_scratch_size)
+		== SBI_PLATFORM_HART_SCRATCH_SIZE_OFFSET,
+	"struct sbi_platform definition has changed, please redefine "
+	"SBI_PLATFORM_HART_SCRATCH_SIZE_OFFSET");
 _Static_assert(
 	offsetof(struct sbi_platform, platform_ops_addr)
 		== SBI_PLATFORM_OPS_OFFSET,
@@ -257,6 +285,11 @@ _Static_assert(
 		== SBI_PLATFORM_HART_INDEX2ID_OFFSET,
 	"struct sbi_platform definition has changed, please redefine "
 	"SBI_PLATFORM_HART_INDEX2ID_OFFSET");
+_Static_assert(
+	offsetof(struct sbi_platform, hart_index2stack)
+		== SBI_PLATFORM_HART_INDEX2STACK_OFFSET,
+	"struct sbi_platform definition has changed, please redefine "
+	"SBI_PLATFORM_HART_INDEX2STACK_OFFSET");
 
 /** Get pointer to sbi_platform for sbi_scratch pointer */
 #define sbi_platform_ptr(__s) \
@@ -371,6 +404,20 @@ static inline u32 sbi_platform_hart_stack_size(const struct sbi_platform *plat)
 	return 0;
 }
 
+/**
+ * Get per-HART scratch space size
+ *
+ * @param plat pointer to struct sbi_platform
+ *
+ * @return scratch space size in bytes
+ */
+static inline u32 sbi_platform_hart_scratch_size(const struct sbi_platform *plat)
+{
+	if (plat && plat->hart_scratch_size)
+		return plat->hart_scratch_size;
+	return SBI_SCRATCH_SIZE;
+}
+
 /**
  * Check whether given HART is allowed to do cold boot
  *
@@ -388,6 +435,21 @@ static inline bool sbi_platform_cold_boot_allowed(
 	return true;
 }
 
+/**
+ * Get the HART which should do cold boot
+ *
+ * @param plat pointer to struct sbi_platform
+ *
+ * @return preferred cold boot HART ID or -1U if any HART allowed to do
+ * cold boot may win the cold boot lottery
+ */
+static inline u32 sbi_platform_cold_boot_hart(const struct sbi_platform *plat)
+{
+	if (plat && sbi_platform_ops(plat)->cold_boot_hart)
+		return sbi_platform_ops(plat)->cold_boot_hart();
+	return -1U;
+}
+
 /**
  * Nascent (very early) initialization for current HART
  *
@@ -739,6 +801,44 @@ static inline int sbi_platform_emulate_store(const struct sbi_platform *plat,
 	return SBI_ENOTSUPP;
 }
 
+/**
+ * Set a platform specific FWFT feature for current HART
+ *
+ * @param plat pointer to struct sbi_platform
+ * @param feature FWFT feature ID within the local platform range
+ * @param value new value of the feature
+ * @param flags SBI_FWFT_SET_FLAG_xyz flags
+ *
+ * @return 0 on success, SBI_EDENIED if the feature is not implemented
+ * and other negative error code on failure
+ */
+static inline int sbi_platform_fwft_set(const struct sbi_platform *plat,
+					u32 feature, unsigned long value,
+					unsigned long flags)
+{
+	if (plat && sbi_platform_ops(plat)->fwft_set)
+		return sbi_platform_ops(plat)->fwft_set(feature, value, flags);
+	return SBI_EDENIED;
+}
+
+/**
+ * Get a platform specific FWFT feature for current HART
+ *
+ * @param plat pointer to struct sbi_platform
+ * @param feature FWFT feature ID within the local platform range
+ * @param value output value of the feature
+ *
+ * @return 0 on success, SBI_EDENIED if the feature is not implemented
+ * and other negative error code on failure
+ */
+static inline int sbi_platform_fwft_get(const struct sbi_platform *plat,
+					u32 feature, unsigned long *value)
+{
+	if (plat && sbi_platform_ops(plat)->fwft_get)
+		return sbi_platform_ops(plat)->fwft_get(feature, value);
+	return SBI_EDENIED;
+}
+
 #endif
 
 #endif
@@ -23,6 +23,8 @@ struct sbi_scratch;
 #define SBI_PMU_FW_CTR_MAX 16
 #define SBI_PMU_HW_CTR_MAX 32
 #define SBI_PMU_CTR_MAX	   (SBI_PMU_HW_CTR_MAX + SBI_PMU_FW_CTR_MAX)
+/* Maximum number of events multiplexed by the firmware on a HART */
+#define SBI_PMU_MUX_MAX_EVENTS 32
 #define SBI_PMU_FIXED_CTR_MASK 0x07
 #define SBI_PMU_CY_IR_MASK	0x05
 
@@ -92,6 +94,12 @@ struct sbi_pmu_device {
 	 */
 	int (*hw_counter_irq_bit)(void);
 
+	/**
+	 * Custom function returning the overflow status of all hardware
+	 * counters at once where bit i is set if counter i has overflowed.
+	 */
+	unsigned long (*hw_counter_overflow_status)(void);
+
 	/**
 	 * Custom function to inhibit counting of events while in
 	 * specified mode.
@@ -111,6 +119,9 @@ int sbi_pmu_init(struct sbi_scratch *scratch, bool cold_boot);
 /** Reset PMU during hart exit */
 void sbi_pmu_exit(struct sbi_scratch *scratch);
 
+/** Restore PMU configuration lost by a non-retentive suspend */
+void sbi_pmu_resume(struct sbi_scratch *scratch);
+
 /** Return the pmu irq bit depending on extension existence */
 int sbi_pmu_irq_bit(void);
 
@@ -143,14 +154,44 @@ int sbi_pmu_ctr_start(unsigned long cidx_base, unsigned long cidx_mask,
 
 int sbi_pmu_ctr_get_info(uint32_t cidx, unsigned long *ctr_info);
 
+/**
+ * Set or clear the shared memory used to take counter snapshots on the
+ * calling HART.
+ * @param shmem_lo lower XLEN bits of the 4KB aligned shared memory address
+ * @param shmem_hi upper XLEN bits of the shared memory address
+ * @param flags must be zero
+ * @return 0 on success, error otherwise.
+ */
+int sbi_pmu_snapshot_set_shmem(unsigned long shmem_lo,
+			       unsigned long shmem_hi, unsigned long flags);
+
 unsigned long sbi_pmu_num_ctr(void);
 
 int sbi_pmu_ctr_cfg_match(unsigned long cidx_base, unsigned long cidx_mask,
 			  unsigned long flags, unsigned long event_idx,
 			  uint64_t event_data);
 
+int sbi_pmu_ctr_add_fw(enum sbi_pmu_fw_event_code_id fw_id,
+		       unsigned long count);
+
 int sbi_pmu_ctr_incr_fw(enum sbi_pmu_fw_event_code_id fw_id);
 
 void sbi_pmu_ovf_irq();
 
+/**
+ * Set or clear the group of hardware events multiplexed by the firmware
+ * on the calling HART. The events are rotated over the programmable
+ * counters not used by S-mode and the counts are written back to the
+ * shared memory on every rotation.
+ * @param shmem_lo lower XLEN bits of the 8 byte aligned shared memory address
+ * @param shmem_hi upper XLEN bits of the shared memory address
+ * @param count number of events in the shared memory or zero to clear
+ * @param period_us rotation period in microseconds
+ * @param flags SBI_PMU_CFG_FLAG_SET_xINH inhibit flags for all events
+ * @return 0 on success, error otherwise.
+ */
+int sbi_pmu_mux_set(unsigned long shmem_lo, unsigned long shmem_hi,
+		    unsigned long count, unsigned long period_us,
+		    unsigned long flags);
+
 #endif
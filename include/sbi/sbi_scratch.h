@@ -44,8 +44,14 @@
 #define SBI_SCRATCH_OPTIONS_OFFSET		(13 * __SIZEOF_POINTER__)
 /** Offset of extra space in sbi_scratch */
 #define SBI_SCRATCH_EXTRA_SPACE_OFFSET		(14 * __SIZEOF_POINTER__)
-/** Maximum size of sbi_scratch (4KB) */
+/** Default size of sbi_scratch (4KB) */
 #define SBI_SCRATCH_SIZE			(0x1000)
+/** Cache line size assumed for the cache line aligned allocations */
+#define SBI_SCRATCH_CACHE_LINE_SIZE		64
+/** Offset of per-HART variables in sbi_scratch */
+#define SBI_SCRATCH_VARS_OFFSET					\
+	((SBI_SCRATCH_EXTRA_SPACE_OFFSET + SBI_SCRATCH_CACHE_LINE_SIZE - 1) & \
+	 ~(SBI_SCRATCH_CACHE_LINE_SIZE - 1))
 
 /* clang-format on */
 
@@ -151,6 +157,8 @@ enum sbi_scratch_options {
 	SBI_SCRATCH_NO_BOOT_PRINTS = (1 << 0),
 	/** Enable runtime debug prints */
 	SBI_SCRATCH_DEBUG_PRINTS = (1 << 1),
+	/** FDT already verified by the previous booting stage */
+	SBI_SCRATCH_FDT_TRUSTED = (1 << 2),
 };
 
 /** Get pointer to sbi_scratch for current HART */
@@ -172,12 +180,28 @@ int sbi_scratch_init(struct sbi_scratch *scratch);
  */
 unsigned long sbi_scratch_alloc_offset(unsigned long size);
 
+/**
+ * Allocate from extra space in sbi_scratch such that the allocation
+ * starts at a cache line boundary and no other allocation shares its
+ * cache lines. This is meant for per-HART data written by remote HARTs.
+ *
+ * @return zero on failure and non-zero (>= SBI_SCRATCH_EXTRA_SPACE_OFFSET)
+ * on success
+ */
+unsigned long sbi_scratch_alloc_cacheline_offset(unsigned long size);
+
 /** Free-up extra space in sbi_scratch */
 void sbi_scratch_free_offset(unsigned long offset);
 
 /** Amount (in bytes) of used space in in sbi_scratch */
 unsigned long sbi_scratch_used_space(void);
 
+/** Size (in bytes) of sbi_scratch of each HART */
+unsigned long sbi_scratch_size(void);
+
+/** Get the offsets and sizes of cache line aligned allocations as string */
+void sbi_scratch_get_cacheline_str(char *str, int nstr);
+
 /** Get pointer from offset in sbi_scratch */
 #define sbi_scratch_offset_ptr(scratch, offset)	(void *)((char *)(scratch) + (offset))
 
@@ -189,6 +213,10 @@ unsigned long sbi_scratch_used_space(void);
 #define sbi_scratch_alloc_type_offset(__type)				\
 	sbi_scratch_alloc_offset(sizeof(__type))
 
+/** Allocate cache line aligned offset for a data type in sbi_scratch */
+#define sbi_scratch_alloc_type_cacheline_offset(__type)		\
+	sbi_scratch_alloc_cacheline_offset(sizeof(__type))
+
 /** Read a data type from sbi_scratch at given offset */
 #define sbi_scratch_read_type(__scratch, __type, __offset)		\
 ({									\
@@ -202,6 +230,35 @@ do {									\
 					= (__type)(__ptr);		\
 } while (0)
 
+/** Initial values of the per-HART variables (provided by the linker) */
+extern char __start_sbi_scratch_vars[] __attribute__((visibility("hidden")));
+extern char __stop_sbi_scratch_vars[] __attribute__((visibility("hidden")));
+
+/**
+ * Define a per-HART variable
+ *
+ * Every HART has its own copy of the variable at a fixed offset in its
+ * sbi_scratch, initialized from the definition by sbi_scratch_init().
+ * The definition itself only holds the initial value so the variable
+ * must be accessed using sbi_scratch_var_ptr().
+ */
+#define SBI_SCRATCH_DEFINE(__type, __name)				\
+	__type __name __attribute__((section("sbi_scratch_vars")))
+
+/** Get offset of a per-HART variable in sbi_scratch */
+#define sbi_scratch_var_offset(__name)					\
+	(SBI_SCRATCH_VARS_OFFSET + ((unsigned long)&(__name) -		\
+				    (unsigned long)__start_sbi_scratch_vars))
+
+/** Get pointer to a per-HART variable in sbi_scratch */
+#define sbi_scratch_var_ptr(__scratch, __name)				\
+	((__typeof__(&(__name)))sbi_scratch_offset_ptr((__scratch),	\
+					sbi_scratch_var_offset(__name)))
+
+/** Get pointer to a per-HART variable for current HART */
+#define sbi_scratch_thishart_var_ptr(__name)				\
+	sbi_scratch_var_ptr(sbi_scratch_thishart_ptr(), __name)
+
 /** Last HART index having a sbi_scratch pointer */
 extern u32 last_hartindex_having_scratch;
 
@@ -225,11 +282,21 @@ extern u32 hartindex_to_hartid_table[];
 /** HART index to scratch table */
 extern struct sbi_scratch *hartindex_to_scratch_table[];
 
+/** Scratch space address of HART index 0 for a regular layout */
+extern unsigned long hartindex_to_scratch_base;
+
+/** Log2 stride of a regular scratch space layout (zero otherwise) */
+extern unsigned long hartindex_to_scratch_shift;
+
 /** Get sbi_scratch from HART index */
 #define sbi_hartindex_to_scratch(__hartindex)		\
 ({							\
 	((__hartindex) <= sbi_scratch_last_hartindex()) ?\
-	hartindex_to_scratch_table[__hartindex] : NULL;\
+	(hartindex_to_scratch_shift ?			\
+	 (struct sbi_scratch *)(hartindex_to_scratch_base -\
+		((unsigned long)(__hartindex) <<	\
+		 hartindex_to_scratch_shift)) :		\
+	 hartindex_to_scratch_table[__hartindex]) : NULL;\
 })
 
 /**
@@ -0,0 +1,51 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_STA_H__
+#define __SBI_STA_H__
+
+#include <sbi/sbi_types.h>
+
+/** Layout of the STA shared memory, all fields are little endian */
+struct sbi_sta_shmem {
+	u32 sequence;
+	u32 flags;
+	u64 steal;
+	u8 preempted;
+	u8 pad[47];
+} __packed;
+
+/**
+ * Steal-time accounting state of one HART in one supervisor domain. The
+ * time spent by the HART in other domains is accounted as stolen.
+ */
+struct sbi_sta_context {
+	/** Address of the shared memory registered by the domain */
+	unsigned long shmem;
+	/** Time value when the domain was switched out of the HART */
+	u64 switch_out_time;
+	/** Is the shared memory registered */
+	bool enabled;
+};
+
+#ifdef CONFIG_SBI_ECALL_STA
+
+int sbi_sta_set_shmem(unsigned long addr_lo, unsigned long addr_hi,
+		      unsigned long flags);
+
+/** Mark the domain of ctx preempted while the HART runs another domain */
+void sbi_sta_switch_out(struct sbi_sta_context *ctx);
+
+/** Account the time since sbi_sta_switch_out() as stolen from ctx */
+void sbi_sta_switch_in(struct sbi_sta_context *ctx);
+
+#else
+
+static inline void sbi_sta_switch_out(struct sbi_sta_context *ctx) { }
+
+static inline void sbi_sta_switch_in(struct sbi_sta_context *ctx) { }
+
+#endif
+
+#endif
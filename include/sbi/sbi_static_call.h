@@ -0,0 +1,84 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_STATIC_CALL_H__
+#define __SBI_STATIC_CALL_H__
+
+#include <sbi/riscv_barrier.h>
+#include <sbi/sbi_const.h>
+#include <sbi/sbi_types.h>
+
+#define __SBI_STATIC_CALL_TRAMP(name)	__sbi_static_call_tramp_##name
+#define __SBI_STATIC_CALL_PTR(name)	__sbi_static_call_ptr_##name
+#define __SBI_STATIC_CALL_DEFAULT(name)	__sbi_static_call_default_##name
+
+#ifdef CONFIG_SBI_STATIC_CALL
+
+/*
+ * Each static call has a trampoline of two instructions in the firmware
+ * text, initially jumping to the default function. Callers make a direct
+ * call to the trampoline which sbi_static_call_update() rewrites into a
+ * direct jump to the new function.
+ *
+ * The default function must be defined in the same file as the static
+ * call, it is also the target when the static call is updated to NULL.
+ */
+#define SBI_STATIC_CALL_DEFINE(name, func)				\
+	__asm__("	.pushsection .text, \"ax\"\n"			\
+		"	.balign 4\n"					\
+		STRINGIFY(__SBI_STATIC_CALL_TRAMP(name)) ":\n"		\
+		"	.option push\n"				\
+		"	.option norvc\n"				\
+		"	.option norelax\n"				\
+		"	jal zero, " #func "\n"				\
+		"	nop\n"						\
+		"	.option pop\n"					\
+		"	.popsection\n");				\
+	extern typeof(func) __SBI_STATIC_CALL_TRAMP(name)		\
+		__attribute__((visibility("hidden")));			\
+	static typeof(func) *const __SBI_STATIC_CALL_DEFAULT(name)	\
+		__attribute__((used)) = func
+
+#define sbi_static_call(name)		__SBI_STATIC_CALL_TRAMP(name)
+
+#define sbi_static_call_update(name, func)				\
+	__sbi_static_call_update((void *)__SBI_STATIC_CALL_TRAMP(name),	\
+		(void *)((func) ? (func) : __SBI_STATIC_CALL_DEFAULT(name)))
+
+/**
+ * Rewrite a static call trampoline into a jump to a function
+ *
+ * The other HARTs must not be running the trampoline, they pick up the
+ * new target with sbi_static_call_sync() when they are initialized.
+ *
+ * @param tramp address of the trampoline
+ * @param func address of the new target
+ */
+void __sbi_static_call_update(void *tramp, void *func);
+
+/** Drop the trampolines fetched before the coldboot HART patched them */
+static inline void sbi_static_call_sync(void)
+{
+	RISCV_FENCE_I;
+}
+
+#else
+
+/* Without patching, a static call is a plain call through a pointer */
+#define SBI_STATIC_CALL_DEFINE(name, func)				\
+	static typeof(func) *const __SBI_STATIC_CALL_DEFAULT(name)	\
+		__attribute__((used)) = func;				\
+	static typeof(func) *__SBI_STATIC_CALL_PTR(name) = func
+
+#define sbi_static_call(name)		(*__SBI_STATIC_CALL_PTR(name))
+
+#define sbi_static_call_update(name, func)				\
+	(__SBI_STATIC_CALL_PTR(name) = (func) ? (func) :		\
+				       __SBI_STATIC_CALL_DEFAULT(name))
+
+static inline void sbi_static_call_sync(void) { }
+
+#endif
+
+#endif
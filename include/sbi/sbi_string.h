@@ -43,4 +43,6 @@ int sbi_memcmp(const void *s1, const void *s2, size_t count);
 
 void *sbi_memchr(const void *s, int c, size_t count);
 
+unsigned long sbi_strtoul(const char *str, char **endptr, int base);
+
 #endif
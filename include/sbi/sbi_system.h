@@ -43,6 +43,9 @@ bool sbi_system_reset_supported(u32 reset_type, u32 reset_reason);
 
 void __noreturn sbi_system_reset(u32 reset_type, u32 reset_reason);
 
+/** Acknowledge a HALT sent by sbi_system_reset() on the given HART */
+void sbi_system_reset_halt_ack(u32 hartindex);
+
 /** System suspend device */
 struct sbi_system_suspend_device {
 	/** Name of the system suspend device */
@@ -77,4 +80,7 @@ void sbi_system_suspend_test_enable(void);
 bool sbi_system_suspend_supported(u32 sleep_type);
 int sbi_system_suspend(u32 sleep_type, ulong resume_addr, ulong opaque);
 
+/** Restore the device state lost in system suspend on the resuming HART */
+void sbi_system_resume(void);
+
 #endif
@@ -10,6 +10,7 @@
 #ifndef __SBI_TIMER_H__
 #define __SBI_TIMER_H__
 
+#include <sbi/sbi_error.h>
 #include <sbi/sbi_types.h>
 
 /** Timer hardware device */
@@ -23,6 +24,12 @@ struct sbi_timer_device {
 	/** Get free-running timer value */
 	u64 (*timer_value)(void);
 
+	/**
+	 * Get address of the free-running timer of current HART which can
+	 * be read with a single 64-bit load (optional)
+	 */
+	volatile u64 *(*timer_value_addr)(void);
+
 	/** Start timer event for current HART */
 	void (*timer_event_start)(u64 next_event);
 
@@ -87,6 +94,37 @@ void sbi_timer_event_start(u64 next_event);
 /** Process timer event for current HART */
 void sbi_timer_process(void);
 
+/** Maximum number of firmware timer events queued per HART */
+#define SBI_TIMER_EVENT_MAX		16
+
+/** Firmware (M-mode) timer event */
+struct sbi_timer_event {
+	/** Absolute deadline in timer ticks */
+	u64 deadline;
+	/** Called from the timer interrupt once the deadline is reached */
+	void (*callback)(struct sbi_timer_event *ev);
+	/** Private data of the event owner */
+	void *priv;
+	/* Private members of the timer event multiplexer */
+	bool queued;
+	u32 heap_index;
+};
+
+#ifdef CONFIG_SBI_TIMER_EVENTS
+/** Queue a firmware timer event on current HART */
+int sbi_timer_event_add(struct sbi_timer_event *ev);
+
+/** Remove a firmware timer event queued on current HART */
+void sbi_timer_event_cancel(struct sbi_timer_event *ev);
+#else
+static inline int sbi_timer_event_add(struct sbi_timer_event *ev)
+{
+	return SBI_ENOTSUPP;
+}
+
+static inline void sbi_timer_event_cancel(struct sbi_timer_event *ev) { }
+#endif
+
 /** Get current timer device */
 const struct sbi_timer_device *sbi_timer_get_device(void);
 
@@ -18,6 +18,9 @@
 
 #define SBI_TLB_FLUSH_ALL			((unsigned long)-1)
 
+/** Maximum number of requests in one batched TLB request */
+#define SBI_TLB_BATCH_MAX			16
+
 /* clang-format on */
 
 struct sbi_scratch;
@@ -30,6 +33,7 @@ enum sbi_tlb_type {
 	SBI_TLB_HFENCE_GVMA,
 	SBI_TLB_HFENCE_VVMA_ASID,
 	SBI_TLB_HFENCE_VVMA,
+	SBI_TLB_BATCH,
 	SBI_TLB_TYPE_MAX,
 };
 
@@ -56,6 +60,21 @@ do { \
 
 int sbi_tlb_request(ulong hmask, ulong hbase, struct sbi_tlb_info *tinfo);
 
+#ifdef CONFIG_SBI_RFENCE_BATCH
+/**
+ * Get the batch buffer of the current HART
+ *
+ * The buffer has SBI_TLB_BATCH_MAX entries and is filled by the caller
+ * before calling sbi_tlb_request_batch().
+ */
+struct sbi_tlb_info *sbi_tlb_batch_entries(void);
+
+int sbi_tlb_request_batch(ulong hmask, ulong hbase, unsigned long count);
+#endif
+
+/** Process one TLB request on the current HART only */
+void sbi_tlb_local_process(struct sbi_tlb_info *tinfo);
+
 int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot);
 
 #endif
@@ -0,0 +1,61 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_TRACE_H__
+#define __SBI_TRACE_H__
+
+#include <sbi/sbi_types.h>
+
+/** Events recorded in the firmware trace */
+enum sbi_trace_event {
+	/** Trap taken, arg0 is mcause and arg1 is mepc */
+	SBI_TRACE_TRAP = 1,
+	/** Ecall handled, arg0 is the extension ID and arg1 the function ID */
+	SBI_TRACE_ECALL,
+	/** IPI sent, arg0 is the target HART index and arg1 the IPI event */
+	SBI_TRACE_IPI_SEND,
+	/** IPI received, arg0 is the mask of pending IPI events */
+	SBI_TRACE_IPI_RECV,
+	/** Timer programmed, arg0 is the next event time */
+	SBI_TRACE_TIMER,
+	/** SSE event injected, arg0 is the event ID and arg1 the HART ID */
+	SBI_TRACE_SSE_INJECT,
+};
+
+/**
+ * One trace record
+ *
+ * The time is the value of the time CSR, the same clock as the one of
+ * S-mode, so records can be merged with S-mode traces. The sequence
+ * number is the low 32 bits of the position of the record in the trace
+ * of its HART and lets readers detect dropped or overwritten records.
+ * This layout is also used for the shared memory copy.
+ */
+struct sbi_trace_record {
+	u64 time;
+	u32 event;
+	u32 seq;
+	u64 arg0;
+	u64 arg1;
+} __packed;
+
+#ifdef CONFIG_SBI_TRACE
+
+void sbi_trace(u32 event, u64 arg0, u64 arg1);
+
+int sbi_trace_read(u32 hartid, unsigned long addr_lo,
+		   unsigned long addr_hi, unsigned long size,
+		   unsigned long flags, unsigned long *out_count);
+
+int sbi_trace_init(void);
+
+#else
+
+static inline void sbi_trace(u32 event, u64 arg0, u64 arg1) { }
+
+static inline int sbi_trace_init(void) { return 0; }
+
+#endif
+
+#endif
@@ -112,10 +112,51 @@
 /** Size (in bytes) of sbi_trap_info */
 #define SBI_TRAP_INFO_SIZE SBI_TRAP_INFO_OFFSET(last)
 
-/** Size (in bytes) of sbi_trap_context */
-#define SBI_TRAP_CONTEXT_SIZE (SBI_TRAP_REGS_SIZE + \
-			       SBI_TRAP_INFO_SIZE + \
-			       __SIZEOF_POINTER__)
+/*
+ * The trap context is saved cache line aligned on the exception stack
+ * with the trap details and the previous context pointer ahead of the
+ * registers. This keeps ra and sp, a0-a7, mepc and mstatus, and cause,
+ * tval and prev_context within four cache lines on RV64 and three on
+ * RV32. The registers stay indexed by their number for the emulation
+ * code.
+ */
+
+/** Alignment (in bytes) of sbi_trap_context on the exception stack */
+#define SBI_TRAP_CONTEXT_ALIGN 64
+
+/** Offset (in bytes) of the trap details in sbi_trap_context */
+#define SBI_TRAP_CONTEXT_TRAP_OFFSET 0
+/** Offset (in bytes) of the previous context pointer in sbi_trap_context */
+#define SBI_TRAP_CONTEXT_PREV_OFFSET SBI_TRAP_INFO_SIZE
+/** Offset (in bytes) of the register state in sbi_trap_context */
+#define SBI_TRAP_CONTEXT_REGS_OFFSET (SBI_TRAP_INFO_SIZE + __SIZEOF_POINTER__)
+
+/** Get offset of register with name 'x' in sbi_trap_context */
+#define SBI_TRAP_CONTEXT_REG_OFFSET(x) \
+	(SBI_TRAP_CONTEXT_REGS_OFFSET + SBI_TRAP_REGS_OFFSET(x))
+/** Get offset of trap detail with name 'x' in sbi_trap_context */
+#define SBI_TRAP_CONTEXT_INFO_OFFSET(x) \
+	(SBI_TRAP_CONTEXT_TRAP_OFFSET + SBI_TRAP_INFO_OFFSET(x))
+
+/** Size (in bytes) of sbi_trap_context on the exception stack */
+#define SBI_TRAP_CONTEXT_SIZE \
+	((SBI_TRAP_CONTEXT_REGS_OFFSET + SBI_TRAP_REGS_SIZE + \
+	  SBI_TRAP_CONTEXT_ALIGN - 1) & ~(SBI_TRAP_CONTEXT_ALIGN - 1))
+
+/*
+ * The top of the exception stack holds a pool of trap context slots.
+ * Traps from S/U-mode take the first slot and traps nested in M-mode
+ * take the slot after the current trap context, so up to three nested
+ * traps reuse the same memory. Nested traps beyond the pool, or outside
+ * of a trap handler, fall back to a trap context below the interrupted
+ * SP. The C routines run below the pool.
+ */
+
+/** Number of trap context slots at the top of the exception stack */
+#define SBI_TRAP_CONTEXT_POOL_SLOTS 4
+/** Size (in bytes) of the trap context pool */
+#define SBI_TRAP_CONTEXT_POOL_SIZE \
+	(SBI_TRAP_CONTEXT_POOL_SLOTS * SBI_TRAP_CONTEXT_SIZE)
 
 #ifndef __ASSEMBLER__
 
@@ -212,14 +253,49 @@ struct sbi_trap_info {
 
 /** Representation of trap context saved on stack */
 struct sbi_trap_context {
-	/** Register state */
-	struct sbi_trap_regs regs;
 	/** Trap details */
 	struct sbi_trap_info trap;
 	/** Pointer to previous trap context */
 	struct sbi_trap_context *prev_context;
+	/** Register state */
+	struct sbi_trap_regs regs;
 };
 
+/**
+ * Prevent modification of struct sbi_trap_context from affecting
+ * SBI_TRAP_CONTEXT_xxx_OFFSET
+ */
+_Static_assert(
+	offsetof(struct sbi_trap_context, trap)
+		== SBI_TRAP_CONTEXT_TRAP_OFFSET,
+	"struct sbi_trap_context definition has changed, please redefine "
+	"SBI_TRAP_CONTEXT_TRAP_OFFSET");
+_Static_assert(
+	offsetof(struct sbi_trap_context, prev_context)
+		== SBI_TRAP_CONTEXT_PREV_OFFSET,
+	"struct sbi_trap_context definition has changed, please redefine "
+	"SBI_TRAP_CONTEXT_PREV_OFFSET");
+_Static_assert(
+	offsetof(struct sbi_trap_context, regs)
+		== SBI_TRAP_CONTEXT_REGS_OFFSET,
+	"struct sbi_trap_context definition has changed, please redefine "
+	"SBI_TRAP_CONTEXT_REGS_OFFSET");
+_Static_assert(
+	sizeof(struct sbi_trap_context) <= SBI_TRAP_CONTEXT_SIZE,
+	"struct sbi_trap_context definition has changed, please redefine "
+	"SBI_TRAP_CONTEXT_SIZE");
+
+/* The trap entry addresses the pool with 12-bit immediates */
+_Static_assert(
+	SBI_TRAP_CONTEXT_POOL_SIZE + SBI_TRAP_CONTEXT_ALIGN <= 2048,
+	"trap context pool is too large for the trap entry");
+
+/* The argument registers of an ecall share one cache line */
+_Static_assert(
+	SBI_TRAP_CONTEXT_REG_OFFSET(a0) / SBI_TRAP_CONTEXT_ALIGN
+		== SBI_TRAP_CONTEXT_REG_OFFSET(a7) / SBI_TRAP_CONTEXT_ALIGN,
+	"a0-a7 of struct sbi_trap_context span two cache lines");
+
 static inline unsigned long sbi_regs_gva(const struct sbi_trap_regs *regs)
 {
 	/*
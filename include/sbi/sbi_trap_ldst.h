@@ -13,6 +13,8 @@
 #include <sbi/sbi_types.h>
 #include <sbi/sbi_trap.h>
 
+struct sbi_scratch;
+
 union sbi_ldst_data {
 	u64 data_u64;
 	u32 data_u32;
@@ -20,6 +22,37 @@ union sbi_ldst_data {
 	ulong data_ulong;
 };
 
+ulong sbi_misaligned_tinst_fixup(ulong orig_tinst, ulong new_tinst,
+				 ulong addr_offset);
+
+ulong sbi_misaligned_load_bytes(ulong addr, u8 *bytes, ulong len,
+				struct sbi_trap_info *uptrap);
+
+ulong sbi_misaligned_store_bytes(ulong addr, const u8 *bytes, ulong len,
+				 struct sbi_trap_info *uptrap);
+
+#ifdef OPENSBI_CC_SUPPORT_VECTOR
+
+int sbi_misaligned_v_ld_emulator(ulong insn, struct sbi_trap_context *tcntx);
+
+int sbi_misaligned_v_st_emulator(ulong insn, struct sbi_trap_context *tcntx);
+
+#else
+
+static inline int sbi_misaligned_v_ld_emulator(ulong insn,
+					       struct sbi_trap_context *tcntx)
+{
+	return sbi_trap_redirect(&tcntx->regs, &tcntx->trap);
+}
+
+static inline int sbi_misaligned_v_st_emulator(ulong insn,
+					       struct sbi_trap_context *tcntx)
+{
+	return sbi_trap_redirect(&tcntx->regs, &tcntx->trap);
+}
+
+#endif
+
 int sbi_misaligned_load_handler(struct sbi_trap_context *tcntx);
 
 int sbi_misaligned_store_handler(struct sbi_trap_context *tcntx);
@@ -28,4 +61,6 @@ int sbi_load_access_handler(struct sbi_trap_context *tcntx);
 
 int sbi_store_access_handler(struct sbi_trap_context *tcntx);
 
+int sbi_trap_ldst_init(struct sbi_scratch *scratch, bool cold_boot);
+
 #endif
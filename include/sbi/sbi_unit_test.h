@@ -14,6 +14,8 @@
 struct sbiunit_test_case {
 	const char *name;
 	bool failed;
+	/* Maximum median cycles of a benchmark, 0 to only report it */
+	unsigned long threshold;
 	void (*test_func)(struct sbiunit_test_case *test);
 };
 
@@ -30,6 +32,14 @@ struct sbiunit_test_suite {
 		.test_func = (func)	\
 	}
 
+#define SBIUNIT_BENCH_CASE(func, thres)	\
+	{				\
+		.name = #func,		\
+		.failed = false,	\
+		.threshold = (thres),	\
+		.test_func = (func)	\
+	}
+
 #define SBIUNIT_END_CASE { }
 
 #define SBIUNIT_TEST_SUITE(suite_name, cases_arr)		\
@@ -66,6 +76,35 @@ struct sbiunit_test_suite {
 #define SBIUNIT_EXPECT_STREQ(test, a, b, len) SBIUNIT_EXPECT(test, !sbi_strncmp(a, b, len))
 #define SBIUNIT_ASSERT_STREQ(test, a, b, len) SBIUNIT_ASSERT(test, !sbi_strncmp(a, b, len))
 
+#define SBIUNIT_BENCH_WARMUP	16
+#define SBIUNIT_BENCH_REPS	128
+
+struct sbiunit_bench_result {
+	unsigned long min;
+	unsigned long median;
+	unsigned long p99;
+	unsigned long max;
+};
+
+/**
+ * Time an operation of a benchmark test case
+ *
+ * The operation is run SBIUNIT_BENCH_WARMUP times before the
+ * SBIUNIT_BENCH_REPS timed runs. The test case fails when the median
+ * exceeds the threshold of the test case.
+ *
+ * @param test the benchmark test case
+ * @param name name of the measurement
+ * @param func the operation, returns 0 on success
+ * @param arg argument of the operation
+ * @param res the timing in cycles or NULL
+ *
+ * @return 0 on success and the error of the operation otherwise
+ */
+int sbiunit_bench(struct sbiunit_test_case *test, const char *name,
+		  int (*func)(void *arg), void *arg,
+		  struct sbiunit_bench_result *res);
+
 void run_all_tests(void);
 #endif
 #else
@@ -38,4 +38,24 @@ DECLARE_UNPRIVILEGED_LOAD_FUNCTION(ulong)
 
 ulong sbi_get_insn(ulong mepc, struct sbi_trap_info *trap);
 
+/**
+ * Copy len bytes from an S-mode address to an M-mode buffer using
+ * naturally aligned accesses of up to XLEN bits
+ *
+ * @return number of bytes copied, on a fault this is the offset of the
+ * faulting access and trap describes the fault
+ */
+ulong sbi_copy_from_smode(u8 *dst, ulong src, ulong len,
+			  struct sbi_trap_info *trap);
+
+/**
+ * Copy len bytes from an M-mode buffer to an S-mode address using
+ * naturally aligned accesses of up to XLEN bits
+ *
+ * @return number of bytes copied, on a fault this is the offset of the
+ * faulting access and trap describes the fault
+ */
+ulong sbi_copy_to_smode(ulong dst, const u8 *src, ulong len,
+			struct sbi_trap_info *trap);
+
 #endif
@@ -0,0 +1,47 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_WAIT_H__
+#define __SBI_WAIT_H__
+
+#include <sbi/riscv_barrier.h>
+#include <sbi/sbi_types.h>
+
+/**
+ * Wait for a short while or until the value at ptr changes from val
+ *
+ * With Zawrs the HART stalls in WRS.STO until the memory location is
+ * written, an interrupt becomes pending (even if disabled) or a short
+ * timeout expires. Without Zawrs this is just cpu_relax().
+ *
+ * Callers must re-check their condition after this returns.
+ */
+void sbi_wait_on(volatile unsigned long *ptr, unsigned long val);
+
+/**
+ * Same as sbi_wait_on() for a 32-bit location, without Zawrs the HART
+ * backs off for the given number of PAUSE (or cpu_relax()) iterations
+ */
+void sbi_wait_on_u32(volatile u32 *ptr, u32 val, unsigned long backoff);
+
+/**
+ * Wait until a condition on the value at ptr becomes true
+ *
+ * The current value is available as VAL in cond and the value for
+ * which cond was true is returned. ptr must point to a long sized
+ * location which is written by another HART.
+ */
+#define sbi_wait_until(__ptr, __cond)					\
+({									\
+	unsigned long VAL;						\
+	while (1) {							\
+		VAL = __smp_load_acquire((volatile unsigned long *)(__ptr)); \
+		if (__cond)						\
+			break;						\
+		sbi_wait_on((volatile unsigned long *)(__ptr), VAL);	\
+	}								\
+	VAL;								\
+})
+
+#endif
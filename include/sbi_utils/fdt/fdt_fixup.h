@@ -93,13 +93,53 @@ void fdt_plic_fixup(void *fdt);
  */
 int fdt_reserved_memory_fixup(void *fdt);
 
+/**
+ * Add the coldboot phase profile to the /chosen node
+ *
+ * The "opensbi,boot-phases" string list holds the names of the coldboot
+ * phases completed so far and "opensbi,boot-cycles" holds the duration
+ * of each phase in mcycle ticks as 64-bit values.
+ *
+ * @param fdt: device tree blob
+ */
+void fdt_boot_profile_fixup(void *fdt);
+
+#ifdef CONFIG_FDT_OVERLAY
+
+/**
+ * Apply a list of device tree overlays
+ *
+ * The overlays are placed one after the other and the list ends with a
+ * word which is not the FDT magic. Room for all of them is made with a
+ * single resize of the device tree, each overlay is copied to the heap
+ * since applying it modifies it. The device tree is unusable if this
+ * fails.
+ *
+ * It is recommended that platform codes call this helper in their
+ * early_init() so that the drivers probe the resulting device tree.
+ *
+ * @param fdt: device tree blob
+ * @param overlays: address of the first overlay or NULL
+ * @return zero on success and -ve on failure
+ */
+int fdt_apply_overlays(void *fdt, const void *overlays);
+
+#else
+
+static inline int fdt_apply_overlays(void *fdt, const void *overlays)
+{
+	return 0;
+}
+
+#endif
+
 /**
  * General device tree fix-up
  *
  * This routine do all required device tree fix-ups for a typical platform.
- * It fixes up the PLIC node, IMSIC nodes, APLIC nodes, and the reserved
- * memory node in the device tree by calling the corresponding helper
- * routines to accomplish the task.
+ * It fixes up the PLIC nodes, IMSIC nodes, APLIC nodes and the PMU node in
+ * a single walk over the device tree, then fixes up the reserved memory
+ * node by calling the corresponding helper routine.
  *
  * It is recommended that platform codes call this helper in their final_init()
  *
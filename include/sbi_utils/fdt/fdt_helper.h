@@ -37,10 +37,51 @@ struct platform_uart_data {
 const struct fdt_match *fdt_match_node(void *fdt, int nodeoff,
 				       const struct fdt_match *match_table);
 
+/**
+ * Find the first enabled node after startoff matching the match table
+ *
+ * The lookup uses an index of all compatible strings in the device tree
+ * which is built on first use and rebuilt when the tree is changed.
+ */
 int fdt_find_match(void *fdt, int startoff,
 		   const struct fdt_match *match_table,
 		   const struct fdt_match **out_match);
 
+/** Hash of a string as used for compatible string lookups */
+u32 fdt_string_hash(const char *str, int len);
+
+/**
+ * Cached variants of the libfdt node lookups
+ *
+ * With CONFIG_FDT_NODE_INDEX these consult an index of all nodes which
+ * is built on first use and rebuilt when the tree is changed, otherwise
+ * they are plain libfdt calls.
+ */
+int fdt_node_offset_by_phandle_cached(const void *fdt, u32 phandle);
+
+int fdt_parent_offset_cached(const void *fdt, int nodeoff);
+
+int fdt_cpus_offset_cached(const void *fdt);
+
+/**
+ * Stage a property write to be applied by fdt_stage_commit()
+ *
+ * Adding or growing properties one at a time with fdt_setprop() moves
+ * the rest of the blob for every edit. Staged writes are applied in a
+ * single pass which moves every byte of the blob at most once. The
+ * value must stay valid and must not point into the blob until the
+ * commit, and no other edit which moves nodes may be done meanwhile.
+ * Staging the same property of a node again replaces the value.
+ */
+int fdt_stage_setprop(void *fdt, int nodeoff, const char *name,
+		      const void *val, int len);
+
+int fdt_stage_setprop_string(void *fdt, int nodeoff, const char *name,
+			     const char *str);
+
+/** Apply all staged property writes, growing the blob as needed */
+int fdt_stage_commit(void *fdt);
+
 int fdt_parse_phandle_with_args(void *fdt, int nodeoff,
 				const char *prop, const char *cells_prop,
 				int index, struct fdt_phandle_args *out_args);
@@ -57,6 +98,33 @@ int fdt_parse_hart_id(void *fdt, int cpu_offset, u32 *hartid);
 
 int fdt_parse_max_enabled_hart_id(void *fdt, u32 *max_hartid);
 
+/**
+ * Get the NUMA node of a DT node
+ *
+ * The numa-node-id property is looked up in the node and then in its
+ * parents. Returns a negative error code when no NUMA node is found.
+ */
+int fdt_parse_numa_node_id(void *fdt, int nodeoff);
+
+/**
+ * Find the first interrupts-extended entry of an interrupt controller
+ * reaching a given interrupt of an enabled HART on a NUMA node
+ *
+ * @param hwirq local interrupt of the HART, such as IRQ_M_EXT
+ * @param hartid optional output for the hartid of the HART
+ * @return entry index on success and negative error code on failure
+ */
+int fdt_find_numa_local_intc_entry(void *fdt, int nodeoff, int numa_node,
+				   u32 hwirq, u32 *hartid);
+
+/**
+ * Get the number of HARTs in each cluster of the /cpus/cpu-map node
+ *
+ * The clusters must all have the same power of two number of HARTs with
+ * consecutive hartids aligned to the cluster size.
+ */
+int fdt_parse_cpu_map_cluster_harts(void *fdt, u32 *cluster_harts);
+
 int fdt_parse_timebase_frequency(void *fdt, unsigned long *freq);
 
 int fdt_parse_isa_extensions(void *fdt, unsigned int hard_id,
@@ -45,6 +45,16 @@ struct fdt_pmu_raw_event_counter_map {
  */
 int fdt_pmu_fixup(void *fdt);
 
+/**
+ * Fix up a given PMU node in the device tree
+ *
+ * This does the same as fdt_pmu_fixup() for an already located node.
+ *
+ * @param fdt device tree blob
+ * @param pmu_offset offset of the PMU node
+ */
+int fdt_pmu_fixup_node(void *fdt, int pmu_offset);
+
 /**
  * Setup PMU data from device tree
  *
@@ -70,6 +80,7 @@ extern uint32_t hw_event_count;
 #else
 
 static inline void fdt_pmu_fixup(void *fdt) { }
+static inline int fdt_pmu_fixup_node(void *fdt, int pmu_offset) { return 0; }
 static inline int fdt_pmu_setup(void *fdt) { return 0; }
 static inline uint64_t fdt_pmu_get_select_value(uint32_t event_idx) { return 0; }
 
@@ -11,11 +11,15 @@
 #define __GPIO_H__
 
 #include <sbi/sbi_types.h>
+#include <sbi/sbi_bitops.h>
 #include <sbi/sbi_list.h>
 
 #define GPIO_LINE_DIRECTION_IN	1
 #define GPIO_LINE_DIRECTION_OUT	0
 
+/** Maximum number of GPIOs of a chip supporting set/get_multiple */
+#define GPIO_CHIP_MULTIPLE_MAX	64
+
 /** Representation of a GPIO pin */
 struct gpio_pin {
 	/** Pointer to the GPIO chip */
@@ -71,6 +75,19 @@ struct gpio_chip {
 	int (*get)(struct gpio_pin *gp);
 	/** Set output value for GPIO pin */
 	void (*set)(struct gpio_pin *gp, int value);
+	/**
+	 * Get current values of the GPIO pins set in mask
+	 *
+	 * Both mask and bits are bitmaps indexed by GPIO pin offset with
+	 * BITS_TO_LONGS(GPIO_CHIP_MULTIPLE_MAX) entries.
+	 *
+	 * @return 0 on success and negative error code on failure
+	 */
+	int (*get_multiple)(struct gpio_chip *gc, const unsigned long *mask,
+			    unsigned long *bits);
+	/** Set output values of the GPIO pins set in mask from bits */
+	void (*set_multiple)(struct gpio_chip *gc, const unsigned long *mask,
+			     const unsigned long *bits);
 	/** List */
 	struct sbi_dlist node;
 };
@@ -104,4 +121,21 @@ int gpio_get(struct gpio_pin *gp);
 /** Set output value of GPIO pin */
 int gpio_set(struct gpio_pin *gp, int value);
 
+/**
+ * Get current values of multiple GPIO pins
+ *
+ * Pins of the same GPIO chip are read with one get_multiple() call when
+ * the chip supports it.
+ */
+int gpio_get_multiple(struct gpio_pin *gps, unsigned int count, int *values);
+
+/**
+ * Set output values of multiple GPIO pins
+ *
+ * Pins of the same GPIO chip are updated with one set_multiple() call
+ * when the chip supports it.
+ */
+int gpio_set_multiple(struct gpio_pin *gps, unsigned int count,
+		      const int *values);
+
 #endif
@@ -15,6 +15,9 @@ int dw_i2c_init(struct i2c_adapter *, int nodeoff);
 
 struct dw_i2c_adapter {
 	unsigned long addr;
+	/* FIFO depths read from IC_COMP_PARAM_1 by dw_i2c_init() */
+	u32 tx_fifo_depth;
+	u32 rx_fifo_depth;
 	struct i2c_adapter adapter;
 };
 
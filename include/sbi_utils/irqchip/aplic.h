@@ -34,6 +34,8 @@ struct aplic_data {
 	unsigned long size;
 	unsigned long num_idc;
 	unsigned long num_source;
+	/* Hart index targeted by the sources which aren't delegated */
+	u32 default_target;
 	bool targets_mmode;
 	bool has_msicfg_mmode;
 	struct aplic_msicfg_data msicfg_mmode;
@@ -44,4 +46,7 @@ struct aplic_data {
 
 int aplic_cold_irqchip_init(struct aplic_data *aplic);
 
+/* Program the APLIC again if it lost its state in system suspend */
+void aplic_resume_irqchip(struct aplic_data *aplic);
+
 #endif
@@ -11,6 +11,11 @@
 
 /**
  * Save the PLIC priority state
+ *
+ * Only the priorities of sources enabled in a context of any HART using
+ * the PLIC are saved. Priorities are global so on multi-HART systems only
+ * the last HART powering down the PLIC needs to save them.
+ *
  * @param priority pointer to the memory region for the saved priority
  * @param num size of the memory region including interrupt source 0
  */
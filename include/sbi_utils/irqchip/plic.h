@@ -16,6 +16,8 @@ struct plic_data {
 	unsigned long addr;
 	unsigned long size;
 	unsigned long num_src;
+	/* Bitmap of sources whose priority was saved, in IE word layout */
+	u32 *saved_src;
 };
 
 /* So far, priorities on all consumers of these functions fit in 8 bits. */
@@ -24,12 +26,43 @@ void plic_priority_save(const struct plic_data *plic, u8 *priority, u32 num);
 void plic_priority_restore(const struct plic_data *plic, const u8 *priority,
 			   u32 num);
 
+/*
+ * Same as above but only for the sources set in the enabled bitmap which
+ * uses the layout of the PLIC enable words. Others are saved as zero.
+ */
+void plic_priority_save_enabled(const struct plic_data *plic, u8 *priority,
+				const u32 *enabled, u32 num);
+
+void plic_priority_restore_enabled(const struct plic_data *plic,
+				   const u8 *priority, const u32 *enabled,
+				   u32 num);
+
+/* OR the enable words of a context into the enabled bitmap */
+void plic_context_enabled_sources(const struct plic_data *plic,
+				  int context_id, u32 *enabled);
+
 void plic_context_save(const struct plic_data *plic, int context_id,
 		       u32 *enable, u32 *threshold, u32 num);
 
 void plic_context_restore(const struct plic_data *plic, int context_id,
 			  const u32 *enable, u32 threshold, u32 num);
 
+u32 plic_source_get_priority(const struct plic_data *plic, u32 source);
+
+void plic_source_set_priority(const struct plic_data *plic, u32 source,
+			      u32 priority);
+
+void plic_context_enable_source(const struct plic_data *plic, int context_id,
+				u32 source, bool enable);
+
+void plic_context_set_threshold(const struct plic_data *plic, int context_id,
+				u32 threshold);
+
+u32 plic_context_claim(const struct plic_data *plic, int context_id);
+
+void plic_context_complete(const struct plic_data *plic, int context_id,
+			   u32 source);
+
 int plic_context_init(const struct plic_data *plic, int context_id,
 		      bool enable, u32 threshold);
 
@@ -0,0 +1,60 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __LZ4_H__
+#define __LZ4_H__
+
+#include <sbi/sbi_types.h>
+
+/**
+ * Room needed after the decompressed data of a frame to decompress it
+ * in place. It covers the worst case expansion of the LZ4 blocks and the
+ * frame and block headers for the smallest block size.
+ */
+#define LZ4_INPLACE_MARGIN(__size)					\
+	((__size) / 255 + ((__size) / 0x10000 + 1) * 24 + 32)
+
+/**
+ * Get the decompressed size recorded in an LZ4 frame header
+ *
+ * @param src the frame
+ * @param src_size size of the frame
+ *
+ * @return decompressed size on success and negative error code on failure
+ */
+long lz4_frame_content_size(const void *src, unsigned long src_size);
+
+/**
+ * Decompress an LZ4 frame
+ *
+ * The frame must record its content size and must not need a dictionary.
+ * The checksums are not verified. The destination may overlap the frame
+ * if it starts below it and ends at least LZ4_INPLACE_MARGIN() bytes
+ * before the end of the frame.
+ *
+ * @param dst destination buffer
+ * @param dst_size size of the destination buffer
+ * @param src the frame
+ * @param src_size size of the frame
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int lz4_frame_decompress(void *dst, unsigned long dst_size,
+			 const void *src, unsigned long src_size);
+
+/**
+ * Decompress an LZ4 frame over itself
+ *
+ * The frame is first moved up so that it ends LZ4_INPLACE_MARGIN() bytes
+ * after the end of the decompressed data, the memory up to there must be
+ * free.
+ *
+ * @param buf start of the frame and of the decompressed data
+ * @param src_size size of the frame
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int lz4_frame_decompress_inplace(void *buf, unsigned long src_size);
+
+#endif
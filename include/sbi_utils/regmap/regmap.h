@@ -36,6 +36,15 @@ struct regmap {
 	int (*reg_update_bits)(struct regmap *rmap, unsigned int reg,
 			       unsigned int mask, unsigned int val);
 
+	/**
+	 * Optional write-through cache of non-volatile registers set up
+	 * by regmap_cache_init(), indexed by register / reg_stride
+	 */
+	unsigned int cache_count;
+	unsigned int *cache_vals;
+	unsigned long *cache_valid;
+	unsigned long *cache_nonvolatile;
+
 	/** List */
 	struct sbi_dlist node;
 };
@@ -54,6 +63,18 @@ int regmap_add(struct regmap *rmap);
 /** Un-register a regmap instance */
 void regmap_remove(struct regmap *rmap);
 
+/** Allocate the register cache of a regmap instance */
+int regmap_cache_init(struct regmap *rmap);
+
+/** Free the register cache of a regmap instance */
+void regmap_cache_free(struct regmap *rmap);
+
+/** Mark a register of a regmap instance as non-volatile (i.e. cacheable) */
+int regmap_cache_set_nonvolatile(struct regmap *rmap, unsigned int reg);
+
+/** Drop all cached register values of a regmap instance */
+void regmap_cache_invalidate(struct regmap *rmap);
+
 /** Read a register in a regmap instance */
 int regmap_read(struct regmap *rmap, unsigned int reg, unsigned int *val);
 
@@ -14,4 +14,7 @@
 
 int sifive_uart_init(unsigned long base, u32 in_freq, u32 baudrate);
 
+/** Set the interrupt source used for the console RX interrupt */
+void sifive_uart_set_hwirq(u32 hwirq);
+
 #endif
@@ -18,13 +18,22 @@ struct uart8250_device {
 	u32 baudrate;
 	u32 reg_shift;
 	u32 reg_width;
+	u32 tx_fifo_depth;
 };
 
 void uart8250_putc(struct uart8250_device *dev, char ch);
+unsigned long uart8250_puts(struct uart8250_device *dev, const char *str,
+			    unsigned long len);
+/** Write as many bytes as the empty TX FIFO takes without waiting */
+unsigned long uart8250_write_nonblock(struct uart8250_device *dev,
+				     const char *buf, unsigned long len);
 int uart8250_getc(struct uart8250_device *dev);
 int uart8250_init(struct uart8250_device * dev, unsigned long base, u32 in_freq,
 		  u32 baudrate, u32 reg_shift, u32 reg_width, u32 reg_offset);
 
+/** Set the interrupt source used for the console TX and RX interrupts */
+void uart8250_console_set_hwirq(u32 hwirq);
+
 int uart8250_console_init(unsigned long base, u32 in_freq, u32 baudrate,
 		  u32 reg_shift, u32 reg_width, u32 reg_offset);
 
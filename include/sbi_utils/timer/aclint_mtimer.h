@@ -38,12 +38,18 @@ struct aclint_mtimer_data {
 	/* Private details (initialized and used by ACLINT MTIMER library) */
 	struct aclint_mtimer_data *time_delta_reference;
 	unsigned long time_delta_computed;
+	struct aclint_mtimer_data *sync_next;
+	u64 sync_max_skew;
 	u64 (*time_rd)(volatile u64 *addr);
 	void (*time_wr)(bool timecmp, u64 value, volatile u64 *addr);
 };
 
 void aclint_mtimer_sync(struct aclint_mtimer_data *mt);
 
+int aclint_mtimer_sync_start(unsigned long period_ms);
+
+u64 aclint_mtimer_sync_max_skew(void);
+
 void aclint_mtimer_set_reference(struct aclint_mtimer_data *mt,
 				 struct aclint_mtimer_data *ref);
 
@@ -49,6 +49,14 @@ libsbi-objs-$(CONFIG_SBI_ECALL_CPPC) += sbi_ecall_cppc.o
 carray-sbi_ecall_exts-$(CONFIG_SBI_ECALL_FWFT) += ecall_fwft
 libsbi-objs-$(CONFIG_SBI_ECALL_FWFT) += sbi_ecall_fwft.o
 
+carray-sbi_ecall_exts-$(CONFIG_SBI_ECALL_NACL) += ecall_nacl
+libsbi-objs-$(CONFIG_SBI_ECALL_NACL) += sbi_ecall_nacl.o
+libsbi-objs-$(CONFIG_SBI_ECALL_NACL) += sbi_nacl.o
+
+carray-sbi_ecall_exts-$(CONFIG_SBI_ECALL_STA) += ecall_sta
+libsbi-objs-$(CONFIG_SBI_ECALL_STA) += sbi_ecall_sta.o
+libsbi-objs-$(CONFIG_SBI_ECALL_STA) += sbi_sta.o
+
 carray-sbi_ecall_exts-$(CONFIG_SBI_ECALL_LEGACY) += ecall_legacy
 libsbi-objs-$(CONFIG_SBI_ECALL_LEGACY) += sbi_ecall_legacy.o
 
@@ -61,8 +69,23 @@ libsbi-objs-$(CONFIG_SBI_ECALL_DBTR) += sbi_ecall_dbtr.o
 carray-sbi_ecall_exts-$(CONFIG_SBI_ECALL_SSE) += ecall_sse
 libsbi-objs-$(CONFIG_SBI_ECALL_SSE) += sbi_ecall_sse.o
 
+carray-sbi_ecall_exts-$(CONFIG_SBI_ECALL_OPENSBI) += ecall_opensbi
+libsbi-objs-$(CONFIG_SBI_ECALL_OPENSBI) += sbi_ecall_opensbi.o
+
+libsbi-objs-$(CONFIG_SBI_ECALL_STATS) += sbi_ecall_stats.o
+libsbi-objs-$(CONFIG_SBI_MISALIGNED_STATS) += sbi_misaligned_stats.o
+libsbi-objs-$(CONFIG_SBI_HSM_IDLE_STATS) += sbi_hsm_idle_stats.o
+libsbi-objs-$(CONFIG_SBI_LOCKSTAT) += sbi_lockstat.o
+libsbi-objs-$(CONFIG_SBI_TRACE) += sbi_trace.o
+
+libsbi-objs-$(CONFIG_SBI_BOOT_PROFILE) += sbi_boot_profile.o
+libsbi-objs-$(CONFIG_SBI_ALTERNATIVES) += sbi_alternative.o
+libsbi-objs-$(CONFIG_SBI_STATIC_CALL) += sbi_static_call.o
+libsbi-objs-$(CONFIG_SBI_EMULATE_BITMANIP) += sbi_emulate_bitmanip.o
+
 libsbi-objs-y += sbi_bitmap.o
 libsbi-objs-y += sbi_bitops.o
+libsbi-objs-y += sbi_cache.o
 libsbi-objs-y += sbi_console.o
 libsbi-objs-y += sbi_domain_context.o
 libsbi-objs-y += sbi_domain.o
@@ -89,6 +112,8 @@ libsbi-objs-y += sbi_timer.o
 libsbi-objs-y += sbi_tlb.o
 libsbi-objs-y += sbi_trap.o
 libsbi-objs-y += sbi_trap_ldst.o
+libsbi-objs-y += sbi_trap_v_ldst.o
 libsbi-objs-y += sbi_unpriv.o
+libsbi-objs-y += sbi_wait.o
 libsbi-objs-y += sbi_expected_trap.o
 libsbi-objs-y += sbi_cppc.o
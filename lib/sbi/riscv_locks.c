@@ -5,8 +5,151 @@
  * Copyright (c) 2021 Christoph Müllner <cmuellner@linux.com>
  */
 
+#include <sbi/riscv_asm.h>
 #include <sbi/riscv_barrier.h>
 #include <sbi/riscv_locks.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_lockstat.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_wait.h>
+
+#ifdef CONFIG_SBI_QUEUED_SPINLOCK
+
+#define SPIN_LOCK_LOCKED	1UL
+
+/* Per-HART queue node, only used while the HART waits for a lock */
+struct spin_lock_node {
+	struct spin_lock_node *next;
+	unsigned long wait;
+	unsigned long busy;
+};
+
+static unsigned long spin_lock_node_off;
+
+static inline bool spin_lock_cmpxchg(spinlock_t *lock, unsigned long old,
+				     unsigned long new)
+{
+	return __atomic_compare_exchange_n(&lock->val, &old, new, false,
+					   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static struct spin_lock_node *spin_lock_get_node(void)
+{
+	unsigned long off = __smp_load_acquire(&spin_lock_node_off);
+	struct spin_lock_node *node;
+
+	/* Locks taken before the queue nodes exist simply spin */
+	if (!off)
+		return NULL;
+
+	/* A nested wait (e.g. from a trap handler) also simply spins */
+	node = sbi_scratch_thishart_offset_ptr(off);
+	if (node->busy)
+		return NULL;
+	node->busy = 1;
+
+	return node;
+}
+
+bool spin_lock_check(spinlock_t *lock)
+{
+	return __smp_load_acquire(&lock->val) & SPIN_LOCK_LOCKED;
+}
+
+bool spin_trylock(spinlock_t *lock)
+{
+	unsigned long val = __atomic_load_n(&lock->val, __ATOMIC_RELAXED);
+
+	if (val & SPIN_LOCK_LOCKED)
+		return false;
+
+	return spin_lock_cmpxchg(lock, val, val | SPIN_LOCK_LOCKED);
+}
+
+static void __spin_lock(spinlock_t *lock)
+{
+	struct spin_lock_node *node, *prev;
+	unsigned long val, tail;
+
+	/* Fast path for an uncontended lock */
+	if (spin_lock_cmpxchg(lock, 0, SPIN_LOCK_LOCKED))
+		return;
+
+	node = spin_lock_get_node();
+	if (!node) {
+		while (!spin_trylock(lock))
+			cpu_relax();
+		return;
+	}
+
+	node->next = NULL;
+	node->wait = 1;
+
+	/* Append our node at the tail of the queue */
+	val = __atomic_load_n(&lock->val, __ATOMIC_RELAXED);
+	while (1) {
+		if (!val && spin_lock_cmpxchg(lock, 0, SPIN_LOCK_LOCKED))
+			goto done;
+		if (__atomic_compare_exchange_n(&lock->val, &val,
+				(unsigned long)node | (val & SPIN_LOCK_LOCKED),
+				false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			break;
+	}
+
+	/* Wait on our own node until the previous waiter hands over */
+	prev = (struct spin_lock_node *)(val & ~SPIN_LOCK_LOCKED);
+	if (prev) {
+		__smp_store_release(&prev->next, node);
+		sbi_wait_until(&node->wait, !VAL);
+	}
+
+	/* We are at the head of the queue so spin on the lock word */
+	while (1) {
+		val = __atomic_load_n(&lock->val, __ATOMIC_RELAXED);
+		if (val & SPIN_LOCK_LOCKED) {
+			cpu_relax();
+			continue;
+		}
+
+		tail = val & ~SPIN_LOCK_LOCKED;
+		if (tail == (unsigned long)node) {
+			/* No other waiter so the queue becomes empty */
+			if (spin_lock_cmpxchg(lock, val, SPIN_LOCK_LOCKED))
+				goto done;
+		} else if (spin_lock_cmpxchg(lock, val,
+					     val | SPIN_LOCK_LOCKED)) {
+			/* Make the next waiter the head of the queue */
+			while (!__smp_load_acquire(&node->next))
+				cpu_relax();
+			__smp_store_release(&node->next->wait, 0);
+			goto done;
+		}
+	}
+
+done:
+	node->busy = 0;
+}
+
+void spin_unlock(spinlock_t *lock)
+{
+	__atomic_fetch_and(&lock->val, ~SPIN_LOCK_LOCKED, __ATOMIC_RELEASE);
+}
+
+int spin_lock_queue_init(void)
+{
+	unsigned long off;
+
+	/* Each node gets its own cache line because remote HARTs write it */
+	off = sbi_scratch_alloc_cacheline_offset(sizeof(struct spin_lock_node));
+	if (!off)
+		return SBI_ENOMEM;
+
+	__smp_store_release(&spin_lock_node_off, off);
+
+	return 0;
+}
+
+#else
 
 static inline bool spin_lock_unlocked(spinlock_t lock)
 {
@@ -45,33 +188,154 @@ bool spin_trylock(spinlock_t *lock)
 	return l0 == 0;
 }
 
-void spin_lock(spinlock_t *lock)
+/* PAUSE iterations per HART queued ahead of a waiter */
+#define SPIN_LOCK_BACKOFF	16
+#define SPIN_LOCK_BACKOFF_MAX	1024
+
+static void __spin_lock(spinlock_t *lock)
 {
-	unsigned long inc = 1u << TICKET_SHIFT;
-	unsigned long mask = 0xffffu;
-	u32 l0, tmp1, tmp2;
+	volatile u32 *word = (volatile u32 *)lock;
+	unsigned long backoff;
+	u32 l0;
+	u16 ticket, owner;
 
-	__asm__ __volatile__(
-		/* Atomically increment the next ticket. */
-		"	amoadd.w.aqrl	%0, %4, %3\n"
-
-		/* Did we get the lock? */
-		"	srli	%1, %0, %6\n"
-		"	and	%1, %1, %5\n"
-		"1:	and	%2, %0, %5\n"
-		"	beq	%1, %2, 2f\n"
-
-		/* If not, then spin on the lock. */
-		"	lw	%0, %3\n"
-		RISCV_ACQUIRE_BARRIER
-		"	j	1b\n"
-		"2:"
-		: "=&r"(l0), "=&r"(tmp1), "=&r"(tmp2), "+A"(*lock)
-		: "r"(inc), "r"(mask), "I"(TICKET_SHIFT)
-		: "memory");
+	/* Atomically increment the next ticket. */
+	l0 = __atomic_fetch_add(word, 1U << TICKET_SHIFT, __ATOMIC_ACQ_REL);
+	ticket = l0 >> TICKET_SHIFT;
+	owner = l0 & 0xffff;
+
+	/*
+	 * If we did not get the lock then spin on the lock. The back off
+	 * grows with the number of HARTs ahead of us in the queue because
+	 * they all have to release the lock before we get it.
+	 */
+	while (owner != ticket) {
+		backoff = (u16)(ticket - owner) * SPIN_LOCK_BACKOFF;
+		if (backoff > SPIN_LOCK_BACKOFF_MAX)
+			backoff = SPIN_LOCK_BACKOFF_MAX;
+		sbi_wait_on_u32(word, l0, backoff);
+
+		l0 = __smp_load_acquire(word);
+		owner = l0 & 0xffff;
+	}
 }
 
 void spin_unlock(spinlock_t *lock)
 {
 	__smp_store_release(&lock->owner, lock->owner + 1);
 }
+
+#endif
+
+void spin_lock(spinlock_t *lock)
+{
+#ifdef CONFIG_SBI_LOCKSTAT
+	unsigned long start;
+
+	if (spin_trylock(lock)) {
+		sbi_lockstat_acquired(lock, false, 0);
+		return;
+	}
+
+	start = csr_read(CSR_MCYCLE);
+	__spin_lock(lock);
+	sbi_lockstat_acquired(lock, true, csr_read(CSR_MCYCLE) - start);
+#else
+	__spin_lock(lock);
+#endif
+}
+
+/* Writer holds the lock */
+#define RWLOCK_WRITER_LOCKED	0x0ffU
+/* Writer waits for the readers to leave */
+#define RWLOCK_WRITER_WAITING	0x100U
+#define RWLOCK_WRITER_MASK	(RWLOCK_WRITER_LOCKED | RWLOCK_WRITER_WAITING)
+#define RWLOCK_READER		0x200U
+
+void read_lock(rwlock_t *lock)
+{
+	u32 cnts;
+
+	cnts = __atomic_add_fetch(&lock->cnts, RWLOCK_READER,
+				  __ATOMIC_ACQUIRE);
+	if (likely(!(cnts & RWLOCK_WRITER_MASK)))
+		return;
+
+	/* Queue up behind the writer instead of starving it */
+	__atomic_sub_fetch(&lock->cnts, RWLOCK_READER, __ATOMIC_RELAXED);
+	spin_lock(&lock->wait_lock);
+
+	__atomic_add_fetch(&lock->cnts, RWLOCK_READER, __ATOMIC_RELAXED);
+	while (__smp_load_acquire(&lock->cnts) & RWLOCK_WRITER_LOCKED)
+		cpu_relax();
+
+	spin_unlock(&lock->wait_lock);
+}
+
+void read_unlock(rwlock_t *lock)
+{
+	__atomic_sub_fetch(&lock->cnts, RWLOCK_READER, __ATOMIC_RELEASE);
+}
+
+void write_lock(rwlock_t *lock)
+{
+	u32 cnts = 0;
+
+	if (__atomic_compare_exchange_n(&lock->cnts, &cnts,
+					RWLOCK_WRITER_LOCKED, false,
+					__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return;
+
+	spin_lock(&lock->wait_lock);
+
+	/* Stop new readers and wait for the current ones to leave */
+	__atomic_fetch_or(&lock->cnts, RWLOCK_WRITER_WAITING,
+			  __ATOMIC_RELAXED);
+	do {
+		cnts = RWLOCK_WRITER_WAITING;
+		if (__atomic_compare_exchange_n(&lock->cnts, &cnts,
+						RWLOCK_WRITER_LOCKED, false,
+						__ATOMIC_ACQUIRE,
+						__ATOMIC_RELAXED))
+			break;
+		cpu_relax();
+	} while (1);
+
+	spin_unlock(&lock->wait_lock);
+}
+
+void write_unlock(rwlock_t *lock)
+{
+	__atomic_sub_fetch(&lock->cnts, RWLOCK_WRITER_LOCKED,
+			   __ATOMIC_RELEASE);
+}
+
+u32 read_seqbegin(const seqlock_t *sl)
+{
+	u32 seq;
+
+	/* An odd sequence means a writer is updating the record */
+	while ((seq = __smp_load_acquire(&sl->sequence)) & 1)
+		cpu_relax();
+
+	return seq;
+}
+
+bool read_seqretry(const seqlock_t *sl, u32 start)
+{
+	smp_rmb();
+	return __atomic_load_n(&sl->sequence, __ATOMIC_RELAXED) != start;
+}
+
+void write_seqlock(seqlock_t *sl)
+{
+	spin_lock(&sl->lock);
+	__atomic_store_n(&sl->sequence, sl->sequence + 1, __ATOMIC_RELAXED);
+	smp_wmb();
+}
+
+void write_sequnlock(seqlock_t *sl)
+{
+	__smp_store_release(&sl->sequence, sl->sequence + 1);
+	spin_unlock(&sl->lock);
+}
@@ -0,0 +1,94 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Boot-time patching of the hot feature checks of sbi_hart.h
+ */
+
+#include <sbi/riscv_barrier.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_alternative.h>
+
+#define ALT_INSN_NOP			0x00000013U
+#define ALT_INSN_JAL			0x0000006fU
+
+extern struct sbi_alt_entry __sbi_alt_start[]
+	__attribute__((visibility("hidden")));
+extern struct sbi_alt_entry __sbi_alt_end[]
+	__attribute__((visibility("hidden")));
+
+static spinlock_t alt_lock = SPIN_LOCK_INITIALIZER;
+/* Flags whose SBI_ALT_ALL or SBI_ALT_NONE sites are currently patched */
+static unsigned long alt_all, alt_none;
+
+/* Encode "jal zero, off", the sites are always well within +/-1MB */
+static u32 alt_jal(unsigned long off)
+{
+	u32 imm = off;
+
+	return ALT_INSN_JAL | ((imm & 0x100000) << 11) |
+	       ((imm & 0x7fe) << 20) | ((imm & 0x800) << 9) |
+	       (imm & 0xff000);
+}
+
+static void alt_patch(unsigned long flags, u32 kind, bool enable)
+{
+	struct sbi_alt_entry *e;
+	unsigned long site, target;
+
+	if (!flags)
+		return;
+
+	for (e = __sbi_alt_start; e < __sbi_alt_end; e++) {
+		if (e->kind != kind || !(e->flag & flags))
+			continue;
+
+		site = (unsigned long)&e->site + e->site;
+		target = (unsigned long)&e->target + e->target;
+
+		/*
+		 * The sites are 4-byte aligned so other HARTs fetch either
+		 * the old or the new instruction.
+		 */
+		*(volatile u32 *)site = enable ? alt_jal(target - site) :
+						 ALT_INSN_NOP;
+	}
+}
+
+void sbi_alternative_apply(unsigned long hot)
+{
+	spin_lock(&alt_lock);
+
+	alt_all = hot;
+	alt_none = ~hot;
+	alt_patch(alt_all, SBI_ALT_ALL, true);
+	alt_patch(alt_none, SBI_ALT_NONE, true);
+
+	spin_unlock(&alt_lock);
+
+	RISCV_FENCE_I;
+}
+
+void sbi_alternative_check(unsigned long hot)
+{
+	unsigned long revert_all, revert_none;
+
+	spin_lock(&alt_lock);
+
+	/*
+	 * A HART with different features puts the sites back to the
+	 * runtime check. HARTs which are already running may keep the
+	 * patched sites in their instruction cache for a while, this is
+	 * fine since the patched path matches their own features.
+	 */
+	revert_all = alt_all & ~hot;
+	revert_none = alt_none & hot;
+	alt_patch(revert_all, SBI_ALT_ALL, false);
+	alt_patch(revert_none, SBI_ALT_NONE, false);
+	alt_all &= ~revert_all;
+	alt_none &= ~revert_none;
+
+	spin_unlock(&alt_lock);
+
+	/* Drop sites fetched before the coldboot HART patched them */
+	RISCV_FENCE_I;
+}
@@ -38,3 +38,43 @@ void __bitmap_xor(unsigned long *dst, const unsigned long *bitmap1,
 	for (k = 0; k < nr; k++)
 		dst[k] = bitmap1[k] ^ bitmap2[k];
 }
+
+void __bitmap_andnot(unsigned long *dst, const unsigned long *bitmap1,
+		     const unsigned long *bitmap2, int bits)
+{
+	int k;
+	int nr = BITS_TO_LONGS(bits);
+
+	for (k = 0; k < nr; k++)
+		dst[k] = bitmap1[k] & ~bitmap2[k];
+}
+
+int __bitmap_weight(const unsigned long *bitmap, int bits)
+{
+	int k, w = 0;
+	int lim = bits / BITS_PER_LONG;
+
+	for (k = 0; k < lim; k++)
+		w += sbi_popcount(bitmap[k]);
+
+	if (bits % BITS_PER_LONG)
+		w += sbi_popcount(bitmap[k] & BITMAP_LAST_WORD_MASK(bits));
+
+	return w;
+}
+
+bool __bitmap_empty(const unsigned long *bitmap, int bits)
+{
+	int k;
+	int lim = bits / BITS_PER_LONG;
+
+	for (k = 0; k < lim; k++)
+		if (bitmap[k])
+			return false;
+
+	if (bits % BITS_PER_LONG)
+		if (bitmap[k] & BITMAP_LAST_WORD_MASK(bits))
+			return false;
+
+	return true;
+}
@@ -12,6 +12,18 @@
 
 #define BITOP_WORD(nr)		((nr) / BITS_PER_LONG)
 
+const unsigned char sbi_bitops_debruijn_table[BITS_PER_LONG] = {
+#if BITS_PER_LONG == 64
+	0,  1, 48,  2, 57, 49, 28,  3, 61, 58, 50, 42, 38, 29, 17,  4,
+	62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12,  5,
+	63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+	46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19,  9, 13,  8,  7,  6,
+#else
+	0,  1, 28,  2, 29, 14, 24,  3, 30, 22, 20, 15, 25, 17,  4,  8,
+	31, 27, 13, 23, 21, 19, 16,  7, 26, 12, 18,  6, 11,  5, 10,  9,
+#endif
+};
+
 /**
  * find_first_bit - find the first set bit in a memory region
  * @addr: The address to start the search at
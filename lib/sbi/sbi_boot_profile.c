@@ -0,0 +1,86 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/sbi_boot_profile.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_scratch.h>
+
+static struct sbi_boot_profile_phase boot_phases[SBI_BOOT_PROFILE_MAX_PHASES];
+static u32 boot_phase_count;
+static unsigned long boot_phase_last;
+
+/** Offset of warmboot cycles in scratch space */
+static unsigned long boot_warm_cycles_offset;
+
+void sbi_boot_profile_mark(const char *name)
+{
+	unsigned long now = sbi_boot_profile_cycles();
+	struct sbi_boot_profile_phase *p;
+
+	if (boot_phase_count < SBI_BOOT_PROFILE_MAX_PHASES) {
+		p = &boot_phases[boot_phase_count++];
+		p->name = name;
+		p->cycles = now - boot_phase_last;
+	}
+
+	boot_phase_last = now;
+}
+
+u32 sbi_boot_profile_phases(const struct sbi_boot_profile_phase **phases)
+{
+	*phases = boot_phases;
+
+	return boot_phase_count;
+}
+
+void sbi_boot_profile_warmboot(struct sbi_scratch *scratch,
+			       unsigned long cycles)
+{
+	if (!boot_warm_cycles_offset)
+		return;
+
+	sbi_scratch_write_type(scratch, unsigned long,
+			       boot_warm_cycles_offset, cycles);
+}
+
+void sbi_boot_profile_dump(void)
+{
+	struct sbi_scratch *scratch;
+	unsigned long total = 0, cycles;
+	u32 i;
+
+	for (i = 0; i < boot_phase_count; i++)
+		total += boot_phases[i].cycles;
+
+	sbi_printf("Boot Profile              : %lu cycles (coldboot)\n",
+		   total);
+	for (i = 0; i < boot_phase_count; i++)
+		sbi_printf("  %-24s: %lu\n", boot_phases[i].name,
+			   boot_phases[i].cycles);
+
+	if (!boot_warm_cycles_offset)
+		return;
+
+	/* Only HARTs started before the banner are reported here */
+	for (i = 0; i <= sbi_scratch_last_hartindex(); i++) {
+		scratch = sbi_hartindex_to_scratch(i);
+		if (!scratch)
+			continue;
+		cycles = sbi_scratch_read_type(scratch, unsigned long,
+					       boot_warm_cycles_offset);
+		if (cycles)
+			sbi_printf("  %-24s: %lu (HART%u)\n", "warmboot",
+				   cycles, sbi_hartindex_to_hartid(i));
+	}
+}
+
+int sbi_boot_profile_init(void)
+{
+	boot_warm_cycles_offset = sbi_scratch_alloc_type_offset(unsigned long);
+	if (!boot_warm_cycles_offset)
+		return SBI_ENOMEM;
+
+	return 0;
+}
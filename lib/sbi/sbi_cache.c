@@ -0,0 +1,100 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/sbi_cache.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_scratch.h>
+
+static const struct sbi_cache_device *cache_dev = NULL;
+
+const struct sbi_cache_device *sbi_cache_get_device(void)
+{
+	return cache_dev;
+}
+
+void sbi_cache_set_device(const struct sbi_cache_device *dev)
+{
+	if (!dev || cache_dev)
+		return;
+
+	cache_dev = dev;
+}
+
+void sbi_cache_set_way_mask(unsigned long mask)
+{
+	if (cache_dev && cache_dev->set_way_mask)
+		cache_dev->set_way_mask(current_hartid(), mask);
+}
+
+#ifdef CONFIG_SBI_CACHE_OPS
+
+/* The cbo.* instructions are I-type MISC-MEM encodings with a fixed imm */
+#define CBO_INSN(__imm, __addr)						\
+	__asm__ __volatile__(".insn i 0x0f, 2, x0, %0, " #__imm		\
+			     : : "r"(__addr) : "memory")
+
+static void cache_cbo_range_op(enum sbi_cache_op op, unsigned long addr,
+			       unsigned long size)
+{
+	unsigned long end = addr + size;
+
+	addr &= ~(CONFIG_SBI_CACHE_BLOCK_SIZE - 1UL);
+	switch (op) {
+	case SBI_CACHE_OP_CLEAN:
+		for (; addr < end; addr += CONFIG_SBI_CACHE_BLOCK_SIZE)
+			CBO_INSN(1, addr);
+		break;
+	case SBI_CACHE_OP_INVAL:
+		for (; addr < end; addr += CONFIG_SBI_CACHE_BLOCK_SIZE)
+			CBO_INSN(0, addr);
+		break;
+	default:
+		for (; addr < end; addr += CONFIG_SBI_CACHE_BLOCK_SIZE)
+			CBO_INSN(2, addr);
+		break;
+	}
+}
+
+int sbi_cache_range_op(unsigned long addr_lo, unsigned long addr_hi,
+		       unsigned long size, unsigned long op)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	unsigned long access = SBI_DOMAIN_READ;
+	int ret = 0;
+
+	if (op >= SBI_CACHE_OP_MAX)
+		return SBI_EINVAL;
+
+	if (!cache_dev &&
+	    !sbi_hart_has_extension(scratch, SBI_HART_EXT_ZICBOM))
+		return SBI_ENOTSUPP;
+
+	if (!size)
+		return 0;
+
+	/* M-mode can only access shared memory below 4GB on RV32 */
+	if (addr_hi || addr_lo + size < addr_lo)
+		return SBI_EINVALID_ADDR;
+
+	/* Dropping dirty data is as good as a write to the memory */
+	if (op != SBI_CACHE_OP_CLEAN)
+		access |= SBI_DOMAIN_WRITE;
+
+	if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(),
+					 addr_lo, size, PRV_S, access))
+		return SBI_EINVALID_ADDR;
+
+	sbi_hart_map_saddr(addr_lo, size);
+	if (cache_dev)
+		ret = cache_dev->cache_range_op(op, addr_lo, size);
+	else
+		cache_cbo_range_op(op, addr_lo, size);
+	sbi_hart_unmap_saddr();
+
+	return ret;
+}
+#endif
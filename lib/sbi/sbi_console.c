@@ -7,11 +7,14 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <sbi/riscv_barrier.h>
 #include <sbi/riscv_locks.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_hart.h>
+#include <sbi/sbi_lockstat.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_scratch.h>
+#include <sbi/sbi_static_call.h>
 #include <sbi/sbi_string.h>
 
 #define CONSOLE_TBUF_MAX 256
@@ -20,6 +23,18 @@ static const struct sbi_console_device *console_dev = NULL;
 static char console_tbuf[CONSOLE_TBUF_MAX];
 static u32 console_tbuf_len;
 static spinlock_t console_out_lock	       = SPIN_LOCK_INITIALIZER;
+SBI_LOCKSTAT_DEFINE(console_out_lock, &console_out_lock);
+
+/* Targets of the console output callers before the device */
+static void console_putc_none(char ch) { }
+
+static unsigned long console_puts_none(const char *str, unsigned long len)
+{
+	return len;
+}
+
+SBI_STATIC_CALL_DEFINE(console_putc, console_putc_none);
+SBI_STATIC_CALL_DEFINE(console_puts, console_puts_none);
 
 bool sbi_isprintable(char c)
 {
@@ -30,8 +45,77 @@ bool sbi_isprintable(char c)
 	return false;
 }
 
+#ifdef CONFIG_SBI_CONSOLE_RX_IRQ
+
+/*
+ * Once the RX interrupt is used, console input is only read from the
+ * device by the interrupt handler of the HART the interrupt is routed
+ * to. It fills a ring buffer which the readers, serialized by
+ * console_in_lock, consume without touching the device.
+ */
+#define CONSOLE_RX_RING_SIZE	(1UL << CONFIG_SBI_CONSOLE_RX_RING_SHIFT)
+#define CONSOLE_RX_RING_MASK	(CONSOLE_RX_RING_SIZE - 1)
+
+static char console_rx_ring[CONSOLE_RX_RING_SIZE];
+static unsigned long console_rx_head;
+static unsigned long console_rx_tail;
+static spinlock_t console_in_lock	       = SPIN_LOCK_INITIALIZER;
+static bool console_rx_irq_ready;
+
+void sbi_console_rx_irq_init(void)
+{
+	if (!console_dev || !console_dev->console_rx_irq_enable ||
+	    !console_dev->console_getc)
+		return;
+
+	__smp_store_release(&console_rx_irq_ready, true);
+	console_dev->console_rx_irq_enable(true);
+}
+
+void sbi_console_rx_irq_process(void)
+{
+	unsigned long head = console_rx_head;
+	int ch;
+
+	if (!console_rx_irq_ready)
+		return;
+
+	/* Empty the device FIFO, input not fitting the ring is dropped */
+	while ((ch = console_dev->console_getc()) >= 0) {
+		if (CONSOLE_RX_RING_SIZE <=
+		    head - __smp_load_acquire(&console_rx_tail))
+			continue;
+		console_rx_ring[head++ & CONSOLE_RX_RING_MASK] = ch;
+	}
+
+	__smp_store_release(&console_rx_head, head);
+}
+
+static unsigned long console_rx_read(char *str, unsigned long len)
+{
+	unsigned long head, tail, i;
+
+	spin_lock(&console_in_lock);
+	tail = console_rx_tail;
+	head = __smp_load_acquire(&console_rx_head);
+	for (i = 0; i < len && tail != head; i++)
+		str[i] = console_rx_ring[tail++ & CONSOLE_RX_RING_MASK];
+	__smp_store_release(&console_rx_tail, tail);
+	spin_unlock(&console_in_lock);
+
+	return i;
+}
+
+#endif
+
 int sbi_getc(void)
 {
+#ifdef CONFIG_SBI_CONSOLE_RX_IRQ
+	char ch;
+
+	if (__smp_load_acquire(&console_rx_irq_ready))
+		return console_rx_read(&ch, 1) ? (u8)ch : -1;
+#endif
 	if (console_dev && console_dev->console_getc)
 		return console_dev->console_getc();
 	return -1;
@@ -43,12 +127,12 @@ static unsigned long nputs(const char *str, unsigned long len)
 
 	if (console_dev) {
 		if (console_dev->console_puts)
-			return console_dev->console_puts(str, len);
+			return sbi_static_call(console_puts)(str, len);
 		else if (console_dev->console_putc) {
 			for (i = 0; i < len; i++) {
 				if (str[i] == '\n')
-					console_dev->console_putc('\r');
-				console_dev->console_putc(str[i]);
+					sbi_static_call(console_putc)('\r');
+				sbi_static_call(console_putc)(str[i]);
 			}
 		}
 	}
@@ -63,17 +147,172 @@ static void nputs_all(const char *str, unsigned long len)
 		p += nputs(&str[p], len - p);
 }
 
+#ifdef CONFIG_SBI_CONSOLE_RING
+
+/*
+ * Console output is copied into a ring buffer and written to the console
+ * device later by whichever HART drains the ring first. Producers are
+ * serialized by console_out_lock, the consumer by console_drain_lock, so
+ * producers never wait for the console device unless the ring is full.
+ */
+#define CONSOLE_RING_SIZE	(1UL << CONFIG_SBI_CONSOLE_RING_SHIFT)
+#define CONSOLE_RING_MASK	(CONSOLE_RING_SIZE - 1)
+
+static char console_ring[CONSOLE_RING_SIZE];
+static unsigned long console_ring_head;
+static unsigned long console_ring_tail;
+static spinlock_t console_drain_lock	       = SPIN_LOCK_INITIALIZER;
+
+static void console_ring_drain(void)
+{
+	unsigned long head, tail, off, len;
+
+	if (!spin_trylock(&console_drain_lock))
+		return;
+
+	tail = console_ring_tail;
+	while ((head = __smp_load_acquire(&console_ring_head)) != tail) {
+		off = tail & CONSOLE_RING_MASK;
+		len = head - tail;
+		if (len > CONSOLE_RING_SIZE - off)
+			len = CONSOLE_RING_SIZE - off;
+
+		tail += nputs(&console_ring[off], len);
+		__smp_store_release(&console_ring_tail, tail);
+	}
+
+	spin_unlock(&console_drain_lock);
+}
+
+/* Must be called with console_out_lock held */
+static void console_write(const char *str, unsigned long len)
+{
+	unsigned long head = console_ring_head, off, chunk, space;
+
+	while (len) {
+		/* Drain synchronously when the ring is full */
+		while (!(space = CONSOLE_RING_SIZE -
+			 (head - __smp_load_acquire(&console_ring_tail))))
+			console_ring_drain();
+
+		off = head & CONSOLE_RING_MASK;
+		chunk = CONSOLE_RING_SIZE - off;
+		if (chunk > space)
+			chunk = space;
+		if (chunk > len)
+			chunk = len;
+
+		sbi_memcpy(&console_ring[off], str, chunk);
+		head += chunk;
+		str += chunk;
+		len -= chunk;
+		__smp_store_release(&console_ring_head, head);
+	}
+}
+
+#ifdef CONFIG_SBI_CONSOLE_TX_IRQ
+
+/* Maximum bytes written to the console device per TX empty interrupt */
+#define CONSOLE_TX_IRQ_CHUNK	16
+
+static bool console_tx_irq_ready;
+
+/* Must be called with console_out_lock held */
+static unsigned long console_write_nowait(const char *str, unsigned long len)
+{
+	unsigned long space;
+
+	space = CONSOLE_RING_SIZE -
+		(console_ring_head - __smp_load_acquire(&console_ring_tail));
+	if (!space) {
+		console_ring_drain();
+		space = CONSOLE_RING_SIZE - (console_ring_head -
+				__smp_load_acquire(&console_ring_tail));
+	}
+	if (len > space)
+		len = space;
+
+	console_write(str, len);
+
+	return len;
+}
+
+void sbi_console_tx_irq_init(void)
+{
+	if (console_dev && console_dev->console_tx_irq_enable)
+		console_tx_irq_ready = true;
+}
+
+void sbi_console_tx_irq_process(void)
+{
+	unsigned long head, tail, off, len;
+
+	if (!console_tx_irq_ready || !spin_trylock(&console_drain_lock))
+		return;
+
+	tail = console_ring_tail;
+	head = __smp_load_acquire(&console_ring_head);
+	if (head != tail) {
+		off = tail & CONSOLE_RING_MASK;
+		len = head - tail;
+		if (len > CONSOLE_RING_SIZE - off)
+			len = CONSOLE_RING_SIZE - off;
+		if (len > CONSOLE_TX_IRQ_CHUNK)
+			len = CONSOLE_TX_IRQ_CHUNK;
+
+		tail += nputs(&console_ring[off], len);
+		__smp_store_release(&console_ring_tail, tail);
+	}
+
+	/* Re-check after disabling to not miss newly queued output */
+	if (head == tail) {
+		console_dev->console_tx_irq_enable(false);
+		if (__smp_load_acquire(&console_ring_head) != tail)
+			console_dev->console_tx_irq_enable(true);
+	}
+
+	spin_unlock(&console_drain_lock);
+}
+
+#endif
+
+void sbi_console_drain(void)
+{
+	if (console_ring_tail != console_ring_head)
+		console_ring_drain();
+}
+
+void sbi_console_flush(void)
+{
+	while (__smp_load_acquire(&console_ring_tail) !=
+	       __smp_load_acquire(&console_ring_head))
+		console_ring_drain();
+}
+
+void sbi_putc(char ch)
+{
+	spin_lock(&console_out_lock);
+	console_write(&ch, 1);
+	spin_unlock(&console_out_lock);
+}
+
+#else
+
+#define console_write(__str, __len)	nputs_all(__str, __len)
+
 void sbi_putc(char ch)
 {
 	nputs_all(&ch, 1);
 }
 
+#endif
+
 void sbi_puts(const char *str)
 {
 	unsigned long len = sbi_strlen(str);
 
 	spin_lock(&console_out_lock);
-	nputs_all(str, len);
+	console_write(str, len);
 	spin_unlock(&console_out_lock);
 }
 
@@ -82,7 +321,22 @@ unsigned long sbi_nputs(const char *str, unsigned long len)
 	unsigned long ret;
 
 	spin_lock(&console_out_lock);
+#ifdef CONFIG_SBI_CONSOLE_TX_IRQ
+	if (console_tx_irq_ready) {
+		/* Only queue what fits and let the interrupt drain it */
+		ret = console_write_nowait(str, len);
+		spin_unlock(&console_out_lock);
+		if (ret)
+			console_dev->console_tx_irq_enable(true);
+		return ret;
+	}
+#endif
+#ifdef CONFIG_SBI_CONSOLE_RING
+	console_write(str, len);
+	ret = len;
+#else
 	ret = nputs(str, len);
+#endif
 	spin_unlock(&console_out_lock);
 
 	return ret;
@@ -106,6 +360,12 @@ unsigned long sbi_ngets(char *str, unsigned long len)
 	int ch;
 	unsigned long i;
 
+#ifdef CONFIG_SBI_CONSOLE_RX_IRQ
+	/* Return all the buffered input at once */
+	if (__smp_load_acquire(&console_rx_irq_ready))
+		return console_rx_read(str, len);
+#endif
+
 	for (i = 0; i < len; i++) {
 		ch = sbi_getc();
 		if (ch < 0)
@@ -153,21 +413,55 @@ static void printc(char **out, u32 *out_len, char ch, int flags)
 	}
 }
 
+/* Same as printc() for a whole string, copied in as few chunks as possible */
+static void printn(char **out, u32 *out_len, const char *str, u32 len,
+		   int flags)
+{
+	u32 n;
+
+	if (!out) {
+		while (len--)
+			sbi_putc(*str++);
+		return;
+	}
+
+	if (!out_len) {
+		sbi_memcpy(*out, str, len);
+		*out += len;
+		**out = '\0';
+		return;
+	}
+
+	while (len && *out_len > 1) {
+		n = (len < *out_len - 1) ? len : *out_len - 1;
+		sbi_memcpy(*out, str, n);
+		*out += n;
+		**out = '\0';
+		*out_len -= n;
+		str += n;
+		len -= n;
+		if ((flags & USE_TBUF) && *out_len == 1) {
+			nputs_all(console_tbuf, CONSOLE_TBUF_MAX - *out_len);
+			*out = console_tbuf;
+			*out_len = CONSOLE_TBUF_MAX;
+		}
+	}
+}
+
 static int prints(char **out, u32 *out_len, const char *string, int width,
 		  int flags)
 {
-	int pc = 0;
-	width -= sbi_strlen(string);
+	int pc = 0, len = sbi_strlen(string);
+
+	width -= len;
 	if (!(flags & PAD_RIGHT)) {
 		for (; width > 0; --width) {
 			printc(out, out_len, flags & PAD_ZERO ? '0' : ' ', flags);
 			++pc;
 		}
 	}
-	for (; *string; ++string) {
-		printc(out, out_len, *string, flags);
-		++pc;
-	}
+	printn(out, out_len, string, len, flags);
+	pc += len;
 	for (; width > 0; --width) {
 		printc(out, out_len, ' ', flags);
 		++pc;
@@ -176,12 +470,51 @@ static int prints(char **out, u32 *out_len, const char *string, int width,
 	return pc;
 }
 
+/*
+ * Divide by 10 without a 64-bit division, which is a libgcc call on RV32.
+ * Values fitting in 32 bits use the compiler's reciprocal multiply and
+ * larger ones the shift-and-add reciprocal from Hacker's Delight.
+ */
+static inline unsigned long long printi_udiv10(unsigned long long n,
+					       unsigned int *rem)
+{
+#if __riscv_xlen == 32
+	unsigned long long q, r;
+	u32 w = n;
+
+	if (!(n >> 32)) {
+		*rem = w % 10;
+		return w / 10;
+	}
+
+	q = (n >> 1) + (n >> 2);
+	q += q >> 4;
+	q += q >> 8;
+	q += q >> 16;
+	q += q >> 32;
+	q >>= 3;
+	r = n - ((q << 3) + (q << 1));
+	if (r > 9) {
+		q++;
+		r -= 10;
+	}
+	*rem = r;
+	return q;
+#else
+	*rem = n % 10;
+	return n / 10;
+#endif
+}
+
 static int printi(char **out, u32 *out_len, long long i,
 		  int width, int flags, int type)
 {
+	static const char digits[] = "0123456789abcdef0123456789ABCDEF";
 	int pc = 0;
 	char *s, sign = 0, letbase, print_buf[PRINT_BUF_LEN];
-	unsigned long long u, b, t;
+	const char *dtab;
+	unsigned long long u, b;
+	unsigned int t;
 
 	b = 10;
 	letbase = 'a';
@@ -209,13 +542,21 @@ static int printi(char **out, u32 *out_len, long long i,
 
 	if (!u) {
 		*--s = '0';
+	} else if (b == 16) {
+		dtab = (letbase == 'a') ? digits : digits + 16;
+		while (u) {
+			*--s = dtab[u & 0xf];
+			u >>= 4;
+		}
+	} else if (b == 8) {
+		while (u) {
+			*--s = '0' + (u & 0x7);
+			u >>= 3;
+		}
 	} else {
 		while (u) {
-			t = u % b;
-			u = u / b;
-			if (t >= 10)
-				t += letbase - '0' - 10;
-			*--s = t + '0';
+			u = printi_udiv10(u, &t);
+			*--s = '0' + t;
 		}
 	}
 
@@ -385,7 +726,7 @@ literal:
 	}
 
 	if (use_tbuf && console_tbuf_len < CONSOLE_TBUF_MAX)
-		nputs_all(console_tbuf, CONSOLE_TBUF_MAX - console_tbuf_len);
+		console_write(console_tbuf, CONSOLE_TBUF_MAX - console_tbuf_len);
 
 	return pc;
 }
@@ -462,6 +803,8 @@ void sbi_panic(const char *format, ...)
 	va_end(args);
 	spin_unlock(&console_out_lock);
 
+	sbi_console_flush();
+
 	sbi_hart_hang();
 }
 
@@ -476,6 +819,8 @@ void sbi_console_set_device(const struct sbi_console_device *dev)
 		return;
 
 	console_dev = dev;
+	sbi_static_call_update(console_putc, dev->console_putc);
+	sbi_static_call_update(console_puts, dev->console_puts);
 }
 
 int sbi_console_init(struct sbi_scratch *scratch)
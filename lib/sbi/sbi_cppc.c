@@ -7,6 +7,11 @@
 
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_cppc.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_timer.h>
 
 static const struct sbi_cppc_device *cppc_dev = NULL;
 
@@ -108,3 +113,116 @@ int sbi_cppc_write(unsigned long reg, uint64_t val)
 
 	return cppc_dev->cppc_write(reg, val);
 }
+
+#ifdef CONFIG_SBI_CPPC_SHMEM
+/** Shared memory layout of the CPPC performance request channel */
+struct cppc_shmem {
+	/* Desired performance level requested by S-mode */
+	uint64_t desired_perf;
+	/* Desired performance level last applied by the firmware */
+	uint64_t applied_perf;
+	/* Error code of the last write to the CPPC device */
+	int64_t status;
+};
+
+/** Per-HART state of the CPPC performance request channel */
+struct cppc_shmem_hart {
+	struct sbi_timer_event ev;
+	/* Physical address of the shared memory or zero if disabled */
+	unsigned long shmem;
+	/* Last desired performance level seen in the shared memory */
+	uint64_t desired_perf;
+};
+
+static SBI_SCRATCH_DEFINE(struct cppc_shmem_hart, cppc_shmem_hart);
+
+void sbi_cppc_shmem_process(void)
+{
+	struct cppc_shmem_hart *ch = sbi_scratch_thishart_var_ptr(cppc_shmem_hart);
+	struct cppc_shmem *shm = (struct cppc_shmem *)ch->shmem;
+	uint64_t perf;
+	int ret;
+
+	if (!shm)
+		return;
+
+	sbi_hart_map_saddr(ch->shmem, sizeof(*shm));
+	perf = shm->desired_perf;
+	if (perf != ch->desired_perf) {
+		/* A failed request is not retried until S-mode changes it */
+		ch->desired_perf = perf;
+		ret = sbi_cppc_write(SBI_CPPC_DESIRED_PERF, perf);
+		if (!ret)
+			shm->applied_perf = perf;
+		shm->status = ret;
+	}
+	sbi_hart_unmap_saddr();
+}
+
+static void cppc_shmem_event_callback(struct sbi_timer_event *ev)
+{
+	const struct sbi_timer_device *tdev = sbi_timer_get_device();
+
+	sbi_cppc_shmem_process();
+
+	ev->deadline = sbi_timer_value() +
+		       (u64)tdev->timer_freq * CONFIG_SBI_CPPC_SHMEM_POLL_US /
+		       1000000 + 1;
+	sbi_timer_event_add(ev);
+}
+
+int sbi_cppc_set_shmem(unsigned long shmem_lo, unsigned long shmem_hi,
+		       unsigned long flags)
+{
+	struct cppc_shmem_hart *ch = sbi_scratch_thishart_var_ptr(cppc_shmem_hart);
+	const struct sbi_timer_device *tdev = sbi_timer_get_device();
+	struct cppc_shmem *shm;
+	uint64_t perf;
+
+	if (flags)
+		return SBI_EINVAL;
+
+	if (shmem_lo == SBI_CPPC_SHMEM_DISABLE &&
+	    shmem_hi == SBI_CPPC_SHMEM_DISABLE) {
+		sbi_timer_event_cancel(&ch->ev);
+		ch->shmem = 0;
+		return 0;
+	}
+
+	if (!cppc_dev || !cppc_dev->cppc_write || !tdev || !tdev->timer_freq)
+		return SBI_ENOTSUPP;
+
+	if (shmem_lo & (sizeof(uint64_t) - 1))
+		return SBI_EINVAL;
+
+	/* M-mode can only access shared memory below 4GB on RV32 */
+	if (shmem_hi)
+		return SBI_EINVALID_ADDR;
+
+	if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(),
+					 shmem_lo, sizeof(*shm), PRV_S,
+					 SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_EINVALID_ADDR;
+
+	/* Start from the current performance level */
+	if (sbi_cppc_read(SBI_CPPC_DESIRED_PERF, &perf))
+		perf = 0;
+
+	shm = (struct cppc_shmem *)shmem_lo;
+	sbi_hart_map_saddr(shmem_lo, sizeof(*shm));
+	shm->desired_perf = perf;
+	shm->applied_perf = perf;
+	shm->status = 0;
+	sbi_hart_unmap_saddr();
+
+	ch->desired_perf = perf;
+	ch->shmem = shmem_lo;
+
+	if (ch->ev.queued)
+		return 0;
+
+	ch->ev.callback = cppc_shmem_event_callback;
+	ch->ev.deadline = sbi_timer_value();
+	return sbi_timer_event_add(&ch->ev);
+}
+#endif
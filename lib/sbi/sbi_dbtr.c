@@ -7,6 +7,7 @@
  *   Himanshu Chauhan <hchauhan@ventanamicro.com>
  */
 
+#include <sbi/sbi_bitops.h>
 #include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_csr_detect.h>
 #include <sbi/sbi_platform.h>
@@ -23,6 +24,8 @@
 /** Offset of pointer to HART's debug triggers info in scratch space */
 static unsigned long hart_state_ptr_offset;
 
+SBI_HEAP_NEED(dbtr, 0, sizeof(struct sbi_dbtr_hart_triggers_state));
+
 #define dbtr_get_hart_state_ptr(__scratch)				\
 	sbi_scratch_read_type((__scratch), void *, hart_state_ptr_offset)
 
@@ -74,6 +77,37 @@ static inline void *hart_shmem_base(
 			hs->shmem.phys_hi, hs->shmem.phys_lo));
 }
 
+/*
+ * Map the first count entries of the shared memory of a hart for the
+ * duration of one call, returns NULL when the domain does not allow
+ * S-mode to access all of them.
+ */
+static void *dbtr_shmem_map(struct sbi_dbtr_hart_triggers_state *hs,
+			    unsigned long count)
+{
+	unsigned long base = (unsigned long)hart_shmem_base(hs);
+	unsigned long size = (count ? count : 1) *
+			     sizeof(struct sbi_dbtr_shmem_entry);
+
+	if (!sbi_domain_check_shmem(base, size,
+				    SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return NULL;
+
+	sbi_hart_map_saddr(base, size);
+
+	return (void *)base;
+}
+
+/* Number of shared memory entries used by a trigger index mask */
+static unsigned long dbtr_mask_entries(struct sbi_dbtr_hart_triggers_state *hs,
+				       unsigned long trig_mask)
+{
+	if (hs->total_trigs < BITS_PER_LONG)
+		trig_mask &= BIT(hs->total_trigs) - 1;
+
+	return sbi_popcount(trig_mask);
+}
+
 static void sbi_trigger_init(struct sbi_dbtr_trigger *trig,
 			     unsigned long type_mask, unsigned long idx)
 {
@@ -85,9 +119,21 @@ static void sbi_trigger_init(struct sbi_dbtr_trigger *trig,
 	trig->index = idx;
 }
 
-static inline struct sbi_dbtr_trigger *sbi_alloc_trigger(void)
+/* Bitmap of free triggers in free_mask supporting the given type */
+static inline unsigned long dbtr_free_of_type(
+	struct sbi_dbtr_hart_triggers_state *hs,
+	unsigned long free_mask, unsigned long type)
+{
+	if (type >= SBI_DBTR_TRIG_TYPE_MAX)
+		return 0;
+
+	return free_mask & hs->type_trigs[type];
+}
+
+static inline struct sbi_dbtr_trigger *sbi_alloc_trigger(unsigned long type)
 {
 	int i;
+	unsigned long mask;
 	struct sbi_dbtr_trigger *f_trig = NULL;
 	struct sbi_dbtr_hart_triggers_state *hart_state;
 
@@ -95,20 +141,17 @@ static inline struct sbi_dbtr_trigger *sbi_alloc_trigger(void)
 	if (!hart_state)
 		return NULL;
 
-	if (hart_state->available_trigs <= 0)
+	mask = dbtr_free_of_type(hart_state, hart_state->free_trigs, type);
+	if (!mask) {
+		hart_state->alloc_failures++;
 		return NULL;
-
-	for (i = 0; i < hart_state->total_trigs; i++) {
-		f_trig = INDEX_TO_TRIGGER(i);
-		if (f_trig->state & RV_DBTR_BIT_MASK(TS, MAPPED))
-			continue;
-		hart_state->available_trigs--;
-		break;
 	}
 
-	if (i == hart_state->total_trigs)
-		return NULL;
+	i = sbi_ffs(mask);
+	hart_state->free_trigs &= ~BIT(i);
+	hart_state->available_trigs--;
 
+	f_trig = INDEX_TO_TRIGGER(i);
 	__set_bit(RV_DBTR_BIT(TS, MAPPED), &f_trig->state);
 
 	return f_trig;
@@ -130,6 +173,7 @@ static inline void sbi_free_trigger(struct sbi_dbtr_trigger *trig)
 	trig->tdata2 = 0;
 	trig->tdata3 = 0;
 
+	hart_state->free_trigs |= BIT(trig->index);
 	hart_state->available_trigs++;
 }
 
@@ -138,7 +182,7 @@ int sbi_dbtr_init(struct sbi_scratch *scratch, bool coldboot)
 	struct sbi_trap_info trap = {0};
 	unsigned long tdata1;
 	unsigned long val;
-	int i;
+	int i, j;
 	struct sbi_dbtr_hart_triggers_state *hart_state = NULL;
 
 	if (!sbi_hart_has_extension(scratch, SBI_HART_EXT_SDTRIG))
@@ -210,10 +254,23 @@ int sbi_dbtr_init(struct sbi_scratch *scratch, bool coldboot)
 		}
 	}
 
+	for (i = 0; i < hart_state->total_trigs; i++) {
+		val = INDEX_TO_TRIGGER(i)->type_mask;
+		for (j = 0; j < SBI_DBTR_TRIG_TYPE_MAX; j++) {
+			if (val & BIT(j))
+				hart_state->type_trigs[j] |= BIT(i);
+		}
+	}
+
 	hart_state->probed = 1;
 
  _probed:
-	hart_state->available_trigs = hart_state->total_trigs;
+	hart_state->free_trigs = 0;
+	for (i = 0; i < hart_state->total_trigs; i++) {
+		if (!(INDEX_TO_TRIGGER(i)->state & RV_DBTR_BIT_MASK(TS, MAPPED)))
+			hart_state->free_trigs |= BIT(i);
+	}
+	hart_state->available_trigs = sbi_popcount(hart_state->free_trigs);
 
 	return SBI_SUCCESS;
 }
@@ -522,19 +579,21 @@ int sbi_dbtr_read_trig(unsigned long smode,
 	if (sbi_dbtr_shmem_disabled(hs))
 		return SBI_ERR_NO_SHMEM;
 
-	shmem_base = hart_shmem_base(hs);
+	shmem_base = dbtr_shmem_map(hs, trig_count);
+	if (!shmem_base)
+		return SBI_ERR_INVALID_ADDRESS;
 
 	for_each_trig_entry(shmem_base, trig_count, typeof(*entry), entry) {
-		sbi_hart_map_saddr((unsigned long)entry, sizeof(*entry));
 		xmit = &entry->data;
 		trig = INDEX_TO_TRIGGER((_idx + trig_idx_base));
 		xmit->tstate = cpu_to_lle(trig->state);
 		xmit->tdata1 = cpu_to_lle(trig->tdata1);
 		xmit->tdata2 = cpu_to_lle(trig->tdata2);
 		xmit->tdata3 = cpu_to_lle(trig->tdata3);
-		sbi_hart_unmap_saddr();
 	}
 
+	sbi_hart_unmap_saddr();
+
 	return SBI_SUCCESS;
 }
 
@@ -545,7 +604,7 @@ int sbi_dbtr_install_trig(unsigned long smode,
 	struct sbi_dbtr_shmem_entry *entry;
 	struct sbi_dbtr_data_msg *recv;
 	struct sbi_dbtr_id_msg *xmit;
-	unsigned long ctrl;
+	unsigned long ctrl, free_mask, mask;
 	struct sbi_dbtr_trigger *trig;
 	struct sbi_dbtr_hart_triggers_state *hs = NULL;
 
@@ -556,52 +615,62 @@ int sbi_dbtr_install_trig(unsigned long smode,
 	if (sbi_dbtr_shmem_disabled(hs))
 		return SBI_ERR_NO_SHMEM;
 
-	shmem_base = hart_shmem_base(hs);
+	if (hs->available_trigs < trig_count) {
+		hs->alloc_failures++;
+		*out = hs->available_trigs;
+		return SBI_ERR_FAILED;
+	}
+
+	shmem_base = dbtr_shmem_map(hs, trig_count);
+	if (!shmem_base)
+		return SBI_ERR_INVALID_ADDRESS;
 
-	/* Check requested triggers configuration */
+	/*
+	 * Check requested triggers configuration and that a trigger of
+	 * each requested type can be allocated. The allocation below
+	 * makes the same choices.
+	 */
+	free_mask = hs->free_trigs;
 	for_each_trig_entry(shmem_base, trig_count, typeof(*entry), entry) {
-		sbi_hart_map_saddr((unsigned long)entry, sizeof(*entry));
 		recv = (struct sbi_dbtr_data_msg *)(&entry->data);
 		ctrl = recv->tdata1;
 
-		if (!dbtr_trigger_supported(TDATA1_GET_TYPE(ctrl))) {
+		if (!dbtr_trigger_supported(TDATA1_GET_TYPE(ctrl)) ||
+		    !dbtr_trigger_valid(TDATA1_GET_TYPE(ctrl), ctrl)) {
 			*out = _idx;
 			sbi_hart_unmap_saddr();
 			return SBI_ERR_FAILED;
 		}
 
-		if (!dbtr_trigger_valid(TDATA1_GET_TYPE(ctrl), ctrl)) {
+		mask = dbtr_free_of_type(hs, free_mask, TDATA1_GET_TYPE(ctrl));
+		if (!mask) {
+			hs->alloc_failures++;
 			*out = _idx;
 			sbi_hart_unmap_saddr();
 			return SBI_ERR_FAILED;
 		}
-		sbi_hart_unmap_saddr();
-	}
-
-	if (hs->available_trigs < trig_count) {
-		*out = hs->available_trigs;
-		return SBI_ERR_FAILED;
+		free_mask &= ~BIT(sbi_ffs(mask));
 	}
 
 	/* Install triggers */
 	for_each_trig_entry(shmem_base, trig_count, typeof(*entry), entry) {
+		recv = (struct sbi_dbtr_data_msg *)(&entry->data);
+
 		/*
-		 * Since we have already checked if enough triggers are
-		 * available, trigger allocation must succeed.
+		 * Since we have already checked if enough triggers of each
+		 * type are available, trigger allocation must succeed.
 		 */
-		trig = sbi_alloc_trigger();
+		trig = sbi_alloc_trigger(TDATA1_GET_TYPE(recv->tdata1));
 
-		sbi_hart_map_saddr((unsigned long)entry, sizeof(*entry));
-
-		recv = (struct sbi_dbtr_data_msg *)(&entry->data);
 		xmit = (struct sbi_dbtr_id_msg *)(&entry->id);
 
 		dbtr_trigger_setup(trig,  recv);
 		dbtr_trigger_enable(trig);
 		xmit->idx = cpu_to_lle(trig->index);
-		sbi_hart_unmap_saddr();
 	}
 
+	sbi_hart_unmap_saddr();
+
 	return SBI_SUCCESS;
 }
 
@@ -671,13 +740,17 @@ int sbi_dbtr_update_trig(unsigned long smode,
 	if (sbi_dbtr_shmem_disabled(hs))
 		return SBI_ERR_NO_SHMEM;
 
-	shmem_base = hart_shmem_base(hs);
+	shmem_base = dbtr_shmem_map(hs, dbtr_mask_entries(hs, trig_mask));
+	if (!shmem_base)
+		return SBI_ERR_INVALID_ADDRESS;
 
 	for_each_set_bit_from(idx, &trig_mask, hs->total_trigs) {
 		trig = INDEX_TO_TRIGGER(idx);
 
-		if (!(trig->state & RV_DBTR_BIT_MASK(TS, MAPPED)))
+		if (!(trig->state & RV_DBTR_BIT_MASK(TS, MAPPED))) {
+			sbi_hart_unmap_saddr();
 			return SBI_ERR_INVALID_PARAM;
+		}
 
 		entry = (shmem_base + uidx * sizeof(*entry));
 		recv = &entry->data;
@@ -687,6 +760,128 @@ int sbi_dbtr_update_trig(unsigned long smode,
 		uidx++;
 	}
 
+	sbi_hart_unmap_saddr();
+
+	return SBI_SUCCESS;
+}
+
+/*
+ * Program a trigger to the requested configuration writing only what
+ * changed. Returns true if any trigger CSR was written.
+ */
+static bool dbtr_trigger_apply(struct sbi_dbtr_trigger *trig,
+			       struct sbi_dbtr_data_msg *recv)
+{
+	unsigned long tdata1 = lle_to_cpu(recv->tdata1);
+	unsigned long tdata2 = lle_to_cpu(recv->tdata2);
+	unsigned long tdata3 = lle_to_cpu(recv->tdata3);
+	struct sbi_dbtr_hart_triggers_state *hs = dbtr_thishart_state_ptr();
+	bool mapped = trig->state & RV_DBTR_BIT_MASK(TS, MAPPED);
+
+	if (!tdata1) {
+		if (!mapped)
+			return false;
+
+		dbtr_trigger_clear(trig);
+		sbi_free_trigger(trig);
+		return true;
+	}
+
+	if (mapped && trig->tdata1 == tdata1 &&
+	    trig->tdata2 == tdata2 && trig->tdata3 == tdata3)
+		return false;
+
+	if (!mapped || trig->tdata2 != tdata2) {
+		if (!mapped) {
+			hs->free_trigs &= ~BIT(trig->index);
+			hs->available_trigs--;
+		}
+		dbtr_trigger_setup(trig, recv);
+		dbtr_trigger_enable(trig);
+		return true;
+	}
+
+	/* Only the control changed so tdata2 can stay as it is */
+	dbtr_trigger_setup(trig, recv);
+	csr_write(CSR_TSELECT, trig->index);
+	csr_write(CSR_TDATA1, trig->tdata1);
+
+	return true;
+}
+
+int sbi_dbtr_apply_trig(unsigned long trig_idx_base,
+			unsigned long trig_idx_mask, unsigned long *out)
+{
+	unsigned long trig_mask = trig_idx_mask << trig_idx_base;
+	unsigned long idx = trig_idx_base;
+	struct sbi_dbtr_data_msg *recv;
+	struct sbi_dbtr_trigger *trig;
+	struct sbi_dbtr_shmem_entry *entry;
+	unsigned long uidx = 0, ctrl, written = 0;
+	void *shmem_base = NULL;
+	struct sbi_dbtr_hart_triggers_state *hs = NULL;
+
+	hs = dbtr_thishart_state_ptr();
+	if (!hs)
+		return SBI_ERR_FAILED;
+
+	if (sbi_dbtr_shmem_disabled(hs))
+		return SBI_ERR_NO_SHMEM;
+
+	shmem_base = dbtr_shmem_map(hs, dbtr_mask_entries(hs, trig_mask));
+	if (!shmem_base)
+		return SBI_ERR_INVALID_ADDRESS;
+
+	/* Check the whole requested set before touching any trigger */
+	for_each_set_bit_from(idx, &trig_mask, hs->total_trigs) {
+		entry = (shmem_base + uidx * sizeof(*entry));
+		ctrl = lle_to_cpu(entry->data.tdata1);
+
+		trig = INDEX_TO_TRIGGER(idx);
+		if (ctrl && (!dbtr_trigger_supported(TDATA1_GET_TYPE(ctrl)) ||
+			     !dbtr_trigger_valid(TDATA1_GET_TYPE(ctrl), ctrl) ||
+			     !__test_bit(TDATA1_GET_TYPE(ctrl), &trig->type_mask))) {
+			*out = uidx;
+			sbi_hart_unmap_saddr();
+			return SBI_ERR_FAILED;
+		}
+		uidx++;
+	}
+
+	idx = trig_idx_base;
+	uidx = 0;
+	for_each_set_bit_from(idx, &trig_mask, hs->total_trigs) {
+		trig = INDEX_TO_TRIGGER(idx);
+		entry = (shmem_base + uidx * sizeof(*entry));
+
+		recv = &entry->data;
+		if (dbtr_trigger_apply(trig, recv))
+			written++;
+		uidx++;
+	}
+
+	sbi_hart_unmap_saddr();
+
+	*out = written;
+
+	return SBI_SUCCESS;
+}
+
+int sbi_dbtr_alloc_failures(unsigned long flags, unsigned long *out)
+{
+	struct sbi_dbtr_hart_triggers_state *hs;
+
+	if (flags & ~SBI_EXT_OPENSBI_DBTR_FLAG_CLEAR)
+		return SBI_ERR_INVALID_PARAM;
+
+	hs = dbtr_thishart_state_ptr();
+	if (!hs)
+		return SBI_ERR_FAILED;
+
+	*out = hs->alloc_failures;
+	if (flags & SBI_EXT_OPENSBI_DBTR_FLAG_CLEAR)
+		hs->alloc_failures = 0;
+
 	return SBI_SUCCESS;
 }
 
@@ -10,24 +10,32 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_domain.h>
+#include <sbi/sbi_domain_context.h>
+#include <sbi/sbi_hart.h>
 #include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_heap.h>
 #include <sbi/sbi_hsm.h>
+#include <sbi/sbi_lockstat.h>
 #include <sbi/sbi_math.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_string.h>
 
 /*
- * We allocate an extra element because sbi_domain_for_each() expects
- * the array to be null-terminated.
+ * The domain table is allocated from the heap and grown as domains get
+ * registered. We always keep an extra element because sbi_domain_for_each()
+ * expects the array to be null-terminated.
  */
-struct sbi_domain *domidx_to_domain_table[SBI_DOMAIN_MAX_INDEX + 1] = { 0 };
+static struct sbi_domain *domidx_to_domain_empty[1] = { 0 };
+struct sbi_domain **domidx_to_domain_table = domidx_to_domain_empty;
+static u32 domidx_to_domain_table_size = 0;
 static u32 domain_count = 0;
 static bool domain_finalized = false;
 
 #define ROOT_REGION_MAX	16
 static u32 root_memregs_count = 0;
+/* Root regions were added since they were last sorted and merged */
+static bool root_memregs_dirty = false;
 
 struct sbi_domain root = {
 	.name = "root",
@@ -40,6 +48,14 @@ struct sbi_domain root = {
 
 static unsigned long domain_hart_ptr_offset;
 
+/* Only the writers and the queued readers take the wait_lock */
+SBI_LOCKSTAT_DEFINE(domain_assigned_harts_lock, NULL);
+
+struct sbi_domain *sbi_domain_find_index(unsigned long index)
+{
+	return (index < domain_count) ? domidx_to_domain_table[index] : NULL;
+}
+
 struct sbi_domain *sbi_hartindex_to_domain(u32 hartindex)
 {
 	struct sbi_scratch *scratch;
@@ -70,9 +86,9 @@ bool sbi_domain_is_assigned_hart(const struct sbi_domain *dom, u32 hartid)
 	if (!dom)
 		return false;
 
-	spin_lock(&tdom->assigned_harts_lock);
+	read_lock(&tdom->assigned_harts_lock);
 	ret = sbi_hartmask_test_hartid(hartid, &tdom->assigned_harts);
-	spin_unlock(&tdom->assigned_harts_lock);
+	read_unlock(&tdom->assigned_harts_lock);
 
 	return ret;
 }
@@ -86,12 +102,12 @@ ulong sbi_domain_get_assigned_hartmask(const struct sbi_domain *dom,
 	if (!dom)
 		return 0;
 
-	spin_lock(&tdom->assigned_harts_lock);
+	read_lock(&tdom->assigned_harts_lock);
 	for (int i = 0; i < 8 * sizeof(ret); i++) {
 		if (sbi_hartmask_test_hartid(hbase + i, &tdom->assigned_harts))
 			ret |= 1UL << i;
 	}
-	spin_unlock(&tdom->assigned_harts_lock);
+	read_unlock(&tdom->assigned_harts_lock);
 
 	return ret;
 }
@@ -155,16 +171,84 @@ void sbi_domain_memregion_init_tor(unsigned long addr,
 	}
 }
 
-bool sbi_domain_check_addr(const struct sbi_domain *dom,
-			   unsigned long addr, unsigned long mode,
-			   unsigned long access_flags)
+static unsigned long region_last(const struct sbi_domain_memregion *reg)
+{
+	if (reg->tor)
+		return reg->base + reg->tor - 1;
+	return (reg->order < __riscv_xlen) ?
+		reg->base + ((1UL << reg->order) - 1) : -1UL;
+}
+
+static int root_regions_update(void);
+
+static const struct sbi_domain_memregion *find_region(
+						const struct sbi_domain *dom,
+						unsigned long addr)
 {
-	bool rmmio, mmio = false;
 	struct sbi_domain_memregion *reg;
-	unsigned long rstart, rend, rflags, rwx = 0, rrwx = 0;
 
-	if (!dom)
-		return false;
+	/* The first match must be the smallest region */
+	if (dom == &root)
+		root_regions_update();
+
+	sbi_domain_for_each_memregion(dom, reg) {
+		if (reg->base <= addr && addr <= region_last(reg))
+			return reg;
+	}
+
+	return NULL;
+}
+
+/** Per-HART cache of the last region index lookup */
+struct domain_index_cache {
+	const struct sbi_domain *dom;
+	u32 pos;
+};
+
+static unsigned long domain_index_cache_offset;
+
+static const struct sbi_domain_memregion_interval *domain_index_lookup(
+						const struct sbi_domain *dom,
+						unsigned long addr)
+{
+	const struct sbi_domain_memregion_interval *iv;
+	struct domain_index_cache *cache = NULL;
+	u32 lo, hi, mid;
+
+	if (domain_index_cache_offset) {
+		cache = sbi_scratch_offset_ptr(sbi_scratch_thishart_ptr(),
+					       domain_index_cache_offset);
+		if (cache->dom == dom && cache->pos < dom->region_index_count) {
+			iv = &dom->region_index[cache->pos];
+			if (iv->start <= addr && addr <= iv->end)
+				return iv;
+		}
+	}
+
+	lo = 0;
+	hi = dom->region_index_count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		iv = &dom->region_index[mid];
+		if (addr < iv->start)
+			hi = mid;
+		else if (iv->end < addr)
+			lo = mid + 1;
+		else {
+			if (cache) {
+				cache->dom = dom;
+				cache->pos = mid;
+			}
+			return iv;
+		}
+	}
+
+	return NULL;
+}
+
+static unsigned long domain_access_rwx(unsigned long access_flags)
+{
+	unsigned long rwx = 0;
 
 	/*
 	 * Use M_{R/W/X} bits because the SU-bits are at the
@@ -180,27 +264,51 @@ bool sbi_domain_check_addr(const struct sbi_domain *dom,
 	if (access_flags & SBI_DOMAIN_EXECUTE)
 		rwx |= SBI_DOMAIN_MEMREGION_M_EXECUTABLE;
 
-	if (access_flags & SBI_DOMAIN_MMIO)
-		mmio = true;
+	return rwx;
+}
 
-	sbi_domain_for_each_memregion(dom, reg) {
-		rflags = reg->flags;
-		rrwx = (mode == PRV_M ?
-			(rflags & SBI_DOMAIN_MEMREGION_M_ACCESS_MASK) :
-			(rflags & SBI_DOMAIN_MEMREGION_SU_ACCESS_MASK)
-			>> SBI_DOMAIN_MEMREGION_SU_ACCESS_SHIFT);
-
-		rstart = reg->base;
-		rend = (reg->order < __riscv_xlen) ?
-			rstart + ((1UL << reg->order) - 1) : -1UL;
-		if (rstart <= addr && addr <= rend) {
-			rmmio = (rflags & SBI_DOMAIN_MEMREGION_MMIO) ? true : false;
-			if (mmio != rmmio)
-				return false;
-			return ((rrwx & rwx) == rwx) ? true : false;
-		}
+static bool region_allows(const struct sbi_domain_memregion *reg,
+			  unsigned long mode, unsigned long rwx, bool mmio)
+{
+	unsigned long rflags = reg->flags, rrwx;
+	bool rmmio;
+
+	rrwx = (mode == PRV_M ?
+		(rflags & SBI_DOMAIN_MEMREGION_M_ACCESS_MASK) :
+		(rflags & SBI_DOMAIN_MEMREGION_SU_ACCESS_MASK)
+		>> SBI_DOMAIN_MEMREGION_SU_ACCESS_SHIFT);
+
+	rmmio = (rflags & SBI_DOMAIN_MEMREGION_MMIO) ? true : false;
+	if (mmio != rmmio)
+		return false;
+
+	return ((rrwx & rwx) == rwx) ? true : false;
+}
+
+bool sbi_domain_check_addr(const struct sbi_domain *dom,
+			   unsigned long addr, unsigned long mode,
+			   unsigned long access_flags)
+{
+	const struct sbi_domain_memregion_interval *iv;
+	const struct sbi_domain_memregion *reg;
+	bool mmio;
+
+	if (!dom)
+		return false;
+
+	mmio = (access_flags & SBI_DOMAIN_MMIO) ? true : false;
+
+	if (dom->region_index) {
+		iv = domain_index_lookup(dom, addr);
+		reg = (iv) ? iv->reg : NULL;
+	} else {
+		reg = find_region(dom, addr);
 	}
 
+	if (reg)
+		return region_allows(reg, mode,
+				     domain_access_rwx(access_flags), mmio);
+
 	return (mode == PRV_M) ? true : false;
 }
 
@@ -262,24 +370,6 @@ static bool is_region_before(const struct sbi_domain_memregion *regA,
 	return false;
 }
 
-static const struct sbi_domain_memregion *find_region(
-						const struct sbi_domain *dom,
-						unsigned long addr)
-{
-	unsigned long rstart, rend;
-	struct sbi_domain_memregion *reg;
-
-	sbi_domain_for_each_memregion(dom, reg) {
-		rstart = reg->base;
-		rend = (reg->order < __riscv_xlen) ?
-			rstart + ((1UL << reg->order) - 1) : -1UL;
-		if (rstart <= addr && addr <= rend)
-			return reg;
-	}
-
-	return NULL;
-}
-
 static const struct sbi_domain_memregion *find_next_subset_region(
 				const struct sbi_domain *dom,
 				const struct sbi_domain_memregion *reg,
@@ -315,9 +405,39 @@ static void clear_region(struct sbi_domain_memregion* reg)
 	sbi_memset(reg, 0x0, sizeof(*reg));
 }
 
+/* Sift the region at pos down the max-heap of the first count regions */
+static void sift_region(struct sbi_domain_memregion *regs, u32 pos, u32 count)
+{
+	u32 child;
+
+	while ((child = 2 * pos + 1) < count) {
+		if (child + 1 < count &&
+		    is_region_before(&regs[child], &regs[child + 1]))
+			child++;
+		if (!is_region_before(&regs[pos], &regs[child]))
+			break;
+		swap_region(&regs[pos], &regs[child]);
+		pos = child;
+	}
+}
+
+/* Heap sort the regions so that is_region_before() holds for each pair */
+static void sort_regions(struct sbi_domain_memregion *regs, u32 count)
+{
+	u32 i;
+
+	for (i = count / 2; i > 0; i--)
+		sift_region(regs, i - 1, count);
+
+	for (i = count; i > 1; i--) {
+		swap_region(&regs[0], &regs[i - 1]);
+		sift_region(regs, 0, i - 1);
+	}
+}
+
 static int sanitize_domain(struct sbi_domain *dom)
 {
-	u32 i, j, count;
+	u32 i, j, k, count;
 	bool is_covered;
 	struct sbi_domain_memregion *reg, *reg1;
 
@@ -365,22 +485,16 @@ static int sanitize_domain(struct sbi_domain *dom)
 	}
 
 	/* Sort the memory regions */
-	for (i = 0; i < (count - 1); i++) {
-		reg = &dom->regions[i];
-		for (j = i + 1; j < count; j++) {
-			reg1 = &dom->regions[j];
+	sort_regions(dom->regions, count);
 
-			if (!is_region_before(reg1, reg))
-				continue;
-
-			swap_region(reg, reg1);
-		}
-	}
-
-	/* Remove covered regions */
-	while(i < (count - 1)) {
-		is_covered = false;
+	/*
+	 * Remove regions covered by a later compatible region. Regions
+	 * in between overlapping the covered one would take over its
+	 * addresses so the covered region is kept in that case.
+	 */
+	for (i = 0, k = 0; i < count; i++) {
 		reg = &dom->regions[i];
+		is_covered = false;
 
 		for (j = i + 1; j < count; j++) {
 			reg1 = &dom->regions[j];
@@ -389,18 +503,19 @@ static int sanitize_domain(struct sbi_domain *dom)
 				is_covered = true;
 				break;
 			}
+			if (region_start(reg1) < region_end(reg) &&
+			    region_start(reg) < region_end(reg1))
+				break;
 		}
 
-		/* find a region is superset of reg, remove reg */
-		if (is_covered) {
-			for (j = i; j < (count - 1); j++)
-				swap_region(&dom->regions[j],
-					    &dom->regions[j + 1]);
-			clear_region(&dom->regions[count - 1]);
-			count--;
-		} else
-			i++;
+		if (is_covered)
+			continue;
+		if (i != k)
+			sbi_memcpy(&dom->regions[k], reg, sizeof(*reg));
+		k++;
 	}
+	for (i = k; i < count; i++)
+		clear_region(&dom->regions[i]);
 
 	/*
 	 * We don't need to check boot HART id of domain because if boot
@@ -438,11 +553,39 @@ bool sbi_domain_check_addr_range(const struct sbi_domain *dom,
 				 unsigned long access_flags)
 {
 	unsigned long max = addr + size;
+	const struct sbi_domain_memregion_interval *iv, *iv_end;
 	const struct sbi_domain_memregion *reg, *sreg;
+	unsigned long rwx;
+	bool mmio;
 
 	if (!dom)
 		return false;
 
+	if (dom->region_index && addr < max) {
+		iv = domain_index_lookup(dom, addr);
+		if (!iv)
+			return false;
+
+		rwx = domain_access_rwx(access_flags);
+		mmio = (access_flags & SBI_DOMAIN_MMIO) ? true : false;
+
+		/*
+		 * Intervals are sorted and non-overlapping so walk them
+		 * forward until the range is covered or a gap is found.
+		 */
+		iv_end = &dom->region_index[dom->region_index_count];
+		while (region_allows(iv->reg, mode, rwx, mmio)) {
+			if (iv->end == -1UL || max - 1 <= iv->end)
+				return true;
+			addr = iv->end + 1;
+			iv++;
+			if (iv == iv_end || iv->start != addr)
+				break;
+		}
+
+		return false;
+	}
+
 	while (addr < max) {
 		reg = find_region(dom, addr);
 		if (!reg)
@@ -463,6 +606,296 @@ bool sbi_domain_check_addr_range(const struct sbi_domain *dom,
 	return true;
 }
 
+#define DOMAIN_SHMEM_CACHE_RANGES	2
+
+/** S-mode shared memory ranges last checked by a HART */
+struct domain_shmem_cache {
+	const struct sbi_domain *dom;
+	unsigned long next;
+	struct {
+		unsigned long addr;
+		unsigned long size;
+		unsigned long access_flags;
+	} range[DOMAIN_SHMEM_CACHE_RANGES];
+};
+
+static SBI_SCRATCH_DEFINE(struct domain_shmem_cache, domain_shmem_cache);
+
+bool sbi_domain_check_shmem(unsigned long addr, unsigned long size,
+			    unsigned long access_flags)
+{
+	const struct sbi_domain *dom = sbi_domain_thishart_ptr();
+	struct domain_shmem_cache *c;
+	unsigned long i;
+
+	/* The regions of a domain don't change once finalized */
+	if (!domain_finalized || !dom || !size)
+		return sbi_domain_check_addr_range(dom, addr, size, PRV_S,
+						   access_flags);
+
+	c = sbi_scratch_thishart_var_ptr(domain_shmem_cache);
+	if (c->dom != dom) {
+		sbi_memset(c, 0, sizeof(*c));
+		c->dom = dom;
+	}
+
+	for (i = 0; i < DOMAIN_SHMEM_CACHE_RANGES; i++) {
+		if (c->range[i].size && c->range[i].addr <= addr &&
+		    size <= c->range[i].size &&
+		    addr - c->range[i].addr <= c->range[i].size - size &&
+		    (c->range[i].access_flags & access_flags) == access_flags)
+			return true;
+	}
+
+	if (!sbi_domain_check_addr_range(dom, addr, size, PRV_S,
+					 access_flags))
+		return false;
+
+	i = c->next++ % DOMAIN_SHMEM_CACHE_RANGES;
+	c->range[i].addr = addr;
+	c->range[i].size = size;
+	c->range[i].access_flags = access_flags;
+
+	return true;
+}
+
+static unsigned int region_pmp_entries(const struct sbi_domain_memregion *reg)
+{
+	return reg->tor ? 2 : 1;
+}
+
+static unsigned int domain_pmp_entries(const struct sbi_domain *dom)
+{
+	const struct sbi_domain_memregion *reg;
+	unsigned int entries = 0;
+
+	sbi_domain_for_each_memregion(dom, reg)
+		entries += region_pmp_entries(reg);
+
+	return entries;
+}
+
+/* Find the region with the same flags starting right after addr */
+static u32 domain_pmp_next(const struct sbi_domain_memregion *regs, u32 count,
+			   unsigned long flags, unsigned long addr)
+{
+	u32 i;
+
+	if (addr == -1UL)
+		return count;
+
+	for (i = 0; i < count; i++) {
+		if (regs[i].flags == flags && region_start(&regs[i]) == addr + 1)
+			return i;
+	}
+
+	return count;
+}
+
+/* Build the NAPOT or TOR region covering [start, last] */
+static void domain_pmp_span(unsigned long start, unsigned long last,
+			    unsigned long order, unsigned long flags,
+			    struct sbi_domain_memregion *reg)
+{
+	unsigned long size = last - start + 1;
+
+	sbi_memset(reg, 0, sizeof(*reg));
+	reg->flags = flags;
+	if (!(size & (size - 1)) && !(start & (size - 1))) {
+		reg->base = start;
+		reg->order = log2roundup(size);
+	} else {
+		reg->base = start;
+		reg->order = order;
+		reg->tor = size;
+	}
+}
+
+/*
+ * A run can only be replaced by one region if no other region between
+ * the run members and the new region in the priority order overlaps it.
+ * Larger regions come after both of them so only those are allowed.
+ */
+static bool domain_pmp_span_safe(const struct sbi_domain_memregion *regs,
+				 u32 count, const u32 *run, u32 run_len,
+				 unsigned long start, unsigned long last)
+{
+	u32 i, j;
+
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < run_len; j++) {
+			if (run[j] == i)
+				break;
+		}
+		if (j < run_len)
+			continue;
+
+		if (region_last(&regs[i]) < start || last < region_start(&regs[i]))
+			continue;
+		if (last - start < region_last(&regs[i]) - region_start(&regs[i]))
+			continue;
+
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Replace runs of address-consecutive regions with the same flags by one
+ * NAPOT or TOR region until the regions of the domain fit the number of
+ * PMP entries. The run freeing the most entries is replaced first.
+ */
+static int domain_pmp_optimize(struct sbi_domain *dom, unsigned int budget)
+{
+	struct sbi_domain_memregion *regs = dom->regions, cand, best_reg;
+	unsigned int entries, need, saved, best_saved;
+	unsigned long start, last, order;
+	u32 i, j, n, count = 0, best_len = 0;
+	u32 *run, *best_run;
+
+	need = domain_pmp_entries(dom);
+	if (!budget || need <= budget)
+		return 0;
+
+	while (regs[count].order)
+		count++;
+
+	run = sbi_malloc(2 * count * sizeof(*run));
+	if (!run)
+		return SBI_ENOMEM;
+	best_run = run + count;
+
+	while (budget < need) {
+		best_saved = 0;
+		for (i = 0; i < count; i++) {
+			n = 0;
+			run[n++] = i;
+			entries = region_pmp_entries(&regs[i]);
+			start = region_start(&regs[i]);
+			last = region_last(&regs[i]);
+			order = regs[i].order;
+
+			while (n < count) {
+				j = domain_pmp_next(regs, count, regs[i].flags, last);
+				if (j == count)
+					break;
+				run[n++] = j;
+				entries += region_pmp_entries(&regs[j]);
+				last = region_last(&regs[j]);
+				if (regs[j].order < order)
+					order = regs[j].order;
+
+				/* TOR can't describe the end of address space */
+				if (last == -1UL)
+					break;
+
+				domain_pmp_span(start, last, order,
+						regs[i].flags, &cand);
+				if (entries <= region_pmp_entries(&cand))
+					continue;
+				saved = entries - region_pmp_entries(&cand);
+				if (saved <= best_saved ||
+				    !domain_pmp_span_safe(regs, count, run, n,
+							  start, last))
+					continue;
+
+				best_saved = saved;
+				best_len = n;
+				sbi_memcpy(best_run, run, n * sizeof(*run));
+				sbi_memcpy(&best_reg, &cand, sizeof(cand));
+			}
+		}
+		if (!best_saved)
+			break;
+
+		/* Replace the first member and drop the others */
+		sbi_memcpy(&regs[best_run[0]], &best_reg, sizeof(best_reg));
+		for (i = 1; i < best_len; i++)
+			regs[best_run[i]].order = 0;
+		for (i = 0, n = 0; i < count; i++) {
+			if (!regs[i].order)
+				continue;
+			if (i != n)
+				sbi_memcpy(&regs[n], &regs[i], sizeof(regs[i]));
+			n++;
+		}
+		for (i = n; i < count; i++)
+			clear_region(&regs[i]);
+		count = n;
+		need -= best_saved;
+
+		sort_regions(regs, count);
+	}
+
+	sbi_free(run);
+
+	if (budget < need)
+		sbi_printf("%s: %s needs %u PMP entries but only %u are "
+			   "available\n", __func__, dom->name, need, budget);
+
+	return 0;
+}
+
+static int domain_build_region_index(struct sbi_domain *dom)
+{
+	struct sbi_domain_memregion_interval *index, *iv;
+	const struct sbi_domain_memregion *reg;
+	struct sbi_domain_memregion *sreg;
+	unsigned long addr, end, sstart, slast;
+	u32 count = 0, nregs = 0;
+
+	sbi_domain_for_each_memregion(dom, sreg)
+		nregs++;
+
+	/* Each region adds at most two interval boundaries */
+	index = sbi_calloc(sizeof(*index), 2 * nregs + 1);
+	if (!index)
+		return SBI_ENOMEM;
+
+	/*
+	 * Split the address space at every region boundary and record
+	 * the first matching region of each piece, which is exactly the
+	 * region picked by the linear scan in sbi_domain_check_addr().
+	 */
+	addr = 0;
+	while (1) {
+		reg = find_region(dom, addr);
+		end = -1UL;
+		sbi_domain_for_each_memregion(dom, sreg) {
+			sstart = sreg->base;
+			slast = region_last(sreg);
+			if (addr < sstart && sstart - 1 < end)
+				end = sstart - 1;
+			if (sstart <= addr && addr <= slast && slast < end)
+				end = slast;
+		}
+
+		if (reg) {
+			iv = (count) ? &index[count - 1] : NULL;
+			if (iv && iv->reg == reg && iv->end + 1 == addr) {
+				iv->end = end;
+			} else {
+				iv = &index[count++];
+				iv->start = addr;
+				iv->end = end;
+				iv->reg = reg;
+			}
+		}
+
+		if (end == -1UL)
+			break;
+		addr = end + 1;
+	}
+
+	if (dom->region_index)
+		sbi_free(dom->region_index);
+	dom->region_index = index;
+	dom->region_index_count = count;
+
+	return 0;
+}
+
 void sbi_domain_dump(const struct sbi_domain *dom, const char *suffix)
 {
 	u32 i, j, k;
@@ -541,6 +974,19 @@ void sbi_domain_dump(const struct sbi_domain *dom, const char *suffix)
 
 	sbi_printf("Domain%d SysSuspend  %s: %s\n",
 		   dom->index, suffix, (dom->system_suspend_allowed) ? "yes" : "no");
+
+	if (dom->cache_way_mask)
+		sbi_printf("Domain%d CacheWays   %s: 0x%lx\n",
+			   dom->index, suffix, dom->cache_way_mask);
+
+	if (dom->stateen0_deny)
+		sbi_printf("Domain%d StateenDeny %s: 0x%llx\n",
+			   dom->index, suffix,
+			   (unsigned long long)dom->stateen0_deny);
+
+	if (dom->time_slice)
+		sbi_printf("Domain%d TimeSlice   %s: %u us\n",
+			   dom->index, suffix, dom->time_slice);
 }
 
 void sbi_domain_dump_all(const char *suffix)
@@ -554,6 +1000,73 @@ void sbi_domain_dump_all(const char *suffix)
 	}
 }
 
+static int domain_table_grow(void)
+{
+	struct sbi_domain **table;
+	u32 size;
+
+	if (domain_count < domidx_to_domain_table_size)
+		return 0;
+
+	size = domidx_to_domain_table_size ? domidx_to_domain_table_size * 2 : 4;
+	if (size > SBI_DOMAIN_MAX_INDEX)
+		size = SBI_DOMAIN_MAX_INDEX;
+
+	table = sbi_zalloc(sizeof(*table) * (size + 1));
+	if (!table)
+		return SBI_ENOMEM;
+
+	sbi_memcpy(table, domidx_to_domain_table, sizeof(*table) * domain_count);
+	if (domidx_to_domain_table != domidx_to_domain_empty)
+		sbi_free(domidx_to_domain_table);
+	domidx_to_domain_table = table;
+	domidx_to_domain_table_size = size;
+
+	return 0;
+}
+
+/* Root domain context of each HART, padded to a cache line, and its entry */
+SBI_HEAP_NEED(domain_context, 0, sizeof(struct sbi_context) + 64 +
+				 sizeof(struct sbi_context *));
+
+static int domain_contexts_alloc(struct sbi_domain *dom)
+{
+	unsigned long ctx, stride;
+	u32 i, count;
+
+	/* Contexts are only needed for the HARTs of the platform */
+	dom->hartindex_to_context_table =
+		sbi_zalloc(sizeof(*dom->hartindex_to_context_table) *
+			   sbi_hartmask_used_bits());
+	if (!dom->hartindex_to_context_table)
+		return SBI_ENOMEM;
+
+	count = sbi_hartmask_weight(dom->possible_harts);
+	if (!count)
+		return 0;
+
+	/* Each HART switches its own context so keep them on separate lines */
+	stride = sbi_heap_cacheline_size();
+	stride = (sizeof(*dom->contexts) + stride - 1) & ~(stride - 1);
+	dom->contexts = sbi_zalloc_aligned(stride * count,
+					   sbi_heap_cacheline_size());
+	if (!dom->contexts) {
+		sbi_free(dom->hartindex_to_context_table);
+		dom->hartindex_to_context_table = NULL;
+		return SBI_ENOMEM;
+	}
+
+	/* Bind one context of the compact array to each possible HART */
+	ctx = (unsigned long)dom->contexts;
+	sbi_hartmask_for_each_hartindex(i, dom->possible_harts) {
+		((struct sbi_context *)ctx)->dom = dom;
+		dom->hartindex_to_context_table[i] = (struct sbi_context *)ctx;
+		ctx += stride;
+	}
+
+	return 0;
+}
+
 int sbi_domain_register(struct sbi_domain *dom,
 			const struct sbi_hartmask *assign_mask)
 {
@@ -591,12 +1104,24 @@ int sbi_domain_register(struct sbi_domain *dom,
 		return rc;
 	}
 
+	/* Make room for the new domain in the domain table */
+	rc = domain_table_grow();
+	if (rc)
+		return rc;
+
+	/* Allocate contexts of possible HARTs */
+	rc = domain_contexts_alloc(dom);
+	if (rc)
+		return rc;
+
 	/* Assign index to domain */
 	dom->index = domain_count++;
 	domidx_to_domain_table[dom->index] = dom;
 
-	/* Initialize spinlock for dom->assigned_harts */
-	SPIN_LOCK_INIT(dom->assigned_harts_lock);
+	/* Initialize rwlock for dom->assigned_harts */
+	RW_LOCK_INIT(dom->assigned_harts_lock);
+	sbi_lockstat_track(domain_assigned_harts_lock,
+			   &dom->assigned_harts_lock.wait_lock);
 
 	/* Clear assigned HARTs of domain */
 	sbi_hartmask_clear_all(&dom->assigned_harts);
@@ -628,30 +1153,50 @@ int sbi_domain_register(struct sbi_domain *dom,
 	return 0;
 }
 
-int sbi_domain_root_add_memregion(const struct sbi_domain_memregion *reg)
+/*
+ * Merge consecutive root memregions with same order and flags. Returns
+ * true if regions were merged because the merged ones may need sorting
+ * and merging again.
+ */
+static bool root_regions_merge(void)
 {
-	int rc;
-	bool reg_merged;
-	struct sbi_domain_memregion *nreg, *nreg1, *nreg2;
+	struct sbi_domain_memregion *reg, *next;
+	u32 i, count = 0;
+	bool merged = false;
+
+	for (i = 0; i < root_memregs_count; i++) {
+		reg = &root.regions[i];
+		next = (i + 1 < root_memregs_count) ? reg + 1 : NULL;
+		if (count != i)
+			sbi_memcpy(&root.regions[count], reg, sizeof(*reg));
+		reg = &root.regions[count++];
+
+		if (next &&
+		    !(reg->base & (BIT(reg->order + 1) - 1)) &&
+		    (reg->base + BIT(reg->order)) == next->base &&
+		    reg->order == next->order &&
+		    reg->flags == next->flags) {
+			reg->order++;
+			merged = true;
+			i++;
+		}
+	}
 
-	/* Sanity checks */
-	if (!reg || domain_finalized || !root.regions ||
-	    (ROOT_REGION_MAX <= root_memregs_count))
-		return SBI_EINVAL;
+	for (i = count; i < root_memregs_count; i++)
+		clear_region(&root.regions[i]);
+	root_memregs_count = count;
 
-	/* Check whether compatible region exists for the new one */
-	sbi_domain_for_each_memregion(&root, nreg) {
-		if (is_region_compatible(reg, nreg))
-			return 0;
-	}
+	return merged;
+}
+
+/* Sort and optimize the root regions added since the last update */
+static int root_regions_update(void)
+{
+	int rc;
 
-	/* Append the memregion to root memregions */
-	nreg = &root.regions[root_memregs_count];
-	sbi_memcpy(nreg, reg, sizeof(*reg));
-	root_memregs_count++;
-	root.regions[root_memregs_count].order = 0;
+	if (!root_memregs_dirty)
+		return 0;
 
-	/* Sort and optimize root regions */
 	do {
 		/* Sanitize the root domain so that memregions are sorted */
 		rc = sanitize_domain(&root);
@@ -662,38 +1207,91 @@ int sbi_domain_root_add_memregion(const struct sbi_domain_memregion *reg)
 			return rc;
 		}
 
-		/* Merge consecutive memregions with same order and flags */
-		reg_merged = false;
-		sbi_domain_for_each_memregion(&root, nreg) {
-			nreg1 = nreg + 1;
-			if (!nreg1->order)
-				continue;
+		/* Covered regions may have been removed */
+		root_memregs_count = 0;
+		while (root.regions[root_memregs_count].order)
+			root_memregs_count++;
+	} while (root_regions_merge());
 
-			if (!(nreg->base & (BIT(nreg->order + 1) - 1)) &&
-			    (nreg->base + BIT(nreg->order)) == nreg1->base &&
-			    nreg->order == nreg1->order &&
-			    nreg->flags == nreg1->flags) {
-				nreg->order++;
-				while (nreg1->order) {
-					nreg2 = nreg1 + 1;
-					sbi_memcpy(nreg1, nreg2, sizeof(*nreg1));
-					nreg1++;
-				}
-				reg_merged = true;
-				root_memregs_count--;
-			}
+	root_memregs_dirty = false;
+
+	return 0;
+}
+
+static bool root_has_compatible_region(const struct sbi_domain_memregion *reg)
+{
+	struct sbi_domain_memregion *nreg;
+
+	sbi_domain_for_each_memregion(&root, nreg) {
+		if (is_region_compatible(reg, nreg))
+			return true;
+	}
+
+	return false;
+}
+
+int sbi_domain_root_add_memregions(const struct sbi_domain_memregion *regs,
+				   u32 count)
+{
+	const struct sbi_domain_memregion *reg;
+	u32 i;
+	int rc;
+
+	/* Sanity checks */
+	if (!regs || domain_finalized || !root.regions)
+		return SBI_EINVAL;
+
+	for (i = 0; i < count; i++) {
+		reg = &regs[i];
+		if (!is_region_valid(reg))
+			return SBI_EINVAL;
+
+		/* Check whether compatible region exists for the new one */
+		if (root_has_compatible_region(reg))
+			continue;
+
+		/* Merging the pending regions may make room for this one */
+		if (ROOT_REGION_MAX <= root_memregs_count) {
+			rc = root_regions_update();
+			if (rc)
+				return rc;
+			if (ROOT_REGION_MAX <= root_memregs_count)
+				return SBI_EINVAL;
 		}
-	} while (reg_merged);
+
+		/*
+		 * Append the memregion to root memregions, sorting and
+		 * merging is done once by root_regions_update() before
+		 * the root regions are used.
+		 */
+		sbi_memcpy(&root.regions[root_memregs_count], reg,
+			   sizeof(*reg));
+		root_memregs_count++;
+		root.regions[root_memregs_count].order = 0;
+		root_memregs_dirty = true;
+	}
+
+	/* Root regions changed so cached PMP programming is stale */
+	sbi_hart_pmp_cache_invalidate(&root);
 
 	return 0;
 }
 
+int sbi_domain_root_add_memregion(const struct sbi_domain_memregion *reg)
+{
+	return sbi_domain_root_add_memregions(reg, 1);
+}
+
+/* Number of memregions of a memory range added to the root at once */
+#define ROOT_MEMRANGE_BATCH	8
+
 int sbi_domain_root_add_memrange(unsigned long addr, unsigned long size,
 			   unsigned long align, unsigned long region_flags)
 {
 	int rc;
+	u32 count = 0;
 	unsigned long pos, end, rsize;
-	struct sbi_domain_memregion reg;
+	struct sbi_domain_memregion regs[ROOT_MEMRANGE_BATCH];
 
 	pos = addr;
 	end = addr + size;
@@ -705,23 +1303,34 @@ int sbi_domain_root_add_memrange(unsigned long addr, unsigned long size,
 			rsize = ((end - pos) < align) ?
 				(end - pos) : align;
 
-		sbi_domain_memregion_init(pos, rsize, region_flags, &reg);
-		rc = sbi_domain_root_add_memregion(&reg);
-		if (rc)
-			return rc;
+		sbi_domain_memregion_init(pos, rsize, region_flags,
+					  &regs[count++]);
 		pos += rsize;
+
+		if (count == ROOT_MEMRANGE_BATCH) {
+			rc = sbi_domain_root_add_memregions(regs, count);
+			if (rc)
+				return rc;
+			count = 0;
+		}
 	}
 
-	return 0;
+	return count ? sbi_domain_root_add_memregions(regs, count) : 0;
 }
 
 int sbi_domain_finalize(struct sbi_scratch *scratch, u32 cold_hartid)
 {
 	int rc;
 	u32 i, dhart;
+	unsigned int pmp_budget;
 	struct sbi_domain *dom;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
+	/* Sort and merge the root regions added during early init */
+	rc = root_regions_update();
+	if (rc)
+		return rc;
+
 	/* Initialize and populate domains for the platform */
 	rc = sbi_platform_domains_init(plat);
 	if (rc) {
@@ -730,6 +1339,34 @@ int sbi_domain_finalize(struct sbi_scratch *scratch, u32 cold_hartid)
 		return rc;
 	}
 
+	/* Platform domains_init() may have added root regions as well */
+	rc = root_regions_update();
+	if (rc)
+		return rc;
+
+	/* PMP entries left for the domain memory regions */
+	pmp_budget = sbi_hart_pmp_count(scratch);
+	if (pmp_budget &&
+	    sbi_hart_has_extension(scratch, SBI_HART_EXT_SMEPMP))
+		pmp_budget--;
+
+	/* Build memory region lookup index of domains */
+	sbi_domain_for_each(i, dom) {
+		rc = domain_pmp_optimize(dom, pmp_budget);
+		if (rc) {
+			sbi_printf("%s: no memory to optimize %s regions\n",
+				   __func__, dom->name);
+			return rc;
+		}
+
+		rc = domain_build_region_index(dom);
+		if (rc) {
+			sbi_printf("%s: no memory for %s region index\n",
+				   __func__, dom->name);
+			return rc;
+		}
+	}
+
 	/* Startup boot HART of domains */
 	sbi_domain_for_each(i, dom) {
 		/* Domain boot HART index */
@@ -748,9 +1385,9 @@ int sbi_domain_finalize(struct sbi_scratch *scratch, u32 cold_hartid)
 			continue;
 
 		/* Ignore if boot HART is not part of the assigned HARTs */
-		spin_lock(&dom->assigned_harts_lock);
+		read_lock(&dom->assigned_harts_lock);
 		rc = sbi_hartmask_test_hartindex(dhart, &dom->assigned_harts);
-		spin_unlock(&dom->assigned_harts_lock);
+		read_unlock(&dom->assigned_harts_lock);
 		if (!rc)
 			continue;
 
@@ -808,11 +1445,18 @@ int sbi_domain_init(struct sbi_scratch *scratch, u32 cold_hartid)
 	if (!domain_hart_ptr_offset)
 		return SBI_ENOMEM;
 
+	domain_index_cache_offset =
+		sbi_scratch_alloc_type_offset(struct domain_index_cache);
+	if (!domain_index_cache_offset) {
+		rc = SBI_ENOMEM;
+		goto fail_free_domain_hart_ptr_offset;
+	}
+
 	root_memregs = sbi_calloc(sizeof(*root_memregs), ROOT_REGION_MAX + 1);
 	if (!root_memregs) {
 		sbi_printf("%s: no memory for root regions\n", __func__);
 		rc = SBI_ENOMEM;
-		goto fail_free_domain_hart_ptr_offset;
+		goto fail_free_domain_index_cache_offset;
 	}
 	root.regions = root_memregs;
 
@@ -862,6 +1506,11 @@ int sbi_domain_init(struct sbi_scratch *scratch, u32 cold_hartid)
 	root.next_addr = scratch->next_addr;
 	root.next_mode = scratch->next_mode;
 
+#ifdef CONFIG_SBI_DOMAIN_SCHED
+	/* Root domain has no DT node to carry its time slice */
+	root.time_slice = CONFIG_SBI_DOMAIN_SCHED_ROOT_SLICE;
+#endif
+
 	/* Root domain possible and assigned HARTs */
 	for (i = 0; i < plat->hart_count; i++)
 		sbi_hartmask_set_hartindex(i, root_hmask);
@@ -877,6 +1526,9 @@ fail_free_root_hmask:
 	sbi_free(root_hmask);
 fail_free_root_memregs:
 	sbi_free(root_memregs);
+fail_free_domain_index_cache_offset:
+	sbi_scratch_free_offset(domain_index_cache_offset);
+	domain_index_cache_offset = 0;
 fail_free_domain_hart_ptr_offset:
 	sbi_scratch_free_offset(domain_hart_ptr_offset);
 	return rc;
@@ -7,14 +7,70 @@
 #include <sbi/sbi_error.h>
 #include <sbi/riscv_locks.h>
 #include <sbi/riscv_asm.h>
+#include <sbi/sbi_cache.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_hsm.h>
 #include <sbi/sbi_hart.h>
-#include <sbi/sbi_heap.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_string.h>
+#include <sbi/sbi_timer.h>
 #include <sbi/sbi_domain_context.h>
 
+#ifdef CONFIG_SBI_DOMAIN_CONTEXT_BENCH
+/* Number of switches into a context between two latency reports */
+#define DOMAIN_CONTEXT_BENCH_PERIOD	256
+
+static void domain_context_bench(struct sbi_context *ctx,
+				 struct sbi_context *dom_ctx,
+				 unsigned long start_cycle)
+{
+	unsigned long cycles = csr_read(CSR_MCYCLE) - start_cycle;
+
+	dom_ctx->switch_count++;
+	dom_ctx->switch_cycles += cycles;
+	if (dom_ctx->switch_cycles_max < cycles)
+		dom_ctx->switch_cycles_max = cycles;
+
+	if (dom_ctx->switch_count % DOMAIN_CONTEXT_BENCH_PERIOD)
+		return;
+
+	sbi_printf("HART%u domain switch %s -> %s: count=%lu avg=%lu "
+		   "max=%lu cycles\n", current_hartid(), ctx->dom->name,
+		   dom_ctx->dom->name, dom_ctx->switch_count,
+		   dom_ctx->switch_cycles / dom_ctx->switch_count,
+		   dom_ctx->switch_cycles_max);
+}
+#endif
+
+#ifdef CONFIG_SBI_DOMAIN_SCHED
+/** Offset of the per-HART time slice event in scratch space */
+static unsigned long domain_sched_event_offset;
+
+static void domain_sched_expire(struct sbi_timer_event *ev);
+
+static void domain_sched_arm(struct sbi_domain *dom)
+{
+	struct sbi_timer_event *ev;
+	const struct sbi_timer_device *tdev = sbi_timer_get_device();
+
+	if (!domain_sched_event_offset || !tdev)
+		return;
+
+	ev = sbi_scratch_offset_ptr(sbi_scratch_thishart_ptr(),
+				    domain_sched_event_offset);
+	sbi_timer_event_cancel(ev);
+	if (!dom->time_slice)
+		return;
+
+	ev->callback = domain_sched_expire;
+	ev->deadline = sbi_timer_value() +
+		       (u64)dom->time_slice * tdev->timer_freq / 1000000;
+	sbi_timer_event_add(ev);
+}
+#else
+static inline void domain_sched_arm(struct sbi_domain *dom) { }
+#endif
+
 /**
  * Switches the HART context from the current domain to the target domain.
  * This includes changing domain assignments and reconfiguring PMP, as well
@@ -32,23 +88,41 @@ static void switch_to_next_domain_context(struct sbi_context *ctx,
 	struct sbi_domain *target_dom = dom_ctx->dom;
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 	unsigned int pmp_count = sbi_hart_pmp_count(scratch);
+#ifdef CONFIG_SBI_DOMAIN_CONTEXT_BENCH
+	unsigned long start_cycle = csr_read(CSR_MCYCLE);
+#endif
+
+	/* The outgoing domain is not running from now on */
+	sbi_sta_switch_out(&ctx->sta);
 
 	/* Assign current hart to target domain */
-	spin_lock(&current_dom->assigned_harts_lock);
+	write_lock(&current_dom->assigned_harts_lock);
 	sbi_hartmask_clear_hartindex(hartindex, &current_dom->assigned_harts);
-	spin_unlock(&current_dom->assigned_harts_lock);
+	write_unlock(&current_dom->assigned_harts_lock);
 
 	sbi_update_hartindex_to_domain(hartindex, target_dom);
 
-	spin_lock(&target_dom->assigned_harts_lock);
+	write_lock(&target_dom->assigned_harts_lock);
 	sbi_hartmask_set_hartindex(hartindex, &target_dom->assigned_harts);
-	spin_unlock(&target_dom->assigned_harts_lock);
+	write_unlock(&target_dom->assigned_harts_lock);
 
-	/* Reconfigure PMP settings for the new domain */
-	for (int i = 0; i < pmp_count; i++) {
-		pmp_disable(i);
+	/*
+	 * Reconfigure PMP settings for the new domain. The first switch
+	 * into a context programs the PMP from the domain memregions and
+	 * snapshots the result. Later switches only rewrite the entries
+	 * which differ from the snapshot of the outgoing context.
+	 */
+	if (!ctx->pmp.valid)
+		sbi_hart_pmp_save(scratch, &ctx->pmp);
+	if (dom_ctx->pmp.valid) {
+		sbi_hart_pmp_switch(scratch, &ctx->pmp, &dom_ctx->pmp);
+	} else {
+		for (int i = 0; i < pmp_count; i++) {
+			pmp_disable(i);
+		}
+		sbi_hart_pmp_configure(scratch);
+		sbi_hart_pmp_save(scratch, &dom_ctx->pmp);
 	}
-	sbi_hart_pmp_configure(scratch);
 
 	/* Save current CSR context and restore target domain's CSR context */
 	ctx->sstatus	= csr_swap(CSR_SSTATUS, dom_ctx->sstatus);
@@ -60,10 +134,22 @@ static void switch_to_next_domain_context(struct sbi_context *ctx,
 	ctx->stval	= csr_swap(CSR_STVAL, dom_ctx->stval);
 	ctx->sip	= csr_swap(CSR_SIP, dom_ctx->sip);
 	ctx->satp	= csr_swap(CSR_SATP, dom_ctx->satp);
-	if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_10)
+	if (sbi_hart_has_hot_feature(scratch, SBI_HART_HOT_PRIV_1_10))
 		ctx->scounteren = csr_swap(CSR_SCOUNTEREN, dom_ctx->scounteren);
-	if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_12)
+	if (sbi_hart_has_hot_feature(scratch, SBI_HART_HOT_PRIV_1_12))
 		ctx->senvcfg	= csr_swap(CSR_SENVCFG, dom_ctx->senvcfg);
+	if (sbi_hart_has_hot_feature(scratch, SBI_HART_HOT_SMSTATEEN)) {
+		ctx->sstateen0	= csr_swap(CSR_SSTATEEN0, dom_ctx->sstateen0);
+		if (current_dom->stateen0_deny != target_dom->stateen0_deny)
+			sbi_hart_mstateen_configure(scratch,
+						    target_dom->stateen0_deny);
+	}
+
+	/* Firmware features set by S-mode belong to the outgoing domain */
+	sbi_fwft_context_switch(&ctx->fwft, &dom_ctx->fwft);
+
+	if (current_dom->cache_way_mask != target_dom->cache_way_mask)
+		sbi_cache_set_way_mask(target_dom->cache_way_mask);
 
 	/* Save current trap state and restore target domain's trap state */
 	trap_ctx = sbi_trap_get_context(scratch);
@@ -73,6 +159,17 @@ static void switch_to_next_domain_context(struct sbi_context *ctx,
 	/* Mark current context structure initialized because context saved */
 	ctx->initialized = true;
 
+	/* Start the time slice of the target domain */
+	dom_ctx->preempted = false;
+	domain_sched_arm(target_dom);
+
+	/* The target domain runs with the PMP allowing its shared memory */
+	sbi_sta_switch_in(&dom_ctx->sta);
+
+#ifdef CONFIG_SBI_DOMAIN_CONTEXT_BENCH
+	domain_context_bench(ctx, dom_ctx, start_cycle);
+#endif
+
 	/* If target domain context is not initialized or runnable */
 	if (!dom_ctx->initialized) {
 		/* Startup boot HART of target domain */
@@ -97,6 +194,10 @@ int sbi_domain_context_enter(struct sbi_domain *dom)
 	if (!dom_ctx)
 		return SBI_EINVAL;
 
+	/* The trap registers of a preempted context are not at an ecall */
+	if (dom_ctx->preempted)
+		return SBI_EDENIED;
+
 	/* Update target context's previous context to indicate the caller */
 	dom_ctx->prev_ctx = ctx;
 
@@ -112,28 +213,9 @@ int sbi_domain_context_exit(void)
 	struct sbi_context *ctx = sbi_domain_context_thishart_ptr();
 	struct sbi_context *dom_ctx, *tmp;
 
-	/*
-	 * If it's first time to call `exit` on the current hart, no
-	 * context allocated before. Loop through each domain to allocate
-	 * its context on the current hart if valid.
-	 */
-	if (!ctx) {
-		sbi_domain_for_each(i, dom) {
-			if (!sbi_hartmask_test_hartindex(hartindex,
-							 dom->possible_harts))
-				continue;
-
-			dom_ctx = sbi_zalloc(sizeof(struct sbi_context));
-			if (!dom_ctx)
-				return SBI_ENOMEM;
-
-			/* Bind context and domain */
-			dom_ctx->dom				   = dom;
-			dom->hartindex_to_context_table[hartindex] = dom_ctx;
-		}
-
-		ctx = sbi_domain_context_thishart_ptr();
-	}
+	/* Contexts are allocated when the domains are registered */
+	if (!ctx)
+		return SBI_EINVAL;
 
 	dom_ctx = ctx->prev_ctx;
 
@@ -160,3 +242,159 @@ int sbi_domain_context_exit(void)
 
 	return 0;
 }
+
+/* Number of registers passed across a domain call or return */
+#define DOMAIN_CALL_NREGS	6
+
+static void domain_call_deliver(struct sbi_trap_regs *regs,
+				const unsigned long *args)
+{
+	regs->a0 = args[0];
+	regs->a1 = args[1];
+	regs->a2 = args[2];
+	regs->a3 = args[3];
+	regs->a4 = args[4];
+	regs->a5 = args[5];
+
+	/* Resume after the ecall which switched out of the context */
+	regs->mepc += 4;
+}
+
+int sbi_domain_context_call(struct sbi_domain *dom,
+			    struct sbi_trap_regs *regs)
+{
+	u32 hartindex = sbi_hartid_to_hartindex(current_hartid());
+	struct sbi_context *ctx = sbi_domain_context_thishart_ptr();
+	unsigned long args[DOMAIN_CALL_NREGS];
+	struct sbi_context *dom_ctx;
+
+	if (!ctx || !dom)
+		return SBI_EINVAL;
+
+	dom_ctx = sbi_hartindex_to_domain_context(hartindex, dom);
+	if (!dom_ctx || dom_ctx == ctx)
+		return SBI_EINVAL;
+
+	/*
+	 * Domains waiting for their own call to return can't be called,
+	 * neither can domains preempted in the middle of their run.
+	 */
+	if (dom_ctx->calling || dom_ctx->preempted)
+		return SBI_EDENIED;
+
+	args[0] = ctx->dom->index;
+	args[1] = regs->a1;
+	args[2] = regs->a2;
+	args[3] = regs->a3;
+	args[4] = regs->a4;
+	args[5] = regs->a5;
+
+	dom_ctx->prev_ctx = ctx;
+	ctx->calling = true;
+
+	switch_to_next_domain_context(ctx, dom_ctx);
+
+	/* The trap registers now belong to the callee */
+	domain_call_deliver(regs, args);
+
+	return 0;
+}
+
+int sbi_domain_context_return(struct sbi_trap_regs *regs)
+{
+	struct sbi_context *ctx = sbi_domain_context_thishart_ptr();
+	unsigned long args[DOMAIN_CALL_NREGS];
+	struct sbi_context *dom_ctx;
+
+	if (!ctx)
+		return SBI_EINVAL;
+
+	/* The caller must be waiting for this domain */
+	dom_ctx = ctx->prev_ctx;
+	if (!dom_ctx || !dom_ctx->calling)
+		return SBI_EINVAL;
+
+	args[0] = regs->a0;
+	args[1] = regs->a1;
+	args[2] = regs->a2;
+	args[3] = regs->a3;
+	args[4] = regs->a4;
+	args[5] = regs->a5;
+
+	ctx->prev_ctx = NULL;
+	dom_ctx->calling = false;
+
+	switch_to_next_domain_context(ctx, dom_ctx);
+
+	/* The trap registers now belong to the caller */
+	domain_call_deliver(regs, args);
+
+	return 0;
+}
+
+#ifdef CONFIG_SBI_DOMAIN_SCHED
+/*
+ * Pick the next context of the current HART in round-robin order. Only
+ * contexts preempted by the scheduler are resumed, the trap registers of
+ * the others stopped at an ecall which still has to complete. A domain
+ * which never ran is started on its boot HART.
+ */
+static struct sbi_context *domain_sched_next(struct sbi_context *ctx)
+{
+	u32 i, n, hartindex = sbi_hartid_to_hartindex(current_hartid());
+	struct sbi_context *dom_ctx;
+	struct sbi_domain *dom;
+
+	sbi_domain_for_each(n, dom)
+		;
+
+	for (i = 1; i < n; i++) {
+		dom = sbi_index_to_domain((ctx->dom->index + i) % n);
+		dom_ctx = sbi_hartindex_to_domain_context(hartindex, dom);
+		if (!dom_ctx || dom_ctx == ctx || dom_ctx->calling)
+			continue;
+
+		if (dom_ctx->preempted)
+			return dom_ctx;
+		if (!dom_ctx->initialized &&
+		    dom->boot_hartid == current_hartid())
+			return dom_ctx;
+	}
+
+	return NULL;
+}
+
+static void domain_sched_expire(struct sbi_timer_event *ev)
+{
+	struct sbi_context *ctx = sbi_domain_context_thishart_ptr();
+	struct sbi_context *dom_ctx;
+
+	if (!ctx)
+		return;
+
+	dom_ctx = domain_sched_next(ctx);
+	if (!dom_ctx) {
+		/* Nothing else to run, give the current domain a new slice */
+		domain_sched_arm(ctx->dom);
+		return;
+	}
+
+	/* The trap registers are restored on the return from this trap */
+	ctx->preempted = true;
+	switch_to_next_domain_context(ctx, dom_ctx);
+}
+
+int sbi_domain_sched_start(struct sbi_scratch *scratch, bool cold_boot)
+{
+	if (cold_boot) {
+		domain_sched_event_offset =
+			sbi_scratch_alloc_offset(sizeof(struct sbi_timer_event));
+		if (!domain_sched_event_offset)
+			return SBI_ENOMEM;
+	}
+
+	domain_sched_arm(sbi_domain_thishart_ptr());
+
+	return 0;
+}
+#endif
@@ -7,10 +7,17 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <sbi/riscv_barrier.h>
 #include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
 #include <sbi/sbi_ecall.h>
 #include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_ecall_stats.h>
 #include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_pmu.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_trace.h>
 #include <sbi/sbi_trap.h>
 
 extern struct sbi_ecall_extension *sbi_ecall_exts[];
@@ -40,10 +47,123 @@ void sbi_ecall_set_impid(unsigned long impid)
 
 static SBI_LIST_HEAD(ecall_exts_list);
 
+/*
+ * Finalized lookup tables built from ecall_exts_list. Extensions covering
+ * a single extension ID are placed in a small open-addressed hash table
+ * whereas extensions covering an extension ID range (legacy, vendor, etc)
+ * are kept in an array sorted by extid_start. When the tables are not
+ * ready (or an extension does not fit), lookups fall back to walking
+ * ecall_exts_list.
+ */
+#define ECALL_HASH_BITS		5
+#define ECALL_HASH_SIZE		(1UL << ECALL_HASH_BITS)
+#define ECALL_RANGE_MAX		8
+
+static struct sbi_ecall_extension *ecall_hash[ECALL_HASH_SIZE];
+static struct sbi_ecall_extension *ecall_ranges[ECALL_RANGE_MAX];
+static unsigned long ecall_ranges_count;
+static bool ecall_lookup_ready;
+
+static inline unsigned long ecall_hash_index(unsigned long extid)
+{
+	return ((u32)extid * 0x9E3779B1U) >> (32 - ECALL_HASH_BITS);
+}
+
+static bool ecall_hash_add(struct sbi_ecall_extension *ext)
+{
+	unsigned long i, idx = ecall_hash_index(ext->extid_start);
+
+	for (i = 0; i < ECALL_HASH_SIZE; i++) {
+		if (!ecall_hash[idx]) {
+			ecall_hash[idx] = ext;
+			return true;
+		}
+		idx = (idx + 1) & (ECALL_HASH_SIZE - 1);
+	}
+
+	return false;
+}
+
+static bool ecall_range_add(struct sbi_ecall_extension *ext)
+{
+	unsigned long i;
+
+	if (ecall_ranges_count >= ECALL_RANGE_MAX)
+		return false;
+
+	/* Insertion sort based on extid_start */
+	i = ecall_ranges_count;
+	while (i && ext->extid_start < ecall_ranges[i - 1]->extid_start) {
+		ecall_ranges[i] = ecall_ranges[i - 1];
+		i--;
+	}
+	ecall_ranges[i] = ext;
+	ecall_ranges_count++;
+
+	return true;
+}
+
+static void ecall_lookup_build(void)
+{
+	struct sbi_ecall_extension *t;
+	bool ok = true;
+
+	ecall_lookup_ready = false;
+	smp_wmb();
+
+	sbi_memset(ecall_hash, 0, sizeof(ecall_hash));
+	ecall_ranges_count = 0;
+
+	sbi_list_for_each_entry(t, &ecall_exts_list, head) {
+		if (t->extid_start == t->extid_end)
+			ok = ecall_hash_add(t);
+		else
+			ok = ecall_range_add(t);
+		if (!ok)
+			return;
+	}
+
+	smp_wmb();
+	ecall_lookup_ready = true;
+}
+
+static struct sbi_ecall_extension *ecall_lookup_find(unsigned long extid)
+{
+	struct sbi_ecall_extension *t;
+	unsigned long i, lo, hi, mid, idx = ecall_hash_index(extid);
+
+	for (i = 0; i < ECALL_HASH_SIZE; i++) {
+		t = ecall_hash[idx];
+		if (!t)
+			break;
+		if (t->extid_start == extid)
+			return t;
+		idx = (idx + 1) & (ECALL_HASH_SIZE - 1);
+	}
+
+	lo = 0;
+	hi = ecall_ranges_count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		t = ecall_ranges[mid];
+		if (extid < t->extid_start)
+			hi = mid;
+		else if (t->extid_end < extid)
+			lo = mid + 1;
+		else
+			return t;
+	}
+
+	return NULL;
+}
+
 struct sbi_ecall_extension *sbi_ecall_find_extension(unsigned long extid)
 {
 	struct sbi_ecall_extension *t, *ret = NULL;
 
+	if (ecall_lookup_ready)
+		return ecall_lookup_find(extid);
+
 	sbi_list_for_each_entry(t, &ecall_exts_list, head) {
 		if (t->extid_start <= extid && extid <= t->extid_end) {
 			ret = t;
@@ -73,7 +193,10 @@ int sbi_ecall_register_extension(struct sbi_ecall_extension *ext)
 	SBI_INIT_LIST_HEAD(&ext->head);
 	sbi_list_add_tail(&ext->head, &ecall_exts_list);
 
-	return 0;
+	if (ecall_lookup_ready)
+		ecall_lookup_build();
+
+	return sbi_ecall_stats_init();
 }
 
 void sbi_ecall_unregister_extension(struct sbi_ecall_extension *ext)
@@ -91,20 +214,25 @@ void sbi_ecall_unregister_extension(struct sbi_ecall_extension *ext)
 		}
 	}
 
-	if (found)
+	if (found) {
 		sbi_list_del_init(&ext->head);
+		if (ecall_lookup_ready)
+			ecall_lookup_build();
+	}
 }
 
-int sbi_ecall_handler(struct sbi_trap_context *tcntx)
+static void ecall_handle_regs(struct sbi_trap_regs *regs)
 {
+	unsigned long start_cycle = sbi_ecall_stats_begin();
 	int ret = 0;
-	struct sbi_trap_regs *regs = &tcntx->regs;
 	struct sbi_ecall_extension *ext;
 	unsigned long extension_id = regs->a7;
 	unsigned long func_id = regs->a6;
 	struct sbi_ecall_return out = {0};
 	bool is_0_1_spec = 0;
 
+	sbi_trace(SBI_TRACE_ECALL, extension_id, func_id);
+
 	ext = sbi_ecall_find_extension(extension_id);
 	if (ext && ext->handle) {
 		ret = ext->handle(extension_id, func_id, regs, &out);
@@ -139,9 +267,124 @@ int sbi_ecall_handler(struct sbi_trap_context *tcntx)
 			regs->a1 = out.value;
 	}
 
+	sbi_ecall_stats_end(extension_id, func_id, start_cycle);
+}
+
+int sbi_ecall_handler(struct sbi_trap_context *tcntx)
+{
+	ecall_handle_regs(&tcntx->regs);
+
 	return 0;
 }
 
+#ifdef CONFIG_SBI_MULTICALL
+/**
+ * Shared memory layout of one multicall entry
+ *
+ * The eid, fid and args are the a7, a6 and a0-a5 registers of the call
+ * whereas error and value are written back with its a0 and a1 results.
+ */
+struct multicall_entry {
+	unsigned long eid;
+	unsigned long fid;
+	unsigned long args[6];
+	unsigned long error;
+	unsigned long value;
+};
+
+static bool multicall_denied(unsigned long eid, unsigned long fid)
+{
+	/* Legacy calls don't follow the error and value convention */
+	if (eid <= SBI_EXT_0_1_SHUTDOWN)
+		return true;
+
+	switch (eid) {
+	case SBI_EXT_OPENSBI:
+	case SBI_EXT_SUSP:
+		return true;
+	case SBI_EXT_HSM:
+		return fid == SBI_EXT_HSM_HART_STOP ||
+		       fid == SBI_EXT_HSM_HART_SUSPEND;
+	case SBI_EXT_SSE:
+		return fid == SBI_EXT_SSE_COMPLETE;
+	case SBI_EXT_NACL:
+		return fid == SBI_EXT_NACL_SYNC_SRET;
+	default:
+		return false;
+	}
+}
+
+int sbi_ecall_multicall(struct sbi_trap_regs *regs, unsigned long addr_lo,
+			unsigned long addr_hi, unsigned long count)
+{
+	struct sbi_ecall_return out;
+	struct sbi_ecall_extension *ext;
+	struct multicall_entry e, *src;
+	struct sbi_trap_regs call_regs;
+	unsigned long i;
+	int ret;
+
+	if (!count || count > SBI_ECALL_MULTICALL_MAX)
+		return SBI_EINVAL;
+
+	/* M-mode can only access shared memory below 4GB on RV32 */
+	if (addr_hi)
+		return SBI_EINVALID_ADDR;
+
+	if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(),
+					 addr_lo, count * sizeof(*src), PRV_S,
+					 SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_EINVALID_ADDR;
+
+	src = (struct multicall_entry *)addr_lo;
+
+	for (i = 0; i < count; i++) {
+		/* The handlers may map shared memory of their own */
+		sbi_hart_map_saddr((unsigned long)&src[i], sizeof(e));
+		sbi_memcpy(&e, &src[i], sizeof(e));
+		sbi_hart_unmap_saddr();
+
+		sbi_trace(SBI_TRACE_ECALL, e.eid, e.fid);
+
+		sbi_memset(&out, 0, sizeof(out));
+		ext = sbi_ecall_find_extension(e.eid);
+		if (!ext || !ext->handle || multicall_denied(e.eid, e.fid)) {
+			ret = SBI_ENOTSUPP;
+		} else {
+			sbi_memcpy(&call_regs, regs, sizeof(call_regs));
+			call_regs.a0 = e.args[0];
+			call_regs.a1 = e.args[1];
+			call_regs.a2 = e.args[2];
+			call_regs.a3 = e.args[3];
+			call_regs.a4 = e.args[4];
+			call_regs.a5 = e.args[5];
+			call_regs.a6 = e.fid;
+			call_regs.a7 = e.eid;
+			ret = ext->handle(e.eid, e.fid, &call_regs, &out);
+			if (ret < SBI_LAST_ERR || SBI_SUCCESS < ret)
+				ret = SBI_ERR_FAILED;
+		}
+
+		e.error = ret;
+		e.value = out.value;
+		sbi_hart_map_saddr((unsigned long)&src[i], sizeof(e));
+		sbi_memcpy(&src[i].error, &e.error,
+			   sizeof(e.error) + sizeof(e.value));
+		sbi_hart_unmap_saddr();
+	}
+
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_SBI_ECALL_FASTPATH
+void sbi_ecall_fast_handler(struct sbi_trap_regs *regs)
+{
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_ECALL_FASTPATH);
+	ecall_handle_regs(regs);
+}
+#endif
+
 int sbi_ecall_init(void)
 {
 	int ret;
@@ -158,5 +401,7 @@ int sbi_ecall_init(void)
 			return ret;
 	}
 
+	ecall_lookup_build();
+
 	return 0;
 }
@@ -10,11 +10,9 @@
 
 #include <sbi/riscv_asm.h>
 #include <sbi/sbi_console.h>
-#include <sbi/sbi_domain.h>
 #include <sbi/sbi_ecall.h>
 #include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_error.h>
-#include <sbi/sbi_hsm.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_system.h>
@@ -24,22 +22,25 @@
 #include <sbi/sbi_unpriv.h>
 #include <sbi/sbi_hart.h>
 
+/*
+ * Get the target HARTs of a legacy IPI or remote fence. A NULL hart mask
+ * pointer means all HARTs which is passed on as hart mask base -1 so the
+ * request takes the same path as the SBI v0.2+ calls for all HARTs.
+ */
 static bool sbi_load_hart_mask_unpriv(ulong *pmask, ulong *hmask,
+				      ulong *hbase,
 				      struct sbi_trap_info *uptrap)
 {
-	ulong mask = 0;
-
-	if (pmask) {
-		mask = sbi_load_ulong(pmask, uptrap);
-		if (uptrap->cause)
-			return false;
-	} else {
-		sbi_hsm_hart_interruptible_mask(sbi_domain_thishart_ptr(),
-						0, &mask);
+	if (!pmask) {
+		*hmask = 0;
+		*hbase = -1UL;
+		return true;
 	}
-	*hmask = mask;
 
-	return true;
+	*hmask = sbi_load_ulong(pmask, uptrap);
+	*hbase = 0;
+
+	return !uptrap->cause;
 }
 
 static int sbi_ecall_legacy_handler(unsigned long extid, unsigned long funcid,
@@ -50,7 +51,22 @@ static int sbi_ecall_legacy_handler(unsigned long extid, unsigned long funcid,
 	struct sbi_tlb_info tlb_info;
 	u32 source_hart = current_hartid();
 	struct sbi_trap_info trap = {0};
-	ulong hmask = 0;
+	ulong hmask = 0, hbase = 0;
+
+	switch (extid) {
+	case SBI_EXT_0_1_SEND_IPI:
+	case SBI_EXT_0_1_REMOTE_FENCE_I:
+	case SBI_EXT_0_1_REMOTE_SFENCE_VMA:
+	case SBI_EXT_0_1_REMOTE_SFENCE_VMA_ASID:
+		/* The hart mask is read once before dispatching the call */
+		if (!sbi_load_hart_mask_unpriv((ulong *)regs->a0, &hmask,
+					       &hbase, &trap)) {
+			sbi_trap_redirect(regs, &trap);
+			out->skip_regs_update = true;
+			return 0;
+		}
+		break;
+	}
 
 	switch (extid) {
 	case SBI_EXT_0_1_SET_TIMER:
@@ -70,48 +86,24 @@ static int sbi_ecall_legacy_handler(unsigned long extid, unsigned long funcid,
 		sbi_ipi_clear_smode();
 		break;
 	case SBI_EXT_0_1_SEND_IPI:
-		if (sbi_load_hart_mask_unpriv((ulong *)regs->a0,
-						&hmask, &trap)) {
-			ret = sbi_ipi_send_smode(hmask, 0);
-		} else {
-			sbi_trap_redirect(regs, &trap);
-			out->skip_regs_update = true;
-		}
+		ret = sbi_ipi_send_smode(hmask, hbase);
 		break;
 	case SBI_EXT_0_1_REMOTE_FENCE_I:
-		if (sbi_load_hart_mask_unpriv((ulong *)regs->a0,
-						&hmask, &trap)) {
-			SBI_TLB_INFO_INIT(&tlb_info, 0, 0, 0, 0,
-					  SBI_TLB_FENCE_I, source_hart);
-			ret = sbi_tlb_request(hmask, 0, &tlb_info);
-		} else {
-			sbi_trap_redirect(regs, &trap);
-			out->skip_regs_update = true;
-		}
+		SBI_TLB_INFO_INIT(&tlb_info, 0, 0, 0, 0,
+				  SBI_TLB_FENCE_I, source_hart);
+		ret = sbi_tlb_request(hmask, hbase, &tlb_info);
 		break;
 	case SBI_EXT_0_1_REMOTE_SFENCE_VMA:
-		if (sbi_load_hart_mask_unpriv((ulong *)regs->a0,
-						&hmask, &trap)) {
-			SBI_TLB_INFO_INIT(&tlb_info, regs->a1, regs->a2, 0, 0,
-					  SBI_TLB_SFENCE_VMA, source_hart);
-			ret = sbi_tlb_request(hmask, 0, &tlb_info);
-		} else {
-			sbi_trap_redirect(regs, &trap);
-			out->skip_regs_update = true;
-		}
+		SBI_TLB_INFO_INIT(&tlb_info, regs->a1, regs->a2, 0, 0,
+				  SBI_TLB_SFENCE_VMA, source_hart);
+		ret = sbi_tlb_request(hmask, hbase, &tlb_info);
 		break;
 	case SBI_EXT_0_1_REMOTE_SFENCE_VMA_ASID:
-		if (sbi_load_hart_mask_unpriv((ulong *)regs->a0,
-						&hmask, &trap)) {
-			SBI_TLB_INFO_INIT(&tlb_info, regs->a1,
-					  regs->a2, regs->a3, 0,
-					  SBI_TLB_SFENCE_VMA_ASID,
-					  source_hart);
-			ret = sbi_tlb_request(hmask, 0, &tlb_info);
-		} else {
-			sbi_trap_redirect(regs, &trap);
-			out->skip_regs_update = true;
-		}
+		SBI_TLB_INFO_INIT(&tlb_info, regs->a1,
+				  regs->a2, regs->a3, 0,
+				  SBI_TLB_SFENCE_VMA_ASID,
+				  source_hart);
+		ret = sbi_tlb_request(hmask, hbase, &tlb_info);
 		break;
 	case SBI_EXT_0_1_SHUTDOWN:
 		sbi_system_reset(SBI_SRST_RESET_TYPE_SHUTDOWN,
@@ -0,0 +1,60 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_nacl.h>
+#include <sbi/sbi_trap.h>
+
+static int sbi_ecall_nacl_handler(unsigned long extid, unsigned long funcid,
+				  struct sbi_trap_regs *regs,
+				  struct sbi_ecall_return *out)
+{
+	int ret = 0;
+
+	switch (funcid) {
+	case SBI_EXT_NACL_PROBE_FEATURE:
+		ret = sbi_nacl_probe_feature(regs->a0, &out->value);
+		break;
+	case SBI_EXT_NACL_SET_SHMEM:
+		ret = sbi_nacl_set_shmem(regs->a0, regs->a1, regs->a2);
+		break;
+	case SBI_EXT_NACL_SYNC_CSR:
+		ret = sbi_nacl_sync_csr(regs->a0);
+		break;
+	case SBI_EXT_NACL_SYNC_HFENCE:
+		ret = sbi_nacl_sync_hfence(regs->a0);
+		break;
+	case SBI_EXT_NACL_SYNC_SRET:
+		ret = sbi_nacl_sync_sret(regs);
+		/* The registers were already updated for the SRET target */
+		if (!ret)
+			out->skip_regs_update = true;
+		break;
+	default:
+		ret = SBI_ENOTSUPP;
+		break;
+	}
+
+	return ret;
+}
+
+struct sbi_ecall_extension ecall_nacl;
+
+static int sbi_ecall_nacl_register_extensions(void)
+{
+	if (!misa_extension('H'))
+		return 0;
+
+	return sbi_ecall_register_extension(&ecall_nacl);
+}
+
+struct sbi_ecall_extension ecall_nacl = {
+	.extid_start		= SBI_EXT_NACL,
+	.extid_end		= SBI_EXT_NACL,
+	.register_extensions	= sbi_ecall_nacl_register_extensions,
+	.handle			= sbi_ecall_nacl_handler,
+};
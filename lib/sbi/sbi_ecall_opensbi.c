@@ -0,0 +1,251 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/sbi_cache.h>
+#include <sbi/sbi_cppc.h>
+#include <sbi/sbi_dbtr.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_domain_context.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_ecall_stats.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_hsm.h>
+#include <sbi/sbi_hsm_idle_stats.h>
+#include <sbi/sbi_lockstat.h>
+#include <sbi/sbi_misaligned_stats.h>
+#include <sbi/sbi_pmu.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_tlb.h>
+#include <sbi/sbi_trace.h>
+#include <sbi/sbi_trap.h>
+
+#ifdef CONFIG_SBI_RFENCE_BATCH
+/**
+ * Shared memory layout of one batched remote fence request
+ *
+ * The type is one of the SBI_EXT_RFENCE_REMOTE_xyz function IDs except
+ * FENCE_I whereas id is the ASID or VMID required by the function.
+ */
+struct opensbi_rfence_batch_entry {
+	unsigned long start;
+	unsigned long size;
+	unsigned long id;
+	unsigned long type;
+};
+
+static int opensbi_rfence_entry_to_tlb(struct opensbi_rfence_batch_entry *e,
+				       struct sbi_tlb_info *tinfo,
+				       u32 source_hart)
+{
+	unsigned long vmid = 0;
+
+	if (e->type >= SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA_VMID &&
+	    e->type <= SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA) {
+		if (!misa_extension('H'))
+			return SBI_ENOTSUPP;
+		vmid = (csr_read(CSR_HGATP) & HGATP_VMID_MASK);
+		vmid = vmid >> HGATP_VMID_SHIFT;
+	}
+
+	switch (e->type) {
+	case SBI_EXT_RFENCE_REMOTE_SFENCE_VMA:
+		SBI_TLB_INFO_INIT(tinfo, e->start, e->size, 0, 0,
+				  SBI_TLB_SFENCE_VMA, source_hart);
+		break;
+	case SBI_EXT_RFENCE_REMOTE_SFENCE_VMA_ASID:
+		SBI_TLB_INFO_INIT(tinfo, e->start, e->size, e->id, 0,
+				  SBI_TLB_SFENCE_VMA_ASID, source_hart);
+		break;
+	case SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA_VMID:
+		SBI_TLB_INFO_INIT(tinfo, e->start, e->size, 0, e->id,
+				  SBI_TLB_HFENCE_GVMA_VMID, source_hart);
+		break;
+	case SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA:
+		SBI_TLB_INFO_INIT(tinfo, e->start, e->size, 0, 0,
+				  SBI_TLB_HFENCE_GVMA, source_hart);
+		break;
+	case SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA_ASID:
+		SBI_TLB_INFO_INIT(tinfo, e->start, e->size, e->id, vmid,
+				  SBI_TLB_HFENCE_VVMA_ASID, source_hart);
+		break;
+	case SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA:
+		SBI_TLB_INFO_INIT(tinfo, e->start, e->size, 0, vmid,
+				  SBI_TLB_HFENCE_VVMA, source_hart);
+		break;
+	default:
+		return SBI_EINVAL;
+	}
+
+	return 0;
+}
+
+static int opensbi_rfence_batch(unsigned long hmask, unsigned long hbase,
+				unsigned long addr_lo, unsigned long addr_hi,
+				unsigned long count)
+{
+	struct sbi_tlb_info *entries = sbi_tlb_batch_entries();
+	struct opensbi_rfence_batch_entry e, *src;
+	u32 source_hart = current_hartid();
+	unsigned long i, size;
+	int ret = 0;
+
+	if (!entries)
+		return SBI_ENOTSUPP;
+
+	if (!count || count > SBI_TLB_BATCH_MAX)
+		return SBI_EINVAL;
+
+	/* M-mode can only access shared memory below 4GB on RV32 */
+	if (addr_hi)
+		return SBI_EINVALID_ADDR;
+
+	size = count * sizeof(*src);
+	if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(),
+					 addr_lo, size, PRV_S,
+					 SBI_DOMAIN_READ))
+		return SBI_EINVALID_ADDR;
+
+	src = (struct opensbi_rfence_batch_entry *)addr_lo;
+
+	sbi_hart_map_saddr(addr_lo, size);
+	for (i = 0; i < count; i++) {
+		sbi_memcpy(&e, &src[i], sizeof(e));
+		ret = opensbi_rfence_entry_to_tlb(&e, &entries[i],
+						  source_hart);
+		if (ret)
+			break;
+	}
+	sbi_hart_unmap_saddr();
+
+	if (ret)
+		return ret;
+
+	return sbi_tlb_request_batch(hmask, hbase, count);
+}
+#endif
+
+static int sbi_ecall_opensbi_handler(unsigned long extid, unsigned long funcid,
+				     struct sbi_trap_regs *regs,
+				     struct sbi_ecall_return *out)
+{
+	int ret = 0;
+
+	switch (funcid) {
+#ifdef CONFIG_SBI_ECALL_STATS
+	case SBI_EXT_OPENSBI_ECALL_STATS_READ:
+		ret = sbi_ecall_stats_read(regs->a0, regs->a1, regs->a2,
+					   regs->a3, regs->a4, &out->value);
+		break;
+#endif
+#ifdef CONFIG_SBI_RFENCE_BATCH
+	case SBI_EXT_OPENSBI_RFENCE_BATCH:
+		ret = opensbi_rfence_batch(regs->a0, regs->a1, regs->a2,
+					   regs->a3, regs->a4);
+		break;
+#endif
+#ifdef CONFIG_SBI_MISALIGNED_STATS
+	case SBI_EXT_OPENSBI_MISALIGNED_STATS_READ:
+		ret = sbi_misaligned_stats_read(regs->a0, regs->a1, regs->a2,
+						regs->a3, regs->a4,
+						&out->value);
+		break;
+#endif
+#ifdef CONFIG_SBI_HSM_IDLE_STATS
+	case SBI_EXT_OPENSBI_IDLE_STATS_READ:
+		ret = sbi_hsm_idle_stats_read(regs->a0, regs->a1, regs->a2,
+					      regs->a3, regs->a4, &out->value);
+		break;
+#endif
+#ifdef CONFIG_SBI_ECALL_DBTR
+	case SBI_EXT_OPENSBI_DBTR_APPLY:
+		ret = sbi_dbtr_apply_trig(regs->a0, regs->a1, &out->value);
+		break;
+	case SBI_EXT_OPENSBI_DBTR_ALLOC_FAILURES:
+		ret = sbi_dbtr_alloc_failures(regs->a0, &out->value);
+		break;
+#endif
+#ifdef CONFIG_SBI_DOMAIN_CALL
+	case SBI_EXT_OPENSBI_DOMAIN_CALL:
+		ret = sbi_domain_context_call(sbi_domain_find_index(regs->a0),
+					      regs);
+		/* The registers were already updated for the callee */
+		if (!ret)
+			out->skip_regs_update = true;
+		break;
+	case SBI_EXT_OPENSBI_DOMAIN_RETURN:
+		ret = sbi_domain_context_return(regs);
+		if (!ret)
+			out->skip_regs_update = true;
+		break;
+#endif
+#ifdef CONFIG_SBI_PMU_MUX
+	case SBI_EXT_OPENSBI_PMU_MUX_SET:
+		ret = sbi_pmu_mux_set(regs->a0, regs->a1, regs->a2,
+				      regs->a3, regs->a4);
+		break;
+#endif
+#ifdef CONFIG_SBI_CPPC_SHMEM
+	case SBI_EXT_OPENSBI_CPPC_SET_SHMEM:
+		ret = sbi_cppc_set_shmem(regs->a0, regs->a1, regs->a2);
+		break;
+#endif
+#ifdef CONFIG_SBI_CACHE_OPS
+	case SBI_EXT_OPENSBI_CACHE_RANGE_OP:
+		ret = sbi_cache_range_op(regs->a0, regs->a1, regs->a2,
+					 regs->a3);
+		break;
+#endif
+#ifdef CONFIG_SBI_MULTICALL
+	case SBI_EXT_OPENSBI_MULTICALL:
+		ret = sbi_ecall_multicall(regs, regs->a0, regs->a1, regs->a2);
+		break;
+#endif
+#ifdef CONFIG_SBI_TRACE
+	case SBI_EXT_OPENSBI_TRACE_READ:
+		ret = sbi_trace_read(regs->a0, regs->a1, regs->a2,
+				     regs->a3, regs->a4, &out->value);
+		break;
+#endif
+	case SBI_EXT_OPENSBI_HSM_START_MANY:
+		ret = sbi_hsm_hart_start_many(sbi_scratch_thishart_ptr(),
+					      sbi_domain_thishart_ptr(),
+					      regs->a0, regs->a1, regs->a2,
+					      (csr_read(CSR_MSTATUS) &
+					       MSTATUS_MPP) >> MSTATUS_MPP_SHIFT,
+					      regs->a3, &out->value);
+		break;
+	case SBI_EXT_OPENSBI_HSM_GET_STATES:
+		ret = sbi_hsm_hart_get_states(sbi_domain_thishart_ptr(),
+					      regs->a0, regs->a1, regs->a2,
+					      regs->a3, &out->value);
+		break;
+#ifdef CONFIG_SBI_LOCKSTAT
+	case SBI_EXT_OPENSBI_LOCKSTAT_READ:
+		ret = sbi_lockstat_read(regs->a0, regs->a1, regs->a2,
+					regs->a3, &out->value);
+		break;
+#endif
+	default:
+		ret = SBI_ENOTSUPP;
+	}
+
+	return ret;
+}
+
+struct sbi_ecall_extension ecall_opensbi;
+
+static int sbi_ecall_opensbi_register_extensions(void)
+{
+	return sbi_ecall_register_extension(&ecall_opensbi);
+}
+
+struct sbi_ecall_extension ecall_opensbi = {
+	.extid_start		= SBI_EXT_OPENSBI,
+	.extid_end		= SBI_EXT_OPENSBI,
+	.register_extensions	= sbi_ecall_opensbi_register_extensions,
+	.handle			= sbi_ecall_opensbi_handler,
+};
@@ -0,0 +1,46 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_sta.h>
+#include <sbi/sbi_trap.h>
+
+static int sbi_ecall_sta_handler(unsigned long extid, unsigned long funcid,
+				 struct sbi_trap_regs *regs,
+				 struct sbi_ecall_return *out)
+{
+	int ret = 0;
+
+	switch (funcid) {
+	case SBI_EXT_STA_STEAL_TIME_SET_SHMEM:
+		ret = sbi_sta_set_shmem(regs->a0, regs->a1, regs->a2);
+		break;
+	default:
+		ret = SBI_ENOTSUPP;
+		break;
+	}
+
+	return ret;
+}
+
+struct sbi_ecall_extension ecall_sta;
+
+static int sbi_ecall_sta_register_extensions(void)
+{
+	/* Time is only stolen when HARTs are shared with other domains */
+	if (!sbi_domain_find_index(1))
+		return 0;
+
+	return sbi_ecall_register_extension(&ecall_sta);
+}
+
+struct sbi_ecall_extension ecall_sta = {
+	.extid_start		= SBI_EXT_STA,
+	.extid_end		= SBI_EXT_STA,
+	.register_extensions	= sbi_ecall_sta_register_extensions,
+	.handle			= sbi_ecall_sta_handler,
+};
@@ -0,0 +1,186 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/sbi_bitops.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_ecall_stats.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_heap.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
+
+/** Per-HART ecall latency statistics */
+struct ecall_stats_hart {
+	/* Number of ecalls not recorded because the table was full */
+	unsigned long dropped;
+	struct sbi_ecall_stats_entry entries[SBI_ECALL_STATS_MAX_ENTRIES];
+};
+
+/** Offset of pointer to ecall statistics in scratch space */
+static unsigned long ecall_stats_ptr_offset;
+
+#define ecall_stats_get_ptr(__scratch)					\
+	(ecall_stats_ptr_offset ?					\
+	 sbi_scratch_read_type((__scratch), void *, ecall_stats_ptr_offset) \
+	 : NULL)
+
+static struct sbi_ecall_stats_entry *ecall_stats_find(
+					struct ecall_stats_hart *es,
+					unsigned long extid,
+					unsigned long funcid)
+{
+	struct sbi_ecall_stats_entry *e;
+	unsigned long i, idx;
+
+	idx = ((u32)(extid ^ (funcid << 16)) * 0x9E3779B1U) %
+	      SBI_ECALL_STATS_MAX_ENTRIES;
+	for (i = 0; i < SBI_ECALL_STATS_MAX_ENTRIES; i++) {
+		e = &es->entries[idx];
+		if (!e->count) {
+			e->extid = extid;
+			e->funcid = funcid;
+			return e;
+		}
+		if (e->extid == (u32)extid && e->funcid == (u32)funcid)
+			return e;
+		idx = (idx + 1) % SBI_ECALL_STATS_MAX_ENTRIES;
+	}
+
+	return NULL;
+}
+
+void sbi_ecall_stats_end(unsigned long extid, unsigned long funcid,
+			 unsigned long start_cycle)
+{
+	unsigned long cycles = csr_read(CSR_MCYCLE) - start_cycle;
+	struct ecall_stats_hart *es;
+	struct sbi_ecall_stats_entry *e;
+	unsigned long bucket;
+
+	es = ecall_stats_get_ptr(sbi_scratch_thishart_ptr());
+	if (!es)
+		return;
+
+	e = ecall_stats_find(es, extid, funcid);
+	if (!e) {
+		es->dropped++;
+		return;
+	}
+
+	bucket = cycles ? sbi_fls(cycles) : 0;
+	if (bucket >= SBI_ECALL_STATS_HIST_BUCKETS)
+		bucket = SBI_ECALL_STATS_HIST_BUCKETS - 1;
+
+	e->hist[bucket]++;
+	e->total_cycles += cycles;
+	if (e->max_cycles < cycles)
+		e->max_cycles = cycles;
+	e->count++;
+}
+
+int sbi_ecall_stats_read(u32 hartid, unsigned long addr_lo,
+			 unsigned long addr_hi, unsigned long size,
+			 unsigned long flags, unsigned long *out_count)
+{
+	struct sbi_scratch *scratch = sbi_hartid_to_scratch(hartid);
+	struct sbi_ecall_stats_entry *dst;
+	struct ecall_stats_hart *es;
+	unsigned long i, count = 0, max;
+
+	if (flags & ~SBI_EXT_OPENSBI_ECALL_STATS_FLAG_CLEAR)
+		return SBI_EINVAL;
+
+	if (!scratch)
+		return SBI_EINVAL;
+
+	es = ecall_stats_get_ptr(scratch);
+	if (!es)
+		return SBI_ENOTSUPP;
+
+	/* M-mode can only access shared memory below 4GB on RV32 */
+	if (addr_hi)
+		return SBI_EINVALID_ADDR;
+
+	if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(),
+					 addr_lo, size, PRV_S,
+					 SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_EINVALID_ADDR;
+
+	max = size / sizeof(*dst);
+	dst = (struct sbi_ecall_stats_entry *)addr_lo;
+
+	sbi_hart_map_saddr(addr_lo, size);
+	for (i = 0; i < SBI_ECALL_STATS_MAX_ENTRIES && count < max; i++) {
+		if (!es->entries[i].count)
+			continue;
+		sbi_memcpy(&dst[count++], &es->entries[i], sizeof(*dst));
+	}
+	sbi_hart_unmap_saddr();
+
+	if (flags & SBI_EXT_OPENSBI_ECALL_STATS_FLAG_CLEAR)
+		sbi_memset(es, 0, sizeof(*es));
+
+	*out_count = count;
+
+	return 0;
+}
+
+void sbi_ecall_stats_dump(struct sbi_scratch *scratch)
+{
+	struct ecall_stats_hart *es = ecall_stats_get_ptr(scratch);
+	struct sbi_ecall_stats_entry *e;
+	unsigned long i, j;
+
+	if (!es)
+		return;
+
+	sbi_printf("HART%u ecall statistics (dropped %lu)\n",
+		   current_hartid(), es->dropped);
+	for (i = 0; i < SBI_ECALL_STATS_MAX_ENTRIES; i++) {
+		e = &es->entries[i];
+		if (!e->count)
+			continue;
+
+		sbi_printf("  ext=0x%08x func=0x%x count=%lu avg=%lu max=%lu\n",
+			   e->extid, e->funcid, (ulong)e->count,
+			   (ulong)(e->total_cycles / e->count),
+			   (ulong)e->max_cycles);
+		sbi_printf("   ");
+		for (j = 0; j < SBI_ECALL_STATS_HIST_BUCKETS; j++) {
+			if (e->hist[j])
+				sbi_printf(" 2^%lu:%u", j, e->hist[j]);
+		}
+		sbi_printf("\n");
+	}
+}
+
+int sbi_ecall_stats_init(void)
+{
+	struct sbi_scratch *scratch;
+	struct ecall_stats_hart *es;
+	u32 i;
+
+	ecall_stats_ptr_offset = sbi_scratch_alloc_type_offset(void *);
+	if (!ecall_stats_ptr_offset)
+		return SBI_ENOMEM;
+
+	for (i = 0; i <= sbi_scratch_last_hartindex(); i++) {
+		scratch = sbi_hartindex_to_scratch(i);
+		if (!scratch)
+			continue;
+
+		es = sbi_zalloc(sizeof(*es));
+		if (!es)
+			return SBI_ENOMEM;
+
+		sbi_scratch_write_type(scratch, void *,
+				       ecall_stats_ptr_offset, es);
+	}
+
+	return 0;
+}
@@ -0,0 +1,367 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Emulation of the Zba, Zbb, Zbs and Zicond instructions for HARTs
+ * which don't implement them
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_bitops.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_emulate_bitmanip.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_trap.h>
+
+#define OPCODE_OP_IMM			0x13
+#define OPCODE_OP_IMM_32		0x1b
+#define OPCODE_OP			0x33
+#define OPCODE_OP_32			0x3b
+
+#define INSN_FUNCT7(insn)		(((insn) >> 25) & 0x7f)
+#define INSN_RS2_NUM(insn)		(((insn) >> SH_RS2) & 0x1f)
+#define INSN_IMM12(insn)		(((insn) >> 20) & 0xfff)
+
+/* Register-register instructions by funct7 and funct3 */
+#define OP_FUNCT(f7, f3)		(((f7) << 3) | (f3))
+
+#define XLEN_MASK			(__riscv_xlen - 1)
+
+#if __riscv_xlen == 64
+#define IMM_REV8			0x6b8
+#else
+#define IMM_REV8			0x698
+#endif
+
+#define BITMANIP_HOT_ENTRIES		8
+
+/** Instructions emulated recently by one HART, indexed by address */
+struct bitmanip_hot {
+	ulong mepc[BITMANIP_HOT_ENTRIES];
+	u32 count[BITMANIP_HOT_ENTRIES];
+};
+
+static SBI_SCRATCH_DEFINE(struct bitmanip_hot, bitmanip_hot);
+
+static void bitmanip_account(ulong mepc)
+{
+	struct bitmanip_hot *hot = sbi_scratch_thishart_var_ptr(bitmanip_hot);
+	u32 i = (mepc >> 1) & (BITMANIP_HOT_ENTRIES - 1);
+
+	if (hot->mepc[i] != mepc) {
+		hot->mepc[i] = mepc;
+		hot->count[i] = 0;
+	}
+
+	/* The count saturates so each hot instruction is reported once */
+	if (hot->count[i] < CONFIG_SBI_EMULATE_BITMANIP_HOT &&
+	    ++hot->count[i] == CONFIG_SBI_EMULATE_BITMANIP_HOT)
+		sbi_printf("%s: hart%d emulated the instruction at 0x%lx "
+			   "%u times\n", __func__, current_hartid(), mepc,
+			   hot->count[i]);
+}
+
+static ulong bitmanip_rol(ulong x, ulong sh)
+{
+	sh &= XLEN_MASK;
+	return sh ? (x << sh) | (x >> (__riscv_xlen - sh)) : x;
+}
+
+static ulong bitmanip_ror(ulong x, ulong sh)
+{
+	sh &= XLEN_MASK;
+	return sh ? (x >> sh) | (x << (__riscv_xlen - sh)) : x;
+}
+
+static ulong bitmanip_clz(ulong x)
+{
+	return x ? __riscv_xlen - 1 - sbi_fls(x) : __riscv_xlen;
+}
+
+static ulong bitmanip_ctz(ulong x)
+{
+	return x ? sbi_ffs(x) : __riscv_xlen;
+}
+
+static ulong bitmanip_orc_b(ulong x)
+{
+	ulong r = 0;
+	int i;
+
+	for (i = 0; i < __riscv_xlen; i += 8) {
+		if ((x >> i) & 0xff)
+			r |= 0xffUL << i;
+	}
+
+	return r;
+}
+
+static ulong bitmanip_rev8(ulong x)
+{
+	ulong r = 0;
+	int i;
+
+	for (i = 0; i < __riscv_xlen; i += 8)
+		r |= ((x >> i) & 0xff) << (__riscv_xlen - 8 - i);
+
+	return r;
+}
+
+static int bitmanip_op(ulong insn, ulong a, ulong b, ulong *rd)
+{
+	ulong bit = 1UL << (b & XLEN_MASK);
+
+	switch (OP_FUNCT(INSN_FUNCT7(insn), GET_RM(insn))) {
+	/* Zba */
+	case OP_FUNCT(0x10, 2):
+		*rd = (a << 1) + b;
+		break;
+	case OP_FUNCT(0x10, 4):
+		*rd = (a << 2) + b;
+		break;
+	case OP_FUNCT(0x10, 6):
+		*rd = (a << 3) + b;
+		break;
+	/* Zbb */
+	case OP_FUNCT(0x20, 7):
+		*rd = a & ~b;
+		break;
+	case OP_FUNCT(0x20, 6):
+		*rd = a | ~b;
+		break;
+	case OP_FUNCT(0x20, 4):
+		*rd = ~(a ^ b);
+		break;
+	case OP_FUNCT(0x05, 4):
+		*rd = ((long)a < (long)b) ? a : b;
+		break;
+	case OP_FUNCT(0x05, 5):
+		*rd = (a < b) ? a : b;
+		break;
+	case OP_FUNCT(0x05, 6):
+		*rd = ((long)a < (long)b) ? b : a;
+		break;
+	case OP_FUNCT(0x05, 7):
+		*rd = (a < b) ? b : a;
+		break;
+	case OP_FUNCT(0x30, 1):
+		*rd = bitmanip_rol(a, b);
+		break;
+	case OP_FUNCT(0x30, 5):
+		*rd = bitmanip_ror(a, b);
+		break;
+#if __riscv_xlen == 32
+	case OP_FUNCT(0x04, 4):
+		if (INSN_RS2_NUM(insn))
+			return SBI_ENOTSUPP;
+		*rd = a & 0xffff;
+		break;
+#endif
+	/* Zbs */
+	case OP_FUNCT(0x24, 1):
+		*rd = a & ~bit;
+		break;
+	case OP_FUNCT(0x24, 5):
+		*rd = (a & bit) ? 1 : 0;
+		break;
+	case OP_FUNCT(0x34, 1):
+		*rd = a ^ bit;
+		break;
+	case OP_FUNCT(0x14, 1):
+		*rd = a | bit;
+		break;
+	/* Zicond */
+	case OP_FUNCT(0x07, 5):
+		*rd = b ? a : 0;
+		break;
+	case OP_FUNCT(0x07, 7):
+		*rd = b ? 0 : a;
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	}
+
+	return 0;
+}
+
+static int bitmanip_op_imm(ulong insn, ulong a, ulong *rd)
+{
+	u32 imm = INSN_IMM12(insn);
+	ulong bit = 1UL << (imm & XLEN_MASK);
+
+	switch (GET_RM(insn)) {
+	case 1:
+		switch (imm) {
+		case 0x600:
+			*rd = bitmanip_clz(a);
+			return 0;
+		case 0x601:
+			*rd = bitmanip_ctz(a);
+			return 0;
+		case 0x602:
+			*rd = sbi_popcount(a);
+			return 0;
+		case 0x604:
+			*rd = (long)(signed char)a;
+			return 0;
+		case 0x605:
+			*rd = (long)(s16)a;
+			return 0;
+		}
+		break;
+	case 5:
+		switch (imm) {
+		case 0x287:
+			*rd = bitmanip_orc_b(a);
+			return 0;
+		case IMM_REV8:
+			*rd = bitmanip_rev8(a);
+			return 0;
+		}
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	}
+
+	/* The shift amount only has 5 bits on RV32 */
+	if (__riscv_xlen == 32 && (imm & 0x20))
+		return SBI_ENOTSUPP;
+
+	switch (((imm >> 6) << 3) | GET_RM(insn)) {
+	case (0x18 << 3) | 5:
+		*rd = bitmanip_ror(a, imm);
+		break;
+	case (0x12 << 3) | 1:
+		*rd = a & ~bit;
+		break;
+	case (0x12 << 3) | 5:
+		*rd = (a & bit) ? 1 : 0;
+		break;
+	case (0x1a << 3) | 1:
+		*rd = a ^ bit;
+		break;
+	case (0x0a << 3) | 1:
+		*rd = a | bit;
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	}
+
+	return 0;
+}
+
+#if __riscv_xlen == 64
+static u32 bitmanip_rol32(u32 x, ulong sh)
+{
+	sh &= 31;
+	return sh ? (x << sh) | (x >> (32 - sh)) : x;
+}
+
+static int bitmanip_op_32(ulong insn, ulong a, ulong b, ulong *rd)
+{
+	ulong a_uw = a & 0xffffffffUL;
+
+	switch (OP_FUNCT(INSN_FUNCT7(insn), GET_RM(insn))) {
+	/* Zba */
+	case OP_FUNCT(0x04, 0):
+		*rd = a_uw + b;
+		break;
+	case OP_FUNCT(0x10, 2):
+		*rd = (a_uw << 1) + b;
+		break;
+	case OP_FUNCT(0x10, 4):
+		*rd = (a_uw << 2) + b;
+		break;
+	case OP_FUNCT(0x10, 6):
+		*rd = (a_uw << 3) + b;
+		break;
+	/* Zbb */
+	case OP_FUNCT(0x04, 4):
+		if (INSN_RS2_NUM(insn))
+			return SBI_ENOTSUPP;
+		*rd = a & 0xffff;
+		break;
+	case OP_FUNCT(0x30, 1):
+		*rd = (long)(s32)bitmanip_rol32(a, b);
+		break;
+	case OP_FUNCT(0x30, 5):
+		*rd = (long)(s32)bitmanip_rol32(a, 32 - (b & 31));
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	}
+
+	return 0;
+}
+
+static int bitmanip_op_imm_32(ulong insn, ulong a, ulong *rd)
+{
+	u32 imm = INSN_IMM12(insn);
+	u32 a_w = a;
+
+	switch (GET_RM(insn)) {
+	case 1:
+		switch (imm) {
+		case 0x600:
+			*rd = a_w ? 31 - sbi_fls(a_w) : 32;
+			return 0;
+		case 0x601:
+			*rd = a_w ? sbi_ffs(a_w) : 32;
+			return 0;
+		case 0x602:
+			*rd = sbi_popcount(a_w);
+			return 0;
+		}
+		/* Zba slli.uw */
+		if ((imm >> 6) == 0x02) {
+			*rd = (a & 0xffffffffUL) << (imm & 0x3f);
+			return 0;
+		}
+		break;
+	case 5:
+		/* Zbb roriw */
+		if ((imm >> 5) == 0x30) {
+			*rd = (long)(s32)bitmanip_rol32(a_w, 32 - (imm & 31));
+			return 0;
+		}
+		break;
+	}
+
+	return SBI_ENOTSUPP;
+}
+#endif
+
+int sbi_emulate_bitmanip(ulong insn, struct sbi_trap_regs *regs)
+{
+	ulong rs1 = GET_RS1(insn, regs), rs2 = GET_RS2(insn, regs), rd;
+	int rc;
+
+	switch (insn & 0x7f) {
+	case OPCODE_OP:
+		rc = bitmanip_op(insn, rs1, rs2, &rd);
+		break;
+	case OPCODE_OP_IMM:
+		rc = bitmanip_op_imm(insn, rs1, &rd);
+		break;
+#if __riscv_xlen == 64
+	case OPCODE_OP_32:
+		rc = bitmanip_op_32(insn, rs1, rs2, &rd);
+		break;
+	case OPCODE_OP_IMM_32:
+		rc = bitmanip_op_imm_32(insn, rs1, &rd);
+		break;
+#endif
+	default:
+		return SBI_ENOTSUPP;
+	}
+	if (rc)
+		return rc;
+
+	bitmanip_account(regs->mepc);
+
+	SET_RD(insn, regs, rd);
+	regs->mepc += 4;
+
+	return 0;
+}
@@ -7,6 +7,8 @@
  *   Atish Patra<atish.patra@wdc.com>
  *
  */
+#include <sbi/riscv_atomic.h>
+#include <sbi/riscv_barrier.h>
 #include <sbi/riscv_locks.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_fifo.h>
@@ -20,9 +22,194 @@ void sbi_fifo_init(struct sbi_fifo *fifo, void *queue_mem, u16 entries,
 	fifo->entry_size  = entry_size;
 	SPIN_LOCK_INIT(fifo->qlock);
 	fifo->avail = fifo->tail = 0;
+	fifo->seq = NULL;
 	sbi_memset(fifo->queue, 0, (size_t)entries * entry_size);
 }
 
+/*
+ * Lock-free multi-producer/single-consumer backend
+ *
+ * Each entry has a sequence number derived from the position of the
+ * entry. The entry at position pos is free for producers when its
+ * sequence is pos and ready for the consumer when its sequence is pos + 1.
+ * Producers reserve positions by updating head_pos using cmpxchg. The
+ * lowest bit of a sequence marks an entry as busy so that the consumer
+ * and in-place updaters never access the same ready entry concurrently.
+ * Positions wrap at pos_wrap, which is a multiple of num_entries.
+ */
+#define FIFO_MPSC_BUSY		1L
+
+static inline long fifo_mpsc_seq(unsigned long pos)
+{
+	return (long)(pos << 1);
+}
+
+static inline unsigned long fifo_mpsc_pos_add(struct sbi_fifo *fifo,
+					      unsigned long pos,
+					      unsigned long n)
+{
+	pos += n;
+	return (pos >= fifo->pos_wrap) ? pos - fifo->pos_wrap : pos;
+}
+
+static inline void *fifo_mpsc_entry(struct sbi_fifo *fifo, unsigned long pos)
+{
+	return (char *)fifo->queue +
+		(pos % fifo->num_entries) * fifo->entry_size;
+}
+
+static inline atomic_t *fifo_mpsc_entry_seq(struct sbi_fifo *fifo,
+					    unsigned long pos)
+{
+	return &fifo->seq[pos % fifo->num_entries];
+}
+
+void sbi_fifo_mpsc_init(struct sbi_fifo *fifo, void *queue_mem, u16 entries,
+			u16 entry_size)
+{
+	unsigned long i;
+
+	fifo->seq	  = queue_mem;
+	fifo->queue	  = (char *)queue_mem + entries * sizeof(atomic_t);
+	fifo->num_entries = entries;
+	fifo->entry_size  = entry_size;
+	SPIN_LOCK_INIT(fifo->qlock);
+	fifo->avail = fifo->tail = 0;
+	fifo->pos_wrap = ((-1UL) >> 2) / entries * entries;
+	sbi_memset(fifo->queue, 0, (size_t)entries * entry_size);
+	for (i = 0; i < entries; i++)
+		ATOMIC_INIT(&fifo->seq[i], fifo_mpsc_seq(i));
+	ATOMIC_INIT(&fifo->head_pos, 0);
+	ATOMIC_INIT(&fifo->tail_pos, 0);
+	smp_wmb();
+}
+
+static u16 fifo_mpsc_avail(struct sbi_fifo *fifo)
+{
+	unsigned long tail = atomic_read(&fifo->tail_pos);
+	unsigned long head = atomic_read(&fifo->head_pos);
+
+	if (head < tail)
+		head += fifo->pos_wrap;
+
+	return (head - tail < fifo->num_entries) ?
+		head - tail : fifo->num_entries;
+}
+
+static int fifo_mpsc_enqueue_start(struct sbi_fifo *fifo, void **entry,
+				   unsigned long *pos_out)
+{
+	unsigned long pos;
+	long seq;
+
+	while (1) {
+		pos = atomic_read(&fifo->head_pos);
+		seq = __smp_load_acquire(&fifo_mpsc_entry_seq(fifo, pos)->counter);
+		if (seq == fifo_mpsc_seq(pos)) {
+			if (atomic_cmpxchg(&fifo->head_pos, pos,
+				fifo_mpsc_pos_add(fifo, pos, 1)) == pos)
+				break;
+		} else if (atomic_read(&fifo->head_pos) == pos) {
+			/* Entry from previous lap is not yet consumed */
+			return SBI_ENOSPC;
+		}
+	}
+
+	*entry = fifo_mpsc_entry(fifo, pos);
+	*pos_out = pos;
+
+	return 0;
+}
+
+static void fifo_mpsc_enqueue_finish(struct sbi_fifo *fifo, unsigned long pos)
+{
+	__smp_store_release(&fifo_mpsc_entry_seq(fifo, pos)->counter,
+			    fifo_mpsc_seq(fifo_mpsc_pos_add(fifo, pos, 1)));
+}
+
+static int fifo_mpsc_dequeue_start(struct sbi_fifo *fifo, void **entry,
+				   unsigned long *pos_out)
+{
+	unsigned long pos = atomic_read(&fifo->tail_pos);
+	atomic_t *eseq = fifo_mpsc_entry_seq(fifo, pos);
+	long ready = fifo_mpsc_seq(fifo_mpsc_pos_add(fifo, pos, 1));
+	long seq;
+
+	while (1) {
+		seq = __smp_load_acquire(&eseq->counter);
+		if (seq == (ready | FIFO_MPSC_BUSY))
+			/* In-place update of this entry is in progress */
+			continue;
+		if (seq != ready)
+			return SBI_ENOENT;
+		if (atomic_cmpxchg(eseq, ready, ready | FIFO_MPSC_BUSY) == ready)
+			break;
+	}
+
+	*entry = fifo_mpsc_entry(fifo, pos);
+	*pos_out = pos;
+
+	return 0;
+}
+
+static void fifo_mpsc_dequeue_finish(struct sbi_fifo *fifo, unsigned long pos)
+{
+	atomic_write(&fifo->tail_pos, fifo_mpsc_pos_add(fifo, pos, 1));
+	__smp_store_release(&fifo_mpsc_entry_seq(fifo, pos)->counter,
+			    fifo_mpsc_seq(fifo_mpsc_pos_add(fifo, pos,
+							    fifo->num_entries)));
+}
+
+static int fifo_mpsc_inplace_update(struct sbi_fifo *fifo, void *in,
+				    int (*fptr)(void *in, void *data))
+{
+	unsigned long pos = atomic_read(&fifo->tail_pos);
+	unsigned long head = atomic_read(&fifo->head_pos);
+	int ret = SBI_FIFO_UNCHANGED;
+	atomic_t *eseq;
+	long ready;
+
+	for (; pos != head; pos = fifo_mpsc_pos_add(fifo, pos, 1)) {
+		eseq = fifo_mpsc_entry_seq(fifo, pos);
+		ready = fifo_mpsc_seq(fifo_mpsc_pos_add(fifo, pos, 1));
+		if (atomic_cmpxchg(eseq, ready, ready | FIFO_MPSC_BUSY) != ready)
+			continue;
+
+		ret = fptr(in, fifo_mpsc_entry(fifo, pos));
+
+		__smp_store_release(&eseq->counter, ready);
+
+		if (ret == SBI_FIFO_SKIP || ret == SBI_FIFO_UPDATED)
+			break;
+	}
+
+	return ret;
+}
+
+static int fifo_mpsc_inplace_update_pos(struct sbi_fifo *fifo,
+					unsigned long pos, void *in,
+					int (*fptr)(void *in, void *data))
+{
+	atomic_t *eseq;
+	long ready;
+	int ret;
+
+	if (pos >= fifo->pos_wrap)
+		return SBI_FIFO_UNCHANGED;
+
+	/* Positions are unique per lap so this also rejects stale ones */
+	eseq = fifo_mpsc_entry_seq(fifo, pos);
+	ready = fifo_mpsc_seq(fifo_mpsc_pos_add(fifo, pos, 1));
+	if (atomic_cmpxchg(eseq, ready, ready | FIFO_MPSC_BUSY) != ready)
+		return SBI_FIFO_UNCHANGED;
+
+	ret = fptr(in, fifo_mpsc_entry(fifo, pos));
+
+	__smp_store_release(&eseq->counter, ready);
+
+	return ret;
+}
+
 /* Note: must be called with fifo->qlock held */
 static inline bool __sbi_fifo_is_full(struct sbi_fifo *fifo)
 {
@@ -36,6 +223,9 @@ u16 sbi_fifo_avail(struct sbi_fifo *fifo)
 	if (!fifo)
 		return 0;
 
+	if (fifo->seq)
+		return fifo_mpsc_avail(fifo);
+
 	spin_lock(&fifo->qlock);
 	ret = fifo->avail;
 	spin_unlock(&fifo->qlock);
@@ -50,6 +240,9 @@ int sbi_fifo_is_full(struct sbi_fifo *fifo)
 	if (!fifo)
 		return SBI_EINVAL;
 
+	if (fifo->seq)
+		return fifo_mpsc_avail(fifo) == fifo->num_entries;
+
 	spin_lock(&fifo->qlock);
 	ret = __sbi_fifo_is_full(fifo);
 	spin_unlock(&fifo->qlock);
@@ -57,21 +250,6 @@ int sbi_fifo_is_full(struct sbi_fifo *fifo)
 	return ret;
 }
 
-/* Note: must be called with fifo->qlock held */
-static inline void  __sbi_fifo_enqueue(struct sbi_fifo *fifo, void *data)
-{
-	u32 head;
-
-	head = (u32)fifo->tail + fifo->avail;
-	if (head >= fifo->num_entries)
-		head = head - fifo->num_entries;
-
-	sbi_memcpy((char *)fifo->queue + head * fifo->entry_size, data, fifo->entry_size);
-
-	fifo->avail++;
-}
-
-
 /* Note: must be called with fifo->qlock held */
 static inline bool __sbi_fifo_is_empty(struct sbi_fifo *fifo)
 {
@@ -85,6 +263,9 @@ int sbi_fifo_is_empty(struct sbi_fifo *fifo)
 	if (!fifo)
 		return SBI_EINVAL;
 
+	if (fifo->seq)
+		return fifo_mpsc_avail(fifo) == 0;
+
 	spin_lock(&fifo->qlock);
 	ret = __sbi_fifo_is_empty(fifo);
 	spin_unlock(&fifo->qlock);
@@ -104,7 +285,8 @@ static inline void __sbi_fifo_reset(struct sbi_fifo *fifo)
 
 bool sbi_fifo_reset(struct sbi_fifo *fifo)
 {
-	if (!fifo)
+	/* The lock-free backend can't be reset while in use */
+	if (!fifo || fifo->seq)
 		return false;
 
 	spin_lock(&fifo->qlock);
@@ -116,7 +298,8 @@ bool sbi_fifo_reset(struct sbi_fifo *fifo)
 
 /**
  * Provide a helper function to do inplace update to the fifo.
- * Note: The callback function is called with lock being held.
+ * Note: The callback function is called with lock being held. For the
+ * lock-free backend, the callback is called with the entry marked busy.
  *
  * **Do not** invoke any other fifo function from callback. Otherwise, it will
  * lead to deadlock.
@@ -131,6 +314,9 @@ int sbi_fifo_inplace_update(struct sbi_fifo *fifo, void *in,
 	if (!fifo || !in)
 		return ret;
 
+	if (fifo->seq)
+		return fifo_mpsc_inplace_update(fifo, in, fptr);
+
 	spin_lock(&fifo->qlock);
 
 	if (__sbi_fifo_is_empty(fifo)) {
@@ -154,29 +340,89 @@ int sbi_fifo_inplace_update(struct sbi_fifo *fifo, void *in,
 	return ret;
 }
 
-int sbi_fifo_enqueue(struct sbi_fifo *fifo, void *data)
+/**
+ * Same as sbi_fifo_inplace_update() but only for the entry at the given
+ * position as returned by sbi_fifo_enqueue_start(). Returns
+ * SBI_FIFO_UNCHANGED without calling the callback when that entry is no
+ * longer queued.
+ */
+int sbi_fifo_inplace_update_pos(struct sbi_fifo *fifo, unsigned long pos,
+				void *in, int (*fptr)(void *in, void *data))
 {
-	if (!fifo || !data)
+	int ret = SBI_FIFO_UNCHANGED;
+	unsigned long first;
+
+	if (!fifo || !in)
+		return ret;
+
+	if (fifo->seq)
+		return fifo_mpsc_inplace_update_pos(fifo, pos, in, fptr);
+
+	if (pos >= fifo->num_entries)
+		return ret;
+
+	spin_lock(&fifo->qlock);
+
+	/* Any queued entry is valid for the locked backend */
+	first = (pos < fifo->tail) ? pos + fifo->num_entries - fifo->tail :
+				     pos - fifo->tail;
+	if (first < fifo->avail)
+		ret = fptr(in, (char *)fifo->queue + pos * fifo->entry_size);
+
+	spin_unlock(&fifo->qlock);
+
+	return ret;
+}
+
+int sbi_fifo_enqueue_start(struct sbi_fifo *fifo, void **entry,
+			   unsigned long *pos)
+{
+	u32 head;
+
+	if (!fifo || !entry || !pos)
 		return SBI_EINVAL;
 
+	if (fifo->seq)
+		return fifo_mpsc_enqueue_start(fifo, entry, pos);
+
 	spin_lock(&fifo->qlock);
 
 	if (__sbi_fifo_is_full(fifo)) {
 		spin_unlock(&fifo->qlock);
 		return SBI_ENOSPC;
 	}
-	__sbi_fifo_enqueue(fifo, data);
 
-	spin_unlock(&fifo->qlock);
+	head = (u32)fifo->tail + fifo->avail;
+	if (head >= fifo->num_entries)
+		head = head - fifo->num_entries;
+
+	*entry = (char *)fifo->queue + head * fifo->entry_size;
+	*pos = head;
 
 	return 0;
 }
 
-int sbi_fifo_dequeue(struct sbi_fifo *fifo, void *data)
+void sbi_fifo_enqueue_finish(struct sbi_fifo *fifo, unsigned long pos)
+{
+	if (fifo->seq) {
+		fifo_mpsc_enqueue_finish(fifo, pos);
+		return;
+	}
+
+	fifo->avail++;
+
+	spin_unlock(&fifo->qlock);
+}
+
+int sbi_fifo_dequeue_start(struct sbi_fifo *fifo, void **entry,
+			   unsigned long *pos)
 {
-	if (!fifo || !data)
+	if (!fifo || !entry || !pos)
 		return SBI_EINVAL;
 
+	if (fifo->seq)
+		return fifo_mpsc_dequeue_start(fifo, entry, pos);
+
 	spin_lock(&fifo->qlock);
 
 	if (__sbi_fifo_is_empty(fifo)) {
@@ -184,8 +430,18 @@ int sbi_fifo_dequeue(struct sbi_fifo *fifo, void *data)
 		return SBI_ENOENT;
 	}
 
-	sbi_memcpy(data, (char *)fifo->queue + (u32)fifo->tail * fifo->entry_size,
-	       fifo->entry_size);
+	*entry = (char *)fifo->queue + (u32)fifo->tail * fifo->entry_size;
+	*pos = fifo->tail;
+
+	return 0;
+}
+
+void sbi_fifo_dequeue_finish(struct sbi_fifo *fifo, unsigned long pos)
+{
+	if (fifo->seq) {
+		fifo_mpsc_dequeue_finish(fifo, pos);
+		return;
+	}
 
 	fifo->avail--;
 	fifo->tail++;
@@ -193,6 +449,42 @@ int sbi_fifo_dequeue(struct sbi_fifo *fifo, void *data)
 		fifo->tail = 0;
 
 	spin_unlock(&fifo->qlock);
+}
+
+int sbi_fifo_enqueue(struct sbi_fifo *fifo, void *data)
+{
+	unsigned long pos;
+	void *entry;
+	int ret;
+
+	if (!data)
+		return SBI_EINVAL;
+
+	ret = sbi_fifo_enqueue_start(fifo, &entry, &pos);
+	if (ret)
+		return ret;
+
+	sbi_memcpy(entry, data, fifo->entry_size);
+	sbi_fifo_enqueue_finish(fifo, pos);
+
+	return 0;
+}
+
+int sbi_fifo_dequeue(struct sbi_fifo *fifo, void *data)
+{
+	unsigned long pos;
+	void *entry;
+	int ret;
+
+	if (!data)
+		return SBI_EINVAL;
+
+	ret = sbi_fifo_dequeue_start(fifo, &entry, &pos);
+	if (ret)
+		return ret;
+
+	sbi_memcpy(data, entry, fifo->entry_size);
+	sbi_fifo_dequeue_finish(fifo, pos);
 
 	return 0;
 }
@@ -11,8 +11,10 @@
 #include <sbi/sbi_bitmap.h>
 #include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_error.h>
+#include <sbi/sbi_fwft.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_heap.h>
+#include <sbi/sbi_platform.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_string.h>
 #include <sbi/sbi_types.h>
@@ -61,6 +63,13 @@ static const unsigned long fwft_defined_features[] = {
 	SBI_FWFT_PTE_AD_HW_UPDATING,
 };
 
+/* Local platform features are implemented by the platform itself */
+static bool fwft_is_platform_feature(enum sbi_fwft_feature_t feature)
+{
+	return (feature & SBI_FWFT_PLATFORM_FEATURE_BIT) &&
+	       !(feature & SBI_FWFT_GLOBAL_FEATURE_BIT);
+}
+
 static bool fwft_is_defined_feature(enum sbi_fwft_feature_t feature)
 {
 	int i;
@@ -191,6 +200,14 @@ int sbi_fwft_set(enum sbi_fwft_feature_t feature, unsigned long value,
 	int ret;
 	struct fwft_config *conf;
 
+	if (fwft_is_platform_feature(feature)) {
+		if ((flags & ~SBI_FWFT_SET_FLAG_LOCK) != 0)
+			return SBI_EINVAL;
+
+		return sbi_platform_fwft_set(sbi_platform_thishart_ptr(),
+					     feature, value, flags);
+	}
+
 	ret = fwft_get_feature(feature, &conf);
 	if (ret)
 		return ret;
@@ -215,6 +232,10 @@ int sbi_fwft_get(enum sbi_fwft_feature_t feature, unsigned long *out_val)
 	int ret;
 	struct fwft_config *conf;
 
+	if (fwft_is_platform_feature(feature))
+		return sbi_platform_fwft_get(sbi_platform_thishart_ptr(),
+					     feature, out_val);
+
 	ret = fwft_get_feature(feature, &conf);
 	if (ret)
 		return ret;
@@ -222,6 +243,39 @@ int sbi_fwft_get(enum sbi_fwft_feature_t feature, unsigned long *out_val)
 	return conf->feature->get(conf, out_val);
 }
 
+void sbi_fwft_context_switch(struct sbi_fwft_context *out,
+			     const struct sbi_fwft_context *in)
+{
+	struct fwft_hart_state *fhs = fwft_thishart_state_ptr();
+	unsigned long values = 0, locked = 0, value, want;
+	struct fwft_config *conf;
+	int i;
+
+	for (i = 0; i < fhs->config_count; i++) {
+		conf = &fhs->configs[i];
+		if (conf->feature->supported && conf->feature->supported(conf))
+			continue;
+		if (conf->feature->get(conf, &value))
+			continue;
+
+		if (value)
+			values |= BIT(i);
+		if (conf->flags & SBI_FWFT_SET_FLAG_LOCK)
+			locked |= BIT(i);
+
+		/* Only features whose value differs are written */
+		want = (in->valid && (in->values & BIT(i))) ? 1 : 0;
+		if (value != want)
+			conf->feature->set(conf, want);
+		conf->flags = (in->valid && (in->locked & BIT(i))) ?
+			      SBI_FWFT_SET_FLAG_LOCK : 0;
+	}
+
+	out->values = values;
+	out->locked = locked;
+	out->valid = true;
+}
+
 static const struct fwft_feature features[] =
 {
 	{
@@ -11,12 +11,14 @@
 #include <sbi/riscv_barrier.h>
 #include <sbi/riscv_encoding.h>
 #include <sbi/riscv_fp.h>
+#include <sbi/riscv_locks.h>
 #include <sbi/sbi_bitops.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_domain.h>
 #include <sbi/sbi_csr_detect.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
+#include <sbi/sbi_heap.h>
 #include <sbi/sbi_math.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_pmu.h>
@@ -29,7 +31,9 @@ extern void __sbi_expected_trap_hext(void);
 
 void (*sbi_hart_expected_trap)(void) = &__sbi_expected_trap;
 
-static unsigned long hart_features_offset;
+static SBI_SCRATCH_DEFINE(struct sbi_hart_features, hart_features);
+static bool hart_features_ready;
+unsigned long sbi_hart_hot_features_offset;
 
 static void mstatus_init(struct sbi_scratch *scratch)
 {
@@ -37,7 +41,8 @@ static void mstatus_init(struct sbi_scratch *scratch)
 	unsigned long mstatus_val = 0;
 	unsigned int mhpm_mask = sbi_hart_mhpm_mask(scratch);
 	uint64_t mhpmevent_init_val = 0;
-	uint64_t menvcfg_val, mstateen_val;
+	struct sbi_domain *dom = sbi_domain_thishart_ptr();
+	uint64_t menvcfg_val;
 
 	/* Enable FPU */
 	if (misa_extension('D') || misa_extension('F'))
@@ -86,29 +91,17 @@ static void mstatus_init(struct sbi_scratch *scratch)
 	}
 
 	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SMSTATEEN)) {
-		mstateen_val = csr_read(CSR_MSTATEEN0);
-#if __riscv_xlen == 32
-		mstateen_val |= ((uint64_t)csr_read(CSR_MSTATEEN0H)) << 32;
-#endif
-		mstateen_val |= SMSTATEEN_STATEN;
-		mstateen_val |= SMSTATEEN0_CONTEXT;
-		mstateen_val |= SMSTATEEN0_HSENVCFG;
-
-		if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SMAIA))
-			mstateen_val |= (SMSTATEEN0_AIA | SMSTATEEN0_IMSIC);
-		else
-			mstateen_val &= ~(SMSTATEEN0_AIA | SMSTATEEN0_IMSIC);
-
-		if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SMAIA) ||
-		    sbi_hart_has_extension(scratch, SBI_HART_EXT_SMCSRIND))
-			mstateen_val |= (SMSTATEEN0_SVSLCT);
-		else
-			mstateen_val &= ~(SMSTATEEN0_SVSLCT);
-
-		csr_write(CSR_MSTATEEN0, mstateen_val);
+		/* Domains are not yet assigned early in coldboot */
+		sbi_hart_mstateen_configure(scratch,
+					    dom ? dom->stateen0_deny : 0);
+
+		/* None of the mstateen1-3 bits are defined apart from SE */
+		for (cidx = 1; cidx < SMSTATEEN_MAX_COUNT; cidx++) {
+			csr_write_num(CSR_MSTATEEN0 + cidx, 0);
 #if __riscv_xlen == 32
-		csr_write(CSR_MSTATEEN0H, mstateen_val >> 32);
+			csr_write_num(CSR_MSTATEEN0H + cidx, 0);
 #endif
+		}
 	}
 
 	if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_12) {
@@ -243,10 +236,11 @@ void sbi_hart_delegation_dump(struct sbi_scratch *scratch,
 		   prefix, suffix, csr_read(CSR_MEDELEG));
 }
 
+#ifndef CONFIG_SBI_HART_FIXED_GEOMETRY
 unsigned int sbi_hart_mhpm_mask(struct sbi_scratch *scratch)
 {
 	struct sbi_hart_features *hfeatures =
-			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+			sbi_scratch_var_ptr(scratch, hart_features);
 
 	return hfeatures->mhpm_mask;
 }
@@ -254,7 +248,7 @@ unsigned int sbi_hart_mhpm_mask(struct sbi_scratch *scratch)
 unsigned int sbi_hart_pmp_count(struct sbi_scratch *scratch)
 {
 	struct sbi_hart_features *hfeatures =
-			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+			sbi_scratch_var_ptr(scratch, hart_features);
 
 	return hfeatures->pmp_count;
 }
@@ -262,7 +256,7 @@ unsigned int sbi_hart_pmp_count(struct sbi_scratch *scratch)
 unsigned int sbi_hart_pmp_log2gran(struct sbi_scratch *scratch)
 {
 	struct sbi_hart_features *hfeatures =
-			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+			sbi_scratch_var_ptr(scratch, hart_features);
 
 	return hfeatures->pmp_log2gran;
 }
@@ -270,7 +264,7 @@ unsigned int sbi_hart_pmp_log2gran(struct sbi_scratch *scratch)
 unsigned int sbi_hart_pmp_addrbits(struct sbi_scratch *scratch)
 {
 	struct sbi_hart_features *hfeatures =
-			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+			sbi_scratch_var_ptr(scratch, hart_features);
 
 	return hfeatures->pmp_addr_bits;
 }
@@ -278,10 +272,70 @@ unsigned int sbi_hart_pmp_addrbits(struct sbi_scratch *scratch)
 unsigned int sbi_hart_mhpm_bits(struct sbi_scratch *scratch)
 {
 	struct sbi_hart_features *hfeatures =
-			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+			sbi_scratch_var_ptr(scratch, hart_features);
 
 	return hfeatures->mhpm_bits;
 }
+#endif
+
+/*
+ * Programmable HPM counters which S-mode configures itself through the
+ * indirect CSR interface, these are not allocated by the SBI PMU.
+ */
+unsigned int sbi_hart_mhpm_deleg_mask(struct sbi_scratch *scratch)
+{
+#ifdef CONFIG_SBI_PMU_COUNTER_DELEG
+	if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_12 &&
+	    sbi_hart_has_extension(scratch, SBI_HART_EXT_SMCDELEG) &&
+	    sbi_hart_has_extension(scratch, SBI_HART_EXT_SSCCFG) &&
+	    sbi_hart_has_extension(scratch, SBI_HART_EXT_SSCSRIND))
+		return sbi_hart_mhpm_mask(scratch);
+#endif
+
+	return 0;
+}
+
+/**
+ * Value of mstateen0 giving S-mode direct access to the state of all
+ * the extensions present on the HART
+ *
+ * The value is built from scratch so that bits left set by a previous
+ * booting stage don't expose state OpenSBI doesn't switch.
+ */
+u64 sbi_hart_mstateen0(struct sbi_scratch *scratch)
+{
+	u64 val = SMSTATEEN_STATEN | SMSTATEEN0_CONTEXT | SMSTATEEN0_HSENVCFG;
+
+	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SMAIA))
+		val |= SMSTATEEN0_AIA | SMSTATEEN0_IMSIC;
+
+	/* Delegated counters are accessed through siselect/sireg */
+	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SMAIA) ||
+	    sbi_hart_has_extension(scratch, SBI_HART_EXT_SMCSRIND) ||
+	    sbi_hart_mhpm_deleg_mask(scratch))
+		val |= SMSTATEEN0_SVSLCT;
+
+	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_ZCMT))
+		val |= SMSTATEEN0_JVT;
+
+	return val;
+}
+
+/**
+ * Program mstateen0 for the domain running on the HART
+ *
+ * @param scratch pointer to the HART scratch space
+ * @param deny mstateen0 bits cleared for the domain
+ */
+void sbi_hart_mstateen_configure(struct sbi_scratch *scratch, u64 deny)
+{
+	u64 val = sbi_hart_mstateen0(scratch) & ~deny;
+
+	csr_write(CSR_MSTATEEN0, val);
+#if __riscv_xlen == 32
+	csr_write(CSR_MSTATEEN0H, val >> 32);
+#endif
+}
 
 /*
  * Returns Smepmp flags for a given domain and region based on permissions.
@@ -346,6 +400,37 @@ static unsigned int sbi_hart_get_smepmp_flags(struct sbi_scratch *scratch,
 	return pmp_flags;
 }
 
+/** PMP programming of a domain cached for one PMP geometry */
+struct sbi_hart_pmp_cache {
+	unsigned int pmp_count;
+	unsigned int pmp_log2gran;
+	unsigned int pmp_addr_bits;
+	bool smepmp;
+	/** PMP entries programmed from the domain memregions */
+	u64 set_mask;
+	/** Smepmp entries programmed after MSECCFG.MML is set */
+	u64 mml_mask;
+	/** Values of the programmed PMP CSRs */
+	struct sbi_hart_pmp_image img;
+};
+
+static spinlock_t pmp_cache_lock = SPIN_LOCK_INITIALIZER;
+
+static void hart_pmp_cache_mark(struct sbi_hart_pmp_cache *pc,
+				unsigned int pmp_idx, unsigned int count,
+				bool mml)
+{
+	u64 mask;
+
+	if (!pc || !count)
+		return;
+
+	mask = ((1ULL << count) - 1) << pmp_idx;
+	pc->set_mask |= mask;
+	if (mml)
+		pc->mml_mask |= mask;
+}
+
 static int sbi_hart_smepmp_set(struct sbi_scratch *scratch,
 				struct sbi_domain *dom,
 				struct sbi_domain_memregion *reg,
@@ -376,11 +461,12 @@ static int sbi_hart_smepmp_set(struct sbi_scratch *scratch,
 static int sbi_hart_smepmp_configure(struct sbi_scratch *scratch,
 				     unsigned int pmp_count,
 				     unsigned int pmp_log2gran,
-				     unsigned long pmp_addr_max)
+				     unsigned long pmp_addr_max,
+				     struct sbi_hart_pmp_cache *pc)
 {
 	struct sbi_domain_memregion *reg;
 	struct sbi_domain *dom = sbi_domain_thishart_ptr();
-	unsigned int pmp_idx, pmp_flags;
+	unsigned int pmp_idx, pmp_flags, n;
 
 	/*
 	 * Set the RLB so that, we can write to PMP entries without
@@ -410,8 +496,10 @@ static int sbi_hart_smepmp_configure(struct sbi_scratch *scratch,
 		if (!pmp_flags)
 			return 0;
 
-		pmp_idx += sbi_hart_smepmp_set(scratch, dom, reg, pmp_idx, pmp_flags,
-				    pmp_log2gran, pmp_addr_max);
+		n = sbi_hart_smepmp_set(scratch, dom, reg, pmp_idx, pmp_flags,
+					pmp_log2gran, pmp_addr_max);
+		hart_pmp_cache_mark(pc, pmp_idx, n, false);
+		pmp_idx += n;
 	}
 
 	/* Set the MML to enforce new encoding */
@@ -436,8 +524,10 @@ static int sbi_hart_smepmp_configure(struct sbi_scratch *scratch,
 		if (!pmp_flags)
 			return 0;
 
-		pmp_idx += sbi_hart_smepmp_set(scratch, dom, reg, pmp_idx, pmp_flags,
-				    pmp_log2gran, pmp_addr_max);
+		n = sbi_hart_smepmp_set(scratch, dom, reg, pmp_idx, pmp_flags,
+					pmp_log2gran, pmp_addr_max);
+		hart_pmp_cache_mark(pc, pmp_idx, n, true);
+		pmp_idx += n;
 	}
 
 	/*
@@ -451,7 +541,8 @@ static int sbi_hart_smepmp_configure(struct sbi_scratch *scratch,
 static int sbi_hart_oldpmp_configure(struct sbi_scratch *scratch,
 				     unsigned int pmp_count,
 				     unsigned int pmp_log2gran,
-				     unsigned long pmp_addr_max)
+				     unsigned long pmp_addr_max,
+				     struct sbi_hart_pmp_cache *pc)
 {
 	struct sbi_domain_memregion *reg;
 	struct sbi_domain *dom = sbi_domain_thishart_ptr();
@@ -483,9 +574,13 @@ static int sbi_hart_oldpmp_configure(struct sbi_scratch *scratch,
 		if (pmp_log2gran <= reg->order && pmp_addr < pmp_addr_max) {
 			if (reg->tor) {
 				pmp_set_tor(pmp_idx, pmp_flags, reg->base, reg->tor);
+				hart_pmp_cache_mark(pc, pmp_idx, 2, false);
 				pmp_idx += 2;
-			} else
-				pmp_set(pmp_idx++, pmp_flags, reg->base, reg->order);
+			} else {
+				pmp_set(pmp_idx, pmp_flags, reg->base, reg->order);
+				hart_pmp_cache_mark(pc, pmp_idx, 1, false);
+				pmp_idx++;
+			}
 		} else {
 			sbi_printf("Can not configure pmp for domain %s because"
 				   " memory region address 0x%lx or size 0x%lx "
@@ -540,27 +635,114 @@ int sbi_hart_unmap_saddr(void)
 	return pmp_disable(SBI_SMEPMP_RESV_ENTRY);
 }
 
-int sbi_hart_pmp_configure(struct sbi_scratch *scratch)
+/* Index of the pmpcfg CSR holding the PMP entry relative to PMPCFG0 */
+#define pmp_cfg_csr_index(__n)	((__n) / SBI_HART_PMP_CFG_PER_CSR)
+#define pmp_cfg_csr_num(__i)	(CSR_PMPCFG0 + (__i) * (__riscv_xlen / 32))
+#define pmp_cfg_shift(__n)	(((__n) % SBI_HART_PMP_CFG_PER_CSR) << 3)
+
+static struct sbi_hart_pmp_cache *hart_pmp_cache_alloc(
+						struct sbi_scratch *scratch)
 {
-	int rc;
-	unsigned int pmp_bits, pmp_log2gran;
-	unsigned int pmp_count = sbi_hart_pmp_count(scratch);
-	unsigned long pmp_addr_max;
+	struct sbi_hart_pmp_cache *pc = sbi_zalloc(sizeof(*pc));
 
-	if (!pmp_count)
-		return 0;
+	if (!pc)
+		return NULL;
 
-	pmp_log2gran = sbi_hart_pmp_log2gran(scratch);
-	pmp_bits = sbi_hart_pmp_addrbits(scratch) - 1;
-	pmp_addr_max = (1UL << pmp_bits) | ((1UL << pmp_bits) - 1);
+	pc->pmp_count = sbi_hart_pmp_count(scratch);
+	pc->pmp_log2gran = sbi_hart_pmp_log2gran(scratch);
+	pc->pmp_addr_bits = sbi_hart_pmp_addrbits(scratch);
+	pc->smepmp = sbi_hart_has_extension(scratch, SBI_HART_EXT_SMEPMP);
 
-	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SMEPMP))
-		rc = sbi_hart_smepmp_configure(scratch, pmp_count,
-						pmp_log2gran, pmp_addr_max);
-	else
-		rc = sbi_hart_oldpmp_configure(scratch, pmp_count,
-						pmp_log2gran, pmp_addr_max);
+	return pc;
+}
+
+static struct sbi_hart_pmp_cache *hart_pmp_cache_find(
+						struct sbi_scratch *scratch,
+						struct sbi_domain *dom)
+{
+	struct sbi_hart_pmp_cache *pc;
+
+	if (!dom)
+		return NULL;
+
+	pc = __smp_load_acquire(&dom->pmp_cache);
+	if (!pc ||
+	    pc->pmp_count != sbi_hart_pmp_count(scratch) ||
+	    pc->pmp_log2gran != sbi_hart_pmp_log2gran(scratch) ||
+	    pc->pmp_addr_bits != sbi_hart_pmp_addrbits(scratch) ||
+	    pc->smepmp != sbi_hart_has_extension(scratch, SBI_HART_EXT_SMEPMP))
+		return NULL;
+
+	return pc;
+}
+
+static void hart_pmp_cache_publish(struct sbi_domain *dom,
+				   struct sbi_hart_pmp_cache *pc)
+{
+	unsigned int i;
+
+	/* Record the CSR values written by the configure functions */
+	for (i = 0; i < pc->pmp_count; i++) {
+		if (!(pc->set_mask & (1ULL << i)))
+			continue;
+		pc->img.cfg[pmp_cfg_csr_index(i)] =
+				csr_read_num(pmp_cfg_csr_num(pmp_cfg_csr_index(i)));
+		pc->img.addr[i] = csr_read_num(CSR_PMPADDR0 + i);
+	}
+	pc->img.valid = true;
+
+	/* Another HART may have published first */
+	spin_lock(&pmp_cache_lock);
+	if (!dom->pmp_cache) {
+		__smp_store_release(&dom->pmp_cache, pc);
+		pc = NULL;
+	}
+	spin_unlock(&pmp_cache_lock);
 
+	if (pc)
+		sbi_free(pc);
+}
+
+static void hart_pmp_cache_write(const struct sbi_hart_pmp_cache *pc,
+				 u64 mask)
+{
+	unsigned long cfgmask[PMP_COUNT / SBI_HART_PMP_CFG_PER_CSR] = { 0 };
+	unsigned int i, ci, last = 0;
+
+	for (i = 0; i < pc->pmp_count; i++) {
+		if (!(mask & (1ULL << i)))
+			continue;
+		csr_write_num(CSR_PMPADDR0 + i, pc->img.addr[i]);
+		cfgmask[pmp_cfg_csr_index(i)] |= (0xffUL << pmp_cfg_shift(i));
+		last = pmp_cfg_csr_index(i);
+	}
+
+	for (ci = 0; ci <= last; ci++) {
+		if (!cfgmask[ci])
+			continue;
+		csr_write_num(pmp_cfg_csr_num(ci),
+			      (csr_read_num(pmp_cfg_csr_num(ci)) & ~cfgmask[ci]) |
+			      (pc->img.cfg[ci] & cfgmask[ci]));
+	}
+}
+
+static void hart_pmp_cache_restore(const struct sbi_hart_pmp_cache *pc)
+{
+	if (!pc->smepmp) {
+		hart_pmp_cache_write(pc, pc->set_mask);
+		return;
+	}
+
+	/* Same sequence as sbi_hart_smepmp_configure() */
+	csr_set(CSR_MSECCFG, MSECCFG_RLB);
+	pmp_disable(SBI_SMEPMP_RESV_ENTRY);
+	hart_pmp_cache_write(pc, pc->set_mask & ~pc->mml_mask);
+	csr_set(CSR_MSECCFG, MSECCFG_MML);
+	hart_pmp_cache_write(pc, pc->mml_mask);
+}
+
+static void sbi_hart_pmp_fence(void)
+{
 	/*
 	 * As per section 3.7.2 of privileged specification v1.12,
 	 * virtual address translations can be speculatively performed
@@ -581,14 +763,138 @@ int sbi_hart_pmp_configure(struct sbi_scratch *scratch)
 		if (misa_extension('H'))
 			__sbi_hfence_gvma_all();
 	}
+}
+
+int sbi_hart_pmp_configure(struct sbi_scratch *scratch)
+{
+	int rc;
+	unsigned int pmp_bits, pmp_log2gran;
+	unsigned int pmp_count = sbi_hart_pmp_count(scratch);
+	unsigned long pmp_addr_max;
+	struct sbi_domain *dom = sbi_domain_thishart_ptr();
+	struct sbi_hart_pmp_cache *pc;
+
+	if (!pmp_count)
+		return 0;
+
+	/* Restore PMP programming computed earlier for this domain */
+	pc = hart_pmp_cache_find(scratch, dom);
+	if (pc) {
+		hart_pmp_cache_restore(pc);
+		sbi_hart_pmp_fence();
+		return 0;
+	}
+
+	pmp_log2gran = sbi_hart_pmp_log2gran(scratch);
+	pmp_bits = sbi_hart_pmp_addrbits(scratch) - 1;
+	pmp_addr_max = (1UL << pmp_bits) | ((1UL << pmp_bits) - 1);
+
+	pc = (dom && !__smp_load_acquire(&dom->pmp_cache)) ?
+	     hart_pmp_cache_alloc(scratch) : NULL;
+
+	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SMEPMP))
+		rc = sbi_hart_smepmp_configure(scratch, pmp_count,
+						pmp_log2gran, pmp_addr_max, pc);
+	else
+		rc = sbi_hart_oldpmp_configure(scratch, pmp_count,
+						pmp_log2gran, pmp_addr_max, pc);
+
+	if (pc)
+		hart_pmp_cache_publish(dom, pc);
+
+	sbi_hart_pmp_fence();
 
 	return rc;
 }
 
+void sbi_hart_pmp_cache_invalidate(struct sbi_domain *dom)
+{
+	struct sbi_hart_pmp_cache *pc;
+
+	spin_lock(&pmp_cache_lock);
+	pc = dom->pmp_cache;
+	__smp_store_release(&dom->pmp_cache, NULL);
+	spin_unlock(&pmp_cache_lock);
+
+	if (pc)
+		sbi_free(pc);
+}
+
+void sbi_hart_pmp_save(struct sbi_scratch *scratch,
+		       struct sbi_hart_pmp_image *img)
+{
+	unsigned int i, pmp_count = sbi_hart_pmp_count(scratch);
+
+	sbi_memset(img, 0, sizeof(*img));
+	for (i = 0; i < pmp_count; i++) {
+		if (!pmp_cfg_shift(i))
+			img->cfg[pmp_cfg_csr_index(i)] =
+				csr_read_num(pmp_cfg_csr_num(pmp_cfg_csr_index(i)));
+		img->addr[i] = csr_read_num(CSR_PMPADDR0 + i);
+	}
+	img->valid = true;
+}
+
+unsigned int sbi_hart_pmp_switch(struct sbi_scratch *scratch,
+				 const struct sbi_hart_pmp_image *cur,
+				 const struct sbi_hart_pmp_image *next)
+{
+	unsigned long dirty[PMP_COUNT / SBI_HART_PMP_CFG_PER_CSR] = { 0 };
+	unsigned int i, ci, pmp_count = sbi_hart_pmp_count(scratch);
+	unsigned long mask, next_cfg;
+	unsigned int writes = 0;
+
+	if (!pmp_count)
+		return 0;
+
+	/*
+	 * An entry must be rewritten when its configuration or address
+	 * changes or, for TOR entries, when the address of the previous
+	 * entry which holds the bottom of the range changes.
+	 */
+	for (i = 0; i < pmp_count; i++) {
+		ci = pmp_cfg_csr_index(i);
+		mask = 0xffUL << pmp_cfg_shift(i);
+		next_cfg = next->cfg[ci] >> pmp_cfg_shift(i);
+		if (((cur->cfg[ci] ^ next->cfg[ci]) & mask) ||
+		    cur->addr[i] != next->addr[i] ||
+		    (i && (next_cfg & PMP_A) == PMP_A_TOR &&
+		     cur->addr[i - 1] != next->addr[i - 1]))
+			dirty[ci] |= mask;
+	}
+
+	/* Disable changed entries before touching their addresses */
+	for (ci = 0; ci <= pmp_cfg_csr_index(pmp_count - 1); ci++) {
+		if (!dirty[ci])
+			continue;
+		csr_write_num(pmp_cfg_csr_num(ci), cur->cfg[ci] & ~dirty[ci]);
+		writes++;
+	}
+
+	for (i = 0; i < pmp_count; i++) {
+		if (cur->addr[i] == next->addr[i])
+			continue;
+		csr_write_num(CSR_PMPADDR0 + i, next->addr[i]);
+		writes++;
+	}
+
+	for (ci = 0; ci <= pmp_cfg_csr_index(pmp_count - 1); ci++) {
+		if (!dirty[ci])
+			continue;
+		csr_write_num(pmp_cfg_csr_num(ci), next->cfg[ci]);
+		writes++;
+	}
+
+	if (writes)
+		sbi_hart_pmp_fence();
+
+	return writes;
+}
+
 int sbi_hart_priv_version(struct sbi_scratch *scratch)
 {
 	struct sbi_hart_features *hfeatures =
-			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+			sbi_scratch_var_ptr(scratch, hart_features);
 
 	return hfeatures->priv_version;
 }
@@ -598,7 +904,7 @@ void sbi_hart_get_priv_version_str(struct sbi_scratch *scratch,
 {
 	char *temp;
 	struct sbi_hart_features *hfeatures =
-			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+			sbi_scratch_var_ptr(scratch, hart_features);
 
 	switch (hfeatures->priv_version) {
 	case SBI_HART_PRIV_VER_1_10:
@@ -629,6 +935,35 @@ static inline void __sbi_hart_update_extension(
 		__clear_bit(ext, hfeatures->extensions);
 }
 
+static void hart_update_hot_features(struct sbi_scratch *scratch)
+{
+	unsigned long hot = 0;
+
+	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SMAIA))
+		hot |= SBI_HART_HOT_SMAIA;
+	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SSTC))
+		hot |= SBI_HART_HOT_SSTC;
+	if (misa_extension('H'))
+		hot |= SBI_HART_HOT_H;
+	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SVINVAL))
+		hot |= SBI_HART_HOT_SVINVAL;
+	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SMSTATEEN))
+		hot |= SBI_HART_HOT_SMSTATEEN;
+	if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_10)
+		hot |= SBI_HART_HOT_PRIV_1_10;
+	if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_12)
+		hot |= SBI_HART_HOT_PRIV_1_12;
+
+	sbi_scratch_write_type(scratch, unsigned long,
+			       sbi_hart_hot_features_offset, hot);
+
+	/*
+	 * This runs before the PMP of the HART is configured so the
+	 * patch sites are still writable with Smepmp.
+	 */
+	sbi_alternative_check(hot);
+}
+
 /**
  * Enable/Disable a particular hart extension
  *
@@ -641,9 +976,10 @@ void sbi_hart_update_extension(struct sbi_scratch *scratch,
 			       bool enable)
 {
 	struct sbi_hart_features *hfeatures =
-			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+			sbi_scratch_var_ptr(scratch, hart_features);
 
 	__sbi_hart_update_extension(hfeatures, ext, enable);
+	hart_update_hot_features(scratch);
 }
 
 /**
@@ -657,7 +993,11 @@ bool sbi_hart_has_extension(struct sbi_scratch *scratch,
 			    enum sbi_hart_extensions ext)
 {
 	struct sbi_hart_features *hfeatures =
-			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+			sbi_scratch_var_ptr(scratch, hart_features);
+
+	/* HART features are not yet initialized early in coldboot */
+	if (!hart_features_ready)
+		return false;
 
 	if (__test_bit(ext, hfeatures->extensions))
 		return true;
@@ -691,6 +1031,10 @@ const struct sbi_hart_ext_data sbi_hart_ext[] = {
 	__SBI_HART_EXT_DATA(ssccfg, SBI_HART_EXT_SSCCFG),
 	__SBI_HART_EXT_DATA(svade, SBI_HART_EXT_SVADE),
 	__SBI_HART_EXT_DATA(svadu, SBI_HART_EXT_SVADU),
+	__SBI_HART_EXT_DATA(zawrs, SBI_HART_EXT_ZAWRS),
+	__SBI_HART_EXT_DATA(zihintpause, SBI_HART_EXT_ZIHINTPAUSE),
+	__SBI_HART_EXT_DATA(svinval, SBI_HART_EXT_SVINVAL),
+	__SBI_HART_EXT_DATA(zcmt, SBI_HART_EXT_ZCMT),
 };
 
 _Static_assert(SBI_HART_EXT_MAX == array_size(sbi_hart_ext),
@@ -709,7 +1053,7 @@ void sbi_hart_get_extensions_str(struct sbi_scratch *scratch,
 				 char *extensions_str, int nestr)
 {
 	struct sbi_hart_features *hfeatures =
-			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+			sbi_scratch_var_ptr(scratch, hart_features);
 	int offset = 0, ext = 0;
 
 	if (!extensions_str || nestr <= 0)
@@ -779,12 +1123,53 @@ static int hart_mhpm_get_allowed_bits(void)
 	return num_bits;
 }
 
+#ifdef CONFIG_SBI_HART_IDENTICAL_FEATURES
+/*
+ * Reuse the features detected by another HART with the same vendor,
+ * architecture and implementation IDs.
+ */
+static bool hart_copy_features(struct sbi_scratch *scratch,
+			       struct sbi_hart_features *hfeatures)
+{
+	struct sbi_hart_features *src;
+	struct sbi_scratch *rscratch;
+	u32 i;
+
+	for (i = 0; i <= sbi_scratch_last_hartindex(); i++) {
+		rscratch = sbi_hartindex_to_scratch(i);
+		if (!rscratch || rscratch == scratch)
+			continue;
+
+		src = sbi_scratch_var_ptr(rscratch, hart_features);
+		if (!__smp_load_acquire(&src->detected) ||
+		    src->mvendorid != hfeatures->mvendorid ||
+		    src->marchid != hfeatures->marchid ||
+		    src->mimpid != hfeatures->mimpid)
+			continue;
+
+		sbi_memcpy(hfeatures, src, sizeof(*hfeatures));
+		return true;
+	}
+
+	return false;
+}
+#else
+static inline bool hart_copy_features(struct sbi_scratch *scratch,
+				      struct sbi_hart_features *hfeatures)
+{
+	return false;
+}
+#endif
+
 static int hart_detect_features(struct sbi_scratch *scratch)
 {
 	struct sbi_trap_info trap = {0};
 	struct sbi_hart_features *hfeatures =
-		sbi_scratch_offset_ptr(scratch, hart_features_offset);
-	unsigned long val, oldval;
+		sbi_scratch_var_ptr(scratch, hart_features);
+	unsigned long val;
+#ifndef CONFIG_SBI_HART_FIXED_GEOMETRY
+	unsigned long oldval;
+#endif
 	bool has_zicntr = false;
 	int rc;
 
@@ -792,6 +1177,13 @@ static int hart_detect_features(struct sbi_scratch *scratch)
 	if (hfeatures->detected)
 		return 0;
 
+	hfeatures->mvendorid = csr_read(CSR_MVENDORID);
+	hfeatures->marchid = csr_read(CSR_MARCHID);
+	hfeatures->mimpid = csr_read(CSR_MIMPID);
+
+	if (hart_copy_features(scratch, hfeatures))
+		goto detected;
+
 	/* Clear hart features */
 	sbi_memset(hfeatures->extensions, 0, sizeof(hfeatures->extensions));
 	hfeatures->pmp_count = 0;
@@ -858,6 +1250,13 @@ static int hart_detect_features(struct sbi_scratch *scratch)
 	__check_csr_32(__csr + 0, __rdonly, __wrval, __field, __skip)	\
 	__check_csr_32(__csr + 32, __rdonly, __wrval, __field, __skip)
 
+#ifdef CONFIG_SBI_HART_FIXED_GEOMETRY
+	hfeatures->pmp_count = CONFIG_SBI_HART_PMP_COUNT;
+	hfeatures->pmp_log2gran = CONFIG_SBI_HART_PMP_LOG2GRAN;
+	hfeatures->pmp_addr_bits = CONFIG_SBI_HART_PMP_ADDR_BITS;
+	hfeatures->mhpm_mask = CONFIG_SBI_HART_MHPM_MASK;
+	hfeatures->mhpm_bits = CONFIG_SBI_HART_MHPM_BITS;
+#else
 	/**
 	 * Detect the allowed address bits & granularity. At least PMPADDR0
 	 * should be implemented.
@@ -876,6 +1275,7 @@ __pmp_skip:
 	__check_hpm_csr_4(CSR_MHPMCOUNTER4, mhpm_mask);
 	__check_hpm_csr_8(CSR_MHPMCOUNTER8, mhpm_mask);
 	__check_hpm_csr_16(CSR_MHPMCOUNTER16, mhpm_mask);
+#endif
 
 	/**
 	 * No need to check for MHPMCOUNTERH for RV32 as they are expected to be
@@ -932,6 +1332,9 @@ __pmp_skip:
 	/* Detect if hart supports mstateen CSRs */
 	__check_ext_csr(SBI_HART_PRIV_VER_1_12,
 			CSR_MSTATEEN0, SBI_HART_EXT_SMSTATEEN);
+	/* Detect if hart supports the table jump CSR */
+	__check_ext_csr(SBI_HART_PRIV_VER_UNKNOWN,
+			CSR_JVT, SBI_HART_EXT_ZCMT);
 	/* Detect if hart supports smcntrpmf */
 	__check_ext_csr(SBI_HART_PRIV_VER_1_12,
 			CSR_MCYCLECFG, SBI_HART_EXT_SMCNTRPMF);
@@ -960,7 +1363,10 @@ __pmp_skip:
 					SBI_HART_EXT_ZIHPM, true);
 
 	/* Mark hart feature detection done */
-	hfeatures->detected = true;
+	__smp_store_release(&hfeatures->detected, true);
+
+detected:
+	hart_update_hot_features(scratch);
 
 	/*
 	 * On platforms with Smepmp, the previous booting stage must
@@ -1006,9 +1412,11 @@ int sbi_hart_init(struct sbi_scratch *scratch, bool cold_boot)
 		if (misa_extension('H'))
 			sbi_hart_expected_trap = &__sbi_expected_trap_hext;
 
-		hart_features_offset = sbi_scratch_alloc_offset(
-					sizeof(struct sbi_hart_features));
-		if (!hart_features_offset)
+		hart_features_ready = true;
+
+		sbi_hart_hot_features_offset =
+			sbi_scratch_alloc_type_offset(unsigned long);
+		if (!sbi_hart_hot_features_offset)
 			return SBI_ENOMEM;
 	}
 
@@ -1016,11 +1424,22 @@ int sbi_hart_init(struct sbi_scratch *scratch, bool cold_boot)
 	if (rc)
 		return rc;
 
+	/*
+	 * Assume that the other HARTs have the same features as the
+	 * coldboot HART, the ones which don't revert the patch sites
+	 * when they detect their own features.
+	 */
+	if (cold_boot)
+		sbi_alternative_apply(sbi_scratch_read_type(scratch,
+					unsigned long, sbi_hart_hot_features_offset));
+
 	return sbi_hart_reinit(scratch);
 }
 
 void __attribute__((noreturn)) sbi_hart_hang(void)
 {
+	sbi_console_flush();
+
 	while (1)
 		wfi();
 	__builtin_unreachable();
@@ -1037,6 +1456,8 @@ sbi_hart_switch_mode(unsigned long arg0, unsigned long arg1,
 	unsigned long val;
 #endif
 
+	sbi_console_flush();
+
 	switch (next_mode) {
 	case PRV_M:
 		break;
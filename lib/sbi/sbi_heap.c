@@ -7,9 +7,13 @@
  *   Anup Patel<apatel@ventanamicro.com>
  */
 
+#include <sbi/riscv_asm.h>
 #include <sbi/riscv_locks.h>
+#include <sbi/sbi_bitops.h>
+#include <sbi/sbi_console.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_heap.h>
+#include <sbi/sbi_lockstat.h>
 #include <sbi/sbi_list.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_string.h>
@@ -18,10 +22,19 @@
 #define HEAP_ALLOC_ALIGN		64
 #define HEAP_HOUSEKEEPING_FACTOR	16
 
+/*
+ * Every block is hashed by its start address and free blocks are also
+ * hashed by their end address. A free finds its block and both of its
+ * neighbours with three hash lookups instead of walking the lists.
+ */
 struct heap_node {
 	struct sbi_dlist head;
+	/* Next node in the same bucket of the start and end hashes */
+	struct heap_node *start_next;
+	struct heap_node *end_next;
 	unsigned long addr;
 	unsigned long size;
+	bool free;
 };
 
 struct heap_control {
@@ -32,137 +45,840 @@ struct heap_control {
 	unsigned long hksize;
 	struct sbi_dlist free_node_list;
 	struct sbi_dlist free_space_list;
-	struct sbi_dlist used_space_list;
+	struct heap_node **start_hash;
+	struct heap_node **end_hash;
+	unsigned long hash_bits;
 };
 
 static struct heap_control hpctrl;
+SBI_LOCKSTAT_DEFINE(heap_lock, &hpctrl.lock);
 
-void *sbi_malloc(size_t size)
-{
-	void *ret = NULL;
-	struct heap_node *n, *np;
+/* Largest cache block size of the HARTs, kept in .data for early setters */
+#ifdef CONFIG_SBI_CACHE_BLOCK_SIZE
+static unsigned long heap_cacheline_size =
+	(CONFIG_SBI_CACHE_BLOCK_SIZE > HEAP_ALLOC_ALIGN) ?
+	CONFIG_SBI_CACHE_BLOCK_SIZE : HEAP_ALLOC_ALIGN;
+#else
+static unsigned long heap_cacheline_size = HEAP_ALLOC_ALIGN;
+#endif
+
+#ifdef CONFIG_SBI_HEAP_SLAB
+
+/*
+ * Small allocations are served from a dedicated slab area at the end of
+ * the heap. The slab area is split into one equally sized segment per
+ * size class so the size class of a slab object is found using only
+ * its address. Each HART caches a few free objects of every size class
+ * in a magazine which is accessed without taking any lock.
+ */
+#define HEAP_SLAB_CLASSES		4
+#define HEAP_SLAB_MIN_SHIFT		6
+#define HEAP_SLAB_MAX_SIZE		(1UL << (HEAP_SLAB_MIN_SHIFT + \
+						 HEAP_SLAB_CLASSES - 1))
+#define HEAP_SLAB_FACTOR		8
+#define HEAP_SLAB_MAG_SIZE		4
+
+struct heap_slab {
+	spinlock_t lock;
+	unsigned long obj_size;
+	unsigned long base;
+	unsigned long end;
+	unsigned long next;
+	unsigned long free_count;
+	void *free_list;
+};
+
+struct heap_magazine {
+	unsigned long count[HEAP_SLAB_CLASSES];
+	void *objs[HEAP_SLAB_CLASSES][HEAP_SLAB_MAG_SIZE];
+};
 
-	if (!size)
+static struct heap_slab heap_slabs[HEAP_SLAB_CLASSES];
+SBI_LOCKSTAT_DEFINE(heap_slab_lock, NULL);
+static unsigned long heap_slab_base;
+static unsigned long heap_slab_seg_size;
+static unsigned long heap_mag_off;
+
+static inline struct heap_magazine *heap_magazine_thishart(void)
+{
+	if (!heap_mag_off)
 		return NULL;
+	return sbi_scratch_offset_ptr(sbi_scratch_thishart_ptr(),
+				      heap_mag_off);
+}
+
+/* Must be called with slab lock held */
+static void *heap_slab_get(struct heap_slab *slab)
+{
+	void *obj = slab->free_list;
+
+	if (obj) {
+		slab->free_list = *(void **)obj;
+		slab->free_count--;
+	} else if (slab->next + slab->obj_size <= slab->end) {
+		obj = (void *)slab->next;
+		slab->next += slab->obj_size;
+	}
 
-	size += HEAP_ALLOC_ALIGN - 1;
-	size &= ~((unsigned long)HEAP_ALLOC_ALIGN - 1);
+	return obj;
+}
 
-	spin_lock(&hpctrl.lock);
+/* Must be called with slab lock held */
+static void heap_slab_put(struct heap_slab *slab, void *obj)
+{
+	*(void **)obj = slab->free_list;
+	slab->free_list = obj;
+	slab->free_count++;
+}
 
-	np = NULL;
-	sbi_list_for_each_entry(n, &hpctrl.free_space_list, head) {
-		if (size <= n->size) {
-			np = n;
+static void *heap_slab_alloc(unsigned long size)
+{
+	struct heap_magazine *mag = heap_magazine_thishart();
+	struct heap_slab *slab;
+	void *obj, *extra;
+	int idx;
+
+	idx = (size <= (1UL << HEAP_SLAB_MIN_SHIFT)) ? 0 :
+	      sbi_fls(size - 1) + 1 - HEAP_SLAB_MIN_SHIFT;
+	slab = &heap_slabs[idx];
+
+	if (mag && mag->count[idx])
+		return mag->objs[idx][--mag->count[idx]];
+
+	spin_lock(&slab->lock);
+	obj = heap_slab_get(slab);
+	/* Refill half of the magazine while holding the lock */
+	while (obj && mag && mag->count[idx] < HEAP_SLAB_MAG_SIZE / 2) {
+		extra = heap_slab_get(slab);
+		if (!extra)
 			break;
-		}
+		mag->objs[idx][mag->count[idx]++] = extra;
 	}
-	if (np) {
-		if ((size < np->size) &&
-		    !sbi_list_empty(&hpctrl.free_node_list)) {
-			n = sbi_list_first_entry(&hpctrl.free_node_list,
-						 struct heap_node, head);
-			sbi_list_del(&n->head);
-			n->addr = np->addr + np->size - size;
-			n->size = size;
-			np->size -= size;
-			sbi_list_add_tail(&n->head, &hpctrl.used_space_list);
-			ret = (void *)n->addr;
-		} else if (size == np->size) {
-			sbi_list_del(&np->head);
-			sbi_list_add_tail(&np->head, &hpctrl.used_space_list);
-			ret = (void *)np->addr;
-		}
+	spin_unlock(&slab->lock);
+
+	return obj;
+}
+
+static unsigned long heap_slab_free(void *ptr)
+{
+	struct heap_magazine *mag = heap_magazine_thishart();
+	unsigned long idx;
+	struct heap_slab *slab;
+
+	idx = ((unsigned long)ptr - heap_slab_base) / heap_slab_seg_size;
+	slab = &heap_slabs[idx];
+	ptr = (void *)((unsigned long)ptr & ~(slab->obj_size - 1));
+
+	if (mag && mag->count[idx] < HEAP_SLAB_MAG_SIZE) {
+		mag->objs[idx][mag->count[idx]++] = ptr;
+		return slab->obj_size;
 	}
 
-	spin_unlock(&hpctrl.lock);
+	/* Magazine is full so return half of it with this object */
+	spin_lock(&slab->lock);
+	heap_slab_put(slab, ptr);
+	while (mag && mag->count[idx] > HEAP_SLAB_MAG_SIZE / 2)
+		heap_slab_put(slab, mag->objs[idx][--mag->count[idx]]);
+	spin_unlock(&slab->lock);
 
-	return ret;
+	return slab->obj_size;
 }
 
-void *sbi_zalloc(size_t size)
+static inline bool heap_slab_contains(void *ptr)
 {
-	void *ret = sbi_malloc(size);
+	return heap_slab_seg_size &&
+	       (heap_slab_base <= (unsigned long)ptr) &&
+	       ((unsigned long)ptr < (heap_slab_base +
+			(heap_slab_seg_size * HEAP_SLAB_CLASSES)));
+}
+
+static unsigned long heap_slab_free_space(void)
+{
+	struct heap_magazine *mag;
+	struct sbi_scratch *scratch;
+	struct heap_slab *slab;
+	unsigned long i, j, ret = 0;
+
+	for (i = 0; i < HEAP_SLAB_CLASSES; i++) {
+		slab = &heap_slabs[i];
+		spin_lock(&slab->lock);
+		ret += slab->end - slab->next;
+		ret += slab->free_count * slab->obj_size;
+		spin_unlock(&slab->lock);
+	}
+
+	if (!heap_mag_off)
+		return ret;
+
+	for (j = 0; j <= sbi_scratch_last_hartindex(); j++) {
+		scratch = sbi_hartindex_to_scratch(j);
+		if (!scratch)
+			continue;
+		mag = sbi_scratch_offset_ptr(scratch, heap_mag_off);
+		for (i = 0; i < HEAP_SLAB_CLASSES; i++)
+			ret += mag->count[i] * heap_slabs[i].obj_size;
+	}
 
-	if (ret)
-		sbi_memset(ret, 0, size);
 	return ret;
 }
 
-void sbi_free(void *ptr)
+static unsigned long heap_slab_init(void)
 {
-	struct heap_node *n, *np;
+	struct heap_slab *slab;
+	unsigned long i, size;
+
+	size = hpctrl.size / HEAP_SLAB_FACTOR;
+	heap_slab_seg_size = (size / HEAP_SLAB_CLASSES) &
+			     ~(HEAP_SLAB_MAX_SIZE - 1);
+	if (!heap_slab_seg_size)
+		return 0;
+
+	size = heap_slab_seg_size * HEAP_SLAB_CLASSES;
+	heap_slab_base = hpctrl.base + hpctrl.size - size;
+	for (i = 0; i < HEAP_SLAB_CLASSES; i++) {
+		slab = &heap_slabs[i];
+		SPIN_LOCK_INIT(slab->lock);
+		sbi_lockstat_track(heap_slab_lock, &slab->lock);
+		slab->obj_size = 1UL << (HEAP_SLAB_MIN_SHIFT + i);
+		slab->base = heap_slab_base + heap_slab_seg_size * i;
+		slab->end = slab->base + heap_slab_seg_size;
+		slab->next = slab->base;
+		slab->free_count = 0;
+		slab->free_list = NULL;
+	}
 
-	if (!ptr)
-		return;
+	/* Without magazines all slab allocations take the class lock */
+	heap_mag_off = sbi_scratch_alloc_type_offset(struct heap_magazine);
 
-	spin_lock(&hpctrl.lock);
+	return size;
+}
+
+#else
+
+static inline void *heap_slab_alloc(unsigned long size) { return NULL; }
+
+static inline unsigned long heap_slab_free(void *ptr) { return 0; }
+
+static inline bool heap_slab_contains(void *ptr) { return false; }
+
+static inline unsigned long heap_slab_free_space(void) { return 0; }
+
+static inline unsigned long heap_slab_init(void) { return 0; }
+
+#endif
+
+#ifdef CONFIG_SBI_HEAP_STATS
+
+static spinlock_t heap_stats_lock = SPIN_LOCK_INITIALIZER;
+static struct sbi_heap_stats heap_stats;
+
+static void heap_stats_alloc(unsigned long size, unsigned long caller,
+			     void *ptr)
+{
+	struct sbi_heap_caller_stats *c;
+	unsigned long i;
+
+	spin_lock(&heap_stats_lock);
+
+	if (!ptr) {
+		heap_stats.alloc_failed++;
+		goto done;
+	}
+
+	heap_stats.alloc_count++;
+	heap_stats.used_bytes += size;
+	if (heap_stats.peak_bytes < heap_stats.used_bytes)
+		heap_stats.peak_bytes = heap_stats.used_bytes;
+
+	for (i = 0; i < SBI_HEAP_STATS_MAX_CALLERS; i++) {
+		c = &heap_stats.callers[i];
+		if (c->caller && c->caller != caller)
+			continue;
+		c->caller = caller;
+		c->count++;
+		c->bytes += size;
+		break;
+	}
+
+done:
+	spin_unlock(&heap_stats_lock);
+}
+
+static void heap_stats_free(unsigned long size)
+{
+	spin_lock(&heap_stats_lock);
+	heap_stats.free_count++;
+	heap_stats.used_bytes -= size;
+	spin_unlock(&heap_stats_lock);
+}
+
+#else
+
+static inline void heap_stats_alloc(unsigned long size, unsigned long caller,
+				    void *ptr) { }
 
-	np = NULL;
-	sbi_list_for_each_entry(n, &hpctrl.used_space_list, head) {
-		if ((n->addr <= (unsigned long)ptr) &&
-		    ((unsigned long)ptr < (n->addr + n->size))) {
+static inline void heap_stats_free(unsigned long size) { }
+
+#endif
+
+static inline struct heap_node **heap_hash_bucket(struct heap_control *hpc,
+						  struct heap_node **table,
+						  unsigned long addr)
+{
+	u32 key = addr / HEAP_ALLOC_ALIGN;
+
+	if (!hpc->hash_bits)
+		return &table[0];
+
+	return &table[(u32)(key * 0x9E3779B1U) >> (32 - hpc->hash_bits)];
+}
+
+static void heap_start_add(struct heap_control *hpc, struct heap_node *n)
+{
+	struct heap_node **b = heap_hash_bucket(hpc, hpc->start_hash, n->addr);
+
+	n->start_next = *b;
+	*b = n;
+}
+
+static void heap_start_del(struct heap_control *hpc, struct heap_node *n)
+{
+	struct heap_node **b = heap_hash_bucket(hpc, hpc->start_hash, n->addr);
+
+	while (*b != n)
+		b = &(*b)->start_next;
+	*b = n->start_next;
+}
+
+static struct heap_node *heap_start_find(struct heap_control *hpc,
+					 unsigned long addr)
+{
+	struct heap_node *n = *heap_hash_bucket(hpc, hpc->start_hash, addr);
+
+	while (n && n->addr != addr)
+		n = n->start_next;
+
+	return n;
+}
+
+static void heap_end_add(struct heap_control *hpc, struct heap_node *n)
+{
+	struct heap_node **b = heap_hash_bucket(hpc, hpc->end_hash,
+						n->addr + n->size);
+
+	n->end_next = *b;
+	*b = n;
+}
+
+static void heap_end_del(struct heap_control *hpc, struct heap_node *n)
+{
+	struct heap_node **b = heap_hash_bucket(hpc, hpc->end_hash,
+						n->addr + n->size);
+
+	while (*b != n)
+		b = &(*b)->end_next;
+	*b = n->end_next;
+}
+
+static struct heap_node *heap_end_find(struct heap_control *hpc,
+				       unsigned long end)
+{
+	struct heap_node *n = *heap_hash_bucket(hpc, hpc->end_hash, end);
+
+	while (n && (n->addr + n->size) != end)
+		n = n->end_next;
+
+	return n;
+}
+
+/* Must be called with heap lock held */
+static struct heap_node *heap_node_get(struct heap_control *hpc)
+{
+	struct heap_node *n = sbi_list_first_entry(&hpc->free_node_list,
+						   struct heap_node, head);
+
+	sbi_list_del_init(&n->head);
+
+	return n;
+}
+
+/* Returns the highest address in the free block np where size bytes fit */
+static inline unsigned long heap_fit(struct heap_node *np, size_t size,
+				     unsigned long align)
+{
+	unsigned long addr;
+
+	if (np->size < size)
+		return 0;
+
+	addr = (np->addr + np->size - size) & ~(align - 1);
+
+	return (np->addr <= addr) ? addr : 0;
+}
+
+static void *heap_list_alloc(struct heap_control *hpc, size_t size,
+			     unsigned long align)
+{
+	unsigned long addr = 0, lower, upper, nodes = 0;
+	struct heap_node *n, *np = NULL;
+	struct sbi_dlist *pos;
+
+	spin_lock(&hpc->lock);
+
+	sbi_list_for_each_entry(n, &hpc->free_space_list, head) {
+		addr = heap_fit(n, size, align);
+		if (addr) {
 			np = n;
 			break;
 		}
 	}
-	if (!np) {
-		spin_unlock(&hpctrl.lock);
-		return;
+	if (!np)
+		goto done;
+
+	/* Blocks are split into free lower, used and free upper parts */
+	lower = addr - np->addr;
+	upper = np->addr + np->size - addr - size;
+	sbi_list_for_each(pos, &hpc->free_node_list) {
+		if (++nodes >= 2)
+			break;
+	}
+	if (nodes < (lower ? 1 : 0) + (upper ? 1 : 0)) {
+		np = NULL;
+		goto done;
 	}
 
-	sbi_list_del(&np->head);
+	heap_end_del(hpc, np);
 
-	sbi_list_for_each_entry(n, &hpctrl.free_space_list, head) {
-		if ((np->addr + np->size) == n->addr) {
-			n->addr = np->addr;
-			n->size += np->size;
-			sbi_list_add_tail(&np->head, &hpctrl.free_node_list);
-			np = NULL;
-			break;
-		} else if (np->addr == (n->addr + n->size)) {
-			n->size += np->size;
-			sbi_list_add_tail(&np->head, &hpctrl.free_node_list);
-			np = NULL;
-			break;
-		} else if ((n->addr + n->size) < np->addr) {
-			sbi_list_add(&np->head, &n->head);
-			np = NULL;
-			break;
-		}
+	if (upper) {
+		n = heap_node_get(hpc);
+		n->addr = addr + size;
+		n->size = upper;
+		n->free = true;
+		heap_start_add(hpc, n);
+		heap_end_add(hpc, n);
+		sbi_list_add_tail(&n->head, &hpc->free_space_list);
 	}
-	if (np)
-		sbi_list_add_tail(&np->head, &hpctrl.free_space_list);
 
-	spin_unlock(&hpctrl.lock);
+	if (lower) {
+		np->size = lower;
+		heap_end_add(hpc, np);
+
+		np = heap_node_get(hpc);
+		np->addr = addr;
+		heap_start_add(hpc, np);
+	} else {
+		sbi_list_del_init(&np->head);
+	}
+	np->size = size;
+	np->free = false;
+
+done:
+	spin_unlock(&hpc->lock);
+
+	return np ? (void *)np->addr : NULL;
 }
 
-unsigned long sbi_heap_free_space(void)
+/* Returns size of the freed allocation or zero if ptr was not found */
+static unsigned long heap_list_free(struct heap_control *hpc, void *ptr)
+{
+	struct heap_node *n, *np;
+	unsigned long size;
+
+	spin_lock(&hpc->lock);
+
+	np = heap_start_find(hpc, (unsigned long)ptr);
+	if (!np || np->free) {
+		spin_unlock(&hpc->lock);
+		return 0;
+	}
+
+	size = np->size;
+
+	/* Absorb the free block right after this one */
+	n = heap_start_find(hpc, np->addr + np->size);
+	if (n && n->free) {
+		heap_start_del(hpc, n);
+		heap_end_del(hpc, n);
+		sbi_list_del(&n->head);
+		np->size += n->size;
+		sbi_list_add_tail(&n->head, &hpc->free_node_list);
+	}
+
+	/* Merge into the free block right before this one */
+	n = heap_end_find(hpc, np->addr);
+	if (n) {
+		heap_start_del(hpc, np);
+		heap_end_del(hpc, n);
+		n->size += np->size;
+		heap_end_add(hpc, n);
+		sbi_list_add_tail(&np->head, &hpc->free_node_list);
+	} else {
+		np->free = true;
+		heap_end_add(hpc, np);
+		sbi_list_add_tail(&np->head, &hpc->free_space_list);
+	}
+
+	spin_unlock(&hpc->lock);
+
+	return size;
+}
+
+static unsigned long heap_list_free_space(struct heap_control *hpc)
 {
 	struct heap_node *n;
 	unsigned long ret = 0;
 
-	spin_lock(&hpctrl.lock);
-	sbi_list_for_each_entry(n, &hpctrl.free_space_list, head)
+	spin_lock(&hpc->lock);
+	sbi_list_for_each_entry(n, &hpc->free_space_list, head)
 		ret += n->size;
-	spin_unlock(&hpctrl.lock);
+	spin_unlock(&hpc->lock);
 
 	return ret;
 }
 
+static void heap_control_init(struct heap_control *hpc, unsigned long base,
+			      unsigned long size, unsigned long hksize)
+{
+	unsigned long i, buckets, nodes_base;
+	struct heap_node *n;
+
+	SPIN_LOCK_INIT(hpc->lock);
+	hpc->base = base;
+	hpc->size = size;
+	hpc->hkbase = hpc->base;
+	hpc->hksize = hksize;
+	SBI_INIT_LIST_HEAD(&hpc->free_node_list);
+	SBI_INIT_LIST_HEAD(&hpc->free_space_list);
+
+	/* About four nodes per bucket of each hash in the worst case */
+	buckets = hksize / (sizeof(*n) * 4);
+	hpc->hash_bits = buckets > 1 ? sbi_fls(buckets) : 0;
+	buckets = 1UL << hpc->hash_bits;
+	hpc->start_hash = (struct heap_node **)hpc->hkbase;
+	hpc->end_hash = hpc->start_hash + buckets;
+	for (i = 0; i < buckets; i++)
+		hpc->start_hash[i] = hpc->end_hash[i] = NULL;
+	nodes_base = (unsigned long)(hpc->end_hash + buckets);
+
+	/* Prepare free node list */
+	for (i = 0; i < ((hpc->hkbase + hpc->hksize - nodes_base) /
+			 sizeof(*n)); i++) {
+		n = (struct heap_node *)(nodes_base + (sizeof(*n) * i));
+		SBI_INIT_LIST_HEAD(&n->head);
+		n->addr = n->size = 0;
+		sbi_list_add_tail(&n->head, &hpc->free_node_list);
+	}
+
+	/* Prepare free space list */
+	n = sbi_list_first_entry(&hpc->free_node_list,
+				 struct heap_node, head);
+	sbi_list_del(&n->head);
+	n->addr = hpc->hkbase + hpc->hksize;
+	n->size = hpc->size - hpc->hksize;
+	n->free = true;
+	heap_start_add(hpc, n);
+	heap_end_add(hpc, n);
+	sbi_list_add_tail(&n->head, &hpc->free_space_list);
+}
+
+#if CONFIG_SBI_HEAP_LOCAL_SIZE
+
+/*
+ * HART-local arenas are carved out of the heap at boot and placed next
+ * to each other so the owning arena of a pointer is found using only
+ * its address. Allocations from the local arena only contend with
+ * frees of the same objects from other HARTs.
+ */
+#define HEAP_LOCAL_SIZE		((unsigned long)CONFIG_SBI_HEAP_LOCAL_SIZE)
+
+static struct heap_control *heap_local;
+static unsigned long heap_local_base;
+static u32 heap_local_count;
+
+static inline bool heap_local_contains(void *ptr)
+{
+	return heap_local_count &&
+	       (heap_local_base <= (unsigned long)ptr) &&
+	       ((unsigned long)ptr < (heap_local_base +
+			(HEAP_LOCAL_SIZE * heap_local_count)));
+}
+
+static unsigned long heap_local_free(void *ptr)
+{
+	u32 i = ((unsigned long)ptr - heap_local_base) / HEAP_LOCAL_SIZE;
+
+	return heap_list_free(&heap_local[i], ptr);
+}
+
+static void *heap_local_alloc(size_t size, unsigned long align)
+{
+	u32 i = sbi_hartid_to_hartindex(current_hartid());
+
+	if (i >= heap_local_count)
+		return NULL;
+
+	return heap_list_alloc(&heap_local[i], size, align);
+}
+
+static unsigned long heap_local_space(bool reserved)
+{
+	unsigned long ret = 0;
+	u32 i;
+
+	for (i = 0; i < heap_local_count; i++)
+		ret += reserved ? heap_local[i].hksize :
+			heap_list_free_space(&heap_local[i]);
+
+	return ret;
+}
+
+static void heap_local_init(void)
+{
+	u32 i, count = sbi_scratch_last_hartindex() + 1;
+
+	heap_local = heap_list_alloc(&hpctrl, count * sizeof(*heap_local),
+				     HEAP_ALLOC_ALIGN);
+	if (!heap_local)
+		return;
+
+	heap_local_base = (unsigned long)heap_list_alloc(&hpctrl,
+						count * HEAP_LOCAL_SIZE,
+						HEAP_ALLOC_ALIGN);
+	if (!heap_local_base) {
+		heap_list_free(&hpctrl, heap_local);
+		heap_local = NULL;
+		return;
+	}
+
+	for (i = 0; i < count; i++)
+		heap_control_init(&heap_local[i],
+				  heap_local_base + HEAP_LOCAL_SIZE * i,
+				  HEAP_LOCAL_SIZE,
+				  HEAP_LOCAL_SIZE / HEAP_HOUSEKEEPING_FACTOR);
+	heap_local_count = count;
+}
+
+#else
+
+static inline bool heap_local_contains(void *ptr) { return false; }
+
+static inline unsigned long heap_local_free(void *ptr) { return 0; }
+
+static inline void *heap_local_alloc(size_t size, unsigned long align)
+{
+	return NULL;
+}
+
+static inline unsigned long heap_local_space(bool reserved) { return 0; }
+
+static inline void heap_local_init(void) { }
+
+#endif
+
+static void *heap_alloc(size_t size, unsigned long align, bool local,
+			unsigned long caller)
+{
+	void *ret = NULL;
+
+	if (!size || (align & (align - 1)))
+		return NULL;
+
+	if (align < HEAP_ALLOC_ALIGN)
+		align = HEAP_ALLOC_ALIGN;
+
+	/* Rounding the size keeps the next block off the last line too */
+	size += align - 1;
+	size &= ~(align - 1);
+
+	if (local)
+		ret = heap_local_alloc(size, align);
+
+	/* Slab objects are aligned to their power of 2 size */
+#ifdef CONFIG_SBI_HEAP_SLAB
+	if (!ret && size <= HEAP_SLAB_MAX_SIZE && heap_slab_seg_size)
+		ret = heap_slab_alloc(size);
+#endif
+
+	if (!ret)
+		ret = heap_list_alloc(&hpctrl, size, align);
+
+	heap_stats_alloc(size, caller, ret);
+
+	return ret;
+}
+
+void *sbi_malloc(size_t size)
+{
+	return heap_alloc(size, HEAP_ALLOC_ALIGN, false,
+			  (unsigned long)__builtin_return_address(0));
+}
+
+void *sbi_zalloc(size_t size)
+{
+	void *ret = heap_alloc(size, HEAP_ALLOC_ALIGN, false,
+			       (unsigned long)__builtin_return_address(0));
+
+	if (ret)
+		sbi_memset(ret, 0, size);
+	return ret;
+}
+
+void *sbi_aligned_alloc(size_t size, unsigned long align)
+{
+	return heap_alloc(size, align, false,
+			  (unsigned long)__builtin_return_address(0));
+}
+
+void *sbi_zalloc_aligned(size_t size, unsigned long align)
+{
+	void *ret = heap_alloc(size, align, false,
+			       (unsigned long)__builtin_return_address(0));
+
+	if (ret)
+		sbi_memset(ret, 0, size);
+	return ret;
+}
+
+void *sbi_malloc_local(size_t size)
+{
+	return heap_alloc(size, heap_cacheline_size, true,
+			  (unsigned long)__builtin_return_address(0));
+}
+
+void *sbi_zalloc_local(size_t size)
+{
+	void *ret = heap_alloc(size, heap_cacheline_size, true,
+			       (unsigned long)__builtin_return_address(0));
+
+	if (ret)
+		sbi_memset(ret, 0, size);
+	return ret;
+}
+
+void sbi_heap_set_cacheline_size(unsigned long size)
+{
+	if (size && !(size & (size - 1)) && heap_cacheline_size < size)
+		heap_cacheline_size = size;
+}
+
+unsigned long sbi_heap_cacheline_size(void)
+{
+	return heap_cacheline_size;
+}
+
+void sbi_free(void *ptr)
+{
+	unsigned long size;
+
+	if (!ptr)
+		return;
+
+	if (heap_local_contains(ptr))
+		size = heap_local_free(ptr);
+	else if (heap_slab_contains(ptr))
+		size = heap_slab_free(ptr);
+	else
+		size = heap_list_free(&hpctrl, ptr);
+
+	if (size)
+		heap_stats_free(size);
+}
+
+unsigned long sbi_heap_free_space(void)
+{
+	return heap_list_free_space(&hpctrl) + heap_slab_free_space() +
+	       heap_local_space(false);
+}
+
 unsigned long sbi_heap_used_space(void)
 {
-	return hpctrl.size - hpctrl.hksize - sbi_heap_free_space();
+	return hpctrl.size - sbi_heap_reserved_space() - sbi_heap_free_space();
 }
 
 unsigned long sbi_heap_reserved_space(void)
 {
-	return hpctrl.hksize;
+	return hpctrl.hksize + heap_local_space(true);
 }
 
-int sbi_heap_init(struct sbi_scratch *scratch)
+#ifdef CONFIG_SBI_HEAP_STATS
+void sbi_heap_get_stats(struct sbi_heap_stats *stats)
+{
+	struct heap_node *n;
+
+	spin_lock(&heap_stats_lock);
+	sbi_memcpy(stats, &heap_stats, sizeof(*stats));
+	spin_unlock(&heap_stats_lock);
+
+	stats->largest_free = 0;
+	stats->free_blocks = 0;
+	spin_lock(&hpctrl.lock);
+	sbi_list_for_each_entry(n, &hpctrl.free_space_list, head) {
+		if (stats->largest_free < n->size)
+			stats->largest_free = n->size;
+		stats->free_blocks++;
+	}
+	spin_unlock(&hpctrl.lock);
+}
+
+void sbi_heap_dump_stats(void)
 {
+	struct sbi_heap_stats stats;
+	struct sbi_heap_caller_stats *c;
 	unsigned long i;
+
+	sbi_heap_get_stats(&stats);
+
+	sbi_printf("Firmware Heap Allocs      : "
+		   "%lu (allocs), %lu (frees), %lu (failed)\n",
+		   stats.alloc_count, stats.free_count, stats.alloc_failed);
+	sbi_printf("Firmware Heap Usage       : "
+		   "%lu B (used), %lu B (peak)\n",
+		   stats.used_bytes, stats.peak_bytes);
+	sbi_printf("Firmware Heap Free List   : "
+		   "%lu (blocks), %lu B (largest)\n",
+		   stats.free_blocks, stats.largest_free);
+	for (i = 0; i < SBI_HEAP_STATS_MAX_CALLERS; i++) {
+		c = &stats.callers[i];
+		if (!c->caller)
+			break;
+		sbi_printf("Firmware Heap Caller      : "
+			   "0x%lx %lu B (%lu allocs)\n",
+			   c->caller, c->bytes, c->count);
+	}
+}
+#endif
+
+extern const struct sbi_heap_need __sbi_heap_needs_start[]
+	__attribute__((visibility("hidden")));
+extern const struct sbi_heap_need __sbi_heap_needs_end[]
+	__attribute__((visibility("hidden")));
+
+/* Drivers, domains, FDT parsing and the small per-HART allocations */
+SBI_HEAP_NEED(core, 0x8000, 0x200);
+
+#if CONFIG_SBI_HEAP_LOCAL_SIZE
+SBI_HEAP_NEED(heap_local, 0, HEAP_LOCAL_SIZE + sizeof(struct heap_control));
+#endif
+
+unsigned long sbi_heap_size_estimate(u32 hart_count)
+{
+	const struct sbi_heap_need *n;
+	unsigned long size = 0;
+
+	for (n = __sbi_heap_needs_start; n < __sbi_heap_needs_end; n++)
+		size += n->global + n->per_hart * hart_count;
+
+	/*
+	 * The housekeeping nodes take 1/16 and the slab area 1/8 of the
+	 * heap, the rest of the quarter covers the alignment padding.
+	 */
+	size += size / 4;
+
+	return BIT_ALIGN(size, HEAP_BASE_ALIGN);
+}
+
+int sbi_heap_init(struct sbi_scratch *scratch)
+{
 	struct heap_node *n;
 
 	/* Sanity checks on heap offset and size */
@@ -174,31 +890,19 @@ int sbi_heap_init(struct sbi_scratch *scratch)
 		return SBI_EINVAL;
 
 	/* Initialize heap control */
-	SPIN_LOCK_INIT(hpctrl.lock);
-	hpctrl.base = scratch->fw_start + scratch->fw_heap_offset;
-	hpctrl.size = scratch->fw_heap_size;
-	hpctrl.hkbase = hpctrl.base;
-	hpctrl.hksize = hpctrl.size / HEAP_HOUSEKEEPING_FACTOR;
-	hpctrl.hksize &= ~((unsigned long)HEAP_BASE_ALIGN - 1);
-	SBI_INIT_LIST_HEAD(&hpctrl.free_node_list);
-	SBI_INIT_LIST_HEAD(&hpctrl.free_space_list);
-	SBI_INIT_LIST_HEAD(&hpctrl.used_space_list);
+	heap_control_init(&hpctrl, scratch->fw_start + scratch->fw_heap_offset,
+			  scratch->fw_heap_size,
+			  (scratch->fw_heap_size / HEAP_HOUSEKEEPING_FACTOR) &
+			  ~((unsigned long)HEAP_BASE_ALIGN - 1));
 
-	/* Prepare free node list */
-	for (i = 0; i < (hpctrl.hksize / sizeof(*n)); i++) {
-		n = (struct heap_node *)(hpctrl.hkbase + (sizeof(*n) * i));
-		SBI_INIT_LIST_HEAD(&n->head);
-		n->addr = n->size = 0;
-		sbi_list_add_tail(&n->head, &hpctrl.free_node_list);
-	}
-
-	/* Prepare free space list */
-	n = sbi_list_first_entry(&hpctrl.free_node_list,
+	/* Take the slab area from the end of the free space */
+	n = sbi_list_first_entry(&hpctrl.free_space_list,
 				 struct heap_node, head);
-	sbi_list_del(&n->head);
-	n->addr = hpctrl.hkbase + hpctrl.hksize;
-	n->size = hpctrl.size - hpctrl.hksize;
-	sbi_list_add_tail(&n->head, &hpctrl.free_space_list);
+	heap_end_del(&hpctrl, n);
+	n->size -= heap_slab_init();
+	heap_end_add(&hpctrl, n);
+
+	heap_local_init();
 
 	return 0;
 }
@@ -18,7 +18,9 @@
 #include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_heap.h>
 #include <sbi/sbi_hsm.h>
+#include <sbi/sbi_hsm_idle_stats.h>
 #include <sbi/sbi_init.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_scratch.h>
@@ -32,6 +34,8 @@
 	if (state != (oldstate))					\
 		sbi_printf("%s: ERR: The hart is in invalid state [%lu]\n", \
 			   __func__, state);				\
+	else								\
+		hsm_interruptible_update((hdata), (newstate));		\
 	state == (oldstate);						\
 })
 
@@ -49,9 +53,62 @@ struct sbi_hsm_data {
 #if __riscv_xlen == 32
 	unsigned long saved_menvcfgh;
 #endif
+	u64 saved_stimecmp;
 	atomic_t start_ticket;
+	u32 hartid;
+	u32 cluster;
+	bool cluster_idle;
 };
 
+/** Per cluster data to coordinate cluster suspend **/
+struct sbi_hsm_cluster {
+	/* Number of harts of the cluster in non-retentive suspend */
+	atomic_t idle_count;
+	/* Number of harts of the cluster */
+	u32 hart_count;
+	/* Was cluster suspend attempted by the last idle hart */
+	bool suspend_attempted;
+};
+
+static struct sbi_hsm_cluster *hsm_clusters;
+static u32 hsm_cluster_count;
+
+/*
+ * HART ids of the HARTs which can take interrupts, kept in sync with
+ * the HSM state so that IPI senders don't have to check every HART.
+ */
+static volatile unsigned long
+hsm_interruptible_harts[BITS_TO_LONGS(SBI_HARTMASK_MAX_BITS)];
+
+static void hsm_interruptible_update(struct sbi_hsm_data *hdata,
+				     long newstate)
+{
+	if (SBI_HARTMASK_MAX_BITS <= hdata->hartid)
+		return;
+
+	if (newstate == SBI_HSM_STATE_STARTED ||
+	    newstate == SBI_HSM_STATE_SUSPENDED ||
+	    newstate == SBI_HSM_STATE_RESUME_PENDING)
+		atomic_raw_set_bit(hdata->hartid, hsm_interruptible_harts);
+	else
+		atomic_raw_clear_bit(hdata->hartid, hsm_interruptible_harts);
+}
+
+/* Get the interruptible HARTs among the HART ids hbase onwards */
+static ulong hsm_interruptible_word(ulong hbase)
+{
+	ulong w = BIT_WORD(hbase), off = BIT_WORD_OFFSET(hbase), ret;
+
+	if (SBI_HARTMASK_MAX_BITS <= hbase)
+		return 0;
+
+	ret = hsm_interruptible_harts[w] >> off;
+	if (off && (w + 1) < BITS_TO_LONGS(SBI_HARTMASK_MAX_BITS))
+		ret |= hsm_interruptible_harts[w + 1] << (BITS_PER_LONG - off);
+
+	return ret;
+}
+
 bool sbi_hsm_hart_change_state(struct sbi_scratch *scratch, long oldstate,
 			       long newstate)
 {
@@ -81,6 +138,50 @@ int sbi_hsm_hart_get_state(const struct sbi_domain *dom, u32 hartid)
 	return __sbi_hsm_hart_get_state(hartid);
 }
 
+int sbi_hsm_hart_get_states(const struct sbi_domain *dom, ulong hbase,
+			    ulong count, unsigned long addr_lo,
+			    unsigned long addr_hi, unsigned long *out_count)
+{
+	struct sbi_scratch *rscratch;
+	struct sbi_hsm_data *hdata;
+	u8 *dst = (u8 *)addr_lo;
+	ulong i, m = 0;
+	u8 state;
+
+	*out_count = 0;
+
+	/* M-mode can only access shared memory below 4GB on RV32 */
+	if (addr_hi)
+		return SBI_EINVALID_ADDR;
+
+	if (!sbi_domain_check_addr_range(dom, addr_lo, count, PRV_S,
+					 SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_EINVALID_ADDR;
+
+	sbi_hart_map_saddr(addr_lo, count);
+	for (i = 0; i < count; i++) {
+		/* Fetch the assigned HARTs one word at a time */
+		if (!(i % BITS_PER_LONG))
+			m = sbi_domain_get_assigned_hartmask(dom, hbase + i);
+
+		state = SBI_EXT_OPENSBI_HSM_STATE_NONE;
+		rscratch = sbi_hartid_to_scratch(hbase + i);
+		if (rscratch && (m & 1UL)) {
+			hdata = sbi_scratch_offset_ptr(rscratch,
+						       hart_data_offset);
+			state = atomic_read(&hdata->state);
+		}
+		m >>= 1;
+
+		dst[i] = state;
+	}
+	sbi_hart_unmap_saddr();
+
+	*out_count = count;
+
+	return 0;
+}
+
 /*
  * Try to acquire the ticket for the given target hart to make sure only
  * one hart prepares the start of the target hart.
@@ -118,25 +219,12 @@ static void hsm_start_ticket_release(struct sbi_hsm_data *hdata)
 int sbi_hsm_hart_interruptible_mask(const struct sbi_domain *dom,
 				    ulong hbase, ulong *out_hmask)
 {
-	int hstate;
-	ulong i, hmask, dmask;
-
 	*out_hmask = 0;
 	if (!sbi_hartid_valid(hbase))
 		return SBI_EINVAL;
 
-	dmask = sbi_domain_get_assigned_hartmask(dom, hbase);
-	for (i = 0; i < BITS_PER_LONG; i++) {
-		hmask = 1UL << i;
-		if (!(dmask & hmask))
-			continue;
-
-		hstate = __sbi_hsm_hart_get_state(hbase + i);
-		if (hstate == SBI_HSM_STATE_STARTED ||
-		    hstate == SBI_HSM_STATE_SUSPENDED ||
-		    hstate == SBI_HSM_STATE_RESUME_PENDING)
-			*out_hmask |= hmask;
-	}
+	*out_hmask = sbi_domain_get_assigned_hartmask(dom, hbase) &
+		     hsm_interruptible_word(hbase);
 
 	return 0;
 }
@@ -162,20 +250,37 @@ void __noreturn sbi_hsm_hart_start_finish(struct sbi_scratch *scratch,
 	sbi_hart_switch_mode(hartid, next_arg1, next_addr, next_mode, false);
 }
 
+static bool hsm_device_has_hart_park(void)
+{
+	if (hsm_dev && hsm_dev->hart_park && hsm_dev->hart_unpark)
+		return true;
+	return false;
+}
+
 static void sbi_hsm_hart_wait(struct sbi_scratch *scratch, u32 hartid)
 {
 	unsigned long saved_mie;
 	struct sbi_hsm_data *hdata = sbi_scratch_offset_ptr(scratch,
 							    hart_data_offset);
+	bool park = hsm_device_has_hart_park();
+
 	/* Save MIE CSR */
 	saved_mie = csr_read(CSR_MIE);
 
-	/* Set MSIE and MEIE bits to receive IPI */
-	csr_set(CSR_MIE, MIP_MSIP | MIP_MEIP);
+	/*
+	 * Set MSIE and MEIE bits to receive IPI, a parked hart only
+	 * wakes up from its dedicated wake source instead
+	 */
+	if (!park)
+		csr_set(CSR_MIE, MIP_MSIP | MIP_MEIP);
 
 	/* Wait for state transition requested by sbi_hsm_hart_start() */
 	while (atomic_read(&hdata->state) != SBI_HSM_STATE_START_PENDING) {
-		wfi();
+		sbi_console_drain();
+		if (park)
+			hsm_dev->hart_park();
+		else
+			wfi();
 	}
 
 	/* Restore MIE CSR */
@@ -192,12 +297,99 @@ const struct sbi_hsm_device *sbi_hsm_get_device(void)
 	return hsm_dev;
 }
 
+static bool hsm_device_has_cluster_suspend(void)
+{
+	return (hsm_dev && hsm_dev->hart_cluster &&
+		hsm_dev->cluster_suspend) ? true : false;
+}
+
+/* Assign harts to the clusters reported by the HSM device */
+static void hsm_cluster_setup(void)
+{
+	struct sbi_hsm_data *hdata;
+	struct sbi_scratch *rscratch;
+	u32 i, count = 0;
+
+	if (!hart_data_offset || !hsm_device_has_cluster_suspend() ||
+	    hsm_clusters)
+		return;
+
+	for (i = 0; i <= sbi_scratch_last_hartindex(); i++) {
+		rscratch = sbi_hartindex_to_scratch(i);
+		if (!rscratch)
+			continue;
+
+		hdata = sbi_scratch_offset_ptr(rscratch, hart_data_offset);
+		hdata->cluster = hsm_dev->hart_cluster(
+					sbi_hartindex_to_hartid(i));
+		if (count <= hdata->cluster)
+			count = hdata->cluster + 1;
+	}
+
+	hsm_clusters = sbi_zalloc(count * sizeof(*hsm_clusters));
+	if (!hsm_clusters)
+		return;
+
+	for (i = 0; i <= sbi_scratch_last_hartindex(); i++) {
+		rscratch = sbi_hartindex_to_scratch(i);
+		if (!rscratch)
+			continue;
+
+		hdata = sbi_scratch_offset_ptr(rscratch, hart_data_offset);
+		hsm_clusters[hdata->cluster].hart_count++;
+	}
+
+	hsm_cluster_count = count;
+}
+
+/*
+ * Account current hart as idle in its cluster and return true if it is
+ * the last hart of the cluster to become idle.
+ */
+static bool hsm_cluster_enter_idle(struct sbi_hsm_data *hdata)
+{
+	struct sbi_hsm_cluster *cl;
+
+	if (!hsm_clusters || hsm_cluster_count <= hdata->cluster)
+		return false;
+
+	cl = &hsm_clusters[hdata->cluster];
+	hdata->cluster_idle = true;
+	if (atomic_add_return(&cl->idle_count, 1) != cl->hart_count)
+		return false;
+
+	cl->suspend_attempted = true;
+	return true;
+}
+
+/*
+ * Account current hart as running again in its cluster and restore the
+ * cluster state if it is the first hart resuming after cluster suspend.
+ */
+static void hsm_cluster_exit_idle(struct sbi_hsm_data *hdata, bool resume)
+{
+	struct sbi_hsm_cluster *cl;
+
+	if (!hdata->cluster_idle)
+		return;
+
+	cl = &hsm_clusters[hdata->cluster];
+	hdata->cluster_idle = false;
+	if (atomic_sub_return(&cl->idle_count, 1) + 1 == cl->hart_count &&
+	    cl->suspend_attempted) {
+		cl->suspend_attempted = false;
+		if (resume && hsm_dev->cluster_resume)
+			hsm_dev->cluster_resume();
+	}
+}
+
 void sbi_hsm_set_device(const struct sbi_hsm_device *dev)
 {
 	if (!dev || hsm_dev)
 		return;
 
 	hsm_dev = dev;
+	hsm_cluster_setup();
 }
 
 static bool hsm_device_has_hart_hotplug(void)
@@ -221,6 +413,14 @@ static int hsm_device_hart_start(u32 hartid, ulong saddr)
 	return SBI_ENOTSUPP;
 }
 
+/* Wake up a hart waiting in sbi_hsm_hart_wait() */
+static int hsm_hart_wake(u32 hartid)
+{
+	if (hsm_device_has_hart_park())
+		return hsm_dev->hart_unpark(hartid);
+	return sbi_ipi_raw_send(sbi_hartid_to_hartindex(hartid));
+}
+
 static int hsm_device_hart_stop(void)
 {
 	if (hsm_dev && hsm_dev->hart_stop)
@@ -243,12 +443,14 @@ static void hsm_device_hart_resume(void)
 
 int sbi_hsm_init(struct sbi_scratch *scratch, u32 hartid, bool cold_boot)
 {
+	int rc;
 	u32 i;
 	struct sbi_scratch *rscratch;
 	struct sbi_hsm_data *hdata;
 
 	if (cold_boot) {
-		hart_data_offset = sbi_scratch_alloc_offset(sizeof(*hdata));
+		hart_data_offset =
+			sbi_scratch_alloc_cacheline_offset(sizeof(*hdata));
 		if (!hart_data_offset)
 			return SBI_ENOMEM;
 
@@ -265,7 +467,15 @@ int sbi_hsm_init(struct sbi_scratch *scratch, u32 hartid, bool cold_boot)
 				    SBI_HSM_STATE_START_PENDING :
 				    SBI_HSM_STATE_STOPPED);
 			ATOMIC_INIT(&hdata->start_ticket, 0);
+			hdata->hartid = sbi_hartindex_to_hartid(i);
 		}
+
+		/* The HSM device might have been registered already */
+		hsm_cluster_setup();
+
+		rc = sbi_hsm_idle_stats_init();
+		if (rc)
+			return rc;
 	} else {
 		sbi_hsm_hart_wait(scratch, hartid);
 	}
@@ -301,9 +511,14 @@ fail_exit:
 	sbi_hart_hang();
 }
 
-int sbi_hsm_hart_start(struct sbi_scratch *scratch,
-		       const struct sbi_domain *dom,
-		       u32 hartid, ulong saddr, ulong smode, ulong arg1)
+/*
+ * Hand the start address over to a stopped hart and move it to the
+ * START_PENDING state. On success the caller owns the start ticket of
+ * the hart and must wake it up.
+ */
+static int hsm_hart_start_prepare(u32 hartid, ulong saddr, ulong smode,
+				  ulong arg1, struct sbi_hsm_data **out_hdata,
+				  bool *out_use_device)
 {
 	unsigned long init_count, entry_count;
 	unsigned int hstate;
@@ -311,15 +526,6 @@ int sbi_hsm_hart_start(struct sbi_scratch *scratch,
 	struct sbi_hsm_data *hdata;
 	int rc;
 
-	/* For now, we only allow start mode to be S-mode or U-mode. */
-	if (smode != PRV_S && smode != PRV_U)
-		return SBI_EINVAL;
-	if (dom && !sbi_domain_is_assigned_hart(dom, hartid))
-		return SBI_EINVAL;
-	if (dom && !sbi_domain_check_addr(dom, saddr, smode,
-					  SBI_DOMAIN_EXECUTE))
-		return SBI_EINVALID_ADDR;
-
 	rscratch = sbi_hartid_to_scratch(hartid);
 	if (!rscratch)
 		return SBI_EINVAL;
@@ -356,24 +562,131 @@ int sbi_hsm_hart_start(struct sbi_scratch *scratch,
 		goto err;
 	}
 
-	if ((hsm_device_has_hart_hotplug() && (entry_count == init_count)) ||
-	   (hsm_device_has_hart_secondary_boot() && !init_count)) {
-		rc = hsm_device_hart_start(hartid, scratch->warmboot_addr);
-	} else {
-		rc = sbi_ipi_raw_send(sbi_hartid_to_hartindex(hartid));
-	}
+	*out_hdata = hdata;
+	*out_use_device =
+		(hsm_device_has_hart_hotplug() && (entry_count == init_count)) ||
+		(hsm_device_has_hart_secondary_boot() && !init_count);
+	return 0;
 
-	if (!rc)
-		return 0;
+err:
+	hsm_start_ticket_release(hdata);
+	return rc;
+}
 
+/* Undo hsm_hart_start_prepare() when the hart could not be woken up */
+static void hsm_hart_start_abort(struct sbi_hsm_data *hdata)
+{
 	/* If it fails to start, change hart state back to stop */
 	__sbi_hsm_hart_change_state(hdata, SBI_HSM_STATE_START_PENDING,
 				    SBI_HSM_STATE_STOPPED);
-err:
 	hsm_start_ticket_release(hdata);
+}
+
+int sbi_hsm_hart_start(struct sbi_scratch *scratch,
+		       const struct sbi_domain *dom,
+		       u32 hartid, ulong saddr, ulong smode, ulong arg1)
+{
+	struct sbi_hsm_data *hdata;
+	bool use_device;
+	int rc;
+
+	/* For now, we only allow start mode to be S-mode or U-mode. */
+	if (smode != PRV_S && smode != PRV_U)
+		return SBI_EINVAL;
+	if (dom && !sbi_domain_is_assigned_hart(dom, hartid))
+		return SBI_EINVAL;
+	if (dom && !sbi_domain_check_addr(dom, saddr, smode,
+					  SBI_DOMAIN_EXECUTE))
+		return SBI_EINVALID_ADDR;
+
+	rc = hsm_hart_start_prepare(hartid, saddr, smode, arg1,
+				    &hdata, &use_device);
+	if (rc)
+		return rc;
+
+	if (use_device)
+		rc = hsm_device_hart_start(hartid, scratch->warmboot_addr);
+	else
+		rc = hsm_hart_wake(hartid);
+
+	if (!rc)
+		return 0;
+
+	hsm_hart_start_abort(hdata);
 	return rc;
 }
 
+int sbi_hsm_hart_start_many(struct sbi_scratch *scratch,
+			    const struct sbi_domain *dom,
+			    ulong hmask, ulong hbase, ulong saddr,
+			    ulong smode, ulong arg1, ulong *out_started)
+{
+	struct sbi_hsm_data *hdata[BITS_PER_LONG];
+	struct sbi_hartmask ipi_mask;
+	ulong i, started = 0, ipi_harts = 0;
+	bool use_device;
+	int rc, ret = 0;
+
+	*out_started = 0;
+
+	/* The start address is validated once for the whole set */
+	if (smode != PRV_S && smode != PRV_U)
+		return SBI_EINVAL;
+	if (!sbi_hartid_valid(hbase))
+		return SBI_EINVAL;
+	if ((sbi_domain_get_assigned_hartmask(dom, hbase) & hmask) != hmask)
+		return SBI_EINVAL;
+	if (!sbi_domain_check_addr(dom, saddr, smode, SBI_DOMAIN_EXECUTE))
+		return SBI_EINVALID_ADDR;
+
+	sbi_hartmask_clear_all(&ipi_mask);
+	for (i = 0; i < BITS_PER_LONG; i++) {
+		if (!(hmask & (1UL << i)))
+			continue;
+
+		rc = hsm_hart_start_prepare(hbase + i, saddr, smode, arg1,
+					    &hdata[i], &use_device);
+		if (!rc && use_device) {
+			rc = hsm_device_hart_start(hbase + i,
+						   scratch->warmboot_addr);
+			if (rc)
+				hsm_hart_start_abort(hdata[i]);
+		} else if (!rc && hsm_device_has_hart_park()) {
+			rc = hsm_hart_wake(hbase + i);
+			if (rc)
+				hsm_hart_start_abort(hdata[i]);
+		} else if (!rc) {
+			sbi_hartmask_set_hartid(hbase + i, &ipi_mask);
+			ipi_harts |= 1UL << i;
+		}
+
+		/* The other harts are still started, the first error is kept */
+		if (rc) {
+			if (!ret)
+				ret = rc;
+			continue;
+		}
+		started |= 1UL << i;
+	}
+
+	/* Wake up all the harts waiting in the warmboot path at once */
+	if (ipi_harts) {
+		rc = sbi_ipi_raw_send_mask(&ipi_mask);
+		if (rc) {
+			for (i = 0; i < BITS_PER_LONG; i++) {
+				if (ipi_harts & (1UL << i))
+					hsm_hart_start_abort(hdata[i]);
+			}
+			started &= ~ipi_harts;
+			if (!ret)
+				ret = rc;
+		}
+	}
+
+	*out_started = started;
+	return ret;
+}
+
 int sbi_hsm_hart_stop(struct sbi_scratch *scratch, bool exitnow)
 {
 	const struct sbi_domain *dom = sbi_domain_thishart_ptr();
@@ -396,6 +709,7 @@ int sbi_hsm_hart_stop(struct sbi_scratch *scratch, bool exitnow)
 static int __sbi_hsm_suspend_default(struct sbi_scratch *scratch)
 {
 	/* Wait for interrupt */
+	sbi_console_drain();
 	wfi();
 
 	return 0;
@@ -429,6 +743,17 @@ void __sbi_hsm_suspend_non_ret_save(struct sbi_scratch *scratch)
 #endif
 		hdata->saved_menvcfg = csr_read(CSR_MENVCFG);
 	}
+
+	/* The stimecmp CSR is lost in non-retentive suspend */
+	if (sbi_hart_has_hot_feature(scratch, SBI_HART_HOT_SSTC)) {
+#if __riscv_xlen == 32
+		hdata->saved_stimecmp = csr_read(CSR_STIMECMPH);
+		hdata->saved_stimecmp <<= 32;
+#else
+		hdata->saved_stimecmp = 0;
+#endif
+		hdata->saved_stimecmp |= csr_read(CSR_STIMECMP);
+	}
 }
 
 static void __sbi_hsm_suspend_non_ret_restore(struct sbi_scratch *scratch)
@@ -443,6 +768,13 @@ static void __sbi_hsm_suspend_non_ret_restore(struct sbi_scratch *scratch)
 #endif
 	}
 	csr_write(CSR_MEDELEG, hdata->saved_medeleg);
+	if (sbi_hart_has_hot_feature(scratch, SBI_HART_HOT_SSTC)) {
+#if __riscv_xlen == 32
+		csr_write(CSR_STIMECMP, -1UL);
+		csr_write(CSR_STIMECMPH, hdata->saved_stimecmp >> 32);
+#endif
+		csr_write(CSR_STIMECMP, (ulong)hdata->saved_stimecmp);
+	}
 	csr_write(CSR_MIE, hdata->saved_mie);
 	csr_set(CSR_MIP, (hdata->saved_mip & (MIP_SSIP | MIP_STIP)));
 }
@@ -457,6 +789,10 @@ void sbi_hsm_hart_resume_start(struct sbi_scratch *scratch)
 					 SBI_HSM_STATE_RESUME_PENDING))
 		sbi_hart_hang();
 
+	sbi_hsm_idle_stats_wake(scratch);
+
+	hsm_cluster_exit_idle(hdata, true);
+
 	hsm_device_hart_resume();
 }
 
@@ -477,6 +813,8 @@ void __noreturn sbi_hsm_hart_resume_finish(struct sbi_scratch *scratch,
 	 */
 	__sbi_hsm_suspend_non_ret_restore(scratch);
 
+	sbi_hsm_idle_stats_exit(scratch, true);
+
 	sbi_hart_switch_mode(hartid, scratch->next_arg1,
 			     scratch->next_addr,
 			     scratch->next_mode, false);
@@ -527,6 +865,7 @@ int sbi_hsm_hart_suspend(struct sbi_scratch *scratch, u32 suspend_type,
 
 	/* Save the suspend type */
 	hdata->suspend_type = suspend_type;
+	sbi_hsm_idle_stats_enter(scratch, suspend_type);
 
 	/*
 	 * Save context which will be restored after resuming from
@@ -535,8 +874,16 @@ int sbi_hsm_hart_suspend(struct sbi_scratch *scratch, u32 suspend_type,
 	if (suspend_type & SBI_HSM_SUSP_NON_RET_BIT)
 		__sbi_hsm_suspend_non_ret_save(scratch);
 
-	/* Try platform specific suspend */
-	ret = hsm_device_hart_suspend(suspend_type);
+	/*
+	 * Try cluster suspend on the last hart of a cluster entering
+	 * non-retentive suspend, otherwise platform specific suspend.
+	 */
+	sbi_hsm_idle_stats_suspend(scratch);
+	if ((suspend_type & SBI_HSM_SUSP_NON_RET_BIT) &&
+	    hsm_cluster_enter_idle(hdata))
+		ret = hsm_dev->cluster_suspend(suspend_type);
+	else
+		ret = hsm_device_hart_suspend(suspend_type);
 	if (ret == SBI_ENOTSUPP) {
 		/* Try generic implementation of default suspend types */
 		if (suspend_type == SBI_HSM_SUSPEND_RET_DEFAULT ||
@@ -544,6 +891,7 @@ int sbi_hsm_hart_suspend(struct sbi_scratch *scratch, u32 suspend_type,
 			ret = __sbi_hsm_suspend_default(scratch);
 		}
 	}
+	sbi_hsm_idle_stats_wake(scratch);
 
 	/*
 	 * The platform may have coordinated a retentive suspend, or it may
@@ -558,6 +906,9 @@ int sbi_hsm_hart_suspend(struct sbi_scratch *scratch, u32 suspend_type,
 		jump_warmboot();
 	}
 
+	/* Non-retentive suspend failed so this hart is not idle anymore */
+	hsm_cluster_exit_idle(hdata, false);
+
 	/*
 	 * We might have successfully resumed from retentive suspend
 	 * or suspend failed. In both cases, we restore state of hart.
@@ -566,5 +917,7 @@ int sbi_hsm_hart_suspend(struct sbi_scratch *scratch, u32 suspend_type,
 					 SBI_HSM_STATE_STARTED))
 		sbi_hart_hang();
 
+	sbi_hsm_idle_stats_exit(scratch, ret == 0);
+
 	return ret;
 }
@@ -0,0 +1,202 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_heap.h>
+#include <sbi/sbi_hsm_idle_stats.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_timer.h>
+
+/** Per-HART idle statistics */
+struct hsm_idle_stats_hart {
+	/* Timestamps of the suspend in progress */
+	u64 enter_time;
+	u64 suspend_time;
+	u64 wake_time;
+	u32 suspend_type;
+	bool pending;
+	/* Number of suspends not recorded because the table was full */
+	unsigned long dropped;
+	struct sbi_hsm_idle_stats_entry entries[SBI_HSM_IDLE_STATS_MAX_ENTRIES];
+};
+
+/** Offset of pointer to idle statistics in scratch space */
+static unsigned long hsm_idle_stats_ptr_offset;
+
+#define hsm_idle_stats_get_ptr(__scratch)				\
+	(hsm_idle_stats_ptr_offset ?					\
+	 sbi_scratch_read_type((__scratch), void *,			\
+			       hsm_idle_stats_ptr_offset) : NULL)
+
+void sbi_hsm_idle_stats_enter(struct sbi_scratch *scratch, u32 suspend_type)
+{
+	struct hsm_idle_stats_hart *is = hsm_idle_stats_get_ptr(scratch);
+
+	if (!is)
+		return;
+
+	is->suspend_type = suspend_type;
+	is->enter_time = sbi_timer_value();
+	is->suspend_time = is->enter_time;
+	is->wake_time = is->enter_time;
+	is->pending = true;
+}
+
+void sbi_hsm_idle_stats_suspend(struct sbi_scratch *scratch)
+{
+	struct hsm_idle_stats_hart *is = hsm_idle_stats_get_ptr(scratch);
+
+	if (is && is->pending)
+		is->suspend_time = sbi_timer_value();
+}
+
+void sbi_hsm_idle_stats_wake(struct sbi_scratch *scratch)
+{
+	struct hsm_idle_stats_hart *is = hsm_idle_stats_get_ptr(scratch);
+
+	if (is && is->pending)
+		is->wake_time = sbi_timer_value();
+}
+
+void sbi_hsm_idle_stats_exit(struct sbi_scratch *scratch, bool resumed)
+{
+	struct hsm_idle_stats_hart *is = hsm_idle_stats_get_ptr(scratch);
+	struct sbi_hsm_idle_stats_entry *e = NULL;
+	u64 exit_latency;
+	unsigned long i;
+
+	if (!is || !is->pending)
+		return;
+	is->pending = false;
+
+	/* Failed suspends are not accounted */
+	if (!resumed)
+		return;
+
+	for (i = 0; i < SBI_HSM_IDLE_STATS_MAX_ENTRIES; i++) {
+		e = &is->entries[i];
+		if (!e->count || e->suspend_type == is->suspend_type)
+			break;
+	}
+	if (i == SBI_HSM_IDLE_STATS_MAX_ENTRIES) {
+		is->dropped++;
+		return;
+	}
+
+	exit_latency = sbi_timer_value() - is->wake_time;
+	e->suspend_type = is->suspend_type;
+	e->residency += is->wake_time - is->suspend_time;
+	e->entry_latency += is->suspend_time - is->enter_time;
+	e->exit_latency += exit_latency;
+	if (e->max_exit_latency < exit_latency)
+		e->max_exit_latency = exit_latency;
+	e->count++;
+}
+
+int sbi_hsm_idle_stats_read(u32 hartid, unsigned long addr_lo,
+			    unsigned long addr_hi, unsigned long size,
+			    unsigned long flags, unsigned long *out_count)
+{
+	struct sbi_scratch *scratch = sbi_hartid_to_scratch(hartid);
+	struct sbi_hsm_idle_stats_entry *dst;
+	struct hsm_idle_stats_hart *is;
+	unsigned long i, count = 0, max;
+
+	if (flags & ~SBI_EXT_OPENSBI_IDLE_STATS_FLAG_CLEAR)
+		return SBI_EINVAL;
+
+	if (!scratch)
+		return SBI_EINVAL;
+
+	is = hsm_idle_stats_get_ptr(scratch);
+	if (!is)
+		return SBI_ENOTSUPP;
+
+	/* M-mode can only access shared memory below 4GB on RV32 */
+	if (addr_hi)
+		return SBI_EINVALID_ADDR;
+
+	if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(),
+					 addr_lo, size, PRV_S,
+					 SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_EINVALID_ADDR;
+
+	max = size / sizeof(*dst);
+	dst = (struct sbi_hsm_idle_stats_entry *)addr_lo;
+
+	sbi_hart_map_saddr(addr_lo, size);
+	for (i = 0; i < SBI_HSM_IDLE_STATS_MAX_ENTRIES && count < max; i++) {
+		if (!is->entries[i].count)
+			continue;
+		sbi_memcpy(&dst[count++], &is->entries[i], sizeof(*dst));
+	}
+	sbi_hart_unmap_saddr();
+
+	if (flags & SBI_EXT_OPENSBI_IDLE_STATS_FLAG_CLEAR) {
+		sbi_memset(is->entries, 0, sizeof(is->entries));
+		is->dropped = 0;
+	}
+
+	*out_count = count;
+
+	return 0;
+}
+
+void sbi_hsm_idle_stats_dump(struct sbi_scratch *scratch)
+{
+	struct hsm_idle_stats_hart *is = hsm_idle_stats_get_ptr(scratch);
+	struct sbi_hsm_idle_stats_entry *e;
+	unsigned long i;
+
+	if (!is)
+		return;
+
+	sbi_printf("HART%u idle statistics (dropped %lu)\n",
+		   current_hartid(), is->dropped);
+	for (i = 0; i < SBI_HSM_IDLE_STATS_MAX_ENTRIES; i++) {
+		e = &is->entries[i];
+		if (!e->count)
+			continue;
+
+		sbi_printf("  type=0x%08x count=%lu residency=%lu "
+			   "entry=%lu exit=%lu max_exit=%lu\n",
+			   e->suspend_type, (ulong)e->count,
+			   (ulong)e->residency,
+			   (ulong)(e->entry_latency / e->count),
+			   (ulong)(e->exit_latency / e->count),
+			   (ulong)e->max_exit_latency);
+	}
+}
+
+int sbi_hsm_idle_stats_init(void)
+{
+	struct sbi_scratch *scratch;
+	struct hsm_idle_stats_hart *is;
+	u32 i;
+
+	hsm_idle_stats_ptr_offset = sbi_scratch_alloc_type_offset(void *);
+	if (!hsm_idle_stats_ptr_offset)
+		return SBI_ENOMEM;
+
+	for (i = 0; i <= sbi_scratch_last_hartindex(); i++) {
+		scratch = sbi_hartindex_to_scratch(i);
+		if (!scratch)
+			continue;
+
+		is = sbi_zalloc(sizeof(*is));
+		if (!is)
+			return SBI_ENOMEM;
+
+		sbi_scratch_write_type(scratch, void *,
+				       hsm_idle_stats_ptr_offset, is);
+	}
+
+	return 0;
+}
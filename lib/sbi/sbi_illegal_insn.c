@@ -11,10 +11,13 @@
 #include <sbi/riscv_barrier.h>
 #include <sbi/riscv_encoding.h>
 #include <sbi/sbi_bitops.h>
+#include <sbi/sbi_emulate_bitmanip.h>
 #include <sbi/sbi_emulate_csr.h>
 #include <sbi/sbi_error.h>
+#include <sbi/sbi_heap.h>
 #include <sbi/sbi_illegal_insn.h>
 #include <sbi/sbi_pmu.h>
+#include <sbi/sbi_timer.h>
 #include <sbi/sbi_trap.h>
 #include <sbi/sbi_unpriv.h>
 #include <sbi/sbi_console.h>
@@ -46,6 +49,13 @@ static int misc_mem_opcode_insn(ulong insn, struct sbi_trap_regs *regs)
 	return truly_illegal_insn(insn, regs);
 }
 
+static int bitmanip_opcode_insn(ulong insn, struct sbi_trap_regs *regs)
+{
+	int rc = sbi_emulate_bitmanip(insn, regs);
+
+	return (rc == SBI_ENOTSUPP) ? truly_illegal_insn(insn, regs) : rc;
+}
+
 static int system_opcode_insn(ulong insn, struct sbi_trap_regs *regs)
 {
 	int do_write, rs1_num = (insn >> 15) & 0x1f;
@@ -106,17 +116,17 @@ static const illegal_insn_func illegal_insn_table[32] = {
 	truly_illegal_insn, /* 1 */
 	truly_illegal_insn, /* 2 */
 	misc_mem_opcode_insn, /* 3 */
-	truly_illegal_insn, /* 4 */
+	bitmanip_opcode_insn, /* 4 */
 	truly_illegal_insn, /* 5 */
-	truly_illegal_insn, /* 6 */
+	bitmanip_opcode_insn, /* 6 */
 	truly_illegal_insn, /* 7 */
 	truly_illegal_insn, /* 8 */
 	truly_illegal_insn, /* 9 */
 	truly_illegal_insn, /* 10 */
 	truly_illegal_insn, /* 11 */
-	truly_illegal_insn, /* 12 */
+	bitmanip_opcode_insn, /* 12 */
 	truly_illegal_insn, /* 13 */
-	truly_illegal_insn, /* 14 */
+	bitmanip_opcode_insn, /* 14 */
 	truly_illegal_insn, /* 15 */
 	truly_illegal_insn, /* 16 */
 	truly_illegal_insn, /* 17 */
@@ -136,11 +146,95 @@ static const illegal_insn_func illegal_insn_table[32] = {
 	truly_illegal_insn  /* 31 */
 };
 
+/*
+ * Fast path for pure CSR reads (rdtime, rdcycle, rdinstret, etc) which
+ * are by far the most frequently emulated instructions. These never write
+ * the CSR so the opcode table and the RM decoding are skipped altogether.
+ */
+static int csr_read_insn(ulong insn, struct sbi_trap_regs *regs)
+{
+	int csr_num = (u32)insn >> 20;
+	ulong prev_mode = (regs->mstatus & MSTATUS_MPP) >> MSTATUS_MPP_SHIFT;
+	ulong csr_val;
+#if __riscv_xlen == 32
+	bool virt = (regs->mstatusH & MSTATUSH_MPV) ? true : false;
+#else
+	bool virt = (regs->mstatus & MSTATUS_MPV) ? true : false;
+#endif
+
+	if (prev_mode == PRV_M)
+		return system_opcode_insn(insn, regs);
+
+	switch (csr_num) {
+	case CSR_TIME:
+		csr_val = (virt) ? sbi_timer_virt_value() : sbi_timer_value();
+		break;
+#if __riscv_xlen == 32
+	case CSR_TIMEH:
+		csr_val = ((virt) ? sbi_timer_virt_value() :
+				    sbi_timer_value()) >> 32;
+		break;
+#endif
+	default:
+		if (sbi_emulate_csr_read(csr_num, regs, &csr_val))
+			return truly_illegal_insn(insn, regs);
+		break;
+	}
+
+	SET_RD(insn, regs, csr_val);
+
+	regs->mepc += 4;
+
+	return 0;
+}
+
+/*
+ * Platform hooks indexed by major opcode and then by funct3. The second
+ * level is only allocated for major opcodes having hooks registered so
+ * the common case costs a single NULL check.
+ */
+static sbi_illegal_insn_hook *illegal_insn_hooks[32];
+
+int sbi_illegal_insn_register(u32 opcode, int funct3,
+			      sbi_illegal_insn_hook hook)
+{
+	sbi_illegal_insn_hook *hooks;
+	int i;
+
+	if (!hook || (opcode & ~0x7fU) || (opcode & 3) != 3 ||
+	    funct3 < SBI_ILLEGAL_INSN_FUNCT3_ANY || 7 < funct3)
+		return SBI_EINVAL;
+
+	hooks = illegal_insn_hooks[opcode >> 2];
+	if (!hooks) {
+		hooks = sbi_zalloc(8 * sizeof(*hooks));
+		if (!hooks)
+			return SBI_ENOMEM;
+		illegal_insn_hooks[opcode >> 2] = hooks;
+	}
+
+	for (i = 0; i < 8; i++) {
+		if (funct3 != SBI_ILLEGAL_INSN_FUNCT3_ANY && funct3 != i)
+			continue;
+		if (hooks[i])
+			return SBI_EALREADY;
+	}
+
+	for (i = 0; i < 8; i++) {
+		if (funct3 == SBI_ILLEGAL_INSN_FUNCT3_ANY || funct3 == i)
+			hooks[i] = hook;
+	}
+
+	return 0;
+}
+
 int sbi_illegal_insn_handler(struct sbi_trap_context *tcntx)
 {
 	struct sbi_trap_regs *regs = &tcntx->regs;
 	ulong insn = tcntx->trap.tval;
 	struct sbi_trap_info uptrap;
+	sbi_illegal_insn_hook *hooks;
+	int rc;
 
 	/*
 	 * We only deal with 32-bit (or longer) illegal instructions. If we
@@ -162,5 +256,15 @@ int sbi_illegal_insn_handler(struct sbi_trap_context *tcntx)
 			return truly_illegal_insn(insn, regs);
 	}
 
+	hooks = illegal_insn_hooks[(insn & 0x7c) >> 2];
+	if (unlikely(hooks != NULL) && hooks[GET_RM(insn)]) {
+		rc = hooks[GET_RM(insn)](insn, regs);
+		if (rc != SBI_ENOTSUPP)
+			return rc;
+	}
+
+	if ((insn & INSN_MASK_CSRR) == INSN_MATCH_CSRR)
+		return csr_read_insn(insn, regs);
+
 	return illegal_insn_table[(insn & 0x7c) >> 2](insn, regs);
 }
@@ -10,26 +10,39 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/riscv_atomic.h>
 #include <sbi/riscv_barrier.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_boot_profile.h>
+#include <sbi/sbi_cache.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_cppc.h>
 #include <sbi/sbi_domain.h>
 #include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_stats.h>
 #include <sbi/sbi_fwft.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_heap.h>
 #include <sbi/sbi_hsm.h>
+#include <sbi/sbi_nacl.h>
+#include <sbi/sbi_hsm_idle_stats.h>
+#include <sbi/sbi_lockstat.h>
+#include <sbi/sbi_init.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_irqchip.h>
+#include <sbi/sbi_misaligned_stats.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_pmu.h>
 #include <sbi/sbi_dbtr.h>
 #include <sbi/sbi_sse.h>
+#include <sbi/sbi_static_call.h>
 #include <sbi/sbi_system.h>
 #include <sbi/sbi_string.h>
 #include <sbi/sbi_timer.h>
 #include <sbi/sbi_tlb.h>
+#include <sbi/sbi_trace.h>
+#include <sbi/sbi_trap_ldst.h>
 #include <sbi/sbi_version.h>
+#include <sbi/sbi_wait.h>
 #include <sbi/sbi_unit_test.h>
 
 #define BANNER                                              \
@@ -131,15 +144,17 @@ static void sbi_boot_print_general(struct sbi_scratch *scratch)
 		   (u32)(sbi_heap_reserved_space() / 1024),
 		   (u32)(sbi_heap_used_space() / 1024),
 		   (u32)(sbi_heap_free_space() / 1024));
+	sbi_heap_dump_stats();
 	sbi_printf("Firmware Scratch Size     : "
 		   "%d B (total), %d B (used), %d B (free)\n",
-		   SBI_SCRATCH_SIZE,
+		   (u32)sbi_scratch_size(),
 		   (u32)sbi_scratch_used_space(),
-		   (u32)(SBI_SCRATCH_SIZE - sbi_scratch_used_space()));
+		   (u32)(sbi_scratch_size() - sbi_scratch_used_space()));
 
 	/* SBI details */
 	sbi_printf("Runtime SBI Version       : %d.%d\n",
 		   sbi_ecall_version_major(), sbi_ecall_version_minor());
+	sbi_boot_profile_dump();
 	sbi_printf("\n");
 }
 
@@ -188,22 +203,97 @@ static void sbi_boot_print_hart(struct sbi_scratch *scratch, u32 hartid)
 		   sbi_hart_mhpm_mask(scratch));
 	sbi_printf("Boot HART Debug Triggers  : %d triggers\n",
 		   sbi_dbtr_get_total_triggers());
+	sbi_printf("Boot HART Scratch Space   : %lu/%lu bytes\n",
+		   sbi_scratch_used_space(), sbi_scratch_size());
+	sbi_scratch_get_cacheline_str(str, sizeof(str));
+	sbi_printf("Boot HART Scratch Lines   : %s\n", str);
 	sbi_hart_delegation_dump(scratch, "Boot HART ", "         ");
 }
 
-static unsigned long coldboot_done;
+/* HSM state of all HARTs is initialized */
+#define COLDBOOT_PHASE_HSM		1
+/* Platform early init and global HART feature data are initialized */
+#define COLDBOOT_PHASE_HART		2
+/* Domains are finalized so no more coldboot work is posted */
+#define COLDBOOT_PHASE_DOMAIN		3
 
-static void wait_for_coldboot(struct sbi_scratch *scratch, u32 hartid)
+static unsigned long coldboot_phase;
+
+/* Coldboot work shared with the HARTs waiting for the domain phase */
+static struct sbi_init_work *init_work;
+static atomic_t init_work_users = ATOMIC_INITIALIZER(0);
+
+static void init_work_process(struct sbi_init_work *work)
+{
+	long i;
+	int rc;
+
+	while ((i = atomic_add_return(&work->next, 1) - 1) < work->count) {
+		rc = work->process(work, i);
+		if (rc)
+			work->error = rc;
+		atomic_add_return(&work->done, 1);
+	}
+}
+
+int sbi_init_work_run(struct sbi_init_work *work)
 {
-	/* Wait for coldboot to finish */
-	while (!__smp_load_acquire(&coldboot_done))
+	if (!work || !work->process)
+		return SBI_EINVAL;
+
+	ATOMIC_INIT(&work->next, 0);
+	ATOMIC_INIT(&work->done, 0);
+	work->error = 0;
+
+	if (__smp_load_acquire(&coldboot_phase) >= COLDBOOT_PHASE_DOMAIN) {
+		init_work_process(work);
+		return work->error;
+	}
+
+	__smp_store_release(&init_work, work);
+	init_work_process(work);
+	sbi_wait_until(&work->done.counter, VAL >= work->count);
+
+	/* Helpers may still hold the work so wait for them to drop it */
+	__smp_store_release(&init_work, NULL);
+	mb();
+	while (atomic_read(&init_work_users))
 		cpu_relax();
+
+	return work->error;
 }
 
-static void wake_coldboot_harts(struct sbi_scratch *scratch, u32 hartid)
+/* Help with the coldboot work until the domains are finalized */
+static void init_work_help(void)
 {
-	/* Mark coldboot done */
-	__smp_store_release(&coldboot_done, 1);
+	struct sbi_init_work *work;
+
+	while (__smp_load_acquire(&coldboot_phase) < COLDBOOT_PHASE_DOMAIN) {
+		if (!__smp_load_acquire(&init_work)) {
+			cpu_relax();
+			continue;
+		}
+
+		atomic_add_return(&init_work_users, 1);
+		work = __smp_load_acquire(&init_work);
+		if (work)
+			init_work_process(work);
+		atomic_sub_return(&init_work_users, 1);
+	}
+}
+
+static void wait_for_coldboot(struct sbi_scratch *scratch, u32 hartid,
+			      unsigned long phase)
+{
+	/* Wait for coldboot to reach the phase */
+	sbi_wait_until(&coldboot_phase, VAL >= phase);
+}
+
+static void wake_coldboot_harts(struct sbi_scratch *scratch, u32 hartid,
+				unsigned long phase)
+{
+	/* Mark coldboot phase done */
+	__smp_store_release(&coldboot_phase, phase);
 }
 
 static unsigned long entry_count_offset;
@@ -215,16 +305,24 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 	unsigned long *count;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
+	sbi_boot_profile_mark("reset to coldboot");
+
 	/* Note: This has to be first thing in coldboot init sequence */
 	rc = sbi_scratch_init(scratch);
 	if (rc)
 		sbi_hart_hang();
 
+	rc = spin_lock_queue_init();
+	if (rc)
+		sbi_hart_hang();
+
 	/* Note: This has to be second thing in coldboot init sequence */
 	rc = sbi_heap_init(scratch);
 	if (rc)
 		sbi_hart_hang();
 
+	sbi_boot_profile_mark("scratch and heap init");
+
 	/* Note: This has to be the third thing in coldboot init sequence */
 	rc = sbi_domain_init(scratch, hartid);
 	if (rc)
@@ -238,6 +336,20 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 	if (!init_count_offset)
 		sbi_hart_hang();
 
+	rc = sbi_boot_profile_init();
+	if (rc)
+		sbi_hart_hang();
+
+	rc = sbi_trace_init();
+	if (rc)
+		sbi_hart_hang();
+
+	rc = sbi_lockstat_init();
+	if (rc)
+		sbi_hart_hang();
+
+	sbi_boot_profile_mark("domain init");
+
 	count = sbi_scratch_offset_ptr(scratch, entry_count_offset);
 	(*count)++;
 
@@ -245,32 +357,51 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 	if (rc)
 		sbi_hart_hang();
 
+	sbi_boot_profile_mark("hsm init");
+
 	/*
 	 * All non-coldboot HARTs do HSM initialization (i.e. enter HSM state
 	 * machine) at the start of the warmboot path so it is wasteful to
 	 * have these HARTs busy spin in wait_for_coldboot() until coldboot
 	 * path is completed.
 	 */
-	wake_coldboot_harts(scratch, hartid);
+	wake_coldboot_harts(scratch, hartid, COLDBOOT_PHASE_HSM);
 
 	rc = sbi_platform_early_init(plat, true);
 	if (rc)
 		sbi_hart_hang();
 
+	sbi_boot_profile_mark("platform early init");
+
 	rc = sbi_hart_init(scratch, true);
 	if (rc)
 		sbi_hart_hang();
 
+	sbi_boot_profile_mark("hart init");
+
+	/*
+	 * Let non-coldboot HARTs do their HART local initialization while
+	 * the rest of the coldboot path runs instead of deferring all of
+	 * it until they are started. Everything below either depends on
+	 * the HART being started or is global state which is only used
+	 * after that.
+	 */
+	wake_coldboot_harts(scratch, hartid, COLDBOOT_PHASE_HART);
+
 	rc = sbi_console_init(scratch);
 	if (rc)
 		sbi_hart_hang();
 
+	sbi_boot_profile_mark("console init");
+
 	rc = sbi_sse_init(scratch, true);
 	if (rc) {
 		sbi_printf("%s: sse init failed (error %d)\n", __func__, rc);
 		sbi_hart_hang();
 	}
 
+	sbi_boot_profile_mark("sse init");
+
 	rc = sbi_pmu_init(scratch, true);
 	if (rc) {
 		sbi_printf("%s: pmu init failed (error %d)\n",
@@ -278,12 +409,18 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 		sbi_hart_hang();
 	}
 
+	sbi_boot_profile_mark("pmu init");
+
 	rc = sbi_dbtr_init(scratch, true);
 	if (rc)
 		sbi_hart_hang();
 
+	sbi_boot_profile_mark("dbtr init");
+
 	sbi_boot_print_banner(scratch);
 
+	sbi_boot_profile_mark("banner");
+
 	rc = sbi_irqchip_init(scratch, true);
 	if (rc) {
 		sbi_printf("%s: irqchip init failed (error %d)\n",
@@ -291,30 +428,55 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 		sbi_hart_hang();
 	}
 
+	sbi_boot_profile_mark("irqchip init");
+
 	rc = sbi_ipi_init(scratch, true);
 	if (rc) {
 		sbi_printf("%s: ipi init failed (error %d)\n", __func__, rc);
 		sbi_hart_hang();
 	}
 
+	sbi_boot_profile_mark("ipi init");
+
 	rc = sbi_tlb_init(scratch, true);
 	if (rc) {
 		sbi_printf("%s: tlb init failed (error %d)\n", __func__, rc);
 		sbi_hart_hang();
 	}
 
+	sbi_boot_profile_mark("tlb init");
+
 	rc = sbi_timer_init(scratch, true);
 	if (rc) {
 		sbi_printf("%s: timer init failed (error %d)\n", __func__, rc);
 		sbi_hart_hang();
 	}
 
+	sbi_boot_profile_mark("timer init");
+
 	rc = sbi_fwft_init(scratch, true);
 	if (rc) {
 		sbi_printf("%s: fwft init failed (error %d)\n", __func__, rc);
 		sbi_hart_hang();
 	}
 
+	sbi_boot_profile_mark("fwft init");
+
+	rc = sbi_nacl_init(scratch, true);
+	if (rc) {
+		sbi_printf("%s: nacl init failed (error %d)\n", __func__, rc);
+		sbi_hart_hang();
+	}
+
+	rc = sbi_trap_ldst_init(scratch, true);
+	if (rc) {
+		sbi_printf("%s: trap ldst init failed (error %d)\n",
+			   __func__, rc);
+		sbi_hart_hang();
+	}
+
+	sbi_boot_profile_mark("trap ldst init");
+
 	/*
 	 * Note: Finalize domains after HSM initialization so that we
 	 * can startup non-root domains.
@@ -328,6 +490,19 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 		sbi_hart_hang();
 	}
 
+	sbi_boot_profile_mark("domain finalize");
+
+	/* Before any HART of a non-root domain can start its time slice */
+	rc = sbi_domain_sched_start(scratch, true);
+	if (rc) {
+		sbi_printf("%s: domain sched start failed (error %d)\n",
+			   __func__, rc);
+		sbi_hart_hang();
+	}
+
+	/* HARTs helping with the coldboot work can go to the HSM wait */
+	wake_coldboot_harts(scratch, hartid, COLDBOOT_PHASE_DOMAIN);
+
 	/*
 	 * Note: Platform final initialization should be after finalizing
 	 * domains so that it sees correct domain assignment and PMP
@@ -340,6 +515,8 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 		sbi_hart_hang();
 	}
 
+	sbi_boot_profile_mark("platform final init");
+
 	/*
 	 * Note: Ecall initialization should be after platform final
 	 * initialization so that all available platform devices are
@@ -351,6 +528,8 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 		sbi_hart_hang();
 	}
 
+	sbi_boot_profile_mark("ecall init");
+
 	sbi_boot_print_general(scratch);
 
 	sbi_boot_print_domains(scratch);
@@ -370,29 +549,69 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 		sbi_hart_hang();
 	}
 
+	sbi_cache_set_way_mask(sbi_domain_thishart_ptr()->cache_way_mask);
+
+	/* The coldboot HART was assigned to its domain after sbi_hart_init() */
+	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SMSTATEEN))
+		sbi_hart_mstateen_configure(scratch,
+				sbi_domain_thishart_ptr()->stateen0_deny);
+
 	count = sbi_scratch_offset_ptr(scratch, init_count_offset);
 	(*count)++;
 
 	sbi_hsm_hart_start_finish(scratch, hartid);
 }
 
+/*
+ * HART local initialization which neither depends on other HARTs nor on
+ * the HART being started. Its result persists in scratch space so for a
+ * HART started again after a stop it is done before waiting to be
+ * started, which shortens the HART start latency.
+ */
+static int init_warm_local(struct sbi_scratch *scratch)
+{
+	int rc;
+
+	rc = sbi_dbtr_init(scratch, false);
+	if (rc)
+		return rc;
+
+	rc = sbi_fwft_init(scratch, false);
+	if (rc)
+		return rc;
+
+	rc = sbi_nacl_init(scratch, false);
+	if (rc)
+		return rc;
+
+	return sbi_trap_ldst_init(scratch, false);
+}
+
 static void __noreturn init_warm_startup(struct sbi_scratch *scratch,
 					 u32 hartid)
 {
 	int rc;
-	unsigned long *count;
+	bool express;
+	unsigned long *count, cycles, start_cycle;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	if (!entry_count_offset || !init_count_offset)
 		sbi_hart_hang();
 
+	/* HARTs which were started before take the express start path */
+	count = sbi_scratch_offset_ptr(scratch, init_count_offset);
+	express = (*count) ? true : false;
+
 	count = sbi_scratch_offset_ptr(scratch, entry_count_offset);
 	(*count)++;
 
-	/* Note: This has to be first thing in warmboot init sequence */
-	rc = sbi_hsm_init(scratch, hartid, false);
-	if (rc)
-		sbi_hart_hang();
+	/*
+	 * HART local initialization which only needs the platform early
+	 * init and global HART data of the coldboot path is done before
+	 * waiting to be started so it overlaps with the coldboot path.
+	 */
+	wait_for_coldboot(scratch, hartid, COLDBOOT_PHASE_HART);
+	start_cycle = sbi_boot_profile_cycles();
 
 	rc = sbi_platform_early_init(plat, false);
 	if (rc)
@@ -402,15 +621,26 @@ static void __noreturn init_warm_startup(struct sbi_scratch *scratch,
 	if (rc)
 		sbi_hart_hang();
 
-	rc = sbi_sse_init(scratch, false);
+	if (express && init_warm_local(scratch))
+		sbi_hart_hang();
+
+	init_work_help();
+
+	/* Note: Everything below has to be after the HSM wait */
+	cycles = sbi_boot_profile_cycles() - start_cycle;
+	rc = sbi_hsm_init(scratch, hartid, false);
 	if (rc)
 		sbi_hart_hang();
+	start_cycle = sbi_boot_profile_cycles();
 
-	rc = sbi_pmu_init(scratch, false);
+	/* Device callbacks were patched by the coldboot HART meanwhile */
+	sbi_static_call_sync();
+
+	rc = sbi_sse_init(scratch, false);
 	if (rc)
 		sbi_hart_hang();
 
-	rc = sbi_dbtr_init(scratch, false);
+	rc = sbi_pmu_init(scratch, false);
 	if (rc)
 		sbi_hart_hang();
 
@@ -430,8 +660,7 @@ static void __noreturn init_warm_startup(struct sbi_scratch *scratch,
 	if (rc)
 		sbi_hart_hang();
 
-	rc = sbi_fwft_init(scratch, false);
-	if (rc)
+	if (!express && init_warm_local(scratch))
 		sbi_hart_hang();
 
 	rc = sbi_platform_final_init(plat, false);
@@ -446,6 +675,15 @@ static void __noreturn init_warm_startup(struct sbi_scratch *scratch,
 	if (rc)
 		sbi_hart_hang();
 
+	sbi_cache_set_way_mask(sbi_domain_thishart_ptr()->cache_way_mask);
+
+	rc = sbi_domain_sched_start(scratch, false);
+	if (rc)
+		sbi_hart_hang();
+
+	cycles += sbi_boot_profile_cycles() - start_cycle;
+	sbi_boot_profile_warmboot(scratch, cycles);
+
 	count = sbi_scratch_offset_ptr(scratch, init_count_offset);
 	(*count)++;
 
@@ -464,6 +702,10 @@ static void __noreturn init_warm_resume(struct sbi_scratch *scratch,
 	if (rc)
 		sbi_hart_hang();
 
+	sbi_system_resume();
+
+	sbi_pmu_resume(scratch);
+
 	rc = sbi_hart_pmp_configure(scratch);
 	if (rc)
 		sbi_hart_hang();
@@ -477,7 +719,7 @@ static void __noreturn init_warmboot(struct sbi_scratch *scratch, u32 hartid)
 {
 	int hstate;
 
-	wait_for_coldboot(scratch, hartid);
+	wait_for_coldboot(scratch, hartid, COLDBOOT_PHASE_HSM);
 
 	hstate = sbi_hsm_hart_get_state(sbi_domain_thishart_ptr(), hartid);
 	if (hstate < 0)
@@ -509,15 +751,19 @@ void __noreturn sbi_init(struct sbi_scratch *scratch)
 {
 	u32 i, h;
 	bool hartid_valid		= false;
+	bool preferred_valid		= false;
 	bool next_mode_supported	= false;
 	bool coldboot			= false;
 	u32 hartid			= current_hartid();
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+	u32 preferred			= sbi_platform_cold_boot_hart(plat);
 
 	for (i = 0; i < plat->hart_count; i++) {
 		h = (plat->hart_index2id) ? plat->hart_index2id[i] : i;
 		if (h == hartid)
 			hartid_valid = true;
+		if (h == preferred)
+			preferred_valid = true;
 	}
 	if (!hartid_valid)
 		sbi_hart_hang();
@@ -545,12 +791,20 @@ void __noreturn sbi_init(struct sbi_scratch *scratch)
 	 * the next booting stage.
 	 *
 	 * We use a lottery mechanism to select coldboot HART among
-	 * HARTs which satisfy above condition.
+	 * HARTs which satisfy above condition unless the platform has
+	 * a preferred coldboot HART. In that case, the other HARTs go
+	 * straight to warmboot so the coldboot HART is the same on
+	 * every boot.
 	 */
 
+	if (preferred_valid && !sbi_platform_cold_boot_allowed(plat, preferred))
+		preferred_valid = false;
+
 	if (sbi_platform_cold_boot_allowed(plat, hartid)) {
-		if (next_mode_supported &&
-		    atomic_xchg(&coldboot_lottery, 1) == 0)
+		if (preferred_valid)
+			coldboot = next_mode_supported && hartid == preferred;
+		else if (next_mode_supported &&
+			 atomic_xchg(&coldboot_lottery, 1) == 0)
 			coldboot = true;
 	}
 
@@ -621,6 +875,14 @@ void __noreturn sbi_exit(struct sbi_scratch *scratch)
 
 	sbi_platform_early_exit(plat);
 
+	sbi_ecall_stats_dump(scratch);
+
+	sbi_misaligned_stats_dump(scratch);
+
+	sbi_hsm_idle_stats_dump(scratch);
+
+	sbi_lockstat_dump();
+
 	sbi_sse_exit(scratch);
 
 	sbi_pmu_exit(scratch);
@@ -633,5 +895,7 @@ void __noreturn sbi_exit(struct sbi_scratch *scratch)
 
 	sbi_platform_final_exit(plat);
 
+	sbi_system_reset_halt_ack(sbi_hartid_to_hartindex(hartid));
+
 	sbi_hsm_exit(scratch);
 }
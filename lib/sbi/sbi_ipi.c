@@ -20,11 +20,19 @@
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_pmu.h>
+#include <sbi/sbi_static_call.h>
 #include <sbi/sbi_string.h>
 #include <sbi/sbi_tlb.h>
+#include <sbi/sbi_trace.h>
 
 struct sbi_ipi_data {
 	unsigned long ipi_type;
+	/* HART index of the owner, cached for sbi_ipi_process() */
+	u32 hartindex;
+#ifdef CONFIG_SBI_IPI_FORWARD
+	/* HARTs this HART has to interrupt on behalf of others */
+	struct sbi_hartmask forward;
+#endif
 };
 
 _Static_assert(
@@ -36,8 +44,27 @@ static unsigned long ipi_data_off;
 static const struct sbi_ipi_device *ipi_dev = NULL;
 static const struct sbi_ipi_event_ops *ipi_ops_array[SBI_IPI_EVENT_MAX];
 
-static int sbi_ipi_send(struct sbi_scratch *scratch, u32 remote_hartindex,
-			u32 event, void *data)
+/* Targets of the IPI send and clear callers before the device */
+static void ipi_send_none(u32 hartindex) { }
+static void ipi_clear_none(u32 hartindex) { }
+
+SBI_STATIC_CALL_DEFINE(ipi_send, ipi_send_none);
+SBI_STATIC_CALL_DEFINE(ipi_clear, ipi_clear_none);
+
+static inline bool sbi_ipi_event_has_doorbell(u32 event)
+{
+	return ipi_dev && ipi_dev->ipi_send_event &&
+	       event < ipi_dev->ipi_event_count;
+}
+
+/*
+ * Prepare an IPI event for a remote HART. The remote HART index is set
+ * in send_mask when it must be interrupted, the interrupt itself is
+ * triggered later by the caller as part of a batch.
+ */
+static int sbi_ipi_prepare(struct sbi_scratch *scratch, u32 remote_hartindex,
+			   u32 event, void *data, struct sbi_hartmask *send_mask,
+			   ulong *send_count, ulong *sent)
 {
 	int ret = 0;
 	struct sbi_scratch *remote_scratch = NULL;
@@ -55,6 +82,8 @@ static int sbi_ipi_send(struct sbi_scratch *scratch, u32 remote_hartindex,
 
 	ipi_data = sbi_scratch_offset_ptr(remote_scratch, ipi_data_off);
 
+	sbi_trace(SBI_TRACE_IPI_SEND, remote_hartindex, event);
+
 	if (ipi_ops->update) {
 		ret = ipi_ops->update(scratch, remote_scratch,
 				      remote_hartindex, data);
@@ -70,23 +99,232 @@ static int sbi_ipi_send(struct sbi_scratch *scratch, u32 remote_hartindex,
 		return 0;
 	}
 
+	/*
+	 * Events with a dedicated doorbell don't need the IPI type
+	 * because the device itself keeps track of pending events.
+	 */
+	if (sbi_ipi_event_has_doorbell(event)) {
+		sbi_hartmask_set_hartindex(remote_hartindex, send_mask);
+		(*send_count)++;
+		(*sent)++;
+		return ret;
+	}
+
 	/*
 	 * Set IPI type on remote hart's scratch area and
-	 * trigger the interrupt.
+	 * request the interrupt.
 	 *
 	 * Multiple harts may be trying to send IPI to the
-	 * remote hart so call sbi_ipi_raw_send() only when
+	 * remote hart so trigger the interrupt only when
 	 * the ipi_type was previously zero.
 	 */
 	if (!__atomic_fetch_or(&ipi_data->ipi_type,
-				BIT(event), __ATOMIC_RELAXED))
-		ret = sbi_ipi_raw_send(remote_hartindex);
+				BIT(event), __ATOMIC_RELAXED)) {
+		sbi_hartmask_set_hartindex(remote_hartindex, send_mask);
+		(*send_count)++;
+	}
 
-	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_IPI_SENT);
+	(*sent)++;
 
 	return ret;
 }
 
+static int ipi_raw_send_mask(const struct sbi_hartmask *mask, u32 event)
+{
+	u32 i;
+
+	if (!ipi_dev || (!ipi_dev->ipi_send_mask && !ipi_dev->ipi_send))
+		return SBI_EINVAL;
+
+	/* Same ordering requirements as sbi_ipi_raw_send() */
+	wmb();
+
+	if (sbi_ipi_event_has_doorbell(event)) {
+		sbi_hartmask_for_each_hartindex(i, mask)
+			ipi_dev->ipi_send_event(i, event);
+	} else if (ipi_dev->ipi_send_mask) {
+		ipi_dev->ipi_send_mask(mask);
+	} else {
+		sbi_hartmask_for_each_hartindex(i, mask)
+			sbi_static_call(ipi_send)(i);
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_SBI_IPI_FORWARD
+/* Number of consecutive hartids sharing a cluster leader */
+static u32 ipi_forward_harts;
+
+static inline u32 ipi_forward_leader(u32 hartid)
+{
+	return hartid & ~(ipi_forward_harts - 1);
+}
+
+/*
+ * Queue the HARTs in members for forwarding by the given HART and add
+ * it to out. The members are added to out instead when the forwarder
+ * is not running because it would not forward them in time.
+ */
+static void ipi_forward_queue(u32 fwd_hartindex, struct sbi_hartmask *members,
+			      struct sbi_hartmask *out)
+{
+	struct sbi_scratch *fwd_scratch;
+	struct sbi_ipi_data *fwd_data;
+	u32 i;
+
+	if (sbi_hartmask_empty(members))
+		return;
+
+	fwd_scratch = sbi_hartindex_to_scratch(fwd_hartindex);
+	if (!fwd_scratch)
+		goto direct;
+
+	fwd_data = sbi_scratch_offset_ptr(fwd_scratch, ipi_data_off);
+	for (i = 0; i < BITS_TO_LONGS(sbi_hartmask_used_bits()); i++) {
+		if (members->bits[i])
+			__atomic_fetch_or(&fwd_data->forward.bits[i],
+					  members->bits[i], __ATOMIC_SEQ_CST);
+	}
+
+	/*
+	 * A stopping forwarder changes its state before draining its
+	 * forward mask in sbi_ipi_exit() so either it observes the bits
+	 * set above or the state read below is not STARTED.
+	 */
+	if (__sbi_hsm_hart_get_state(sbi_hartindex_to_hartid(fwd_hartindex)) !=
+	    SBI_HSM_STATE_STARTED)
+		goto direct;
+
+	sbi_hartmask_set_hartindex(fwd_hartindex, out);
+	sbi_hartmask_clear_all(members);
+	return;
+
+direct:
+	sbi_hartmask_or(out, out, members);
+	sbi_hartmask_clear_all(members);
+}
+
+/*
+ * Replace the targets in other clusters by their cluster leader which
+ * forwards to the targets of its cluster.
+ */
+static void ipi_forward_clusters(struct sbi_hartmask *mask)
+{
+	u32 i, hartid, leader, self, lindex = -1U;
+	struct sbi_hartmask out, members;
+
+	if (ipi_forward_harts < 2)
+		return;
+
+	self = ipi_forward_leader(current_hartid());
+	sbi_hartmask_clear_all(&out);
+	sbi_hartmask_clear_all(&members);
+	sbi_hartmask_for_each_hartindex(i, mask) {
+		hartid = sbi_hartindex_to_hartid(i);
+		leader = ipi_forward_leader(hartid);
+		if (leader == hartid || leader == self) {
+			sbi_hartmask_set_hartindex(i, &out);
+			continue;
+		}
+
+		if (sbi_hartid_to_hartindex(leader) != lindex) {
+			ipi_forward_queue(lindex, &members, &out);
+			lindex = sbi_hartid_to_hartindex(leader);
+		}
+		sbi_hartmask_set_hartindex(i, &members);
+	}
+	ipi_forward_queue(lindex, &members, &out);
+
+	*mask = out;
+}
+
+/*
+ * Split the targets into CONFIG_SBI_IPI_FORWARD_FANOUT chunks of
+ * consecutive HARTs. Only the first HART of each chunk is interrupted
+ * and it splits the rest of its chunk the same way so the interrupts
+ * of N targets are raised by log(N) levels of HARTs.
+ */
+static void ipi_forward_tree(struct sbi_hartmask *mask)
+{
+	const u32 fanout = CONFIG_SBI_IPI_FORWARD_FANOUT;
+	u32 i, n = 0, chunk, count, head = -1U, head_chunk = -1U;
+	struct sbi_hartmask out, members;
+
+	count = sbi_hartmask_weight(mask);
+	if (fanout < 2 || count <= fanout)
+		return;
+
+	sbi_hartmask_clear_all(&out);
+	sbi_hartmask_clear_all(&members);
+	sbi_hartmask_for_each_hartindex(i, mask) {
+		chunk = (n++ * fanout) / count;
+		if (chunk != head_chunk) {
+			ipi_forward_queue(head, &members, &out);
+			sbi_hartmask_set_hartindex(i, &out);
+			head = i;
+			head_chunk = chunk;
+			continue;
+		}
+		sbi_hartmask_set_hartindex(i, &members);
+	}
+	ipi_forward_queue(head, &members, &out);
+
+	*mask = out;
+}
+
+static void ipi_forward_mask(struct sbi_hartmask *mask, u32 event)
+{
+	if (sbi_ipi_event_has_doorbell(event))
+		return;
+
+	/* The IPI type of the targets must be visible to the forwarders */
+	wmb();
+
+	ipi_forward_clusters(mask);
+	ipi_forward_tree(mask);
+}
+
+void sbi_ipi_forward_process(void)
+{
+	struct sbi_ipi_data *ipi_data;
+	struct sbi_hartmask mask;
+	bool pending = false;
+	u32 i;
+
+	if (!ipi_data_off)
+		return;
+
+	ipi_data = sbi_scratch_thishart_offset_ptr(ipi_data_off);
+	for (i = 0; i < BITS_TO_LONGS(sbi_hartmask_used_bits()); i++) {
+		mask.bits[i] = 0;
+		if (!__atomic_load_n(&ipi_data->forward.bits[i],
+				     __ATOMIC_RELAXED))
+			continue;
+		mask.bits[i] = atomic_raw_xchg_ulong(&ipi_data->forward.bits[i],
+						     0);
+		pending = true;
+	}
+	if (!pending)
+		return;
+
+	/* Forward to the children first, the own events are handled later */
+	ipi_forward_mask(&mask, SBI_IPI_EVENT_MAX);
+	ipi_raw_send_mask(&mask, SBI_IPI_EVENT_MAX);
+}
+
+void sbi_ipi_set_forward_cluster(u32 harts)
+{
+	/* Cluster leaders are found by aligning the hartid */
+	if (harts & (harts - 1))
+		return;
+
+	ipi_forward_harts = harts;
+}
+#else
+static inline void ipi_forward_mask(struct sbi_hartmask *mask, u32 event) { }
+#endif
+
 static int sbi_ipi_sync(struct sbi_scratch *scratch, u32 event)
 {
 	const struct sbi_ipi_event_ops *ipi_ops;
@@ -102,6 +340,69 @@ static int sbi_ipi_sync(struct sbi_scratch *scratch, u32 event)
 	return 0;
 }
 
+static int ipi_raw_send_one(u32 hartindex, u32 event)
+{
+	struct sbi_hartmask mask;
+
+	if (sbi_ipi_event_has_doorbell(event) || !ipi_dev ||
+	    !ipi_dev->ipi_send) {
+		sbi_hartmask_clear_all(&mask);
+		sbi_hartmask_set_hartindex(hartindex, &mask);
+		return ipi_raw_send_mask(&mask, event);
+	}
+
+	return sbi_ipi_raw_send(hartindex);
+}
+
+/*
+ * Send an IPI event to exactly one HART without building the target
+ * mask. Self-IPIs are completed by sbi_ipi_prepare() on the local HART
+ * so there is nothing to sync for them.
+ */
+static int ipi_send_one(struct sbi_scratch *scratch, u32 hartindex,
+			u32 event, void *data)
+{
+	struct sbi_hartmask send_mask;
+	ulong send_count, sent = 0;
+	unsigned long start_cycle;
+	int rc;
+
+	if (scratch == sbi_hartindex_to_scratch(hartindex)) {
+		rc = sbi_ipi_prepare(scratch, hartindex, event, data,
+				     &send_mask, &send_count, &sent);
+		return (rc < 0) ? rc : 0;
+	}
+
+	start_cycle = csr_read(CSR_MCYCLE);
+
+	do {
+		/* Only the send count is looked at, not the send mask */
+		send_count = 0;
+		rc = sbi_ipi_prepare(scratch, hartindex, event, data,
+				     &send_mask, &send_count, &sent);
+		if (rc < 0)
+			break;
+		if (send_count) {
+			rc = ipi_raw_send_one(hartindex, event);
+			if (rc)
+				break;
+		}
+	} while (rc == SBI_IPI_UPDATE_RETRY);
+
+	if (rc > 0)
+		rc = 0;
+
+	sbi_pmu_ctr_add_fw(SBI_PMU_FW_IPI_SENT, sent);
+
+	sbi_ipi_sync(scratch, event);
+
+	if (sent)
+		sbi_pmu_ctr_add_fw(SBI_PMU_FW_IPI_SEND_CYCLES,
+				   csr_read(CSR_MCYCLE) - start_cycle);
+
+	return rc;
+}
+
 /**
  * As this this function only handlers scalar values of hart mask, it must be
  * set to all online harts if the intention is to send IPIs to all the harts.
@@ -109,12 +410,13 @@ static int sbi_ipi_sync(struct sbi_scratch *scratch, u32 event)
  */
 int sbi_ipi_send_many(ulong hmask, ulong hbase, u32 event, void *data)
 {
-	int rc = 0;
-	bool retry_needed;
-	ulong i, m;
+	int rc = 0, send_rc;
+	ulong i, m, send_count, sent = 0;
 	struct sbi_hartmask target_mask = {0};
+	struct sbi_hartmask send_mask, retry_mask;
 	struct sbi_domain *dom = sbi_domain_thishart_ptr();
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	unsigned long start_cycle;
 
 	/* Find the target harts */
 	if (hbase != -1UL) {
@@ -122,41 +424,70 @@ int sbi_ipi_send_many(ulong hmask, ulong hbase, u32 event, void *data)
 		if (rc)
 			return rc;
 		m &= hmask;
-
-		for (i = hbase; m; i++, m >>= 1) {
-			if (m & 1UL)
-				sbi_hartmask_set_hartid(i, &target_mask);
-		}
+		/* Single target, typically the local HART */
+		if (m && !(m & (m - 1)))
+			return ipi_send_one(scratch,
+				sbi_hartid_to_hartindex(hbase + sbi_ffs(m)),
+				event, data);
+		sbi_hartmask_set_hartid_mask(m, hbase, &target_mask);
 	} else {
 		hbase = 0;
 		while (!sbi_hsm_hart_interruptible_mask(dom, hbase, &m)) {
-			for (i = hbase; m; i++, m >>= 1) {
-				if (m & 1UL)
-					sbi_hartmask_set_hartid(i, &target_mask);
-			}
+			sbi_hartmask_set_hartid_mask(m, hbase, &target_mask);
 			hbase += BITS_PER_LONG;
 		}
 	}
 
-	/* Send IPIs */
+	start_cycle = csr_read(CSR_MCYCLE);
+
+	/*
+	 * Send IPIs
+	 *
+	 * Each pass first updates the IPI data of all target harts and
+	 * then triggers the interrupts of the whole pass in one batch so
+	 * that only one barrier and one device operation is needed.
+	 */
 	do {
-		retry_needed = false;
+		send_count = 0;
+		sbi_hartmask_clear_all(&send_mask);
+		sbi_hartmask_clear_all(&retry_mask);
 		sbi_hartmask_for_each_hartindex(i, &target_mask) {
-			rc = sbi_ipi_send(scratch, i, event, data);
+			rc = sbi_ipi_prepare(scratch, i, event, data,
+					     &send_mask, &send_count, &sent);
 			if (rc < 0)
-				goto done;
+				break;
 			if (rc == SBI_IPI_UPDATE_RETRY)
-				retry_needed = true;
-			else
-				sbi_hartmask_clear_hartindex(i, &target_mask);
+				sbi_hartmask_set_hartindex(i, &retry_mask);
 			rc = 0;
 		}
-	} while (retry_needed);
+
+		/* Harts updated before a failure still get their IPI */
+		if (send_count)
+			ipi_forward_mask(&send_mask, event);
+		send_rc = send_count ?
+			  ipi_raw_send_mask(&send_mask, event) : 0;
+		if (rc < 0)
+			goto done;
+		if (send_rc) {
+			rc = send_rc;
+			goto done;
+		}
+
+		/* Only the harts asking for a retry are visited again */
+		target_mask = retry_mask;
+	} while (!sbi_hartmask_empty(&target_mask));
 
 done:
+	sbi_pmu_ctr_add_fw(SBI_PMU_FW_IPI_SENT, sent);
+
 	/* Sync IPIs */
 	sbi_ipi_sync(scratch, event);
 
+	/* Time from the first send until the targets acknowledged */
+	if (sent)
+		sbi_pmu_ctr_add_fw(SBI_PMU_FW_IPI_SEND_CYCLES,
+				   csr_read(CSR_MCYCLE) - start_cycle);
+
 	return rc;
 }
 
@@ -228,29 +559,50 @@ int sbi_ipi_send_halt(ulong hmask, ulong hbase)
 void sbi_ipi_process(void)
 {
 	unsigned long ipi_type;
-	unsigned int ipi_event;
 	const struct sbi_ipi_event_ops *ipi_ops;
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 	struct sbi_ipi_data *ipi_data =
 			sbi_scratch_offset_ptr(scratch, ipi_data_off);
-	u32 hartindex = sbi_hartid_to_hartindex(current_hartid());
 
 	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_IPI_RECVD);
-	sbi_ipi_raw_clear(hartindex);
+	sbi_ipi_raw_clear(ipi_data->hartindex);
+	sbi_ipi_forward_process();
 
-	ipi_type = atomic_raw_xchg_ulong(&ipi_data->ipi_type, 0);
-	ipi_event = 0;
-	while (ipi_type) {
-		if (ipi_type & 1UL) {
-			ipi_ops = ipi_ops_array[ipi_event];
+	/*
+	 * Events raised while processing are picked up by the next
+	 * exchange instead of taking another trap for them.
+	 */
+	while ((ipi_type = atomic_raw_xchg_ulong(&ipi_data->ipi_type, 0))) {
+		sbi_trace(SBI_TRACE_IPI_RECV, ipi_type, 0);
+		do {
+			ipi_ops = ipi_ops_array[sbi_ffs(ipi_type)];
 			if (ipi_ops)
 				ipi_ops->process(scratch);
-		}
-		ipi_type = ipi_type >> 1;
-		ipi_event++;
+			ipi_type &= ipi_type - 1;
+		} while (ipi_type);
 	}
 }
 
+void sbi_ipi_process_event(u32 event)
+{
+	const struct sbi_ipi_event_ops *ipi_ops;
+
+	if (SBI_IPI_EVENT_MAX <= event)
+		return;
+
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_IPI_RECVD);
+
+	/*
+	 * Ensure that the event data written by the sender before
+	 * triggering the doorbell is observed by the event callback.
+	 */
+	mb();
+
+	ipi_ops = ipi_ops_array[event];
+	if (ipi_ops)
+		ipi_ops->process(sbi_scratch_thishart_ptr());
+}
+
 int sbi_ipi_raw_send(u32 hartindex)
 {
 	if (!ipi_dev || !ipi_dev->ipi_send)
@@ -267,14 +619,19 @@ int sbi_ipi_raw_send(u32 hartindex)
 	 */
 	wmb();
 
-	ipi_dev->ipi_send(hartindex);
+	sbi_static_call(ipi_send)(hartindex);
 	return 0;
 }
 
+int sbi_ipi_raw_send_mask(const struct sbi_hartmask *mask)
+{
+	return ipi_raw_send_mask(mask, SBI_IPI_EVENT_MAX);
+}
+
 void sbi_ipi_raw_clear(u32 hartindex)
 {
 	if (ipi_dev && ipi_dev->ipi_clear)
-		ipi_dev->ipi_clear(hartindex);
+		sbi_static_call(ipi_clear)(hartindex);
 
 	/*
 	 * Ensure that memory or MMIO writes after this
@@ -299,6 +656,8 @@ void sbi_ipi_set_device(const struct sbi_ipi_device *dev)
 		return;
 
 	ipi_dev = dev;
+	sbi_static_call_update(ipi_send, dev->ipi_send);
+	sbi_static_call_update(ipi_clear, dev->ipi_clear);
 }
 
 int sbi_ipi_init(struct sbi_scratch *scratch, bool cold_boot)
@@ -307,7 +666,8 @@ int sbi_ipi_init(struct sbi_scratch *scratch, bool cold_boot)
 	struct sbi_ipi_data *ipi_data;
 
 	if (cold_boot) {
-		ipi_data_off = sbi_scratch_alloc_offset(sizeof(*ipi_data));
+		ipi_data_off =
+			sbi_scratch_alloc_cacheline_offset(sizeof(*ipi_data));
 		if (!ipi_data_off)
 			return SBI_ENOMEM;
 		ret = sbi_ipi_event_create(&ipi_smode_ops);
@@ -328,6 +688,10 @@ int sbi_ipi_init(struct sbi_scratch *scratch, bool cold_boot)
 
 	ipi_data = sbi_scratch_offset_ptr(scratch, ipi_data_off);
 	ipi_data->ipi_type = 0x00;
+	ipi_data->hartindex = sbi_hartid_to_hartindex(current_hartid());
+#ifdef CONFIG_SBI_IPI_FORWARD
+	sbi_hartmask_clear_all(&ipi_data->forward);
+#endif
 
 	/*
 	 * Initialize platform IPI support. This will also clear any
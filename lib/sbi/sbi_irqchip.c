@@ -7,8 +7,106 @@
  *   Anup Patel <apatel@ventanamicro.com>
  */
 
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_heap.h>
 #include <sbi/sbi_irqchip.h>
 #include <sbi/sbi_platform.h>
+#include <sbi/sbi_static_call.h>
+
+#define IRQCHIP_HANDLERS_PER_CHUNK	32
+
+struct irqchip_handler {
+	sbi_irqchip_handler handler;
+	void *priv;
+};
+
+/* Two level table of handlers indexed by hwirq, chunks allocated on demand */
+static struct irqchip_handler *irqchip_handlers[SBI_IRQCHIP_MAX_HWIRQ /
+						IRQCHIP_HANDLERS_PER_CHUNK];
+
+int sbi_irqchip_register_handler(u32 hwirq, sbi_irqchip_handler handler,
+				 void *priv)
+{
+	struct irqchip_handler *chunk;
+
+	if (!handler || SBI_IRQCHIP_MAX_HWIRQ <= hwirq)
+		return SBI_EINVAL;
+
+	chunk = irqchip_handlers[hwirq / IRQCHIP_HANDLERS_PER_CHUNK];
+	if (!chunk) {
+		chunk = sbi_zalloc(IRQCHIP_HANDLERS_PER_CHUNK * sizeof(*chunk));
+		if (!chunk)
+			return SBI_ENOMEM;
+		irqchip_handlers[hwirq / IRQCHIP_HANDLERS_PER_CHUNK] = chunk;
+	}
+
+	chunk = &chunk[hwirq % IRQCHIP_HANDLERS_PER_CHUNK];
+	if (chunk->handler)
+		return SBI_EALREADY;
+
+	chunk->priv = priv;
+	chunk->handler = handler;
+
+	return 0;
+}
+
+void sbi_irqchip_unregister_handler(u32 hwirq)
+{
+	struct irqchip_handler *chunk;
+
+	if (SBI_IRQCHIP_MAX_HWIRQ <= hwirq)
+		return;
+
+	chunk = irqchip_handlers[hwirq / IRQCHIP_HANDLERS_PER_CHUNK];
+	if (chunk)
+		chunk[hwirq % IRQCHIP_HANDLERS_PER_CHUNK].handler = NULL;
+}
+
+int sbi_irqchip_handle_hwirq(u32 hwirq)
+{
+	struct irqchip_handler *chunk;
+
+	if (SBI_IRQCHIP_MAX_HWIRQ <= hwirq)
+		return SBI_ENOENT;
+
+	chunk = irqchip_handlers[hwirq / IRQCHIP_HANDLERS_PER_CHUNK];
+	if (!chunk)
+		return SBI_ENOENT;
+
+	chunk = &chunk[hwirq % IRQCHIP_HANDLERS_PER_CHUNK];
+	if (!chunk->handler)
+		return SBI_ENOENT;
+
+	return chunk->handler(hwirq, chunk->priv);
+}
+
+static SBI_LIST_HEAD(irqchip_pm_list);
+
+void sbi_irqchip_add_pm(struct sbi_irqchip_pm *pm)
+{
+	if (pm)
+		sbi_list_add_tail(&pm->node, &irqchip_pm_list);
+}
+
+void sbi_irqchip_system_suspend(void)
+{
+	struct sbi_irqchip_pm *pm;
+
+	sbi_list_for_each_entry(pm, &irqchip_pm_list, node) {
+		if (pm->suspend)
+			pm->suspend(pm);
+	}
+}
+
+void sbi_irqchip_system_resume(void)
+{
+	struct sbi_irqchip_pm *pm;
+
+	sbi_list_for_each_entry(pm, &irqchip_pm_list, node) {
+		if (pm->resume)
+			pm->resume(pm);
+	}
+}
 
 static int default_irqfn(void)
 {
@@ -17,15 +115,19 @@ static int default_irqfn(void)
 
 static int (*ext_irqfn)(void) = default_irqfn;
 
+SBI_STATIC_CALL_DEFINE(ext_irqfn, default_irqfn);
+
 void sbi_irqchip_set_irqfn(int (*fn)(void))
 {
-	if (fn)
+	if (fn) {
 		ext_irqfn = fn;
+		sbi_static_call_update(ext_irqfn, fn);
+	}
 }
 
 int sbi_irqchip_process(void)
 {
-	return ext_irqfn();
+	return sbi_static_call(ext_irqfn)();
 }
 
 int sbi_irqchip_init(struct sbi_scratch *scratch, bool cold_boot)
@@ -0,0 +1,182 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_barrier.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_lockstat.h>
+#include <sbi/sbi_string.h>
+
+#define LOCKSTAT_SLOTS		CONFIG_SBI_LOCKSTAT_LOCKS
+
+#if LOCKSTAT_SLOTS & (LOCKSTAT_SLOTS - 1)
+#error "CONFIG_SBI_LOCKSTAT_LOCKS must be a power of 2"
+#endif
+
+extern struct sbi_lockstat __start_sbi_lockstats[]
+	__attribute__((visibility("hidden")));
+extern struct sbi_lockstat __stop_sbi_lockstats[]
+	__attribute__((visibility("hidden")));
+
+/** Lock to statistics mapping, open addressed by lock address */
+struct lockstat_slot {
+	spinlock_t *lock;
+	struct sbi_lockstat *stat;
+};
+
+static struct lockstat_slot lockstat_slots[LOCKSTAT_SLOTS];
+static unsigned long lockstat_dumped;
+
+static inline unsigned long lockstat_hash(spinlock_t *lock)
+{
+	return (((unsigned long)lock >> 2) * 0x9e3779b1UL) &
+	       (LOCKSTAT_SLOTS - 1);
+}
+
+void __sbi_lockstat_track(struct sbi_lockstat *stat, spinlock_t *lock)
+{
+	unsigned long i, n, h = lockstat_hash(lock);
+	spinlock_t *old;
+
+	for (n = 0; n < LOCKSTAT_SLOTS; n++) {
+		i = (h + n) & (LOCKSTAT_SLOTS - 1);
+		old = NULL;
+		if (__atomic_compare_exchange_n(&lockstat_slots[i].lock, &old,
+						lock, false, __ATOMIC_RELAXED,
+						__ATOMIC_RELAXED) ||
+		    old == lock) {
+			__smp_store_release(&lockstat_slots[i].stat, stat);
+			return;
+		}
+	}
+
+	/* The lock simply isn't accounted when the table is full */
+}
+
+void sbi_lockstat_acquired(spinlock_t *lock, bool contended, u64 cycles)
+{
+	unsigned long i, n, h = lockstat_hash(lock);
+	struct sbi_lockstat *stat = NULL;
+	spinlock_t *l;
+	u64 max;
+
+	for (n = 0; n < LOCKSTAT_SLOTS; n++) {
+		i = (h + n) & (LOCKSTAT_SLOTS - 1);
+		l = __atomic_load_n(&lockstat_slots[i].lock, __ATOMIC_RELAXED);
+		if (!l)
+			return;
+		if (l == lock) {
+			stat = __smp_load_acquire(&lockstat_slots[i].stat);
+			break;
+		}
+	}
+	if (!stat)
+		return;
+
+	__atomic_fetch_add(&stat->acquired, 1, __ATOMIC_RELAXED);
+	if (!contended)
+		return;
+
+	__atomic_fetch_add(&stat->contended, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&stat->spin_cycles, cycles, __ATOMIC_RELAXED);
+	max = __atomic_load_n(&stat->max_spin_cycles, __ATOMIC_RELAXED);
+	while (max < cycles &&
+	       !__atomic_compare_exchange_n(&stat->max_spin_cycles, &max,
+					    cycles, false, __ATOMIC_RELAXED,
+					    __ATOMIC_RELAXED))
+		;
+}
+
+static void lockstat_clear(struct sbi_lockstat *stat)
+{
+	__atomic_store_n(&stat->acquired, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&stat->contended, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&stat->spin_cycles, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&stat->max_spin_cycles, 0, __ATOMIC_RELAXED);
+}
+
+int sbi_lockstat_read(unsigned long addr_lo, unsigned long addr_hi,
+		      unsigned long size, unsigned long flags,
+		      unsigned long *out_count)
+{
+	struct sbi_lockstat_entry *dst, e;
+	struct sbi_lockstat *stat;
+	unsigned long count = 0, max;
+
+	if (flags & ~SBI_EXT_OPENSBI_LOCKSTAT_FLAG_CLEAR)
+		return SBI_EINVAL;
+
+	/* M-mode can only access shared memory below 4GB on RV32 */
+	if (addr_hi)
+		return SBI_EINVALID_ADDR;
+
+	if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(),
+					 addr_lo, size, PRV_S,
+					 SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_EINVALID_ADDR;
+
+	max = size / sizeof(*dst);
+	dst = (struct sbi_lockstat_entry *)addr_lo;
+
+	sbi_hart_map_saddr(addr_lo, size);
+	for (stat = __start_sbi_lockstats;
+	     stat < __stop_sbi_lockstats && count < max; stat++) {
+		sbi_memset(&e, 0, sizeof(e));
+		sbi_strncpy(e.name, stat->name, sizeof(e.name) - 1);
+		e.acquired = __atomic_load_n(&stat->acquired, __ATOMIC_RELAXED);
+		e.contended = __atomic_load_n(&stat->contended,
+					      __ATOMIC_RELAXED);
+		e.spin_cycles = __atomic_load_n(&stat->spin_cycles,
+						__ATOMIC_RELAXED);
+		e.max_spin_cycles = __atomic_load_n(&stat->max_spin_cycles,
+						    __ATOMIC_RELAXED);
+		if (flags & SBI_EXT_OPENSBI_LOCKSTAT_FLAG_CLEAR)
+			lockstat_clear(stat);
+
+		sbi_memcpy(&dst[count++], &e, sizeof(e));
+	}
+	sbi_hart_unmap_saddr();
+
+	*out_count = count;
+
+	return 0;
+}
+
+void sbi_lockstat_dump(void)
+{
+	struct sbi_lockstat *stat;
+
+	/* The statistics are global so only the first HART prints them */
+	if (__atomic_exchange_n(&lockstat_dumped, 1, __ATOMIC_RELAXED))
+		return;
+
+	sbi_printf("Lock statistics\n");
+	for (stat = __start_sbi_lockstats; stat < __stop_sbi_lockstats;
+	     stat++) {
+		if (!stat->acquired)
+			continue;
+
+		sbi_printf("  %-24s acquired=%lu contended=%lu "
+			   "spin_cycles=%lu max_spin_cycles=%lu\n",
+			   stat->name, stat->acquired, stat->contended,
+			   (ulong)stat->spin_cycles,
+			   (ulong)stat->max_spin_cycles);
+	}
+}
+
+int sbi_lockstat_init(void)
+{
+	struct sbi_lockstat *stat;
+
+	for (stat = __start_sbi_lockstats; stat < __stop_sbi_lockstats;
+	     stat++) {
+		if (stat->lock)
+			__sbi_lockstat_track(stat, stat->lock);
+	}
+
+	return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_heap.h>
+#include <sbi/sbi_misaligned_stats.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
+
+/** Per-HART table of the most frequent misaligned trap locations */
+struct misaligned_stats_hart {
+	struct sbi_misaligned_stats_entry entries[SBI_MISALIGNED_STATS_MAX_ENTRIES];
+};
+
+/** Offset of pointer to misaligned statistics in scratch space */
+static unsigned long misaligned_stats_ptr_offset;
+
+#define misaligned_stats_get_ptr(__scratch)				\
+	(misaligned_stats_ptr_offset ?					\
+	 sbi_scratch_read_type((__scratch), void *,			\
+			       misaligned_stats_ptr_offset) : NULL)
+
+/*
+ * Count the trap using the space-saving heavy hitter algorithm: a known
+ * mepc is simply counted, otherwise the least frequent entry is replaced
+ * and the new mepc inherits its count. Every mepc trapping more often
+ * than 1/SBI_MISALIGNED_STATS_MAX_ENTRIES of all traps stays in the table.
+ */
+void sbi_misaligned_stats_record(unsigned long mepc, u32 type)
+{
+	struct misaligned_stats_hart *ms;
+	struct sbi_misaligned_stats_entry *e, *min = NULL;
+	unsigned long i;
+
+	ms = misaligned_stats_get_ptr(sbi_scratch_thishart_ptr());
+	if (!ms)
+		return;
+
+	for (i = 0; i < SBI_MISALIGNED_STATS_MAX_ENTRIES; i++) {
+		e = &ms->entries[i];
+		if (e->count && e->mepc == mepc && e->type == type) {
+			e->count++;
+			return;
+		}
+		if (!min || e->count < min->count)
+			min = e;
+	}
+
+	min->mepc = mepc;
+	min->type = type;
+	min->count++;
+}
+
+int sbi_misaligned_stats_read(u32 hartid, unsigned long addr_lo,
+			      unsigned long addr_hi, unsigned long size,
+			      unsigned long flags, unsigned long *out_count)
+{
+	struct sbi_scratch *scratch = sbi_hartid_to_scratch(hartid);
+	struct sbi_misaligned_stats_entry *dst;
+	struct misaligned_stats_hart *ms;
+	unsigned long i, count = 0, max;
+
+	if (flags & ~SBI_EXT_OPENSBI_MISALIGNED_STATS_FLAG_CLEAR)
+		return SBI_EINVAL;
+
+	if (!scratch)
+		return SBI_EINVAL;
+
+	ms = misaligned_stats_get_ptr(scratch);
+	if (!ms)
+		return SBI_ENOTSUPP;
+
+	/* M-mode can only access shared memory below 4GB on RV32 */
+	if (addr_hi)
+		return SBI_EINVALID_ADDR;
+
+	if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(),
+					 addr_lo, size, PRV_S,
+					 SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_EINVALID_ADDR;
+
+	max = size / sizeof(*dst);
+	dst = (struct sbi_misaligned_stats_entry *)addr_lo;
+
+	sbi_hart_map_saddr(addr_lo, size);
+	for (i = 0; i < SBI_MISALIGNED_STATS_MAX_ENTRIES && count < max; i++) {
+		if (!ms->entries[i].count)
+			continue;
+		sbi_memcpy(&dst[count++], &ms->entries[i], sizeof(*dst));
+	}
+	sbi_hart_unmap_saddr();
+
+	if (flags & SBI_EXT_OPENSBI_MISALIGNED_STATS_FLAG_CLEAR)
+		sbi_memset(ms, 0, sizeof(*ms));
+
+	*out_count = count;
+
+	return 0;
+}
+
+void sbi_misaligned_stats_dump(struct sbi_scratch *scratch)
+{
+	struct misaligned_stats_hart *ms = misaligned_stats_get_ptr(scratch);
+	struct sbi_misaligned_stats_entry *e;
+	unsigned long i;
+
+	if (!ms)
+		return;
+
+	sbi_printf("HART%u misaligned trap statistics\n", current_hartid());
+	for (i = 0; i < SBI_MISALIGNED_STATS_MAX_ENTRIES; i++) {
+		e = &ms->entries[i];
+		if (!e->count)
+			continue;
+
+		sbi_printf("  %s mepc=0x%lx count=%lu\n",
+			   (e->type == SBI_MISALIGNED_STATS_TYPE_STORE) ?
+			   "store" : "load ",
+			   (ulong)e->mepc, (ulong)e->count);
+	}
+}
+
+int sbi_misaligned_stats_init(void)
+{
+	struct sbi_scratch *scratch;
+	struct misaligned_stats_hart *ms;
+	u32 i;
+
+	misaligned_stats_ptr_offset = sbi_scratch_alloc_type_offset(void *);
+	if (!misaligned_stats_ptr_offset)
+		return SBI_ENOMEM;
+
+	for (i = 0; i <= sbi_scratch_last_hartindex(); i++) {
+		scratch = sbi_hartindex_to_scratch(i);
+		if (!scratch)
+			continue;
+
+		ms = sbi_zalloc(sizeof(*ms));
+		if (!ms)
+			return SBI_ENOMEM;
+
+		sbi_scratch_write_type(scratch, void *,
+				       misaligned_stats_ptr_offset, ms);
+	}
+
+	return 0;
+}
@@ -0,0 +1,382 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * SBI nested acceleration (NACL) extension
+ *
+ * The HS-mode hypervisor keeps the H-extension CSRs it updates and the
+ * HFENCEs it needs in per-HART shared memory, they are applied in one go
+ * by the sync functions instead of one trap each.
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_nacl.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_tlb.h>
+#include <sbi/sbi_trap.h>
+
+/** Offset of the NACL shared memory address in scratch space */
+static unsigned long nacl_shmem_offset;
+
+#define NACL_SHMEM_DISABLED		(-1UL)
+
+#define nacl_shmem(__base, __off)					\
+	((unsigned long *)((__base) + (__off)))
+
+#define nacl_shmem_csr(__base, __csr)					\
+	nacl_shmem(__base, SBI_NACL_SHMEM_CSR_OFFSET +			\
+		   SBI_NACL_SHMEM_CSR_INDEX(__csr) * (__riscv_xlen / 8))
+
+/* Writable H-extension and VS-mode CSRs kept in the shared memory */
+#define NACL_CSR_LIST(__X)						\
+	__X(CSR_HSTATUS)						\
+	__X(CSR_HEDELEG)						\
+	__X(CSR_HIDELEG)						\
+	__X(CSR_HIE)							\
+	__X(CSR_HCOUNTEREN)						\
+	__X(CSR_HGEIE)							\
+	__X(CSR_HTIMEDELTA)						\
+	__X(CSR_HTVAL)							\
+	__X(CSR_HIP)							\
+	__X(CSR_HVIP)							\
+	__X(CSR_HTINST)							\
+	__X(CSR_HGATP)							\
+	__X(CSR_VSSTATUS)						\
+	__X(CSR_VSIE)							\
+	__X(CSR_VSTVEC)							\
+	__X(CSR_VSSCRATCH)						\
+	__X(CSR_VSEPC)							\
+	__X(CSR_VSCAUSE)						\
+	__X(CSR_VSTVAL)							\
+	__X(CSR_VSIP)							\
+	__X(CSR_VSATP)
+
+#define NACL_CSR_NUM(__csr)		__csr,
+
+static const unsigned short nacl_csrs[] = {
+	NACL_CSR_LIST(NACL_CSR_NUM)
+#if __riscv_xlen == 32
+	CSR_HTIMEDELTAH,
+#endif
+	CSR_HGEIP,
+	CSR_HENVCFG,
+#if __riscv_xlen == 32
+	CSR_HENVCFGH,
+#endif
+};
+
+#define NACL_CSR_CASE(__csr)						\
+	case __csr:							\
+		if (write)						\
+			csr_write(__csr, *val);				\
+		else							\
+			*val = csr_read(__csr);				\
+		return 0;
+
+static int nacl_csr_access(unsigned long csr, unsigned long *val, bool write)
+{
+	/* The HENVCFG CSRs only exist since privileged spec v1.12 */
+	if ((csr == CSR_HENVCFG || csr == CSR_HENVCFGH) &&
+	    sbi_hart_priv_version(sbi_scratch_thishart_ptr()) <
+	    SBI_HART_PRIV_VER_1_12)
+		return SBI_EINVAL;
+
+	switch (csr) {
+	NACL_CSR_LIST(NACL_CSR_CASE)
+#if __riscv_xlen == 32
+	NACL_CSR_CASE(CSR_HTIMEDELTAH)
+	NACL_CSR_CASE(CSR_HENVCFGH)
+#endif
+	NACL_CSR_CASE(CSR_HENVCFG)
+	case CSR_HGEIP:
+		/* Read-only, writes are dropped */
+		if (!write)
+			*val = csr_read(CSR_HGEIP);
+		return 0;
+	default:
+		return SBI_EINVAL;
+	}
+}
+
+/* Write the CSR if it is marked dirty and refresh the shared copy */
+static int nacl_sync_one_csr(unsigned long base, unsigned long csr)
+{
+	unsigned long idx = SBI_NACL_SHMEM_CSR_INDEX(csr);
+	unsigned long *dbitmap = nacl_shmem(base, SBI_NACL_SHMEM_DBITMAP_OFFSET);
+	unsigned long *word = &dbitmap[idx / BITS_PER_LONG];
+	unsigned long bit = 1UL << (idx % BITS_PER_LONG);
+	unsigned long *val = nacl_shmem_csr(base, csr);
+	int ret;
+
+	if (*word & bit) {
+		ret = nacl_csr_access(csr, val, true);
+		if (ret)
+			return ret;
+		*word &= ~bit;
+	}
+
+	return nacl_csr_access(csr, val, false);
+}
+
+static void nacl_sync_all_csrs(unsigned long base)
+{
+	unsigned long i;
+
+	for (i = 0; i < array_size(nacl_csrs); i++)
+		nacl_sync_one_csr(base, nacl_csrs[i]);
+}
+
+static void nacl_sync_one_hfence(unsigned long base, unsigned long index)
+{
+	unsigned long *e = nacl_shmem(base, SBI_NACL_SHMEM_HFENCE_OFFSET +
+				      index * SBI_NACL_SHMEM_HFENCE_ENTRY_SZ);
+	unsigned long config = e[0], order, vmid, asid, start, size;
+	struct sbi_tlb_info tinfo;
+	u32 hartid = current_hartid();
+
+	if (!(config & SBI_NACL_SHMEM_HFENCE_CONFIG_PEND))
+		return;
+
+	order = (config >> SBI_NACL_SHMEM_HFENCE_CONFIG_ORDER_SHIFT) &
+		SBI_NACL_SHMEM_HFENCE_CONFIG_ORDER_MASK;
+	order += SBI_NACL_SHMEM_HFENCE_ORDER_BASE;
+	vmid = (config >> SBI_NACL_SHMEM_HFENCE_CONFIG_VMID_SHIFT) &
+	       SBI_NACL_SHMEM_HFENCE_CONFIG_VMID_MASK;
+	asid = config & SBI_NACL_SHMEM_HFENCE_CONFIG_ASID_MASK;
+	start = e[1] << order;
+	size = e[2] << order;
+
+	switch ((config >> SBI_NACL_SHMEM_HFENCE_CONFIG_TYPE_SHIFT) &
+		SBI_NACL_SHMEM_HFENCE_CONFIG_TYPE_MASK) {
+	case SBI_NACL_SHMEM_HFENCE_TYPE_GVMA:
+		SBI_TLB_INFO_INIT(&tinfo, start, size, 0, 0,
+				  SBI_TLB_HFENCE_GVMA, hartid);
+		break;
+	case SBI_NACL_SHMEM_HFENCE_TYPE_GVMA_ALL:
+		SBI_TLB_INFO_INIT(&tinfo, 0, SBI_TLB_FLUSH_ALL, 0, 0,
+				  SBI_TLB_HFENCE_GVMA, hartid);
+		break;
+	case SBI_NACL_SHMEM_HFENCE_TYPE_GVMA_VMID:
+		SBI_TLB_INFO_INIT(&tinfo, start, size, 0, vmid,
+				  SBI_TLB_HFENCE_GVMA_VMID, hartid);
+		break;
+	case SBI_NACL_SHMEM_HFENCE_TYPE_GVMA_VMID_ALL:
+		SBI_TLB_INFO_INIT(&tinfo, 0, SBI_TLB_FLUSH_ALL, 0, vmid,
+				  SBI_TLB_HFENCE_GVMA_VMID, hartid);
+		break;
+	case SBI_NACL_SHMEM_HFENCE_TYPE_VVMA:
+		SBI_TLB_INFO_INIT(&tinfo, start, size, 0, vmid,
+				  SBI_TLB_HFENCE_VVMA, hartid);
+		break;
+	case SBI_NACL_SHMEM_HFENCE_TYPE_VVMA_ALL:
+		SBI_TLB_INFO_INIT(&tinfo, 0, SBI_TLB_FLUSH_ALL, 0, vmid,
+				  SBI_TLB_HFENCE_VVMA, hartid);
+		break;
+	case SBI_NACL_SHMEM_HFENCE_TYPE_VVMA_ASID:
+		SBI_TLB_INFO_INIT(&tinfo, start, size, asid, vmid,
+				  SBI_TLB_HFENCE_VVMA_ASID, hartid);
+		break;
+	case SBI_NACL_SHMEM_HFENCE_TYPE_VVMA_ASID_ALL:
+		SBI_TLB_INFO_INIT(&tinfo, 0, SBI_TLB_FLUSH_ALL, asid, vmid,
+				  SBI_TLB_HFENCE_VVMA_ASID, hartid);
+		break;
+	default:
+		/* Unknown types are dropped like reserved encodings */
+		e[0] = config & ~SBI_NACL_SHMEM_HFENCE_CONFIG_PEND;
+		return;
+	}
+
+	sbi_tlb_local_process(&tinfo);
+	e[0] = config & ~SBI_NACL_SHMEM_HFENCE_CONFIG_PEND;
+}
+
+static void nacl_sync_all_hfences(unsigned long base)
+{
+	unsigned long i;
+
+	for (i = 0; i < SBI_NACL_SHMEM_HFENCE_ENTRY_MAX; i++)
+		nacl_sync_one_hfence(base, i);
+}
+
+static unsigned long nacl_shmem_base(void)
+{
+	if (!nacl_shmem_offset)
+		return NACL_SHMEM_DISABLED;
+
+	return sbi_scratch_read_type(sbi_scratch_thishart_ptr(),
+				     unsigned long, nacl_shmem_offset);
+}
+
+int sbi_nacl_probe_feature(unsigned long feature, unsigned long *out_val)
+{
+	switch (feature) {
+	case SBI_NACL_FEAT_SYNC_CSR:
+	case SBI_NACL_FEAT_SYNC_HFENCE:
+	case SBI_NACL_FEAT_SYNC_SRET:
+	case SBI_NACL_FEAT_AUTOSWAP_CSR:
+		*out_val = 1;
+		break;
+	default:
+		*out_val = 0;
+		break;
+	}
+
+	return 0;
+}
+
+int sbi_nacl_set_shmem(unsigned long addr_lo, unsigned long addr_hi,
+		       unsigned long flags)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	if (!nacl_shmem_offset)
+		return SBI_ENOTSUPP;
+
+	if (flags)
+		return SBI_EINVAL;
+
+	if (addr_lo == NACL_SHMEM_DISABLED && addr_hi == NACL_SHMEM_DISABLED) {
+		sbi_scratch_write_type(scratch, unsigned long,
+				       nacl_shmem_offset, NACL_SHMEM_DISABLED);
+		return 0;
+	}
+
+	if (addr_lo & ((1UL << SBI_NACL_SHMEM_ADDR_SHIFT) - 1))
+		return SBI_EINVAL;
+
+	/* M-mode can only access shared memory below 4GB on RV32 */
+	if (addr_hi)
+		return SBI_EINVALID_ADDR;
+
+	if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(),
+					 addr_lo, SBI_NACL_SHMEM_SIZE, PRV_S,
+					 SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_EINVALID_ADDR;
+
+	sbi_scratch_write_type(scratch, unsigned long, nacl_shmem_offset,
+			       addr_lo);
+
+	return 0;
+}
+
+int sbi_nacl_sync_csr(unsigned long csr_num)
+{
+	unsigned long base = nacl_shmem_base();
+	int ret = 0;
+
+	if (base == NACL_SHMEM_DISABLED)
+		return SBI_ENO_SHMEM;
+
+	if (csr_num != -1UL && csr_num > 0xfff)
+		return SBI_EINVAL;
+
+	sbi_hart_map_saddr(base, SBI_NACL_SHMEM_SIZE);
+	if (csr_num == -1UL)
+		nacl_sync_all_csrs(base);
+	else
+		ret = nacl_sync_one_csr(base, csr_num);
+	sbi_hart_unmap_saddr();
+
+	return ret;
+}
+
+int sbi_nacl_sync_hfence(unsigned long entry_index)
+{
+	unsigned long base = nacl_shmem_base();
+
+	if (base == NACL_SHMEM_DISABLED)
+		return SBI_ENO_SHMEM;
+
+	if (entry_index != -1UL &&
+	    entry_index >= SBI_NACL_SHMEM_HFENCE_ENTRY_MAX)
+		return SBI_EINVAL;
+
+	sbi_hart_map_saddr(base, SBI_NACL_SHMEM_SIZE);
+	if (entry_index == -1UL)
+		nacl_sync_all_hfences(base);
+	else
+		nacl_sync_one_hfence(base, entry_index);
+	sbi_hart_unmap_saddr();
+
+	return 0;
+}
+
+int sbi_nacl_sync_sret(struct sbi_trap_regs *regs)
+{
+	unsigned long base = nacl_shmem_base();
+	unsigned long *gprs = (unsigned long *)regs;
+	unsigned long *autoswap, sstatus, hstatus, i;
+#if __riscv_xlen == 32
+	bool prev_virt = (regs->mstatusH & MSTATUSH_MPV) ? true : false;
+#else
+	bool prev_virt = (regs->mstatus & MSTATUS_MPV) ? true : false;
+#endif
+
+	if (base == NACL_SHMEM_DISABLED)
+		return SBI_ENO_SHMEM;
+
+	/* The SRET is emulated for an HS-mode caller only */
+	if (prev_virt ||
+	    ((regs->mstatus & MSTATUS_MPP) >> MSTATUS_MPP_SHIFT) != PRV_S)
+		return SBI_EDENIED;
+
+	sbi_hart_map_saddr(base, SBI_NACL_SHMEM_SIZE);
+
+	nacl_sync_all_csrs(base);
+	nacl_sync_all_hfences(base);
+
+	autoswap = nacl_shmem(base, SBI_NACL_SHMEM_AUTOSWAP_OFFSET);
+	if (*autoswap & SBI_NACL_SHMEM_AUTOSWAP_FLAG_HSTATUS) {
+		autoswap = nacl_shmem(base, SBI_NACL_SHMEM_AUTOSWAP_HSTATUS);
+		*autoswap = csr_swap(CSR_HSTATUS, *autoswap);
+	}
+
+	/* The trap registers are laid out as x0 to x31 */
+	for (i = 1; i <= SBI_NACL_SHMEM_SRET_X_LAST; i++)
+		gprs[i] = *nacl_shmem(base, SBI_NACL_SHMEM_SRET_OFFSET +
+				      SBI_NACL_SHMEM_SRET_X(i));
+
+	sbi_hart_unmap_saddr();
+
+	/* Emulate the SRET of the hypervisor */
+	sstatus = csr_read(CSR_SSTATUS);
+	hstatus = csr_read(CSR_HSTATUS);
+
+	regs->mepc = csr_read(CSR_SEPC);
+	regs->mstatus &= ~MSTATUS_MPP;
+	regs->mstatus |= ((sstatus & SSTATUS_SPP) ? PRV_S : PRV_U) <<
+			 MSTATUS_MPP_SHIFT;
+#if __riscv_xlen == 32
+	regs->mstatusH &= ~MSTATUSH_MPV;
+	regs->mstatusH |= (hstatus & HSTATUS_SPV) ? MSTATUSH_MPV : 0UL;
+#else
+	regs->mstatus &= ~MSTATUS_MPV;
+	regs->mstatus |= (hstatus & HSTATUS_SPV) ? MSTATUS_MPV : 0UL;
+#endif
+
+	sstatus &= ~(SSTATUS_SIE | SSTATUS_SPP);
+	sstatus |= (sstatus & SSTATUS_SPIE) ? SSTATUS_SIE : 0;
+	sstatus |= SSTATUS_SPIE;
+	csr_write(CSR_SSTATUS, sstatus);
+
+	return 0;
+}
+
+int sbi_nacl_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	if (cold_boot) {
+		nacl_shmem_offset = sbi_scratch_alloc_type_offset(unsigned long);
+		if (!nacl_shmem_offset)
+			return SBI_ENOMEM;
+	}
+
+	/* A HART starts without shared memory */
+	sbi_scratch_write_type(scratch, unsigned long, nacl_shmem_offset,
+			       NACL_SHMEM_DISABLED);
+
+	return 0;
+}
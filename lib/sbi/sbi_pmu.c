@@ -10,6 +10,7 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/sbi_bitops.h>
 #include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
 #include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_heap.h>
@@ -18,6 +19,7 @@
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_string.h>
 #include <sbi/sbi_sse.h>
+#include <sbi/sbi_timer.h>
 
 /** Information about hardware counters */
 struct sbi_pmu_hw_event {
@@ -55,24 +57,120 @@ union sbi_pmu_ctr_info {
 #error "Can't handle firmware counters beyond BITS_PER_LONG"
 #endif
 
-/** Per-HART state of the PMU counters */
+/** Number of entries of the per-HART hardware event lookup cache */
+#define PMU_HW_EVENT_CACHE_SIZE		8
+
+/** Cached result of a hardware event lookup */
+struct pmu_hw_event_cache {
+	unsigned long event_idx;
+	uint64_t data;
+	/* Counters which can monitor the event */
+	uint32_t counters;
+	/* Counter assigned to the event the last time */
+	uint32_t last_ctr;
+};
+
+#ifdef CONFIG_SBI_PMU_MUX
+/** Shared memory layout of one multiplexed event */
+struct pmu_mux_shmem_entry {
+	/* Event index and data as for counter_config_matching (input) */
+	uint64_t event_idx;
+	uint64_t event_data;
+	/* Count scaled to the time the group was enabled (output) */
+	uint64_t count;
+	/* Timer ticks for which the group was enabled (output) */
+	uint64_t time_enabled;
+	/* Timer ticks for which the event was on a counter (output) */
+	uint64_t time_running;
+};
+
+/** Multiplexed event of the firmware counter multiplexing group */
+struct pmu_mux_event {
+	unsigned long event_idx;
+	uint64_t event_data;
+	/* Counter of the event while it is scheduled or -1 */
+	int ctr;
+	/* Sum of the counter values over all scheduled periods */
+	uint64_t raw_count;
+	uint64_t time_running;
+};
+
+/** Per-HART state of firmware counter multiplexing */
+struct pmu_mux_state {
+	struct sbi_timer_event ev;
+	/* Physical address of the multiplexed events shared memory */
+	unsigned long shmem;
+	/* Rotation period in timer ticks */
+	u64 period;
+	/* Inhibit flags of the counter_config_matching call */
+	unsigned long flags;
+	/* Timer value of the last rotation */
+	u64 last_time;
+	u64 time_enabled;
+	/* Hardware counters reserved for multiplexing */
+	unsigned long counters;
+	/* Event scheduled first by the next rotation */
+	u32 next;
+	u32 count;
+	struct pmu_mux_event events[SBI_PMU_MUX_MAX_EVENTS];
+};
+
+/* Counters reserved for multiplexing are not valid for S-mode */
+#define PMU_MUX_RESERVED_EVENT_IDX	SBI_PMU_EVENT_IDX_TYPE_MASK
+#endif
+
+/** Size of the counter snapshot shared memory as per SBI specification */
+#define SBI_PMU_SNAPSHOT_SHMEM_SIZE	4096
+
+/** Layout of the counter snapshot shared memory */
+struct sbi_pmu_snapshot {
+	/* Overflow status of counters relative to the counter base */
+	uint64_t counter_overflow_bitmap;
+	/* Values of counters relative to the counter base */
+	uint64_t counter_values[64];
+};
+
+/**
+ * Per-HART state of the PMU counters
+ *
+ * The fields only used when configuring counters come first, the ones
+ * used on every counter access are kept together at the end. The counter
+ * to event mapping is sized by the number of counters found at boot.
+ */
 struct sbi_pmu_hart_state {
 	/* HART to which this state belongs */
 	uint32_t hartid;
-	/* Counter to enabled event mapping */
-	uint32_t active_events[SBI_PMU_HW_CTR_MAX + SBI_PMU_FW_CTR_MAX];
-	/* Bitmap of firmware counters started */
-	unsigned long fw_counters_started;
 	/* if true, SSE is enabled */
 	bool sse_enabled;
+	/* if true, counter snapshots are saved to shared memory */
+	bool snapshot_enabled;
+	/* Physical address of the counter snapshot shared memory */
+	unsigned long snapshot_addr;
+	/* Recent hardware event lookups */
+	struct pmu_hw_event_cache hw_event_cache[PMU_HW_EVENT_CACHE_SIZE];
+	/* Last mcyclecfg and minstretcfg values, restored on resume */
+	uint64_t fixed_ctr_cfg[2];
+#ifdef CONFIG_SBI_PMU_MUX
+	/* Firmware counter multiplexing group, if any */
+	struct pmu_mux_state *mux;
+#endif
+	/* Bitmap of firmware counters started */
+	unsigned long fw_counters_started;
+	/* Bitmap of started firmware counters for each SBI firmware event */
+	uint16_t fw_event_counters[SBI_PMU_FW_MAX];
 	/*
 	 * Counter values for SBI firmware events and event codes
 	 * for platform firmware events. Both are mutually exclusive
 	 * and hence can optimally share the same memory.
 	 */
 	uint64_t fw_counters_data[SBI_PMU_FW_CTR_MAX];
+	/* Counter to enabled event mapping, total_ctrs entries */
+	uint32_t active_events[];
 };
 
+SBI_HEAP_NEED(pmu, 0, sizeof(struct sbi_pmu_hart_state) +
+		      SBI_PMU_CTR_MAX * sizeof(uint32_t));
+
 /** Offset of pointer to PMU HART state in scratch space */
 static unsigned long phs_ptr_offset;
 
@@ -88,11 +186,17 @@ static unsigned long phs_ptr_offset;
 /* Platform specific PMU device */
 static const struct sbi_pmu_device *pmu_dev = NULL;
 
-/* Mapping between event range and possible counters  */
+/*
+ * Mapping between event range and possible counters. The ranged events
+ * come first sorted by event index followed by the raw events sorted by
+ * select mask and select value so that both can be binary searched.
+ */
 static struct sbi_pmu_hw_event *hw_event_map;
 
 /* Maximum number of hardware events available */
 static uint32_t num_hw_events;
+/* Number of ranged hardware events at the start of the event map */
+static uint32_t num_hw_range_events;
 /* Maximum number of hardware counters available */
 static uint32_t num_hw_ctrs;
 
@@ -121,6 +225,15 @@ static bool pmu_event_range_overlap(struct sbi_pmu_hw_event *evtA,
 	return true;
 }
 
+/* Check whether a firmware event code is standard, custom or platform */
+static inline bool pmu_fw_event_code_valid(uint32_t event_code)
+{
+	return event_code < SBI_PMU_FW_MAX ||
+	       (SBI_PMU_FW_CUSTOM_START <= event_code &&
+		event_code < SBI_PMU_FW_CUSTOM_MAX) ||
+	       event_code == SBI_PMU_FW_PLATFORM;
+}
+
 static bool pmu_event_select_overlap(struct sbi_pmu_hw_event *evt,
 				     uint64_t select_val, uint64_t select_mask)
 {
@@ -143,18 +256,17 @@ static int pmu_event_validate(struct sbi_pmu_hart_state *phs,
 		event_idx_code_max = SBI_PMU_HW_GENERAL_MAX;
 		break;
 	case SBI_PMU_EVENT_TYPE_FW:
-		if ((event_idx_code >= SBI_PMU_FW_MAX &&
-		    event_idx_code <= SBI_PMU_FW_RESERVED_MAX) ||
-		    event_idx_code > SBI_PMU_FW_PLATFORM)
+		if (!pmu_fw_event_code_valid(event_idx_code))
 			return SBI_EINVAL;
 
 		if (SBI_PMU_FW_PLATFORM == event_idx_code &&
 		    pmu_dev && pmu_dev->fw_event_validate_encoding)
 			return pmu_dev->fw_event_validate_encoding(phs->hartid,
 							           edata);
+		else if (SBI_PMU_FW_PLATFORM == event_idx_code)
+			return SBI_EINVAL;
 		else
-			event_idx_code_max = SBI_PMU_FW_MAX;
-		break;
+			return event_idx_type;
 	case SBI_PMU_EVENT_TYPE_HW_CACHE:
 		cache_ops_result = event_idx_code &
 					SBI_PMU_EVENT_HW_CACHE_OPS_RESULT;
@@ -217,9 +329,7 @@ int sbi_pmu_ctr_fw_read(uint32_t cidx, uint64_t *cval)
 	if (event_idx_type != SBI_PMU_EVENT_TYPE_FW)
 		return SBI_EINVAL;
 
-	if ((event_code >= SBI_PMU_FW_MAX &&
-	    event_code <= SBI_PMU_FW_RESERVED_MAX) ||
-	    event_code > SBI_PMU_FW_PLATFORM)
+	if (!pmu_fw_event_code_valid(event_code))
 		return SBI_EINVAL;
 
 	if (SBI_PMU_FW_PLATFORM == event_code) {
@@ -235,12 +345,82 @@ int sbi_pmu_ctr_fw_read(uint32_t cidx, uint64_t *cval)
 	return 0;
 }
 
+/* Position of the first ranged event which doesn't end before event_idx */
+static uint32_t pmu_hw_event_range_pos(uint32_t event_idx)
+{
+	uint32_t lo = 0, hi = num_hw_range_events, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (hw_event_map[mid].end_idx < event_idx)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* Position of the first raw event not below (select_mask, select) */
+static uint32_t pmu_hw_event_raw_pos(uint64_t select_mask, uint64_t select)
+{
+	uint32_t lo = num_hw_range_events, hi = num_hw_events, mid;
+	struct sbi_pmu_hw_event *evt;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		evt = &hw_event_map[mid];
+		if (evt->select_mask < select_mask ||
+		    (evt->select_mask == select_mask && evt->select < select))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* Get the counters which can monitor an event by searching the event map */
+static uint32_t pmu_hw_event_counters(unsigned long event_idx, uint64_t data)
+{
+	struct sbi_pmu_hw_event *evt;
+	uint32_t i, counters = 0;
+	uint64_t mask;
+
+	i = pmu_hw_event_range_pos(event_idx);
+	if (i < num_hw_range_events && hw_event_map[i].start_idx <= event_idx)
+		counters = hw_event_map[i].counters;
+
+	if (event_idx != SBI_PMU_EVENT_RAW_IDX)
+		return counters;
+
+	/*
+	 * For raw events, event data is used as the select value. The
+	 * non-event map bits of data should match the selector so look
+	 * up the data once for each distinct select mask.
+	 */
+	i = num_hw_range_events;
+	while (i < num_hw_events) {
+		mask = hw_event_map[i].select_mask;
+		i = pmu_hw_event_raw_pos(mask, data & mask);
+		evt = &hw_event_map[i];
+		if (i < num_hw_events && evt->select_mask == mask &&
+		    evt->select == (data & mask))
+			counters |= evt->counters;
+
+		if (mask == -1ULL)
+			break;
+		i = pmu_hw_event_raw_pos(mask + 1, 0);
+	}
+
+	return counters;
+}
+
 static int pmu_add_hw_event_map(u32 eidx_start, u32 eidx_end, u32 cmap,
 				uint64_t select, uint64_t select_mask)
 {
-	int i = 0;
-	bool is_overlap;
-	struct sbi_pmu_hw_event *event = &hw_event_map[num_hw_events];
+	uint32_t pos;
+	struct sbi_pmu_hw_event event = { 0 };
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 	uint32_t ctr_avail_mask = sbi_hart_mhpm_mask(scratch) | 0x7;
 
@@ -254,33 +434,43 @@ static int pmu_add_hw_event_map(u32 eidx_start, u32 eidx_end, u32 cmap,
 		return SBI_EFAIL;
 	}
 
-	event->start_idx = eidx_start;
-	event->end_idx = eidx_end;
+	event.start_idx = eidx_start;
+	event.end_idx = eidx_end;
+	event.select_mask = select_mask;
+	/* Map the only the counters that are available in the hardware */
+	event.counters = cmap & ctr_avail_mask;
+	event.select = select;
 
-	/* Sanity check */
-	for (i = 0; i < num_hw_events; i++) {
-		if (eidx_start == SBI_PMU_EVENT_RAW_IDX)
-		/* All raw events have same event idx. Just do sanity check on select */
-			is_overlap = pmu_event_select_overlap(&hw_event_map[i],
-							      select, select_mask);
-		else
-			is_overlap = pmu_event_range_overlap(&hw_event_map[i], event);
-		if (is_overlap)
-			goto reset_event;
+	/*
+	 * Keep the event map sorted for the lookups. The entries of the
+	 * sorted map don't overlap so only the entry at the insertion
+	 * position can overlap with the new one.
+	 */
+	if (eidx_start == SBI_PMU_EVENT_RAW_IDX) {
+		/* All raw events have same event idx, only check the select */
+		pos = pmu_hw_event_raw_pos(select_mask, select);
+		if (pos < num_hw_events &&
+		    pmu_event_select_overlap(&hw_event_map[pos],
+					     select, select_mask))
+			return SBI_EINVAL;
+	} else {
+		pos = pmu_hw_event_range_pos(eidx_start);
+		if (pos < num_hw_range_events &&
+		    pmu_event_range_overlap(&hw_event_map[pos], &event))
+			return SBI_EINVAL;
+		/* A range can't cover the index of the raw events either */
+		if (num_hw_range_events < num_hw_events &&
+		    eidx_start <= SBI_PMU_EVENT_RAW_IDX &&
+		    SBI_PMU_EVENT_RAW_IDX <= eidx_end)
+			return SBI_EINVAL;
+		num_hw_range_events++;
 	}
-
-	event->select_mask = select_mask;
-	/* Map the only the counters that are available in the hardware */
-	event->counters = cmap & ctr_avail_mask;
-	event->select = select;
+	sbi_memmove(&hw_event_map[pos + 1], &hw_event_map[pos],
+		    sizeof(*hw_event_map) * (num_hw_events - pos));
+	hw_event_map[pos] = event;
 	num_hw_events++;
 
 	return 0;
-
-reset_event:
-	event->start_idx = 0;
-	event->end_idx = 0;
-	return SBI_EINVAL;
 }
 
 /**
@@ -303,13 +493,23 @@ int sbi_pmu_add_raw_event_counter_map(uint64_t select, uint64_t select_mask, u32
 				    SBI_PMU_EVENT_RAW_IDX, cmap, select, select_mask);
 }
 
+/* Interrupt enable bit of the counter overflow interrupt */
+static unsigned long pmu_ovf_irq_mask(void)
+{
+	int irq_bit = sbi_pmu_irq_bit();
+
+	return irq_bit ? irq_bit : MIP_LCOFIP;
+}
+
 void sbi_pmu_ovf_irq()
 {
 	/*
-	 * We need to disable LCOFIP before returning to S-mode or we will loop
-	 * on LCOFIP being triggered
+	 * All counters which have overflowed are reported to S-mode by
+	 * a single event. We need to disable the overflow interrupt before
+	 * returning to S-mode or we will loop on it being triggered until
+	 * S-mode has handled the overflowed counters.
 	 */
-	csr_clear(CSR_MIE, MIP_LCOFIP);
+	csr_clear(CSR_MIE, pmu_ovf_irq_mask());
 	sbi_sse_inject_event(SBI_SSE_EVENT_LOCAL_PMU);
 }
 
@@ -360,10 +560,46 @@ static void pmu_ctr_write_hw(uint32_t cidx, uint64_t ival)
 #endif
 }
 
-static int pmu_ctr_start_hw(uint32_t cidx, uint64_t ival, bool ival_update)
+static uint64_t pmu_ctr_read_hw(uint32_t cidx)
+{
+#if __riscv_xlen == 32
+	uint32_t lo, hi;
+
+	do {
+		hi = csr_read_num(CSR_MCYCLEH + cidx);
+		lo = csr_read_num(CSR_MCYCLE + cidx);
+	} while (hi != csr_read_num(CSR_MCYCLEH + cidx));
+
+	return ((uint64_t)hi << 32) | lo;
+#else
+	return csr_read_num(CSR_MCYCLE + cidx);
+#endif
+}
+
+/* Read the overflow status of all hardware counters at once */
+static unsigned long pmu_ctr_overflow_status_hw(void)
+{
+	if (pmu_dev && pmu_dev->hw_counter_overflow_status)
+		return pmu_dev->hw_counter_overflow_status();
+
+	/* The scountovf CSR shadows the OF bits of all mhpmevent CSRs */
+	if (sbi_hart_has_extension(sbi_scratch_thishart_ptr(),
+				   SBI_HART_EXT_SSCOFPMF))
+		return csr_read(CSR_SCOUNTOVF);
+
+	return 0;
+}
+
+/*
+ * Prepare a hardware counter for starting. The counter is not started
+ * here, instead its bit is added to start_mask so that the caller can
+ * start all prepared counters with a single mcountinhibit update.
+ */
+static int pmu_ctr_start_hw_prep(uint32_t cidx, uint64_t ival,
+				 bool ival_update, unsigned long mctr_inhbt,
+				 unsigned long *start_mask)
 {
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
-	unsigned long mctr_inhbt;
 
 	/* Make sure the counter index lies within the range and is not TM bit */
 	if (cidx >= num_hw_ctrs || cidx == 1)
@@ -379,12 +615,9 @@ static int pmu_ctr_start_hw(uint32_t cidx, uint64_t ival, bool ival_update)
 	 * Some of the hardware may not support mcountinhibit but perf stat
 	 * still can work if supervisor mode programs the initial value.
 	 */
-	mctr_inhbt = csr_read(CSR_MCOUNTINHIBIT);
-	if (!__test_bit(cidx, &mctr_inhbt))
+	if (!__test_bit(cidx, &mctr_inhbt) || (*start_mask & BIT(cidx)))
 		return SBI_EALREADY_STARTED;
 
-	__clear_bit(cidx, &mctr_inhbt);
-
 	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SSCOFPMF))
 		pmu_ctr_enable_irq_hw(cidx);
 	if (ival_update)
@@ -392,11 +625,34 @@ static int pmu_ctr_start_hw(uint32_t cidx, uint64_t ival, bool ival_update)
 	if (pmu_dev && pmu_dev->hw_counter_enable_irq)
 		pmu_dev->hw_counter_enable_irq(cidx);
 
-	csr_write(CSR_MCOUNTINHIBIT, mctr_inhbt);
+	*start_mask |= BIT(cidx);
 
 	return 0;
 }
 
+/* Get mcountinhibit or zero if it is not implemented */
+static unsigned long pmu_read_mcountinhibit(void)
+{
+	if (sbi_hart_priv_version(sbi_scratch_thishart_ptr()) <
+	    SBI_HART_PRIV_VER_1_11)
+		return 0;
+
+	return csr_read(CSR_MCOUNTINHIBIT);
+}
+
+static int pmu_ctr_start_hw(uint32_t cidx, uint64_t ival, bool ival_update)
+{
+	unsigned long start_mask = 0;
+	int ret;
+
+	ret = pmu_ctr_start_hw_prep(cidx, ival, ival_update,
+				    pmu_read_mcountinhibit(), &start_mask);
+	if (start_mask)
+		csr_clear(CSR_MCOUNTINHIBIT, start_mask);
+
+	return ret;
+}
+
 int sbi_pmu_irq_bit(void)
 {
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
@@ -409,14 +665,32 @@ int sbi_pmu_irq_bit(void)
 	return 0;
 }
 
+/*
+ * Rebuild the firmware event to started counter bitmaps. This is done
+ * whenever a firmware counter is started or stopped so that counting
+ * a firmware event does not have to scan all firmware counters.
+ */
+static void pmu_fw_event_counters_update(struct sbi_pmu_hart_state *phs)
+{
+	uint32_t i, event_code;
+
+	sbi_memset(phs->fw_event_counters, 0, sizeof(phs->fw_event_counters));
+	for (i = 0; i < SBI_PMU_FW_CTR_MAX; i++) {
+		if (!(phs->fw_counters_started & BIT(i)))
+			continue;
+
+		event_code = get_cidx_code(phs->active_events[num_hw_ctrs + i]);
+		if (event_code < SBI_PMU_FW_MAX)
+			phs->fw_event_counters[event_code] |= BIT(i);
+	}
+}
+
 static int pmu_ctr_start_fw(struct sbi_pmu_hart_state *phs,
 			    uint32_t cidx, uint32_t event_code,
 			    uint64_t event_data, uint64_t ival,
 			    bool ival_update)
 {
-	if ((event_code >= SBI_PMU_FW_MAX &&
-	    event_code <= SBI_PMU_FW_RESERVED_MAX) ||
-	    event_code > SBI_PMU_FW_PLATFORM)
+	if (!pmu_fw_event_code_valid(event_code))
 		return SBI_EINVAL;
 
 	if (SBI_PMU_FW_PLATFORM == event_code) {
@@ -440,6 +714,7 @@ static int pmu_ctr_start_fw(struct sbi_pmu_hart_state *phs,
 	}
 
 	phs->fw_counters_started |= BIT(cidx - num_hw_ctrs);
+	pmu_fw_event_counters_update(phs);
 
 	return 0;
 }
@@ -458,23 +733,35 @@ int sbi_pmu_ctr_start(unsigned long cbase, unsigned long cmask,
 	bool bUpdate = false;
 	int i, cidx;
 	uint64_t edata;
+	struct sbi_pmu_snapshot *snapshot = NULL;
+	unsigned long mctr_inhbt, start_mask = 0;
 
 	if ((cbase + sbi_fls(cmask)) >= total_ctrs)
 		return ret;
 
-	if (flags & SBI_PMU_STOP_FLAG_TAKE_SNAPSHOT)
-		return SBI_ENO_SHMEM;
+	if (flags & SBI_PMU_START_FLAG_INIT_FROM_SNAPSHOT) {
+		if (!phs->snapshot_enabled)
+			return SBI_ENO_SHMEM;
+		snapshot = (struct sbi_pmu_snapshot *)phs->snapshot_addr;
+		sbi_hart_map_saddr(phs->snapshot_addr, sizeof(*snapshot));
+		bUpdate = true;
+	}
 
 	if (flags & SBI_PMU_START_FLAG_SET_INIT_VALUE)
 		bUpdate = true;
 
+	mctr_inhbt = pmu_read_mcountinhibit();
 	for_each_set_bit(i, &cmask, BITS_PER_LONG) {
 		cidx = i + cbase;
 		event_idx_type = pmu_ctr_validate(phs, cidx, &event_code);
 		if (event_idx_type < 0)
 			/* Continue the start operation for other counters */
 			continue;
-		else if (event_idx_type == SBI_PMU_EVENT_TYPE_FW) {
+
+		if (snapshot)
+			ival = snapshot->counter_values[i];
+
+		if (event_idx_type == SBI_PMU_EVENT_TYPE_FW) {
 			edata = (event_code == SBI_PMU_FW_PLATFORM) ?
 				 phs->fw_counters_data[cidx - num_hw_ctrs]
 				 : 0x0;
@@ -482,35 +769,57 @@ int sbi_pmu_ctr_start(unsigned long cbase, unsigned long cmask,
 					       ival, bUpdate);
 		}
 		else
-			ret = pmu_ctr_start_hw(cidx, ival, bUpdate);
+			ret = pmu_ctr_start_hw_prep(cidx, ival, bUpdate,
+						    mctr_inhbt, &start_mask);
 	}
 
+	/* Start all hardware counters together */
+	if (start_mask)
+		csr_clear(CSR_MCOUNTINHIBIT, start_mask);
+
+	if (snapshot)
+		sbi_hart_unmap_saddr();
+
 	return ret;
 }
 
-static int pmu_ctr_stop_hw(uint32_t cidx)
+/*
+ * Prepare a hardware counter for stopping by adding its bit to stop_mask
+ * so that the caller can stop all counters with a single mcountinhibit
+ * update before calling pmu_ctr_stop_hw_done().
+ */
+static int pmu_ctr_stop_hw_prep(uint32_t cidx, unsigned long mctr_inhbt,
+				unsigned long *stop_mask)
 {
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
-	unsigned long mctr_inhbt;
 
 	if (sbi_hart_priv_version(scratch) < SBI_HART_PRIV_VER_1_11)
 		return 0;
 
-	mctr_inhbt = csr_read(CSR_MCOUNTINHIBIT);
-
 	/* Make sure the counter index lies within the range and is not TM bit */
 	if (cidx >= num_hw_ctrs || cidx == 1)
 		return SBI_EINVAL;
 
-	if (!__test_bit(cidx, &mctr_inhbt)) {
-		__set_bit(cidx, &mctr_inhbt);
-		csr_write(CSR_MCOUNTINHIBIT, mctr_inhbt);
-		if (pmu_dev && pmu_dev->hw_counter_disable_irq) {
-			pmu_dev->hw_counter_disable_irq(cidx);
-		}
-		return 0;
-	} else
+	if (__test_bit(cidx, &mctr_inhbt) || (*stop_mask & BIT(cidx)))
 		return SBI_EALREADY_STOPPED;
+
+	*stop_mask |= BIT(cidx);
+
+	return 0;
+}
+
+static void pmu_ctr_stop_hw_done(unsigned long stop_mask)
+{
+	int i;
+
+	if (!stop_mask)
+		return;
+
+	csr_set(CSR_MCOUNTINHIBIT, stop_mask);
+	if (pmu_dev && pmu_dev->hw_counter_disable_irq) {
+		for_each_set_bit(i, &stop_mask, SBI_PMU_HW_CTR_MAX)
+			pmu_dev->hw_counter_disable_irq(i);
+	}
 }
 
 static int pmu_ctr_stop_fw(struct sbi_pmu_hart_state *phs,
@@ -518,9 +827,7 @@ static int pmu_ctr_stop_fw(struct sbi_pmu_hart_state *phs,
 {
 	int ret;
 
-	if ((event_code >= SBI_PMU_FW_MAX &&
-	    event_code <= SBI_PMU_FW_RESERVED_MAX) ||
-	    event_code > SBI_PMU_FW_PLATFORM)
+	if (!pmu_fw_event_code_valid(event_code))
 		return SBI_EINVAL;
 
 	if (SBI_PMU_FW_PLATFORM == event_code &&
@@ -531,6 +838,7 @@ static int pmu_ctr_stop_fw(struct sbi_pmu_hart_state *phs,
 	}
 
 	phs->fw_counters_started &= ~BIT(cidx - num_hw_ctrs);
+	pmu_fw_event_counters_update(phs);
 
 	return 0;
 }
@@ -563,13 +871,21 @@ int sbi_pmu_ctr_stop(unsigned long cbase, unsigned long cmask,
 	int event_idx_type;
 	uint32_t event_code;
 	int i, cidx;
+	struct sbi_pmu_snapshot *snapshot = NULL;
+	unsigned long mctr_inhbt, stop_mask = 0, ovf = 0;
 
 	if ((cbase + sbi_fls(cmask)) >= total_ctrs)
 		return SBI_EINVAL;
 
-	if (flag & SBI_PMU_STOP_FLAG_TAKE_SNAPSHOT)
-		return SBI_ENO_SHMEM;
+	if (flag & SBI_PMU_STOP_FLAG_TAKE_SNAPSHOT) {
+		if (!phs->snapshot_enabled)
+			return SBI_ENO_SHMEM;
+		snapshot = (struct sbi_pmu_snapshot *)phs->snapshot_addr;
+		sbi_hart_map_saddr(phs->snapshot_addr, sizeof(*snapshot));
+		snapshot->counter_overflow_bitmap = 0;
+	}
 
+	mctr_inhbt = pmu_read_mcountinhibit();
 	for_each_set_bit(i, &cmask, BITS_PER_LONG) {
 		cidx = i + cbase;
 		event_idx_type = pmu_ctr_validate(phs, cidx, &event_code);
@@ -580,7 +896,33 @@ int sbi_pmu_ctr_stop(unsigned long cbase, unsigned long cmask,
 		else if (event_idx_type == SBI_PMU_EVENT_TYPE_FW)
 			ret = pmu_ctr_stop_fw(phs, cidx, event_code);
 		else
-			ret = pmu_ctr_stop_hw(cidx);
+			ret = pmu_ctr_stop_hw_prep(cidx, mctr_inhbt, &stop_mask);
+	}
+
+	/* Stop all hardware counters together before reading them */
+	pmu_ctr_stop_hw_done(stop_mask);
+
+	if (snapshot)
+		ovf = pmu_ctr_overflow_status_hw();
+
+	for_each_set_bit(i, &cmask, BITS_PER_LONG) {
+		cidx = i + cbase;
+		event_idx_type = pmu_ctr_validate(phs, cidx, &event_code);
+		if (event_idx_type < 0)
+			continue;
+
+		if (snapshot) {
+			if (event_idx_type == SBI_PMU_EVENT_TYPE_FW) {
+				sbi_pmu_ctr_fw_read(cidx,
+						&snapshot->counter_values[i]);
+			} else {
+				snapshot->counter_values[i] =
+						pmu_ctr_read_hw(cidx);
+				if (cidx < num_hw_ctrs && (ovf & BIT(cidx)))
+					snapshot->counter_overflow_bitmap |=
+								(1ULL << i);
+			}
+		}
 
 		if (cidx > (CSR_INSTRET - CSR_CYCLE) && flag & SBI_PMU_STOP_FLAG_RESET) {
 			phs->active_events[cidx] = SBI_PMU_EVENT_IDX_INVALID;
@@ -588,6 +930,9 @@ int sbi_pmu_ctr_stop(unsigned long cbase, unsigned long cmask,
 		}
 	}
 
+	if (snapshot)
+		sbi_hart_unmap_saddr();
+
 	/* Clear MIP_LCOFIP to avoid spurious interrupts */
 	if (phs->sse_enabled)
 		csr_clear(CSR_MIP, MIP_LCOFIP);
@@ -595,6 +940,47 @@ int sbi_pmu_ctr_stop(unsigned long cbase, unsigned long cmask,
 	return ret;
 }
 
+int sbi_pmu_snapshot_set_shmem(unsigned long shmem_lo,
+			       unsigned long shmem_hi, unsigned long flags)
+{
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
+
+	if (unlikely(!phs))
+		return SBI_EINVAL;
+
+	if (flags)
+		return SBI_EINVAL;
+
+	if (shmem_lo == SBI_PMU_SNAPSHOT_DISABLE &&
+	    shmem_hi == SBI_PMU_SNAPSHOT_DISABLE) {
+		phs->snapshot_enabled = false;
+		phs->snapshot_addr = 0;
+		return 0;
+	}
+
+	if (shmem_lo & (SBI_PMU_SNAPSHOT_SHMEM_SIZE - 1))
+		return SBI_EINVAL;
+
+	/* M-mode can only access shared memory below 4GB on RV32 */
+	if (shmem_hi)
+		return SBI_EINVALID_ADDR;
+
+	if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(),
+					 shmem_lo, SBI_PMU_SNAPSHOT_SHMEM_SIZE,
+					 PRV_S,
+					 SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_EINVALID_ADDR;
+
+	sbi_hart_map_saddr(shmem_lo, sizeof(struct sbi_pmu_snapshot));
+	sbi_memset((void *)shmem_lo, 0, sizeof(struct sbi_pmu_snapshot));
+	sbi_hart_unmap_saddr();
+
+	phs->snapshot_addr = shmem_lo;
+	phs->snapshot_enabled = true;
+
+	return 0;
+}
+
 static void pmu_update_inhibit_flags(unsigned long flags, uint64_t *mhpmevent_val)
 {
 	if (flags & SBI_PMU_CFG_FLAG_SET_VUINH)
@@ -607,9 +993,8 @@ static void pmu_update_inhibit_flags(unsigned long flags, uint64_t *mhpmevent_va
 		*mhpmevent_val |= MHPMEVENT_SINH;
 }
 
-static int pmu_update_hw_mhpmevent(struct sbi_pmu_hw_event *hw_evt, int ctr_idx,
-				   unsigned long flags, unsigned long eindex,
-				   uint64_t data)
+static int pmu_update_hw_mhpmevent(int ctr_idx, unsigned long flags,
+				   unsigned long eindex, uint64_t data)
 {
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
@@ -638,55 +1023,59 @@ static int pmu_update_hw_mhpmevent(struct sbi_pmu_hw_event *hw_evt, int ctr_idx,
 	if (pmu_dev && pmu_dev->hw_counter_filter_mode)
 		pmu_dev->hw_counter_filter_mode(flags, ctr_idx);
 
+	/* Skip the write when the counter is already set up for the event */
 #if __riscv_xlen == 32
-	csr_write_num(CSR_MHPMEVENT3 + ctr_idx - 3, mhpmevent_val & 0xFFFFFFFF);
-	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SSCOFPMF))
+	if (csr_read_num(CSR_MHPMEVENT3 + ctr_idx - 3) !=
+	    (mhpmevent_val & 0xFFFFFFFF))
+		csr_write_num(CSR_MHPMEVENT3 + ctr_idx - 3,
+			      mhpmevent_val & 0xFFFFFFFF);
+	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SSCOFPMF) &&
+	    csr_read_num(CSR_MHPMEVENT3H + ctr_idx - 3) !=
+	    (mhpmevent_val >> BITS_PER_LONG))
 		csr_write_num(CSR_MHPMEVENT3H + ctr_idx - 3,
 			      mhpmevent_val >> BITS_PER_LONG);
 #else
-	csr_write_num(CSR_MHPMEVENT3 + ctr_idx - 3, mhpmevent_val);
+	if (csr_read_num(CSR_MHPMEVENT3 + ctr_idx - 3) != mhpmevent_val)
+		csr_write_num(CSR_MHPMEVENT3 + ctr_idx - 3, mhpmevent_val);
 #endif
 
 	return 0;
 }
 
-static int pmu_fixed_ctr_update_inhibit_bits(int fixed_ctr, unsigned long flags)
+/* Write mcyclecfg (fixed_ctr 0) or minstretcfg (fixed_ctr 2) */
+static void pmu_fixed_ctr_write_cfg(struct sbi_pmu_hart_state *phs,
+				    int fixed_ctr, uint64_t cfg_val)
 {
-	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
-	uint64_t cfg_val = 0, cfg_csr_no;
+	int cfg_csr_no = fixed_ctr ? CSR_MINSTRETCFG : CSR_MCYCLECFG;
+
 #if __riscv_xlen == 32
-	uint64_t cfgh_csr_no;
+	csr_write_num(cfg_csr_no, cfg_val & 0xFFFFFFFF);
+	csr_write_num(fixed_ctr ? CSR_MINSTRETCFGH : CSR_MCYCLECFGH,
+		      cfg_val >> BITS_PER_LONG);
+#else
+	csr_write_num(cfg_csr_no, cfg_val);
 #endif
+	phs->fixed_ctr_cfg[fixed_ctr / 2] = cfg_val;
+}
+
+static int pmu_fixed_ctr_update_inhibit_bits(int fixed_ctr, unsigned long flags)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	uint64_t cfg_val = 0;
+
 	if (!sbi_hart_has_extension(scratch, SBI_HART_EXT_SMCNTRPMF) &&
 		!(pmu_dev && pmu_dev->hw_counter_filter_mode))
 		return fixed_ctr;
 
-	switch (fixed_ctr) {
-	case 0:
-		cfg_csr_no = CSR_MCYCLECFG;
-#if __riscv_xlen == 32
-		cfgh_csr_no = CSR_MCYCLECFGH;
-#endif
-		break;
-	case 2:
-		cfg_csr_no = CSR_MINSTRETCFG;
-#if __riscv_xlen == 32
-		cfgh_csr_no = CSR_MINSTRETCFGH;
-#endif
-		break;
-	default:
+	if (fixed_ctr != 0 && fixed_ctr != 2)
 		return SBI_EFAIL;
-	}
 
+	/* Firmware time is never counted, like for the programmable counters */
 	cfg_val |= MHPMEVENT_MINH;
 	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SMCNTRPMF)) {
 		pmu_update_inhibit_flags(flags, &cfg_val);
-#if __riscv_xlen == 32
-		csr_write_num(cfg_csr_no, cfg_val & 0xFFFFFFFF);
-		csr_write_num(cfgh_csr_no, cfg_val >> BITS_PER_LONG);
-#else
-		csr_write_num(cfg_csr_no, cfg_val);
-#endif
+		pmu_fixed_ctr_write_cfg(pmu_get_hart_state_ptr(scratch),
+					fixed_ctr, cfg_val);
 	}
 	if (pmu_dev && pmu_dev->hw_counter_filter_mode)
 		pmu_dev->hw_counter_filter_mode(flags, fixed_ctr);
@@ -704,14 +1093,35 @@ static int pmu_ctr_find_fixed_hw(unsigned long evt_idx_code)
 		return SBI_EINVAL;
 }
 
+static struct pmu_hw_event_cache *pmu_hw_event_lookup(
+					struct sbi_pmu_hart_state *phs,
+					unsigned long event_idx, uint64_t data)
+{
+	struct pmu_hw_event_cache *c;
+	unsigned long idx;
+
+	idx = ((u32)(event_idx ^ data ^ (data >> 32)) * 0x9E3779B1U) %
+	      PMU_HW_EVENT_CACHE_SIZE;
+	c = &phs->hw_event_cache[idx];
+	if (c->event_idx == event_idx && c->data == data)
+		return c;
+
+	c->event_idx = event_idx;
+	c->data = data;
+	c->counters = pmu_hw_event_counters(event_idx, data);
+	c->last_ctr = 0;
+
+	return c;
+}
+
 static int pmu_ctr_find_hw(struct sbi_pmu_hart_state *phs,
 			   unsigned long cbase, unsigned long cmask,
 			   unsigned long flags,
 			   unsigned long event_idx, uint64_t data)
 {
 	unsigned long ctr_mask;
-	int i, ret = 0, fixed_ctr, ctr_idx = SBI_ENOTSUPP;
-	struct sbi_pmu_hw_event *temp;
+	int ret = 0, fixed_ctr, ctr_idx = SBI_ENOTSUPP;
+	struct pmu_hw_event_cache *c;
 	unsigned long mctr_inhbt = 0;
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 
@@ -729,37 +1139,31 @@ static int pmu_ctr_find_hw(struct sbi_pmu_hart_state *phs,
 
 	if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_11)
 		mctr_inhbt = csr_read(CSR_MCOUNTINHIBIT);
-	for (i = 0; i < num_hw_events; i++) {
-		temp = &hw_event_map[i];
-		if ((temp->start_idx > event_idx && event_idx < temp->end_idx) ||
-		    (temp->start_idx < event_idx && event_idx > temp->end_idx))
-			continue;
 
-		/* For raw events, event data is used as the select value */
-		if (event_idx == SBI_PMU_EVENT_RAW_IDX) {
-			uint64_t select_mask = temp->select_mask;
+	c = pmu_hw_event_lookup(phs, event_idx, data);
 
-			/* The non-event map bits of data should match the selector */
-			if (temp->select != (data & select_mask))
-				continue;
-		}
-		/* Fixed counters should not be part of the search */
-		ctr_mask = temp->counters & (cmask << cbase) &
-			   (~SBI_PMU_FIXED_CTR_MASK);
-		for_each_set_bit_from(cbase, &ctr_mask, SBI_PMU_HW_CTR_MAX) {
-			/**
-			 * Some of the platform may not support mcountinhibit.
-			 * Checking the active_events is enough for them
-			 */
-			if (phs->active_events[cbase] != SBI_PMU_EVENT_IDX_INVALID)
-				continue;
-			/* If mcountinhibit is supported, the bit must be enabled */
-			if ((sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_11) &&
-			    !__test_bit(cbase, &mctr_inhbt))
-				continue;
-			/* We found a valid counter that is not started yet */
-			ctr_idx = cbase;
-		}
+	/*
+	 * Fixed counters should not be part of the search and neither
+	 * should the counters delegated to S-mode.
+	 */
+	ctr_mask = c->counters & (cmask << cbase) & (~SBI_PMU_FIXED_CTR_MASK);
+	ctr_mask &= ~(unsigned long)sbi_hart_mhpm_deleg_mask(scratch);
+	for_each_set_bit_from(cbase, &ctr_mask, SBI_PMU_HW_CTR_MAX) {
+		/**
+		 * Some of the platform may not support mcountinhibit.
+		 * Checking the active_events is enough for them
+		 */
+		if (phs->active_events[cbase] != SBI_PMU_EVENT_IDX_INVALID)
+			continue;
+		/* If mcountinhibit is supported, the bit must be enabled */
+		if ((sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_11) &&
+		    !__test_bit(cbase, &mctr_inhbt))
+			continue;
+		/* We found a valid counter that is not started yet */
+		ctr_idx = cbase;
+		/* Prefer the counter which was used for the event before */
+		if (cbase == c->last_ctr)
+			break;
 	}
 
 	if (ctr_idx == SBI_ENOTSUPP) {
@@ -772,15 +1176,266 @@ static int pmu_ctr_find_hw(struct sbi_pmu_hart_state *phs,
 		else
 			return SBI_EFAIL;
 	}
-	ret = pmu_update_hw_mhpmevent(temp, ctr_idx, flags, event_idx, data);
+	ret = pmu_update_hw_mhpmevent(ctr_idx, flags, event_idx, data);
 
-	if (!ret)
+	if (!ret) {
+		c->last_ctr = ctr_idx;
 		ret = ctr_idx;
+	}
 
 	return ret;
 }
 
 
+#ifdef CONFIG_SBI_PMU_MUX
+static void pmu_mux_unschedule(struct pmu_mux_state *mux, u64 delta)
+{
+	struct pmu_mux_event *e;
+	u32 i;
+
+	csr_set(CSR_MCOUNTINHIBIT, mux->counters);
+
+	for (i = 0; i < mux->count; i++) {
+		e = &mux->events[i];
+		if (e->ctr < 0)
+			continue;
+
+		e->raw_count += pmu_ctr_read_hw(e->ctr);
+		e->time_running += delta;
+		e->ctr = -1;
+	}
+}
+
+static void pmu_mux_schedule(struct pmu_mux_state *mux)
+{
+	unsigned long free = mux->counters;
+	struct pmu_mux_event *e;
+	u32 i, n, start = mux->next;
+	uint32_t cmask;
+	int ctr;
+
+	/* Round-robin over the events starting after the last scheduled */
+	for (n = 0; n < mux->count && free; n++) {
+		i = (start + n) % mux->count;
+		e = &mux->events[i];
+
+		cmask = pmu_hw_event_counters(e->event_idx, e->event_data) & free;
+		if (!cmask)
+			continue;
+
+		ctr = sbi_ffs(cmask);
+		if (pmu_update_hw_mhpmevent(ctr, mux->flags, e->event_idx,
+					    e->event_data))
+			continue;
+
+		pmu_ctr_write_hw(ctr, 0);
+		free &= ~BIT(ctr);
+		e->ctr = ctr;
+		mux->next = (i + 1) % mux->count;
+	}
+
+	csr_clear(CSR_MCOUNTINHIBIT, mux->counters & ~free);
+}
+
+/* Scale count by enabled / running without overflowing 64 bits */
+static uint64_t pmu_mux_scale(uint64_t count, uint64_t enabled,
+			      uint64_t running)
+{
+	if (!running)
+		return 0;
+	if (enabled <= running)
+		return count;
+
+	while (running > 1 && count > (-1ULL / enabled)) {
+		enabled >>= 1;
+		running >>= 1;
+	}
+
+	return count * enabled / running;
+}
+
+static void pmu_mux_publish(struct pmu_mux_state *mux)
+{
+	struct pmu_mux_shmem_entry *dst = (void *)mux->shmem;
+	struct pmu_mux_event *e;
+	u32 i;
+
+	sbi_hart_map_saddr(mux->shmem, sizeof(*dst) * mux->count);
+	for (i = 0; i < mux->count; i++) {
+		e = &mux->events[i];
+		dst[i].count = pmu_mux_scale(e->raw_count, mux->time_enabled,
+					     e->time_running);
+		dst[i].time_enabled = mux->time_enabled;
+		dst[i].time_running = e->time_running;
+	}
+	sbi_hart_unmap_saddr();
+}
+
+/* Account the time since the last rotation and take the events off */
+static void pmu_mux_update(struct pmu_mux_state *mux)
+{
+	u64 now = sbi_timer_value(), delta = now - mux->last_time;
+
+	pmu_mux_unschedule(mux, delta);
+	mux->time_enabled += delta;
+	mux->last_time = now;
+}
+
+static void pmu_mux_event_callback(struct sbi_timer_event *ev)
+{
+	struct pmu_mux_state *mux = ev->priv;
+
+	pmu_mux_update(mux);
+	pmu_mux_schedule(mux);
+	pmu_mux_publish(mux);
+
+	ev->deadline += mux->period;
+	if (ev->deadline < mux->last_time)
+		ev->deadline = mux->last_time + mux->period;
+	sbi_timer_event_add(ev);
+}
+
+static void pmu_mux_stop(struct sbi_pmu_hart_state *phs)
+{
+	struct pmu_mux_state *mux = phs->mux;
+	int i;
+
+	if (!mux)
+		return;
+
+	sbi_timer_event_cancel(&mux->ev);
+	pmu_mux_update(mux);
+	pmu_mux_publish(mux);
+
+	for_each_set_bit(i, &mux->counters, SBI_PMU_HW_CTR_MAX) {
+		phs->active_events[i] = SBI_PMU_EVENT_IDX_INVALID;
+		pmu_reset_hw_mhpmevent(i);
+	}
+
+	phs->mux = NULL;
+	sbi_free(mux);
+}
+
+static int pmu_mux_read_events(struct sbi_pmu_hart_state *phs,
+			       struct pmu_mux_state *mux)
+{
+	struct pmu_mux_shmem_entry *src = (void *)mux->shmem;
+	struct pmu_mux_event *e;
+	int ret = 0, type;
+	u32 i;
+
+	sbi_hart_map_saddr(mux->shmem, sizeof(*src) * mux->count);
+	for (i = 0; i < mux->count; i++) {
+		e = &mux->events[i];
+		e->event_idx = src[i].event_idx;
+		e->event_data = src[i].event_data;
+		e->ctr = -1;
+
+		/* Only hardware events can be multiplexed */
+		type = pmu_event_validate(phs, e->event_idx, e->event_data);
+		if (type != SBI_PMU_EVENT_TYPE_HW &&
+		    type != SBI_PMU_EVENT_TYPE_HW_CACHE &&
+		    type != SBI_PMU_EVENT_TYPE_HW_RAW) {
+			ret = SBI_EINVAL;
+			break;
+		}
+
+		src[i].count = 0;
+		src[i].time_enabled = 0;
+		src[i].time_running = 0;
+	}
+	sbi_hart_unmap_saddr();
+
+	return ret;
+}
+
+int sbi_pmu_mux_set(unsigned long shmem_lo, unsigned long shmem_hi,
+		    unsigned long count, unsigned long period_us,
+		    unsigned long flags)
+{
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
+	const struct sbi_timer_device *tdev = sbi_timer_get_device();
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct pmu_mux_state *mux;
+	unsigned long counters = 0;
+	int i, ret;
+
+	if (unlikely(!phs))
+		return SBI_EINVAL;
+
+	/* A new group replaces the current one */
+	pmu_mux_stop(phs);
+	if (!count)
+		return 0;
+
+	if (count > SBI_PMU_MUX_MAX_EVENTS || !period_us ||
+	    (flags & ~(SBI_PMU_CFG_FLAG_SET_VUINH | SBI_PMU_CFG_FLAG_SET_VSINH |
+		       SBI_PMU_CFG_FLAG_SET_UINH | SBI_PMU_CFG_FLAG_SET_SINH |
+		       SBI_PMU_CFG_FLAG_SET_MINH)))
+		return SBI_EINVAL;
+
+	/* Counters are rotated using mcountinhibit */
+	if (sbi_hart_priv_version(scratch) < SBI_HART_PRIV_VER_1_11 ||
+	    !tdev || !tdev->timer_freq)
+		return SBI_ENOTSUPP;
+
+	if (shmem_lo & (sizeof(uint64_t) - 1))
+		return SBI_EINVAL;
+
+	/* M-mode can only access shared memory below 4GB on RV32 */
+	if (shmem_hi)
+		return SBI_EINVALID_ADDR;
+
+	if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(), shmem_lo,
+					 count * sizeof(struct pmu_mux_shmem_entry),
+					 PRV_S,
+					 SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_EINVALID_ADDR;
+
+	/* Take over the programmable counters which S-mode isn't using */
+	for (i = 3; i < num_hw_ctrs; i++) {
+		if (phs->active_events[i] == SBI_PMU_EVENT_IDX_INVALID)
+			counters |= BIT(i);
+	}
+	counters &= ~(unsigned long)sbi_hart_mhpm_deleg_mask(scratch);
+	if (!counters)
+		return SBI_ENOTSUPP;
+
+	mux = sbi_zalloc(sizeof(*mux));
+	if (!mux)
+		return SBI_ENOMEM;
+
+	mux->shmem = shmem_lo;
+	mux->count = count;
+	mux->flags = flags;
+	ret = pmu_mux_read_events(phs, mux);
+	if (ret) {
+		sbi_free(mux);
+		return ret;
+	}
+
+	mux->counters = counters;
+	for_each_set_bit(i, &counters, SBI_PMU_HW_CTR_MAX)
+		phs->active_events[i] = PMU_MUX_RESERVED_EVENT_IDX;
+
+	mux->period = (u64)tdev->timer_freq * period_us / 1000000;
+	if (!mux->period)
+		mux->period = 1;
+	mux->last_time = sbi_timer_value();
+	mux->ev.callback = pmu_mux_event_callback;
+	mux->ev.priv = mux;
+	mux->ev.deadline = mux->last_time + mux->period;
+	phs->mux = mux;
+
+	pmu_mux_schedule(mux);
+	ret = sbi_timer_event_add(&mux->ev);
+	if (ret)
+		pmu_mux_stop(phs);
+
+	return ret;
+}
+#endif
+
 /**
  * Any firmware counter can map to any firmware event.
  * Thus, select the first available fw counter after sanity
@@ -792,9 +1447,7 @@ static int pmu_ctr_find_fw(struct sbi_pmu_hart_state *phs,
 {
 	int i, cidx;
 
-	if ((event_code >= SBI_PMU_FW_MAX &&
-	    event_code <= SBI_PMU_FW_RESERVED_MAX) ||
-	    event_code > SBI_PMU_FW_PLATFORM)
+	if (!pmu_fw_event_code_valid(event_code))
 		return SBI_EINVAL;
 
 	for_each_set_bit(i, &cmask, BITS_PER_LONG) {
@@ -848,7 +1501,9 @@ int sbi_pmu_ctr_cfg_match(unsigned long cidx_base, unsigned long cidx_mask,
 		 */
 		unsigned long cidx_first = cidx_base + sbi_ffs(cidx_mask);
 
-		if (phs->active_events[cidx_first] == SBI_PMU_EVENT_IDX_INVALID)
+		if (phs->active_events[cidx_first] == SBI_PMU_EVENT_IDX_INVALID ||
+		    get_cidx_type(phs->active_events[cidx_first]) >=
+						SBI_PMU_EVENT_TYPE_MAX)
 			return SBI_EINVAL;
 		ctr_idx = cidx_first;
 		goto skip_match;
@@ -889,13 +1544,15 @@ skip_match:
 					return ret;
 			}
 			phs->fw_counters_started |= BIT(ctr_idx - num_hw_ctrs);
+			pmu_fw_event_counters_update(phs);
 		}
 	}
 
 	return ctr_idx;
 }
 
-int sbi_pmu_ctr_incr_fw(enum sbi_pmu_fw_event_code_id fw_id)
+int sbi_pmu_ctr_add_fw(enum sbi_pmu_fw_event_code_id fw_id,
+		       unsigned long count)
 {
 	u32 cidx;
 	uint64_t *fcounter = NULL;
@@ -907,7 +1564,16 @@ int sbi_pmu_ctr_incr_fw(enum sbi_pmu_fw_event_code_id fw_id)
 	if (likely(!phs->fw_counters_started))
 		return 0;
 
-	if (unlikely(fw_id >= SBI_PMU_FW_MAX))
+	/* SBI firmware events are looked up in the per-event bitmap */
+	if (likely(fw_id < SBI_PMU_FW_MAX)) {
+		cidx = phs->fw_event_counters[fw_id];
+		if (cidx)
+			phs->fw_counters_data[sbi_ffs(cidx)] += count;
+		return 0;
+	}
+
+	if (unlikely(!pmu_fw_event_code_valid(fw_id) ||
+		     fw_id == SBI_PMU_FW_PLATFORM))
 		return SBI_EINVAL;
 
 	for (cidx = num_hw_ctrs; cidx < total_ctrs; cidx++) {
@@ -919,11 +1585,16 @@ int sbi_pmu_ctr_incr_fw(enum sbi_pmu_fw_event_code_id fw_id)
 	}
 
 	if (fcounter)
-		(*fcounter)++;
+		*fcounter += count;
 
 	return 0;
 }
 
+int sbi_pmu_ctr_incr_fw(enum sbi_pmu_fw_event_code_id fw_id)
+{
+	return sbi_pmu_ctr_add_fw(fw_id, 1);
+}
+
 unsigned long sbi_pmu_num_ctr(void)
 {
 	return (num_hw_ctrs + SBI_PMU_FW_CTR_MAX);
@@ -979,7 +1650,12 @@ static void pmu_reset_event_map(struct sbi_pmu_hart_state *phs)
 	for (j = 0; j < SBI_PMU_FW_CTR_MAX; j++)
 		phs->fw_counters_data[j] = 0;
 	phs->fw_counters_started = 0;
+	pmu_fw_event_counters_update(phs);
 	phs->sse_enabled = 0;
+	phs->snapshot_enabled = false;
+	phs->snapshot_addr = 0;
+	for (j = 0; j < PMU_HW_EVENT_CACHE_SIZE; j++)
+		phs->hw_event_cache[j].event_idx = SBI_PMU_EVENT_IDX_INVALID;
 }
 
 const struct sbi_pmu_device *sbi_pmu_get_device(void)
@@ -1008,9 +1684,24 @@ void sbi_pmu_exit(struct sbi_scratch *scratch)
 	if (unlikely(!phs))
 		return;
 
+#ifdef CONFIG_SBI_PMU_MUX
+	pmu_mux_stop(phs);
+#endif
 	pmu_reset_event_map(phs);
 }
 
+void sbi_pmu_resume(struct sbi_scratch *scratch)
+{
+	struct sbi_pmu_hart_state *phs = pmu_get_hart_state_ptr(scratch);
+
+	if (unlikely(!phs) ||
+	    !sbi_hart_has_extension(scratch, SBI_HART_EXT_SMCNTRPMF))
+		return;
+
+	pmu_fixed_ctr_write_cfg(phs, 0, phs->fixed_ctr_cfg[0]);
+	pmu_fixed_ctr_write_cfg(phs, 2, phs->fixed_ctr_cfg[1]);
+}
+
 static void pmu_sse_enable(uint32_t event_id)
 {
 	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
@@ -1018,14 +1709,14 @@ static void pmu_sse_enable(uint32_t event_id)
 	phs->sse_enabled = true;
 	csr_clear(CSR_MIDELEG, sbi_pmu_irq_bit());
 	csr_clear(CSR_MIP, MIP_LCOFIP);
-	csr_set(CSR_MIE, MIP_LCOFIP);
+	csr_set(CSR_MIE, pmu_ovf_irq_mask());
 }
 
 static void pmu_sse_disable(uint32_t event_id)
 {
 	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
 
-	csr_clear(CSR_MIE, MIP_LCOFIP);
+	csr_clear(CSR_MIE, pmu_ovf_irq_mask());
 	csr_clear(CSR_MIP, MIP_LCOFIP);
 	csr_set(CSR_MIDELEG, sbi_pmu_irq_bit());
 	phs->sse_enabled = false;
@@ -1033,7 +1724,7 @@ static void pmu_sse_disable(uint32_t event_id)
 
 static void pmu_sse_complete(uint32_t event_id)
 {
-	csr_set(CSR_MIE, MIP_LCOFIP);
+	csr_set(CSR_MIE, pmu_ovf_irq_mask());
 }
 
 static const struct sbi_sse_cb_ops pmu_sse_cb_ops = {
@@ -1085,7 +1776,8 @@ int sbi_pmu_init(struct sbi_scratch *scratch, bool cold_boot)
 
 	phs = pmu_get_hart_state_ptr(scratch);
 	if (!phs) {
-		phs = sbi_zalloc(sizeof(*phs));
+		phs = sbi_zalloc_local(sizeof(*phs) +
+					total_ctrs * sizeof(*phs->active_events));
 		if (!phs)
 			return SBI_ENOMEM;
 		phs->hartid = current_hartid();
@@ -1094,6 +1786,12 @@ int sbi_pmu_init(struct sbi_scratch *scratch, bool cold_boot)
 
 	pmu_reset_event_map(phs);
 
+	/* Don't inherit the mode filters of a previous run of the HART */
+	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SMCNTRPMF)) {
+		pmu_fixed_ctr_write_cfg(phs, 0, 0);
+		pmu_fixed_ctr_write_cfg(phs, 2, 0);
+	}
+
 	/* First three counters are fixed by the priv spec and we enable it by default */
 	phs->active_events[0] = (SBI_PMU_EVENT_TYPE_HW << SBI_PMU_EVENT_IDX_TYPE_OFFSET) |
 				SBI_PMU_HW_CPU_CYCLES;
@@ -8,6 +8,9 @@
  */
 
 #include <sbi/riscv_locks.h>
+#include <sbi/sbi_bitops.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_platform.h>
@@ -17,14 +20,29 @@
 u32 last_hartindex_having_scratch = 0;
 u32 hartindex_to_hartid_table[SBI_HARTMASK_MAX_BITS + 1] = { -1U };
 struct sbi_scratch *hartindex_to_scratch_table[SBI_HARTMASK_MAX_BITS + 1] = { 0 };
+unsigned long hartindex_to_scratch_base;
+unsigned long hartindex_to_scratch_shift;
 
+/* HART id to (HART index + 1) table where zero means invalid HART id */
+static u16 hartid_to_hartindex_table[SBI_HARTMASK_MAX_BITS];
+
+static unsigned long scratch_size = SBI_SCRATCH_SIZE;
 static spinlock_t extra_lock = SPIN_LOCK_INITIALIZER;
 static unsigned long extra_offset = SBI_SCRATCH_EXTRA_SPACE_OFFSET;
 
+/* Cache line aligned allocations remembered for the boot prints */
+#define SCRATCH_CACHELINE_RECORDS	16
+static unsigned long cacheline_offsets[SCRATCH_CACHELINE_RECORDS];
+static unsigned long cacheline_sizes[SCRATCH_CACHELINE_RECORDS];
+static u32 cacheline_count;
+
 u32 sbi_hartid_to_hartindex(u32 hartid)
 {
 	u32 i;
 
+	if (hartid < SBI_HARTMASK_MAX_BITS)
+		return (u32)hartid_to_hartindex_table[hartid] - 1;
+
 	for (i = 0; i <= last_hartindex_having_scratch; i++)
 		if (hartindex_to_hartid_table[i] == hartid)
 			return i;
@@ -34,9 +52,39 @@ u32 sbi_hartid_to_hartindex(u32 hartid)
 
 typedef struct sbi_scratch *(*hartid2scratch)(ulong hartid, ulong hartindex);
 
+/*
+ * The scratch spaces are normally placed below each other at a power
+ * of 2 stride, in which case sbi_hartindex_to_scratch() can compute the
+ * scratch space address instead of reading the table.
+ */
+static void scratch_layout_init(u32 hart_count)
+{
+	unsigned long base, stride;
+	u32 i;
+
+	hartindex_to_scratch_shift = 0;
+	if (hart_count < 2)
+		return;
+
+	base = (unsigned long)hartindex_to_scratch_table[0];
+	stride = base - (unsigned long)hartindex_to_scratch_table[1];
+	if (!stride || (stride & (stride - 1)) || base < stride)
+		return;
+
+	for (i = 2; i < hart_count; i++) {
+		if ((unsigned long)hartindex_to_scratch_table[i] !=
+		    base - i * stride)
+			return;
+	}
+
+	hartindex_to_scratch_base = base;
+	hartindex_to_scratch_shift = sbi_ffs(stride);
+}
+
 int sbi_scratch_init(struct sbi_scratch *scratch)
 {
 	u32 i, h;
+	unsigned long vars_size;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	for (i = 0; i < plat->hart_count; i++) {
@@ -44,18 +92,36 @@ int sbi_scratch_init(struct sbi_scratch *scratch)
 		hartindex_to_hartid_table[i] = h;
 		hartindex_to_scratch_table[i] =
 			((hartid2scratch)scratch->hartid_to_scratch)(h, i);
+		if (h < SBI_HARTMASK_MAX_BITS &&
+		    !hartid_to_hartindex_table[h])
+			hartid_to_hartindex_table[h] = i + 1;
 	}
 
 	last_hartindex_having_scratch = plat->hart_count - 1;
+	scratch_layout_init(plat->hart_count);
+	scratch_size = sbi_platform_hart_scratch_size(plat);
+
+	/* Per-HART variables come first in the extra space */
+	vars_size = __stop_sbi_scratch_vars - __start_sbi_scratch_vars;
+	extra_offset = SBI_SCRATCH_VARS_OFFSET + vars_size;
+	extra_offset = (extra_offset + __SIZEOF_POINTER__ - 1) &
+		       ~(__SIZEOF_POINTER__ - 1);
+	if (scratch_size < extra_offset)
+		return SBI_ENOMEM;
+
+	for (i = 0; i < plat->hart_count; i++)
+		sbi_memcpy(sbi_scratch_offset_ptr(hartindex_to_scratch_table[i],
+						  SBI_SCRATCH_VARS_OFFSET),
+			   __start_sbi_scratch_vars, vars_size);
 
 	return 0;
 }
 
-unsigned long sbi_scratch_alloc_offset(unsigned long size)
+static unsigned long scratch_alloc(unsigned long size, unsigned long align)
 {
 	u32 i;
 	void *ptr;
-	unsigned long ret = 0;
+	unsigned long ret = 0, start;
 	struct sbi_scratch *rscratch;
 
 	/*
@@ -70,16 +136,24 @@ unsigned long sbi_scratch_alloc_offset(unsigned long size)
 	if (!size)
 		return 0;
 
-	size += __SIZEOF_POINTER__ - 1;
-	size &= ~((unsigned long)__SIZEOF_POINTER__ - 1);
+	size += align - 1;
+	size &= ~(align - 1);
 
 	spin_lock(&extra_lock);
 
-	if (SBI_SCRATCH_SIZE < (extra_offset + size))
+	start = (extra_offset + align - 1) & ~(align - 1);
+	if (scratch_size < (start + size))
 		goto done;
 
-	ret = extra_offset;
-	extra_offset += size;
+	ret = start;
+	extra_offset = start + size;
+
+	if (align == SBI_SCRATCH_CACHE_LINE_SIZE &&
+	    cacheline_count < SCRATCH_CACHELINE_RECORDS) {
+		cacheline_offsets[cacheline_count] = ret;
+		cacheline_sizes[cacheline_count] = size;
+		cacheline_count++;
+	}
 
 done:
 	spin_unlock(&extra_lock);
@@ -97,10 +171,24 @@ done:
 	return ret;
 }
 
+unsigned long sbi_scratch_alloc_offset(unsigned long size)
+{
+	return scratch_alloc(size, __SIZEOF_POINTER__);
+}
+
+unsigned long sbi_scratch_alloc_cacheline_offset(unsigned long size)
+{
+	/*
+	 * The scratch space of each HART is page aligned so a cache line
+	 * aligned offset is also a cache line aligned address.
+	 */
+	return scratch_alloc(size, SBI_SCRATCH_CACHE_LINE_SIZE);
+}
+
 void sbi_scratch_free_offset(unsigned long offset)
 {
 	if ((offset < SBI_SCRATCH_EXTRA_SPACE_OFFSET) ||
-	    (SBI_SCRATCH_SIZE <= offset))
+	    (scratch_size <= offset))
 		return;
 
 	/*
@@ -119,3 +207,31 @@ unsigned long sbi_scratch_used_space(void)
 
 	return ret;
 }
+
+unsigned long sbi_scratch_size(void)
+{
+	return scratch_size;
+}
+
+void sbi_scratch_get_cacheline_str(char *str, int nstr)
+{
+	int offset = 0;
+	u32 i;
+
+	if (!str || nstr <= 0)
+		return;
+	sbi_memset(str, 0, nstr);
+
+	spin_lock(&extra_lock);
+	for (i = 0; i < cacheline_count && offset < nstr; i++) {
+		sbi_snprintf(str + offset, nstr - offset, "0x%03lx+%lu,",
+			     cacheline_offsets[i], cacheline_sizes[i]);
+		offset += sbi_strlen(str + offset);
+	}
+	spin_unlock(&extra_lock);
+
+	if (offset)
+		str[offset - 1] = '\0';
+	else
+		sbi_strncpy(str, "none", nstr);
+}
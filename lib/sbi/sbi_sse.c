@@ -10,6 +10,7 @@
 #include <sbi/riscv_encoding.h>
 #include <sbi/riscv_locks.h>
 #include <sbi/sbi_domain.h>
+#include <sbi/sbi_bitops.h>
 #include <sbi/sbi_ecall.h>
 #include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_error.h>
@@ -19,11 +20,13 @@
 #include <sbi/sbi_hsm.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_list.h>
+#include <sbi/sbi_lockstat.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_pmu.h>
 #include <sbi/sbi_sse.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_string.h>
+#include <sbi/sbi_trace.h>
 #include <sbi/sbi_trap.h>
 
 #include <sbi/sbi_console.h>
@@ -34,8 +37,8 @@
 #define sse_thishart_state_ptr() \
 	sse_get_hart_state_ptr(sbi_scratch_thishart_ptr())
 
-#define sse_set_hart_state_ptr(__scratch, __sse_state) \
-	sbi_scratch_write_type((__scratch), void *, shs_ptr_off, (__sse_state))
+#define sse_hart_state_ptr_slot(__scratch) \
+	((void **)sbi_scratch_offset_ptr((__scratch), shs_ptr_off))
 
 #define EVENT_IS_GLOBAL(__event_id) ((__event_id) & SBI_SSE_EVENT_GLOBAL_BIT)
 
@@ -49,6 +52,9 @@ static const uint32_t supported_events[] = {
 
 #define EVENT_COUNT array_size(supported_events)
 
+_Static_assert(EVENT_COUNT <= BITS_PER_LONG,
+	       "local SSE events do not fit in the pending bitmap");
+
 #define sse_event_invoke_cb(_event, _cb, ...)                                 \
 	{                                                                     \
 		if (_event->cb_ops && _event->cb_ops->_cb)                    \
@@ -77,6 +83,8 @@ struct sse_ipi_inject_data {
 	uint32_t event_id;
 };
 
+SBI_FIFO_DEFINE_TYPED(sse_inject_fifo, struct sse_ipi_inject_data);
+
 struct sbi_sse_event_attrs {
 	unsigned long status;
 	unsigned long prio;
@@ -114,17 +122,11 @@ struct sbi_sse_event {
 
 /** Per-hart state */
 struct sse_hart_state {
-	/* Priority sorted list of enabled events (global and local in >=
-	 * ENABLED state). This list is protected by the enabled_event_lock.
-	 *
-	 * Global events can also be inserted in this list. Since these events
-	 * can be accessed by all harts, we actually need to lock independently
-	 * (see sse_global_event).
-	 *
-	 * Local events do not actually need to be locked since, we do
-	 * not have preemption and there are solely accessed by the current
-	 * hart. So when inserting a local event in this list, we just need to
-	 * lock the list at insertion/removal time.
+	/* Priority sorted list of enabled global events targeting this hart
+	 * (in >= ENABLED state). This list is protected by the
+	 * enabled_event_lock. Since global events can be accessed by all
+	 * harts, we actually need to lock them independently (see
+	 * sse_global_event).
 	 *
 	 * When an event is in a state >= ENABLED, then it is inserted in the
 	 * this enabled_event_list and thus can only be removed from this
@@ -133,10 +135,32 @@ struct sse_hart_state {
 	struct sbi_dlist enabled_event_list;
 
 	/**
-	 * Lock that protects enabled_event_list
+	 * Lock that protects enabled_event_list and global_enabled_count
 	 */
 	spinlock_t enabled_event_lock;
 
+	/**
+	 * Number of global events in enabled_event_list. It is read without
+	 * the lock to skip the list when it is empty: a global event which
+	 * becomes pending on an enabled event always sends an IPI to this
+	 * hart so a stale zero is corrected on the next trap.
+	 */
+	unsigned int global_enabled_count;
+
+	/*
+	 * Local events do not need to be locked since we do not have
+	 * preemption and they are solely accessed by the current hart.
+	 * Enabled local events are kept in the priority sorted index array
+	 * local_enabled[] (local_rank[] being its inverse). The pending and
+	 * running bitmaps are indexed by priority rank so that the first
+	 * active local event is found with a single find-first-set.
+	 */
+	unsigned long local_pending;
+	unsigned long local_running;
+	unsigned int local_enabled_count;
+	u8 local_enabled[EVENT_COUNT];
+	u8 local_rank[EVENT_COUNT];
+
 	/**
 	 * List of local events allocated at boot time.
 	 */
@@ -154,23 +178,33 @@ struct sse_global_event {
 
 	/**
 	 * Global event lock protecting access from multiple harts from ecall to
-	 * the event.
+	 * the event. Ecalls which only read the event take it as a reader.
 	 */
-	spinlock_t lock;
+	rwlock_t lock;
 };
 
 static unsigned int local_event_count;
 static unsigned int global_event_count;
 static struct sse_global_event *global_events;
 
+SBI_HEAP_NEED(sse, EVENT_COUNT * sizeof(struct sse_global_event),
+	      sizeof(struct sse_hart_state) +
+	      EVENT_COUNT * sizeof(struct sbi_sse_event));
+
+SBI_LOCKSTAT_DEFINE(sse_enabled_event_lock, NULL);
+
 static unsigned long sse_inject_fifo_off;
 static unsigned long sse_inject_fifo_mem_off;
 /* Offset of pointer to SSE HART state in scratch space */
 static unsigned long shs_ptr_off;
 
+/* Callbacks of the local events, applied to each per hart state */
+static const struct sbi_sse_cb_ops *local_cb_ops[EVENT_COUNT];
+
 static u32 sse_ipi_inject_event = SBI_IPI_EVENT_MAX;
 
 static int sse_ipi_inject_send(unsigned long hartid, uint32_t event_id);
+static struct sse_hart_state *sse_hart_state_alloc(unsigned long hartid);
 
 static unsigned long sse_event_state(struct sbi_sse_event *e)
 {
@@ -207,28 +241,71 @@ static struct sse_global_event *sse_get_global_event(struct sbi_sse_event *e)
 	return container_of(e, struct sse_global_event, event);
 }
 
+static unsigned int sse_local_event_index(struct sse_hart_state *shs,
+					  struct sbi_sse_event *e)
+{
+	return e - shs->local_events;
+}
+
+/* Bit of an enabled local event in the rank indexed bitmaps */
+static unsigned long sse_local_rank_bit(struct sse_hart_state *shs,
+					struct sbi_sse_event *e)
+{
+	return BIT(shs->local_rank[sse_local_event_index(shs, e)]);
+}
+
+/* Open (insert) or close (remove) a hole at bit position rank */
+static unsigned long sse_rank_mask_insert(unsigned long mask,
+					  unsigned int rank)
+{
+	return (mask & (BIT(rank) - 1)) | ((mask >> rank) << (rank + 1));
+}
+
+static unsigned long sse_rank_mask_remove(unsigned long mask,
+					  unsigned int rank)
+{
+	return (mask & (BIT(rank) - 1)) | ((mask >> (rank + 1)) << rank);
+}
+
 /**
- * If event is global, must be called under enabled event lock
+ * If event is global, must be called under global event lock. Local events
+ * are only accessed by their owner hart and need no locking.
  */
 static void sse_enabled_event_lock(struct sbi_sse_event *e)
 {
 	struct sse_hart_state *shs;
 
+	if (sse_event_is_local(e))
+		return;
+
 	shs = sse_get_hart_state(e);
 	spin_lock(&shs->enabled_event_lock);
 }
 
 /**
- * If event is global, must be called under enabled event lock
+ * If event is global, must be called under global event lock
  */
 static void sse_enabled_event_unlock(struct sbi_sse_event *e)
 {
 	struct sse_hart_state *shs;
 
+	if (sse_event_is_local(e))
+		return;
+
 	shs = sse_get_hart_state(e);
 	spin_unlock(&shs->enabled_event_lock);
 }
 
+/* Return true if event a must be handled before event b */
+static bool sse_event_is_before(struct sbi_sse_event *a,
+				struct sbi_sse_event *b)
+{
+	if (a->attrs.prio != b->attrs.prio)
+		return a->attrs.prio < b->attrs.prio;
+
+	return a->event_id < b->event_id;
+}
+
 static void sse_event_set_state(struct sbi_sse_event *e,
 				unsigned long new_state)
 {
@@ -236,7 +313,7 @@ static void sse_event_set_state(struct sbi_sse_event *e,
 	e->attrs.status |= new_state;
 }
 
-static struct sbi_sse_event *sse_event_get(uint32_t event_id)
+static struct sbi_sse_event *__sse_event_get(uint32_t event_id, bool read)
 {
 	unsigned int i;
 	struct sbi_sse_event *e;
@@ -246,12 +323,17 @@ static struct sbi_sse_event *sse_event_get(uint32_t event_id)
 		for (i = 0; i < global_event_count; i++) {
 			e = &global_events[i].event;
 			if (e->event_id == event_id) {
-				spin_lock(&global_events[i].lock);
+				if (read)
+					read_lock(&global_events[i].lock);
+				else
+					write_lock(&global_events[i].lock);
 				return e;
 			}
 		}
 	} else {
 		shs = sse_thishart_state_ptr();
+		if (!shs)
+			return NULL;
 		for (i = 0; i < local_event_count; i++) {
 			e = &shs->local_events[i];
 			if (e->event_id == event_id)
@@ -262,7 +344,7 @@ static struct sbi_sse_event *sse_event_get(uint32_t event_id)
 	return NULL;
 }
 
-static void sse_event_put(struct sbi_sse_event *e)
+static void __sse_event_put(struct sbi_sse_event *e, bool read)
 {
 	struct sse_global_event *ge;
 
@@ -270,12 +352,67 @@ static void sse_event_put(struct sbi_sse_event *e)
 		return;
 
 	ge = sse_get_global_event(e);
-	spin_unlock(&ge->lock);
+	if (read)
+		read_unlock(&ge->lock);
+	else
+		write_unlock(&ge->lock);
+}
+
+/*
+ * The per hart state is only allocated once S-mode uses a local event on
+ * the hart or enables a global event targeting it. An allocation failure
+ * makes the lookup of the local event fail.
+ */
+static void sse_thishart_state_prepare(uint32_t event_id)
+{
+	if (!EVENT_IS_GLOBAL(event_id) && !sse_thishart_state_ptr())
+		sse_hart_state_alloc(current_hartid());
+}
+
+static struct sbi_sse_event *sse_event_get(uint32_t event_id)
+{
+	return __sse_event_get(event_id, false);
+}
+
+static void sse_event_put(struct sbi_sse_event *e)
+{
+	__sse_event_put(e, false);
+}
+
+/* Same as sse_event_get() but only allows reading the event */
+static struct sbi_sse_event *sse_event_get_read(uint32_t event_id)
+{
+	return __sse_event_get(event_id, true);
+}
+
+static void sse_event_put_read(struct sbi_sse_event *e)
+{
+	__sse_event_put(e, true);
 }
 
+/**
+ * Must be called under owner hart lock
+ */
 static void sse_event_remove_from_list(struct sbi_sse_event *e)
 {
-	sbi_list_del(&e->node);
+	struct sse_hart_state *state = sse_get_hart_state(e);
+	unsigned int i, idx;
+
+	if (sse_event_is_global(e)) {
+		sbi_list_del(&e->node);
+		state->global_enabled_count--;
+		return;
+	}
+
+	idx = sse_local_event_index(state, e);
+	i = state->local_rank[idx];
+	state->local_pending = sse_rank_mask_remove(state->local_pending, i);
+	state->local_running = sse_rank_mask_remove(state->local_running, i);
+	for (; i + 1 < state->local_enabled_count; i++) {
+		state->local_enabled[i] = state->local_enabled[i + 1];
+		state->local_rank[state->local_enabled[i]] = i;
+	}
+	state->local_enabled_count--;
 }
 
 /**
@@ -285,15 +422,34 @@ static void sse_event_add_to_list(struct sbi_sse_event *e)
 {
 	struct sse_hart_state *state = sse_get_hart_state(e);
 	struct sbi_sse_event *tmp;
+	unsigned int i, idx;
+
+	if (sse_event_is_local(e)) {
+		for (i = state->local_enabled_count; i > 0; i--) {
+			tmp = &state->local_events[state->local_enabled[i - 1]];
+			if (!sse_event_is_before(e, tmp))
+				break;
+			state->local_enabled[i] = state->local_enabled[i - 1];
+			state->local_rank[state->local_enabled[i]] = i;
+		}
+		idx = sse_local_event_index(state, e);
+		state->local_enabled[i] = idx;
+		state->local_rank[idx] = i;
+		state->local_enabled_count++;
+
+		state->local_pending = sse_rank_mask_insert(state->local_pending, i);
+		state->local_running = sse_rank_mask_insert(state->local_running, i);
+		if (sse_event_pending(e))
+			state->local_pending |= BIT(i);
+		return;
+	}
 
 	sbi_list_for_each_entry(tmp, &state->enabled_event_list, node) {
-		if (e->attrs.prio < tmp->attrs.prio)
-			break;
-		if (e->attrs.prio == tmp->attrs.prio &&
-		    e->event_id < tmp->event_id)
+		if (sse_event_is_before(e, tmp))
 			break;
 	}
 	sbi_list_add_tail(&e->node, &tmp->node);
+	state->global_enabled_count++;
 }
 
 /**
@@ -466,7 +622,13 @@ static void sse_event_inject(struct sbi_sse_event *e,
 
 	sse_event_set_state(e, SBI_SSE_STATE_RUNNING);
 
-	e->attrs.status = ~BIT(SBI_SSE_ATTR_STATUS_PENDING_OFFSET);
+	e->attrs.status &= ~BIT(SBI_SSE_ATTR_STATUS_PENDING_OFFSET);
+	if (sse_event_is_local(e)) {
+		struct sse_hart_state *shs = sse_thishart_state_ptr();
+
+		shs->local_pending &= ~sse_local_rank_bit(shs, e);
+		shs->local_running |= sse_local_rank_bit(shs, e);
+	}
 
 	i_ctx->a6 = regs->a6;
 	i_ctx->a7 = regs->a7;
@@ -580,44 +742,94 @@ static bool sse_event_is_ready(struct sbi_sse_event *e)
 	return true;
 }
 
-static bool sse_event_check_inject(struct sbi_sse_event *e,
-				   struct sbi_trap_regs *regs)
+/*
+ * Enabled events are ordered by priority, stop at first running event
+ * since all other events after this one are of lower priority. This means
+ * an event of higher priority is already running.
+ */
+static bool sse_event_is_active(struct sbi_sse_event *e, bool running_only)
 {
-	/*
-	 * List of event is ordered by priority, stop at first running
-	 * event since all other events after this one are of lower
-	 * priority. This means an event of higher priority is already
-	 * running.
-	 */
-	if (sse_event_state(e) == SBI_SSE_STATE_RUNNING) {
+	if (sse_event_state(e) == SBI_SSE_STATE_RUNNING)
 		return true;
-	}
 
-	if (sse_event_is_ready(e)) {
-		sse_event_inject(e, regs);
-		return true;
+	return !running_only && sse_event_is_ready(e);
+}
+
+static struct sbi_sse_event *sse_local_first_active(struct sse_hart_state *shs,
+						    bool running_only)
+{
+	unsigned long mask = shs->local_running;
+
+	if (!running_only)
+		mask |= shs->local_pending;
+	if (!mask)
+		return NULL;
+
+	return &shs->local_events[shs->local_enabled[sbi_ffs(mask)]];
+}
+
+/**
+ * Must be called under owner hart lock
+ */
+static struct sbi_sse_event *sse_global_first_active(struct sse_hart_state *shs,
+						     bool running_only)
+{
+	struct sbi_sse_event *e;
+
+	sbi_list_for_each_entry(e, &shs->enabled_event_list, node) {
+		if (sse_event_is_active(e, running_only))
+			return e;
 	}
 
-	return false;
+	return NULL;
+}
+
+/*
+ * Return the first running or ready event of this hart taking local and
+ * global events into account. The enabled event lock is taken when global
+ * events need to be looked at and the caller must release it if *locked
+ * is set.
+ */
+static struct sbi_sse_event *sse_first_active(struct sse_hart_state *shs,
+					      bool running_only, bool *locked)
+{
+	struct sbi_sse_event *e, *ge;
+
+	e = sse_local_first_active(shs, running_only);
+
+	*locked = false;
+	if (!shs->global_enabled_count)
+		return e;
+
+	spin_lock(&shs->enabled_event_lock);
+	*locked = true;
+
+	ge = sse_global_first_active(shs, running_only);
+	if (ge && (!e || sse_event_is_before(ge, e)))
+		e = ge;
+
+	return e;
 }
 
-/* Return true if an event has been injected, false otherwise */
 void sbi_sse_process_pending_events(struct sbi_trap_regs *regs)
 {
-	bool ret;
+	bool locked;
 	struct sbi_sse_event *e;
 	struct sse_hart_state *state = sse_thishart_state_ptr();
 
-	spin_lock(&state->enabled_event_lock);
+	/*
+	 * Fast path: SSE is not used on this hart, or nothing is pending
+	 * locally and no global event is enabled
+	 */
+	if (!state || (!state->local_pending && !state->global_enabled_count))
+		return;
 
-	sbi_list_for_each_entry(e, &state->enabled_event_list, node) {
-		ret = sse_event_check_inject(e, regs);
-		if (ret)
-			goto out;
-	}
+	e = sse_first_active(state, false, &locked);
+	if (e && sse_event_state(e) != SBI_SSE_STATE_RUNNING)
+		sse_event_inject(e, regs);
 
-out:
-	spin_unlock(&state->enabled_event_lock);
+	if (locked)
+		spin_unlock(&state->enabled_event_lock);
 }
 
 static int sse_event_set_pending(struct sbi_sse_event *e)
@@ -627,6 +839,11 @@ static int sse_event_set_pending(struct sbi_sse_event *e)
 		return SBI_EINVALID_STATE;
 
 	e->attrs.status |= BIT(SBI_SSE_ATTR_STATUS_PENDING_OFFSET);
+	if (sse_event_is_local(e)) {
+		struct sse_hart_state *shs = sse_thishart_state_ptr();
+
+		shs->local_pending |= sse_local_rank_bit(shs, e);
+	}
 
 	return SBI_OK;
 }
@@ -639,7 +856,7 @@ static void sse_ipi_inject_process(struct sbi_scratch *scratch)
 		sbi_scratch_offset_ptr(scratch, sse_inject_fifo_off);
 
 	/* Mark all queued events as pending */
-	while (!sbi_fifo_dequeue(sse_inject_fifo_r, &evt)) {
+	while (!sse_inject_fifo_dequeue(sse_inject_fifo_r, &evt)) {
 		e = sse_event_get(evt.event_id);
 		if (!e)
 			continue;
@@ -667,7 +884,7 @@ static int sse_ipi_inject_send(unsigned long hartid, uint32_t event_id)
 	sse_inject_fifo_r =
 		sbi_scratch_offset_ptr(remote_scratch, sse_inject_fifo_off);
 
-	ret = sbi_fifo_enqueue(sse_inject_fifo_r, &evt);
+	ret = sse_inject_fifo_enqueue(sse_inject_fifo_r, &evt);
 	if (ret)
 		return SBI_EFAIL;
 
@@ -688,11 +905,12 @@ static int sse_inject_event(uint32_t event_id, unsigned long hartid,
 	if (!e)
 		return SBI_EINVAL;
 
-
 	/* In case of global event, provided hart_id is ignored */
 	if (sse_event_is_global(e))
 		hartid = e->attrs.hartid;
 
+	sbi_trace(SBI_TRACE_SSE_INJECT, event_id, hartid);
+
 	/* Event is for another hart, send it through IPI */
 	if (hartid != current_hartid()) {
 		sse_event_put(e);
@@ -738,6 +956,11 @@ static int sse_event_complete(struct sbi_sse_event *e,
 		return SBI_EINVAL;
 
 	sse_event_set_state(e, SBI_SSE_STATE_ENABLED);
+	if (sse_event_is_local(e)) {
+		struct sse_hart_state *shs = sse_thishart_state_ptr();
+
+		shs->local_running &= ~sse_local_rank_bit(shs, e);
+	}
 	if (e->attrs.config & SBI_SSE_ATTR_CONFIG_ONESHOT)
 		sse_event_disable(e);
 
@@ -752,21 +975,24 @@ static int sse_event_complete(struct sbi_sse_event *e,
 int sbi_sse_complete(struct sbi_trap_regs *regs, struct sbi_ecall_return *out)
 {
 	int ret = SBI_OK;
-	struct sbi_sse_event *tmp;
+	bool locked;
+	struct sbi_sse_event *e;
 	struct sse_hart_state *state = sse_thishart_state_ptr();
 
-	spin_lock(&state->enabled_event_lock);
-	sbi_list_for_each_entry(tmp, &state->enabled_event_list, node) {
-		/*
-		 * List of event is ordered by priority, first one running is
-		 * the one that needs to be completed
-		 */
-		if (sse_event_state(tmp) == SBI_SSE_STATE_RUNNING) {
-			ret = sse_event_complete(tmp, regs, out);
-			break;
-		}
-	}
-	spin_unlock(&state->enabled_event_lock);
+	/* No event ever ran on a hart without SSE state */
+	if (!state)
+		return SBI_OK;
+
+	/*
+	 * Events are ordered by priority, first one running is the one that
+	 * needs to be completed
+	 */
+	e = sse_first_active(state, true, &locked);
+	if (e)
+		ret = sse_event_complete(e, regs, out);
+
+	if (locked)
+		spin_unlock(&state->enabled_event_lock);
 
 	return ret;
 }
@@ -776,10 +1002,17 @@ int sbi_sse_enable(uint32_t event_id)
 	int ret;
 	struct sbi_sse_event *e;
 
+	sse_thishart_state_prepare(event_id);
 	e = sse_event_get(event_id);
 	if (!e)
 		return SBI_EINVAL;
 
+	/* The enabled list of a global event is in its target hart state */
+	if (sse_event_is_global(e) && !sse_hart_state_alloc(e->attrs.hartid)) {
+		sse_event_put(e);
+		return SBI_ENOMEM;
+	}
+
 	sse_enabled_event_lock(e);
 	ret = sse_event_enable(e);
 	sse_enabled_event_unlock(e);
@@ -793,10 +1026,18 @@ int sbi_sse_disable(uint32_t event_id)
 	int ret;
 	struct sbi_sse_event *e;
 
+	sse_thishart_state_prepare(event_id);
 	e = sse_event_get(event_id);
 	if (!e)
 		return SBI_EINVAL;
 
+	/* A global event was never enabled on a hart without SSE state */
+	if (sse_event_is_global(e) &&
+	    !sse_get_hart_state_ptr(sbi_hartid_to_scratch(e->attrs.hartid))) {
+		sse_event_put(e);
+		return SBI_EINVALID_STATE;
+	}
+
 	sse_enabled_event_lock(e);
 	ret = sse_event_disable(e);
 	sse_enabled_event_unlock(e);
@@ -812,6 +1053,9 @@ int sbi_sse_inject_from_ecall(uint32_t event_id, unsigned long hartid,
 	if (!sbi_domain_is_assigned_hart(sbi_domain_thishart_ptr(), hartid))
 		return SBI_EINVAL;
 
+	if (hartid == current_hartid())
+		sse_thishart_state_prepare(event_id);
+
 	return sse_inject_event(event_id, hartid, out);
 }
 
@@ -826,13 +1070,29 @@ int sbi_sse_inject_event(uint32_t event_id)
 int sbi_sse_set_cb_ops(uint32_t event_id, const struct sbi_sse_cb_ops *cb_ops)
 {
 	struct sbi_sse_event *e;
+	unsigned int i, ev = 0;
 
 	if (cb_ops->set_hartid_cb && !EVENT_IS_GLOBAL(event_id))
 		return SBI_EINVAL;
 
+	/* Local events also get the callbacks when their hart state is set up */
+	if (!EVENT_IS_GLOBAL(event_id)) {
+		for (i = 0; i < EVENT_COUNT; i++) {
+			if (EVENT_IS_GLOBAL(supported_events[i]))
+				continue;
+			if (supported_events[i] == event_id)
+				break;
+			ev++;
+		}
+		if (i == EVENT_COUNT)
+			return SBI_EINVAL;
+
+		local_cb_ops[ev] = cb_ops;
+	}
+
 	e = sse_event_get(event_id);
 	if (!e)
-		return SBI_EINVAL;
+		return EVENT_IS_GLOBAL(event_id) ? SBI_EINVAL : SBI_OK;
 
 	e->cb_ops = cb_ops;
 	sse_event_put(e);
@@ -868,9 +1128,8 @@ int sbi_sse_attr_check(uint32_t base_attr_id, uint32_t attr_count,
 	if (phys_hi)
 		return SBI_EINVALID_ADDR;
 
-	if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(), phys_lo,
-					 sizeof(unsigned long) * attr_count,
-					 PRV_S, access))
+	if (!sbi_domain_check_shmem(phys_lo,
+				    sizeof(unsigned long) * attr_count, access))
 		return SBI_EINVALID_ADDR;
 
 	return SBI_OK;
@@ -903,7 +1162,8 @@ int sbi_sse_read_attrs(uint32_t event_id, uint32_t base_attr_id,
 	if (ret)
 		return ret;
 
-	e = sse_event_get(event_id);
+	sse_thishart_state_prepare(event_id);
+	e = sse_event_get_read(event_id);
 	if (!e)
 		return SBI_EINVAL;
 
@@ -922,7 +1182,7 @@ int sbi_sse_read_attrs(uint32_t event_id, uint32_t base_attr_id,
 
 	sbi_hart_unmap_saddr();
 
-	sse_event_put(e);
+	sse_event_put_read(e);
 
 	return SBI_OK;
 }
@@ -933,15 +1193,21 @@ static int sse_write_attrs(struct sbi_sse_event *e, uint32_t base_attr_id,
 	int ret = 0;
 	unsigned long attr = 0, val;
 	uint32_t id, end_id = base_attr_id + attr_count;
-	unsigned long *attrs = (unsigned long *)input_phys;
+	unsigned long attrs[SBI_SSE_ATTR_MAX];
 
+	/*
+	 * Fetch the attributes in one go so that the shared memory is
+	 * mapped only once and each attribute is read once.
+	 */
 	sbi_hart_map_saddr(input_phys, sizeof(unsigned long) * attr_count);
+	copy_attrs(attrs, (const unsigned long *)input_phys, attr_count);
+	sbi_hart_unmap_saddr();
 
 	for (id = base_attr_id; id < end_id; id++) {
 		val = attrs[attr++];
 		ret = sse_event_set_attr_check(e, id, val);
 		if (ret)
-			goto out;
+			return ret;
 	}
 
 	attr = 0;
@@ -950,9 +1216,6 @@ static int sse_write_attrs(struct sbi_sse_event *e, uint32_t base_attr_id,
 		sse_event_set_attr(e, id, val);
 	}
 
-out:
-	sbi_hart_unmap_saddr();
-
 	return ret;
 }
 
@@ -968,6 +1231,7 @@ int sbi_sse_write_attrs(uint32_t event_id, uint32_t base_attr_id,
 	if (ret)
 		return ret;
 
+	sse_thishart_state_prepare(event_id);
 	e = sse_event_get(event_id);
 	if (!e)
 		return SBI_EINVAL;
@@ -993,6 +1257,7 @@ int sbi_sse_register(uint32_t event_id, unsigned long handler_entry_pc,
 					 SBI_DOMAIN_EXECUTE))
 		return SBI_EINVALID_ADDR;
 
+	sse_thishart_state_prepare(event_id);
 	e = sse_event_get(event_id);
 	if (!e)
 		return SBI_EINVAL;
@@ -1008,6 +1273,7 @@ int sbi_sse_unregister(uint32_t event_id)
 	int ret;
 	struct sbi_sse_event *e;
 
+	sse_thishart_state_prepare(event_id);
 	e = sse_event_get(event_id);
 	if (!e)
 		return SBI_EINVAL;
@@ -1018,10 +1284,11 @@ int sbi_sse_unregister(uint32_t event_id)
 	return ret;
 }
 
-static void sse_event_init(struct sbi_sse_event *e, uint32_t event_id)
+static void sse_event_init(struct sbi_sse_event *e, uint32_t event_id,
+			   unsigned long hartid)
 {
 	e->event_id = event_id;
-	e->attrs.hartid = current_hartid();
+	e->attrs.hartid = hartid;
 	/* Declare all events as injectable */
 	e->attrs.status |= BIT(SBI_SSE_ATTR_STATUS_INJECT_OFFSET);
 }
@@ -1052,8 +1319,8 @@ static int sse_global_init()
 			continue;
 
 		e = &global_events[ev].event;
-		sse_event_init(e, supported_events[i]);
-		SPIN_LOCK_INIT(global_events[ev].lock);
+		sse_event_init(e, supported_events[i], current_hartid());
+		RW_LOCK_INIT(global_events[ev].lock);
 
 		ev++;
 	}
@@ -1061,21 +1328,69 @@ static int sse_global_init()
 	return 0;
 }
 
-static void sse_local_init(struct sse_hart_state *shs)
+static void sse_local_init(struct sse_hart_state *shs, unsigned long hartid)
 {
 	unsigned int i, ev = 0;
 
 	SBI_INIT_LIST_HEAD(&shs->enabled_event_list);
 	SPIN_LOCK_INIT(shs->enabled_event_lock);
+	sbi_lockstat_track(sse_enabled_event_lock, &shs->enabled_event_lock);
+	shs->global_enabled_count = 0;
+	shs->local_pending = 0;
+	shs->local_running = 0;
+	shs->local_enabled_count = 0;
 
 	for (i = 0; i < EVENT_COUNT; i++) {
 		if (EVENT_IS_GLOBAL(supported_events[i]))
 			continue;
 
-		sse_event_init(&shs->local_events[ev++], supported_events[i]);
+		sse_event_init(&shs->local_events[ev], supported_events[i],
+			       hartid);
+		shs->local_events[ev].cb_ops = local_cb_ops[ev];
+		ev++;
 	}
 }
 
+/*
+ * Allocate the state of a hart when it is first needed. A global event
+ * may be enabled on another hart so the state is published atomically,
+ * the loser of a race frees its copy.
+ */
+static struct sse_hart_state *sse_hart_state_alloc(unsigned long hartid)
+{
+	struct sbi_scratch *scratch = sbi_hartid_to_scratch(hartid);
+	struct sse_hart_state *shs, *old = NULL;
+	size_t size;
+
+	if (!scratch)
+		return NULL;
+
+	shs = sse_get_hart_state_ptr(scratch);
+	if (shs)
+		return shs;
+
+	/* Allocate per hart state and local events at once */
+	size = sizeof(*shs) + sizeof(struct sbi_sse_event) * local_event_count;
+	if (hartid == current_hartid())
+		shs = sbi_zalloc_local(size);
+	else
+		shs = sbi_zalloc(size);
+	if (!shs)
+		return NULL;
+
+	shs->local_events = (struct sbi_sse_event *)(shs + 1);
+	sse_local_init(shs, hartid);
+
+	if (!__atomic_compare_exchange_n(sse_hart_state_ptr_slot(scratch),
+					 (void **)&old, shs, false,
+					 __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+		sbi_free(shs);
+		return old;
+	}
+
+	return shs;
+}
+
 int sbi_sse_init(struct sbi_scratch *scratch, bool cold_boot)
 {
 	int ret;
@@ -1095,7 +1410,7 @@ int sbi_sse_init(struct sbi_scratch *scratch, bool cold_boot)
 			return SBI_ENOMEM;
 
 		sse_inject_fifo_off =
-			sbi_scratch_alloc_offset(sizeof(*sse_inject_q));
+			sbi_scratch_alloc_cacheline_offset(sizeof(*sse_inject_q));
 		if (!sse_inject_fifo_off) {
 			sbi_scratch_free_offset(shs_ptr_off);
 			return SBI_ENOMEM;
@@ -1117,20 +1432,13 @@ int sbi_sse_init(struct sbi_scratch *scratch, bool cold_boot)
 		sse_ipi_inject_event = ret;
 	}
 
+	/*
+	 * The per hart state is allocated lazily, a hart coming back from
+	 * a stop only resets the state it already has.
+	 */
 	shs = sse_get_hart_state_ptr(scratch);
-	if (!shs) {
-		/* Allocate per hart state and local events at once */
-		shs = sbi_zalloc(sizeof(*shs) + sizeof(struct sbi_sse_event) *
-							local_event_count);
-		if (!shs)
-			return SBI_ENOMEM;
-
-		shs->local_events = (struct sbi_sse_event *)(shs + 1);
-
-		sse_set_hart_state_ptr(scratch, shs);
-	}
-
-	sse_local_init(shs);
+	if (shs)
+		sse_local_init(shs, current_hartid());
 
 	sse_inject_q = sbi_scratch_offset_ptr(scratch, sse_inject_fifo_off);
 	sse_inject_mem =
@@ -0,0 +1,91 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_barrier.h>
+#include <sbi/sbi_byteorder.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_domain_context.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_sta.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_timer.h>
+
+static void sta_update(struct sbi_sta_context *ctx, u64 stolen, u8 preempted)
+{
+	struct sbi_sta_shmem *shmem = (struct sbi_sta_shmem *)ctx->shmem;
+	u32 seq;
+
+	sbi_hart_map_saddr(ctx->shmem, sizeof(*shmem));
+
+	/*
+	 * S-mode readers retry while the sequence is odd or has changed.
+	 * The sequence is forced odd so that a value written by S-mode
+	 * can't leave the record looking stable during the update.
+	 */
+	seq = le32_to_cpu(shmem->sequence) | 1;
+	shmem->sequence = cpu_to_le32(seq);
+	smp_wmb();
+	shmem->steal = cpu_to_le64(le64_to_cpu(shmem->steal) + stolen);
+	shmem->preempted = preempted;
+	smp_wmb();
+	shmem->sequence = cpu_to_le32(seq + 1);
+
+	sbi_hart_unmap_saddr();
+}
+
+void sbi_sta_switch_out(struct sbi_sta_context *ctx)
+{
+	ctx->switch_out_time = sbi_timer_value();
+	if (ctx->enabled)
+		sta_update(ctx, 0, 1);
+}
+
+void sbi_sta_switch_in(struct sbi_sta_context *ctx)
+{
+	if (ctx->enabled)
+		sta_update(ctx, sbi_timer_value() - ctx->switch_out_time, 0);
+}
+
+int sbi_sta_set_shmem(unsigned long addr_lo, unsigned long addr_hi,
+		      unsigned long flags)
+{
+	struct sbi_context *dom_ctx = sbi_domain_context_thishart_ptr();
+	struct sbi_sta_context *ctx;
+
+	if (!dom_ctx)
+		return SBI_ENOTSUPP;
+
+	if (flags)
+		return SBI_EINVAL;
+
+	ctx = &dom_ctx->sta;
+	if (addr_lo == SBI_STA_SHMEM_DISABLE &&
+	    addr_hi == SBI_STA_SHMEM_DISABLE) {
+		ctx->enabled = false;
+		return 0;
+	}
+
+	if (addr_lo & (SBI_STA_SHMEM_SIZE - 1))
+		return SBI_EINVAL;
+
+	/* M-mode can only access shared memory below 4GB on RV32 */
+	if (addr_hi)
+		return SBI_EINVALID_ADDR;
+
+	if (!sbi_domain_check_shmem(addr_lo, SBI_STA_SHMEM_SIZE,
+				    SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_EINVALID_ADDR;
+
+	/* The steal time of a new record starts from zero */
+	sbi_hart_map_saddr(addr_lo, SBI_STA_SHMEM_SIZE);
+	sbi_memset((void *)addr_lo, 0, SBI_STA_SHMEM_SIZE);
+	sbi_hart_unmap_saddr();
+
+	ctx->shmem = addr_lo;
+	ctx->enabled = true;
+
+	return 0;
+}
@@ -0,0 +1,45 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Boot-time patching of the device callbacks used on hot paths
+ */
+
+#include <sbi/riscv_barrier.h>
+#include <sbi/sbi_static_call.h>
+
+#define SC_INSN_NOP			0x00000013U
+#define SC_INSN_JAL			0x0000006fU
+#define SC_INSN_AUIPC_T0		0x00000297U
+#define SC_INSN_JALR_ZERO_T0		0x00028067U
+
+/* Encode "jal zero, off" */
+static u32 sc_jal(unsigned long off)
+{
+	u32 imm = off;
+
+	return SC_INSN_JAL | ((imm & 0x100000) << 11) |
+	       ((imm & 0x7fe) << 20) | ((imm & 0x800) << 9) |
+	       (imm & 0xff000);
+}
+
+void __sbi_static_call_update(void *tramp, void *func)
+{
+	volatile u32 *insn = tramp;
+	long off = (unsigned long)func - (unsigned long)tramp;
+
+	if (-(1L << 20) <= off && off < (1L << 20)) {
+		insn[0] = sc_jal(off);
+		insn[1] = SC_INSN_NOP;
+	} else {
+		/*
+		 * Targets out of the range of jal, like the ones of a
+		 * platform in a separate image, need "auipc t0" followed
+		 * by "jalr zero, t0". The t0 register is a temporary for
+		 * the caller so the trampoline is free to clobber it.
+		 */
+		insn[1] = SC_INSN_JALR_ZERO_T0 | ((u32)off << 20);
+		insn[0] = SC_INSN_AUIPC_T0 | (((u32)off + 0x800) & 0xfffff000);
+	}
+
+	RISCV_FENCE_I;
+}
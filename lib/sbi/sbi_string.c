@@ -8,8 +8,9 @@
  */
 
 /*
- * Simple libc functions. These are not optimized at all and might have some
- * bugs as well. Use any optimized routines from newlib or glibc if required.
+ * Simple libc functions. Apart from the memory functions using word sized
+ * accesses these are not optimized at all and might have some bugs as well.
+ * Use any optimized routines from newlib or glibc if required.
  */
 
 #include <sbi/sbi_string.h>
@@ -109,9 +110,40 @@ char *sbi_strrchr(const char *s, int c)
 	else
 		return (char *)last;
 }
+#define WORD_SIZE		sizeof(unsigned long)
+#define WORD_MASK		(WORD_SIZE - 1)
+
+/*
+ * Word sized accesses are only used when both pointers share the same
+ * alignment within a word so that no misaligned access is ever made.
+ */
+#define WORD_COALIGNED(__a, __b)	\
+	((((unsigned long)(__a) ^ (unsigned long)(__b)) & WORD_MASK) == 0)
+
 void *sbi_memset(void *s, int c, size_t count)
 {
-	char *temp = s;
+	unsigned char *temp = s;
+	unsigned long *wtemp, word;
+
+	while (count > 0 && ((unsigned long)temp & WORD_MASK)) {
+		count--;
+		*temp++ = c;
+	}
+
+	if (count >= WORD_SIZE) {
+		word = (unsigned char)c;
+		word |= word << 8;
+		word |= word << 16;
+#if __riscv_xlen == 64
+		word |= word << 32;
+#endif
+		wtemp = (unsigned long *)temp;
+		while (count >= WORD_SIZE) {
+			*wtemp++ = word;
+			count -= WORD_SIZE;
+		}
+		temp = (unsigned char *)wtemp;
+	}
 
 	while (count > 0) {
 		count--;
@@ -125,6 +157,24 @@ void *sbi_memcpy(void *dest, const void *src, size_t count)
 {
 	char *temp1	  = dest;
 	const char *temp2 = src;
+	unsigned long *wtemp1;
+	const unsigned long *wtemp2;
+
+	if (WORD_COALIGNED(temp1, temp2)) {
+		while (count > 0 && ((unsigned long)temp1 & WORD_MASK)) {
+			*temp1++ = *temp2++;
+			count--;
+		}
+
+		wtemp1 = (unsigned long *)temp1;
+		wtemp2 = (const unsigned long *)temp2;
+		while (count >= WORD_SIZE) {
+			*wtemp1++ = *wtemp2++;
+			count -= WORD_SIZE;
+		}
+		temp1 = (char *)wtemp1;
+		temp2 = (const char *)wtemp2;
+	}
 
 	while (count > 0) {
 		*temp1++ = *temp2++;
@@ -138,23 +188,37 @@ void *sbi_memmove(void *dest, const void *src, size_t count)
 {
 	char *temp1	  = (char *)dest;
 	const char *temp2 = (char *)src;
+	unsigned long *wtemp1;
+	const unsigned long *wtemp2;
 
 	if (src == dest)
 		return dest;
 
-	if (dest < src) {
-		while (count > 0) {
-			*temp1++ = *temp2++;
+	if (dest < src)
+		return sbi_memcpy(dest, src, count);
+
+	temp1 = (char *)dest + count;
+	temp2 = (char *)src + count;
+
+	if (WORD_COALIGNED(temp1, temp2)) {
+		while (count > 0 && ((unsigned long)temp1 & WORD_MASK)) {
+			*--temp1 = *--temp2;
 			count--;
 		}
-	} else {
-		temp1 = (char *)dest + count - 1;
-		temp2 = (char *)src + count - 1;
 
-		while (count > 0) {
-			*temp1-- = *temp2--;
-			count--;
+		wtemp1 = (unsigned long *)temp1;
+		wtemp2 = (const unsigned long *)temp2;
+		while (count >= WORD_SIZE) {
+			*--wtemp1 = *--wtemp2;
+			count -= WORD_SIZE;
 		}
+		temp1 = (char *)wtemp1;
+		temp2 = (const char *)wtemp2;
+	}
+
+	while (count > 0) {
+		*--temp1 = *--temp2;
+		count--;
 	}
 
 	return dest;
@@ -165,6 +229,26 @@ int sbi_memcmp(const void *s1, const void *s2, size_t count)
 	const char *temp1 = s1;
 	const char *temp2 = s2;
 
+	if (WORD_COALIGNED(temp1, temp2)) {
+		while (count > 0 && ((unsigned long)temp1 & WORD_MASK) &&
+		       (*temp1 == *temp2)) {
+			temp1++;
+			temp2++;
+			count--;
+		}
+
+		/* Skip equal words, the differing word is compared bytewise */
+		if (!((unsigned long)temp1 & WORD_MASK)) {
+			while (count >= WORD_SIZE &&
+			       *(const unsigned long *)temp1 ==
+			       *(const unsigned long *)temp2) {
+				temp1 += WORD_SIZE;
+				temp2 += WORD_SIZE;
+				count -= WORD_SIZE;
+			}
+		}
+	}
+
 	for (; count > 0 && (*temp1 == *temp2); count--) {
 		temp1++;
 		temp2++;
@@ -189,3 +273,39 @@ void *sbi_memchr(const void *s, int c, size_t count)
 
 	return NULL;
 }
+
+unsigned long sbi_strtoul(const char *str, char **endptr, int base)
+{
+	unsigned long val = 0;
+	int digit;
+
+	while (*str == ' ' || *str == '\t')
+		str++;
+
+	if ((!base || base == 16) && str[0] == '0' &&
+	    (str[1] == 'x' || str[1] == 'X')) {
+		base = 16;
+		str += 2;
+	} else if (!base) {
+		base = (str[0] == '0') ? 8 : 10;
+	}
+
+	for (; *str; str++) {
+		if ('0' <= *str && *str <= '9')
+			digit = *str - '0';
+		else if ('a' <= *str && *str <= 'z')
+			digit = *str - 'a' + 10;
+		else if ('A' <= *str && *str <= 'Z')
+			digit = *str - 'A' + 10;
+		else
+			break;
+		if (digit >= base)
+			break;
+		val = val * base + digit;
+	}
+
+	if (endptr)
+		*endptr = (char *)str;
+
+	return val;
+}
@@ -9,10 +9,13 @@
  */
 
 #include <sbi/riscv_asm.h>
+#include <sbi/riscv_atomic.h>
 #include <sbi/sbi_bitops.h>
+#include <sbi/sbi_console.h>
 #include <sbi/sbi_domain.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_hsm.h>
+#include <sbi/sbi_irqchip.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_system.h>
 #include <sbi/sbi_ipi.h>
@@ -63,26 +66,71 @@ bool sbi_system_reset_supported(u32 reset_type, u32 reset_reason)
 	return !!sbi_system_reset_get_device(reset_type, reset_reason);
 }
 
+/* Longest time to wait for the other HARTs to quiesce before a reset */
+#define SBI_SYSTEM_RESET_QUIESCE_TIMEOUT_MS	100
+
+/* HARTs which have not yet acknowledged the HALT sent by a system reset */
+static struct sbi_hartmask reset_halt_pending;
+
+void sbi_system_reset_halt_ack(u32 hartindex)
+{
+	if (sbi_hartmask_test_hartindex(hartindex, &reset_halt_pending))
+		atomic_raw_clear_bit(hartindex, reset_halt_pending.bits);
+}
+
+static bool sbi_system_reset_quiesced(void *arg)
+{
+	u32 i;
+
+	for (i = 0; i < BITS_TO_LONGS(sbi_hartmask_used_bits()); i++) {
+		if (__atomic_load_n(&reset_halt_pending.bits[i],
+				    __ATOMIC_RELAXED))
+			return false;
+	}
+
+	return true;
+}
+
 void __noreturn sbi_system_reset(u32 reset_type, u32 reset_reason)
 {
-	ulong hbase = 0, hmask;
+	ulong i, hbase = 0, hmask;
 	u32 cur_hartid = current_hartid();
 	struct sbi_domain *dom = sbi_domain_thishart_ptr();
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 
-	/* Send HALT IPI to every hart other than the current hart */
+	/*
+	 * Send HALT IPI to every hart other than the current hart. The
+	 * targets are marked pending first and clear their bit on the
+	 * way out in sbi_exit().
+	 */
 	while (!sbi_hsm_hart_interruptible_mask(dom, hbase, &hmask)) {
 		if ((hbase <= cur_hartid)
 			  && (cur_hartid < hbase + BITS_PER_LONG))
 			hmask &= ~(1UL << (cur_hartid - hbase));
-		if (hmask)
+		if (hmask) {
+			for (i = 0; i < BITS_PER_LONG; i++) {
+				if (hmask & (1UL << i))
+					atomic_raw_set_bit(
+						sbi_hartid_to_hartindex(hbase + i),
+						reset_halt_pending.bits);
+			}
 			sbi_ipi_send_halt(hmask, hbase);
+		}
 		hbase += BITS_PER_LONG;
 	}
 
+	/* Wait for the other HARTs so the reset never races with them */
+	if (sbi_timer_get_device() &&
+	    !sbi_timer_waitms_until(sbi_system_reset_quiesced, NULL,
+				    SBI_SYSTEM_RESET_QUIESCE_TIMEOUT_MS))
+		sbi_printf("%s: not all HARTs quiesced in %dms\n", __func__,
+			   SBI_SYSTEM_RESET_QUIESCE_TIMEOUT_MS);
+
 	/* Stop current HART */
 	sbi_hsm_hart_stop(scratch, false);
 
+	sbi_console_flush();
+
 	/* Platform specific reset if domain allowed system reset */
 	if (dom->system_reset_allowed) {
 		const struct sbi_system_reset_device *dev =
@@ -146,6 +194,22 @@ bool sbi_system_suspend_supported(u32 sleep_type)
 	       suspend_dev->system_suspend_check(sleep_type) == 0;
 }
 
+/* The system suspend device was called and the system did not resume yet */
+static bool system_suspended;
+
+void sbi_system_resume(void)
+{
+	if (!system_suspended)
+		return;
+	system_suspended = false;
+
+	/*
+	 * The HART state is restored by the non-retentive suspend path,
+	 * only the devices restore what they lost.
+	 */
+	sbi_irqchip_system_resume();
+}
+
 int sbi_system_suspend(u32 sleep_type, ulong resume_addr, ulong opaque)
 {
 	struct sbi_domain *dom = sbi_domain_thishart_ptr();
@@ -171,17 +235,17 @@ int sbi_system_suspend(u32 sleep_type, ulong resume_addr, ulong opaque)
 	if (prev_mode != PRV_S && prev_mode != PRV_U)
 		return SBI_EFAIL;
 
-	spin_lock(&dom->assigned_harts_lock);
+	read_lock(&dom->assigned_harts_lock);
 	sbi_hartmask_for_each_hartindex(j, &dom->assigned_harts) {
 		i = sbi_hartindex_to_hartid(j);
 		if (i == hartid)
 			continue;
 		if (__sbi_hsm_hart_get_state(i) != SBI_HSM_STATE_STOPPED) {
-			spin_unlock(&dom->assigned_harts_lock);
+			read_unlock(&dom->assigned_harts_lock);
 			return SBI_ERR_DENIED;
 		}
 	}
-	spin_unlock(&dom->assigned_harts_lock);
+	read_unlock(&dom->assigned_harts_lock);
 
 	if (!sbi_domain_check_addr(dom, resume_addr, prev_mode,
 				   SBI_DOMAIN_EXECUTE))
@@ -197,10 +261,13 @@ int sbi_system_suspend(u32 sleep_type, ulong resume_addr, ulong opaque)
 	scratch->next_arg1 = opaque;
 
 	__sbi_hsm_suspend_non_ret_save(scratch);
+	sbi_irqchip_system_suspend();
 
 	/* Suspend */
+	system_suspended = true;
 	ret = suspend_dev->system_suspend(sleep_type, scratch->warmboot_addr);
 	if (ret != SBI_OK) {
+		system_suspended = false;
 		if (!sbi_hsm_hart_change_state(scratch, SBI_HSM_STATE_SUSPENDED,
 					       SBI_HSM_STATE_STARTED))
 			sbi_hart_hang();
@@ -10,18 +10,67 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/riscv_barrier.h>
 #include <sbi/riscv_encoding.h>
+#include <sbi/riscv_io.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_pmu.h>
 #include <sbi/sbi_scratch.h>
+#include <sbi/sbi_static_call.h>
 #include <sbi/sbi_timer.h>
+#include <sbi/sbi_trace.h>
 
 static unsigned long time_delta_off;
+static unsigned long time_addr_off;
+static unsigned long time_event_off;
+#ifdef CONFIG_SBI_TIMER_CYCLE_DELAY
+static unsigned long time_cycles_off;
+#endif
 static u64 (*get_time_val)(void);
 static const struct sbi_timer_device *timer_dev = NULL;
 
+/* Targets of the timer value and event callers before the device */
+static u64 timer_value_none(void)
+{
+	return 0;
+}
+
+static void timer_event_start_none(u64 next_event) { }
+
+SBI_STATIC_CALL_DEFINE(timer_value, timer_value_none);
+SBI_STATIC_CALL_DEFINE(timer_event_start, timer_event_start_none);
+
+static void timer_set_value_fn(u64 (*fn)(void))
+{
+	get_time_val = fn;
+	sbi_static_call_update(timer_value, fn);
+}
+
+/** Per-HART timer event last programmed in the timer device */
+struct timer_event_state {
+	u64 next_event;
+	bool programmed;
+};
+
+#ifdef CONFIG_SBI_TIMER_EVENTS
+/**
+ * Per-HART timer event multiplexer
+ *
+ * The timer device of a HART is shared by the S-mode deadline (only
+ * without Sstc) and a min-heap of firmware timer events, the earliest
+ * of which is always programmed.
+ */
+struct timer_mux {
+	u64 s_deadline;
+	bool s_armed;
+	u32 count;
+	struct sbi_timer_event *heap[SBI_TIMER_EVENT_MAX];
+};
+
+static unsigned long time_mux_off;
+#endif
+
 #if __riscv_xlen == 32
 static u64 get_ticks(void)
 {
@@ -49,6 +98,134 @@ static void nop_delay_fn(void *opaque)
 	cpu_relax();
 }
 
+/* Fixed point shift of the precomputed timer ticks per unit */
+#define TIMER_RECIP_SHIFT		24
+
+/**
+ * Timer ticks per millisecond or microsecond, rounded up so that the
+ * converted delays are never shorter, to avoid a 64-bit division (a
+ * libquad call on RV32) for every delay.
+ */
+struct timer_recip {
+	u64 unit_freq;
+	u64 ticks;
+	/* Largest number of units which does not overflow */
+	u64 max_units;
+};
+
+static struct timer_recip timer_recips[] = {
+	{ .unit_freq = 1000 },
+	{ .unit_freq = 1000000 },
+};
+
+static void timer_recip_init(void)
+{
+	struct timer_recip *r;
+	u32 i;
+
+	for (i = 0; i < array_size(timer_recips); i++) {
+		r = &timer_recips[i];
+		if (!timer_dev || ((u64)timer_dev->timer_freq >>
+				   (64 - TIMER_RECIP_SHIFT))) {
+			r->ticks = 0;
+			continue;
+		}
+		r->ticks = (((u64)timer_dev->timer_freq << TIMER_RECIP_SHIFT) +
+			    r->unit_freq - 1) / r->unit_freq;
+		r->max_units = r->ticks ? -1ULL / r->ticks : 0;
+	}
+}
+
+static u64 timer_units_to_ticks(u64 units, u64 unit_freq)
+{
+	const struct timer_recip *r;
+	u32 i;
+
+	for (i = 0; i < array_size(timer_recips); i++) {
+		r = &timer_recips[i];
+		if (r->unit_freq == unit_freq && r->ticks &&
+		    units <= r->max_units)
+			return (units * r->ticks) >> TIMER_RECIP_SHIFT;
+	}
+
+	return ((u64)timer_dev->timer_freq * units) / unit_freq;
+}
+
+#ifdef CONFIG_SBI_TIMER_CYCLE_DELAY
+/* Fixed point shift of the calibrated cycles per timer tick */
+#define TIMER_CYCLES_SHIFT		16
+
+/*
+ * Calibrate the mcycle frequency of current HART against the timer so
+ * that short delays can spin on mcycle instead of polling an MMIO timer.
+ */
+static void timer_cycles_calibrate(struct sbi_scratch *scratch)
+{
+	u64 *cycles_per_tick = sbi_scratch_offset_ptr(scratch, time_cycles_off);
+	u64 ticks, t0, t1, c0, c1;
+
+	/* Calibrate only once per HART, the result is kept across restarts */
+	if (*cycles_per_tick)
+		return;
+
+	/* Only useful when the timer is not read through the time CSR */
+	if (!timer_dev || !get_time_val || get_time_val == get_ticks)
+		return;
+
+	/* Calibrate over ~100us but at least 64 ticks */
+	ticks = timer_dev->timer_freq / 10000;
+	if (ticks < 64)
+		ticks = 64;
+
+	/* Align to a timer tick edge */
+	t0 = sbi_static_call(timer_value)();
+	while ((t1 = sbi_static_call(timer_value)()) == t0)
+		;
+
+	c0 = csr_read(CSR_MCYCLE);
+	while ((t0 = sbi_static_call(timer_value)()) - t1 < ticks)
+		;
+	c1 = csr_read(CSR_MCYCLE);
+
+	if (c1 > c0)
+		*cycles_per_tick = ((c1 - c0) << TIMER_CYCLES_SHIFT) / (t0 - t1);
+}
+
+static bool timer_cycles_delay(u64 delta, void (*delay_fn)(void *),
+			       void *opaque)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	u64 cycles, start;
+
+	if (!time_cycles_off)
+		return false;
+
+	cycles = sbi_scratch_read_type(scratch, u64, time_cycles_off);
+	if (!cycles)
+		return false;
+
+	/* S-mode might have stopped the cycle counter through the PMU */
+	if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_11 &&
+	    (csr_read(CSR_MCOUNTINHIBIT) & 0x1))
+		return false;
+
+	cycles = (delta * cycles) >> TIMER_CYCLES_SHIFT;
+	start = csr_read(CSR_MCYCLE);
+	while ((csr_read(CSR_MCYCLE) - start) < cycles)
+		delay_fn(opaque);
+
+	return true;
+}
+#else
+static inline void timer_cycles_calibrate(struct sbi_scratch *scratch) { }
+
+static inline bool timer_cycles_delay(u64 delta, void (*delay_fn)(void *),
+				      void *opaque)
+{
+	return false;
+}
+#endif
+
 void sbi_timer_delay_loop(ulong units, u64 unit_freq,
 			  void (*delay_fn)(void *), void *opaque)
 {
@@ -61,18 +238,22 @@ void sbi_timer_delay_loop(ulong units, u64 unit_freq,
 	}
 
 	/* Save starting timer value */
-	start_val = get_time_val();
+	start_val = sbi_static_call(timer_value)();
 
 	/* Compute desired timer value delta */
-	delta = ((u64)timer_dev->timer_freq * (u64)units);
-	delta = delta / unit_freq;
+	delta = timer_units_to_ticks(units, unit_freq);
 
 	/* Use NOP delay function if delay function not available */
 	if (!delay_fn)
 		delay_fn = nop_delay_fn;
 
+	/* Spin on the cycle counter for delays up to one millisecond */
+	if (delta <= timer_units_to_ticks(1, 1000) &&
+	    timer_cycles_delay(delta, delay_fn, opaque))
+		return;
+
 	/* Busy loop until desired timer value delta reached */
-	while ((get_time_val() - start_val) < delta)
+	while ((sbi_static_call(timer_value)() - start_val) < delta)
 		delay_fn(opaque);
 }
 
@@ -80,9 +261,7 @@ bool sbi_timer_waitms_until(bool (*predicate)(void *), void *arg,
 			    uint64_t timeout_ms)
 {
 	uint64_t start_time = sbi_timer_value();
-	uint64_t ticks =
-		(sbi_timer_get_device()->timer_freq / 1000) *
-		timeout_ms;
+	uint64_t ticks = timer_units_to_ticks(timeout_ms, 1000);
 	while(!predicate(arg))
 		if (sbi_timer_value() - start_time  >= ticks)
 			return false;
@@ -91,8 +270,19 @@ bool sbi_timer_waitms_until(bool (*predicate)(void *), void *arg,
 
 u64 sbi_timer_value(void)
 {
+#if __riscv_xlen != 32
+	volatile u64 *time_addr;
+
+	/* Read the timer directly when the device allows it */
+	if (time_addr_off) {
+		time_addr = sbi_scratch_read_type(sbi_scratch_thishart_ptr(),
+						  volatile u64 *, time_addr_off);
+		if (time_addr)
+			return readq_relaxed(time_addr);
+	}
+#endif
 	if (get_time_val)
-		return get_time_val();
+		return sbi_static_call(timer_value)();
 	return 0;
 }
 
@@ -129,38 +319,225 @@ void sbi_timer_set_delta_upper(ulong delta_upper)
 	*time_delta |= ((u64)delta_upper << 32);
 }
 
+static void timer_device_start(struct sbi_scratch *scratch, u64 next_event)
+{
+	struct timer_event_state *tes;
+
+	/* Skip the MMIO write when the deadline is unchanged */
+	tes = sbi_scratch_offset_ptr(scratch, time_event_off);
+	if (!tes->programmed || tes->next_event != next_event) {
+		sbi_static_call(timer_event_start)(next_event);
+		tes->next_event = next_event;
+		tes->programmed = true;
+	}
+}
+
+#ifdef CONFIG_SBI_TIMER_EVENTS
+static void timer_mux_swap(struct timer_mux *mux, u32 i, u32 j)
+{
+	struct sbi_timer_event *tmp = mux->heap[i];
+
+	mux->heap[i] = mux->heap[j];
+	mux->heap[i]->heap_index = i;
+	mux->heap[j] = tmp;
+	mux->heap[j]->heap_index = j;
+}
+
+static void timer_mux_sift_up(struct timer_mux *mux, u32 i)
+{
+	u32 parent;
+
+	while (i) {
+		parent = (i - 1) / 2;
+		if (mux->heap[parent]->deadline <= mux->heap[i]->deadline)
+			break;
+		timer_mux_swap(mux, i, parent);
+		i = parent;
+	}
+}
+
+static void timer_mux_sift_down(struct timer_mux *mux, u32 i)
+{
+	u32 l, r, min;
+
+	while (1) {
+		l = 2 * i + 1;
+		r = l + 1;
+		min = i;
+		if (l < mux->count &&
+		    mux->heap[l]->deadline < mux->heap[min]->deadline)
+			min = l;
+		if (r < mux->count &&
+		    mux->heap[r]->deadline < mux->heap[min]->deadline)
+			min = r;
+		if (min == i)
+			break;
+		timer_mux_swap(mux, i, min);
+		i = min;
+	}
+}
+
+static void timer_mux_remove(struct timer_mux *mux, u32 i)
+{
+	mux->heap[i]->queued = false;
+	mux->count--;
+	if (i == mux->count)
+		return;
+
+	mux->heap[i] = mux->heap[mux->count];
+	mux->heap[i]->heap_index = i;
+	timer_mux_sift_down(mux, i);
+	timer_mux_sift_up(mux, i);
+}
+
+/* Program the earliest of the S-mode deadline and firmware events */
+static void timer_mux_program(struct sbi_scratch *scratch,
+			      struct timer_mux *mux)
+{
+	u64 next_event = -1ULL;
+
+	if (!mux->s_armed && !mux->count) {
+		csr_clear(CSR_MIE, MIP_MTIP);
+		return;
+	}
+
+	if (mux->s_armed)
+		next_event = mux->s_deadline;
+	if (mux->count && mux->heap[0]->deadline < next_event)
+		next_event = mux->heap[0]->deadline;
+
+	if (timer_dev && timer_dev->timer_event_start)
+		timer_device_start(scratch, next_event);
+	csr_set(CSR_MIE, MIP_MTIP);
+}
+
+static void timer_mux_process(struct sbi_scratch *scratch)
+{
+	struct timer_mux *mux = sbi_scratch_offset_ptr(scratch, time_mux_off);
+	struct sbi_timer_event *ev;
+	u64 now = sbi_timer_value();
+
+	while (mux->count && mux->heap[0]->deadline <= now) {
+		ev = mux->heap[0];
+		timer_mux_remove(mux, 0);
+		/* The callback may queue the event again */
+		ev->callback(ev);
+	}
+
+	if (mux->s_armed && mux->s_deadline <= now) {
+		mux->s_armed = false;
+		csr_set(CSR_MIP, MIP_STIP);
+	}
+
+	timer_mux_program(scratch, mux);
+}
+
+int sbi_timer_event_add(struct sbi_timer_event *ev)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct timer_mux *mux;
+
+	if (!ev || !ev->callback)
+		return SBI_EINVAL;
+	if (ev->queued)
+		return SBI_EALREADY;
+	if (!time_mux_off)
+		return SBI_ENOTSUPP;
+
+	mux = sbi_scratch_offset_ptr(scratch, time_mux_off);
+	if (mux->count == SBI_TIMER_EVENT_MAX)
+		return SBI_ENOSPC;
+
+	ev->queued = true;
+	ev->heap_index = mux->count;
+	mux->heap[mux->count++] = ev;
+	timer_mux_sift_up(mux, ev->heap_index);
+
+	if (!ev->heap_index)
+		timer_mux_program(scratch, mux);
+
+	return 0;
+}
+
+void sbi_timer_event_cancel(struct sbi_timer_event *ev)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct timer_mux *mux;
+
+	if (!ev || !ev->queued || !time_mux_off)
+		return;
+
+	mux = sbi_scratch_offset_ptr(scratch, time_mux_off);
+	if (ev->heap_index >= mux->count || mux->heap[ev->heap_index] != ev)
+		return;
+
+	timer_mux_remove(mux, ev->heap_index);
+	timer_mux_program(scratch, mux);
+}
+#endif
+
 void sbi_timer_event_start(u64 next_event)
 {
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+#ifdef CONFIG_SBI_TIMER_EVENTS
+	struct timer_mux *mux;
+#endif
+
 	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_SET_TIMER);
+	sbi_trace(SBI_TRACE_TIMER, next_event, 0);
 
 	/**
 	 * Update the stimecmp directly if available. This allows
 	 * the older software to leverage sstc extension on newer hardware.
+	 * The S-mode timer interrupt is then raised by the hart itself so
+	 * the M-mode timer interrupt stays disabled.
 	 */
-	if (sbi_hart_has_extension(sbi_scratch_thishart_ptr(), SBI_HART_EXT_SSTC)) {
+	if (sbi_hart_has_hot_feature(scratch, SBI_HART_HOT_SSTC)) {
 #if __riscv_xlen == 32
 		csr_write(CSR_STIMECMP, next_event & 0xFFFFFFFF);
 		csr_write(CSR_STIMECMPH, next_event >> 32);
 #else
 		csr_write(CSR_STIMECMP, next_event);
 #endif
-	} else if (timer_dev && timer_dev->timer_event_start) {
-		timer_dev->timer_event_start(next_event);
+		return;
+	}
+
+#ifdef CONFIG_SBI_TIMER_EVENTS
+	mux = sbi_scratch_offset_ptr(scratch, time_mux_off);
+	mux->s_deadline = next_event;
+	mux->s_armed = true;
+	csr_clear(CSR_MIP, MIP_STIP);
+	timer_mux_program(scratch, mux);
+#else
+	if (timer_dev && timer_dev->timer_event_start) {
+		timer_device_start(scratch, next_event);
 		csr_clear(CSR_MIP, MIP_STIP);
 	}
 	csr_set(CSR_MIE, MIP_MTIP);
+#endif
 }
 
 void sbi_timer_process(void)
 {
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
 	csr_clear(CSR_MIE, MIP_MTIP);
+	sbi_console_drain();
+#ifdef CONFIG_SBI_TIMER_EVENTS
+	/*
+	 * Run the expired firmware timer events and only raise the S-mode
+	 * timer interrupt once the S-mode deadline is reached.
+	 */
+	timer_mux_process(scratch);
+#else
 	/*
 	 * If sstc extension is available, supervisor can receive the timer
 	 * directly without M-mode come in between. This function should
 	 * only invoked if M-mode programs the timer for its own purpose.
 	 */
-	if (!sbi_hart_has_extension(sbi_scratch_thishart_ptr(), SBI_HART_EXT_SSTC))
+	if (!sbi_hart_has_hot_feature(scratch, SBI_HART_HOT_SSTC))
 		csr_set(CSR_MIP, MIP_STIP);
+#endif
 }
 
 const struct sbi_timer_device *sbi_timer_get_device(void)
@@ -175,12 +552,15 @@ void sbi_timer_set_device(const struct sbi_timer_device *dev)
 
 	timer_dev = dev;
 	if (!get_time_val && timer_dev->timer_value)
-		get_time_val = timer_dev->timer_value;
+		timer_set_value_fn(timer_dev->timer_value);
+	sbi_static_call_update(timer_event_start, timer_dev->timer_event_start);
 }
 
 int sbi_timer_init(struct sbi_scratch *scratch, bool cold_boot)
 {
+	int rc;
 	u64 *time_delta;
+	struct timer_event_state *tes;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	if (cold_boot) {
@@ -188,24 +568,86 @@ int sbi_timer_init(struct sbi_scratch *scratch, bool cold_boot)
 		if (!time_delta_off)
 			return SBI_ENOMEM;
 
+		time_addr_off = sbi_scratch_alloc_type_offset(volatile u64 *);
+		if (!time_addr_off)
+			return SBI_ENOMEM;
+
+		time_event_off = sbi_scratch_alloc_type_offset(
+						struct timer_event_state);
+		if (!time_event_off)
+			return SBI_ENOMEM;
+
+#ifdef CONFIG_SBI_TIMER_EVENTS
+		time_mux_off = sbi_scratch_alloc_type_offset(struct timer_mux);
+		if (!time_mux_off)
+			return SBI_ENOMEM;
+#endif
+#ifdef CONFIG_SBI_TIMER_CYCLE_DELAY
+		time_cycles_off = sbi_scratch_alloc_type_offset(u64);
+		if (!time_cycles_off)
+			return SBI_ENOMEM;
+#endif
+
 		if (sbi_hart_has_extension(scratch, SBI_HART_EXT_ZICNTR))
-			get_time_val = get_ticks;
+			timer_set_value_fn(get_ticks);
 	} else {
-		if (!time_delta_off)
+		if (!time_delta_off || !time_addr_off || !time_event_off)
 			return SBI_ENOMEM;
 	}
 
 	time_delta = sbi_scratch_offset_ptr(scratch, time_delta_off);
 	*time_delta = 0;
 
-	return sbi_platform_timer_init(plat, cold_boot);
+	/* Timer device state is unknown after (re)initialization */
+	tes = sbi_scratch_offset_ptr(scratch, time_event_off);
+	tes->programmed = false;
+
+	rc = sbi_platform_timer_init(plat, cold_boot);
+	if (rc)
+		return rc;
+
+	if (cold_boot)
+		timer_recip_init();
+
+	/*
+	 * Cache the timer address of this HART unless the timer is read
+	 * through the time CSR or using the device callback is mandatory.
+	 */
+	if (timer_dev && timer_dev->timer_value_addr &&
+	    get_time_val == timer_dev->timer_value)
+		sbi_scratch_write_type(scratch, volatile u64 *, time_addr_off,
+				       timer_dev->timer_value_addr());
+
+	timer_cycles_calibrate(scratch);
+
+	return 0;
 }
 
 void sbi_timer_exit(struct sbi_scratch *scratch)
 {
+	struct timer_event_state *tes;
+#ifdef CONFIG_SBI_TIMER_EVENTS
+	struct timer_mux *mux;
+#endif
+
 	if (timer_dev && timer_dev->timer_event_stop)
 		timer_dev->timer_event_stop();
 
+	if (time_event_off) {
+		tes = sbi_scratch_offset_ptr(scratch, time_event_off);
+		tes->programmed = false;
+	}
+
+#ifdef CONFIG_SBI_TIMER_EVENTS
+	/* Firmware timer events of a stopped HART are dropped */
+	if (time_mux_off) {
+		mux = sbi_scratch_offset_ptr(scratch, time_mux_off);
+		while (mux->count)
+			timer_mux_remove(mux, mux->count - 1);
+		mux->s_armed = false;
+	}
+#endif
+
 	csr_clear(CSR_MIP, MIP_STIP);
 	csr_clear(CSR_MIE, MIP_MTIP);
 
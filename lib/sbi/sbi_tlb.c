@@ -11,11 +11,14 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/riscv_atomic.h>
 #include <sbi/riscv_barrier.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_bitops.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_fifo.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_heap.h>
 #include <sbi/sbi_ipi.h>
+#include <sbi/sbi_lockstat.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_tlb.h>
 #include <sbi/sbi_hfence.h>
@@ -23,17 +26,217 @@
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_pmu.h>
+#include <sbi/sbi_wait.h>
 
 static unsigned long tlb_sync_off;
 static unsigned long tlb_fifo_off;
 static unsigned long tlb_fifo_mem_off;
+static unsigned long tlb_bcast_pending_off;
+static unsigned long tlb_fence_i_off;
+static unsigned long tlb_overflow_off;
+
+SBI_LOCKSTAT_DEFINE(tlb_overflow_lock, NULL);
+static unsigned long tlb_fifo_stats_off;
+#ifdef CONFIG_SBI_RFENCE_BATCH
+static unsigned long tlb_batch_ptr_off;
+#endif
 static unsigned long tlb_range_flush_limit;
+/* Largest per-HART flush limit, used when preparing requests */
+static unsigned long tlb_range_flush_max;
+#ifdef CONFIG_SBI_TLB_FLUSH_CALIBRATE
+static unsigned long tlb_flush_limit_off;
+#endif
+
+SBI_FIFO_DEFINE_TYPED(tlb_fifo, struct sbi_tlb_info);
+
+/*
+ * Requests sent to at least this many HARTs are published once in the
+ * sender's broadcast slot instead of being copied into every target fifo.
+ */
+#define TLB_BCAST_MIN_HARTS		4
+
+/** Broadcast request descriptor shared by all targets of one sender */
+struct tlb_bcast_slot {
+	struct sbi_tlb_info tinfo;
+	/* Number of targets which have not yet processed tinfo */
+	atomic_t refcount;
+};
+
+/*
+ * FENCE.I carries no range so it bypasses the fifo: senders bump the
+ * request generation of each target and the target executes one fence.i
+ * covering every generation requested so far, merging requests from any
+ * number of senders.
+ */
+struct tlb_fence_i {
+	/* Generation requested by senders */
+	atomic_t req;
+	/* Generation covered by the last local fence.i */
+	atomic_t done;
+	/* Targets of FENCE.I requests sent by this HART */
+	struct sbi_hartmask targets;
+};
+
+/*
+ * Requests which do not fit in a full fifo are recorded here instead so
+ * that senders never wait for the target. The target performs one full
+ * flush of every recorded type before draining its fifo and then releases
+ * all recorded senders.
+ */
+struct tlb_overflow {
+	spinlock_t lock;
+	/* Bitmap of overflowed request types */
+	unsigned long types;
+	/* VMID of overflowed HFENCE.VVMA requests */
+	u16 vvma_vmid;
+	struct sbi_hartmask smask;
+};
+
+#define TLB_OVERFLOW_SFENCE	(BIT(SBI_TLB_SFENCE_VMA) | \
+				 BIT(SBI_TLB_SFENCE_VMA_ASID))
+#define TLB_OVERFLOW_GVMA	(BIT(SBI_TLB_HFENCE_GVMA) | \
+				 BIT(SBI_TLB_HFENCE_GVMA_VMID))
+#define TLB_OVERFLOW_VVMA	(BIT(SBI_TLB_HFENCE_VVMA) | \
+				 BIT(SBI_TLB_HFENCE_VVMA_ASID))
+
+/** Per-HART TLB fifo statistics */
+struct tlb_fifo_stats {
+	/* Number of entries of the fifo */
+	unsigned long depth;
+	/* Largest number of queued entries seen by senders */
+	unsigned long high_water;
+	/* Number of requests recorded in the overflow state */
+	unsigned long overflows;
+};
+
+/* Broadcast slots indexed by sender HART index */
+static struct tlb_bcast_slot *tlb_bcast_slots;
+
+#define tlb_bcast_thishart_slot()					\
+	(&tlb_bcast_slots[sbi_hartid_to_hartindex(current_hartid())])
+
+/*
+ * Per-HART index of the fifo holding the position (plus one) of the most
+ * recently queued entry for each hash of (type, asid, vmid). Slots are only
+ * hints written without locking: a stale or colliding slot is rejected by
+ * sbi_fifo_inplace_update_pos() or by the key check of the callback.
+ */
+#define TLB_FIFO_INDEX_SHIFT		4
+#define TLB_FIFO_INDEX_SLOTS		(1UL << TLB_FIFO_INDEX_SHIFT)
+
+struct tlb_fifo_index {
+	unsigned long pos[TLB_FIFO_INDEX_SLOTS];
+};
+
+static unsigned long tlb_fifo_index_off;
+
+static inline bool tlb_type_mergeable(enum sbi_tlb_type type)
+{
+	return type != SBI_TLB_FENCE_I && type != SBI_TLB_BATCH;
+}
+
+static inline unsigned long *tlb_fifo_index_slot(struct sbi_scratch *scratch,
+						 struct sbi_tlb_info *tinfo)
+{
+	struct tlb_fifo_index *index =
+			sbi_scratch_offset_ptr(scratch, tlb_fifo_index_off);
+	u32 key = tinfo->asid | ((u32)tinfo->vmid << 16);
+
+	key = (key ^ tinfo->type) * 0x9E3779B1U;
+	return &index->pos[key >> (32 - TLB_FIFO_INDEX_SHIFT)];
+}
+
+static inline bool tlb_same_key(struct sbi_tlb_info *a,
+				struct sbi_tlb_info *b)
+{
+	return a->type == b->type && a->asid == b->asid && a->vmid == b->vmid;
+}
+
+/*
+ * Svinval lets a range be invalidated without full ordering per page so
+ * HARTs having it use a larger range flush limit.
+ */
+#define TLB_SVINVAL_LIMIT_SHIFT		2
 
 static void tlb_flush_all(void)
 {
 	__asm__ __volatile("sfence.vma");
 }
 
+static inline bool tlb_has_svinval(struct sbi_scratch *scratch)
+{
+	return sbi_hart_has_hot_feature(scratch, SBI_HART_HOT_SVINVAL);
+}
+
+static unsigned long tlb_hart_flush_limit(struct sbi_scratch *scratch)
+{
+	if (tlb_has_svinval(scratch))
+		return tlb_range_flush_limit << TLB_SVINVAL_LIMIT_SHIFT;
+	return tlb_range_flush_limit;
+}
+
+#ifdef CONFIG_SBI_TLB_FLUSH_CALIBRATE
+
+/* Number of pages flushed when measuring per-page sfence.vma cost */
+#define TLB_CALIBRATE_PAGES		32
+
+static unsigned long tlb_calibrate_flush_limit(struct sbi_scratch *scratch)
+{
+	unsigned long i, start, page_cycles, full_cycles;
+	unsigned long limit = tlb_hart_flush_limit(scratch);
+
+	start = csr_read(CSR_MCYCLE);
+	if (tlb_has_svinval(scratch)) {
+		__sbi_sinval_vma_range(0, TLB_CALIBRATE_PAGES * PAGE_SIZE);
+	} else {
+		for (i = 0; i < TLB_CALIBRATE_PAGES; i++) {
+			__asm__ __volatile__("sfence.vma %0"
+					     :
+					     : "r"(i * PAGE_SIZE)
+					     : "memory");
+		}
+	}
+	page_cycles = (csr_read(CSR_MCYCLE) - start) / TLB_CALIBRATE_PAGES;
+
+	start = csr_read(CSR_MCYCLE);
+	tlb_flush_all();
+	full_cycles = csr_read(CSR_MCYCLE) - start;
+
+	/*
+	 * A full flush also costs TLB refills afterwards which can not
+	 * be measured here so always allow at least one page.
+	 */
+	if (!page_cycles || full_cycles >= page_cycles * (limit / PAGE_SIZE))
+		return limit;
+	if (full_cycles < page_cycles)
+		return PAGE_SIZE;
+
+	return (full_cycles / page_cycles) * PAGE_SIZE;
+}
+
+static inline unsigned long tlb_local_flush_limit(void)
+{
+	return sbi_scratch_read_type(sbi_scratch_thishart_ptr(),
+				     unsigned long, tlb_flush_limit_off);
+}
+
+#else
+
+static inline unsigned long tlb_local_flush_limit(void)
+{
+	return tlb_hart_flush_limit(sbi_scratch_thishart_ptr());
+}
+
+#endif
+
+/* Check whether a request is better served by flushing everything */
+static inline bool tlb_flush_whole(struct sbi_tlb_info *tinfo)
+{
+	return (tinfo->start == 0 && tinfo->size == 0) ||
+	       (tinfo->size == SBI_TLB_FLUSH_ALL) ||
+	       (tinfo->size > tlb_local_flush_limit());
+}
+
 static void sbi_tlb_local_hfence_vvma(struct sbi_tlb_info *tinfo)
 {
 	unsigned long start = tinfo->start;
@@ -46,11 +249,16 @@ static void sbi_tlb_local_hfence_vvma(struct sbi_tlb_info *tinfo)
 	hgatp = csr_swap(CSR_HGATP,
 			 (vmid << HGATP_VMID_SHIFT) & HGATP_VMID_MASK);
 
-	if ((start == 0 && size == 0) || (size == SBI_TLB_FLUSH_ALL)) {
+	if (tlb_flush_whole(tinfo)) {
 		__sbi_hfence_vvma_all();
 		goto done;
 	}
 
+	if (tlb_has_svinval(sbi_scratch_thishart_ptr())) {
+		__sbi_hinval_vvma_range(start, size);
+		goto done;
+	}
+
 	for (i = 0; i < size; i += PAGE_SIZE) {
 		__sbi_hfence_vvma_va(start+i);
 	}
@@ -67,11 +275,16 @@ static void sbi_tlb_local_hfence_gvma(struct sbi_tlb_info *tinfo)
 
 	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_HFENCE_GVMA_RCVD);
 
-	if ((start == 0 && size == 0) || (size == SBI_TLB_FLUSH_ALL)) {
+	if (tlb_flush_whole(tinfo)) {
 		__sbi_hfence_gvma_all();
 		return;
 	}
 
+	if (tlb_has_svinval(sbi_scratch_thishart_ptr())) {
+		__sbi_hinval_gvma_range(start, size);
+		return;
+	}
+
 	for (i = 0; i < size; i += PAGE_SIZE) {
 		__sbi_hfence_gvma_gpa((start + i) >> 2);
 	}
@@ -85,11 +298,16 @@ static void sbi_tlb_local_sfence_vma(struct sbi_tlb_info *tinfo)
 
 	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_SFENCE_VMA_RCVD);
 
-	if ((start == 0 && size == 0) || (size == SBI_TLB_FLUSH_ALL)) {
+	if (tlb_flush_whole(tinfo)) {
 		tlb_flush_all();
 		return;
 	}
 
+	if (tlb_has_svinval(sbi_scratch_thishart_ptr())) {
+		__sbi_sinval_vma_range(start, size);
+		return;
+	}
+
 	for (i = 0; i < size; i += PAGE_SIZE) {
 		__asm__ __volatile__("sfence.vma %0"
 				     :
@@ -111,11 +329,16 @@ static void sbi_tlb_local_hfence_vvma_asid(struct sbi_tlb_info *tinfo)
 	hgatp = csr_swap(CSR_HGATP,
 			 (vmid << HGATP_VMID_SHIFT) & HGATP_VMID_MASK);
 
-	if ((start == 0 && size == 0) || (size == SBI_TLB_FLUSH_ALL)) {
+	if (tlb_flush_whole(tinfo)) {
 		__sbi_hfence_vvma_asid(asid);
 		goto done;
 	}
 
+	if (tlb_has_svinval(sbi_scratch_thishart_ptr())) {
+		__sbi_hinval_vvma_asid_range(start, size, asid);
+		goto done;
+	}
+
 	for (i = 0; i < size; i += PAGE_SIZE) {
 		__sbi_hfence_vvma_asid_va(start + i, asid);
 	}
@@ -133,11 +356,16 @@ static void sbi_tlb_local_hfence_gvma_vmid(struct sbi_tlb_info *tinfo)
 
 	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_HFENCE_GVMA_VMID_RCVD);
 
-	if ((start == 0 && size == 0) || (size == SBI_TLB_FLUSH_ALL)) {
+	if (tlb_flush_whole(tinfo)) {
 		__sbi_hfence_gvma_vmid(vmid);
 		return;
 	}
 
+	if (tlb_has_svinval(sbi_scratch_thishart_ptr())) {
+		__sbi_hinval_gvma_vmid_range(start, size, vmid);
+		return;
+	}
+
 	for (i = 0; i < size; i += PAGE_SIZE) {
 		__sbi_hfence_gvma_vmid_gpa((start + i) >> 2, vmid);
 	}
@@ -153,7 +381,7 @@ static void sbi_tlb_local_sfence_vma_asid(struct sbi_tlb_info *tinfo)
 	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_SFENCE_VMA_ASID_RCVD);
 
 	/* Flush entire MM context for a given ASID */
-	if ((start == 0 && size == 0) || (size == SBI_TLB_FLUSH_ALL)) {
+	if (tlb_flush_whole(tinfo)) {
 		__asm__ __volatile__("sfence.vma x0, %0"
 				     :
 				     : "r"(asid)
@@ -161,6 +389,11 @@ static void sbi_tlb_local_sfence_vma_asid(struct sbi_tlb_info *tinfo)
 		return;
 	}
 
+	if (tlb_has_svinval(sbi_scratch_thishart_ptr())) {
+		__sbi_sinval_vma_asid_range(start, size, asid);
+		return;
+	}
+
 	for (i = 0; i < size; i += PAGE_SIZE) {
 		__asm__ __volatile__("sfence.vma %0, %1"
 				     :
@@ -176,6 +409,21 @@ static void sbi_tlb_local_fence_i(struct sbi_tlb_info *tinfo)
 	__asm__ __volatile("fence.i");
 }
 
+static void tlb_entry_local_process(struct sbi_tlb_info *data);
+
+/*
+ * A batch request points to the batch buffer of the sender HART which
+ * stays valid until the sender is done waiting in tlb_sync().
+ */
+static void tlb_entry_local_process_batch(struct sbi_tlb_info *tinfo)
+{
+	struct sbi_tlb_info *entries = (struct sbi_tlb_info *)tinfo->start;
+	unsigned long i;
+
+	for (i = 0; i < tinfo->size; i++)
+		tlb_entry_local_process(&entries[i]);
+}
+
 static void tlb_entry_local_process(struct sbi_tlb_info *data)
 {
 	if (unlikely(!data))
@@ -203,20 +451,26 @@ static void tlb_entry_local_process(struct sbi_tlb_info *data)
 	case SBI_TLB_HFENCE_VVMA:
 		sbi_tlb_local_hfence_vvma(data);
 		break;
+	case SBI_TLB_BATCH:
+		tlb_entry_local_process_batch(data);
+		break;
 	default:
 		break;
 	};
 }
 
-static void tlb_entry_process(struct sbi_tlb_info *tinfo)
+void sbi_tlb_local_process(struct sbi_tlb_info *tinfo)
+{
+	tlb_entry_local_process(tinfo);
+}
+
+static void tlb_release_senders(struct sbi_hartmask *smask)
 {
 	u32 rindex;
 	struct sbi_scratch *rscratch = NULL;
 	atomic_t *rtlb_sync = NULL;
 
-	tlb_entry_local_process(tinfo);
-
-	sbi_hartmask_for_each_hartindex(rindex, &tinfo->smask) {
+	sbi_hartmask_for_each_hartindex(rindex, smask) {
 		rscratch = sbi_hartindex_to_scratch(rindex);
 		if (!rscratch)
 			continue;
@@ -226,14 +480,186 @@ static void tlb_entry_process(struct sbi_tlb_info *tinfo)
 	}
 }
 
+static void tlb_entry_process(struct sbi_tlb_info *tinfo)
+{
+	tlb_entry_local_process(tinfo);
+	tlb_release_senders(&tinfo->smask);
+}
+
+static bool tlb_overflow_process(struct sbi_scratch *scratch)
+{
+	struct tlb_overflow *ov =
+			sbi_scratch_offset_ptr(scratch, tlb_overflow_off);
+	struct sbi_hartmask smask;
+	unsigned long types, hgatp;
+	u16 vmid;
+
+	if (!__smp_load_acquire(&ov->types))
+		return false;
+
+	spin_lock(&ov->lock);
+	types = ov->types;
+	vmid = ov->vvma_vmid;
+	smask = ov->smask;
+	ov->types = 0;
+	SBI_HARTMASK_INIT(&ov->smask);
+	spin_unlock(&ov->lock);
+
+	if (types & TLB_OVERFLOW_SFENCE)
+		tlb_flush_all();
+	if (types & TLB_OVERFLOW_GVMA)
+		__sbi_hfence_gvma_all();
+	if (types & TLB_OVERFLOW_VVMA) {
+		hgatp = csr_swap(CSR_HGATP,
+				 ((unsigned long)vmid << HGATP_VMID_SHIFT) &
+				 HGATP_VMID_MASK);
+		__sbi_hfence_vvma_all();
+		csr_write(CSR_HGATP, hgatp);
+	}
+
+	tlb_release_senders(&smask);
+
+	return true;
+}
+
+/*
+ * Record a request which did not fit in the fifo of the target. Batches
+ * and HFENCE.VVMA requests for a second VMID can not be represented and
+ * return false.
+ */
+static bool tlb_overflow_add(struct sbi_scratch *remote_scratch,
+			     struct sbi_tlb_info *tinfo)
+{
+	struct tlb_overflow *ov =
+			sbi_scratch_offset_ptr(remote_scratch, tlb_overflow_off);
+	struct tlb_fifo_stats *stats =
+			sbi_scratch_offset_ptr(remote_scratch, tlb_fifo_stats_off);
+	bool ret = false;
+
+	if (tinfo->type == SBI_TLB_BATCH)
+		return false;
+
+	spin_lock(&ov->lock);
+
+	if (BIT(tinfo->type) & TLB_OVERFLOW_VVMA) {
+		if ((ov->types & TLB_OVERFLOW_VVMA) &&
+		    ov->vvma_vmid != tinfo->vmid)
+			goto done;
+		ov->vvma_vmid = tinfo->vmid;
+	}
+
+	sbi_hartmask_or(&ov->smask, &ov->smask, &tinfo->smask);
+	/* Pairs with the acquire in tlb_overflow_process() */
+	__smp_store_release(&ov->types, ov->types | BIT(tinfo->type));
+	stats->overflows++;
+	ret = true;
+
+done:
+	spin_unlock(&ov->lock);
+	return ret;
+}
+
+static bool tlb_bcast_process(struct sbi_scratch *scratch)
+{
+	struct sbi_hartmask *pending =
+			sbi_scratch_offset_ptr(scratch, tlb_bcast_pending_off);
+	struct tlb_bcast_slot *slot;
+	unsigned long i, bits;
+	bool processed = false;
+	int bit;
+
+	for (i = 0; i < BITS_TO_LONGS(sbi_hartmask_used_bits()); i++) {
+		if (!pending->bits[i])
+			continue;
+
+		/* Acquire ordering pairs with the barrier in tlb_update() */
+		bits = atomic_raw_xchg_ulong(&pending->bits[i], 0);
+		while (bits) {
+			bit = sbi_ffs(bits);
+			bits &= ~(1UL << bit);
+
+			slot = &tlb_bcast_slots[i * BITS_PER_LONG + bit];
+			tlb_entry_local_process(&slot->tinfo);
+			atomic_sub_return(&slot->refcount, 1);
+			processed = true;
+		}
+	}
+
+	return processed;
+}
+
+static bool tlb_fence_i_process(struct sbi_scratch *scratch)
+{
+	struct tlb_fence_i *fi = sbi_scratch_offset_ptr(scratch,
+							tlb_fence_i_off);
+	long req = atomic_read(&fi->req);
+
+	if (req == atomic_read(&fi->done))
+		return false;
+
+	/* Order the generation read before the fence.i */
+	smp_rmb();
+	sbi_tlb_local_fence_i(NULL);
+	__smp_store_release(&fi->done.counter, req);
+
+	return true;
+}
+
+static int tlb_fold_cb(void *in, void *data)
+{
+	struct sbi_tlb_info *curr = data;
+	struct sbi_tlb_info *prev = in;
+
+	if (!tlb_same_key(curr, prev) ||
+	    curr->start != 0 || curr->size != SBI_TLB_FLUSH_ALL)
+		return SBI_FIFO_UNCHANGED;
+
+	sbi_hartmask_or(&curr->smask, &curr->smask, &prev->smask);
+
+	return SBI_FIFO_UPDATED;
+}
+
+/*
+ * A full flush still queued for the same key supersedes the dequeued
+ * entry: hand its senders over to the full flush instead of flushing now.
+ * The full flush is queued behind the dequeued entry so they are still
+ * released once the flush is done.
+ */
+static bool tlb_fold_into_flush_all(struct sbi_scratch *scratch,
+				    struct sbi_fifo *tlb_fifo,
+				    struct sbi_tlb_info *tinfo)
+{
+	unsigned long pos;
+
+	if (!tlb_type_mergeable(tinfo->type))
+		return false;
+
+	pos = *tlb_fifo_index_slot(scratch, tinfo);
+	if (!pos)
+		return false;
+
+	return sbi_fifo_inplace_update_pos(tlb_fifo, pos - 1, tinfo,
+					   tlb_fold_cb) == SBI_FIFO_UPDATED;
+}
+
 static bool tlb_process_once(struct sbi_scratch *scratch)
 {
 	struct sbi_tlb_info tinfo;
 	struct sbi_fifo *tlb_fifo =
 			sbi_scratch_offset_ptr(scratch, tlb_fifo_off);
 
-	if (!sbi_fifo_dequeue(tlb_fifo, &tinfo)) {
-		tlb_entry_process(&tinfo);
+	if (tlb_fence_i_process(scratch))
+		return true;
+
+	if (tlb_overflow_process(scratch))
+		return true;
+
+	if (tlb_bcast_process(scratch))
+		return true;
+
+	if (!tlb_fifo_dequeue(tlb_fifo, &tinfo)) {
+		if (!tlb_fold_into_flush_all(scratch, tlb_fifo, &tinfo))
+			tlb_entry_process(&tinfo);
 		return true;
 	}
 
@@ -245,19 +671,79 @@ static void tlb_process(struct sbi_scratch *scratch)
 	while (tlb_process_once(scratch));
 }
 
+/*
+ * Wait for the FENCE.I targets of this HART. The request generation read
+ * here already includes the one added by this HART so waiting for the
+ * target to cover it is enough.
+ */
+static void tlb_fence_i_sync(struct sbi_scratch *scratch)
+{
+	struct tlb_fence_i *fi = sbi_scratch_offset_ptr(scratch,
+							tlb_fence_i_off);
+	struct tlb_fence_i *rfi;
+	struct sbi_scratch *rscratch;
+	long req, done;
+	u32 rindex;
+
+	sbi_hartmask_for_each_hartindex(rindex, &fi->targets) {
+		rscratch = sbi_hartindex_to_scratch(rindex);
+		if (!rscratch)
+			continue;
+
+		rfi = sbi_scratch_offset_ptr(rscratch, tlb_fence_i_off);
+		req = atomic_read(&rfi->req);
+		while (1) {
+			done = __smp_load_acquire(&rfi->done.counter);
+			if (done - req >= 0)
+				break;
+
+			sbi_ipi_forward_process();
+			if (!tlb_process_once(scratch))
+				sbi_wait_on((volatile unsigned long *)
+					    &rfi->done.counter, done);
+		}
+	}
+
+	SBI_HARTMASK_INIT(&fi->targets);
+}
+
 static void tlb_sync(struct sbi_scratch *scratch)
 {
 	atomic_t *tlb_sync =
 			sbi_scratch_offset_ptr(scratch, tlb_sync_off);
+	struct tlb_bcast_slot *slot = tlb_bcast_thishart_slot();
+	unsigned long start_cycle = csr_read(CSR_MCYCLE);
+	atomic_t *pending;
+	long count;
+
+	while (1) {
+		pending = tlb_sync;
+		count = atomic_read(pending);
+		if (count <= 0) {
+			pending = &slot->refcount;
+			count = atomic_read(pending);
+			if (count <= 0)
+				break;
+		}
 
-	while (atomic_read(tlb_sync) > 0) {
 		/*
 		 * While we are waiting for remote hart to set the sync,
-		 * consume fifo requests to avoid deadlock.
+		 * consume fifo requests to avoid deadlock. Requests from
+		 * remote harts come with an IPI which also ends the wait.
+		 * Cluster leaders also forward the IPIs queued for their
+		 * cluster since the remote hart may be waiting on those.
 		 */
-		tlb_process_once(scratch);
+		sbi_ipi_forward_process();
+		if (!tlb_process_once(scratch))
+			sbi_wait_on((volatile unsigned long *)&pending->counter,
+				    count);
 	}
 
+	tlb_fence_i_sync(scratch);
+
+	sbi_pmu_ctr_add_fw(SBI_PMU_FW_TLB_SYNC_CYCLES,
+			   csr_read(CSR_MCYCLE) - start_cycle);
+
 	return;
 }
 
@@ -288,7 +774,9 @@ static inline int tlb_range_check(struct sbi_tlb_info *curr,
 
 /**
  * Call back to decide if an inplace fifo update is required or next entry can
- * can be skipped. Here are the different cases that are being handled.
+ * can be skipped. The candidate entry is the one recorded in the fifo index
+ * for the same (type, asid, vmid). Here are the different cases that are
+ * being handled.
  *
  * Case1:
  *	if next flush request range lies within one of the existing entry, skip
@@ -316,18 +804,50 @@ static int tlb_update_cb(void *in, void *data)
 	curr = (struct sbi_tlb_info *)data;
 	next = (struct sbi_tlb_info *)in;
 
-	if (next->type == SBI_TLB_SFENCE_VMA_ASID &&
-	    curr->type == SBI_TLB_SFENCE_VMA_ASID) {
-		if (next->asid == curr->asid)
-			ret = tlb_range_check(curr, next);
-	} else if (next->type == SBI_TLB_SFENCE_VMA &&
-		   curr->type == SBI_TLB_SFENCE_VMA) {
+	if (tlb_type_mergeable(next->type) && tlb_same_key(curr, next))
 		ret = tlb_range_check(curr, next);
-	}
 
 	return ret;
 }
 
+/* Enqueue a request and record its position in the given index slot */
+static int tlb_fifo_index_enqueue(struct sbi_fifo *tlb_fifo,
+				  struct sbi_tlb_info *tinfo,
+				  unsigned long *slot_pos)
+{
+	unsigned long pos;
+	void *entry;
+	int ret;
+
+	ret = sbi_fifo_enqueue_start(tlb_fifo, &entry, &pos);
+	if (ret)
+		return ret;
+	*(struct sbi_tlb_info *)entry = *tinfo;
+	sbi_fifo_enqueue_finish(tlb_fifo, pos);
+
+	if (slot_pos)
+		*slot_pos = pos + 1;
+
+	return 0;
+}
+
+#ifdef CONFIG_SBI_TLB_FIFO_AUTOSIZE
+static void tlb_fifo_update_high_water(struct sbi_scratch *remote_scratch,
+				       struct sbi_fifo *tlb_fifo)
+{
+	struct tlb_fifo_stats *stats =
+			sbi_scratch_offset_ptr(remote_scratch, tlb_fifo_stats_off);
+	unsigned long used = sbi_fifo_avail(tlb_fifo);
+
+	/* Racy update is fine, this only steers the next fifo sizing */
+	if (stats->high_water < used)
+		stats->high_water = used;
+}
+#else
+static inline void tlb_fifo_update_high_water(struct sbi_scratch *remote_scratch,
+					      struct sbi_fifo *tlb_fifo) { }
+#endif
+
 static int tlb_update(struct sbi_scratch *scratch,
 			  struct sbi_scratch *remote_scratch,
 			  u32 remote_hartindex, void *data)
@@ -335,7 +855,11 @@ static int tlb_update(struct sbi_scratch *scratch,
 	int ret;
 	atomic_t *tlb_sync;
 	struct sbi_fifo *tlb_fifo_r;
+	struct sbi_hartmask *pending_r;
 	struct sbi_tlb_info *tinfo = data;
+	struct tlb_bcast_slot *slot;
+	struct tlb_fence_i *fi;
+	unsigned long pos, *slot_pos;
 	u32 curr_hartid = current_hartid();
 
 	/*
@@ -347,18 +871,52 @@ static int tlb_update(struct sbi_scratch *scratch,
 		return SBI_IPI_UPDATE_BREAK;
 	}
 
+	if (tinfo->type == SBI_TLB_FENCE_I) {
+		/* Prior stores are ordered by the fully fenced AMO */
+		fi = sbi_scratch_offset_ptr(remote_scratch, tlb_fence_i_off);
+		atomic_add_return(&fi->req, 1);
+		fi = sbi_scratch_offset_ptr(scratch, tlb_fence_i_off);
+		sbi_hartmask_set_hartindex(remote_hartindex, &fi->targets);
+		return SBI_IPI_UPDATE_SUCCESS;
+	}
+
+	/*
+	 * Broadcast requests only mark the sender slot as pending on
+	 * the remote HART, the descriptor itself is shared.
+	 */
+	slot = tlb_bcast_thishart_slot();
+	if (tinfo == &slot->tinfo) {
+		atomic_add_return(&slot->refcount, 1);
+		pending_r = sbi_scratch_offset_ptr(remote_scratch,
+						   tlb_bcast_pending_off);
+		/* Make descriptor visible before marking it pending */
+		smp_wmb();
+		atomic_raw_set_bit(sbi_hartid_to_hartindex(curr_hartid),
+				   pending_r->bits);
+		return SBI_IPI_UPDATE_SUCCESS;
+	}
+
 	tlb_fifo_r = sbi_scratch_offset_ptr(remote_scratch, tlb_fifo_off);
 
-	ret = sbi_fifo_inplace_update(tlb_fifo_r, data, tlb_update_cb);
+	ret = SBI_FIFO_UNCHANGED;
+	slot_pos = NULL;
+	if (tlb_type_mergeable(tinfo->type)) {
+		slot_pos = tlb_fifo_index_slot(remote_scratch, tinfo);
+		pos = *slot_pos;
+		if (pos)
+			ret = sbi_fifo_inplace_update_pos(tlb_fifo_r, pos - 1,
+							  data, tlb_update_cb);
+	}
 
-	if (ret == SBI_FIFO_UNCHANGED && sbi_fifo_enqueue(tlb_fifo_r, data) < 0) {
+	if (ret == SBI_FIFO_UNCHANGED &&
+	    tlb_fifo_index_enqueue(tlb_fifo_r, tinfo, slot_pos) < 0 &&
+	    !tlb_overflow_add(remote_scratch, tinfo)) {
 		/**
-		 * For now, Busy loop until there is space in the fifo.
+		 * Requests which can not be recorded in the overflow
+		 * state busy loop until there is space in the fifo.
 		 * There may be case where target hart is also
-		 * enqueue in source hart's fifo. Both hart may busy
-		 * loop leading to a deadlock.
-		 * TODO: Introduce a wait/wakeup event mechanism to handle
-		 * this properly.
+		 * enqueue in source hart's fifo so keep processing
+		 * our own queue meanwhile.
 		 */
 		tlb_process_once(scratch);
 		sbi_dprintf("hart%d: hart%d tlb fifo full\n", curr_hartid,
@@ -366,6 +924,8 @@ static int tlb_update(struct sbi_scratch *scratch,
 		return SBI_IPI_UPDATE_RETRY;
 	}
 
+	tlb_fifo_update_high_water(remote_scratch, tlb_fifo_r);
+
 	tlb_sync = sbi_scratch_offset_ptr(scratch, tlb_sync_off);
 	atomic_add_return(tlb_sync, 1);
 
@@ -391,39 +951,128 @@ static const u32 tlb_type_to_pmu_fw_event[SBI_TLB_TYPE_MAX] = {
 	[SBI_TLB_HFENCE_VVMA] = SBI_PMU_FW_HFENCE_VVMA_SENT,
 };
 
-int sbi_tlb_request(ulong hmask, ulong hbase, struct sbi_tlb_info *tinfo)
+static void tlb_request_prepare(struct sbi_tlb_info *tinfo)
 {
-	if (tinfo->type < 0 || tinfo->type >= SBI_TLB_TYPE_MAX)
-		return SBI_EINVAL;
-
 	/*
 	 * If address range to flush is too big then simply
 	 * upgrade it to flush all because we can only flush
 	 * 4KB at a time.
 	 */
-	if (tinfo->size > tlb_range_flush_limit) {
+	if (tinfo->size > tlb_range_flush_max) {
 		tinfo->start = 0;
 		tinfo->size = SBI_TLB_FLUSH_ALL;
 	}
 
 	sbi_pmu_ctr_incr_fw(tlb_type_to_pmu_fw_event[tinfo->type]);
+}
+
+static int tlb_request_send(ulong hmask, ulong hbase,
+			    struct sbi_tlb_info *tinfo)
+{
+	struct tlb_bcast_slot *slot;
+
+	/*
+	 * Publish requests targeting many HARTs in the broadcast slot
+	 * of this HART. The slot is free once the previous request has
+	 * been synced, otherwise fallback to per-HART fifo entries.
+	 */
+	slot = tlb_bcast_thishart_slot();
+	if (tinfo->type != SBI_TLB_FENCE_I &&
+	    (hbase == -1UL || sbi_popcount(hmask) >= TLB_BCAST_MIN_HARTS) &&
+	    !atomic_read(&slot->refcount)) {
+		sbi_memcpy(&slot->tinfo, tinfo, sizeof(*tinfo));
+		tinfo = &slot->tinfo;
+	}
 
 	return sbi_ipi_send_many(hmask, hbase, tlb_event, tinfo);
 }
 
+int sbi_tlb_request(ulong hmask, ulong hbase, struct sbi_tlb_info *tinfo)
+{
+	if (tinfo->type < 0 || tinfo->type >= SBI_TLB_BATCH)
+		return SBI_EINVAL;
+
+	tlb_request_prepare(tinfo);
+
+	return tlb_request_send(hmask, hbase, tinfo);
+}
+
+#ifdef CONFIG_SBI_RFENCE_BATCH
+struct sbi_tlb_info *sbi_tlb_batch_entries(void)
+{
+	return sbi_scratch_read_type(sbi_scratch_thishart_ptr(), void *,
+				     tlb_batch_ptr_off);
+}
+
+int sbi_tlb_request_batch(ulong hmask, ulong hbase, unsigned long count)
+{
+	struct sbi_tlb_info *entries = sbi_tlb_batch_entries();
+	struct sbi_tlb_info tinfo;
+	unsigned long i;
+
+	if (!entries)
+		return SBI_ENOTSUPP;
+	if (!count || count > SBI_TLB_BATCH_MAX)
+		return SBI_EINVAL;
+
+	for (i = 0; i < count; i++) {
+		if (entries[i].type < 0 || entries[i].type >= SBI_TLB_BATCH)
+			return SBI_EINVAL;
+	}
+
+	for (i = 0; i < count; i++)
+		tlb_request_prepare(&entries[i]);
+
+	SBI_TLB_INFO_INIT(&tinfo, (unsigned long)entries, count, 0, 0,
+			  SBI_TLB_BATCH, current_hartid());
+
+	return tlb_request_send(hmask, hbase, &tinfo);
+}
+#endif
+
+/*
+ * Number of entries of the fifo of a HART. With CONFIG_SBI_TLB_FIFO_AUTOSIZE
+ * a fifo which filled up is doubled when its HART is initialized again, up
+ * to one entry per remote HART which is enough as each sender has at most
+ * one request queued per target.
+ */
+static unsigned long tlb_fifo_depth(const struct sbi_platform *plat,
+				    struct tlb_fifo_stats *stats)
+{
+	unsigned long depth = sbi_platform_tlb_fifo_num_entries(plat);
+#ifdef CONFIG_SBI_TLB_FIFO_AUTOSIZE
+	unsigned long max = MAX(depth, sbi_scratch_last_hartindex());
+
+	if (stats->depth) {
+		depth = stats->depth;
+		if (stats->high_water >= depth)
+			depth = MIN(depth << 1, max);
+	}
+#endif
+
+	return depth;
+}
+
 int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot)
 {
 	int ret;
 	void *tlb_mem;
 	atomic_t *tlb_sync;
 	struct sbi_fifo *tlb_q;
+	struct sbi_hartmask *tlb_pending;
+	struct tlb_fence_i *fence_i;
+	struct tlb_overflow *ov;
+	struct tlb_fifo_stats *stats;
+	unsigned long depth;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	if (cold_boot) {
-		tlb_sync_off = sbi_scratch_alloc_offset(sizeof(*tlb_sync));
+		tlb_sync_off =
+			sbi_scratch_alloc_cacheline_offset(sizeof(*tlb_sync));
 		if (!tlb_sync_off)
 			return SBI_ENOMEM;
-		tlb_fifo_off = sbi_scratch_alloc_offset(sizeof(*tlb_q));
+		tlb_fifo_off =
+			sbi_scratch_alloc_cacheline_offset(sizeof(*tlb_q));
 		if (!tlb_fifo_off) {
 			sbi_scratch_free_offset(tlb_sync_off);
 			return SBI_ENOMEM;
@@ -434,8 +1083,28 @@ int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot)
 			sbi_scratch_free_offset(tlb_sync_off);
 			return SBI_ENOMEM;
 		}
+		tlb_bcast_pending_off =
+			sbi_scratch_alloc_offset(sizeof(*tlb_pending));
+		if (!tlb_bcast_pending_off) {
+			sbi_scratch_free_offset(tlb_fifo_mem_off);
+			sbi_scratch_free_offset(tlb_fifo_off);
+			sbi_scratch_free_offset(tlb_sync_off);
+			return SBI_ENOMEM;
+		}
+		tlb_bcast_slots = sbi_zalloc((sbi_scratch_last_hartindex() + 1) *
+					     sizeof(*tlb_bcast_slots));
+		if (!tlb_bcast_slots) {
+			sbi_scratch_free_offset(tlb_bcast_pending_off);
+			sbi_scratch_free_offset(tlb_fifo_mem_off);
+			sbi_scratch_free_offset(tlb_fifo_off);
+			sbi_scratch_free_offset(tlb_sync_off);
+			return SBI_ENOMEM;
+		}
 		ret = sbi_ipi_event_create(&tlb_ops);
 		if (ret < 0) {
+			sbi_free(tlb_bcast_slots);
+			tlb_bcast_slots = NULL;
+			sbi_scratch_free_offset(tlb_bcast_pending_off);
 			sbi_scratch_free_offset(tlb_fifo_mem_off);
 			sbi_scratch_free_offset(tlb_fifo_off);
 			sbi_scratch_free_offset(tlb_sync_off);
@@ -443,10 +1112,42 @@ int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot)
 		}
 		tlb_event = ret;
 		tlb_range_flush_limit = sbi_platform_tlbr_flush_limit(plat);
+		tlb_range_flush_max = tlb_range_flush_limit;
+#ifdef CONFIG_SBI_TLB_FLUSH_CALIBRATE
+		tlb_flush_limit_off =
+			sbi_scratch_alloc_type_offset(unsigned long);
+		if (!tlb_flush_limit_off)
+			return SBI_ENOMEM;
+#endif
+		tlb_fence_i_off =
+			sbi_scratch_alloc_cacheline_offset(sizeof(*fence_i));
+		if (!tlb_fence_i_off)
+			return SBI_ENOMEM;
+		tlb_fifo_index_off =
+			sbi_scratch_alloc_offset(sizeof(struct tlb_fifo_index));
+		if (!tlb_fifo_index_off)
+			return SBI_ENOMEM;
+		tlb_overflow_off = sbi_scratch_alloc_offset(sizeof(*ov));
+		if (!tlb_overflow_off)
+			return SBI_ENOMEM;
+		tlb_fifo_stats_off = sbi_scratch_alloc_offset(sizeof(*stats));
+		if (!tlb_fifo_stats_off)
+			return SBI_ENOMEM;
+#ifdef CONFIG_SBI_RFENCE_BATCH
+		tlb_batch_ptr_off = sbi_scratch_alloc_type_offset(void *);
+		if (!tlb_batch_ptr_off)
+			return SBI_ENOMEM;
+#endif
 	} else {
 		if (!tlb_sync_off ||
 		    !tlb_fifo_off ||
-		    !tlb_fifo_mem_off)
+		    !tlb_fifo_mem_off ||
+		    !tlb_bcast_pending_off ||
+		    !tlb_fence_i_off ||
+		    !tlb_fifo_index_off ||
+		    !tlb_overflow_off ||
+		    !tlb_fifo_stats_off ||
+		    !tlb_bcast_slots)
 			return SBI_ENOMEM;
 		if (SBI_IPI_EVENT_MAX <= tlb_event)
 			return SBI_ENOSPC;
@@ -454,19 +1155,62 @@ int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot)
 
 	tlb_sync = sbi_scratch_offset_ptr(scratch, tlb_sync_off);
 	tlb_q = sbi_scratch_offset_ptr(scratch, tlb_fifo_off);
+	tlb_pending = sbi_scratch_offset_ptr(scratch, tlb_bcast_pending_off);
+	stats = sbi_scratch_offset_ptr(scratch, tlb_fifo_stats_off);
+	depth = tlb_fifo_depth(plat, stats);
 	tlb_mem = sbi_scratch_read_type(scratch, void *, tlb_fifo_mem_off);
+	if (tlb_mem && depth != stats->depth) {
+		sbi_scratch_write_type(scratch, void *, tlb_fifo_mem_off, NULL);
+		sbi_free(tlb_mem);
+		tlb_mem = NULL;
+	}
 	if (!tlb_mem) {
-		tlb_mem = sbi_malloc(
-				sbi_platform_tlb_fifo_num_entries(plat) * SBI_TLB_INFO_SIZE);
+		tlb_mem = sbi_aligned_alloc(SBI_FIFO_MPSC_MEM_SIZE(depth,
+							SBI_TLB_INFO_SIZE),
+					    sbi_heap_cacheline_size());
 		if (!tlb_mem)
 			return SBI_ENOMEM;
 		sbi_scratch_write_type(scratch, void *, tlb_fifo_mem_off, tlb_mem);
 	}
+	stats->depth = depth;
+	stats->high_water = 0;
 
 	ATOMIC_INIT(tlb_sync, 0);
+	SBI_HARTMASK_INIT(tlb_pending);
+
+	fence_i = sbi_scratch_offset_ptr(scratch, tlb_fence_i_off);
+	ATOMIC_INIT(&fence_i->req, 0);
+	ATOMIC_INIT(&fence_i->done, 0);
+	SBI_HARTMASK_INIT(&fence_i->targets);
+
+	sbi_memset(sbi_scratch_offset_ptr(scratch, tlb_fifo_index_off), 0,
+		   sizeof(struct tlb_fifo_index));
+
+	ov = sbi_scratch_offset_ptr(scratch, tlb_overflow_off);
+	SPIN_LOCK_INIT(ov->lock);
+	sbi_lockstat_track(tlb_overflow_lock, &ov->lock);
+	ov->types = 0;
+	SBI_HARTMASK_INIT(&ov->smask);
+
+#ifdef CONFIG_SBI_RFENCE_BATCH
+	if (!sbi_scratch_read_type(scratch, void *, tlb_batch_ptr_off)) {
+		tlb_mem = sbi_zalloc(SBI_TLB_BATCH_MAX * SBI_TLB_INFO_SIZE);
+		if (!tlb_mem)
+			return SBI_ENOMEM;
+		sbi_scratch_write_type(scratch, void *, tlb_batch_ptr_off,
+				       tlb_mem);
+	}
+#endif
+
+	if (tlb_range_flush_max < tlb_hart_flush_limit(scratch))
+		tlb_range_flush_max = tlb_hart_flush_limit(scratch);
+
+#ifdef CONFIG_SBI_TLB_FLUSH_CALIBRATE
+	sbi_scratch_write_type(scratch, unsigned long, tlb_flush_limit_off,
+			       tlb_calibrate_flush_limit(scratch));
+#endif
 
-	sbi_fifo_init(tlb_q, tlb_mem,
-		      sbi_platform_tlb_fifo_num_entries(plat), SBI_TLB_INFO_SIZE);
+	sbi_fifo_mpsc_init(tlb_q, tlb_mem, depth, SBI_TLB_INFO_SIZE);
 
 	return 0;
 }
@@ -0,0 +1,141 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_barrier.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_heap.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_timer.h>
+#include <sbi/sbi_trace.h>
+
+#define TRACE_RING_ENTRIES	CONFIG_SBI_TRACE_RING_ENTRIES
+
+#if TRACE_RING_ENTRIES & (TRACE_RING_ENTRIES - 1)
+#error "CONFIG_SBI_TRACE_RING_ENTRIES must be a power of 2"
+#endif
+
+/** Per-HART trace ring, only written by its own HART */
+struct trace_ring {
+	/* Position of the next record */
+	unsigned long head;
+	/* Position of the oldest record not yet cleared by a reader */
+	unsigned long tail;
+	struct sbi_trace_record records[TRACE_RING_ENTRIES];
+};
+
+/** Offset of pointer to trace ring in scratch space */
+static unsigned long trace_ring_ptr_offset;
+
+#define trace_ring_get_ptr(__scratch)					\
+	(trace_ring_ptr_offset ?					\
+	 sbi_scratch_read_type((__scratch), void *,			\
+			       trace_ring_ptr_offset) : NULL)
+
+void sbi_trace(u32 event, u64 arg0, u64 arg1)
+{
+	struct trace_ring *r = trace_ring_get_ptr(sbi_scratch_thishart_ptr());
+	struct sbi_trace_record *rec;
+	unsigned long pos;
+
+	if (!r)
+		return;
+
+	/*
+	 * Claim the slot first so that a nested M-mode trap recording
+	 * its own event doesn't overwrite this record.
+	 */
+	pos = r->head++;
+	rec = &r->records[pos & (TRACE_RING_ENTRIES - 1)];
+	rec->time = sbi_timer_value();
+	rec->event = event;
+	rec->seq = pos;
+	rec->arg0 = arg0;
+	rec->arg1 = arg1;
+}
+
+int sbi_trace_read(u32 hartid, unsigned long addr_lo,
+		   unsigned long addr_hi, unsigned long size,
+		   unsigned long flags, unsigned long *out_count)
+{
+	struct sbi_scratch *scratch = sbi_hartid_to_scratch(hartid);
+	struct sbi_trace_record *dst;
+	struct trace_ring *r;
+	unsigned long pos, head, count = 0, max;
+
+	if (flags & ~SBI_EXT_OPENSBI_TRACE_FLAG_CLEAR)
+		return SBI_EINVAL;
+
+	if (!scratch)
+		return SBI_EINVAL;
+
+	r = trace_ring_get_ptr(scratch);
+	if (!r)
+		return SBI_ENOTSUPP;
+
+	/* M-mode can only access shared memory below 4GB on RV32 */
+	if (addr_hi)
+		return SBI_EINVALID_ADDR;
+
+	if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(),
+					 addr_lo, size, PRV_S,
+					 SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_EINVALID_ADDR;
+
+	max = size / sizeof(*dst);
+	dst = (struct sbi_trace_record *)addr_lo;
+
+	/*
+	 * The ring of another HART may be written while it is copied,
+	 * readers use the sequence numbers to drop torn records.
+	 */
+	head = __smp_load_acquire(&r->head);
+	pos = r->tail;
+	if (head - pos > TRACE_RING_ENTRIES)
+		pos = head - TRACE_RING_ENTRIES;
+
+	sbi_hart_map_saddr(addr_lo, size);
+	for (; pos != head && count < max; pos++)
+		sbi_memcpy(&dst[count++],
+			   &r->records[pos & (TRACE_RING_ENTRIES - 1)],
+			   sizeof(*dst));
+	sbi_hart_unmap_saddr();
+
+	if (flags & SBI_EXT_OPENSBI_TRACE_FLAG_CLEAR)
+		r->tail = pos;
+
+	*out_count = count;
+
+	return 0;
+}
+
+int sbi_trace_init(void)
+{
+	struct sbi_scratch *scratch;
+	struct trace_ring *r;
+	u32 i;
+
+	trace_ring_ptr_offset = sbi_scratch_alloc_type_offset(void *);
+	if (!trace_ring_ptr_offset)
+		return SBI_ENOMEM;
+
+	for (i = 0; i <= sbi_scratch_last_hartindex(); i++) {
+		scratch = sbi_hartindex_to_scratch(i);
+		if (!scratch)
+			continue;
+
+		r = sbi_zalloc(sizeof(*r));
+		if (!r)
+			return SBI_ENOMEM;
+
+		sbi_scratch_write_type(scratch, void *,
+				       trace_ring_ptr_offset, r);
+	}
+
+	return 0;
+}
@@ -17,13 +17,96 @@
 #include <sbi/sbi_illegal_insn.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_irqchip.h>
+#include <sbi/sbi_misaligned_stats.h>
 #include <sbi/sbi_trap_ldst.h>
 #include <sbi/sbi_pmu.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_sse.h>
 #include <sbi/sbi_timer.h>
+#include <sbi/sbi_trace.h>
 #include <sbi/sbi_trap.h>
 
+#ifdef CONFIG_SBI_TRAP_STATS
+static inline unsigned long sbi_trap_stats_start(void)
+{
+	return csr_read(CSR_MCYCLE);
+}
+
+static void sbi_trap_stats_irq(unsigned long irq)
+{
+	switch (irq) {
+	case IRQ_M_TIMER:
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_TRAP_IRQ_TIMER);
+		break;
+	case IRQ_M_SOFT:
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_TRAP_IRQ_SOFT);
+		break;
+	case IRQ_M_EXT:
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_TRAP_IRQ_EXT);
+		break;
+	default:
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_TRAP_IRQ_OTHER);
+		break;
+	}
+}
+
+static void sbi_trap_stats_irq_pass(unsigned long batch, bool exhausted)
+{
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_TRAP_IRQ_PASS);
+	sbi_pmu_ctr_add_fw(SBI_PMU_FW_TRAP_IRQ_BATCH, batch);
+	if (exhausted)
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_TRAP_IRQ_BUDGET_EXHAUSTED);
+}
+
+static void sbi_trap_stats_redirect(ulong cause, bool next_virt)
+{
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_TRAP_REDIRECT);
+	if (next_virt)
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_TRAP_REDIRECT_VS);
+
+	switch (cause) {
+	case CAUSE_ILLEGAL_INSTRUCTION:
+	case CAUSE_VIRTUAL_INST_FAULT:
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_TRAP_REDIRECT_ILLEGAL_INSN);
+		break;
+	case CAUSE_FETCH_PAGE_FAULT:
+	case CAUSE_LOAD_PAGE_FAULT:
+	case CAUSE_STORE_PAGE_FAULT:
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_TRAP_REDIRECT_PAGE_FAULT);
+		break;
+	case CAUSE_FETCH_GUEST_PAGE_FAULT:
+	case CAUSE_LOAD_GUEST_PAGE_FAULT:
+	case CAUSE_STORE_GUEST_PAGE_FAULT:
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_TRAP_REDIRECT_GUEST_PAGE_FAULT);
+		break;
+	default:
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_TRAP_REDIRECT_OTHER);
+		break;
+	}
+}
+
+static void sbi_trap_stats_end(ulong mcause, unsigned long start_cycle)
+{
+	unsigned long cycles = csr_read(CSR_MCYCLE) - start_cycle;
+
+	if (mcause & MCAUSE_IRQ_MASK)
+		sbi_pmu_ctr_add_fw(SBI_PMU_FW_TRAP_IRQ_CYCLES, cycles);
+	else if (mcause == CAUSE_SUPERVISOR_ECALL ||
+		 mcause == CAUSE_MACHINE_ECALL)
+		sbi_pmu_ctr_add_fw(SBI_PMU_FW_TRAP_ECALL_CYCLES, cycles);
+	else
+		sbi_pmu_ctr_add_fw(SBI_PMU_FW_TRAP_EXCEPTION_CYCLES, cycles);
+}
+#else
+static inline unsigned long sbi_trap_stats_start(void) { return 0; }
+static inline void sbi_trap_stats_irq(unsigned long irq) { }
+static inline void sbi_trap_stats_irq_pass(unsigned long batch,
+					   bool exhausted) { }
+static inline void sbi_trap_stats_redirect(ulong cause, bool next_virt) { }
+static inline void sbi_trap_stats_end(ulong mcause,
+				      unsigned long start_cycle) { }
+#endif
+
 static void sbi_trap_error_one(const struct sbi_trap_context *tcntx,
 			       const char *prefix, u32 hartid, u32 depth)
 {
@@ -102,7 +185,9 @@ static void __noreturn sbi_trap_error(const char *msg, int rc,
 int sbi_trap_redirect(struct sbi_trap_regs *regs,
 		      const struct sbi_trap_info *trap)
 {
-	ulong hstatus, vsstatus, prev_mode;
+	ulong hstatus, new_hstatus, vsstatus, prev_mode;
+	bool has_h = sbi_hart_has_hot_feature(sbi_scratch_thishart_ptr(),
+					      SBI_HART_HOT_H);
 #if __riscv_xlen == 32
 	bool prev_virt = (regs->mstatusH & MSTATUSH_MPV) ? true : false;
 #else
@@ -117,15 +202,18 @@ int sbi_trap_redirect(struct sbi_trap_regs *regs,
 		return SBI_ENOTSUPP;
 
 	/* If exceptions came from VS/VU-mode, redirect to VS-mode if
-	 * delegated in hedeleg
+	 * delegated in hedeleg. The hedeleg CSR is owned by the HS-mode
+	 * hypervisor so it can't be cached and is only read when needed.
 	 */
-	if (misa_extension('H') && prev_virt) {
+	if (has_h && prev_virt) {
 		if ((trap->cause < __riscv_xlen) &&
 		    (csr_read(CSR_HEDELEG) & BIT(trap->cause))) {
 			next_virt = true;
 		}
 	}
 
+	sbi_trap_stats_redirect(trap->cause, next_virt);
+
 	/* Update MSTATUS MPV bits */
 #if __riscv_xlen == 32
 	regs->mstatusH &= ~MSTATUSH_MPV;
@@ -136,18 +224,21 @@ int sbi_trap_redirect(struct sbi_trap_regs *regs,
 #endif
 
 	/* Update hypervisor CSRs if going to HS-mode */
-	if (misa_extension('H') && !next_virt) {
+	if (has_h && !next_virt) {
 		hstatus = csr_read(CSR_HSTATUS);
+		new_hstatus = hstatus;
 		if (prev_virt) {
 			/* hstatus.SPVP is only updated if coming from VS/VU-mode */
-			hstatus &= ~HSTATUS_SPVP;
-			hstatus |= (prev_mode == PRV_S) ? HSTATUS_SPVP : 0;
+			new_hstatus &= ~HSTATUS_SPVP;
+			new_hstatus |= (prev_mode == PRV_S) ? HSTATUS_SPVP : 0;
 		}
-		hstatus &= ~HSTATUS_SPV;
-		hstatus |= (prev_virt) ? HSTATUS_SPV : 0;
-		hstatus &= ~HSTATUS_GVA;
-		hstatus |= (trap->gva) ? HSTATUS_GVA : 0;
-		csr_write(CSR_HSTATUS, hstatus);
+		new_hstatus &= ~HSTATUS_SPV;
+		new_hstatus |= (prev_virt) ? HSTATUS_SPV : 0;
+		new_hstatus &= ~HSTATUS_GVA;
+		new_hstatus |= (trap->gva) ? HSTATUS_GVA : 0;
+		/* Most redirects leave hstatus as is so skip the write */
+		if (new_hstatus != hstatus)
+			csr_write(CSR_HSTATUS, new_hstatus);
 		csr_write(CSR_HTVAL, trap->tval2);
 		csr_write(CSR_HTINST, trap->tinst);
 	}
@@ -216,32 +307,67 @@ int sbi_trap_redirect(struct sbi_trap_regs *regs,
 
 static int sbi_trap_nonaia_irq(unsigned long irq)
 {
-	switch (irq) {
-	case IRQ_M_TIMER:
-		sbi_timer_process();
-		break;
-	case IRQ_M_SOFT:
-		sbi_ipi_process();
-		break;
-	case IRQ_PMU_OVF:
-		sbi_pmu_ovf_irq();
-		break;
-	case IRQ_M_EXT:
-		return sbi_irqchip_process();
-	default:
-		return SBI_ENOENT;
+	unsigned long pending, batch = 0;
+	int rc;
+
+	while (1) {
+		sbi_trap_stats_irq(irq);
+
+		switch (irq) {
+		case IRQ_M_TIMER:
+			sbi_timer_process();
+			break;
+		case IRQ_M_SOFT:
+			sbi_ipi_process();
+			break;
+		case IRQ_PMU_OVF:
+			sbi_pmu_ovf_irq();
+			break;
+		case IRQ_M_EXT:
+			rc = sbi_irqchip_process();
+			if (rc)
+				return rc;
+			break;
+		default:
+			/* Counter overflow interrupt of a custom PMU */
+			if (irq < __riscv_xlen &&
+			    (BIT(irq) & sbi_pmu_irq_bit())) {
+				sbi_pmu_ovf_irq();
+				break;
+			}
+			return SBI_ENOENT;
+		}
+		batch++;
+
+		/* Handle other pending M-mode interrupts without a new trap */
+		pending = csr_read(CSR_MIP) & csr_read(CSR_MIE) &
+			  ~csr_read(CSR_MIDELEG);
+		if (!pending || batch == CONFIG_SBI_TRAP_IRQ_BUDGET)
+			break;
+		irq = sbi_fls(pending);
 	}
 
+	sbi_trap_stats_irq_pass(batch, pending != 0);
+
 	return 0;
 }
 
 static int sbi_trap_aia_irq(void)
 {
 	int rc;
-	unsigned long mtopi;
+	unsigned long mtopi, batch = 0;
 
+	/*
+	 * Handle IPI, timer and external interrupts in one pass until
+	 * nothing is pending or the budget is used up.
+	 */
 	while ((mtopi = csr_read(CSR_MTOPI))) {
+		if (batch == CONFIG_SBI_TRAP_IRQ_BUDGET)
+			break;
+		batch++;
+
 		mtopi = mtopi >> TOPI_IID_SHIFT;
+		sbi_trap_stats_irq(mtopi);
 		switch (mtopi) {
 		case IRQ_M_TIMER:
 			sbi_timer_process();
@@ -258,10 +384,18 @@ static int sbi_trap_aia_irq(void)
 				return rc;
 			break;
 		default:
+			/* Counter overflow interrupt of a custom PMU */
+			if (mtopi < __riscv_xlen &&
+			    (BIT(mtopi) & sbi_pmu_irq_bit())) {
+				sbi_pmu_ovf_irq();
+				break;
+			}
 			return SBI_ENOENT;
 		}
 	}
 
+	sbi_trap_stats_irq_pass(batch, mtopi != 0);
+
 	return 0;
 }
 
@@ -289,14 +423,16 @@ struct sbi_trap_context *sbi_trap_handler(struct sbi_trap_context *tcntx)
 	const struct sbi_trap_info *trap = &tcntx->trap;
 	struct sbi_trap_regs *regs = &tcntx->regs;
 	ulong mcause = tcntx->trap.cause;
+	unsigned long start_cycle = sbi_trap_stats_start();
 
 	/* Update trap context pointer */
 	tcntx->prev_context = sbi_trap_get_context(scratch);
 	sbi_trap_set_context(scratch, tcntx);
 
+	sbi_trace(SBI_TRACE_TRAP, mcause, regs->mepc);
+
 	if (mcause & MCAUSE_IRQ_MASK) {
-		if (sbi_hart_has_extension(sbi_scratch_thishart_ptr(),
-					   SBI_HART_EXT_SMAIA))
+		if (sbi_hart_has_hot_feature(scratch, SBI_HART_HOT_SMAIA))
 			rc = sbi_trap_aia_irq();
 		else
 			rc = sbi_trap_nonaia_irq(mcause & ~MCAUSE_IRQ_MASK);
@@ -311,16 +447,23 @@ struct sbi_trap_context *sbi_trap_handler(struct sbi_trap_context *tcntx)
 		break;
 	case CAUSE_MISALIGNED_LOAD:
 		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_MISALIGNED_LOAD);
+		sbi_misaligned_stats_record(tcntx->regs.mepc,
+					    SBI_MISALIGNED_STATS_TYPE_LOAD);
 		rc  = sbi_misaligned_load_handler(tcntx);
 		msg = "misaligned load handler failed";
 		break;
 	case CAUSE_MISALIGNED_STORE:
 		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_MISALIGNED_STORE);
+		sbi_misaligned_stats_record(tcntx->regs.mepc,
+					    SBI_MISALIGNED_STATS_TYPE_STORE);
 		rc  = sbi_misaligned_store_handler(tcntx);
 		msg = "misaligned store handler failed";
 		break;
 	case CAUSE_SUPERVISOR_ECALL:
 	case CAUSE_MACHINE_ECALL:
+#ifdef CONFIG_SBI_TRAP_STATS
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_TRAP_ECALL);
+#endif
 		rc  = sbi_ecall_handler(tcntx);
 		msg = "ecall handler failed";
 		break;
@@ -348,6 +491,8 @@ trap_done:
 	if (((regs->mstatus & MSTATUS_MPP) >> MSTATUS_MPP_SHIFT) != PRV_M)
 		sbi_sse_process_pending_events(regs);
 
+	sbi_trap_stats_end(mcause, start_cycle);
+
 	sbi_trap_set_context(scratch, tcntx->prev_context);
 	return tcntx;
 }
@@ -11,6 +11,8 @@
 #include <sbi/riscv_encoding.h>
 #include <sbi/riscv_fp.h>
 #include <sbi/sbi_error.h>
+#include <sbi/sbi_misaligned_stats.h>
+#include <sbi/sbi_scratch.h>
 #include <sbi/sbi_trap_ldst.h>
 #include <sbi/sbi_trap.h>
 #include <sbi/sbi_unpriv.h>
@@ -32,8 +34,15 @@ typedef int (*sbi_trap_ld_emulator)(int rlen, union sbi_ldst_data *out_val,
 typedef int (*sbi_trap_st_emulator)(int wlen, union sbi_ldst_data in_val,
 				    struct sbi_trap_context *tcntx);
 
-static ulong sbi_misaligned_tinst_fixup(ulong orig_tinst, ulong new_tinst,
-					ulong addr_offset)
+/**
+ * Vector load/store emulator callback:
+ *
+ * @return 0=success or negative error
+ */
+typedef int (*sbi_trap_v_emulator)(ulong insn, struct sbi_trap_context *tcntx);
+
+ulong sbi_misaligned_tinst_fixup(ulong orig_tinst, ulong new_tinst,
+				 ulong addr_offset)
 {
 	if (new_tinst == INSN_PSEUDO_VS_LOAD ||
 	    new_tinst == INSN_PSEUDO_VS_STORE)
@@ -44,34 +53,21 @@ static ulong sbi_misaligned_tinst_fixup(ulong orig_tinst, ulong new_tinst,
 		return orig_tinst | (addr_offset << SH_RS1);
 }
 
-static int sbi_trap_emulate_load(struct sbi_trap_context *tcntx,
-				 sbi_trap_ld_emulator emu)
+/** Decoded load or store instruction */
+struct sbi_ldst_insn {
+	/*
+	 * Instruction with the destination register of loads at SH_RD and
+	 * the source register of stores at SH_RS2 irrespective of encoding
+	 */
+	ulong insn;
+	u8 len;
+	u8 shift;
+	u8 fp;
+};
+
+static int sbi_trap_decode_load(ulong insn, struct sbi_ldst_insn *d)
 {
-	const struct sbi_trap_info *orig_trap = &tcntx->trap;
-	struct sbi_trap_regs *regs = &tcntx->regs;
-	ulong insn, insn_len;
-	union sbi_ldst_data val = { 0 };
-	struct sbi_trap_info uptrap;
-	int rc, fp = 0, shift = 0, len = 0;
-
-	if (orig_trap->tinst & 0x1) {
-		/*
-		 * Bit[0] == 1 implies trapped instruction value is
-		 * transformed instruction or custom instruction.
-		 */
-		insn	 = orig_trap->tinst | INSN_16BIT_MASK;
-		insn_len = (orig_trap->tinst & 0x2) ? INSN_LEN(insn) : 2;
-	} else {
-		/*
-		 * Bit[0] == 0 implies trapped instruction value is
-		 * zero or special value.
-		 */
-		insn = sbi_get_insn(regs->mepc, &uptrap);
-		if (uptrap.cause) {
-			return sbi_trap_redirect(regs, &uptrap);
-		}
-		insn_len = INSN_LEN(insn);
-	}
+	int fp = 0, shift = 0, len = 0;
 
 	if ((insn & INSN_MASK_LB) == INSN_MATCH_LB) {
 		len   = 1;
@@ -145,57 +141,20 @@ static int sbi_trap_emulate_load(struct sbi_trap_context *tcntx,
 		shift = 8 * (sizeof(ulong) - len);
 		insn = RVC_RS2S(insn) << SH_RD;
 	} else {
-		return sbi_trap_redirect(regs, orig_trap);
+		return SBI_EINVAL;
 	}
 
-	rc = emu(len, &val, tcntx);
-	if (rc <= 0)
-		return rc;
-
-	if (!fp)
-		SET_RD(insn, regs, ((long)(val.data_ulong << shift)) >> shift);
-#ifdef __riscv_flen
-	else if (len == 8)
-		SET_F64_RD(insn, regs, val.data_u64);
-	else
-		SET_F32_RD(insn, regs, val.data_ulong);
-#endif
-
-	regs->mepc += insn_len;
+	d->insn	 = insn & (0x1fUL << SH_RD);
+	d->len	 = len;
+	d->shift = shift;
+	d->fp	 = fp;
 
 	return 0;
 }
 
-static int sbi_trap_emulate_store(struct sbi_trap_context *tcntx,
-				  sbi_trap_st_emulator emu)
+static int sbi_trap_decode_store(ulong insn, struct sbi_ldst_insn *d)
 {
-	const struct sbi_trap_info *orig_trap = &tcntx->trap;
-	struct sbi_trap_regs *regs = &tcntx->regs;
-	ulong insn, insn_len;
-	union sbi_ldst_data val;
-	struct sbi_trap_info uptrap;
-	int rc, len = 0;
-
-	if (orig_trap->tinst & 0x1) {
-		/*
-		 * Bit[0] == 1 implies trapped instruction value is
-		 * transformed instruction or custom instruction.
-		 */
-		insn	 = orig_trap->tinst | INSN_16BIT_MASK;
-		insn_len = (orig_trap->tinst & 0x2) ? INSN_LEN(insn) : 2;
-	} else {
-		/*
-		 * Bit[0] == 0 implies trapped instruction value is
-		 * zero or special value.
-		 */
-		insn = sbi_get_insn(regs->mepc, &uptrap);
-		if (uptrap.cause) {
-			return sbi_trap_redirect(regs, &uptrap);
-		}
-		insn_len = INSN_LEN(insn);
-	}
-
-	val.data_ulong = GET_RS2(insn, regs);
+	int fp = 0, len = 0;
 
 	if ((insn & INSN_MASK_SB) == INSN_MATCH_SB) {
 		len = 1;
@@ -207,52 +166,237 @@ static int sbi_trap_emulate_store(struct sbi_trap_context *tcntx,
 #endif
 #ifdef __riscv_flen
 	} else if ((insn & INSN_MASK_FSD) == INSN_MATCH_FSD) {
-		len	     = 8;
-		val.data_u64 = GET_F64_RS2(insn, regs);
+		fp  = 1;
+		len = 8;
 	} else if ((insn & INSN_MASK_FSW) == INSN_MATCH_FSW) {
-		len	       = 4;
-		val.data_ulong = GET_F32_RS2(insn, regs);
+		fp  = 1;
+		len = 4;
 #endif
 	} else if ((insn & INSN_MASK_SH) == INSN_MATCH_SH) {
 		len = 2;
 #if __riscv_xlen >= 64
 	} else if ((insn & INSN_MASK_C_SD) == INSN_MATCH_C_SD) {
-		len	       = 8;
-		val.data_ulong = GET_RS2S(insn, regs);
+		len  = 8;
+		insn = RVC_RS2S(insn) << SH_RS2;
 	} else if ((insn & INSN_MASK_C_SDSP) == INSN_MATCH_C_SDSP) {
-		len	       = 8;
-		val.data_ulong = GET_RS2C(insn, regs);
+		len  = 8;
+		insn = RVC_RS2(insn) << SH_RS2;
 #endif
 	} else if ((insn & INSN_MASK_C_SW) == INSN_MATCH_C_SW) {
-		len	       = 4;
-		val.data_ulong = GET_RS2S(insn, regs);
+		len  = 4;
+		insn = RVC_RS2S(insn) << SH_RS2;
 	} else if ((insn & INSN_MASK_C_SWSP) == INSN_MATCH_C_SWSP) {
-		len	       = 4;
-		val.data_ulong = GET_RS2C(insn, regs);
+		len  = 4;
+		insn = RVC_RS2(insn) << SH_RS2;
 #ifdef __riscv_flen
 	} else if ((insn & INSN_MASK_C_FSD) == INSN_MATCH_C_FSD) {
-		len	     = 8;
-		val.data_u64 = GET_F64_RS2S(insn, regs);
+		fp   = 1;
+		len  = 8;
+		insn = RVC_RS2S(insn) << SH_RS2;
 	} else if ((insn & INSN_MASK_C_FSDSP) == INSN_MATCH_C_FSDSP) {
-		len	     = 8;
-		val.data_u64 = GET_F64_RS2C(insn, regs);
+		fp   = 1;
+		len  = 8;
+		insn = RVC_RS2(insn) << SH_RS2;
 #if __riscv_xlen == 32
 	} else if ((insn & INSN_MASK_C_FSW) == INSN_MATCH_C_FSW) {
-		len	       = 4;
-		val.data_ulong = GET_F32_RS2S(insn, regs);
+		fp   = 1;
+		len  = 4;
+		insn = RVC_RS2S(insn) << SH_RS2;
 	} else if ((insn & INSN_MASK_C_FSWSP) == INSN_MATCH_C_FSWSP) {
-		len	       = 4;
-		val.data_ulong = GET_F32_RS2C(insn, regs);
+		fp   = 1;
+		len  = 4;
+		insn = RVC_RS2(insn) << SH_RS2;
 #endif
 #endif
 	} else if ((insn & INSN_MASK_C_SH) == INSN_MATCH_C_SH) {
-		len		= 2;
-		val.data_ulong = GET_RS2S(insn, regs);
+		len  = 2;
+		insn = RVC_RS2S(insn) << SH_RS2;
 	} else {
+		return SBI_EINVAL;
+	}
+
+	d->insn	 = insn & (0x1fUL << SH_RS2);
+	d->len	 = len;
+	d->shift = 0;
+	d->fp	 = fp;
+
+	return 0;
+}
+
+/*
+ * Small per-HART cache of decoded instructions indexed by mepc. The raw
+ * instruction is used as tag so a stale entry is never used when the
+ * code at mepc changes.
+ */
+#define LDST_CACHE_ENTRIES	8
+
+struct ldst_cache_entry {
+	ulong raw_insn;
+	bool store;
+	struct sbi_ldst_insn d;
+};
+
+static unsigned long ldst_cache_off;
+
+static int sbi_trap_decode(ulong mepc, ulong insn, bool store,
+			   struct sbi_ldst_insn *d)
+{
+	struct ldst_cache_entry *e = NULL;
+	int rc;
+
+	if (ldst_cache_off) {
+		e = sbi_scratch_thishart_offset_ptr(ldst_cache_off);
+		e += (mepc >> 1) % LDST_CACHE_ENTRIES;
+		if (e->raw_insn == insn && e->store == store) {
+			*d = e->d;
+			return 0;
+		}
+	}
+
+	rc = store ? sbi_trap_decode_store(insn, d) :
+		     sbi_trap_decode_load(insn, d);
+	if (rc)
+		return rc;
+
+	if (e) {
+		e->raw_insn = insn;
+		e->store = store;
+		e->d = *d;
+	}
+
+	return 0;
+}
+
+static int sbi_trap_get_insn(struct sbi_trap_context *tcntx,
+			     ulong *insn, ulong *insn_len)
+{
+	const struct sbi_trap_info *orig_trap = &tcntx->trap;
+	struct sbi_trap_regs *regs = &tcntx->regs;
+	struct sbi_trap_info uptrap;
+
+	if (orig_trap->tinst & 0x1) {
+		/*
+		 * Bit[0] == 1 implies trapped instruction value is
+		 * transformed instruction or custom instruction.
+		 */
+		*insn	  = orig_trap->tinst | INSN_16BIT_MASK;
+		*insn_len = (orig_trap->tinst & 0x2) ? INSN_LEN(*insn) : 2;
+	} else {
+		/*
+		 * Bit[0] == 0 implies trapped instruction value is
+		 * zero or special value.
+		 */
+		*insn = sbi_get_insn(regs->mepc, &uptrap);
+		if (uptrap.cause) {
+			return sbi_trap_redirect(regs, &uptrap);
+		}
+		*insn_len = INSN_LEN(*insn);
+	}
+
+	return 1;
+}
+
+#ifdef __riscv_flen
+/*
+ * M-mode can only move the FP registers while mstatus.FS is not Off so
+ * the FP state is checked once per emulated instruction, an FP access
+ * with FS Off is reported like the hardware would instead of faulting
+ * in M-mode on the register move.
+ */
+static int sbi_trap_fp_off(ulong insn, struct sbi_trap_regs *regs)
+{
+	struct sbi_trap_info trap = { 0 };
+
+	trap.cause = CAUSE_ILLEGAL_INSTRUCTION;
+	trap.tval = insn;
+	return sbi_trap_redirect(regs, &trap);
+}
+#endif
+
+static int sbi_trap_emulate_load(struct sbi_trap_context *tcntx,
+				 sbi_trap_ld_emulator emu,
+				 sbi_trap_v_emulator v_emu)
+{
+	const struct sbi_trap_info *orig_trap = &tcntx->trap;
+	struct sbi_trap_regs *regs = &tcntx->regs;
+	ulong insn, insn_len;
+	union sbi_ldst_data val = { 0 };
+	struct sbi_ldst_insn d;
+	int rc;
+
+	rc = sbi_trap_get_insn(tcntx, &insn, &insn_len);
+	if (rc <= 0)
+		return rc;
+
+	if (v_emu && IS_VECTOR_LOAD(insn))
+		return v_emu(insn, tcntx);
+
+	if (sbi_trap_decode(regs->mepc, insn, false, &d))
 		return sbi_trap_redirect(regs, orig_trap);
+
+#ifdef __riscv_flen
+	if (d.fp && !(regs->mstatus & MSTATUS_FS))
+		return sbi_trap_fp_off(insn, regs);
+#endif
+
+	rc = emu(d.len, &val, tcntx);
+	if (rc <= 0)
+		return rc;
+
+	if (!d.fp) {
+		SET_RD(d.insn, regs,
+		       ((long)(val.data_ulong << d.shift)) >> d.shift);
+#ifdef __riscv_flen
+	} else {
+		if (d.len == 8)
+			SET_F64_REG(d.insn, 7, regs, val.data_u64);
+		else
+			SET_F32_REG(d.insn, 7, regs, val.data_ulong);
+		SET_FS_DIRTY(regs);
+#endif
 	}
 
-	rc = emu(len, val, tcntx);
+	regs->mepc += insn_len;
+
+	return 0;
+}
+
+static int sbi_trap_emulate_store(struct sbi_trap_context *tcntx,
+				  sbi_trap_st_emulator emu,
+				  sbi_trap_v_emulator v_emu)
+{
+	const struct sbi_trap_info *orig_trap = &tcntx->trap;
+	struct sbi_trap_regs *regs = &tcntx->regs;
+	ulong insn, insn_len;
+	union sbi_ldst_data val;
+	struct sbi_ldst_insn d;
+	int rc;
+
+	rc = sbi_trap_get_insn(tcntx, &insn, &insn_len);
+	if (rc <= 0)
+		return rc;
+
+	if (v_emu && IS_VECTOR_STORE(insn))
+		return v_emu(insn, tcntx);
+
+	if (sbi_trap_decode(regs->mepc, insn, true, &d))
+		return sbi_trap_redirect(regs, orig_trap);
+
+#ifdef __riscv_flen
+	if (d.fp && !(regs->mstatus & MSTATUS_FS))
+		return sbi_trap_fp_off(insn, regs);
+#endif
+
+	if (!d.fp)
+		val.data_ulong = GET_RS2(d.insn, regs);
+#ifdef __riscv_flen
+	else if (d.len == 8)
+		val.data_u64 = GET_F64_RS2(d.insn, regs);
+	else
+		val.data_ulong = GET_F32_RS2(d.insn, regs);
+#endif
+
+	rc = emu(d.len, val, tcntx);
 	if (rc <= 0)
 		return rc;
 
@@ -261,29 +405,41 @@ static int sbi_trap_emulate_store(struct sbi_trap_context *tcntx,
 	return 0;
 }
 
+ulong sbi_misaligned_load_bytes(ulong addr, u8 *bytes, ulong len,
+				struct sbi_trap_info *uptrap)
+{
+	return sbi_copy_from_smode(bytes, addr, len, uptrap);
+}
+
+ulong sbi_misaligned_store_bytes(ulong addr, const u8 *bytes, ulong len,
+				 struct sbi_trap_info *uptrap)
+{
+	return sbi_copy_to_smode(addr, bytes, len, uptrap);
+}
+
 static int sbi_misaligned_ld_emulator(int rlen, union sbi_ldst_data *out_val,
 				      struct sbi_trap_context *tcntx)
 {
 	const struct sbi_trap_info *orig_trap = &tcntx->trap;
 	struct sbi_trap_regs *regs = &tcntx->regs;
 	struct sbi_trap_info uptrap;
-	int i;
-
-	for (i = 0; i < rlen; i++) {
-		out_val->data_bytes[i] =
-			sbi_load_u8((void *)(orig_trap->tval + i), &uptrap);
-		if (uptrap.cause) {
-			uptrap.tinst = sbi_misaligned_tinst_fixup(
-				orig_trap->tinst, uptrap.tinst, i);
-			return sbi_trap_redirect(regs, &uptrap);
-		}
+	ulong done;
+
+	done = sbi_misaligned_load_bytes(orig_trap->tval, out_val->data_bytes,
+					 rlen, &uptrap);
+	if (uptrap.cause) {
+		uptrap.tinst = sbi_misaligned_tinst_fixup(
+			orig_trap->tinst, uptrap.tinst, done);
+		return sbi_trap_redirect(regs, &uptrap);
 	}
+
 	return rlen;
 }
 
 int sbi_misaligned_load_handler(struct sbi_trap_context *tcntx)
 {
-	return sbi_trap_emulate_load(tcntx, sbi_misaligned_ld_emulator);
+	return sbi_trap_emulate_load(tcntx, sbi_misaligned_ld_emulator,
+				     sbi_misaligned_v_ld_emulator);
 }
 
 static int sbi_misaligned_st_emulator(int wlen, union sbi_ldst_data in_val,
@@ -292,23 +448,23 @@ static int sbi_misaligned_st_emulator(int wlen, union sbi_ldst_data in_val,
 	const struct sbi_trap_info *orig_trap = &tcntx->trap;
 	struct sbi_trap_regs *regs = &tcntx->regs;
 	struct sbi_trap_info uptrap;
-	int i;
-
-	for (i = 0; i < wlen; i++) {
-		sbi_store_u8((void *)(orig_trap->tval + i),
-			     in_val.data_bytes[i], &uptrap);
-		if (uptrap.cause) {
-			uptrap.tinst = sbi_misaligned_tinst_fixup(
-				orig_trap->tinst, uptrap.tinst, i);
-			return sbi_trap_redirect(regs, &uptrap);
-		}
+	ulong done;
+
+	done = sbi_misaligned_store_bytes(orig_trap->tval, in_val.data_bytes,
+					  wlen, &uptrap);
+	if (uptrap.cause) {
+		uptrap.tinst = sbi_misaligned_tinst_fixup(
+			orig_trap->tinst, uptrap.tinst, done);
+		return sbi_trap_redirect(regs, &uptrap);
 	}
+
 	return wlen;
 }
 
 int sbi_misaligned_store_handler(struct sbi_trap_context *tcntx)
 {
-	return sbi_trap_emulate_store(tcntx, sbi_misaligned_st_emulator);
+	return sbi_trap_emulate_store(tcntx, sbi_misaligned_st_emulator,
+				      sbi_misaligned_v_st_emulator);
 }
 
 static int sbi_ld_access_emulator(int rlen, union sbi_ldst_data *out_val,
@@ -331,7 +487,7 @@ static int sbi_ld_access_emulator(int rlen, union sbi_ldst_data *out_val,
 
 int sbi_load_access_handler(struct sbi_trap_context *tcntx)
 {
-	return sbi_trap_emulate_load(tcntx, sbi_ld_access_emulator);
+	return sbi_trap_emulate_load(tcntx, sbi_ld_access_emulator, NULL);
 }
 
 static int sbi_st_access_emulator(int wlen, union sbi_ldst_data in_val,
@@ -354,5 +510,19 @@ static int sbi_st_access_emulator(int wlen, union sbi_ldst_data in_val,
 
 int sbi_store_access_handler(struct sbi_trap_context *tcntx)
 {
-	return sbi_trap_emulate_store(tcntx, sbi_st_access_emulator);
+	return sbi_trap_emulate_store(tcntx, sbi_st_access_emulator, NULL);
+}
+
+int sbi_trap_ldst_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	if (cold_boot) {
+		ldst_cache_off = sbi_scratch_alloc_offset(
+			sizeof(struct ldst_cache_entry) * LDST_CACHE_ENTRIES);
+		if (!ldst_cache_off)
+			return SBI_ENOMEM;
+
+		return sbi_misaligned_stats_init();
+	}
+
+	return 0;
 }
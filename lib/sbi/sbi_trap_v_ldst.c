@@ -0,0 +1,331 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_trap.h>
+#include <sbi/sbi_trap_ldst.h>
+
+#ifdef OPENSBI_CC_SUPPORT_VECTOR
+
+#define VLS_VD(insn)		RV_X(insn, 7, 5)
+#define VLS_UMOP(insn)		RV_X(insn, 20, 5)
+#define VLS_VM(insn)		RV_X(insn, 25, 1)
+#define VLS_MOP(insn)		RV_X(insn, 26, 2)
+#define VLS_MEW(insn)		RV_X(insn, 28, 1)
+#define VLS_NF(insn)		(RV_X(insn, 29, 3) + 1)
+
+#define VLS_MOP_UNIT_STRIDE	0
+#define VLS_MOP_STRIDED		2
+
+#define VLS_UMOP_NORMAL		0x00
+#define VLS_UMOP_FAULT_FIRST	0x10
+
+#define VTYPE_VLMUL(vtype)	((vtype) & 0x7)
+#define VTYPE_VSEW(vtype)	(((vtype) >> 3) & 0x7)
+#define VTYPE_VILL		(1UL << (__riscv_xlen - 1))
+
+/* Maximum number of bytes moved between memory and a register at once */
+#define VLS_BATCH_BYTES		64
+
+#define VLS_ASM(__insn)		\
+	".option push\n\t.option arch, +v\n\t" __insn "\n\t.option pop"
+
+/** Decoded unit-stride or strided vector load/store */
+struct vls_insn {
+	ulong base;
+	long stride;
+	ulong vd;
+	/* Element width in bytes */
+	ulong eew;
+	ulong nf;
+	/* Number of vector registers of each field */
+	ulong emul_regs;
+	bool fault_first;
+	ulong vlenb;
+	/* Mask register byte cached by vls_active() */
+	bool masked;
+	ulong mask_idx;
+	u8 mask_byte;
+};
+
+static void vls_vsetvl(ulong vl, ulong vtype)
+{
+	asm volatile(VLS_ASM("vsetvl x0, %0, %1")
+		     : : "r"(vl), "r"(vtype) : "memory");
+}
+
+/*
+ * Registers are accessed as part of an LMUL=8 register group of byte
+ * elements so that vstart and a tail undisturbed vl select the bytes at
+ * offset pos of register vreg. This clobbers vl and vtype.
+ */
+static void vls_set_vreg(ulong vlenb, ulong vreg, ulong pos, ulong size,
+			 const u8 *bytes)
+{
+	ulong addr;
+
+	pos += (vreg % 8) * vlenb;
+	addr = (ulong)bytes - pos;
+
+	asm volatile(VLS_ASM("vsetvli x0, %0, e8, m8, tu, mu")
+		     : : "r"(pos + size));
+	csr_write(CSR_VSTART, pos);
+
+	switch (vreg / 8) {
+	case 0:
+		asm volatile(VLS_ASM("vle8.v v0, (%0)")
+			     : : "r"(addr) : "memory");
+		break;
+	case 1:
+		asm volatile(VLS_ASM("vle8.v v8, (%0)")
+			     : : "r"(addr) : "memory");
+		break;
+	case 2:
+		asm volatile(VLS_ASM("vle8.v v16, (%0)")
+			     : : "r"(addr) : "memory");
+		break;
+	default:
+		asm volatile(VLS_ASM("vle8.v v24, (%0)")
+			     : : "r"(addr) : "memory");
+		break;
+	}
+}
+
+static void vls_get_vreg(ulong vlenb, ulong vreg, ulong pos, ulong size,
+			 u8 *bytes)
+{
+	ulong addr;
+
+	pos += (vreg % 8) * vlenb;
+	addr = (ulong)bytes - pos;
+
+	asm volatile(VLS_ASM("vsetvli x0, %0, e8, m8, tu, mu")
+		     : : "r"(pos + size));
+	csr_write(CSR_VSTART, pos);
+
+	switch (vreg / 8) {
+	case 0:
+		asm volatile(VLS_ASM("vse8.v v0, (%0)")
+			     : : "r"(addr) : "memory");
+		break;
+	case 1:
+		asm volatile(VLS_ASM("vse8.v v8, (%0)")
+			     : : "r"(addr) : "memory");
+		break;
+	case 2:
+		asm volatile(VLS_ASM("vse8.v v16, (%0)")
+			     : : "r"(addr) : "memory");
+		break;
+	default:
+		asm volatile(VLS_ASM("vse8.v v24, (%0)")
+			     : : "r"(addr) : "memory");
+		break;
+	}
+}
+
+static int vls_decode(ulong insn, struct sbi_trap_regs *regs, ulong vtype,
+		      bool load, struct vls_insn *v)
+{
+	ulong width = INSN_VECTOR_LDST_WIDTH(insn);
+	long eew_log2 = width ? width - 4 : 0;
+	long lmul_log2 = VTYPE_VLMUL(vtype);
+	long emul_log2;
+
+	if ((vtype & VTYPE_VILL) || VLS_MEW(insn) || lmul_log2 == 4)
+		return SBI_EINVAL;
+	if (lmul_log2 > 4)
+		lmul_log2 -= 8;
+
+	emul_log2 = eew_log2 - (long)VTYPE_VSEW(vtype) + lmul_log2;
+	if (emul_log2 < -3 || emul_log2 > 3)
+		return SBI_EINVAL;
+
+	v->base	       = GET_RS1(insn, regs);
+	v->vd	       = VLS_VD(insn);
+	v->eew	       = 1UL << eew_log2;
+	v->nf	       = VLS_NF(insn);
+	v->emul_regs   = (emul_log2 > 0) ? 1UL << emul_log2 : 1;
+	v->fault_first = false;
+	v->vlenb       = csr_read(CSR_VLENB);
+	v->masked      = !VLS_VM(insn);
+	v->mask_idx    = -1UL;
+
+	if (v->nf * v->emul_regs > 8 || v->vd % v->emul_regs ||
+	    v->vd + v->nf * v->emul_regs > 32)
+		return SBI_EINVAL;
+
+	/* Indexed, whole register and mask accesses are not emulated */
+	switch (VLS_MOP(insn)) {
+	case VLS_MOP_UNIT_STRIDE:
+		if (load && VLS_UMOP(insn) == VLS_UMOP_FAULT_FIRST)
+			v->fault_first = true;
+		else if (VLS_UMOP(insn) != VLS_UMOP_NORMAL)
+			return SBI_ENOTSUPP;
+		v->stride = v->nf * v->eew;
+		break;
+	case VLS_MOP_STRIDED:
+		v->stride = GET_RS2(insn, regs);
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	}
+
+	return 0;
+}
+
+static bool vls_active(struct vls_insn *v, ulong i)
+{
+	if (!v->masked)
+		return true;
+
+	if (v->mask_idx != i / 8) {
+		v->mask_idx = i / 8;
+		vls_get_vreg(v->vlenb, 0, i / 8, 1, &v->mask_byte);
+	}
+
+	return (v->mask_byte >> (i % 8)) & 1;
+}
+
+/*
+ * Number of active elements starting at element i which are contiguous
+ * in memory and in the same vector register so that they can be moved
+ * at once.
+ */
+static ulong vls_batch(struct vls_insn *v, ulong i, ulong vl)
+{
+	ulong n = 1, max;
+
+	if (v->nf != 1 || v->stride != (long)v->eew)
+		return 1;
+
+	max = (v->vlenb - (i * v->eew) % v->vlenb) / v->eew;
+	if (max > VLS_BATCH_BYTES / v->eew)
+		max = VLS_BATCH_BYTES / v->eew;
+	if (max > vl - i)
+		max = vl - i;
+
+	while (n < max && vls_active(v, i + n))
+		n++;
+
+	return n;
+}
+
+static ulong vls_vreg(struct vls_insn *v, ulong i, ulong seg)
+{
+	return v->vd + seg * v->emul_regs + (i * v->eew) / v->vlenb;
+}
+
+static int vls_fault(struct sbi_trap_context *tcntx,
+		     struct sbi_trap_info *uptrap, ulong vl, ulong vtype,
+		     ulong elem, ulong offset)
+{
+	/* Resume the instruction at the faulting element */
+	vls_vsetvl(vl, vtype);
+	csr_write(CSR_VSTART, elem);
+	tcntx->regs.mstatus |= MSTATUS_VS;
+
+	uptrap->tinst = sbi_misaligned_tinst_fixup(tcntx->trap.tinst,
+						   uptrap->tinst, offset);
+	return sbi_trap_redirect(&tcntx->regs, uptrap);
+}
+
+int sbi_misaligned_v_ld_emulator(ulong insn, struct sbi_trap_context *tcntx)
+{
+	struct sbi_trap_regs *regs = &tcntx->regs;
+	ulong vl = csr_read(CSR_VL);
+	ulong vtype = csr_read(CSR_VTYPE);
+	ulong i = csr_read(CSR_VSTART);
+	struct sbi_trap_info uptrap;
+	u8 bytes[VLS_BATCH_BYTES];
+	ulong n, seg, addr, done;
+	struct vls_insn v;
+
+	if (vls_decode(insn, regs, vtype, true, &v))
+		return sbi_trap_redirect(regs, &tcntx->trap);
+
+	for (; i < vl; i += n) {
+		if (!vls_active(&v, i)) {
+			n = 1;
+			continue;
+		}
+
+		n = vls_batch(&v, i, vl);
+		for (seg = 0; seg < v.nf; seg++) {
+			addr = v.base + i * v.stride + seg * v.eew;
+			done = sbi_misaligned_load_bytes(addr, bytes,
+							 n * v.eew, &uptrap);
+			if (done >= v.eew)
+				vls_set_vreg(v.vlenb, vls_vreg(&v, i, seg),
+					     (i * v.eew) % v.vlenb,
+					     done - done % v.eew, bytes);
+			if (!uptrap.cause)
+				continue;
+
+			/* Trim vl instead of trapping after the first element */
+			if (v.fault_first && i + done / v.eew) {
+				vl = i + done / v.eew;
+				break;
+			}
+
+			return vls_fault(tcntx, &uptrap, vl, vtype,
+					 i + done / v.eew, addr + done -
+					 tcntx->trap.tval);
+		}
+		if (seg < v.nf)
+			break;
+	}
+
+	vls_vsetvl(vl, vtype);
+	csr_write(CSR_VSTART, 0);
+	regs->mstatus |= MSTATUS_VS;
+	regs->mepc += 4;
+
+	return 0;
+}
+
+int sbi_misaligned_v_st_emulator(ulong insn, struct sbi_trap_context *tcntx)
+{
+	struct sbi_trap_regs *regs = &tcntx->regs;
+	ulong vl = csr_read(CSR_VL);
+	ulong vtype = csr_read(CSR_VTYPE);
+	ulong i = csr_read(CSR_VSTART);
+	struct sbi_trap_info uptrap;
+	u8 bytes[VLS_BATCH_BYTES];
+	ulong n, seg, addr, done;
+	struct vls_insn v;
+
+	if (vls_decode(insn, regs, vtype, false, &v))
+		return sbi_trap_redirect(regs, &tcntx->trap);
+
+	for (; i < vl; i += n) {
+		if (!vls_active(&v, i)) {
+			n = 1;
+			continue;
+		}
+
+		n = vls_batch(&v, i, vl);
+		for (seg = 0; seg < v.nf; seg++) {
+			addr = v.base + i * v.stride + seg * v.eew;
+			vls_get_vreg(v.vlenb, vls_vreg(&v, i, seg),
+				     (i * v.eew) % v.vlenb, n * v.eew, bytes);
+			done = sbi_misaligned_store_bytes(addr, bytes,
+							  n * v.eew, &uptrap);
+			if (uptrap.cause)
+				return vls_fault(tcntx, &uptrap, vl, vtype,
+						 i + done / v.eew, addr + done -
+						 tcntx->trap.tval);
+		}
+	}
+
+	vls_vsetvl(vl, vtype);
+	csr_write(CSR_VSTART, 0);
+	regs->mstatus |= MSTATUS_VS;
+	regs->mepc += 4;
+
+	return 0;
+}
+
+#endif
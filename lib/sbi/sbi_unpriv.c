@@ -7,6 +7,7 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <sbi/riscv_asm.h>
 #include <sbi/riscv_encoding.h>
 #include <sbi/sbi_bitops.h>
 #include <sbi/sbi_hart.h>
@@ -167,3 +168,125 @@ ulong sbi_get_insn(ulong mepc, struct sbi_trap_info *trap)
 
 	return insn;
 }
+
+/*
+ * The copy helpers install the expected trap handler once and only set
+ * MPRV around each access because M-mode buffers can't be accessed with
+ * MPRV set. The trap handler leaves the updated MEPC in a4 which is zero
+ * before each access so a non-zero a4 flags the fault. Only byte stores
+ * to the M-mode buffer run in between so nothing else can trap there.
+ */
+#define UNPRIV_COPY_ACCESS(__insn, __val, __addr, __tinfo, __tflag)	\
+	asm volatile(							\
+		"csrs " STR(CSR_MSTATUS) ", %[mprv]\n"			\
+		".option push\n"					\
+		".option norvc\n"					\
+		#__insn " %[val], 0(%[addr])\n"				\
+		".option pop\n"						\
+		"csrc " STR(CSR_MSTATUS) ", %[mprv]\n"			\
+	    : [val] "+&r"(__val), [tflag] "+&r"(__tflag)		\
+	    : [addr] "r"(__addr), [mprv] "r"(MSTATUS_MPRV),		\
+	      [tinfo] "r"(__tinfo)					\
+	    : "memory")
+
+/* Largest naturally aligned access at addr not going beyond len */
+static ulong unpriv_copy_chunk(ulong addr, ulong len)
+{
+#if __riscv_xlen == 64
+	if (!(addr & 0x7) && len >= 8)
+		return 8;
+#endif
+	if (!(addr & 0x3) && len >= 4)
+		return 4;
+	if (!(addr & 0x1) && len >= 2)
+		return 2;
+
+	return 1;
+}
+
+ulong sbi_copy_from_smode(u8 *dst, ulong src, ulong len,
+			  struct sbi_trap_info *trap)
+{
+	register ulong tinfo asm("a3") = (ulong)trap;
+	register ulong tflag asm("a4");
+	ulong i, j, n, val, mstatus, mtvec;
+
+	trap->cause = 0;
+	mstatus = csr_read(CSR_MSTATUS);
+	mtvec = csr_swap(CSR_MTVEC, sbi_hart_expected_trap_addr());
+
+	for (i = 0; i < len; i += n) {
+		n = unpriv_copy_chunk(src + i, len - i);
+		val = 0;
+		tflag = 0;
+		switch (n) {
+#if __riscv_xlen == 64
+		case 8:
+			UNPRIV_COPY_ACCESS(ld, val, src + i, tinfo, tflag);
+			break;
+#endif
+		case 4:
+			UNPRIV_COPY_ACCESS(lw, val, src + i, tinfo, tflag);
+			break;
+		case 2:
+			UNPRIV_COPY_ACCESS(lhu, val, src + i, tinfo, tflag);
+			break;
+		default:
+			UNPRIV_COPY_ACCESS(lbu, val, src + i, tinfo, tflag);
+			break;
+		}
+		if (tflag)
+			break;
+		for (j = 0; j < n; j++)
+			dst[i + j] = val >> (8 * j);
+	}
+
+	/* A trap taken from M-mode changed MPP so restore all of MSTATUS */
+	csr_write(CSR_MTVEC, mtvec);
+	csr_write(CSR_MSTATUS, mstatus);
+
+	return (i < len) ? i : len;
+}
+
+ulong sbi_copy_to_smode(ulong dst, const u8 *src, ulong len,
+			struct sbi_trap_info *trap)
+{
+	register ulong tinfo asm("a3") = (ulong)trap;
+	register ulong tflag asm("a4");
+	ulong i, j, n, val, mstatus, mtvec;
+
+	trap->cause = 0;
+	mstatus = csr_read(CSR_MSTATUS);
+	mtvec = csr_swap(CSR_MTVEC, sbi_hart_expected_trap_addr());
+
+	for (i = 0; i < len; i += n) {
+		n = unpriv_copy_chunk(dst + i, len - i);
+		val = 0;
+		for (j = 0; j < n; j++)
+			val |= (ulong)src[i + j] << (8 * j);
+		tflag = 0;
+		switch (n) {
+#if __riscv_xlen == 64
+		case 8:
+			UNPRIV_COPY_ACCESS(sd, val, dst + i, tinfo, tflag);
+			break;
+#endif
+		case 4:
+			UNPRIV_COPY_ACCESS(sw, val, dst + i, tinfo, tflag);
+			break;
+		case 2:
+			UNPRIV_COPY_ACCESS(sh, val, dst + i, tinfo, tflag);
+			break;
+		default:
+			UNPRIV_COPY_ACCESS(sb, val, dst + i, tinfo, tflag);
+			break;
+		}
+		if (tflag)
+			break;
+	}
+
+	csr_write(CSR_MTVEC, mtvec);
+	csr_write(CSR_MSTATUS, mstatus);
+
+	return (i < len) ? i : len;
+}
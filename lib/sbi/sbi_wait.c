@@ -0,0 +1,60 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_wait.h>
+
+/* Encodings for toolchains without Zawrs and Zihintpause support */
+#define WRS_STO		".word 0x01d00073"
+#define PAUSE		".word 0x0100000f"
+
+static void wait_backoff(struct sbi_scratch *scratch, unsigned long count)
+{
+	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_ZIHINTPAUSE)) {
+		while (count--)
+			__asm__ __volatile__(PAUSE ::: "memory");
+	} else {
+		while (count--)
+			cpu_relax();
+	}
+}
+
+void sbi_wait_on(volatile unsigned long *ptr, unsigned long val)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	unsigned long cur;
+
+	if (!sbi_hart_has_extension(scratch, SBI_HART_EXT_ZAWRS)) {
+		wait_backoff(scratch, 1);
+		return;
+	}
+
+	/* Register a reservation on ptr and stall only if it is unchanged */
+	__asm__ __volatile__(
+#if __riscv_xlen == 64
+		"lr.d	%0, %1\n"
+#else
+		"lr.w	%0, %1\n"
+#endif
+		: "=&r"(cur) : "A"(*ptr) : "memory");
+	if (cur == val)
+		__asm__ __volatile__(WRS_STO ::: "memory");
+}
+
+void sbi_wait_on_u32(volatile u32 *ptr, u32 val, unsigned long backoff)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	u32 cur;
+
+	if (!sbi_hart_has_extension(scratch, SBI_HART_EXT_ZAWRS)) {
+		wait_backoff(scratch, backoff);
+		return;
+	}
+
+	__asm__ __volatile__("lr.w	%0, %1\n"
+			     : "=&r"(cur) : "A"(*ptr) : "memory");
+	if (cur == val)
+		__asm__ __volatile__(WRS_STO ::: "memory");
+}
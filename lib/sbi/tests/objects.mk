@@ -12,3 +12,15 @@ libsbi-objs-$(CONFIG_SBIUNIT) += tests/riscv_atomic_test.o
 
 carray-sbi_unit_tests-$(CONFIG_SBIUNIT) += locks_test_suite
 libsbi-objs-$(CONFIG_SBIUNIT) += tests/riscv_locks_test.o
+
+carray-sbi_unit_tests-$(CONFIG_SBIUNIT) += fifo_test_suite
+libsbi-objs-$(CONFIG_SBIUNIT) += tests/sbi_fifo_test.o
+
+carray-sbi_unit_tests-$(CONFIG_SBIUNIT_BENCH) += bench_suite
+libsbi-objs-$(CONFIG_SBIUNIT_BENCH) += tests/sbi_bench_test.o
+
+carray-sbi_unit_tests-$(CONFIG_SBIUNIT_IPI_BENCH) += ipi_bench_suite
+libsbi-objs-$(CONFIG_SBIUNIT_IPI_BENCH) += tests/sbi_ipi_test.o
+
+carray-sbi_unit_tests-$(CONFIG_SBIUNIT_SSE_BENCH) += sse_bench_suite
+libsbi-objs-$(CONFIG_SBIUNIT_SSE_BENCH) += tests/sbi_sse_test.o
@@ -1,6 +1,9 @@
 #include <sbi/sbi_unit_test.h>
+#include <sbi/riscv_asm.h>
 #include <sbi/riscv_locks.h>
 
+#define LOCK_BENCH_ITERATIONS	1024
+
 static spinlock_t test_lock = SPIN_LOCK_INITIALIZER;
 
 static void spin_lock_test(struct sbiunit_test_case *test)
@@ -31,10 +34,85 @@ static void spin_trylock_success(struct sbiunit_test_case *test)
 	spin_unlock(&test_lock);
 }
 
+static void spin_lock_nested_test(struct sbiunit_test_case *test)
+{
+	spinlock_t inner = SPIN_LOCK_INITIALIZER;
+
+	spin_lock(&test_lock);
+	spin_lock(&inner);
+	SBIUNIT_EXPECT(test, spin_lock_check(&test_lock));
+	SBIUNIT_EXPECT(test, spin_lock_check(&inner));
+	spin_unlock(&test_lock);
+	SBIUNIT_EXPECT(test, spin_lock_check(&inner));
+	spin_unlock(&inner);
+
+	SBIUNIT_ASSERT(test, !spin_lock_check(&test_lock));
+	SBIUNIT_ASSERT(test, !spin_lock_check(&inner));
+}
+
+static void rwlock_test(struct sbiunit_test_case *test)
+{
+	rwlock_t lock = RW_LOCK_INITIALIZER;
+
+	/* Multiple readers may hold the lock at once */
+	read_lock(&lock);
+	read_lock(&lock);
+	read_unlock(&lock);
+	read_unlock(&lock);
+
+	write_lock(&lock);
+	write_unlock(&lock);
+
+	read_lock(&lock);
+	read_unlock(&lock);
+	SBIUNIT_EXPECT_EQ(test, lock.cnts, 0);
+}
+
+static void seqlock_test(struct sbiunit_test_case *test)
+{
+	seqlock_t sl = SEQ_LOCK_INITIALIZER;
+	u32 seq;
+
+	seq = read_seqbegin(&sl);
+	SBIUNIT_EXPECT(test, !read_seqretry(&sl, seq));
+
+	write_seqlock(&sl);
+	write_sequnlock(&sl);
+	SBIUNIT_EXPECT(test, read_seqretry(&sl, seq));
+
+	seq = read_seqbegin(&sl);
+	SBIUNIT_EXPECT(test, !read_seqretry(&sl, seq));
+	SBIUNIT_EXPECT(test, !spin_lock_check(&sl.lock));
+}
+
+/*
+ * Only the boot HART runs the tests so this measures the cost of the
+ * uncontended lock and unlock path of the selected lock implementation.
+ */
+static void spin_lock_bench(struct sbiunit_test_case *test)
+{
+	unsigned long i, start, cycles;
+
+	start = csr_read(CSR_MCYCLE);
+	for (i = 0; i < LOCK_BENCH_ITERATIONS; i++) {
+		spin_lock(&test_lock);
+		spin_unlock(&test_lock);
+	}
+	cycles = csr_read(CSR_MCYCLE) - start;
+
+	SBIUNIT_EXPECT(test, !spin_lock_check(&test_lock));
+	sbi_printf("spin_lock/spin_unlock: %lu cycles per iteration\n",
+		   cycles / LOCK_BENCH_ITERATIONS);
+}
+
 static struct sbiunit_test_case locks_test_cases[] = {
 	SBIUNIT_TEST_CASE(spin_lock_test),
 	SBIUNIT_TEST_CASE(spin_trylock_fail),
 	SBIUNIT_TEST_CASE(spin_trylock_success),
+	SBIUNIT_TEST_CASE(spin_lock_nested_test),
+	SBIUNIT_TEST_CASE(rwlock_test),
+	SBIUNIT_TEST_CASE(seqlock_test),
+	SBIUNIT_TEST_CASE(spin_lock_bench),
 	SBIUNIT_END_CASE,
 };
 
@@ -0,0 +1,154 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#include <sbi/riscv_atomic.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_fifo.h>
+#include <sbi/sbi_heap.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_unit_test.h>
+
+#define BENCH_FIFO_ENTRIES	4
+#define BENCH_HEAP_SIZE		64
+
+/*
+ * Only the boot HART runs the tests so each benchmark measures the
+ * uncontended cost of one operation. The thresholds come from the
+ * platform configuration, zero only reports the timing.
+ */
+
+static spinlock_t bench_lock = SPIN_LOCK_INITIALIZER;
+
+static int bench_spinlock(void *arg)
+{
+	spin_lock(&bench_lock);
+	spin_unlock(&bench_lock);
+	return 0;
+}
+
+static void spinlock_bench(struct sbiunit_test_case *test)
+{
+	sbiunit_bench(test, "spin_lock/spin_unlock", bench_spinlock, NULL,
+		      NULL);
+}
+
+static atomic_t bench_atomic = ATOMIC_INITIALIZER(0);
+
+static int bench_atomic_add(void *arg)
+{
+	atomic_add_return(&bench_atomic, 1);
+	return 0;
+}
+
+static void atomic_bench(struct sbiunit_test_case *test)
+{
+	sbiunit_bench(test, "atomic_add_return", bench_atomic_add, NULL,
+		      NULL);
+}
+
+static int bench_heap(void *arg)
+{
+	void *ptr = sbi_malloc(BENCH_HEAP_SIZE);
+
+	if (!ptr)
+		return SBI_ENOMEM;
+	sbi_free(ptr);
+	return 0;
+}
+
+static void heap_bench(struct sbiunit_test_case *test)
+{
+	sbiunit_bench(test, "sbi_malloc/sbi_free", bench_heap, NULL, NULL);
+}
+
+static unsigned long bench_fifo_mem[BENCH_FIFO_ENTRIES];
+static struct sbi_fifo bench_fifo;
+
+static int bench_fifo_op(void *arg)
+{
+	unsigned long val = 1;
+	int rc;
+
+	rc = sbi_fifo_enqueue(&bench_fifo, &val);
+	if (rc)
+		return rc;
+	return sbi_fifo_dequeue(&bench_fifo, &val);
+}
+
+static void fifo_bench(struct sbiunit_test_case *test)
+{
+	sbi_fifo_init(&bench_fifo, bench_fifo_mem, BENCH_FIFO_ENTRIES,
+		      sizeof(unsigned long));
+	sbiunit_bench(test, "sbi_fifo_enqueue/dequeue", bench_fifo_op, NULL,
+		      NULL);
+}
+
+static int bench_check_addr(void *arg)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	if (!sbi_domain_check_addr(sbi_domain_thishart_ptr(),
+				   scratch->next_addr, PRV_S,
+				   SBI_DOMAIN_EXECUTE))
+		return SBI_EINVALID_ADDR;
+	return 0;
+}
+
+static void check_addr_bench(struct sbiunit_test_case *test)
+{
+	sbiunit_bench(test, "sbi_domain_check_addr", bench_check_addr, NULL,
+		      NULL);
+}
+
+static int bench_snprintf(void *arg)
+{
+	char buf[64];
+
+	if (sbi_snprintf(buf, sizeof(buf), "hart%u %s 0x%lx %d",
+			 current_hartid(), "bench", (ulong)buf, -1) <= 0)
+		return SBI_EFAIL;
+	return 0;
+}
+
+static void snprintf_bench(struct sbiunit_test_case *test)
+{
+	sbiunit_bench(test, "sbi_snprintf", bench_snprintf, NULL, NULL);
+}
+
+/* A full trap round trip through _trap_handler and the ecall dispatch */
+static int bench_trap(void *arg)
+{
+	register unsigned long a0 asm("a0") = 0;
+	register unsigned long a1 asm("a1") = 0;
+	register unsigned long a6 asm("a6") = SBI_EXT_BASE_GET_SPEC_VERSION;
+	register unsigned long a7 asm("a7") = SBI_EXT_BASE;
+
+	asm volatile("ecall"
+		     : "+r"(a0), "+r"(a1)
+		     : "r"(a6), "r"(a7)
+		     : "memory");
+
+	return a0 ? SBI_EFAIL : 0;
+}
+
+static void trap_bench(struct sbiunit_test_case *test)
+{
+	sbiunit_bench(test, "M-mode ecall trap", bench_trap, NULL, NULL);
+}
+
+static struct sbiunit_test_case bench_test_cases[] = {
+	SBIUNIT_BENCH_CASE(spinlock_bench, CONFIG_SBIUNIT_BENCH_SPINLOCK),
+	SBIUNIT_BENCH_CASE(atomic_bench, CONFIG_SBIUNIT_BENCH_ATOMIC),
+	SBIUNIT_BENCH_CASE(heap_bench, CONFIG_SBIUNIT_BENCH_HEAP),
+	SBIUNIT_BENCH_CASE(fifo_bench, CONFIG_SBIUNIT_BENCH_FIFO),
+	SBIUNIT_BENCH_CASE(check_addr_bench, CONFIG_SBIUNIT_BENCH_CHECK_ADDR),
+	SBIUNIT_BENCH_CASE(snprintf_bench, CONFIG_SBIUNIT_BENCH_SNPRINTF),
+	SBIUNIT_BENCH_CASE(trap_bench, CONFIG_SBIUNIT_BENCH_TRAP),
+	SBIUNIT_END_CASE,
+};
+
+SBIUNIT_TEST_SUITE(bench_suite, bench_test_cases);
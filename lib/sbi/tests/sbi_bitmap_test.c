@@ -3,9 +3,14 @@
  *
  * Author: Ivan Orlov <ivan.orlov0322@gmail.com>
  */
+#include <sbi/riscv_asm.h>
 #include <sbi/sbi_bitmap.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_unit_test.h>
 
+#define BITOPS_BENCH_ITERATIONS	256
+
 #define DATA_SIZE sizeof(data_zero)
 #define DATA_BIT_SIZE (DATA_SIZE * 8)
 
@@ -92,10 +97,132 @@ static void bitmap_xor_test(struct sbiunit_test_case *test)
 	SBIUNIT_EXPECT_MEMEQ(test, res, data_zero, DATA_SIZE);
 }
 
+static void bitmap_andnot_test(struct sbiunit_test_case *test)
+{
+	unsigned long res[DATA_SIZE];
+	unsigned long a_andnot_b[] = { data_a[0] & ~data_b[0],
+				       data_a[1] & ~data_b[1],
+				       data_a[2] & ~data_b[2],
+				       data_a[3] & ~data_b[3] };
+
+	__bitmap_andnot(res, data_a, data_b, DATA_BIT_SIZE);
+	SBIUNIT_EXPECT_MEMEQ(test, res, a_andnot_b, DATA_SIZE);
+
+	/* a & ~0 = a */
+	__bitmap_andnot(res, data_a, data_zero, DATA_BIT_SIZE);
+	SBIUNIT_EXPECT_MEMEQ(test, res, data_a, DATA_SIZE);
+
+	/* a & ~a = 0 */
+	__bitmap_andnot(res, data_a, data_a, DATA_BIT_SIZE);
+	SBIUNIT_EXPECT_MEMEQ(test, res, data_zero, DATA_SIZE);
+
+	sbi_memcpy(res, data_zero, DATA_SIZE);
+	__bitmap_andnot(res, data_a, data_b, 0);
+	SBIUNIT_EXPECT_MEMEQ(test, res, data_zero, DATA_SIZE);
+}
+
+static void bitmap_weight_test(struct sbiunit_test_case *test)
+{
+	unsigned long one[] = { 0, 0, 0, 1UL << (BITS_PER_LONG - 1) };
+
+	SBIUNIT_EXPECT_EQ(test, __bitmap_weight(data_zero, DATA_BIT_SIZE), 0);
+	SBIUNIT_EXPECT_EQ(test, __bitmap_weight(one, DATA_BIT_SIZE), 1);
+	/* Bits beyond the bitmap size are not counted */
+	SBIUNIT_EXPECT_EQ(test, __bitmap_weight(one, DATA_BIT_SIZE - 1), 0);
+	SBIUNIT_EXPECT_EQ(test, __bitmap_weight(data_a, BITS_PER_LONG),
+			  sbi_popcount(data_a[0]));
+
+	SBIUNIT_EXPECT(test, __bitmap_empty(data_zero, DATA_BIT_SIZE));
+	SBIUNIT_EXPECT(test, !__bitmap_empty(one, DATA_BIT_SIZE));
+	SBIUNIT_EXPECT(test, __bitmap_empty(one, DATA_BIT_SIZE - 1));
+	SBIUNIT_EXPECT(test, __bitmap_empty(data_a, 0));
+}
+
+static void bitops_word_test(struct sbiunit_test_case *test)
+{
+	unsigned long i, j, k, word, ffs, fls, weight;
+
+	for (i = 0; i < DATA_SIZE / sizeof(unsigned long); i++) {
+		/* Check every shift of the test patterns against naive loops */
+		for (j = 0; j < BITS_PER_LONG; j++) {
+			word = (data_a[i] ^ data_b[i]) << j;
+			if (!word)
+				continue;
+
+			ffs = 0;
+			while (!(word & (1UL << ffs)))
+				ffs++;
+			fls = BITS_PER_LONG - 1;
+			while (!(word & (1UL << fls)))
+				fls--;
+			weight = 0;
+			for (k = 0; k < BITS_PER_LONG; k++)
+				weight += (word >> k) & 1;
+
+			SBIUNIT_EXPECT_EQ(test, sbi_ffs(word), ffs);
+			SBIUNIT_EXPECT_EQ(test, sbi_fls(word), fls);
+			SBIUNIT_EXPECT_EQ(test, sbi_popcount(word), weight);
+		}
+	}
+
+	SBIUNIT_EXPECT_EQ(test, sbi_ffs(1UL << (BITS_PER_LONG - 1)),
+			  BITS_PER_LONG - 1);
+	SBIUNIT_EXPECT_EQ(test, sbi_fls(-1UL), BITS_PER_LONG - 1);
+	SBIUNIT_EXPECT_EQ(test, sbi_fls(1), 0);
+	SBIUNIT_EXPECT_EQ(test, sbi_popcount(0), 0);
+	SBIUNIT_EXPECT_EQ(test, sbi_popcount(-1UL), BITS_PER_LONG);
+}
+
+/*
+ * Scan a sparse bitmap as large as a HART mask, this is the pattern of
+ * sbi_hartmask_for_each_hartindex() over the HARTs of a platform.
+ */
+static void bitops_scan_bench(struct sbiunit_test_case *test)
+{
+	static unsigned long bmap[BITS_TO_LONGS(SBI_HARTMASK_MAX_BITS)];
+	unsigned long i, bit, count, start, first, next, weight, total;
+
+	bitmap_zero(bmap, SBI_HARTMASK_MAX_BITS);
+	for (bit = 3; bit < SBI_HARTMASK_MAX_BITS; bit += 37)
+		__set_bit(bit, bmap);
+
+	count = 0;
+	start = csr_read(CSR_MCYCLE);
+	for (i = 0; i < BITOPS_BENCH_ITERATIONS; i++)
+		count += find_first_bit(bmap, SBI_HARTMASK_MAX_BITS);
+	first = csr_read(CSR_MCYCLE) - start;
+	SBIUNIT_EXPECT_EQ(test, count, 3 * BITOPS_BENCH_ITERATIONS);
+
+	count = 0;
+	start = csr_read(CSR_MCYCLE);
+	for (i = 0; i < BITOPS_BENCH_ITERATIONS; i++) {
+		for_each_set_bit(bit, bmap, SBI_HARTMASK_MAX_BITS)
+			count++;
+	}
+	next = csr_read(CSR_MCYCLE) - start;
+
+	total = 0;
+	start = csr_read(CSR_MCYCLE);
+	for (i = 0; i < BITOPS_BENCH_ITERATIONS; i++)
+		total += bitmap_weight(bmap, SBI_HARTMASK_MAX_BITS);
+	weight = csr_read(CSR_MCYCLE) - start;
+	SBIUNIT_EXPECT_EQ(test, total, count);
+
+	sbi_printf("find_first_bit: %lu cycles, for_each_set_bit: %lu cycles, "
+		   "bitmap_weight: %lu cycles over %d bits\n",
+		   first / BITOPS_BENCH_ITERATIONS,
+		   next / BITOPS_BENCH_ITERATIONS,
+		   weight / BITOPS_BENCH_ITERATIONS, SBI_HARTMASK_MAX_BITS);
+}
+
 static struct sbiunit_test_case bitmap_test_cases[] = {
 	SBIUNIT_TEST_CASE(bitmap_and_test),
 	SBIUNIT_TEST_CASE(bitmap_or_test),
 	SBIUNIT_TEST_CASE(bitmap_xor_test),
+	SBIUNIT_TEST_CASE(bitmap_andnot_test),
+	SBIUNIT_TEST_CASE(bitmap_weight_test),
+	SBIUNIT_TEST_CASE(bitops_word_test),
+	SBIUNIT_TEST_CASE(bitops_scan_bench),
 	SBIUNIT_END_CASE,
 };
 
@@ -34,12 +34,14 @@ static const struct sbi_console_device test_console_dev = {
 /* Mock the console device */
 static inline void test_console_begin(const struct sbi_console_device *device)
 {
+	sbi_console_flush();
 	old_dev = sbi_console_get_device();
 	sbi_console_set_device(device);
 }
 
 static inline void test_console_end(void)
 {
+	sbi_console_flush();
 	sbi_console_set_device(old_dev);
 }
 
@@ -95,6 +97,10 @@ static void printf_test(struct sbiunit_test_case *test)
 	PRINTF_TEST(test, "-2147483647", "%ld", -2147483647l);
 	PRINTF_TEST(test, "-9223372036854775807", "%lld", -9223372036854775807LL);
 	PRINTF_TEST(test, "18446744073709551615", "%llu", 18446744073709551615ULL);
+	PRINTF_TEST(test, "777", "%o", 0777);
+	PRINTF_TEST(test, "0x0000abcd", "%#010x", 0xabcd);
+	PRINTF_TEST(test, "FEDCBA9876543210", "%llX", 0xfedcba9876543210ULL);
+	PRINTF_TEST(test, "4294967296", "%llu", 4294967296ULL);
 }
 
 static struct sbiunit_test_case console_test_cases[] = {
@@ -0,0 +1,132 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_fifo.h>
+#include <sbi/sbi_unit_test.h>
+
+#define FIFO_TEST_ENTRIES 4
+
+static unsigned long fifo_mem[FIFO_TEST_ENTRIES];
+static char fifo_mpsc_mem[SBI_FIFO_MPSC_MEM_SIZE(FIFO_TEST_ENTRIES,
+						 sizeof(unsigned long))];
+static struct sbi_fifo test_fifo;
+
+struct fifo_test_entry {
+	unsigned long a;
+	u32 b;
+};
+
+SBI_FIFO_DEFINE_TYPED(fifo_test, struct fifo_test_entry);
+
+static struct fifo_test_entry fifo_typed_mem[FIFO_TEST_ENTRIES];
+
+static int fifo_merge_cb(void *in, void *data)
+{
+	unsigned long *curr = data, *next = in;
+
+	if (*curr == *next)
+		return SBI_FIFO_SKIP;
+
+	return SBI_FIFO_UNCHANGED;
+}
+
+static void fifo_common_test(struct sbiunit_test_case *test)
+{
+	unsigned long i, j, val, pos;
+	void *entry;
+
+	SBIUNIT_EXPECT(test, sbi_fifo_is_empty(&test_fifo));
+	SBIUNIT_EXPECT_EQ(test, sbi_fifo_dequeue(&test_fifo, &val), SBI_ENOENT);
+
+	/* Wrap around the queue a few times */
+	for (j = 0; j < 3; j++) {
+		for (i = 0; i < FIFO_TEST_ENTRIES; i++)
+			SBIUNIT_EXPECT_EQ(test, sbi_fifo_enqueue(&test_fifo, &i), 0);
+
+		SBIUNIT_EXPECT(test, sbi_fifo_is_full(&test_fifo));
+		SBIUNIT_EXPECT_EQ(test, sbi_fifo_avail(&test_fifo),
+				  FIFO_TEST_ENTRIES);
+		SBIUNIT_EXPECT_EQ(test, sbi_fifo_enqueue(&test_fifo, &i),
+				  SBI_ENOSPC);
+
+		for (i = 0; i < FIFO_TEST_ENTRIES; i++) {
+			SBIUNIT_EXPECT_EQ(test, sbi_fifo_dequeue(&test_fifo, &val), 0);
+			SBIUNIT_EXPECT_EQ(test, val, i);
+		}
+		SBIUNIT_EXPECT(test, sbi_fifo_is_empty(&test_fifo));
+	}
+
+	/* In-place update is only done for queued entries */
+	val = 1;
+	SBIUNIT_EXPECT_EQ(test, sbi_fifo_inplace_update(&test_fifo, &val,
+							fifo_merge_cb),
+			  SBI_FIFO_UNCHANGED);
+	SBIUNIT_EXPECT_EQ(test, sbi_fifo_enqueue(&test_fifo, &val), 0);
+	SBIUNIT_EXPECT_EQ(test, sbi_fifo_inplace_update(&test_fifo, &val,
+							fifo_merge_cb),
+			  SBI_FIFO_SKIP);
+	SBIUNIT_EXPECT_EQ(test, sbi_fifo_dequeue(&test_fifo, &val), 0);
+	SBIUNIT_EXPECT_EQ(test, sbi_fifo_inplace_update(&test_fifo, &val,
+							fifo_merge_cb),
+			  SBI_FIFO_UNCHANGED);
+
+	/* Positional in-place update only sees the entry while queued */
+	SBIUNIT_ASSERT_EQ(test, sbi_fifo_enqueue_start(&test_fifo, &entry,
+						       &pos), 0);
+	*(unsigned long *)entry = val;
+	sbi_fifo_enqueue_finish(&test_fifo, pos);
+	SBIUNIT_EXPECT_EQ(test, sbi_fifo_inplace_update_pos(&test_fifo, pos,
+							    &val, fifo_merge_cb),
+			  SBI_FIFO_SKIP);
+	SBIUNIT_EXPECT_EQ(test, sbi_fifo_dequeue(&test_fifo, &val), 0);
+	SBIUNIT_EXPECT_EQ(test, sbi_fifo_inplace_update_pos(&test_fifo, pos,
+							    &val, fifo_merge_cb),
+			  SBI_FIFO_UNCHANGED);
+}
+
+static void fifo_locked_test(struct sbiunit_test_case *test)
+{
+	sbi_fifo_init(&test_fifo, fifo_mem, FIFO_TEST_ENTRIES,
+		      sizeof(unsigned long));
+	fifo_common_test(test);
+}
+
+static void fifo_mpsc_test(struct sbiunit_test_case *test)
+{
+	sbi_fifo_mpsc_init(&test_fifo, fifo_mpsc_mem, FIFO_TEST_ENTRIES,
+			   sizeof(unsigned long));
+	fifo_common_test(test);
+}
+
+static void fifo_typed_test(struct sbiunit_test_case *test)
+{
+	struct fifo_test_entry e;
+	unsigned long i;
+
+	sbi_fifo_init(&test_fifo, fifo_typed_mem, FIFO_TEST_ENTRIES,
+		      sizeof(e));
+
+	for (i = 0; i < FIFO_TEST_ENTRIES; i++) {
+		e.a = i;
+		e.b = ~i;
+		SBIUNIT_EXPECT_EQ(test, fifo_test_enqueue(&test_fifo, &e), 0);
+	}
+	SBIUNIT_EXPECT_EQ(test, fifo_test_enqueue(&test_fifo, &e), SBI_ENOSPC);
+
+	for (i = 0; i < FIFO_TEST_ENTRIES; i++) {
+		SBIUNIT_EXPECT_EQ(test, fifo_test_dequeue(&test_fifo, &e), 0);
+		SBIUNIT_EXPECT_EQ(test, e.a, i);
+		SBIUNIT_EXPECT_EQ(test, e.b, (u32)~i);
+	}
+	SBIUNIT_EXPECT_EQ(test, fifo_test_dequeue(&test_fifo, &e), SBI_ENOENT);
+}
+
+static struct sbiunit_test_case fifo_test_cases[] = {
+	SBIUNIT_TEST_CASE(fifo_locked_test),
+	SBIUNIT_TEST_CASE(fifo_mpsc_test),
+	SBIUNIT_TEST_CASE(fifo_typed_test),
+	SBIUNIT_END_CASE,
+};
+
+SBIUNIT_TEST_SUITE(fifo_test_suite, fifo_test_cases);
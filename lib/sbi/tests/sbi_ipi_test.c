@@ -0,0 +1,92 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_ipi.h>
+#include <sbi/sbi_irqchip.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_unit_test.h>
+
+#define IPI_BENCH_TIMEOUT	(1UL << 20)
+
+static unsigned long ipi_ping_count;
+
+static void ipi_ping_process(struct sbi_scratch *scratch)
+{
+	ipi_ping_count++;
+}
+
+static struct sbi_ipi_event_ops ipi_ping_ops = {
+	.name = "IPI_PING",
+	.process = ipi_ping_process,
+};
+
+static void ipi_event_create_test(struct sbiunit_test_case *test)
+{
+	int event, again;
+
+	SBIUNIT_EXPECT(test, sbi_ipi_event_create(NULL) < 0);
+
+	event = sbi_ipi_event_create(&ipi_ping_ops);
+	SBIUNIT_ASSERT(test, event >= 0 && event < SBI_IPI_EVENT_MAX);
+
+	/* Destroyed event slots are handed out again */
+	sbi_ipi_event_destroy(event);
+	again = sbi_ipi_event_create(&ipi_ping_ops);
+	SBIUNIT_EXPECT_EQ(test, again, event);
+	sbi_ipi_event_destroy(again);
+}
+
+/*
+ * The other HARTs are parked in the HSM wait loop while the tests run so
+ * the IPI device is exercised by the current HART on itself: trigger the
+ * IPI and spin until it becomes pending in the MIP CSR.
+ */
+static int ipi_bench_one(void *arg)
+{
+	u32 hartindex = *(u32 *)arg;
+	unsigned long i, mip = 0;
+	int rc;
+
+	rc = sbi_ipi_raw_send(hartindex);
+	if (rc)
+		return rc;
+
+	for (i = 0; i < IPI_BENCH_TIMEOUT; i++) {
+		mip = csr_read(CSR_MIP) & (MIP_MSIP | MIP_MEIP);
+		if (mip)
+			break;
+	}
+
+	/* MSI based devices such as the IMSIC use external interrupts */
+	if (mip & MIP_MSIP)
+		sbi_ipi_raw_clear(hartindex);
+	else if (mip & MIP_MEIP)
+		sbi_irqchip_process();
+
+	return mip ? 0 : SBI_ETIMEDOUT;
+}
+
+static void ipi_self_latency_bench(struct sbiunit_test_case *test)
+{
+	const struct sbi_ipi_device *dev = sbi_ipi_get_device();
+	u32 hartindex = sbi_hartid_to_hartindex(current_hartid());
+
+	if (!dev) {
+		SBIUNIT_INFO(test, "No IPI device, skipping\n");
+		return;
+	}
+
+	sbiunit_bench(test, dev->name, ipi_bench_one, &hartindex, NULL);
+}
+
+static struct sbiunit_test_case ipi_bench_test_cases[] = {
+	SBIUNIT_TEST_CASE(ipi_event_create_test),
+	SBIUNIT_BENCH_CASE(ipi_self_latency_bench,
+			   CONFIG_SBIUNIT_IPI_BENCH_THRESHOLD),
+	SBIUNIT_END_CASE,
+};
+
+SBIUNIT_TEST_SUITE(ipi_bench_suite, ipi_bench_test_cases);
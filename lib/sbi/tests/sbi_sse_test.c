@@ -0,0 +1,126 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_sse.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_trap.h>
+#include <sbi/sbi_unit_test.h>
+
+#define SSE_BENCH_ITERATIONS	64
+
+struct sse_bench_result {
+	unsigned long min;
+	unsigned long max;
+	unsigned long total;
+};
+
+static void sse_bench_account(struct sse_bench_result *r,
+			      unsigned long cycles)
+{
+	if (cycles < r->min)
+		r->min = cycles;
+	if (r->max < cycles)
+		r->max = cycles;
+	r->total += cycles;
+}
+
+static void sse_bench_print(const char *what, uint32_t event_id,
+			    struct sse_bench_result *r)
+{
+	sbi_printf("SSE 0x%08x %s cycles min=%lu avg=%lu max=%lu\n",
+		   event_id, what, r->min, r->total / SSE_BENCH_ITERATIONS,
+		   r->max);
+}
+
+/*
+ * The other HARTs are parked in the HSM wait loop while the tests run so
+ * the event is injected to the current HART and delivered on a fake trap
+ * frame. The handler is never entered: the benchmark measures the M-mode
+ * part of the delivery, from injection to the trap frame pointing at the
+ * handler entry and from SBI_EXT_SSE_COMPLETE to the resume of the
+ * interrupted context.
+ */
+static void sse_event_bench(struct sbiunit_test_case *test, uint32_t event_id)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct sse_bench_result inject = { -1UL, 0, 0 };
+	struct sse_bench_result complete = { -1UL, 0, 0 };
+	unsigned long i, start, sepc, hstatus = 0;
+	unsigned long entry_pc = scratch->next_addr;
+	struct sbi_ecall_return out;
+	struct sbi_trap_regs regs;
+	int rc;
+
+	rc = sbi_sse_register(event_id, entry_pc, 0);
+	if (rc) {
+		SBIUNIT_INFO(test, "Unable to register event, skipping\n");
+		return;
+	}
+	SBIUNIT_ASSERT_EQ(test, sbi_sse_enable(event_id), 0);
+
+	sepc = csr_read(CSR_SEPC);
+	if (misa_extension('H'))
+		hstatus = csr_read(CSR_HSTATUS);
+
+	for (i = 0; i < SSE_BENCH_ITERATIONS; i++) {
+		sbi_memset(&regs, 0, sizeof(regs));
+		regs.mepc = entry_pc + 4;
+		regs.mstatus = PRV_S << MSTATUS_MPP_SHIFT;
+
+		start = csr_read(CSR_MCYCLE);
+		rc = sbi_sse_inject_event(event_id);
+		sbi_sse_process_pending_events(&regs);
+		sse_bench_account(&inject, csr_read(CSR_MCYCLE) - start);
+		if (rc || regs.mepc != entry_pc) {
+			test->failed = true;
+			SBIUNIT_INFO(test, "Event not delivered\n");
+			break;
+		}
+
+		sbi_memset(&out, 0, sizeof(out));
+		start = csr_read(CSR_MCYCLE);
+		rc = sbi_sse_complete(&regs, &out);
+		sse_bench_account(&complete, csr_read(CSR_MCYCLE) - start);
+		if (rc || regs.mepc != entry_pc + 4) {
+			test->failed = true;
+			SBIUNIT_INFO(test, "Event not completed\n");
+			break;
+		}
+	}
+
+	csr_write(CSR_SEPC, sepc);
+	if (misa_extension('H'))
+		csr_write(CSR_HSTATUS, hstatus);
+
+	SBIUNIT_EXPECT_EQ(test, sbi_sse_disable(event_id), 0);
+	SBIUNIT_EXPECT_EQ(test, sbi_sse_unregister(event_id), 0);
+
+	if (test->failed)
+		return;
+
+	sse_bench_print("inject to entry", event_id, &inject);
+	sse_bench_print("complete to resume", event_id, &complete);
+}
+
+static void sse_local_event_bench(struct sbiunit_test_case *test)
+{
+	sse_event_bench(test, SBI_SSE_EVENT_LOCAL_SOFTWARE);
+}
+
+static void sse_global_event_bench(struct sbiunit_test_case *test)
+{
+	sse_event_bench(test, SBI_SSE_EVENT_GLOBAL_SOFTWARE);
+}
+
+static struct sbiunit_test_case sse_bench_test_cases[] = {
+	SBIUNIT_TEST_CASE(sse_local_event_bench),
+	SBIUNIT_TEST_CASE(sse_global_event_bench),
+	SBIUNIT_END_CASE,
+};
+
+SBIUNIT_TEST_SUITE(sse_bench_suite, sse_bench_test_cases);
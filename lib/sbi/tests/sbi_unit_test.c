@@ -3,6 +3,8 @@
  *
  * Author: Ivan Orlov <ivan.orlov0322@gmail.com>
  */
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
 #include <sbi/sbi_unit_test.h>
 #include <sbi/sbi_types.h>
 #include <sbi/sbi_console.h>
@@ -10,6 +12,73 @@
 extern struct sbiunit_test_suite *sbi_unit_tests[];
 extern unsigned long sbi_unit_tests_size;
 
+/* The tests only run on the boot HART */
+static unsigned long bench_samples[SBIUNIT_BENCH_REPS];
+static u32 total_fail;
+
+static void bench_sort(unsigned long *v, u32 n)
+{
+	unsigned long x;
+	u32 i, j;
+
+	for (i = 1; i < n; i++) {
+		x = v[i];
+		for (j = i; j > 0 && v[j - 1] > x; j--)
+			v[j] = v[j - 1];
+		v[j] = x;
+	}
+}
+
+int sbiunit_bench(struct sbiunit_test_case *test, const char *name,
+		  int (*func)(void *arg), void *arg,
+		  struct sbiunit_bench_result *res)
+{
+	struct sbiunit_bench_result r;
+	unsigned long start;
+	u32 i;
+	int rc;
+
+	for (i = 0; i < SBIUNIT_BENCH_WARMUP; i++) {
+		rc = func(arg);
+		if (rc)
+			goto fail;
+	}
+
+	for (i = 0; i < SBIUNIT_BENCH_REPS; i++) {
+		start = csr_read(CSR_MCYCLE);
+		rc = func(arg);
+		bench_samples[i] = csr_read(CSR_MCYCLE) - start;
+		if (rc)
+			goto fail;
+	}
+
+	bench_sort(bench_samples, SBIUNIT_BENCH_REPS);
+	r.min = bench_samples[0];
+	r.median = bench_samples[SBIUNIT_BENCH_REPS / 2];
+	r.p99 = bench_samples[(SBIUNIT_BENCH_REPS * 99) / 100];
+	r.max = bench_samples[SBIUNIT_BENCH_REPS - 1];
+	if (res)
+		*res = r;
+
+	sbi_printf("%s: %s cycles min=%lu median=%lu p99=%lu max=%lu\n",
+		   test->name, name, r.min, r.median, r.p99, r.max);
+
+	if (test->threshold && r.median > test->threshold) {
+		test->failed = true;
+		sbi_printf("[SBIUnit] %s: %s REGRESSION median %lu > "
+			   "threshold %lu cycles\n", test->name, name,
+			   r.median, test->threshold);
+	}
+
+	return 0;
+
+fail:
+	test->failed = true;
+	sbi_printf("[SBIUnit] %s: %s failed (error %d)\n",
+		   test->name, name, rc);
+	return rc;
+}
+
 static void run_test_suite(struct sbiunit_test_suite *suite)
 {
 	struct sbiunit_test_case *s_case;
@@ -33,6 +102,7 @@ static void run_test_suite(struct sbiunit_test_suite *suite)
 	}
 	sbi_printf("%u PASSED / %u FAILED / %u TOTAL\n", count_pass, count_fail,
 		   count_pass + count_fail);
+	total_fail += count_fail;
 }
 
 void run_all_tests(void)
@@ -43,4 +113,10 @@ void run_all_tests(void)
 
 	for (i = 0; i < sbi_unit_tests_size; i++)
 		run_test_suite(sbi_unit_tests[i]);
+
+	/* A single line for CI to match on */
+	if (total_fail)
+		sbi_printf("# SBIUNIT: %u test(s) FAILED #\n", total_fail);
+	else
+		sbi_printf("# SBIUNIT: all tests PASSED #\n");
 }
@@ -14,6 +14,7 @@
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_heap.h>
+#include <sbi/sbi_init.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi_utils/fdt/fdt_domain.h>
 #include <sbi_utils/fdt/fdt_helper.h>
@@ -70,7 +71,7 @@ int fdt_iterate_each_memregion(void *fdt, int domain_offset, void *opaque,
 
 	rcount = (u32)len / (sizeof(u32) * 2);
 	for (i = 0; i < rcount; i++) {
-		region_offset = fdt_node_offset_by_phandle(fdt,
+		region_offset = fdt_node_offset_by_phandle_cached(fdt,
 						fdt32_to_cpu(regions[2 * i]));
 		if (region_offset < 0)
 			return region_offset;
@@ -107,22 +108,6 @@ static int __fixup_find_domain_offset(void *fdt, int doff, void *p)
 				 SBI_DOMAIN_MEMREGION_WRITEABLE | \
 				 SBI_DOMAIN_MEMREGION_EXECUTABLE)
 
-static int __fixup_count_disable_devices(void *fdt, int doff, int roff,
-					 u32 perm, void *p)
-{
-	int len;
-	u32 *dcount = p;
-
-	if (perm & DISABLE_DEVICES_MASK)
-		return 0;
-
-	len = 0;
-	if (fdt_getprop(fdt, roff, "devices", &len))
-		*dcount += len / sizeof(u32);
-
-	return 0;
-}
-
 static int __fixup_disable_devices(void *fdt, int doff, int roff,
 				   u32 raccess, void *p)
 {
@@ -139,12 +124,12 @@ static int __fixup_disable_devices(void *fdt, int doff, int roff,
 	len = len / sizeof(u32);
 
 	for (i = 0; i < len; i++) {
-		coff = fdt_node_offset_by_phandle(fdt,
+		coff = fdt_node_offset_by_phandle_cached(fdt,
 					fdt32_to_cpu(devices[i]));
 		if (coff < 0)
 			return coff;
 
-		fdt_setprop_string(fdt, coff, "status", "disabled");
+		fdt_stage_setprop_string(fdt, coff, "status", "disabled");
 	}
 
 	return 0;
@@ -152,7 +137,7 @@ static int __fixup_disable_devices(void *fdt, int doff, int roff,
 
 void fdt_domain_fixup(void *fdt)
 {
-	u32 i, dcount;
+	u32 i;
 	int err, poffset, doffset;
 	struct sbi_domain *dom = sbi_domain_thishart_ptr();
 	struct __fixup_find_domain_offset_info fdo;
@@ -184,29 +169,10 @@ void fdt_domain_fixup(void *fdt)
 	if (doffset < 0)
 		goto skip_device_disable;
 
-	/* Count current domain device DT nodes to be disabled */
-	dcount = 0;
-	fdt_iterate_each_memregion(fdt, doffset, &dcount,
-				   __fixup_count_disable_devices);
-	if (!dcount)
-		goto skip_device_disable;
-
-	/* Expand FDT based on device DT nodes to be disabled */
-	err = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + dcount * 32);
-	if (err < 0)
-		return;
-
-	/* Again find current domain DT node */
-	doffset = -1;
-	fdo.name = dom->name;
-	fdo.doffset = &doffset;
-	fdt_iterate_each_domain(fdt, &fdo, __fixup_find_domain_offset);
-	if (doffset < 0)
-		goto skip_device_disable;
-
-	/* Disable device DT nodes for current domain */
+	/* Disable device DT nodes for current domain in one pass */
 	fdt_iterate_each_memregion(fdt, doffset, NULL,
 				   __fixup_disable_devices);
+	fdt_stage_commit(fdt);
 skip_device_disable:
 
 	/* Remove the OpenSBI domain config DT node */
@@ -283,17 +249,44 @@ static int __fdt_parse_region(void *fdt, int domain_offset,
 	return 0;
 }
 
-static int __fdt_parse_domain(void *fdt, int domain_offset, void *opaque)
+/** Domain parsing state shared by the HARTs parsing the domains */
+struct parse_domains_data {
+	void *fdt;
+	int cold_domain_offset;
+	u32 cold_hartid;
+	struct sbi_scratch *cold_scratch;
+	u32 count;
+	struct parse_domain_stage {
+		int offset;
+		int err;
+		struct sbi_domain *dom;
+		struct sbi_hartmask assign_mask;
+	} *stage;
+};
+
+static void fdt_domain_free(struct sbi_domain *dom)
+{
+	sbi_free((void *)dom->possible_harts);
+	sbi_free(dom->regions);
+	sbi_free(dom);
+}
+
+/*
+ * Parse one domain node into a new domain without registering it. This
+ * may run on any HART so the coldboot HART details come from pdata.
+ */
+static int fdt_parse_domain(struct parse_domains_data *pdata,
+			    struct parse_domain_stage *stage)
 {
 	u32 val32;
 	u64 val64;
 	const u32 *val;
 	struct sbi_domain *dom;
 	struct sbi_hartmask *mask;
-	struct sbi_hartmask assign_mask;
 	struct parse_region_data preg;
-	int *cold_domain_offset = opaque;
 	struct sbi_domain_memregion *reg;
+	void *fdt = pdata->fdt;
+	int domain_offset = stage->offset;
 	int i, err = 0, len, cpus_offset, cpu_offset, doffset;
 
 	dom = sbi_zalloc(sizeof(*dom));
@@ -328,7 +321,7 @@ static int __fdt_parse_domain(void *fdt, int domain_offset, void *opaque)
 	len = len / sizeof(u32);
 	if (val && len) {
 		for (i = 0; i < len; i++) {
-			cpu_offset = fdt_node_offset_by_phandle(fdt,
+			cpu_offset = fdt_node_offset_by_phandle_cached(fdt,
 							fdt32_to_cpu(val[i]));
 			if (cpu_offset < 0) {
 				err = cpu_offset;
@@ -378,13 +371,13 @@ static int __fdt_parse_domain(void *fdt, int domain_offset, void *opaque)
 	val32 = -1U;
 	val = fdt_getprop(fdt, domain_offset, "boot-hart", &len);
 	if (val && len >= 4) {
-		cpu_offset = fdt_node_offset_by_phandle(fdt,
+		cpu_offset = fdt_node_offset_by_phandle_cached(fdt,
 							 fdt32_to_cpu(*val));
 		if (cpu_offset >= 0 && fdt_node_is_enabled(fdt, cpu_offset))
 			fdt_parse_hart_id(fdt, cpu_offset, &val32);
 	} else {
-		if (domain_offset == *cold_domain_offset)
-			val32 = current_hartid();
+		if (domain_offset == pdata->cold_domain_offset)
+			val32 = pdata->cold_hartid;
 	}
 	dom->boot_hartid = val32;
 
@@ -395,8 +388,8 @@ static int __fdt_parse_domain(void *fdt, int domain_offset, void *opaque)
 		val64 = fdt32_to_cpu(val[0]);
 		val64 = (val64 << 32) | fdt32_to_cpu(val[1]);
 	} else {
-		if (domain_offset == *cold_domain_offset)
-			val64 = sbi_scratch_thishart_ptr()->next_arg1;
+		if (domain_offset == pdata->cold_domain_offset)
+			val64 = pdata->cold_scratch->next_arg1;
 	}
 	dom->next_arg1 = val64;
 
@@ -407,8 +400,8 @@ static int __fdt_parse_domain(void *fdt, int domain_offset, void *opaque)
 		val64 = fdt32_to_cpu(val[0]);
 		val64 = (val64 << 32) | fdt32_to_cpu(val[1]);
 	} else {
-		if (domain_offset == *cold_domain_offset)
-			val64 = sbi_scratch_thishart_ptr()->next_addr;
+		if (domain_offset == pdata->cold_domain_offset)
+			val64 = pdata->cold_scratch->next_addr;
 	}
 	dom->next_addr = val64;
 
@@ -420,8 +413,8 @@ static int __fdt_parse_domain(void *fdt, int domain_offset, void *opaque)
 		if (val32 != 0x0 && val32 != 0x1)
 			val32 = 0x1;
 	} else {
-		if (domain_offset == *cold_domain_offset)
-			val32 = sbi_scratch_thishart_ptr()->next_mode;
+		if (domain_offset == pdata->cold_domain_offset)
+			val32 = pdata->cold_scratch->next_mode;
 	}
 	dom->next_mode = val32;
 
@@ -439,6 +432,28 @@ static int __fdt_parse_domain(void *fdt, int domain_offset, void *opaque)
 	else
 		dom->system_suspend_allowed = false;
 
+	/* Read "cache-ways" DT property */
+	val32 = 0;
+	val = fdt_getprop(fdt, domain_offset, "cache-ways", &len);
+	if (val && len >= 4)
+		val32 = fdt32_to_cpu(val[0]);
+	dom->cache_way_mask = val32;
+
+	/* Read "stateen0-deny" DT property */
+	dom->stateen0_deny = 0;
+	val = fdt_getprop(fdt, domain_offset, "stateen0-deny", &len);
+	if (val && len >= 8)
+		dom->stateen0_deny = ((u64)fdt32_to_cpu(val[0]) << 32) |
+				     fdt32_to_cpu(val[1]);
+	else if (val && len >= 4)
+		dom->stateen0_deny = fdt32_to_cpu(val[0]);
+
+	/* Read "time-slice" DT property */
+	dom->time_slice = 0;
+	val = fdt_getprop(fdt, domain_offset, "time-slice", &len);
+	if (val && len >= 4)
+		dom->time_slice = fdt32_to_cpu(val[0]);
+
 	/* Find /cpus DT node */
 	cpus_offset = fdt_path_offset(fdt, "/cpus");
 	if (cpus_offset < 0) {
@@ -447,7 +462,7 @@ static int __fdt_parse_domain(void *fdt, int domain_offset, void *opaque)
 	}
 
 	/* HART to domain assignment mask based on CPU DT nodes */
-	sbi_hartmask_clear_all(&assign_mask);
+	sbi_hartmask_clear_all(&stage->assign_mask);
 	fdt_for_each_subnode(cpu_offset, fdt, cpus_offset) {
 		err = fdt_parse_hart_id(fdt, cpu_offset, &val32);
 		if (err)
@@ -465,21 +480,18 @@ static int __fdt_parse_domain(void *fdt, int domain_offset, void *opaque)
 			goto fail_free_all;
 		}
 
-		doffset = fdt_node_offset_by_phandle(fdt, fdt32_to_cpu(*val));
+		doffset = fdt_node_offset_by_phandle_cached(fdt,
+							     fdt32_to_cpu(*val));
 		if (doffset < 0) {
 			err = doffset;
 			goto fail_free_all;
 		}
 
 		if (doffset == domain_offset)
-			sbi_hartmask_set_hartid(val32, &assign_mask);
+			sbi_hartmask_set_hartid(val32, &stage->assign_mask);
 	}
 
-	/* Register the domain */
-	err = sbi_domain_register(dom, &assign_mask);
-	if (err)
-		goto fail_free_all;
-
+	stage->dom = dom;
 	return 0;
 
 fail_free_all:
@@ -491,12 +503,34 @@ fail_free_domain:
 	return err;
 }
 
+static int __fdt_stage_domain(void *fdt, int domain_offset, void *opaque)
+{
+	struct parse_domains_data *pdata = opaque;
+
+	if (pdata->stage)
+		pdata->stage[pdata->count].offset = domain_offset;
+	pdata->count++;
+
+	return 0;
+}
+
+static int fdt_parse_domain_work(struct sbi_init_work *work, u32 index)
+{
+	struct parse_domains_data *pdata = work->priv;
+	struct parse_domain_stage *stage = &pdata->stage[index];
+
+	stage->err = fdt_parse_domain(pdata, stage);
+	return stage->err;
+}
+
 int fdt_domains_populate(void *fdt)
 {
 	const u32 *val;
-	int cold_domain_offset;
-	u32 hartid, cold_hartid;
-	int err, len, cpus_offset, cpu_offset;
+	u32 i, hartid, cold_hartid;
+	struct parse_domains_data pdata = { 0 };
+	struct sbi_init_work work = { 0 };
+	struct parse_domain_stage *stage;
+	int err, len, cpus_offset, cpu_offset, cold_domain_offset;
 
 	/* Sanity checks */
 	if (!fdt)
@@ -523,13 +557,49 @@ int fdt_domains_populate(void *fdt)
 
 		val = fdt_getprop(fdt, cpu_offset, "opensbi-domain", &len);
 		if (val && len >= 4)
-			cold_domain_offset = fdt_node_offset_by_phandle(fdt,
-							   fdt32_to_cpu(*val));
+			cold_domain_offset =
+				fdt_node_offset_by_phandle_cached(fdt,
+							fdt32_to_cpu(*val));
 
 		break;
 	}
 
-	/* Iterate over each domain in FDT and populate details */
-	return fdt_iterate_each_domain(fdt, &cold_domain_offset,
-				       __fdt_parse_domain);
+	/* Collect the domain nodes so that they can be parsed in parallel */
+	pdata.fdt = fdt;
+	pdata.cold_domain_offset = cold_domain_offset;
+	pdata.cold_hartid = cold_hartid;
+	pdata.cold_scratch = sbi_scratch_thishart_ptr();
+	err = fdt_iterate_each_domain(fdt, &pdata, __fdt_stage_domain);
+	if (err || !pdata.count)
+		return err;
+
+	pdata.stage = sbi_calloc(sizeof(*pdata.stage), pdata.count);
+	if (!pdata.stage)
+		return SBI_ENOMEM;
+	pdata.count = 0;
+	fdt_iterate_each_domain(fdt, &pdata, __fdt_stage_domain);
+
+	work.process = fdt_parse_domain_work;
+	work.count = pdata.count;
+	work.priv = &pdata;
+	sbi_init_work_run(&work);
+
+	/* Register the domains in DT order up to the first failure */
+	err = 0;
+	for (i = 0; i < pdata.count; i++) {
+		stage = &pdata.stage[i];
+		if (!err)
+			err = stage->err;
+		if (!err) {
+			err = sbi_domain_register(stage->dom,
+						  &stage->assign_mask);
+			if (!err)
+				continue;
+		}
+		if (stage->dom)
+			fdt_domain_free(stage->dom);
+	}
+
+	sbi_free(pdata.stage);
+	return err;
 }
@@ -9,10 +9,12 @@
  */
 
 #include <libfdt.h>
+#include <sbi/sbi_boot_profile.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_domain.h>
 #include <sbi/sbi_math.h>
 #include <sbi/sbi_hart.h>
+#include <sbi/sbi_heap.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_string.h>
 #include <sbi/sbi_error.h>
@@ -112,10 +114,6 @@ void fdt_cpu_fixup(void *fdt)
 	const char *mmu_type;
 	u32 hartid;
 
-	err = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + 32);
-	if (err < 0)
-		return;
-
 	cpus_offset = fdt_path_offset(fdt, "/cpus");
 	if (cpus_offset < 0)
 		return;
@@ -137,9 +135,11 @@ void fdt_cpu_fixup(void *fdt)
 		mmu_type = fdt_getprop(fdt, cpu_offset, "mmu-type", &len);
 		if (!sbi_domain_is_assigned_hart(dom, hartid) ||
 		    !mmu_type || !len)
-			fdt_setprop_string(fdt, cpu_offset, "status",
-					   "disabled");
+			fdt_stage_setprop_string(fdt, cpu_offset, "status",
+						 "disabled");
 	}
+
+	fdt_stage_commit(fdt);
 }
 
 static void fdt_domain_based_fixup_one(void *fdt, int nodeoff)
@@ -153,12 +153,8 @@ static void fdt_domain_based_fixup_one(void *fdt, int nodeoff)
 		return;
 
 	if (!sbi_domain_check_addr(dom, reg_addr, dom->next_mode,
-				    SBI_DOMAIN_READ | SBI_DOMAIN_WRITE)) {
-		rc = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + 32);
-		if (rc < 0)
-			return;
-		fdt_setprop_string(fdt, nodeoff, "status", "disabled");
-	}
+				    SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		fdt_stage_setprop_string(fdt, nodeoff, "status", "disabled");
 }
 
 static void fdt_fixup_node(void *fdt, const char *compatible)
@@ -168,6 +164,8 @@ static void fdt_fixup_node(void *fdt, const char *compatible)
 	while ((noff = fdt_node_offset_by_compatible(fdt, noff,
 						     compatible)) >= 0)
 		fdt_domain_based_fixup_one(fdt, noff);
+
+	fdt_stage_commit(fdt);
 }
 
 void fdt_aplic_fixup(void *fdt)
@@ -180,18 +178,10 @@ void fdt_imsic_fixup(void *fdt)
 	fdt_fixup_node(fdt, "riscv,imsics");
 }
 
-void fdt_plic_fixup(void *fdt)
+static void fdt_plic_fixup_one(void *fdt, int plic_off)
 {
 	u32 *cells;
 	int i, cells_count;
-	int plic_off;
-
-	plic_off = fdt_node_offset_by_compatible(fdt, 0, "sifive,plic-1.0.0");
-	if (plic_off < 0) {
-		plic_off = fdt_node_offset_by_compatible(fdt, 0, "riscv,plic0");
-		if (plic_off < 0)
-			return;
-	}
 
 	cells = (u32 *)fdt_getprop(fdt, plic_off,
 				   "interrupts-extended", &cells_count);
@@ -208,6 +198,20 @@ void fdt_plic_fixup(void *fdt)
 	}
 }
 
+void fdt_plic_fixup(void *fdt)
+{
+	int plic_off;
+
+	plic_off = fdt_node_offset_by_compatible(fdt, 0, "sifive,plic-1.0.0");
+	if (plic_off < 0) {
+		plic_off = fdt_node_offset_by_compatible(fdt, 0, "riscv,plic0");
+		if (plic_off < 0)
+			return;
+	}
+
+	fdt_plic_fixup_one(fdt, plic_off);
+}
+
 static int fdt_resv_memory_update_node(void *fdt, unsigned long addr,
 				       unsigned long size, int index,
 				       int parent)
@@ -400,19 +404,184 @@ void fdt_config_fixup(void *fdt)
 	fdt_nop_node(fdt, config_offset);
 }
 
-void fdt_fixups(void *fdt)
+void fdt_boot_profile_fixup(void *fdt)
 {
-	fdt_aplic_fixup(fdt);
+	const struct sbi_boot_profile_phase *phases;
+	int chosen_offset, err;
+	u32 i, count;
 
-	fdt_imsic_fixup(fdt);
+	count = sbi_boot_profile_phases(&phases);
+	if (!count)
+		return;
 
-	fdt_plic_fixup(fdt);
+	err = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) +
+			    count * (sizeof(fdt64_t) + 32) + 64);
+	if (err < 0)
+		return;
 
-	fdt_reserved_memory_fixup(fdt);
+	chosen_offset = fdt_path_offset(fdt, "/chosen");
+	if (chosen_offset < 0)
+		return;
+
+	fdt_delprop(fdt, chosen_offset, "opensbi,boot-phases");
+	fdt_delprop(fdt, chosen_offset, "opensbi,boot-cycles");
+	for (i = 0; i < count; i++) {
+		if (fdt_appendprop_string(fdt, chosen_offset,
+					  "opensbi,boot-phases",
+					  phases[i].name) ||
+		    fdt_appendprop_u64(fdt, chosen_offset,
+				       "opensbi,boot-cycles",
+				       phases[i].cycles))
+			return;
+	}
+}
 
+static void fdt_pmu_fixup_one(void *fdt, int nodeoff)
+{
+	fdt_pmu_fixup_node(fdt, nodeoff);
+}
+
+/** Fixup applied by fdt_fixups() to nodes with a given compatible string */
+struct fdt_fixup_match {
+	const char *compatible;
+	void (*fixup)(void *fdt, int nodeoff);
+};
+
+static const struct fdt_fixup_match fdt_fixup_matches[] = {
+	{ .compatible = "riscv,aplic", .fixup = fdt_domain_based_fixup_one },
+	{ .compatible = "riscv,imsics", .fixup = fdt_domain_based_fixup_one },
+	{ .compatible = "sifive,plic-1.0.0", .fixup = fdt_plic_fixup_one },
+	{ .compatible = "riscv,plic0", .fixup = fdt_plic_fixup_one },
 #ifndef CONFIG_FDT_FIXUPS_PRESERVE_PMU_NODE
-	fdt_pmu_fixup(fdt);
+	{ .compatible = "riscv,pmu", .fixup = fdt_pmu_fixup_one },
+#endif
+};
+
+#define FDT_FIXUP_HASH_SIZE		32
+
+/* Index plus one of the matching entry in fdt_fixup_matches[] */
+static u8 fdt_fixup_hash[FDT_FIXUP_HASH_SIZE];
+static bool fdt_fixup_hash_ready;
+
+static void fdt_fixup_hash_init(void)
+{
+	const char *compat;
+	u32 i, pos;
+
+	for (i = 0; i < array_size(fdt_fixup_matches); i++) {
+		compat = fdt_fixup_matches[i].compatible;
+		pos = fdt_string_hash(compat, sbi_strlen(compat));
+		pos %= FDT_FIXUP_HASH_SIZE;
+		while (fdt_fixup_hash[pos])
+			pos = (pos + 1) % FDT_FIXUP_HASH_SIZE;
+		fdt_fixup_hash[pos] = i + 1;
+	}
+
+	fdt_fixup_hash_ready = true;
+}
+
+static const struct fdt_fixup_match *fdt_fixup_lookup(const char *str,
+						      int len)
+{
+	const struct fdt_fixup_match *m;
+	u32 pos, i;
+
+	pos = fdt_string_hash(str, len) % FDT_FIXUP_HASH_SIZE;
+	for (i = 0; i < FDT_FIXUP_HASH_SIZE && fdt_fixup_hash[pos]; i++) {
+		m = &fdt_fixup_matches[fdt_fixup_hash[pos] - 1];
+		if (!sbi_strncmp(m->compatible, str, len) &&
+		    !m->compatible[len])
+			return m;
+		pos = (pos + 1) % FDT_FIXUP_HASH_SIZE;
+	}
+
+	return NULL;
+}
+
+/*
+ * Walk the whole tree once and apply the fixup matching the first
+ * known entry in the compatible list of every node. The fixups only
+ * stage property writes or replace properties with NOPs, so the node
+ * offsets stay valid until the staged writes are committed at the end.
+ */
+static void fdt_fixup_nodes(void *fdt)
+{
+	const struct fdt_fixup_match *m;
+	int noff, depth = 0, len, slen;
+	const char *compat;
+
+	if (!fdt_fixup_hash_ready)
+		fdt_fixup_hash_init();
+
+	for (noff = fdt_next_node(fdt, -1, &depth); noff >= 0;
+	     noff = fdt_next_node(fdt, noff, &depth)) {
+		compat = fdt_getprop(fdt, noff, "compatible", &len);
+		while (compat && len > 0) {
+			slen = sbi_strnlen(compat, len);
+			m = fdt_fixup_lookup(compat, slen);
+			if (m) {
+				m->fixup(fdt, noff);
+				break;
+			}
+			compat += slen + 1;
+			len -= slen + 1;
+		}
+	}
+
+	fdt_stage_commit(fdt);
+}
+
+#ifdef CONFIG_FDT_OVERLAY
+int fdt_apply_overlays(void *fdt, const void *overlays)
+{
+	unsigned long size = 0;
+	const char *ovl;
+	void *copy;
+	int err;
+
+	if (!overlays)
+		return 0;
+
+	for (ovl = overlays; fdt_magic(ovl) == FDT_MAGIC;
+	     ovl += fdt_totalsize(ovl))
+		size += fdt_totalsize(ovl);
+	if (!size)
+		return 0;
+
+	/*
+	 * The merged __symbols__ paths can be longer than the ones of the
+	 * overlays, twice their size is plenty.
+	 */
+	err = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + 2 * size);
+	if (err < 0)
+		return err;
+
+	for (ovl = overlays; fdt_magic(ovl) == FDT_MAGIC;
+	     ovl += fdt_totalsize(ovl)) {
+		copy = sbi_malloc(fdt_totalsize(ovl));
+		if (!copy)
+			return SBI_ENOMEM;
+
+		sbi_memcpy(copy, ovl, fdt_totalsize(ovl));
+		err = fdt_overlay_apply(fdt, copy);
+		sbi_free(copy);
+		if (err < 0)
+			return err;
+	}
+
+	return fdt_pack(fdt);
+}
 #endif
 
+void fdt_fixups(void *fdt)
+{
+	fdt_fixup_nodes(fdt);
+
+	fdt_reserved_memory_fixup(fdt);
+
 	fdt_config_fixup(fdt);
+
+#ifdef CONFIG_FDT_FIXUPS_BOOT_PROFILE
+	fdt_boot_profile_fixup(fdt);
+#endif
 }
@@ -10,6 +10,7 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_heap.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_hart.h>
@@ -52,6 +53,150 @@ const struct fdt_match *fdt_match_node(void *fdt, int nodeoff,
 	return NULL;
 }
 
+u32 fdt_string_hash(const char *str, int len)
+{
+	u32 hash = 2166136261U;
+	int i;
+
+	for (i = 0; i < len; i++)
+		hash = (hash ^ (u8)str[i]) * 16777619U;
+
+	return hash;
+}
+
+/** One compatible string of one node in the compatible index */
+struct fdt_compat_entry {
+	u32 hash;
+	int nodeoff;
+};
+
+/**
+ * Index of all compatible strings of a device tree
+ *
+ * The entries are grouped by hash bucket and ordered by node offset
+ * within a bucket. The index is only valid as long as the size of the
+ * structure block is unchanged since any edit which moves nodes also
+ * changes it.
+ */
+struct fdt_compat_index {
+	const void *fdt;
+	u32 size_dt_struct;
+	u32 bucket_count;
+	u32 *bucket_start;
+	struct fdt_compat_entry *entries;
+};
+
+static struct fdt_compat_index compat_index;
+
+#define fdt_for_each_compat(__fdt, __noff, __compat, __len, __slen)	\
+	for (__compat = fdt_getprop(__fdt, __noff, "compatible", &__len); \
+	     __compat && __len > 0 &&					\
+	     ((__slen = sbi_strnlen(__compat, __len)), 1);		\
+	     __compat += __slen + 1, __len -= __slen + 1)
+
+static void fdt_compat_index_free(void)
+{
+	if (compat_index.bucket_start)
+		sbi_free(compat_index.bucket_start);
+	if (compat_index.entries)
+		sbi_free(compat_index.entries);
+	sbi_memset(&compat_index, 0, sizeof(compat_index));
+}
+
+static int fdt_compat_index_build(const void *fdt)
+{
+	int noff, depth, len, slen;
+	u32 i, b, count = 0, bucket_count = 1;
+	const char *compat;
+	u32 *pos;
+
+	fdt_compat_index_free();
+
+	depth = 0;
+	for (noff = fdt_next_node(fdt, -1, &depth); noff >= 0;
+	     noff = fdt_next_node(fdt, noff, &depth)) {
+		fdt_for_each_compat(fdt, noff, compat, len, slen)
+			count++;
+	}
+
+	while (bucket_count < count)
+		bucket_count <<= 1;
+
+	compat_index.bucket_start = sbi_calloc(sizeof(u32), bucket_count + 1);
+	compat_index.entries = sbi_calloc(sizeof(*compat_index.entries),
+					  count ? count : 1);
+	if (!compat_index.bucket_start || !compat_index.entries) {
+		fdt_compat_index_free();
+		return SBI_ENOMEM;
+	}
+
+	/* Count entries per bucket and turn counts into start indexes */
+	depth = 0;
+	for (noff = fdt_next_node(fdt, -1, &depth); noff >= 0;
+	     noff = fdt_next_node(fdt, noff, &depth)) {
+		fdt_for_each_compat(fdt, noff, compat, len, slen) {
+			b = fdt_string_hash(compat, slen) & (bucket_count - 1);
+			compat_index.bucket_start[b + 1]++;
+		}
+	}
+	for (i = 0; i < bucket_count; i++)
+		compat_index.bucket_start[i + 1] += compat_index.bucket_start[i];
+
+	/* Nodes are visited in offset order so buckets end up sorted */
+	pos = sbi_calloc(sizeof(u32), bucket_count);
+	if (!pos) {
+		fdt_compat_index_free();
+		return SBI_ENOMEM;
+	}
+	depth = 0;
+	for (noff = fdt_next_node(fdt, -1, &depth); noff >= 0;
+	     noff = fdt_next_node(fdt, noff, &depth)) {
+		fdt_for_each_compat(fdt, noff, compat, len, slen) {
+			u32 hash = fdt_string_hash(compat, slen);
+
+			b = hash & (bucket_count - 1);
+			i = compat_index.bucket_start[b] + pos[b]++;
+			compat_index.entries[i].hash = hash;
+			compat_index.entries[i].nodeoff = noff;
+		}
+	}
+	sbi_free(pos);
+
+	compat_index.fdt = fdt;
+	compat_index.size_dt_struct = fdt_size_dt_struct(fdt);
+	compat_index.bucket_count = bucket_count;
+
+	return 0;
+}
+
+static int fdt_compat_index_lookup(const void *fdt, int startoff,
+				   const char *compatible)
+{
+	const struct fdt_compat_entry *e;
+	u32 hash, b, i;
+
+	if (compat_index.fdt != fdt ||
+	    compat_index.size_dt_struct != fdt_size_dt_struct(fdt)) {
+		if (fdt_compat_index_build(fdt))
+			return fdt_node_offset_by_compatible(fdt, startoff,
+							     compatible);
+	}
+
+	hash = fdt_string_hash(compatible, sbi_strlen(compatible));
+	b = hash & (compat_index.bucket_count - 1);
+	for (i = compat_index.bucket_start[b];
+	     i < compat_index.bucket_start[b + 1]; i++) {
+		e = &compat_index.entries[i];
+		if (e->nodeoff <= startoff || e->hash != hash)
+			continue;
+		/* Resolve hash collisions and catch in-place edits */
+		if (!fdt_node_check_compatible(fdt, e->nodeoff, compatible))
+			return e->nodeoff;
+	}
+
+	return -FDT_ERR_NOTFOUND;
+}
+
 int fdt_find_match(void *fdt, int startoff,
 		   const struct fdt_match *match_table,
 		   const struct fdt_match **out_match)
@@ -62,8 +207,8 @@ int fdt_find_match(void *fdt, int startoff,
 		return SBI_ENODEV;
 
 	while (match_table->compatible) {
-		nodeoff = fdt_node_offset_by_compatible(fdt, startoff,
-						match_table->compatible);
+		nodeoff = fdt_compat_index_lookup(fdt, startoff,
+						  match_table->compatible);
 		if (nodeoff >= 0) {
 			if (fdt_node_is_enabled(fdt, nodeoff)) {
 				if (out_match)
@@ -77,6 +222,435 @@ int fdt_find_match(void *fdt, int startoff,
 	return SBI_ENODEV;
 }
 
+#ifdef CONFIG_FDT_NODE_INDEX
+#define FDT_NODE_INDEX_MAX_DEPTH	32
+
+/** One phandle of the node index */
+struct fdt_phandle_entry {
+	u32 phandle;
+	int nodeoff;
+};
+
+/**
+ * Index of all nodes of a device tree
+ *
+ * The node offsets are in tree order which is also ascending offset
+ * order so a node is found by binary search. The parent of each node
+ * is kept as an index into the same array. The phandles are kept in an
+ * open addressing hash table with a power of two size which is at least
+ * twice the number of phandles so a lookup takes one or two probes.
+ * Like the compatible index, this is only valid as long as the size of
+ * the structure block is unchanged.
+ */
+struct fdt_node_index {
+	const void *fdt;
+	u32 size_dt_struct;
+	u32 node_count;
+	u32 phandle_slots;
+	int cpus_off;
+	int *offsets;
+	int *parents;
+	struct fdt_phandle_entry *phandles;
+};
+
+static struct fdt_node_index node_index;
+
+static inline u32 fdt_phandle_slot(u32 phandle, u32 slots)
+{
+	return (phandle * 0x9E3779B1U) & (slots - 1);
+}
+
+static void fdt_node_index_free(void)
+{
+	if (node_index.offsets)
+		sbi_free(node_index.offsets);
+	if (node_index.parents)
+		sbi_free(node_index.parents);
+	if (node_index.phandles)
+		sbi_free(node_index.phandles);
+	sbi_memset(&node_index, 0, sizeof(node_index));
+}
+
+static int fdt_node_index_build(const void *fdt)
+{
+	int noff, depth, stack[FDT_NODE_INDEX_MAX_DEPTH];
+	u32 i, h, count = 0, pcount = 0, slots = 1, phandle;
+
+	fdt_node_index_free();
+
+	depth = 0;
+	for (noff = fdt_next_node(fdt, -1, &depth); noff >= 0;
+	     noff = fdt_next_node(fdt, noff, &depth)) {
+		if (depth >= FDT_NODE_INDEX_MAX_DEPTH)
+			return SBI_EINVAL;
+		count++;
+		if (fdt_get_phandle(fdt, noff))
+			pcount++;
+	}
+
+	while (slots < 2 * pcount)
+		slots <<= 1;
+
+	node_index.offsets = sbi_calloc(sizeof(int), count ? count : 1);
+	node_index.parents = sbi_calloc(sizeof(int), count ? count : 1);
+	node_index.phandles = sbi_calloc(sizeof(*node_index.phandles), slots);
+	if (!node_index.offsets || !node_index.parents ||
+	    !node_index.phandles) {
+		fdt_node_index_free();
+		return SBI_ENOMEM;
+	}
+
+	i = 0;
+	depth = 0;
+	for (noff = fdt_next_node(fdt, -1, &depth); noff >= 0;
+	     noff = fdt_next_node(fdt, noff, &depth)) {
+		stack[depth] = i;
+		node_index.offsets[i] = noff;
+		node_index.parents[i] = depth ? stack[depth - 1] : -1;
+
+		phandle = fdt_get_phandle(fdt, noff);
+		if (phandle) {
+			/* Keep the first node like libfdt for duplicates */
+			h = fdt_phandle_slot(phandle, slots);
+			while (node_index.phandles[h].phandle &&
+			       node_index.phandles[h].phandle != phandle)
+				h = (h + 1) & (slots - 1);
+			if (!node_index.phandles[h].phandle) {
+				node_index.phandles[h].phandle = phandle;
+				node_index.phandles[h].nodeoff = noff;
+			}
+		}
+		i++;
+	}
+
+	node_index.cpus_off = fdt_subnode_offset(fdt, 0, "cpus");
+	node_index.fdt = fdt;
+	node_index.size_dt_struct = fdt_size_dt_struct(fdt);
+	node_index.node_count = count;
+	node_index.phandle_slots = slots;
+
+	return 0;
+}
+
+static bool fdt_node_index_valid(const void *fdt)
+{
+	if (node_index.fdt == fdt &&
+	    node_index.size_dt_struct == fdt_size_dt_struct(fdt))
+		return true;
+
+	return !fdt_node_index_build(fdt);
+}
+
+static int fdt_node_index_find(int nodeoff)
+{
+	int lo = 0, hi = (int)node_index.node_count - 1, mid;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (node_index.offsets[mid] == nodeoff)
+			return mid;
+		if (node_index.offsets[mid] < nodeoff)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	return -1;
+}
+
+int fdt_node_offset_by_phandle_cached(const void *fdt, u32 phandle)
+{
+	const struct fdt_phandle_entry *e;
+	u32 h;
+
+	if (!phandle || phandle == (u32)-1 || !fdt_node_index_valid(fdt))
+		return fdt_node_offset_by_phandle(fdt, phandle);
+
+	h = fdt_phandle_slot(phandle, node_index.phandle_slots);
+	for (e = &node_index.phandles[h]; e->phandle;
+	     h = (h + 1) & (node_index.phandle_slots - 1),
+	     e = &node_index.phandles[h]) {
+		if (e->phandle != phandle)
+			continue;
+		/* Catch in-place edits of the phandle property */
+		if (fdt_get_phandle(fdt, e->nodeoff) == phandle)
+			return e->nodeoff;
+		return fdt_node_offset_by_phandle(fdt, phandle);
+	}
+
+	return -FDT_ERR_NOTFOUND;
+}
+
+int fdt_parent_offset_cached(const void *fdt, int nodeoff)
+{
+	int i;
+
+	if (nodeoff < 0 || !fdt_node_index_valid(fdt))
+		return fdt_parent_offset(fdt, nodeoff);
+
+	i = fdt_node_index_find(nodeoff);
+	if (i < 0)
+		return fdt_parent_offset(fdt, nodeoff);
+	if (node_index.parents[i] < 0)
+		return -FDT_ERR_NOTFOUND;
+
+	return node_index.offsets[node_index.parents[i]];
+}
+
+int fdt_cpus_offset_cached(const void *fdt)
+{
+	if (!fdt_node_index_valid(fdt))
+		return fdt_path_offset(fdt, "/cpus");
+
+	return node_index.cpus_off;
+}
+#else
+int fdt_node_offset_by_phandle_cached(const void *fdt, u32 phandle)
+{
+	return fdt_node_offset_by_phandle(fdt, phandle);
+}
+
+int fdt_parent_offset_cached(const void *fdt, int nodeoff)
+{
+	return fdt_parent_offset(fdt, nodeoff);
+}
+
+int fdt_cpus_offset_cached(const void *fdt)
+{
+	return fdt_path_offset(fdt, "/cpus");
+}
+#endif
+
+/** One property write staged by fdt_stage_setprop() */
+struct fdt_stage_edit {
+	int nodeoff;
+	const char *name;
+	const void *val;
+	int len;
+	/* Resolved by fdt_stage_commit() */
+	int off;
+	int oldsize;
+	int nameoff;
+};
+
+static struct fdt_stage_edit *stage_edits;
+static u32 stage_count, stage_max;
+
+#define FDT_STAGE_PROP_SIZE(__len)					\
+	(sizeof(struct fdt_property) +					\
+	 (((__len) + FDT_TAGSIZE - 1) & ~(FDT_TAGSIZE - 1)))
+
+int fdt_stage_setprop(void *fdt, int nodeoff, const char *name,
+		      const void *val, int len)
+{
+	struct fdt_stage_edit *e;
+	u32 i;
+
+	if (!fdt || nodeoff < 0 || !name || len < 0 || (len && !val))
+		return SBI_EINVAL;
+
+	for (i = 0; i < stage_count; i++) {
+		e = &stage_edits[i];
+		if (e->nodeoff == nodeoff && !sbi_strcmp(e->name, name)) {
+			e->val = val;
+			e->len = len;
+			return 0;
+		}
+	}
+
+	if (stage_count == stage_max) {
+		i = stage_max ? stage_max * 2 : 16;
+		e = sbi_malloc(i * sizeof(*e));
+		if (!e)
+			return SBI_ENOMEM;
+		if (stage_edits) {
+			sbi_memcpy(e, stage_edits, stage_count * sizeof(*e));
+			sbi_free(stage_edits);
+		}
+		stage_edits = e;
+		stage_max = i;
+	}
+
+	e = &stage_edits[stage_count++];
+	e->nodeoff = nodeoff;
+	e->name = name;
+	e->val = val;
+	e->len = len;
+
+	return 0;
+}
+
+int fdt_stage_setprop_string(void *fdt, int nodeoff, const char *name,
+			     const char *str)
+{
+	if (!str)
+		return SBI_EINVAL;
+
+	return fdt_stage_setprop(fdt, nodeoff, name, str, sbi_strlen(str) + 1);
+}
+
+static int fdt_stage_find_string(const void *fdt, const char *name)
+{
+	const char *strtab = (const char *)fdt + fdt_off_dt_strings(fdt);
+	int len = sbi_strlen(name) + 1, size = fdt_size_dt_strings(fdt);
+	const char *p;
+
+	for (p = strtab; p + len <= strtab + size; p++) {
+		if (!sbi_memcmp(p, name, len))
+			return p - strtab;
+	}
+
+	return -1;
+}
+
+static int fdt_stage_resolve(void *fdt, struct fdt_stage_edit *e)
+{
+	const struct fdt_property *prop;
+	int oldlen, slen, next;
+	char *strtab;
+
+	if (fdt_next_tag(fdt, e->nodeoff, &next) != FDT_BEGIN_NODE)
+		return SBI_EINVAL;
+
+	prop = fdt_get_property(fdt, e->nodeoff, e->name, &oldlen);
+	if (prop) {
+		e->off = (const char *)prop -
+			 ((const char *)fdt + fdt_off_dt_struct(fdt));
+		e->oldsize = FDT_STAGE_PROP_SIZE(oldlen);
+		e->nameoff = fdt32_to_cpu(prop->nameoff);
+		return 0;
+	}
+	if (oldlen != -FDT_ERR_NOTFOUND)
+		return oldlen;
+
+	/* New properties go first in the node like fdt_setprop() does */
+	e->off = next;
+	e->oldsize = 0;
+	e->nameoff = fdt_stage_find_string(fdt, e->name);
+	if (e->nameoff >= 0)
+		return 0;
+
+	/* The strings block is last after fdt_open_into() */
+	slen = sbi_strlen(e->name) + 1;
+	if (fdt_off_dt_strings(fdt) + fdt_size_dt_strings(fdt) + slen >
+	    fdt_totalsize(fdt))
+		return -FDT_ERR_NOSPACE;
+	strtab = (char *)fdt + fdt_off_dt_strings(fdt);
+	e->nameoff = fdt_size_dt_strings(fdt);
+	sbi_memcpy(strtab + e->nameoff, e->name, slen);
+	fdt_set_size_dt_strings(fdt, e->nameoff + slen);
+
+	return 0;
+}
+
+static void fdt_stage_write(char *p, const struct fdt_stage_edit *e,
+			    int size)
+{
+	struct fdt_property *prop = (struct fdt_property *)p;
+	int pos;
+
+	prop->tag = cpu_to_fdt32(FDT_PROP);
+	prop->len = cpu_to_fdt32(e->len);
+	prop->nameoff = cpu_to_fdt32(e->nameoff);
+	sbi_memcpy(prop->data, e->val, e->len);
+
+	/* Zero the padding and fill space left by shrinking with NOPs */
+	pos = sizeof(*prop) + e->len;
+	sbi_memset(p + pos, 0, FDT_STAGE_PROP_SIZE(e->len) - pos);
+	for (pos = FDT_STAGE_PROP_SIZE(e->len); pos < size; pos += FDT_TAGSIZE)
+		*(fdt32_t *)(p + pos) = cpu_to_fdt32(FDT_NOP);
+}
+
+int fdt_stage_commit(void *fdt)
+{
+	int i, j, rc = 0, need = 0, shift, size, segend, segstart;
+	struct fdt_stage_edit tmp, *e;
+	char *st;
+
+	if (!stage_count)
+		return 0;
+	if (!fdt) {
+		rc = SBI_EINVAL;
+		goto done;
+	}
+
+	/* Grow once by an upper bound of the space needed by all edits */
+	for (i = 0; i < stage_count; i++) {
+		e = &stage_edits[i];
+		need += FDT_STAGE_PROP_SIZE(e->len) + sbi_strlen(e->name) + 1;
+	}
+	rc = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + need);
+	if (rc < 0)
+		goto done;
+
+	for (i = 0; i < stage_count; i++) {
+		rc = fdt_stage_resolve(fdt, &stage_edits[i]);
+		if (rc)
+			goto done;
+	}
+
+	/* Sort by offset, the edits mostly arrive in tree order anyway */
+	for (i = 1; i < stage_count; i++) {
+		tmp = stage_edits[i];
+		for (j = i; j > 0; j--) {
+			e = &stage_edits[j - 1];
+			/*
+			 * New properties of a node go before a replaced
+			 * first property, and in reverse order like they
+			 * would with fdt_setprop()
+			 */
+			if (e->off < tmp.off ||
+			    (e->off == tmp.off && !e->oldsize && tmp.oldsize))
+				break;
+			stage_edits[j] = *e;
+		}
+		stage_edits[j] = tmp;
+	}
+
+	/*
+	 * Shrinking edits keep their size by padding with NOPs so that
+	 * every edit only moves data towards the end of the blob. The
+	 * data after the structure block and after each edit is then
+	 * moved exactly once, starting from the end.
+	 */
+	shift = 0;
+	for (i = 0; i < stage_count; i++) {
+		e = &stage_edits[i];
+		size = FDT_STAGE_PROP_SIZE(e->len);
+		if (size > e->oldsize)
+			shift += size - e->oldsize;
+	}
+
+	st = (char *)fdt + fdt_off_dt_struct(fdt);
+	if (fdt_off_dt_struct(fdt) + fdt_size_dt_struct(fdt) + shift >
+	    fdt_off_dt_strings(fdt)) {
+		sbi_memmove((char *)fdt + fdt_off_dt_strings(fdt) + shift,
+			    (char *)fdt + fdt_off_dt_strings(fdt),
+			    fdt_size_dt_strings(fdt));
+		fdt_set_off_dt_strings(fdt, fdt_off_dt_strings(fdt) + shift);
+	}
+
+	segend = fdt_size_dt_struct(fdt);
+	fdt_set_size_dt_struct(fdt, segend + shift);
+	for (i = stage_count - 1; i >= 0; i--) {
+		e = &stage_edits[i];
+		size = FDT_STAGE_PROP_SIZE(e->len);
+		if (size < e->oldsize)
+			size = e->oldsize;
+
+		segstart = e->off + e->oldsize;
+		sbi_memmove(st + segstart + shift, st + segstart,
+			    segend - segstart);
+		shift -= size - e->oldsize;
+		fdt_stage_write(st + e->off + shift, e, size);
+		segend = e->off;
+	}
+
+done:
+	stage_count = 0;
+	return rc;
+}
+
 int fdt_parse_phandle_with_args(void *fdt, int nodeoff,
 				const char *prop, const char *cells_prop,
 				int index, struct fdt_phandle_args *out_args)
@@ -94,7 +668,7 @@ int fdt_parse_phandle_with_args(void *fdt, int nodeoff,
 	list_end = list + (len / sizeof(*list));
 
 	while (list < list_end) {
-		pnodeoff = fdt_node_offset_by_phandle(fdt,
+		pnodeoff = fdt_node_offset_by_phandle_cached(fdt,
 						fdt32_to_cpu(*list));
 		if (pnodeoff < 0)
 			return pnodeoff;
@@ -173,7 +747,7 @@ int fdt_get_node_addr_size(void *fdt, int node, int index,
 	if (!fdt || node < 0 || index < 0)
 		return SBI_EINVAL;
 
-	parent = fdt_parent_offset(fdt, node);
+	parent = fdt_parent_offset_cached(fdt, node);
 	if (parent < 0)
 		return parent;
 	cell_addr = fdt_address_cells(fdt, parent);
@@ -203,7 +777,7 @@ int fdt_get_node_addr_size(void *fdt, int node, int index,
 			rc  = fdt_translate_address(fdt, temp, parent, addr);
 			if (rc)
 				break;
-			parent = fdt_parent_offset(fdt, parent);
+			parent = fdt_parent_offset_cached(fdt, parent);
 			temp = *addr;
 		} while (1);
 	}
@@ -290,6 +864,61 @@ int fdt_parse_hart_id(void *fdt, int cpu_offset, u32 *hartid)
 	return 0;
 }
 
+int fdt_parse_numa_node_id(void *fdt, int nodeoff)
+{
+	const fdt32_t *val;
+	int len;
+
+	if (!fdt)
+		return SBI_EINVAL;
+
+	/* Like Linux, a node inherits the NUMA node of its parents */
+	for (; nodeoff >= 0; nodeoff = fdt_parent_offset(fdt, nodeoff)) {
+		val = fdt_getprop(fdt, nodeoff, "numa-node-id", &len);
+		if (val && len >= sizeof(fdt32_t))
+			return fdt32_to_cpu(*val) & INT_MAX;
+	}
+
+	return SBI_ENOENT;
+}
+
+int fdt_find_numa_local_intc_entry(void *fdt, int nodeoff, int numa_node,
+				   u32 hwirq, u32 *hartid)
+{
+	const fdt32_t *val;
+	int i, len, cpu_offset;
+	u32 id;
+
+	if (!fdt || nodeoff < 0 || numa_node < 0)
+		return SBI_EINVAL;
+
+	val = fdt_getprop(fdt, nodeoff, "interrupts-extended", &len);
+	if (!val || len < 2 * sizeof(fdt32_t))
+		return SBI_ENOENT;
+	len = len / sizeof(fdt32_t);
+
+	for (i = 0; i + 1 < len; i += 2) {
+		if (fdt32_to_cpu(val[i + 1]) != hwirq)
+			continue;
+
+		cpu_offset = fdt_node_offset_by_phandle_cached(fdt,
+						fdt32_to_cpu(val[i]));
+		if (cpu_offset < 0)
+			continue;
+		cpu_offset = fdt_parent_offset(fdt, cpu_offset);
+		if (fdt_parse_hart_id(fdt, cpu_offset, &id) ||
+		    !fdt_node_is_enabled(fdt, cpu_offset) ||
+		    fdt_parse_numa_node_id(fdt, cpu_offset) != numa_node)
+			continue;
+
+		if (hartid)
+			*hartid = id;
+		return i / 2;
+	}
+
+	return SBI_ENOENT;
+}
+
 int fdt_parse_max_enabled_hart_id(void *fdt, u32 *max_hartid)
 {
 	u32 hartid;
@@ -302,7 +931,7 @@ int fdt_parse_max_enabled_hart_id(void *fdt, u32 *max_hartid)
 
 	*max_hartid = 0;
 
-	cpus_offset = fdt_path_offset(fdt, "/cpus");
+	cpus_offset = fdt_cpus_offset_cached(fdt);
 	if (cpus_offset < 0)
 		return cpus_offset;
 
@@ -321,6 +950,101 @@ int fdt_parse_max_enabled_hart_id(void *fdt, u32 *max_hartid)
 	return 0;
 }
 
+static int fdt_cpu_map_hart(void *fdt, int nodeoff, u32 *min, u32 *max,
+			    u32 *count)
+{
+	const fdt32_t *val;
+	u32 hartid;
+	int len, err;
+
+	val = fdt_getprop(fdt, nodeoff, "cpu", &len);
+	if (!val || len < sizeof(fdt32_t))
+		return SBI_ENOENT;
+
+	err = fdt_parse_hart_id(fdt,
+			fdt_node_offset_by_phandle(fdt, fdt32_to_cpu(*val)),
+			&hartid);
+	if (err)
+		return err;
+
+	if (hartid < *min)
+		*min = hartid;
+	if (*max < hartid)
+		*max = hartid;
+	(*count)++;
+
+	return 0;
+}
+
+static int fdt_cpu_map_walk(void *fdt, int nodeoff, u32 *cluster_harts)
+{
+	u32 min = -1U, max = 0, count = 0;
+	int child, thread, err;
+	const char *name;
+
+	fdt_for_each_subnode(child, fdt, nodeoff) {
+		name = fdt_get_name(fdt, child, NULL);
+		if (!name)
+			continue;
+
+		if (!strncmp(name, "socket", strlen("socket")) ||
+		    !strncmp(name, "cluster", strlen("cluster"))) {
+			err = fdt_cpu_map_walk(fdt, child, cluster_harts);
+			if (err)
+				return err;
+			continue;
+		}
+
+		if (strncmp(name, "core", strlen("core")))
+			continue;
+
+		/* Cores either point to a cpu or contain threads */
+		if (!fdt_cpu_map_hart(fdt, child, &min, &max, &count))
+			continue;
+		fdt_for_each_subnode(thread, fdt, child) {
+			err = fdt_cpu_map_hart(fdt, thread, &min, &max, &count);
+			if (err)
+				return err;
+		}
+	}
+
+	/* Only the innermost clusters contain cores */
+	if (!count)
+		return 0;
+
+	if ((count & (count - 1)) || (max - min + 1) != count ||
+	    (min & (count - 1)))
+		return SBI_EINVAL;
+	if (*cluster_harts && *cluster_harts != count)
+		return SBI_EINVAL;
+
+	*cluster_harts = count;
+	return 0;
+}
+
+int fdt_parse_cpu_map_cluster_harts(void *fdt, u32 *cluster_harts)
+{
+	int err, cpus_offset, map_offset;
+
+	if (!fdt || !cluster_harts)
+		return SBI_EINVAL;
+
+	cpus_offset = fdt_cpus_offset_cached(fdt);
+	if (cpus_offset < 0)
+		return cpus_offset;
+
+	map_offset = fdt_subnode_offset(fdt, cpus_offset, "cpu-map");
+	if (map_offset < 0)
+		return SBI_ENOENT;
+
+	*cluster_harts = 0;
+	err = fdt_cpu_map_walk(fdt, map_offset, cluster_harts);
+	if (err)
+		return err;
+
+	return *cluster_harts ? 0 : SBI_ENOENT;
+}
+
 int fdt_parse_timebase_frequency(void *fdt, unsigned long *freq)
 {
 	const fdt32_t *val;
@@ -329,7 +1053,7 @@ int fdt_parse_timebase_frequency(void *fdt, unsigned long *freq)
 	if (!fdt || !freq)
 		return SBI_EINVAL;
 
-	cpus_offset = fdt_path_offset(fdt, "/cpus");
+	cpus_offset = fdt_cpus_offset_cached(fdt);
 	if (cpus_offset < 0)
 		return cpus_offset;
 
@@ -343,13 +1067,59 @@ int fdt_parse_timebase_frequency(void *fdt, unsigned long *freq)
 }
 
 #define RISCV_ISA_EXT_NAME_LEN_MAX	32
+#define RISCV_ISA_EXT_SLOTS		64
+#define RISCV_ISA_MEMO_MAX		4
+
+_Static_assert(2 * SBI_HART_EXT_MAX <= RISCV_ISA_EXT_SLOTS,
+	       "RISCV_ISA_EXT_SLOTS too small for sbi_hart_ext[]");
 
 static unsigned long fdt_isa_bitmap_offset;
 
+/* Hash table of sbi_hart_ext[] names, slots hold the index plus one */
+static u8 fdt_isa_ext_slots[RISCV_ISA_EXT_SLOTS];
+static bool fdt_isa_ext_slots_ready;
+
+static void fdt_isa_ext_table_init(void)
+{
+	const char *name;
+	u32 i, h;
+
+	if (fdt_isa_ext_slots_ready)
+		return;
+
+	for (i = 0; i < SBI_HART_EXT_MAX; i++) {
+		name = sbi_hart_ext[i].name;
+		h = fdt_string_hash(name, strlen(name)) &
+		    (RISCV_ISA_EXT_SLOTS - 1);
+		while (fdt_isa_ext_slots[h])
+			h = (h + 1) & (RISCV_ISA_EXT_SLOTS - 1);
+		fdt_isa_ext_slots[h] = i + 1;
+	}
+	fdt_isa_ext_slots_ready = true;
+}
+
+static int fdt_isa_ext_lookup(const char *name, int len)
+{
+	const char *ext;
+	u32 h;
+
+	if (!len || len >= RISCV_ISA_EXT_NAME_LEN_MAX)
+		return -1;
+
+	h = fdt_string_hash(name, len) & (RISCV_ISA_EXT_SLOTS - 1);
+	for (; fdt_isa_ext_slots[h]; h = (h + 1) & (RISCV_ISA_EXT_SLOTS - 1)) {
+		ext = sbi_hart_ext[fdt_isa_ext_slots[h] - 1].name;
+		if (!strncmp(ext, name, len) && !ext[len])
+			return sbi_hart_ext[fdt_isa_ext_slots[h] - 1].id;
+	}
+
+	return -1;
+}
+
 static int fdt_parse_isa_one_hart(const char *isa, unsigned long *extensions)
 {
 	size_t i, j, isa_len;
-	char mstr[RISCV_ISA_EXT_NAME_LEN_MAX];
+	int id;
 
 	i = 0;
 	isa_len = strlen(isa);
@@ -386,48 +1156,61 @@ static int fdt_parse_isa_one_hart(const char *isa, unsigned long *extensions)
 		/* Skip the '_' character */
 		i++;
 
-		/* Extract the multi-letter extension name */
-		j = 0;
-		while ((i < isa_len) && (isa[i] != '_') &&
-		       (j < (sizeof(mstr) - 1)))
-			mstr[j++] = isa[i++];
-		mstr[j] = '\0';
+		/* Find the end of the multi-letter extension name */
+		for (j = i; j < isa_len && isa[j] != '_'; j++)
+			;
 
-		/* Skip empty multi-letter extension name */
-		if (!j)
-			continue;
+		id = fdt_isa_ext_lookup(&isa[i], j - i);
+		if (id >= 0)
+			__set_bit(id, extensions);
+		i = j;
+	}
 
-#define set_multi_letter_ext(name, bit)				\
-			if (!strcmp(mstr, name)) {		\
-				__set_bit(bit, extensions);	\
-				continue;			\
-			}
+	return 0;
+}
 
-		for (j = 0; j < SBI_HART_EXT_MAX; j++) {
-			set_multi_letter_ext(sbi_hart_ext[j].name,
-					     sbi_hart_ext[j].id);
-		}
-#undef set_multi_letter_ext
+static int fdt_parse_isa_ext_list(const char *list, int len,
+				  unsigned long *extensions)
+{
+	int slen, id;
+
+	for (; len > 0; list += slen + 1, len -= slen + 1) {
+		slen = sbi_strnlen(list, len);
+		id = fdt_isa_ext_lookup(list, slen);
+		if (id >= 0)
+			__set_bit(id, extensions);
 	}
 
 	return 0;
 }
 
+/** Result of parsing one distinct ISA property value */
+struct fdt_isa_memo {
+	u32 hash;
+	int len;
+	const void *val;
+	unsigned long exts[BITS_TO_LONGS(SBI_HART_EXT_MAX)];
+};
+
 static int fdt_parse_isa_all_harts(void *fdt)
 {
-	u32 hartid;
-	const fdt32_t *val;
+	u32 hartid, hash;
+	const void *val;
+	bool ext_list;
 	unsigned long *hart_exts;
 	struct sbi_scratch *scratch;
-	int err, cpu_offset, cpus_offset, len;
+	struct fdt_isa_memo memo[RISCV_ISA_MEMO_MAX], *m;
+	int i, err, cpu_offset, cpus_offset, len, memo_count = 0;
 
 	if (!fdt || !fdt_isa_bitmap_offset)
 		return SBI_EINVAL;
 
-	cpus_offset = fdt_path_offset(fdt, "/cpus");
+	cpus_offset = fdt_cpus_offset_cached(fdt);
 	if (cpus_offset < 0)
 		return cpus_offset;
 
+	fdt_isa_ext_table_init();
+
 	fdt_for_each_subnode(cpu_offset, fdt, cpus_offset) {
 		err = fdt_parse_hart_id(fdt, cpu_offset, &hartid);
 		if (err)
@@ -436,7 +1219,14 @@ static int fdt_parse_isa_all_harts(void *fdt)
 		if (!fdt_node_is_enabled(fdt, cpu_offset))
 			continue;
 
-		val = fdt_getprop(fdt, cpu_offset, "riscv,isa", &len);
+		/* Prefer the string list over the ISA string if present */
+		ext_list = true;
+		val = fdt_getprop(fdt, cpu_offset, "riscv,isa-extensions",
+				  &len);
+		if (!val || len <= 0) {
+			ext_list = false;
+			val = fdt_getprop(fdt, cpu_offset, "riscv,isa", &len);
+		}
 		if (!val || len <= 0)
 			return SBI_ENOENT;
 
@@ -447,9 +1237,34 @@ static int fdt_parse_isa_all_harts(void *fdt)
 		hart_exts = sbi_scratch_offset_ptr(scratch,
 						   fdt_isa_bitmap_offset);
 
-		err = fdt_parse_isa_one_hart((const char *)val, hart_exts);
+		/* Most HARTs share one of very few distinct ISA values */
+		hash = fdt_string_hash(val, len) ^ ext_list;
+		for (i = 0; i < memo_count; i++) {
+			m = &memo[i];
+			if (m->hash == hash && m->len == len &&
+			    !sbi_memcmp(m->val, val, len))
+				break;
+		}
+		if (i < memo_count) {
+			for (i = 0; i < BITS_TO_LONGS(SBI_HART_EXT_MAX); i++)
+				hart_exts[i] |= m->exts[i];
+			continue;
+		}
+
+		if (ext_list)
+			err = fdt_parse_isa_ext_list(val, len, hart_exts);
+		else
+			err = fdt_parse_isa_one_hart(val, hart_exts);
 		if (err)
 			return err;
+
+		if (memo_count < RISCV_ISA_MEMO_MAX) {
+			m = &memo[memo_count++];
+			m->hash = hash;
+			m->len = len;
+			m->val = val;
+			sbi_memcpy(m->exts, hart_exts, sizeof(m->exts));
+		}
 	}
 
 	return 0;
@@ -608,6 +1423,28 @@ int fdt_parse_xlnx_uartlite_node(void *fdt, int nodeoffset,
 	return fdt_parse_uart_node_common(fdt, nodeoffset, uart, 0, 0);
 }
 
+/*
+ * Make the sources of an APLIC which has a NUMA node target the first HART
+ * of that NUMA node by default, interrupts-extended of the APLIC or of its
+ * IMSIC lists the HARTs in hart index order.
+ */
+static void fdt_aplic_numa_default_target(void *fdt, int nodeoff,
+					  int intc_offset, bool mmode,
+					  struct aplic_data *aplic)
+{
+	int numa_node, idx;
+
+	numa_node = fdt_parse_numa_node_id(fdt, nodeoff);
+	if (numa_node < 0)
+		return;
+
+	idx = fdt_find_numa_local_intc_entry(fdt, intc_offset, numa_node,
+					     mmode ? IRQ_M_EXT : IRQ_S_EXT,
+					     NULL);
+	if (idx > 0)
+		aplic->default_target = idx;
+}
+
 int fdt_parse_aplic_node(void *fdt, int nodeoff, struct aplic_data *aplic)
 {
 	bool child_found;
@@ -642,12 +1479,15 @@ int fdt_parse_aplic_node(void *fdt, int nodeoff, struct aplic_data *aplic)
 			}
 		}
 		aplic->num_idc = len / 2;
+		fdt_aplic_numa_default_target(fdt, nodeoff, nodeoff,
+					      aplic->targets_mmode, aplic);
 		goto aplic_msi_parent_done;
 	}
 
 	val = fdt_getprop(fdt, nodeoff, "msi-parent", &len);
 	if (val && len >= sizeof(fdt32_t)) {
-		noff = fdt_node_offset_by_phandle(fdt, fdt32_to_cpu(*val));
+		noff = fdt_node_offset_by_phandle_cached(fdt,
+							  fdt32_to_cpu(*val));
 		if (noff < 0)
 			return noff;
 
@@ -660,6 +1500,10 @@ int fdt_parse_aplic_node(void *fdt, int nodeoff, struct aplic_data *aplic)
 			return rc;
 
 		aplic->targets_mmode = imsic.targets_mmode;
+		if (!imsic.group_index_bits)
+			fdt_aplic_numa_default_target(fdt, nodeoff, noff,
+						      imsic.targets_mmode,
+						      aplic);
 
 		if (imsic.targets_mmode) {
 			aplic->has_msicfg_mmode = true;
@@ -680,7 +1524,8 @@ int fdt_parse_aplic_node(void *fdt, int nodeoff, struct aplic_data *aplic)
 		if (!val || len < sizeof(fdt32_t))
 			goto aplic_msi_parent_done;
 
-		noff = fdt_node_offset_by_phandle(fdt, fdt32_to_cpu(*val));
+		noff = fdt_node_offset_by_phandle_cached(fdt,
+							  fdt32_to_cpu(*val));
 		if (noff < 0)
 			return noff;
 
@@ -688,7 +1533,8 @@ int fdt_parse_aplic_node(void *fdt, int nodeoff, struct aplic_data *aplic)
 		if (!val || len < sizeof(fdt32_t))
 			goto aplic_msi_parent_done;
 
-		noff = fdt_node_offset_by_phandle(fdt, fdt32_to_cpu(*val));
+		noff = fdt_node_offset_by_phandle_cached(fdt,
+							  fdt32_to_cpu(*val));
 		if (noff < 0)
 			return noff;
 
@@ -1003,11 +1849,12 @@ int fdt_parse_aclint_node(void *fdt, int nodeoffset,
 		phandle = fdt32_to_cpu(val[2 * i]);
 		hwirq = fdt32_to_cpu(val[(2 * i) + 1]);
 
-		cpu_intc_offset = fdt_node_offset_by_phandle(fdt, phandle);
+		cpu_intc_offset = fdt_node_offset_by_phandle_cached(fdt,
+								     phandle);
 		if (cpu_intc_offset < 0)
 			continue;
 
-		cpu_offset = fdt_parent_offset(fdt, cpu_intc_offset);
+		cpu_offset = fdt_parent_offset_cached(fdt, cpu_intc_offset);
 		if (cpu_offset < 0)
 			continue;
 
@@ -1067,11 +1914,12 @@ int fdt_parse_plmt_node(void *fdt, int nodeoffset, unsigned long *plmt_base,
 		phandle = fdt32_to_cpu(val[2 * i]);
 		hwirq = fdt32_to_cpu(val[2 * i + 1]);
 
-		cpu_intc_offset = fdt_node_offset_by_phandle(fdt, phandle);
+		cpu_intc_offset = fdt_node_offset_by_phandle_cached(fdt,
+								     phandle);
 		if (cpu_intc_offset < 0)
 			continue;
 
-		cpu_offset = fdt_parent_offset(fdt, cpu_intc_offset);
+		cpu_offset = fdt_parent_offset_cached(fdt, cpu_intc_offset);
 		if (cpu_offset < 0)
 			continue;
 
@@ -1123,11 +1971,12 @@ int fdt_parse_plicsw_node(void *fdt, int nodeoffset, unsigned long *plicsw_base,
 		phandle = fdt32_to_cpu(val[2 * i]);
 		hwirq = fdt32_to_cpu(val[2 * i + 1]);
 
-		cpu_intc_offset = fdt_node_offset_by_phandle(fdt, phandle);
+		cpu_intc_offset = fdt_node_offset_by_phandle_cached(fdt,
+								     phandle);
 		if (cpu_intc_offset < 0)
 			continue;
 
-		cpu_offset = fdt_parent_offset(fdt, cpu_intc_offset);
+		cpu_offset = fdt_parent_offset_cached(fdt, cpu_intc_offset);
 		if (cpu_offset < 0)
 			continue;
 
@@ -35,10 +35,22 @@ uint64_t fdt_pmu_get_select_value(uint32_t event_idx)
 	return 0;
 }
 
+int fdt_pmu_fixup_node(void *fdt, int pmu_offset)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	fdt_nop_property(fdt, pmu_offset, "riscv,event-to-mhpmcounters");
+	fdt_nop_property(fdt, pmu_offset, "riscv,event-to-mhpmevent");
+	fdt_nop_property(fdt, pmu_offset, "riscv,raw-event-to-mhpmcounters");
+	if (!sbi_hart_has_extension(scratch, SBI_HART_EXT_SSCOFPMF))
+		fdt_nop_property(fdt, pmu_offset, "interrupts-extended");
+
+	return 0;
+}
+
 int fdt_pmu_fixup(void *fdt)
 {
 	int pmu_offset;
-	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 
 	if (!fdt)
 		return SBI_EINVAL;
@@ -47,13 +59,7 @@ int fdt_pmu_fixup(void *fdt)
 	if (pmu_offset < 0)
 		return SBI_EFAIL;
 
-	fdt_delprop(fdt, pmu_offset, "riscv,event-to-mhpmcounters");
-	fdt_delprop(fdt, pmu_offset, "riscv,event-to-mhpmevent");
-	fdt_delprop(fdt, pmu_offset, "riscv,raw-event-to-mhpmcounters");
-	if (!sbi_hart_has_extension(scratch, SBI_HART_EXT_SSCOFPMF))
-		fdt_delprop(fdt, pmu_offset, "interrupts-extended");
-
-	return 0;
+	return fdt_pmu_fixup_node(fdt, pmu_offset);
 }
 
 int fdt_pmu_setup(void *fdt)
@@ -38,7 +38,7 @@ static int fdt_gpio_init(void *fdt, u32 phandle)
 	const struct fdt_match *match;
 
 	/* Find node offset */
-	nodeoff = fdt_node_offset_by_phandle(fdt, phandle);
+	nodeoff = fdt_node_offset_by_phandle_cached(fdt, phandle);
 	if (nodeoff < 0)
 		return nodeoff;
 
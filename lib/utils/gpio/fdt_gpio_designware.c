@@ -72,6 +72,30 @@ static void dw_gpio_set(struct gpio_pin *gp, int value)
 	writel(v, chip->dr + DW_GPIO_DR);
 }
 
+static int dw_gpio_get_multiple(struct gpio_chip *gc,
+				const unsigned long *mask, unsigned long *bits)
+{
+	struct dw_gpio_chip *chip = container_of(gc, struct dw_gpio_chip, chip);
+
+	/* The external port register reflects the level of all pins */
+	bits[0] = readl(chip->ext) & mask[0];
+
+	return 0;
+}
+
+static void dw_gpio_set_multiple(struct gpio_chip *gc,
+				 const unsigned long *mask,
+				 const unsigned long *bits)
+{
+	struct dw_gpio_chip *chip = container_of(gc, struct dw_gpio_chip, chip);
+	unsigned long v;
+
+	v = readl(chip->dr + DW_GPIO_DR);
+	v &= ~mask[0];
+	v |= bits[0] & mask[0];
+	writel(v, chip->dr + DW_GPIO_DR);
+}
+
 /* notes:
  * each sub node is a bank and has ngpios or snpns,nr-gpios and a reg property
  * with the compatible `snps,dw-apb-gpio-port`.
@@ -118,6 +142,8 @@ static int dw_gpio_init_bank(void *fdt, int nodeoff, u32 phandle,
 	chip->chip.id = phandle;
 	chip->chip.ngpio = nr_pins;
 	chip->chip.set = dw_gpio_set;
+	chip->chip.get_multiple = dw_gpio_get_multiple;
+	chip->chip.set_multiple = dw_gpio_set_multiple;
 	chip->chip.direction_output = dw_gpio_direction_output;
 	rc = gpio_chip_add(&chip->chip);
 	if (rc)
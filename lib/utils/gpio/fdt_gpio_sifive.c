@@ -60,6 +60,21 @@ static void sifive_gpio_set(struct gpio_pin *gp, int value)
 	writel(v, (volatile void *)(chip->addr + SIFIVE_GPIO_OUTVAL));
 }
 
+static void sifive_gpio_set_multiple(struct gpio_chip *gc,
+				     const unsigned long *mask,
+				     const unsigned long *bits)
+{
+	unsigned int v;
+	struct sifive_gpio_chip *chip =
+		container_of(gc, struct sifive_gpio_chip, chip);
+
+	/* All pins live in one 32-bit register */
+	v = readl((volatile void *)(chip->addr + SIFIVE_GPIO_OUTVAL));
+	v &= ~(unsigned int)mask[0];
+	v |= (unsigned int)(bits[0] & mask[0]);
+	writel(v, (volatile void *)(chip->addr + SIFIVE_GPIO_OUTVAL));
+}
+
 extern struct fdt_gpio fdt_gpio_sifive;
 
 static int sifive_gpio_init(void *fdt, int nodeoff, u32 phandle,
@@ -85,6 +100,7 @@ static int sifive_gpio_init(void *fdt, int nodeoff, u32 phandle,
 	chip->chip.ngpio = SIFIVE_GPIO_PINS_DEF;
 	chip->chip.direction_output = sifive_gpio_direction_output;
 	chip->chip.set = sifive_gpio_set;
+	chip->chip.set_multiple = sifive_gpio_set_multiple;
 	rc = gpio_chip_add(&chip->chip);
 	if (rc) {
 		sbi_free(chip);
@@ -69,6 +69,44 @@ static void starfive_gpio_set(struct gpio_pin *gp, int value)
 	writel(val, (void *)(reg_addr + STARFIVE_GPIO_OUTVAL));
 }
 
+static void starfive_gpio_set_multiple(struct gpio_chip *gc,
+				       const unsigned long *mask,
+				       const unsigned long *bits)
+{
+	u32 val, lanes, set;
+	unsigned long reg_addr;
+	unsigned int offset, shift_bits;
+	struct starfive_gpio_chip *chip =
+		container_of(gc, struct starfive_gpio_chip, chip);
+
+	/*
+	 * Each output value register holds one byte lane for four pins
+	 * so update all selected pins of a register with a single write.
+	 */
+	for (offset = 0; offset < gc->ngpio;
+	     offset += STARFIVE_GPIO_REG_SHIFT_MASK + 1) {
+		lanes = 0;
+		set = 0;
+		for (shift_bits = 0;
+		     shift_bits <= STARFIVE_GPIO_REG_SHIFT_MASK; shift_bits++) {
+			if (!__test_bit(offset + shift_bits, mask))
+				continue;
+			lanes |= STARFIVE_GPIO_MASK <<
+				(shift_bits << STARFIVE_GPIO_SHIFT_BITS);
+			if (__test_bit(offset + shift_bits, bits))
+				set |= 1U << (shift_bits << STARFIVE_GPIO_SHIFT_BITS);
+		}
+		if (!lanes)
+			continue;
+
+		reg_addr = chip->addr + offset + STARFIVE_GPIO_OUTVAL;
+		val = readl((void *)reg_addr);
+		val &= ~lanes;
+		val |= set;
+		writel(val, (void *)reg_addr);
+	}
+}
+
 extern struct fdt_gpio fdt_gpio_starfive;
 
 static int starfive_gpio_init(void *fdt, int nodeoff, u32 phandle,
@@ -94,6 +132,7 @@ static int starfive_gpio_init(void *fdt, int nodeoff, u32 phandle,
 	chip->chip.ngpio = STARFIVE_GPIO_PINS_DEF;
 	chip->chip.direction_output = starfive_gpio_direction_output;
 	chip->chip.set = starfive_gpio_set;
+	chip->chip.set_multiple = starfive_gpio_set_multiple;
 	rc = gpio_chip_add(&chip->chip);
 	if (rc) {
 		sbi_free(chip);
@@ -8,6 +8,7 @@
  */
 
 #include <sbi/sbi_error.h>
+#include <sbi/sbi_string.h>
 #include <sbi_utils/gpio/gpio.h>
 
 static SBI_LIST_HEAD(gpio_chip_list);
@@ -108,3 +109,129 @@ int gpio_set(struct gpio_pin *gp, int value)
 	gp->chip->set(gp, value);
 	return 0;
 }
+
+static bool gpio_pin_valid(struct gpio_pin *gp)
+{
+	return gp && gp->chip && (gp->offset < gp->chip->ngpio);
+}
+
+static bool gpio_chip_has_multiple(struct gpio_chip *gc, bool set)
+{
+	if (gc->ngpio > GPIO_CHIP_MULTIPLE_MAX)
+		return false;
+
+	return set ? gc->set_multiple != NULL : gc->get_multiple != NULL;
+}
+
+/*
+ * Collect the pins of gps[first..count) which belong to the GPIO chip of
+ * gps[first] into mask and mark them in done so they are visited once.
+ */
+static void gpio_multiple_collect(struct gpio_pin *gps, unsigned int first,
+				  unsigned int count, unsigned long *done,
+				  unsigned long *mask)
+{
+	struct gpio_chip *gc = gps[first].chip;
+	unsigned int i;
+
+	sbi_memset(mask, 0, BITS_TO_LONGS(GPIO_CHIP_MULTIPLE_MAX) *
+		   sizeof(unsigned long));
+	for (i = first; i < count; i++) {
+		if (gps[i].chip != gc || __test_bit(i, done))
+			continue;
+		__set_bit(gps[i].offset, mask);
+		__set_bit(i, done);
+	}
+}
+
+int gpio_get_multiple(struct gpio_pin *gps, unsigned int count, int *values)
+{
+	unsigned long mask[BITS_TO_LONGS(GPIO_CHIP_MULTIPLE_MAX)];
+	unsigned long bits[BITS_TO_LONGS(GPIO_CHIP_MULTIPLE_MAX)];
+	unsigned long done[BITS_TO_LONGS(GPIO_CHIP_MULTIPLE_MAX)] = { 0 };
+	unsigned int i, j;
+	int rc;
+
+	if (!gps || !values || count > GPIO_CHIP_MULTIPLE_MAX)
+		return SBI_EINVAL;
+	for (i = 0; i < count; i++) {
+		if (!gpio_pin_valid(&gps[i]))
+			return SBI_EINVAL;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (__test_bit(i, done))
+			continue;
+
+		if (!gpio_chip_has_multiple(gps[i].chip, false)) {
+			rc = gpio_get(&gps[i]);
+			if (rc < 0)
+				return rc;
+			values[i] = rc;
+			__set_bit(i, done);
+			continue;
+		}
+
+		gpio_multiple_collect(gps, i, count, done, mask);
+		rc = gps[i].chip->get_multiple(gps[i].chip, mask, bits);
+		if (rc)
+			return rc;
+
+		for (j = i; j < count; j++) {
+			if (gps[j].chip != gps[i].chip)
+				continue;
+			values[j] = __test_bit(gps[j].offset, bits) ? 1 : 0;
+			if (gps[j].flags & GPIO_FLAG_ACTIVE_LOW)
+				values[j] = values[j] == 0 ? 1 : 0;
+		}
+	}
+
+	return 0;
+}
+
+int gpio_set_multiple(struct gpio_pin *gps, unsigned int count,
+		      const int *values)
+{
+	unsigned long mask[BITS_TO_LONGS(GPIO_CHIP_MULTIPLE_MAX)];
+	unsigned long bits[BITS_TO_LONGS(GPIO_CHIP_MULTIPLE_MAX)];
+	unsigned long done[BITS_TO_LONGS(GPIO_CHIP_MULTIPLE_MAX)] = { 0 };
+	unsigned int i, j;
+	int rc, value;
+
+	if (!gps || !values || count > GPIO_CHIP_MULTIPLE_MAX)
+		return SBI_EINVAL;
+	for (i = 0; i < count; i++) {
+		if (!gpio_pin_valid(&gps[i]))
+			return SBI_EINVAL;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (__test_bit(i, done))
+			continue;
+
+		if (!gpio_chip_has_multiple(gps[i].chip, true)) {
+			rc = gpio_set(&gps[i], values[i]);
+			if (rc)
+				return rc;
+			__set_bit(i, done);
+			continue;
+		}
+
+		gpio_multiple_collect(gps, i, count, done, mask);
+		sbi_memset(bits, 0, sizeof(bits));
+		for (j = i; j < count; j++) {
+			if (gps[j].chip != gps[i].chip)
+				continue;
+			value = values[j];
+			if (gps[j].flags & GPIO_FLAG_ACTIVE_LOW)
+				value = value == 0 ? 1 : 0;
+			if (value)
+				__set_bit(gps[j].offset, bits);
+			else
+				__clear_bit(gps[j].offset, bits);
+		}
+		gps[i].chip->set_multiple(gps[i].chip, mask, bits);
+	}
+
+	return 0;
+}
@@ -58,8 +58,12 @@
 #define IC_DATA_CMD_READ	BIT(8)
 #define IC_DATA_CMD_STOP	BIT(9)
 #define IC_DATA_CMD_RESTART	BIT(10)
+#define IC_INT_STATUS_TX_ABRT	BIT(6)
 #define IC_INT_STATUS_STOPDET	BIT(9)
 
+#define IC_COMP_PARAM_1_RX_DEPTH_SHIFT	8
+#define IC_COMP_PARAM_1_TX_DEPTH_SHIFT	16
+
 static inline void dw_i2c_setreg(struct dw_i2c_adapter *adap,
 				 u8 reg, u32 value)
 {
@@ -110,12 +114,42 @@ static int dw_i2c_write_addr(struct dw_i2c_adapter *adap, u8 addr)
 	return 0;
 }
 
+/*
+ * Wait for the TX FIFO to have room (when tx is set) or the RX FIFO to
+ * have data. The timeout matches dw_i2c_adapter_poll() and is restarted
+ * by the callers whenever the transfer makes progress.
+ */
+static int dw_i2c_adapter_wait_fifo(struct dw_i2c_adapter *adap, bool tx,
+				    u32 *txflr, u32 *rxflr, int *count)
+{
+	unsigned int timeout = 10; /* msec */
+
+	do {
+		if (dw_i2c_getreg(adap, DW_IC_RAW_INTR_STAT) &
+		    IC_INT_STATUS_TX_ABRT) {
+			dw_i2c_getreg(adap, DW_IC_CLR_TX_ABRT);
+			return SBI_EIO;
+		}
+
+		*txflr = dw_i2c_getreg(adap, DW_IC_TXFLR);
+		*rxflr = dw_i2c_getreg(adap, DW_IC_RXFLR);
+		if ((tx && *txflr < adap->tx_fifo_depth) || *rxflr)
+			return 0;
+
+		sbi_timer_udelay(2);
+		*count += 1;
+		if (*count == (timeout * 1000))
+			return SBI_ETIMEDOUT;
+	} while (1);
+}
+
 static int dw_i2c_adapter_read(struct i2c_adapter *ia, u8 addr,
 			       u8 reg, u8 *buffer, int len)
 {
 	struct dw_i2c_adapter *adap =
 		container_of(ia, struct dw_i2c_adapter, adapter);
-	int rc;
+	int rc, count = 0, cmds = len, inflight = 0;
+	u32 txflr, rxflr;
 
 	dw_i2c_write_addr(adap, addr);
 
@@ -126,21 +160,39 @@ static int dw_i2c_adapter_read(struct i2c_adapter *ia, u8 addr,
 	/* set register address */
 	dw_i2c_setreg(adap, DW_IC_DATA_CMD, reg);
 
-	/* set value */
+	/*
+	 * Queue as many read commands as both FIFOs can take and drain
+	 * the RX FIFO in bursts instead of polling for every byte.
+	 */
 	while (len) {
-		if (len == 1)
-			dw_i2c_setreg(adap, DW_IC_DATA_CMD,
-				      IC_DATA_CMD_READ | IC_DATA_CMD_STOP);
-		else
-			dw_i2c_setreg(adap, DW_IC_DATA_CMD, IC_DATA_CMD_READ);
-
-		rc = dw_i2c_adapter_poll_rxrdy(adap);
+		rc = dw_i2c_adapter_wait_fifo(adap,
+					      cmds && inflight < adap->rx_fifo_depth,
+					      &txflr, &rxflr, &count);
 		if (rc)
 			return rc;
 
-		*buffer = dw_i2c_getreg(adap, DW_IC_DATA_CMD) & 0xff;
-		buffer++;
-		len--;
+		while (cmds && txflr < adap->tx_fifo_depth &&
+		       inflight < adap->rx_fifo_depth) {
+			if (cmds == 1)
+				dw_i2c_setreg(adap, DW_IC_DATA_CMD,
+					      IC_DATA_CMD_READ | IC_DATA_CMD_STOP);
+			else
+				dw_i2c_setreg(adap, DW_IC_DATA_CMD,
+					      IC_DATA_CMD_READ);
+			txflr++;
+			inflight++;
+			cmds--;
+			count = 0;
+		}
+
+		while (rxflr && len) {
+			*buffer = dw_i2c_getreg(adap, DW_IC_DATA_CMD) & 0xff;
+			buffer++;
+			inflight--;
+			rxflr--;
+			len--;
+			count = 0;
+		}
 	}
 
 	return 0;
@@ -151,7 +203,8 @@ static int dw_i2c_adapter_write(struct i2c_adapter *ia, u8 addr,
 {
 	struct dw_i2c_adapter *adap =
 		container_of(ia, struct dw_i2c_adapter, adapter);
-	int rc;
+	int rc, count = 0;
+	u32 txflr, rxflr;
 
 	dw_i2c_write_addr(adap, addr);
 
@@ -162,18 +215,25 @@ static int dw_i2c_adapter_write(struct i2c_adapter *ia, u8 addr,
 	/* set register address */
 	dw_i2c_setreg(adap, DW_IC_DATA_CMD, reg);
 
+	/* Fill the TX FIFO up to its depth before waiting again */
 	while (len) {
-		rc = dw_i2c_adapter_poll_txfifo_ready(adap);
+		rc = dw_i2c_adapter_wait_fifo(adap, true, &txflr, &rxflr,
+					      &count);
 		if (rc)
 			return rc;
 
-		if (len == 1)
-			dw_i2c_setreg(adap, DW_IC_DATA_CMD, *buffer | IC_DATA_CMD_STOP);
-		else
-			dw_i2c_setreg(adap, DW_IC_DATA_CMD, *buffer);
+		while (len && txflr < adap->tx_fifo_depth) {
+			if (len == 1)
+				dw_i2c_setreg(adap, DW_IC_DATA_CMD,
+					      *buffer | IC_DATA_CMD_STOP);
+			else
+				dw_i2c_setreg(adap, DW_IC_DATA_CMD, *buffer);
 
-		buffer++;
-		len--;
+			buffer++;
+			txflr++;
+			len--;
+			count = 0;
+		}
 	}
 	rc = dw_i2c_adapter_poll_txfifo_ready(adap);
 
@@ -182,6 +242,19 @@ static int dw_i2c_adapter_write(struct i2c_adapter *ia, u8 addr,
 
 int dw_i2c_init(struct i2c_adapter *adapter, int nodeoff)
 {
+	struct dw_i2c_adapter *adap =
+		container_of(adapter, struct dw_i2c_adapter, adapter);
+	u32 param = dw_i2c_getreg(adap, DW_IC_COMP_PARAM_1);
+
+	/*
+	 * IC_COMP_PARAM_1 is optional and reads as zero when absent which
+	 * gives a depth of one, same as transferring byte by byte.
+	 */
+	adap->tx_fifo_depth =
+		((param >> IC_COMP_PARAM_1_TX_DEPTH_SHIFT) & 0xff) + 1;
+	adap->rx_fifo_depth =
+		((param >> IC_COMP_PARAM_1_RX_DEPTH_SHIFT) & 0xff) + 1;
+
 	adapter->id = nodeoff;
 	adapter->write = dw_i2c_adapter_write;
 	adapter->read = dw_i2c_adapter_read;
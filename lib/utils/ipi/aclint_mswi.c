@@ -12,57 +12,40 @@
 #include <sbi/riscv_io.h>
 #include <sbi/sbi_domain.h>
 #include <sbi/sbi_error.h>
+#include <sbi/sbi_heap.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_timer.h>
 #include <sbi_utils/ipi/aclint_mswi.h>
 
-static unsigned long mswi_ptr_offset;
-
-#define mswi_get_hart_data_ptr(__scratch)				\
-	sbi_scratch_read_type((__scratch), void *, mswi_ptr_offset)
-
-#define mswi_set_hart_data_ptr(__scratch, __mswi)			\
-	sbi_scratch_write_type((__scratch), void *, mswi_ptr_offset, (__mswi))
+/* Address of the MSIP register of each HART, indexed by HART index */
+static u32 **mswi_msip;
+static u32 mswi_msip_count;
 
 static void mswi_ipi_send(u32 hart_index)
 {
 	u32 *msip;
-	struct sbi_scratch *scratch;
-	struct aclint_mswi_data *mswi;
-
-	scratch = sbi_hartindex_to_scratch(hart_index);
-	if (!scratch)
-		return;
 
-	mswi = mswi_get_hart_data_ptr(scratch);
-	if (!mswi)
+	if (hart_index >= mswi_msip_count)
 		return;
 
 	/* Set ACLINT IPI */
-	msip = (void *)mswi->addr;
-	writel_relaxed(1, &msip[sbi_hartindex_to_hartid(hart_index) -
-			mswi->first_hartid]);
+	msip = mswi_msip[hart_index];
+	if (msip)
+		writel_relaxed(1, msip);
 }
 
 static void mswi_ipi_clear(u32 hart_index)
 {
 	u32 *msip;
-	struct sbi_scratch *scratch;
-	struct aclint_mswi_data *mswi;
-
-	scratch = sbi_hartindex_to_scratch(hart_index);
-	if (!scratch)
-		return;
 
-	mswi = mswi_get_hart_data_ptr(scratch);
-	if (!mswi)
+	if (hart_index >= mswi_msip_count)
 		return;
 
 	/* Clear ACLINT IPI */
-	msip = (void *)mswi->addr;
-	writel_relaxed(0, &msip[sbi_hartindex_to_hartid(hart_index) -
-			mswi->first_hartid]);
+	msip = mswi_msip[hart_index];
+	if (msip)
+		writel_relaxed(0, msip);
 }
 
 static struct sbi_ipi_device aclint_mswi = {
@@ -74,16 +57,15 @@ static struct sbi_ipi_device aclint_mswi = {
 int aclint_mswi_warm_init(void)
 {
 	/* Clear IPI for current HART */
-	mswi_ipi_clear(current_hartid());
+	mswi_ipi_clear(sbi_hartid_to_hartindex(current_hartid()));
 
 	return 0;
 }
 
 int aclint_mswi_cold_init(struct aclint_mswi_data *mswi)
 {
-	u32 i;
+	u32 i, hartindex;
 	int rc;
-	struct sbi_scratch *scratch;
 	unsigned long pos, region_size;
 	struct sbi_domain_memregion reg;
 
@@ -93,24 +75,25 @@ int aclint_mswi_cold_init(struct aclint_mswi_data *mswi)
 	    (!mswi->hart_count || mswi->hart_count > ACLINT_MSWI_MAX_HARTS))
 		return SBI_EINVAL;
 
-	/* Allocate scratch space pointer */
-	if (!mswi_ptr_offset) {
-		mswi_ptr_offset = sbi_scratch_alloc_type_offset(void *);
-		if (!mswi_ptr_offset)
+	/* Allocate the MSIP register table shared by all MSWI devices */
+	if (!mswi_msip) {
+		mswi_msip_count = sbi_scratch_last_hartindex() + 1;
+		mswi_msip = sbi_calloc(sizeof(*mswi_msip), mswi_msip_count);
+		if (!mswi_msip)
 			return SBI_ENOMEM;
 	}
 
-	/* Update MSWI pointer in scratch space */
+	/* Record the MSIP register of each HART of this device */
 	for (i = 0; i < mswi->hart_count; i++) {
-		scratch = sbi_hartid_to_scratch(mswi->first_hartid + i);
+		hartindex = sbi_hartid_to_hartindex(mswi->first_hartid + i);
 		/*
-		 * We don't need to fail if scratch pointer is not available
+		 * We don't need to fail if the HART index is not available
 		 * because we might be dealing with hartid of a HART disabled
 		 * in the device tree.
 		 */
-		if (!scratch)
+		if (!sbi_hartindex_valid(hartindex))
 			continue;
-		mswi_set_hart_data_ptr(scratch, mswi);
+		mswi_msip[hartindex] = &((u32 *)mswi->addr)[i];
 	}
 
 	/* Add MSWI regions to the root domain */
@@ -13,6 +13,7 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/riscv_io.h>
 #include <sbi/sbi_domain.h>
+#include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi_utils/ipi/andes_plicsw.h>
 
@@ -41,36 +42,73 @@ static void plicsw_ipi_send(u32 hart_index)
 	writel_relaxed(BIT(pending_bit), (void *)pending_reg);
 }
 
+static void plicsw_ipi_send_mask(const struct sbi_hartmask *mask)
+{
+	u32 i, interrupt_id, word_index, cur_index = 0, pending = 0;
+	u32 target_hart;
+
+	/*
+	 * The pending registers are write-one-to-set so all harts
+	 * sharing a pending word are interrupted with one write.
+	 */
+	sbi_hartmask_for_each_hartindex(i, mask) {
+		target_hart = sbi_hartindex_to_hartid(i);
+		if (plicsw.hart_count <= target_hart)
+			ebreak();
+
+		interrupt_id = target_hart + 1;
+		word_index   = interrupt_id / 32;
+		if (pending && word_index != cur_index) {
+			writel_relaxed(pending, (void *)(plicsw.addr +
+				PLICSW_PENDING_BASE + cur_index * 4));
+			pending = 0;
+		}
+		cur_index = word_index;
+		pending |= BIT(interrupt_id % 32);
+	}
+
+	if (pending)
+		writel_relaxed(pending, (void *)(plicsw.addr +
+			PLICSW_PENDING_BASE + cur_index * 4));
+}
+
 static void plicsw_ipi_clear(u32 hart_index)
 {
 	u32 target_hart = sbi_hartindex_to_hartid(hart_index);
 	ulong reg = plicsw.addr + PLICSW_CONTEXT_BASE + PLICSW_CONTEXT_CLAIM +
 		    PLICSW_CONTEXT_STRIDE * target_hart;
 
+	u32 source;
+
 	if (plicsw.hart_count <= target_hart)
 		ebreak();
 
-	/* Claim */
-	u32 source = readl((void *)reg);
+	/* Claim, a successful claim will clear mip.MSIP */
+	source = readl((void *)reg);
 
-	/* A successful claim will clear mip.MSIP */
+	/*
+	 * Only the source of this hart is enabled in its context so a
+	 * zero claim means no IPI is pending and there is nothing to
+	 * complete, which is the case for the clear done at warm init.
+	 */
+	if (!source)
+		return;
 
-	/* Complete */
-	writel(source, (void *)reg);
+	/* Complete, sbi_ipi_raw_clear() orders it with the wmb() */
+	writel_relaxed(source, (void *)reg);
 }
 
 static struct sbi_ipi_device plicsw_ipi = {
-	.name      = "andes_plicsw",
-	.ipi_send  = plicsw_ipi_send,
-	.ipi_clear = plicsw_ipi_clear
+	.name          = "andes_plicsw",
+	.ipi_send      = plicsw_ipi_send,
+	.ipi_send_mask = plicsw_ipi_send_mask,
+	.ipi_clear     = plicsw_ipi_clear
 };
 
 int plicsw_warm_ipi_init(void)
 {
-	u32 hartid = current_hartid();
-
 	/* Clear PLICSW IPI */
-	plicsw_ipi_clear(hartid);
+	plicsw_ipi_clear(sbi_hartid_to_hartindex(current_hartid()));
 
 	return 0;
 }
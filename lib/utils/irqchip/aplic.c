@@ -9,6 +9,7 @@
  */
 
 #include <sbi/riscv_io.h>
+#include <sbi/sbi_bitops.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_domain.h>
 #include <sbi/sbi_error.h>
@@ -165,52 +166,34 @@ static int aplic_check_msicfg(struct aplic_msicfg_data *msicfg)
 	return 0;
 }
 
-int aplic_cold_irqchip_init(struct aplic_data *aplic)
+/* Later delegations take precedence over earlier overlapping ones */
+static struct aplic_delegate_data *aplic_find_delegate(struct aplic_data *aplic,
+						       u32 deleg_valid, u32 irq)
 {
-	int rc;
-	u32 i, j, tmp;
-	struct sbi_domain_memregion reg;
 	struct aplic_delegate_data *deleg;
-	u32 first_deleg_irq, last_deleg_irq;
+	int i;
 
-	/* Sanity checks */
-	if (!aplic ||
-	    !aplic->num_source || APLIC_MAX_SOURCE <= aplic->num_source ||
-	    APLIC_MAX_IDC <= aplic->num_idc)
-		return SBI_EINVAL;
-	if (aplic->targets_mmode && aplic->has_msicfg_mmode) {
-		rc = aplic_check_msicfg(&aplic->msicfg_mmode);
-		if (rc)
-			return rc;
-	}
-	if (aplic->targets_mmode && aplic->has_msicfg_smode) {
-		rc = aplic_check_msicfg(&aplic->msicfg_smode);
-		if (rc)
-			return rc;
-	}
+	for (i = APLIC_MAX_DELEGATE - 1; deleg_valid && i >= 0; i--) {
+		if (!(deleg_valid & BIT(i)))
+			continue;
 
-	/* Set domain configuration to 0 */
-	writel(0, (void *)(aplic->addr + APLIC_DOMAINCFG));
+		deleg = &aplic->delegate[i];
+		if (deleg->first_irq <= irq && irq <= deleg->last_irq)
+			return deleg;
+	}
 
-	/* Disable all interrupts */
-	for (i = 0; i <= aplic->num_source; i += 32)
-		writel(-1U, (void *)(aplic->addr + APLIC_CLRIE_BASE +
-				     (i / 32) * sizeof(u32)));
+	return NULL;
+}
 
-	/* Set interrupt type and priority for all interrupts */
-	for (i = 1; i <= aplic->num_source; i++) {
-		/* Set IRQ source configuration to 0 */
-		writel(0, (void *)(aplic->addr + APLIC_SOURCECFG_BASE +
-			  (i - 1) * sizeof(u32)));
-		/* Set IRQ target hart index and priority to 1 */
-		writel(APLIC_DEFAULT_PRIORITY, (void *)(aplic->addr +
-						APLIC_TARGET_BASE +
-						(i - 1) * sizeof(u32)));
-	}
+/* Check and normalize IRQ delegation, returns the valid delegations */
+static u32 aplic_normalize_delegates(struct aplic_data *aplic,
+				     u32 *first_deleg_irq, u32 *last_deleg_irq)
+{
+	u32 i, tmp, deleg_valid = 0;
+	struct aplic_delegate_data *deleg;
 
-	/* Configure IRQ delegation */
-	first_deleg_irq = -1U;
-	last_deleg_irq = 0;
+	*first_deleg_irq = -1U;
+	*last_deleg_irq = 0;
 	for (i = 0; i < APLIC_MAX_DELEGATE; i++) {
 		deleg = &aplic->delegate[i];
 		if (!deleg->first_irq || !deleg->last_irq)
@@ -225,14 +208,51 @@ int aplic_cold_irqchip_init(struct aplic_data *aplic)
 			deleg->first_irq = deleg->last_irq;
 			deleg->last_irq = tmp;
 		}
-		if (deleg->first_irq < first_deleg_irq)
-			first_deleg_irq = deleg->first_irq;
-		if (last_deleg_irq < deleg->last_irq)
-			last_deleg_irq = deleg->last_irq;
-		for (j = deleg->first_irq; j <= deleg->last_irq; j++)
+		if (deleg->first_irq < *first_deleg_irq)
+			*first_deleg_irq = deleg->first_irq;
+		if (*last_deleg_irq < deleg->last_irq)
+			*last_deleg_irq = deleg->last_irq;
+		deleg_valid |= BIT(i);
+	}
+
+	return deleg_valid;
+}
+
+static void aplic_program(struct aplic_data *aplic, u32 deleg_valid)
+{
+	u32 i;
+	struct aplic_delegate_data *deleg;
+
+	/* Set domain configuration to 0 */
+	writel(0, (void *)(aplic->addr + APLIC_DOMAINCFG));
+
+	/* Disable all interrupts */
+	for (i = 0; i <= aplic->num_source; i += 32)
+		writel(-1U, (void *)(aplic->addr + APLIC_CLRIE_BASE +
+				     (i / 32) * sizeof(u32)));
+
+	/*
+	 * Set interrupt type, delegation and priority for all interrupts
+	 * writing each register once. The target register of a delegated
+	 * interrupt is read-only zero so it is not written.
+	 */
+	for (i = 1; i <= aplic->num_source; i++) {
+		deleg = aplic_find_delegate(aplic, deleg_valid, i);
+		if (deleg) {
 			writel(APLIC_SOURCECFG_D | deleg->child_index,
-				(void *)(aplic->addr + APLIC_SOURCECFG_BASE +
-				(j - 1) * sizeof(u32)));
+			       (void *)(aplic->addr + APLIC_SOURCECFG_BASE +
+			       (i - 1) * sizeof(u32)));
+			continue;
+		}
+
+		/* Set IRQ source configuration to 0 */
+		writel(0, (void *)(aplic->addr + APLIC_SOURCECFG_BASE +
+			  (i - 1) * sizeof(u32)));
+		/* Set IRQ target hart index and priority (or EIID) to 1 */
+		writel((aplic->default_target << APLIC_TARGET_HART_IDX_SHIFT) |
+		       APLIC_DEFAULT_PRIORITY, (void *)(aplic->addr +
+						APLIC_TARGET_BASE +
+						(i - 1) * sizeof(u32)));
 	}
 
 	/* Default initialization of IDC structures */
@@ -258,6 +278,36 @@ int aplic_cold_irqchip_init(struct aplic_data *aplic)
 				(void *)(aplic->addr + APLIC_SMSICFGADDR),
 				(void *)(aplic->addr + APLIC_SMSICFGADDRH));
 	}
+}
+
+int aplic_cold_irqchip_init(struct aplic_data *aplic)
+{
+	int rc;
+	u32 deleg_valid;
+	struct sbi_domain_memregion reg;
+	u32 first_deleg_irq, last_deleg_irq;
+
+	/* Sanity checks */
+	if (!aplic ||
+	    !aplic->num_source || APLIC_MAX_SOURCE <= aplic->num_source ||
+	    APLIC_MAX_IDC <= aplic->num_idc ||
+	    APLIC_TARGET_HART_IDX_MASK < aplic->default_target ||
+	    (aplic->num_idc && aplic->num_idc <= aplic->default_target))
+		return SBI_EINVAL;
+	if (aplic->targets_mmode && aplic->has_msicfg_mmode) {
+		rc = aplic_check_msicfg(&aplic->msicfg_mmode);
+		if (rc)
+			return rc;
+	}
+	if (aplic->targets_mmode && aplic->has_msicfg_smode) {
+		rc = aplic_check_msicfg(&aplic->msicfg_smode);
+		if (rc)
+			return rc;
+	}
+
+	deleg_valid = aplic_normalize_delegates(aplic, &first_deleg_irq,
+						&last_deleg_irq);
+	aplic_program(aplic, deleg_valid);
 
 	/*
 	 * Add APLIC region to the root domain if:
@@ -280,3 +330,30 @@ int aplic_cold_irqchip_init(struct aplic_data *aplic)
 
 	return 0;
 }
+
+void aplic_resume_irqchip(struct aplic_data *aplic)
+{
+	u32 deleg_valid, first_deleg_irq, last_deleg_irq;
+
+	/* The supervisor restores the domains it owns by itself */
+	if (!aplic->targets_mmode)
+		return;
+
+	/*
+	 * The delegation or the MSI configuration reads back as programmed
+	 * when the APLIC kept its state.
+	 */
+	deleg_valid = aplic_normalize_delegates(aplic, &first_deleg_irq,
+						&last_deleg_irq);
+	if (deleg_valid) {
+		if (readl((void *)(aplic->addr + APLIC_SOURCECFG_BASE +
+				   (first_deleg_irq - 1) * sizeof(u32))) &
+		    APLIC_SOURCECFG_D)
+			return;
+	} else if (aplic->has_msicfg_mmode) {
+		if (readl((void *)(aplic->addr + APLIC_MMSICFGADDR)))
+			return;
+	}
+
+	aplic_program(aplic, deleg_valid);
+}
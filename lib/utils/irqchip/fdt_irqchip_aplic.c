@@ -12,10 +12,21 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_heap.h>
+#include <sbi/sbi_irqchip.h>
 #include <sbi_utils/fdt/fdt_helper.h>
 #include <sbi_utils/irqchip/fdt_irqchip.h>
 #include <sbi_utils/irqchip/aplic.h>
 
+struct irqchip_aplic {
+	struct aplic_data data;
+	struct sbi_irqchip_pm pm;
+};
+
+static void irqchip_aplic_resume(struct sbi_irqchip_pm *pm)
+{
+	aplic_resume_irqchip(&container_of(pm, struct irqchip_aplic, pm)->data);
+}
+
 static int irqchip_aplic_warm_init(void)
 {
 	/* Nothing to do here. */
@@ -26,20 +37,23 @@ static int irqchip_aplic_cold_init(void *fdt, int nodeoff,
 				  const struct fdt_match *match)
 {
 	int rc;
-	struct aplic_data *pd;
+	struct irqchip_aplic *pd;
 
 	pd = sbi_zalloc(sizeof(*pd));
 	if (!pd)
 		return SBI_ENOMEM;
 
-	rc = fdt_parse_aplic_node(fdt, nodeoff, pd);
+	rc = fdt_parse_aplic_node(fdt, nodeoff, &pd->data);
 	if (rc)
 		goto fail_free_data;
 
-	rc = aplic_cold_irqchip_init(pd);
+	rc = aplic_cold_irqchip_init(&pd->data);
 	if (rc)
 		goto fail_free_data;
 
+	pd->pm.resume = irqchip_aplic_resume;
+	sbi_irqchip_add_pm(&pd->pm);
+
 	return 0;
 
 fail_free_data:
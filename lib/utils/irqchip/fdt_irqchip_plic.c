@@ -10,13 +10,23 @@
 #include <libfdt.h>
 #include <sbi/riscv_asm.h>
 #include <sbi/riscv_io.h>
+#include <sbi/sbi_console.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_heap.h>
+#include <sbi/sbi_irqchip.h>
 #include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
 #include <sbi_utils/fdt/fdt_helper.h>
 #include <sbi_utils/irqchip/fdt_irqchip.h>
 #include <sbi_utils/irqchip/plic.h>
 
+/* PLIC instance with what is needed to restore it after system suspend */
+struct irqchip_plic {
+	struct plic_data data;
+	struct sbi_irqchip_pm pm;
+	void (*plat_init)(struct plic_data *pd);
+};
+
 static unsigned long plic_ptr_offset;
 
 #define plic_get_hart_data_ptr(__scratch)				\
@@ -43,16 +53,46 @@ static unsigned long plic_scontext_offset;
 
 void fdt_plic_priority_save(u8 *priority, u32 num)
 {
-	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct sbi_scratch *rscratch, *scratch = sbi_scratch_thishart_ptr();
+	struct plic_data *pd = plic_get_hart_data_ptr(scratch);
+	u32 i;
+
+	if (!pd->saved_src) {
+		plic_priority_save(pd, priority, num);
+		return;
+	}
+
+	/*
+	 * Priorities only matter for sources enabled in some context so
+	 * collect the enable words of all HARTs sharing this PLIC instead
+	 * of reading the priority of every source.
+	 */
+	sbi_memset(pd->saved_src, 0, (pd->num_src / 32 + 1) * sizeof(u32));
+	for (i = 0; i <= sbi_scratch_last_hartindex(); i++) {
+		rscratch = sbi_hartindex_to_scratch(i);
+		if (!rscratch || plic_get_hart_data_ptr(rscratch) != pd)
+			continue;
+
+		plic_context_enabled_sources(pd, plic_get_hart_mcontext(rscratch),
+					     pd->saved_src);
+		plic_context_enabled_sources(pd, plic_get_hart_scontext(rscratch),
+					     pd->saved_src);
+	}
 
-	plic_priority_save(plic_get_hart_data_ptr(scratch), priority, num);
+	plic_priority_save_enabled(pd, priority, pd->saved_src, num);
 }
 
 void fdt_plic_priority_restore(const u8 *priority, u32 num)
 {
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct plic_data *pd = plic_get_hart_data_ptr(scratch);
+
+	if (!pd->saved_src) {
+		plic_priority_restore(pd, priority, num);
+		return;
+	}
 
-	plic_priority_restore(plic_get_hart_data_ptr(scratch), priority, num);
+	plic_priority_restore_enabled(pd, priority, pd->saved_src, num);
 }
 
 void fdt_plic_context_save(bool smode, u32 *enable, u32 *threshold, u32 num)
@@ -76,13 +116,191 @@ void fdt_plic_context_restore(bool smode, const u32 *enable, u32 threshold,
 			     enable, threshold, num);
 }
 
+static int irqchip_plic_irqfn(void)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct plic_data *pd = plic_get_hart_data_ptr(scratch);
+	long mctx = plic_get_hart_mcontext(scratch);
+	u32 hwirq;
+
+	if (!pd || mctx < 0)
+		return SBI_ENODEV;
+
+	/* Drain all pending interrupts before returning from the trap */
+	while ((hwirq = plic_context_claim(pd, mctx))) {
+		if (sbi_irqchip_handle_hwirq(hwirq) == SBI_ENOENT)
+			sbi_printf("%s: unhandled IRQ%u\n", __func__, hwirq);
+		plic_context_complete(pd, mctx, hwirq);
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_SBI_CONSOLE_IRQ
+/* Console TX empty and RX interrupt sources and the PLIC handling them */
+static u32 plic_console_tx_hwirq;
+static u32 plic_console_rx_hwirq;
+static struct plic_data *plic_console_pd;
+static u32 plic_console_hartid = -1U;
+
+/* The UARTs commonly use a single interrupt for both directions */
+static int irqchip_plic_console_handler(u32 hwirq, void *priv)
+{
+#ifdef CONFIG_SBI_CONSOLE_RX_IRQ
+	if (hwirq == plic_console_rx_hwirq)
+		sbi_console_rx_irq_process();
+#endif
+#ifdef CONFIG_SBI_CONSOLE_TX_IRQ
+	if (hwirq == plic_console_tx_hwirq)
+		sbi_console_tx_irq_process();
+#endif
+
+	return 0;
+}
+
+static u32 irqchip_plic_console_source(struct plic_data *pd, u32 hwirq,
+				       bool has_enable)
+{
+	if (!has_enable || !hwirq || hwirq > pd->num_src)
+		return 0;
+
+	/* The source may already be registered for the other direction */
+	if (hwirq != plic_console_tx_hwirq && hwirq != plic_console_rx_hwirq &&
+	    sbi_irqchip_register_handler(hwirq, irqchip_plic_console_handler,
+					 NULL))
+		return 0;
+
+	plic_source_set_priority(pd, hwirq, 1);
+	return hwirq;
+}
+
+static void irqchip_plic_console_cold_init(void *fdt, int nodeoff,
+					   struct plic_data *pd)
+{
+	const struct sbi_console_device *cdev = sbi_console_get_device();
+	int numa_node;
+
+	if (plic_console_pd || !cdev)
+		return;
+
+#ifdef CONFIG_SBI_CONSOLE_TX_IRQ
+	plic_console_tx_hwirq = irqchip_plic_console_source(pd,
+			cdev->console_tx_hwirq, !!cdev->console_tx_irq_enable);
+#endif
+#ifdef CONFIG_SBI_CONSOLE_RX_IRQ
+	plic_console_rx_hwirq = irqchip_plic_console_source(pd,
+			cdev->console_rx_hwirq, !!cdev->console_rx_irq_enable);
+#endif
+	if (!plic_console_tx_hwirq && !plic_console_rx_hwirq)
+		return;
+	plic_console_pd = pd;
+
+	/* Prefer a HART on the die of the PLIC to take the interrupt */
+	numa_node = fdt_parse_numa_node_id(fdt, nodeoff);
+	if (numa_node >= 0)
+		fdt_find_numa_local_intc_entry(fdt, nodeoff, numa_node,
+					       IRQ_M_EXT, &plic_console_hartid);
+}
+
+/*
+ * Route the console interrupt to M-mode of the HART chosen at cold boot
+ * or otherwise of the first HART coming up
+ */
+static void irqchip_plic_console_warm_init(struct sbi_scratch *scratch)
+{
+	long mctx = plic_get_hart_mcontext(scratch);
+
+	if (plic_get_hart_data_ptr(scratch) != plic_console_pd || mctx < 0)
+		return;
+
+	if (plic_console_hartid == -1U)
+		plic_console_hartid = current_hartid();
+	if (plic_console_hartid != current_hartid())
+		return;
+
+	if (plic_console_tx_hwirq)
+		plic_context_enable_source(plic_console_pd, mctx,
+					   plic_console_tx_hwirq, true);
+	if (plic_console_rx_hwirq)
+		plic_context_enable_source(plic_console_pd, mctx,
+					   plic_console_rx_hwirq, true);
+	plic_context_set_threshold(plic_console_pd, mctx, 0);
+#ifdef CONFIG_SBI_CONSOLE_TX_IRQ
+	if (plic_console_tx_hwirq)
+		sbi_console_tx_irq_init();
+#endif
+#ifdef CONFIG_SBI_CONSOLE_RX_IRQ
+	if (plic_console_rx_hwirq)
+		sbi_console_rx_irq_init();
+#endif
+}
+
+/* Route the console interrupt again if the PLIC lost its state */
+static void irqchip_plic_console_resume(struct plic_data *pd)
+{
+	u32 hwirq = plic_console_rx_hwirq ? plic_console_rx_hwirq :
+					    plic_console_tx_hwirq;
+	struct sbi_scratch *scratch;
+	long mctx;
+
+	if (pd != plic_console_pd ||
+	    plic_source_get_priority(pd, hwirq))
+		return;
+
+	scratch = sbi_hartid_to_scratch(plic_console_hartid);
+	mctx = scratch ? plic_get_hart_mcontext(scratch) : -1;
+	if (mctx < 0)
+		return;
+
+	if (plic_console_tx_hwirq) {
+		plic_source_set_priority(pd, plic_console_tx_hwirq, 1);
+		plic_context_enable_source(pd, mctx, plic_console_tx_hwirq,
+					   true);
+	}
+	if (plic_console_rx_hwirq) {
+		plic_source_set_priority(pd, plic_console_rx_hwirq, 1);
+		plic_context_enable_source(pd, mctx, plic_console_rx_hwirq,
+					   true);
+	}
+	plic_context_set_threshold(pd, mctx, 0);
+}
+#else
+static inline void irqchip_plic_console_cold_init(void *fdt, int nodeoff,
+						  struct plic_data *pd) { }
+
+static inline void irqchip_plic_console_warm_init(struct sbi_scratch *s) { }
+
+static inline void irqchip_plic_console_resume(struct plic_data *pd) { }
+#endif
+
 static int irqchip_plic_warm_init(void)
 {
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	int rc;
+
+	rc = plic_warm_irqchip_init(plic_get_hart_data_ptr(scratch),
+				    plic_get_hart_mcontext(scratch),
+				    plic_get_hart_scontext(scratch));
+	if (rc)
+		return rc;
+
+	irqchip_plic_console_warm_init(scratch);
+
+	return 0;
+}
+
+/*
+ * The supervisor restores its own contexts and priorities after system
+ * suspend, only the M-mode setup of the PLIC is restored here.
+ */
+static void irqchip_plic_resume(struct sbi_irqchip_pm *pm)
+{
+	struct irqchip_plic *ip = container_of(pm, struct irqchip_plic, pm);
+
+	if (ip->plat_init)
+		ip->plat_init(&ip->data);
 
-	return plic_warm_irqchip_init(plic_get_hart_data_ptr(scratch),
-				      plic_get_hart_mcontext(scratch),
-				      plic_get_hart_scontext(scratch));
+	irqchip_plic_console_resume(&ip->data);
 }
 
 static int irqchip_plic_update_hartid_table(void *fdt, int nodeoff,
@@ -102,7 +320,8 @@ static int irqchip_plic_update_hartid_table(void *fdt, int nodeoff,
 		phandle = fdt32_to_cpu(val[i]);
 		hwirq = fdt32_to_cpu(val[i + 1]);
 
-		cpu_intc_offset = fdt_node_offset_by_phandle(fdt, phandle);
+		cpu_intc_offset = fdt_node_offset_by_phandle_cached(fdt,
+								     phandle);
 		if (cpu_intc_offset < 0)
 			continue;
 
@@ -136,6 +355,7 @@ static int irqchip_plic_cold_init(void *fdt, int nodeoff,
 				  const struct fdt_match *match)
 {
 	int rc;
+	struct irqchip_plic *ip;
 	struct plic_data *pd;
 
 	if (!plic_ptr_offset) {
@@ -156,17 +376,21 @@ static int irqchip_plic_cold_init(void *fdt, int nodeoff,
 			return SBI_ENOMEM;
 	}
 
-	pd = sbi_zalloc(sizeof(*pd));
-	if (!pd)
+	ip = sbi_zalloc(sizeof(*ip));
+	if (!ip)
 		return SBI_ENOMEM;
+	pd = &ip->data;
 
 	rc = fdt_parse_plic_node(fdt, nodeoff, pd);
 	if (rc)
 		goto fail_free_data;
 
+	/* Optional, priorities are fully saved without it */
+	pd->saved_src = sbi_zalloc((pd->num_src / 32 + 1) * sizeof(u32));
+
 	if (match->data) {
-		void (*plic_plat_init)(struct plic_data *) = match->data;
-		plic_plat_init(pd);
+		ip->plat_init = match->data;
+		ip->plat_init(pd);
 	}
 
 	rc = plic_cold_irqchip_init(pd);
@@ -177,10 +401,19 @@ static int irqchip_plic_cold_init(void *fdt, int nodeoff,
 	if (rc)
 		goto fail_free_data;
 
+	sbi_irqchip_set_irqfn(irqchip_plic_irqfn);
+
+	irqchip_plic_console_cold_init(fdt, nodeoff, pd);
+
+	ip->pm.resume = irqchip_plic_resume;
+	sbi_irqchip_add_pm(&ip->pm);
+
 	return 0;
 
 fail_free_data:
-	sbi_free(pd);
+	if (pd->saved_src)
+		sbi_free(pd->saved_src);
+	sbi_free(ip);
 	return rc;
 }
 
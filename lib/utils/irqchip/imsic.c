@@ -17,6 +17,7 @@
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_irqchip.h>
 #include <sbi/sbi_error.h>
+#include <sbi/sbi_heap.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi_utils/irqchip/imsic.h>
 
@@ -54,6 +55,10 @@
 
 #define IMSIC_IPI_ID			1
 
+/* IPI events with a dedicated interrupt identity */
+#define IMSIC_IPI_EVENT_ID_BASE		2
+#define IMSIC_IPI_EVENT_COUNT		8
+
 #define imsic_csr_write(__c, __v)	\
 do { \
 	csr_write(CSR_MISELECT, __c); \
@@ -96,6 +101,28 @@ static unsigned long imsic_file_offset;
 #define imsic_set_hart_file(__scratch, __file)				\
 	sbi_scratch_write_type((__scratch), long, imsic_file_offset, (__file))
 
+/* Address of the M-mode IPI doorbell of each HART, indexed by HART index */
+static void **imsic_doorbells;
+static u32 imsic_doorbell_count;
+
+static void *imsic_hart_doorbell(struct imsic_data *data, int file)
+{
+	unsigned long reloff;
+	struct imsic_regs *regs;
+
+	regs = &data->regs[0];
+	reloff = file * (1UL << data->guest_index_bits) * IMSIC_MMIO_PAGE_SZ;
+	while (regs->size && (regs->size <= reloff)) {
+		reloff -= regs->size;
+		regs++;
+	}
+
+	if (!regs->size || (regs->size <= reloff))
+		return NULL;
+
+	return (void *)(regs->addr + reloff + IMSIC_MMIO_PAGE_LE);
+}
+
 int imsic_map_hartid_to_data(u32 hartid, struct imsic_data *imsic, int file)
 {
 	struct sbi_scratch *scratch;
@@ -116,6 +143,9 @@ int imsic_map_hartid_to_data(u32 hartid, struct imsic_data *imsic, int file)
 
 	imsic_set_hart_data_ptr(scratch, imsic);
 	imsic_set_hart_file(scratch, file);
+	if (imsic_doorbells)
+		imsic_doorbells[sbi_hartid_to_hartindex(hartid)] =
+			imsic_hart_doorbell(imsic, file);
 	return 0;
 }
 
@@ -159,8 +189,15 @@ static int imsic_external_irqfn(void)
 			sbi_ipi_process();
 			break;
 		default:
-			sbi_printf("%s: unhandled IRQ%d\n",
-				   __func__, (u32)mirq);
+			if (IMSIC_IPI_EVENT_ID_BASE <= mirq &&
+			    mirq < IMSIC_IPI_EVENT_ID_BASE + IMSIC_IPI_EVENT_COUNT) {
+				sbi_ipi_process_event(mirq -
+						      IMSIC_IPI_EVENT_ID_BASE);
+				break;
+			}
+			if (sbi_irqchip_handle_hwirq(mirq) == SBI_ENOENT)
+				sbi_printf("%s: unhandled IRQ%d\n",
+					   __func__, (u32)mirq);
 			break;
 		}
 	}
@@ -168,38 +205,33 @@ static int imsic_external_irqfn(void)
 	return 0;
 }
 
-static void imsic_ipi_send(u32 hart_index)
+static void imsic_ipi_send_id(u32 hart_index, u32 id)
 {
-	unsigned long reloff;
-	struct imsic_regs *regs;
-	struct imsic_data *data;
-	struct sbi_scratch *scratch;
-	int file;
+	void *doorbell;
 
-	scratch = sbi_hartindex_to_scratch(hart_index);
-	if (!scratch)
+	if (hart_index >= imsic_doorbell_count)
 		return;
 
-	data = imsic_get_hart_data_ptr(scratch);
-	file = imsic_get_hart_file(scratch);
-	if (!data || !data->targets_mmode)
-		return;
+	doorbell = imsic_doorbells[hart_index];
+	if (doorbell)
+		writel_relaxed(id, doorbell);
+}
 
-	regs = &data->regs[0];
-	reloff = file * (1UL << data->guest_index_bits) * IMSIC_MMIO_PAGE_SZ;
-	while (regs->size && (regs->size <= reloff)) {
-		reloff -= regs->size;
-		regs++;
-	}
+static void imsic_ipi_send(u32 hart_index)
+{
+	imsic_ipi_send_id(hart_index, IMSIC_IPI_ID);
+}
 
-	if (regs->size && (reloff < regs->size))
-		writel_relaxed(IMSIC_IPI_ID,
-			(void *)(regs->addr + reloff + IMSIC_MMIO_PAGE_LE));
+static void imsic_ipi_send_event(u32 hart_index, u32 event)
+{
+	imsic_ipi_send_id(hart_index, IMSIC_IPI_EVENT_ID_BASE + event);
 }
 
 static struct sbi_ipi_device imsic_ipi_device = {
-	.name		= "aia-imsic",
-	.ipi_send	= imsic_ipi_send
+	.name			= "aia-imsic",
+	.ipi_send		= imsic_ipi_send,
+	.ipi_event_count	= IMSIC_IPI_EVENT_COUNT,
+	.ipi_send_event		= imsic_ipi_send_event
 };
 
 static void imsic_local_eix_update(unsigned long base_id,
@@ -251,8 +283,9 @@ void imsic_local_irqchip_init(void)
 	/* Enable interrupt delivery */
 	imsic_csr_write(IMSIC_EIDELIVERY, IMSIC_ENABLE_EIDELIVERY);
 
-	/* Enable IPI */
-	imsic_local_eix_update(IMSIC_IPI_ID, 1, false, true);
+	/* Enable IPI and IPI events */
+	imsic_local_eix_update(IMSIC_IPI_ID, 1 + IMSIC_IPI_EVENT_COUNT,
+			       false, true);
 }
 
 int imsic_warm_irqchip_init(void)
@@ -266,8 +299,9 @@ int imsic_warm_irqchip_init(void)
 	/* Disable all interrupts */
 	imsic_local_eix_update(1, imsic->num_ids, false, false);
 
-	/* Clear IPI pending */
-	imsic_local_eix_update(IMSIC_IPI_ID, 1, true, false);
+	/* Clear IPI and IPI events pending */
+	imsic_local_eix_update(IMSIC_IPI_ID, 1 + IMSIC_IPI_EVENT_COUNT,
+			       true, false);
 
 	/* Local IMSIC initialization */
 	imsic_local_irqchip_init();
@@ -373,6 +407,15 @@ int imsic_cold_irqchip_init(struct imsic_data *imsic)
 			return SBI_ENOMEM;
 	}
 
+	/* Allocate the doorbell table shared by all M-mode IMSICs */
+	if (!imsic_doorbells) {
+		imsic_doorbell_count = sbi_scratch_last_hartindex() + 1;
+		imsic_doorbells = sbi_calloc(sizeof(*imsic_doorbells),
+					     imsic_doorbell_count);
+		if (!imsic_doorbells)
+			return SBI_ENOMEM;
+	}
+
 	/* Setup external interrupt function for IMSIC */
 	sbi_irqchip_set_irqfn(imsic_external_irqfn);
 
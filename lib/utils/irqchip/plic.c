@@ -23,6 +23,7 @@
 #define PLIC_ENABLE_STRIDE 0x80
 #define PLIC_CONTEXT_BASE 0x200000
 #define PLIC_CONTEXT_STRIDE 0x1000
+#define PLIC_CONTEXT_CLAIM 0x4
 
 static u32 plic_get_priority(const struct plic_data *plic, u32 source)
 {
@@ -51,6 +52,27 @@ void plic_priority_restore(const struct plic_data *plic, const u8 *priority,
 		plic_set_priority(plic, i, priority[i]);
 }
 
+void plic_priority_save_enabled(const struct plic_data *plic, u8 *priority,
+				const u32 *enabled, u32 num)
+{
+	for (u32 i = 1; i <= num; i++) {
+		if (enabled[i / 32] & BIT(i % 32))
+			priority[i] = plic_get_priority(plic, i);
+		else
+			priority[i] = 0;
+	}
+}
+
+void plic_priority_restore_enabled(const struct plic_data *plic,
+				   const u8 *priority, const u32 *enabled,
+				   u32 num)
+{
+	for (u32 i = 1; i <= num; i++) {
+		if (enabled[i / 32] & BIT(i % 32))
+			plic_set_priority(plic, i, priority[i]);
+	}
+}
+
 static u32 plic_get_thresh(const struct plic_data *plic, u32 cntxid)
 {
 	volatile void *plic_thresh;
@@ -93,6 +115,18 @@ static void plic_set_ie(const struct plic_data *plic, u32 cntxid,
 	writel(val, plic_ie);
 }
 
+void plic_context_enabled_sources(const struct plic_data *plic,
+				  int context_id, u32 *enabled)
+{
+	u32 ie_words = plic->num_src / 32 + 1;
+
+	if (context_id < 0)
+		return;
+
+	for (u32 i = 0; i < ie_words; i++)
+		enabled[i] |= plic_get_ie(plic, context_id, i);
+}
+
 void plic_context_save(const struct plic_data *plic, int context_id,
 		       u32 *enable, u32 *threshold, u32 num)
 {
@@ -121,6 +155,56 @@ void plic_context_restore(const struct plic_data *plic, int context_id,
 	plic_set_thresh(plic, context_id, threshold);
 }
 
+u32 plic_source_get_priority(const struct plic_data *plic, u32 source)
+{
+	return plic_get_priority(plic, source);
+}
+
+void plic_source_set_priority(const struct plic_data *plic, u32 source,
+			      u32 priority)
+{
+	plic_set_priority(plic, source, priority);
+}
+
+void plic_context_enable_source(const struct plic_data *plic, int context_id,
+				u32 source, bool enable)
+{
+	u32 ie = plic_get_ie(plic, context_id, source / 32);
+
+	if (enable)
+		ie |= BIT(source % 32);
+	else
+		ie &= ~BIT(source % 32);
+	plic_set_ie(plic, context_id, source / 32, ie);
+}
+
+void plic_context_set_threshold(const struct plic_data *plic, int context_id,
+				u32 threshold)
+{
+	plic_set_thresh(plic, context_id, threshold);
+}
+
+u32 plic_context_claim(const struct plic_data *plic, int context_id)
+{
+	volatile void *plic_claim;
+
+	plic_claim = (char *)plic->addr + PLIC_CONTEXT_BASE +
+		     PLIC_CONTEXT_STRIDE * context_id + PLIC_CONTEXT_CLAIM;
+
+	return readl(plic_claim);
+}
+
+void plic_context_complete(const struct plic_data *plic, int context_id,
+			   u32 source)
+{
+	volatile void *plic_claim;
+
+	plic_claim = (char *)plic->addr + PLIC_CONTEXT_BASE +
+		     PLIC_CONTEXT_STRIDE * context_id + PLIC_CONTEXT_CLAIM;
+
+	writel(source, plic_claim);
+}
+
 int plic_context_init(const struct plic_data *plic, int context_id,
 		      bool enable, u32 threshold)
 {
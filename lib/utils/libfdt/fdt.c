@@ -140,6 +140,13 @@ int fdt_check_header(const void *fdt)
 	return 0;
 }
 
+unsigned int fdt_assume_mask;
+
+void fdt_set_trusted(int trusted)
+{
+	fdt_assume_mask = trusted ? ASSUME_VALID_DTB : 0;
+}
+
 const void *fdt_offset_ptr(const void *fdt, int offset, unsigned int len)
 {
 	unsigned int uoffset = offset;
@@ -302,6 +302,16 @@ size_t fdt_header_size_(uint32_t version);
  */
 int fdt_check_header(const void *fdt);
 
+/**
+ * fdt_set_trusted - skip the structural checks of the device trees
+ * @trusted: non-zero if the device trees were verified before
+ *
+ * OpenSBI addition for device trees authenticated by the previous
+ * booting stage. The checks of the arguments passed by the callers are
+ * kept.
+ */
+void fdt_set_trusted(int trusted);
+
 /**
  * fdt_move - move a device tree around in memory
  * @fdt: pointer to the device tree to move
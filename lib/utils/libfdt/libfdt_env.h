@@ -37,6 +37,7 @@
 #define strncmp		sbi_strncmp
 #define strlen		sbi_strlen
 #define strnlen		sbi_strnlen
+#define strtoul		sbi_strtoul
 
 typedef be16_t FDT_BITWISE fdt16_t;
 typedef be32_t FDT_BITWISE fdt32_t;
@@ -75,6 +75,9 @@ static inline uint64_t fdt64_ld_(const fdt64_t *p)
 #define FDT_ASSUME_MASK 0
 #endif
 
+/* OpenSBI: assumptions enabled at runtime, see fdt_set_trusted() */
+extern unsigned int fdt_assume_mask;
+
 /*
  * Defines assumptions which can be enabled. Each of these can be enabled
  * individually. For maximum safety, don't enable any assumptions!
@@ -183,7 +186,7 @@ enum {
  */
 static inline bool can_assume_(int mask)
 {
-	return FDT_ASSUME_MASK & mask;
+	return (FDT_ASSUME_MASK | fdt_assume_mask) & mask;
 }
 
 /** helper macros for checking assumptions */
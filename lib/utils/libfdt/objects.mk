@@ -13,4 +13,5 @@ $(foreach file, $(libfdt_files), \
         $(eval CFLAGS_$(file) = -I$(src)/../../utils/libfdt))
 
 libsbiutils-objs-$(CONFIG_LIBFDT) += $(addprefix libfdt/,$(libfdt_files))
+libsbiutils-objs-$(CONFIG_FDT_OVERLAY) += libfdt/fdt_overlay.o
 libsbiutils-genflags-y  += -I$(libsbiutils_dir)/libfdt/
@@ -108,6 +108,10 @@ __qdivrem(u_quad_t uq, u_quad_t vq, u_quad_t *arq)
 			*arq = uq;
 		return (0);
 	}
+#ifdef __riscv_div
+	/* Use the hardware 32-bit divide instead of the generic digits */
+	return (__qdivrem_m(uq, vq, arq));
+#endif
 	u = &uspace[0];
 	v = &vspace[0];
 	q = &qspace[0];
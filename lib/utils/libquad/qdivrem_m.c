@@ -0,0 +1,131 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * 64-bit division for RV32 using the 32-bit divide and multiply
+ * instructions of the M extension.
+ *
+ * The 64/32 step is the normalized two digit long division of Hacker's
+ * Delight (2nd ed), section 9-4, and the 64/64 case reduces to it as in
+ * section 9-5.
+ */
+
+#include <sys/cdefs.h>
+
+#include "quad.h"
+
+/* Count leading zeros of a non-zero word without relying on libgcc */
+static inline int
+clz32(u32 x)
+{
+	int n = 0;
+
+	if (!(x & 0xffff0000)) {
+		n += 16;
+		x <<= 16;
+	}
+	if (!(x & 0xff000000)) {
+		n += 8;
+		x <<= 8;
+	}
+	if (!(x & 0xf0000000)) {
+		n += 4;
+		x <<= 4;
+	}
+	if (!(x & 0xc0000000)) {
+		n += 2;
+		x <<= 2;
+	}
+	if (!(x & 0x80000000))
+		n += 1;
+
+	return (n);
+}
+
+/*
+ * Divide the two word number u1:u0 by v and return the quotient, u1 must
+ * be smaller than v so that the quotient fits in one word.
+ */
+static u32
+divlu(u32 u1, u32 u0, u32 v, u32 *r)
+{
+	const u32 b = 0x10000;
+	u32 un1, un0, vn1, vn0, q1, q0, un32, un21, un10, rhat;
+	int s;
+
+	s = clz32(v);
+	v <<= s;
+	vn1 = v >> 16;
+	vn0 = v & 0xffff;
+
+	un32 = s ? (u1 << s) | (u0 >> (32 - s)) : u1;
+	un10 = u0 << s;
+	un1 = un10 >> 16;
+	un0 = un10 & 0xffff;
+
+	q1 = un32 / vn1;
+	rhat = un32 - q1 * vn1;
+	while (q1 >= b || q1 * vn0 > b * rhat + un1) {
+		q1--;
+		rhat += vn1;
+		if (rhat >= b)
+			break;
+	}
+
+	un21 = un32 * b + un1 - q1 * v;
+
+	q0 = un21 / vn1;
+	rhat = un21 - q0 * vn1;
+	while (q0 >= b || q0 * vn0 > b * rhat + un0) {
+		q0--;
+		rhat += vn1;
+		if (rhat >= b)
+			break;
+	}
+
+	*r = (un21 * b + un0 - q0 * v) >> s;
+
+	return (q1 * b + q0);
+}
+
+/*
+ * Same contract as __qdivrem() for a non-zero divisor not larger than
+ * the dividend.
+ */
+u_quad_t
+__qdivrem_m(u_quad_t uq, u_quad_t vq, u_quad_t *arq)
+{
+	u32 uh = uq >> 32, ul = uq, vl = vq, qh, ql, r;
+	u_quad_t q;
+	int n;
+
+	if (!(vq >> 32)) {
+		/* Both halves fit, a single hardware divide is enough */
+		if (!uh) {
+			if (arq)
+				*arq = ul % vl;
+			return (ul / vl);
+		}
+
+		qh = uh / vl;
+		ql = divlu(uh % vl, ul, vl, &r);
+		if (arq)
+			*arq = r;
+		return (((u_quad_t)qh << 32) | ql);
+	}
+
+	/*
+	 * Estimate the quotient from the normalized high word of the
+	 * divisor, it is at most one too large after the decrement.
+	 */
+	n = clz32(vq >> 32);
+	q = divlu((uq >> 1) >> 32, uq >> 1, (vq << n) >> 32, &r);
+	q = (q << n) >> 31;
+	if (q)
+		q--;
+	if (uq - q * vq >= vq)
+		q++;
+
+	if (arq)
+		*arq = uq - q * vq;
+	return (q);
+}
@@ -0,0 +1,210 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Decompressor for the LZ4 frame format as produced by the lz4 tool,
+ * see https://github.com/lz4/lz4/blob/dev/doc/lz4_Frame_format.md
+ */
+
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_string.h>
+#include <sbi_utils/lz4/lz4.h>
+
+#define LZ4_FRAME_MAGIC			0x184D2204
+#define LZ4_FLG_VERSION_MASK		0xc0
+#define LZ4_FLG_VERSION			0x40
+#define LZ4_FLG_BLOCK_CHECKSUM		0x10
+#define LZ4_FLG_CONTENT_SIZE		0x08
+#define LZ4_FLG_CONTENT_CHECKSUM	0x04
+#define LZ4_FLG_DICT_ID			0x01
+#define LZ4_BLOCK_UNCOMPRESSED		0x80000000U
+#define LZ4_MIN_MATCH			4
+
+struct lz4_frame {
+	const u8 *blocks;
+	u64 content_size;
+	bool block_checksum;
+};
+
+static u32 lz4_get_le32(const u8 *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static int lz4_frame_parse(const u8 *src, unsigned long src_size,
+			   struct lz4_frame *f)
+{
+	unsigned long hdr_size = 7;
+	u8 flg;
+
+	if (src_size < hdr_size || lz4_get_le32(src) != LZ4_FRAME_MAGIC)
+		return SBI_EINVAL;
+
+	flg = src[4];
+	if ((flg & LZ4_FLG_VERSION_MASK) != LZ4_FLG_VERSION ||
+	    !(flg & LZ4_FLG_CONTENT_SIZE) || (flg & LZ4_FLG_DICT_ID))
+		return SBI_ENOTSUPP;
+
+	hdr_size += 8;
+	if (src_size < hdr_size)
+		return SBI_EINVAL;
+
+	f->content_size = lz4_get_le32(&src[6]) |
+			  ((u64)lz4_get_le32(&src[10]) << 32);
+	f->block_checksum = flg & LZ4_FLG_BLOCK_CHECKSUM;
+	f->blocks = src + hdr_size;
+
+	return 0;
+}
+
+/* Read an extended length, the bytes are added up until one isn't 255 */
+static int lz4_get_len(const u8 **ip, const u8 *iend, unsigned long *len)
+{
+	u8 b;
+
+	do {
+		if (*ip >= iend)
+			return SBI_EINVAL;
+		b = *(*ip)++;
+		*len += b;
+	} while (b == 255);
+
+	return 0;
+}
+
+static int lz4_block_decompress(u8 *dst, u8 **op, u8 *oend,
+				const u8 *ip, const u8 *iend)
+{
+	unsigned long len, off;
+	u8 *o = *op, *match;
+	u8 token;
+
+	while (ip < iend) {
+		token = *ip++;
+
+		len = token >> 4;
+		if (len == 15 && lz4_get_len(&ip, iend, &len))
+			return SBI_EINVAL;
+		if (len > iend - ip || len > oend - o)
+			return SBI_EINVAL;
+
+		/* Forward copy, safe when decompressing in place */
+		sbi_memcpy(o, ip, len);
+		o += len;
+		ip += len;
+
+		/* The last sequence of a block has no match */
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return SBI_EINVAL;
+		off = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (!off || off > o - dst)
+			return SBI_EINVAL;
+
+		len = token & 0xf;
+		if (len == 15 && lz4_get_len(&ip, iend, &len))
+			return SBI_EINVAL;
+		len += LZ4_MIN_MATCH;
+		if (len > oend - o)
+			return SBI_EINVAL;
+
+		match = o - off;
+		if (off >= len) {
+			sbi_memcpy(o, match, len);
+			o += len;
+		} else {
+			/* Overlapping match, it repeats the last off bytes */
+			while (len--)
+				*o++ = *match++;
+		}
+	}
+
+	*op = o;
+
+	return 0;
+}
+
+long lz4_frame_content_size(const void *src, unsigned long src_size)
+{
+	struct lz4_frame f;
+	int rc;
+
+	rc = lz4_frame_parse(src, src_size, &f);
+	if (rc)
+		return rc;
+
+	return f.content_size;
+}
+
+int lz4_frame_decompress(void *dst, unsigned long dst_size,
+			 const void *src, unsigned long src_size)
+{
+	const u8 *ip, *iend = (const u8 *)src + src_size;
+	u8 *op = dst, *oend;
+	struct lz4_frame f;
+	u32 bsize;
+	int rc;
+
+	rc = lz4_frame_parse(src, src_size, &f);
+	if (rc)
+		return rc;
+	if (f.content_size > dst_size)
+		return SBI_ENOSPC;
+	oend = op + f.content_size;
+
+	ip = f.blocks;
+	while (1) {
+		if (iend - ip < 4)
+			return SBI_EINVAL;
+		bsize = lz4_get_le32(ip);
+		ip += 4;
+
+		/* End mark, the content checksum may follow */
+		if (!bsize)
+			break;
+
+		if ((bsize & ~LZ4_BLOCK_UNCOMPRESSED) > iend - ip)
+			return SBI_EINVAL;
+
+		if (bsize & LZ4_BLOCK_UNCOMPRESSED) {
+			bsize &= ~LZ4_BLOCK_UNCOMPRESSED;
+			if (bsize > oend - op)
+				return SBI_EINVAL;
+			sbi_memcpy(op, ip, bsize);
+			op += bsize;
+		} else {
+			rc = lz4_block_decompress(dst, &op, oend,
+						  ip, ip + bsize);
+			if (rc)
+				return rc;
+		}
+		ip += bsize;
+
+		if (f.block_checksum)
+			ip += 4;
+	}
+
+	return (op == oend) ? 0 : SBI_EINVAL;
+}
+
+int lz4_frame_decompress_inplace(void *buf, unsigned long src_size)
+{
+	unsigned long size, off;
+	long rc;
+
+	rc = lz4_frame_content_size(buf, src_size);
+	if (rc < 0)
+		return rc;
+
+	size = rc;
+	off = size + LZ4_INPLACE_MARGIN(size);
+	if (off < src_size)
+		return SBI_EINVAL;
+	off -= src_size;
+
+	sbi_memmove((u8 *)buf + off, buf, src_size);
+
+	return lz4_frame_decompress(buf, size, (u8 *)buf + off, src_size);
+}
@@ -0,0 +1,7 @@
+#
+# SPDX-License-Identifier: BSD-2-Clause
+#
+
+ifeq ($(FW_PAYLOAD_COMPRESS),lz4)
+libsbiutils-objs-y += lz4/lz4.o
+endif
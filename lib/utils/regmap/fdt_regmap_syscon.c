@@ -159,6 +159,37 @@ static int regmap_syscon_write_be32(struct regmap *rmap, unsigned int reg,
 	return 0;
 }
 
+/*
+ * The optional "opensbi,cached-regs" DT property lists the offsets of
+ * non-volatile registers of the syscon which are then served from a
+ * write-through cache. Registers with side effects on write (such as
+ * reset or power-off triggers) or changed behind OpenSBI's back must
+ * not be listed since writes leaving such a register unchanged are
+ * skipped.
+ */
+static int regmap_syscon_cache_init(void *fdt, int nodeoff,
+				    struct regmap *rmap)
+{
+	const fdt32_t *val;
+	int i, rc, len;
+
+	val = fdt_getprop(fdt, nodeoff, "opensbi,cached-regs", &len);
+	if (!val || len < (int)sizeof(fdt32_t))
+		return 0;
+
+	rc = regmap_cache_init(rmap);
+	if (rc)
+		return rc;
+
+	for (i = 0; i < len / (int)sizeof(fdt32_t); i++) {
+		rc = regmap_cache_set_nonvolatile(rmap, fdt32_to_cpu(val[i]));
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
+
 static int regmap_syscon_init(void *fdt, int nodeoff, u32 phandle,
 			      const struct fdt_match *match)
 {
@@ -241,18 +272,24 @@ static int regmap_syscon_init(void *fdt, int nodeoff, u32 phandle,
 		goto fail_free_syscon;
 	}
 
+	rc = regmap_syscon_cache_init(fdt, nodeoff, &srm->rmap);
+	if (rc)
+		goto fail_free_cache;
+
 	rc = sbi_domain_root_add_memrange(addr, size, PAGE_SIZE,
 				(SBI_DOMAIN_MEMREGION_MMIO |
 				 SBI_DOMAIN_MEMREGION_SHARED_SURW_MRW));
 	if (rc)
-		goto fail_free_syscon;
+		goto fail_free_cache;
 
 	rc = regmap_add(&srm->rmap);
 	if (rc)
-		goto fail_free_syscon;
+		goto fail_free_cache;
 
 	return 0;
 
+fail_free_cache:
+	regmap_cache_free(&srm->rmap);
 fail_free_syscon:
 	sbi_free(srm);
 	return rc;
@@ -7,7 +7,10 @@
  *   Anup Patel <apatel@ventanamicro.com>
  */
 
+#include <sbi/sbi_bitops.h>
 #include <sbi/sbi_error.h>
+#include <sbi/sbi_heap.h>
+#include <sbi/sbi_string.h>
 #include <sbi_utils/regmap/regmap.h>
 
 static SBI_LIST_HEAD(regmap_list);
@@ -66,48 +69,177 @@ static unsigned int regmap_reg_addr(struct regmap *rmap, unsigned int reg)
 	return reg;
 }
 
+static unsigned int regmap_cache_index(struct regmap *rmap, unsigned int reg)
+{
+	return reg / rmap->reg_stride;
+}
+
+int regmap_cache_init(struct regmap *rmap)
+{
+	unsigned int count;
+
+	if (!rmap || !rmap->reg_max || rmap->reg_stride <= 0)
+		return SBI_EINVAL;
+	if (rmap->cache_vals)
+		return SBI_EALREADY;
+
+	count = regmap_cache_index(rmap, rmap->reg_max - 1) + 1;
+	rmap->cache_vals = sbi_zalloc(count * sizeof(*rmap->cache_vals));
+	rmap->cache_valid = sbi_zalloc(BITS_TO_LONGS(count) *
+				       sizeof(unsigned long));
+	rmap->cache_nonvolatile = sbi_zalloc(BITS_TO_LONGS(count) *
+					     sizeof(unsigned long));
+	if (!rmap->cache_vals || !rmap->cache_valid ||
+	    !rmap->cache_nonvolatile) {
+		regmap_cache_free(rmap);
+		return SBI_ENOMEM;
+	}
+	rmap->cache_count = count;
+
+	return 0;
+}
+
+void regmap_cache_free(struct regmap *rmap)
+{
+	if (!rmap)
+		return;
+
+	sbi_free(rmap->cache_vals);
+	sbi_free(rmap->cache_valid);
+	sbi_free(rmap->cache_nonvolatile);
+	rmap->cache_vals = NULL;
+	rmap->cache_valid = NULL;
+	rmap->cache_nonvolatile = NULL;
+	rmap->cache_count = 0;
+}
+
+int regmap_cache_set_nonvolatile(struct regmap *rmap, unsigned int reg)
+{
+	if (!rmap || !regmap_reg_valid(rmap, reg))
+		return SBI_EINVAL;
+	if (!rmap->cache_vals)
+		return SBI_ENOSYS;
+
+	__set_bit(regmap_cache_index(rmap, reg), rmap->cache_nonvolatile);
+
+	return 0;
+}
+
+void regmap_cache_invalidate(struct regmap *rmap)
+{
+	if (!rmap || !rmap->cache_vals)
+		return;
+
+	sbi_memset(rmap->cache_valid, 0,
+		   BITS_TO_LONGS(rmap->cache_count) * sizeof(unsigned long));
+}
+
+static bool regmap_cache_lookup(struct regmap *rmap, unsigned int reg,
+				unsigned int *val)
+{
+	unsigned int idx;
+
+	if (!rmap->cache_vals)
+		return false;
+
+	idx = regmap_cache_index(rmap, reg);
+	if (!__test_bit(idx, rmap->cache_valid))
+		return false;
+
+	*val = rmap->cache_vals[idx];
+	return true;
+}
+
+static void regmap_cache_store(struct regmap *rmap, unsigned int reg,
+			       unsigned int val)
+{
+	unsigned int idx;
+
+	if (!rmap->cache_vals)
+		return;
+
+	idx = regmap_cache_index(rmap, reg);
+	if (!__test_bit(idx, rmap->cache_nonvolatile))
+		return;
+
+	rmap->cache_vals[idx] = val;
+	__set_bit(idx, rmap->cache_valid);
+}
+
 int regmap_read(struct regmap *rmap, unsigned int reg, unsigned int *val)
 {
+	int rc;
+
 	if (!rmap || !regmap_reg_valid(rmap, reg))
 		return SBI_EINVAL;
+	if (regmap_cache_lookup(rmap, reg, val))
+		return 0;
 	if (!rmap->reg_read)
 		return SBI_ENOSYS;
 
-	return rmap->reg_read(rmap, regmap_reg_addr(rmap, reg), val);
+	rc = rmap->reg_read(rmap, regmap_reg_addr(rmap, reg), val);
+	if (!rc)
+		regmap_cache_store(rmap, reg, *val);
+
+	return rc;
 }
 
 int regmap_write(struct regmap *rmap, unsigned int reg, unsigned int val)
 {
+	int rc;
+
 	if (!rmap || !regmap_reg_valid(rmap, reg))
 		return SBI_EINVAL;
 	if (!rmap->reg_write)
 		return SBI_ENOSYS;
 
-	return rmap->reg_write(rmap, regmap_reg_addr(rmap, reg), val);
+	rc = rmap->reg_write(rmap, regmap_reg_addr(rmap, reg), val);
+	if (!rc)
+		regmap_cache_store(rmap, reg, val);
+
+	return rc;
 }
 
 int regmap_update_bits(struct regmap *rmap, unsigned int reg,
 		       unsigned int mask, unsigned int val)
 {
 	int rc;
-	unsigned int reg_val;
+	unsigned int reg_val, new_val;
 
 	if (!rmap || !regmap_reg_valid(rmap, reg))
 		return SBI_EINVAL;
 
+	/* Cached registers with no effective change need no access */
+	if (regmap_cache_lookup(rmap, reg, &reg_val)) {
+		new_val = (reg_val & ~mask) | (val & mask);
+		if (new_val == reg_val)
+			return 0;
+
+		if (!rmap->reg_update_bits)
+			return regmap_write(rmap, reg, new_val);
+
+		rc = rmap->reg_update_bits(rmap, regmap_reg_addr(rmap, reg),
+					   mask, val);
+		if (!rc)
+			regmap_cache_store(rmap, reg, new_val);
+		return rc;
+	}
+
 	if (rmap->reg_update_bits) {
 		return rmap->reg_update_bits(rmap, regmap_reg_addr(rmap, reg),
 					     mask, val);
 	} else if (rmap->reg_read && rmap->reg_write) {
-		reg = regmap_reg_addr(rmap, reg);
-
-		rc = rmap->reg_read(rmap, reg, &reg_val);
+		rc = regmap_read(rmap, reg, &reg_val);
 		if (rc)
 			return rc;
 
-		reg_val &= ~mask;
-		reg_val |= val & mask;
-		return rmap->reg_write(rmap, reg, reg_val);
+		new_val = (reg_val & ~mask) | (val & mask);
+		if (new_val == reg_val && rmap->cache_vals &&
+		    __test_bit(regmap_cache_index(rmap, reg),
+			       rmap->cache_nonvolatile))
+			return 0;
+
+		return regmap_write(rmap, reg, new_val);
 	}
 
 	return SBI_ENOSYS;
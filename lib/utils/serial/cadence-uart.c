@@ -34,8 +34,12 @@
 #define UART_BRGR_CD_CLKDIVISOR	0x00000001	/* baud_sample = sel_clk */
 
 #define	UART_CSR_REMPTY		0x00000002
+#define	UART_CSR_TEMPTY		0x00000008
 #define	UART_CSR_TFUL		0x00000010
 
+/* Smallest TX FIFO depth of known Cadence UART configurations */
+#define UART_TX_FIFO_DEPTH	16
+
 /* clang-format on */
 
 static volatile void *uart_base;
@@ -76,6 +80,32 @@ static void cadence_uart_putc(char ch)
 	set_reg(UART_REG_RFIFO_TFIFO, ch);
 }
 
+static unsigned long cadence_uart_puts(const char *str, unsigned long len)
+{
+	unsigned long i = 0;
+	bool cr_sent = false;
+	u32 room = 0;
+
+	while (i < len) {
+		if (!room) {
+			while (!(get_reg(UART_REG_CSR) & UART_CSR_TEMPTY))
+				;
+			room = UART_TX_FIFO_DEPTH;
+		}
+
+		if (str[i] == '\n' && !cr_sent) {
+			set_reg(UART_REG_RFIFO_TFIFO, '\r');
+			cr_sent = true;
+		} else {
+			set_reg(UART_REG_RFIFO_TFIFO, str[i++]);
+			cr_sent = false;
+		}
+		room--;
+	}
+
+	return len;
+}
+
 static int cadence_uart_getc(void)
 {
 	u32 ret = get_reg(UART_REG_CSR);
@@ -89,6 +119,7 @@ static int cadence_uart_getc(void)
 static struct sbi_console_device cadence_console = {
 	.name = "cadence_uart",
 	.console_putc = cadence_uart_putc,
+	.console_puts = cadence_uart_puts,
 	.console_getc = cadence_uart_getc
 };
 
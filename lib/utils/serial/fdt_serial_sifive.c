@@ -7,6 +7,7 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <libfdt.h>
 #include <sbi_utils/fdt/fdt_helper.h>
 #include <sbi_utils/serial/fdt_serial.h>
 #include <sbi_utils/serial/sifive-uart.h>
@@ -16,12 +17,26 @@ static int serial_sifive_init(void *fdt, int nodeoff,
 {
 	int rc;
 	struct platform_uart_data uart = { 0 };
+#ifdef CONFIG_SBI_CONSOLE_RX_IRQ
+	const fdt32_t *val;
+	int len;
+#endif
 
 	rc = fdt_parse_sifive_uart_node(fdt, nodeoff, &uart);
 	if (rc)
 		return rc;
 
-	return sifive_uart_init(uart.addr, uart.freq, uart.baud);
+	rc = sifive_uart_init(uart.addr, uart.freq, uart.baud);
+	if (rc)
+		return rc;
+
+#ifdef CONFIG_SBI_CONSOLE_RX_IRQ
+	val = fdt_getprop(fdt, nodeoff, "interrupts", &len);
+	if (val && len >= sizeof(fdt32_t))
+		sifive_uart_set_hwirq(fdt32_to_cpu(*val));
+#endif
+
+	return 0;
 }
 
 static const struct fdt_match serial_sifive_match[] = {
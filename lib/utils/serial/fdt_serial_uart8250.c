@@ -7,6 +7,7 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <libfdt.h>
 #include <sbi_utils/fdt/fdt_helper.h>
 #include <sbi_utils/serial/fdt_serial.h>
 #include <sbi_utils/serial/uart8250.h>
@@ -16,14 +17,28 @@ static int serial_uart8250_init(void *fdt, int nodeoff,
 {
 	int rc;
 	struct platform_uart_data uart = { 0 };
+#ifdef CONFIG_SBI_CONSOLE_IRQ
+	const fdt32_t *val;
+	int len;
+#endif
 
 	rc = fdt_parse_uart_node(fdt, nodeoff, &uart);
 	if (rc)
 		return rc;
 
-	return uart8250_console_init(uart.addr, uart.freq, uart.baud,
+	rc = uart8250_console_init(uart.addr, uart.freq, uart.baud,
 			     uart.reg_shift, uart.reg_io_width,
 			     uart.reg_offset);
+	if (rc)
+		return rc;
+
+#ifdef CONFIG_SBI_CONSOLE_IRQ
+	val = fdt_getprop(fdt, nodeoff, "interrupts", &len);
+	if (val && len >= sizeof(fdt32_t))
+		uart8250_console_set_hwirq(fdt32_to_cpu(*val));
+#endif
+
+	return 0;
 }
 
 static const struct fdt_match serial_uart8250_match[] = {
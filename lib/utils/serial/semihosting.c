@@ -8,6 +8,7 @@
  *   Kautuk Consul <kconsul@ventanamicro.com>
  */
 
+#include <sbi/riscv_locks.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_string.h>
 #include <sbi/sbi_error.h>
@@ -15,6 +16,7 @@
 
 #define SYSOPEN     0x01
 #define SYSWRITEC   0x03
+#define SYSWRITE0   0x04
 #define SYSWRITE    0x05
 #define SYSREAD     0x06
 #define SYSREADC    0x07
@@ -160,6 +162,113 @@ static long semihosting_write(long fd, const void *memp, size_t len)
 
 /* clang-format on */
 
+static int semihosting_getc(void)
+{
+	char ch = 0;
+	int ret;
+
+	if (semihosting_infd < 0)  {
+		ret = semihosting_trap(SYSREADC, NULL);
+		ret = ret < 0 ? -1 : ret;
+	} else
+		ret = semihosting_read(semihosting_infd, &ch, 1) > 0 ? ch : -1;
+
+	return ret;
+}
+
+#if CONFIG_SERIAL_SEMIHOSTING_BUFFER_SIZE > 0
+#define SEMIHOSTING_BUF_SIZE	CONFIG_SERIAL_SEMIHOSTING_BUFFER_SIZE
+
+static spinlock_t semihosting_lock = SPIN_LOCK_INITIALIZER;
+/* One extra byte for the terminating NUL needed by SYSWRITE0 */
+static char semihosting_outbuf[SEMIHOSTING_BUF_SIZE + 1];
+static unsigned long semihosting_outlen;
+static char semihosting_inbuf[SEMIHOSTING_BUF_SIZE];
+static unsigned long semihosting_inpos, semihosting_inlen;
+
+static void semihosting_out_flush(void)
+{
+	unsigned long pos = 0;
+	long ret;
+
+	if (!semihosting_outlen)
+		return;
+
+	if (semihosting_outfd < 0) {
+		semihosting_outbuf[semihosting_outlen] = '\0';
+		semihosting_trap(SYSWRITE0, semihosting_outbuf);
+	} else {
+		while (pos < semihosting_outlen) {
+			ret = semihosting_write(semihosting_outfd,
+						&semihosting_outbuf[pos],
+						semihosting_outlen - pos);
+			if (ret <= 0)
+				break;
+			pos += ret;
+		}
+	}
+
+	semihosting_outlen = 0;
+}
+
+static unsigned long semihosting_buffered_puts(const char *str,
+					       unsigned long len)
+{
+	unsigned long i;
+	char ch;
+
+	spin_lock(&semihosting_lock);
+	for (i = 0; i < len; i++) {
+		ch = str[i];
+
+		/* SYSWRITE0 can't write NUL characters */
+		if (!ch && semihosting_outfd < 0) {
+			semihosting_out_flush();
+			semihosting_trap(SYSWRITEC, &ch);
+			continue;
+		}
+
+		semihosting_outbuf[semihosting_outlen++] = ch;
+		if (ch == '\n' || semihosting_outlen == SEMIHOSTING_BUF_SIZE)
+			semihosting_out_flush();
+	}
+	spin_unlock(&semihosting_lock);
+
+	return len;
+}
+
+static int semihosting_buffered_getc(void)
+{
+	long ret;
+	int ch = -1;
+
+	spin_lock(&semihosting_lock);
+
+	/* Show pending output such as prompts before waiting for input */
+	semihosting_out_flush();
+
+	if (semihosting_infd < 0) {
+		spin_unlock(&semihosting_lock);
+		return semihosting_getc();
+	}
+
+	if (semihosting_inpos == semihosting_inlen) {
+		ret = semihosting_read(semihosting_infd, semihosting_inbuf,
+				       SEMIHOSTING_BUF_SIZE);
+		semihosting_inpos = 0;
+		semihosting_inlen = (ret > 0) ? ret : 0;
+	}
+	if (semihosting_inpos < semihosting_inlen)
+		ch = semihosting_inbuf[semihosting_inpos++];
+
+	spin_unlock(&semihosting_lock);
+
+	return ch;
+}
+
+#define semihosting_console_puts	semihosting_buffered_puts
+#define semihosting_console_getc	semihosting_buffered_getc
+#else
 static unsigned long semihosting_puts(const char *str, unsigned long len)
 {
 	char ch;
@@ -178,24 +287,14 @@ static unsigned long semihosting_puts(const char *str, unsigned long len)
 	return (ret < 0) ? 0 : ret;
 }
 
-static int semihosting_getc(void)
-{
-	char ch = 0;
-	int ret;
-
-	if (semihosting_infd < 0)  {
-		ret = semihosting_trap(SYSREADC, NULL);
-		ret = ret < 0 ? -1 : ret;
-	} else
-		ret = semihosting_read(semihosting_infd, &ch, 1) > 0 ? ch : -1;
-
-	return ret;
-}
+#define semihosting_console_puts	semihosting_puts
+#define semihosting_console_getc	semihosting_getc
+#endif
 
 static struct sbi_console_device semihosting_console = {
 	.name = "semihosting",
-	.console_puts = semihosting_puts,
-	.console_getc = semihosting_getc
+	.console_puts = semihosting_console_puts,
+	.console_getc = semihosting_console_getc
 };
 
 int semihosting_init(void)
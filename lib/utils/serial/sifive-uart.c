@@ -25,6 +25,10 @@
 #define UART_RXFIFO_EMPTY	0x80000000
 #define UART_RXFIFO_DATA	0x000000ff
 #define UART_TXCTRL_TXEN	0x1
+#define UART_TXCTRL_TXCNT_SHIFT	16
+#define UART_IP_TXWM		0x1
+#define UART_IE_RXWM		0x2
+#define UART_TX_FIFO_DEPTH	8
 #define UART_RXCTRL_RXEN	0x1
 
 /* clang-format on */
@@ -74,6 +78,36 @@ static void sifive_uart_putc(char ch)
 	set_reg(UART_REG_TXFIFO, ch);
 }
 
+static unsigned long sifive_uart_puts(const char *str, unsigned long len)
+{
+	unsigned long i = 0;
+	bool cr_sent = false;
+	u32 room = 0;
+
+	/*
+	 * The TX watermark is pending only when the TX FIFO is empty
+	 * so fill the FIFO completely for every IP poll.
+	 */
+	while (i < len) {
+		if (!room) {
+			while (!(get_reg(UART_REG_IP) & UART_IP_TXWM))
+				;
+			room = UART_TX_FIFO_DEPTH;
+		}
+
+		if (str[i] == '\n' && !cr_sent) {
+			set_reg(UART_REG_TXFIFO, '\r');
+			cr_sent = true;
+		} else {
+			set_reg(UART_REG_TXFIFO, str[i++]);
+			cr_sent = false;
+		}
+		room--;
+	}
+
+	return len;
+}
+
 static int sifive_uart_getc(void)
 {
 	u32 ret = get_reg(UART_REG_RXFIFO);
@@ -84,12 +118,29 @@ static int sifive_uart_getc(void)
 	return -1;
 }
 
+#ifdef CONFIG_SBI_CONSOLE_RX_IRQ
+/* The RX watermark is pending as long as the RX FIFO isn't empty */
+static void sifive_uart_rx_irq_enable(bool enable)
+{
+	set_reg(UART_REG_IE, enable ? UART_IE_RXWM : 0);
+}
+#endif
+
 static struct sbi_console_device sifive_console = {
 	.name = "sifive_uart",
 	.console_putc = sifive_uart_putc,
+	.console_puts = sifive_uart_puts,
 	.console_getc = sifive_uart_getc
 };
 
+void sifive_uart_set_hwirq(u32 hwirq)
+{
+#ifdef CONFIG_SBI_CONSOLE_RX_IRQ
+	sifive_console.console_rx_hwirq = hwirq;
+	sifive_console.console_rx_irq_enable = sifive_uart_rx_irq_enable;
+#endif
+}
+
 int sifive_uart_init(unsigned long base, u32 in_freq, u32 baudrate)
 {
 	uart_base     = (volatile char *)base;
@@ -103,8 +154,9 @@ int sifive_uart_init(unsigned long base, u32 in_freq, u32 baudrate)
 	/* Disable interrupts */
 	set_reg(UART_REG_IE, 0);
 
-	/* Enable TX */
-	set_reg(UART_REG_TXCTRL, UART_TXCTRL_TXEN);
+	/* Enable TX with TX watermark pending when TX FIFO is empty */
+	set_reg(UART_REG_TXCTRL,
+		UART_TXCTRL_TXEN | (1 << UART_TXCTRL_TXCNT_SHIFT));
 
 	/* Enable Rx */
 	set_reg(UART_REG_RXCTRL, UART_RXCTRL_RXEN);
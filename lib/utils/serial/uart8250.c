@@ -39,6 +39,13 @@
 #define UART_LSR_DR		0x01	/* Receiver data ready */
 #define UART_LSR_BRK_ERROR_BITS	0x1E	/* BI, FE, PE, OE bits */
 
+#define UART_IER_RDI		0x01	/* Enable receiver data interrupt */
+#define UART_IER_THRI		0x02	/* Enable transmitter holding register int. */
+
+#define UART_IIR_FIFO_MASK	0xC0	/* FIFOs enabled and working */
+
+#define UART_TX_FIFO_DEPTH	16	/* 16550 compatible TX FIFO depth */
+
 /* clang-format on */
 
 static struct uart8250_device console_dev;
@@ -75,6 +82,54 @@ void uart8250_putc(struct uart8250_device *dev, char ch)
 	set_reg(dev, UART_THR_OFFSET, ch);
 }
 
+unsigned long uart8250_puts(struct uart8250_device *dev, const char *str,
+			    unsigned long len)
+{
+	unsigned long i = 0;
+	bool cr_sent = false;
+	u32 room = 0;
+
+	/*
+	 * THRE is set once the whole TX FIFO is empty so fill the
+	 * FIFO completely for every LSR poll.
+	 */
+	while (i < len) {
+		if (!room) {
+			while ((get_reg(dev, UART_LSR_OFFSET) &
+				UART_LSR_THRE) == 0)
+				;
+			room = dev->tx_fifo_depth;
+		}
+
+		if (str[i] == '\n' && !cr_sent) {
+			set_reg(dev, UART_THR_OFFSET, '\r');
+			cr_sent = true;
+		} else {
+			set_reg(dev, UART_THR_OFFSET, str[i++]);
+			cr_sent = false;
+		}
+		room--;
+	}
+
+	return len;
+}
+
+unsigned long uart8250_write_nonblock(struct uart8250_device *dev,
+				     const char *buf, unsigned long len)
+{
+	unsigned long i;
+
+	if ((get_reg(dev, UART_LSR_OFFSET) & UART_LSR_THRE) == 0)
+		return 0;
+
+	if (len > dev->tx_fifo_depth)
+		len = dev->tx_fifo_depth;
+	for (i = 0; i < len; i++)
+		set_reg(dev, UART_THR_OFFSET, buf[i]);
+
+	return len;
+}
+
 int uart8250_getc(struct uart8250_device *dev)
 {
 	if (get_reg(dev, UART_LSR_OFFSET) & UART_LSR_DR)
@@ -87,17 +142,69 @@ static void uart8250_console_putc(char ch)
 	uart8250_putc(&console_dev, ch);
 }
 
+static unsigned long uart8250_console_puts(const char *str, unsigned long len)
+{
+	return uart8250_puts(&console_dev, str, len);
+}
+
 static int uart8250_console_getc(void)
 {
 	return uart8250_getc(&console_dev);
 }
 
+#ifdef CONFIG_SBI_CONSOLE_IRQ
+/*
+ * Interrupts enabled in the IER of the console UART, updated atomically
+ * because TX is enabled by any HART writing to the console while the
+ * interrupt handler disables it.
+ */
+static u32 console_ier;
+
+static void uart8250_console_irq_enable(u32 mask, bool enable)
+{
+	u32 ier;
+
+	if (enable)
+		ier = __atomic_or_fetch(&console_ier, mask, __ATOMIC_RELAXED);
+	else
+		ier = __atomic_and_fetch(&console_ier, ~mask, __ATOMIC_RELAXED);
+	set_reg(&console_dev, UART_IER_OFFSET, ier);
+}
+#endif
+
+#ifdef CONFIG_SBI_CONSOLE_TX_IRQ
+static void uart8250_console_tx_irq_enable(bool enable)
+{
+	uart8250_console_irq_enable(UART_IER_THRI, enable);
+}
+#endif
+
+#ifdef CONFIG_SBI_CONSOLE_RX_IRQ
+static void uart8250_console_rx_irq_enable(bool enable)
+{
+	uart8250_console_irq_enable(UART_IER_RDI, enable);
+}
+#endif
+
 static struct sbi_console_device uart8250_console = {
 	.name = "uart8250",
 	.console_putc = uart8250_console_putc,
+	.console_puts = uart8250_console_puts,
 	.console_getc = uart8250_console_getc
 };
 
+void uart8250_console_set_hwirq(u32 hwirq)
+{
+#ifdef CONFIG_SBI_CONSOLE_TX_IRQ
+	uart8250_console.console_tx_hwirq = hwirq;
+	uart8250_console.console_tx_irq_enable = uart8250_console_tx_irq_enable;
+#endif
+#ifdef CONFIG_SBI_CONSOLE_RX_IRQ
+	uart8250_console.console_rx_hwirq = hwirq;
+	uart8250_console.console_rx_irq_enable = uart8250_console_rx_irq_enable;
+#endif
+}
+
 int uart8250_init(struct uart8250_device * dev, unsigned long base, u32 in_freq,
 		  u32 baudrate, u32 reg_shift, u32 reg_width, u32 reg_offset)
 {
@@ -128,6 +235,12 @@ int uart8250_init(struct uart8250_device * dev, unsigned long base, u32 in_freq,
 	set_reg(dev, UART_LCR_OFFSET, 0x03);
 	/* Enable FIFO */
 	set_reg(dev, UART_FCR_OFFSET, 0x01);
+	/* Only burst TX writes if the FIFO is really there */
+	if ((get_reg(dev, UART_IIR_OFFSET) & UART_IIR_FIFO_MASK) ==
+	    UART_IIR_FIFO_MASK)
+		dev->tx_fifo_depth = UART_TX_FIFO_DEPTH;
+	else
+		dev->tx_fifo_depth = 1;
 	/* No modem control DTR RTS */
 	set_reg(dev, UART_MCR_OFFSET, 0x00);
 	/* Clear line status */
@@ -127,7 +127,7 @@ static int set_custom_addr(bool custom_addr,
 	return 0;
 }
 
-#if __riscv_xlen == 32
+#if __riscv_xlen == 32 || defined(CONFIG_SYS_HTIF_CONSOLE_SYSCALL)
 static void do_tohost_fromhost(uint64_t dev, uint64_t cmd, uint64_t data)
 {
 	spin_lock(&htif_lock);
@@ -148,7 +148,24 @@ static void do_tohost_fromhost(uint64_t dev, uint64_t cmd, uint64_t data)
 
 	spin_unlock(&htif_lock);
 }
+#endif
 
+#ifdef CONFIG_SYS_HTIF_CONSOLE_SYSCALL
+static unsigned long htif_puts(const char *str, unsigned long len)
+{
+	/* Send the whole string with one proxy write call */
+	volatile uint64_t magic_mem[8];
+	magic_mem[0] = PK_SYS_write;
+	magic_mem[1] = HTIF_DEV_CONSOLE;
+	magic_mem[2] = (uint64_t)(uintptr_t)str;
+	magic_mem[3] = len;
+	do_tohost_fromhost(HTIF_DEV_SYSTEM, 0, (uint64_t)(uintptr_t)magic_mem);
+
+	return len;
+}
+#endif
+
+#if __riscv_xlen == 32
 static void htif_putc(char ch)
 {
 	/* HTIF devices are not supported on RV32, so do a proxy write call */
@@ -194,6 +211,9 @@ static int htif_getc(void)
 static struct sbi_console_device htif_console = {
 	.name = "htif",
 	.console_putc = htif_putc,
+#ifdef CONFIG_SYS_HTIF_CONSOLE_SYSCALL
+	.console_puts = htif_puts,
+#endif
 	.console_getc = htif_getc
 };
 
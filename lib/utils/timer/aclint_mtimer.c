@@ -11,6 +11,7 @@
 #include <sbi/riscv_atomic.h>
 #include <sbi/riscv_io.h>
 #include <sbi/sbi_bitops.h>
+#include <sbi/sbi_console.h>
 #include <sbi/sbi_domain.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_scratch.h>
@@ -19,6 +20,14 @@
 
 static unsigned long mtimer_ptr_offset;
 
+/* Number of round-trips used to measure the offset of two MTIME */
+#define MTIMER_SYNC_SAMPLES		8
+
+/* MTIMER devices having a reference MTIMER device */
+static struct aclint_mtimer_data *mtimer_sync_list;
+static struct sbi_timer_event mtimer_sync_event;
+static u64 mtimer_sync_period;
+
 #define mtimer_get_hart_data_ptr(__scratch)				\
 	sbi_scratch_read_type((__scratch), void *, mtimer_ptr_offset)
 
@@ -66,9 +75,29 @@ static u64 mtimer_value(void)
 		return 0;
 
 	/* Read MTIMER Time Value */
+#if __riscv_xlen != 32
+	if (mt->has_64bit_mmio)
+		return readq_relaxed((void *)mt->mtime_addr);
+#endif
 	return mt->time_rd((void *)mt->mtime_addr);
 }
 
+static volatile u64 *mtimer_value_addr(void)
+{
+#if __riscv_xlen != 32
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct aclint_mtimer_data *mt;
+
+	mt = mtimer_get_hart_data_ptr(scratch);
+	if (!mt || !mt->mtime_size || !mt->has_64bit_mmio)
+		return NULL;
+
+	return (volatile u64 *)mt->mtime_addr;
+#else
+	return NULL;
+#endif
+}
+
 static void mtimer_event_stop(void)
 {
 	u32 target_hart = current_hartid();
@@ -105,40 +134,164 @@ static void mtimer_event_start(u64 next_event)
 static struct sbi_timer_device mtimer = {
 	.name = "aclint-mtimer",
 	.timer_value = mtimer_value,
+	.timer_value_addr = mtimer_value_addr,
 	.timer_event_start = mtimer_event_start,
 	.timer_event_stop = mtimer_event_stop
 };
 
+/*
+ * Measure the offset of the reference MTIME relative to the MTIME of
+ * given MTIMER device. The reference is read in between two reads of
+ * the local MTIME and the sample with the shortest round-trip is used
+ * so the returned offset is accurate up to half of that round-trip,
+ * which is returned as the error bound.
+ */
+static u64 mtimer_sync_measure(struct aclint_mtimer_data *mt, s64 *offset)
+{
+	struct aclint_mtimer_data *reference = mt->time_delta_reference;
+	u64 *mt_time_val = (void *)mt->mtime_addr;
+	u64 *ref_time_val = (void *)reference->mtime_addr;
+	u64 v1, v2, mv, rtt, best_rtt = -1ULL;
+	int i;
+
+	for (i = 0; i < MTIMER_SYNC_SAMPLES; i++) {
+		v1 = mt->time_rd(mt_time_val);
+		mv = reference->time_rd(ref_time_val);
+		v2 = mt->time_rd(mt_time_val);
+		rtt = v2 - v1;
+		if (rtt < best_rtt) {
+			best_rtt = rtt;
+			*offset = (s64)(mv - (v1 + rtt / 2));
+		}
+	}
+
+	return best_rtt / 2 + 1;
+}
+
 void aclint_mtimer_sync(struct aclint_mtimer_data *mt)
 {
-	u64 v1, v2, mv, delta;
-	u64 *mt_time_val, *ref_time_val;
-	struct aclint_mtimer_data *reference;
+	u64 *mt_time_val;
+	s64 delta;
 
 	/* Sync-up non-shared MTIME if reference is available */
 	if (mt->has_shared_mtime || !mt->time_delta_reference)
 		return;
 
-	reference = mt->time_delta_reference;
 	mt_time_val = (void *)mt->mtime_addr;
-	ref_time_val = (void *)reference->mtime_addr;
 	if (!atomic_raw_xchg_ulong(&mt->time_delta_computed, 1)) {
-		v1 = mt->time_rd(mt_time_val);
-		mv = reference->time_rd(ref_time_val);
-		v2 = mt->time_rd(mt_time_val);
-		delta = mv - ((v1 / 2) + (v2 / 2));
+		mtimer_sync_measure(mt, &delta);
 		mt->time_wr(false, mt->time_rd(mt_time_val) + delta,
 			    mt_time_val);
 	}
 
 }
 
+/*
+ * Periodic resync of MTIME counters drifting apart (such as the MTIME
+ * of different dies). Since S-mode expects a monotonic clock, only the
+ * counter which is behind is moved forward and offsets within the
+ * measurement error are left alone.
+ */
+static void mtimer_resync(struct aclint_mtimer_data *mt)
+{
+	struct aclint_mtimer_data *reference = mt->time_delta_reference;
+	u64 *mt_time_val = (void *)mt->mtime_addr;
+	u64 *ref_time_val = (void *)reference->mtime_addr;
+	u64 err, skew;
+	s64 offset;
+
+	if (mt->has_shared_mtime)
+		return;
+
+	err = mtimer_sync_measure(mt, &offset);
+	skew = (offset < 0) ? -offset : offset;
+	if (mt->sync_max_skew < skew)
+		mt->sync_max_skew = skew;
+	if (skew <= err)
+		return;
+
+	if (offset > 0)
+		mt->time_wr(false, mt->time_rd(mt_time_val) + skew,
+			    mt_time_val);
+	else
+		reference->time_wr(false, reference->time_rd(ref_time_val) +
+				   skew, ref_time_val);
+}
+
+static void mtimer_sync_event_callback(struct sbi_timer_event *ev)
+{
+	struct aclint_mtimer_data *mt;
+
+	for (mt = mtimer_sync_list; mt; mt = mt->sync_next)
+		mtimer_resync(mt);
+
+	ev->deadline += mtimer_sync_period;
+	sbi_timer_event_add(ev);
+}
+
+/**
+ * Start periodic resync of MTIMER devices with their reference device
+ *
+ * This is expected to be called once on the boot HART (for example from
+ * the platform final_init) and requires CONFIG_SBI_TIMER_EVENTS for the
+ * periodic part. The skew observed at start is printed in the boot log.
+ */
+int aclint_mtimer_sync_start(unsigned long period_ms)
+{
+	const struct sbi_timer_device *tdev = sbi_timer_get_device();
+	struct aclint_mtimer_data *mt;
+	u64 err;
+	s64 offset;
+
+	if (!mtimer_sync_list)
+		return 0;
+	if (!tdev || !tdev->timer_freq || !period_ms)
+		return SBI_EINVAL;
+
+	for (mt = mtimer_sync_list; mt; mt = mt->sync_next) {
+		if (mt->has_shared_mtime)
+			continue;
+		err = mtimer_sync_measure(mt, &offset);
+		sbi_printf("aclint-mtimer: MTIME@0x%lx skew %ld ticks (+/- %lu)\n",
+			   mt->mtime_addr, (long)offset, (unsigned long)err);
+		mtimer_resync(mt);
+	}
+
+	mtimer_sync_period = (u64)tdev->timer_freq * period_ms / 1000;
+	if (!mtimer_sync_period)
+		mtimer_sync_period = 1;
+
+	mtimer_sync_event.callback = mtimer_sync_event_callback;
+	mtimer_sync_event.deadline = sbi_timer_value() + mtimer_sync_period;
+
+	return sbi_timer_event_add(&mtimer_sync_event);
+}
+
+/** Maximum skew (in ticks) observed by the periodic MTIMER resync */
+u64 aclint_mtimer_sync_max_skew(void)
+{
+	struct aclint_mtimer_data *mt;
+	u64 ret = 0;
+
+	for (mt = mtimer_sync_list; mt; mt = mt->sync_next) {
+		if (ret < mt->sync_max_skew)
+			ret = mt->sync_max_skew;
+	}
+
+	return ret;
+}
+
 void aclint_mtimer_set_reference(struct aclint_mtimer_data *mt,
 				 struct aclint_mtimer_data *ref)
 {
 	if (!mt || !ref || mt == ref)
 		return;
 
+	if (!mt->time_delta_reference) {
+		mt->sync_next = mtimer_sync_list;
+		mtimer_sync_list = mt;
+	}
+
 	mt->time_delta_reference = ref;
 	mt->time_delta_computed = 0;
 }
@@ -32,6 +32,15 @@ static u64 plmt_timer_value(void)
 #endif
 }
 
+static volatile u64 *plmt_timer_value_addr(void)
+{
+#if __riscv_xlen == 64
+	return plmt.time_val;
+#else
+	return NULL;
+#endif
+}
+
 static void plmt_timer_event_stop(void)
 {
 	u32 target_hart = current_hartid();
@@ -71,6 +80,7 @@ static struct sbi_timer_device plmt_timer = {
 	.name		   = "andes_plmt",
 	.timer_freq	   = DEFAULT_AE350_PLMT_FREQ,
 	.timer_value	   = plmt_timer_value,
+	.timer_value_addr  = plmt_timer_value_addr,
 	.timer_event_start = plmt_timer_event_start,
 	.timer_event_stop  = plmt_timer_event_stop
 };
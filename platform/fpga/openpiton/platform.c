@@ -9,7 +9,9 @@
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_const.h>
 #include <sbi/sbi_hart.h>
+#include <sbi/sbi_ipi.h>
 #include <sbi/sbi_platform.h>
+#include <libfdt.h>
 #include <sbi_utils/fdt/fdt_helper.h>
 #include <sbi_utils/fdt/fdt_fixup.h>
 #include <sbi_utils/ipi/aclint_mswi.h>
@@ -27,7 +29,8 @@
 #define OPENPITON_DEFAULT_PLIC_SIZE		(0x200000 + \
 				(OPENPITON_DEFAULT_HART_COUNT * 0x1000))
 #define OPENPITON_DEFAULT_PLIC_NUM_SOURCES	2
-#define OPENPITON_DEFAULT_HART_COUNT		3
+#define OPENPITON_DEFAULT_HART_COUNT		\
+		CONFIG_PLATFORM_OPENPITON_FPGA_HART_COUNT
 #define OPENPITON_DEFAULT_CLINT_ADDR		0xfff1020000
 #define OPENPITON_DEFAULT_ACLINT_MTIMER_FREQ	1000000
 #define OPENPITON_DEFAULT_ACLINT_MSWI_ADDR	\
@@ -66,6 +69,54 @@ static struct aclint_mtimer_data mtimer = {
 	.has_64bit_mmio = true,
 };
 
+/*
+ * PLIC M-mode and S-mode contexts of each HART, -1 for a HART without
+ * context. Used instead of the default two contexts per HART once they
+ * have been found in the device tree.
+ */
+static int plic_contexts[OPENPITON_DEFAULT_HART_COUNT][2];
+static bool plic_contexts_valid;
+
+static void openpiton_parse_plic_contexts(void *fdt, const char *compat)
+{
+	int i, count, nodeoff, cpu_offset, cpu_intc_offset;
+	const fdt32_t *val;
+	u32 hartid, hwirq;
+
+	nodeoff = fdt_node_offset_by_compatible(fdt, -1, compat);
+	if (nodeoff < 0)
+		return;
+
+	val = fdt_getprop(fdt, nodeoff, "interrupts-extended", &count);
+	if (!val || count < 2 * sizeof(fdt32_t))
+		return;
+	count = count / sizeof(fdt32_t);
+
+	for (i = 0; i < OPENPITON_DEFAULT_HART_COUNT; i++)
+		plic_contexts[i][0] = plic_contexts[i][1] = -1;
+
+	for (i = 0; i < count - 1; i += 2) {
+		cpu_intc_offset = fdt_node_offset_by_phandle_cached(fdt,
+						fdt32_to_cpu(val[i]));
+		if (cpu_intc_offset < 0)
+			continue;
+
+		cpu_offset = fdt_parent_offset(fdt, cpu_intc_offset);
+		if (cpu_offset < 0 ||
+		    fdt_parse_hart_id(fdt, cpu_offset, &hartid) ||
+		    OPENPITON_DEFAULT_HART_COUNT <= hartid)
+			continue;
+
+		hwirq = fdt32_to_cpu(val[i + 1]);
+		if (hwirq == IRQ_M_EXT)
+			plic_contexts[hartid][0] = i / 2;
+		else if (hwirq == IRQ_S_EXT)
+			plic_contexts[hartid][1] = i / 2;
+	}
+
+	plic_contexts_valid = true;
+}
+
 /*
  * OpenPiton platform early initialization.
  */
@@ -76,6 +127,7 @@ static int openpiton_early_init(bool cold_boot)
 	struct plic_data plic_data;
 	unsigned long aclint_freq;
 	uint64_t clint_addr;
+	u32 max_hartid, cluster_harts;
 	int rc;
 
 	if (!cold_boot)
@@ -89,6 +141,19 @@ static int openpiton_early_init(bool cold_boot)
 	rc = fdt_parse_plic(fdt, &plic_data, "riscv,plic0");
 	if (!rc)
 		plic = plic_data;
+	openpiton_parse_plic_contexts(fdt, "riscv,plic0");
+
+	/* Only the tiles present in the device tree have a CLINT slot */
+	rc = fdt_parse_max_enabled_hart_id(fdt, &max_hartid);
+	if (!rc && max_hartid < OPENPITON_DEFAULT_HART_COUNT) {
+		mswi.hart_count = max_hartid + 1;
+		mtimer.hart_count = max_hartid + 1;
+	}
+
+	/* Forward IPIs through a leader HART in each cluster of tiles */
+	rc = fdt_parse_cpu_map_cluster_harts(fdt, &cluster_harts);
+	if (!rc)
+		sbi_ipi_set_forward_cluster(cluster_harts);
 
 	rc = fdt_parse_timebase_frequency(fdt, &aclint_freq);
 	if (!rc)
@@ -169,6 +234,12 @@ static int openpiton_irqchip_init(bool cold_boot)
 		if (ret)
 			return ret;
 	}
+
+	if (plic_contexts_valid)
+		return plic_openpiton_warm_irqchip_init(
+				plic_contexts[hartid][0],
+				plic_contexts[hartid][1]);
+
 	return plic_openpiton_warm_irqchip_init(2 * hartid, 2 * hartid + 1);
 }
 
@@ -94,14 +94,33 @@ static inline bool not_napot(unsigned long addr, unsigned long size)
 	return ((size & (size - 1)) || (addr & (size - 1)));
 }
 
-static unsigned long andes_pma_setup(const struct andes_pma_region *pma_region,
-				     unsigned int entry_id)
+#define ANDES_PMACFG_PER_CSR	(__riscv_xlen / 8)
+#define ANDES_PMACFG_CSR_COUNT	(ANDES_MAX_PMA_REGIONS / ANDES_PMACFG_PER_CSR)
+
+/* Only the even pmacfg CSRs exist on RV64 */
+#if __riscv_xlen == 64
+#define ANDES_PMACFG_CSR(__i)	(CSR_PMACFG0 + 2 * (__i))
+#elif __riscv_xlen == 32
+#define ANDES_PMACFG_CSR(__i)	(CSR_PMACFG0 + (__i))
+#else
+#error "Unexpected __riscv_xlen"
+#endif
+
+/*
+ * PMA CSR image computed once on the cold boot HART and written as is
+ * on every HART boot and non-retentive resume.
+ */
+static struct {
+	unsigned long pmacfg[ANDES_PMACFG_CSR_COUNT];
+	unsigned long pmaaddr[ANDES_MAX_PMA_REGIONS];
+	unsigned int count;
+} andes_pma_image;
+
+static int andes_pma_setup(const struct andes_pma_region *pma_region,
+			   unsigned int entry_id)
 {
 	unsigned long size = pma_region->size;
 	unsigned long addr = pma_region->pa;
-	unsigned int pma_cfg_addr;
-	unsigned long pmacfg_val;
-	unsigned long pmaaddr;
 	char *pmaxcfg;
 
 	/* Check for a 4KiB granularity NAPOT region*/
@@ -109,27 +128,29 @@ static unsigned long andes_pma_setup(const struct andes_pma_region *pma_region,
 	    !(pma_region->flags & ANDES_PMACFG_ETYP_NAPOT))
 		return SBI_EINVAL;
 
-#if __riscv_xlen == 64
-	pma_cfg_addr = CSR_PMACFG0 + ((entry_id / 8) ? 2 : 0);
-	pmacfg_val = andes_pma_read_num(pma_cfg_addr);
-	pmaxcfg = (char *)&pmacfg_val + (entry_id % 8);
-#elif __riscv_xlen == 32
-	pma_cfg_addr = CSR_PMACFG0 + (entry_id / 4);
-	pmacfg_val = andes_pma_read_num(pma_cfg_addr);
-	pmaxcfg = (char *)&pmacfg_val + (entry_id % 4);
-#else
-#error "Unexpected __riscv_xlen"
-#endif
-	*pmaxcfg = pma_region->flags;
+	pmaxcfg = (char *)&andes_pma_image.pmacfg[entry_id / ANDES_PMACFG_PER_CSR];
+	pmaxcfg[entry_id % ANDES_PMACFG_PER_CSR] = pma_region->flags;
+
+	andes_pma_image.pmaaddr[entry_id] = (addr >> 2) + (size >> 3) - 1;
+
+	return 0;
+}
 
-	andes_pma_write_num(pma_cfg_addr, pmacfg_val);
+void andes_pma_apply(void)
+{
+	unsigned int i;
 
-	pmaaddr = (addr >> 2) + (size >> 3) - 1;
+	if (!andes_pma_image.count)
+		return;
 
-	andes_pma_write_num(CSR_PMAADDR0 + entry_id, pmaaddr);
+	/* Program the addresses before enabling the entries */
+	for (i = 0; i < andes_pma_image.count; i++)
+		andes_pma_write_num(CSR_PMAADDR0 + i,
+				    andes_pma_image.pmaaddr[i]);
 
-	return andes_pma_read_num(CSR_PMAADDR0 + entry_id) == pmaaddr ?
-	       pmaaddr : SBI_EINVAL;
+	for (i = 0; i <= (andes_pma_image.count - 1) / ANDES_PMACFG_PER_CSR; i++)
+		andes_pma_write_num(ANDES_PMACFG_CSR(i),
+				    andes_pma_image.pmacfg[i]);
 }
 
 static int andes_fdt_pma_resv(void *fdt, const struct andes_pma_region *pma,
@@ -244,7 +265,6 @@ int andes_pma_setup_regions(const struct andes_pma_region *pma_regions,
 	unsigned long mmsc = csr_read(CSR_MMSC_CFG);
 	unsigned int dt_populate_cnt;
 	unsigned int i, j;
-	unsigned long pa;
 	void *fdt;
 	int ret;
 
@@ -257,15 +277,31 @@ int andes_pma_setup_regions(const struct andes_pma_region *pma_regions,
 	if ((mmsc & MMSC_CFG_PPMA_MASK) == 0)
 		return SBI_ENOTSUPP;
 
-	/* Configure the PMA regions */
+	/* Start from the reset value of the pmacfg CSRs */
+	for (i = 0; i < ANDES_PMACFG_CSR_COUNT; i++)
+		andes_pma_image.pmacfg[i] =
+				andes_pma_read_num(ANDES_PMACFG_CSR(i));
+
+	/* Compute the PMA regions */
 	dt_populate_cnt = 0;
 	for (i = 0; i < pma_regions_count; i++) {
-		pa = andes_pma_setup(&pma_regions[i], i);
-		if (pa == SBI_EINVAL)
+		if (andes_pma_setup(&pma_regions[i], i))
 			return SBI_EINVAL;
 		else if (pma_regions[i].dt_populate)
 			dt_populate_cnt++;
 	}
+	andes_pma_image.count = pma_regions_count;
+
+	andes_pma_apply();
+
+	/* PMA entries are WARL so a mismatch means too few entries */
+	for (i = 0; i < pma_regions_count; i++) {
+		if (andes_pma_read_num(CSR_PMAADDR0 + i) !=
+		    andes_pma_image.pmaaddr[i]) {
+			andes_pma_image.count = 0;
+			return SBI_EINVAL;
+		}
+	}
 
 	if (!dt_populate_cnt)
 		return 0;
@@ -31,6 +31,11 @@ static void andes_hw_counter_disable_irq(uint32_t ctr_idx)
 	csr_clear(CSR_MCOUNTERINTEN, BIT(ctr_idx));
 }
 
+static unsigned long andes_hw_counter_overflow_status(void)
+{
+	return csr_read(CSR_MCOUNTEROVF);
+}
+
 static void andes_hw_counter_filter_mode(unsigned long flags, int ctr_idx)
 {
 	if (flags & SBI_PMU_CFG_FLAG_SET_UINH)
@@ -54,7 +59,8 @@ static struct sbi_pmu_device andes_pmu = {
 	 * hw_counter_irq_bit() callback unimplemented.
 	 */
 	.hw_counter_irq_bit     = NULL,
-	.hw_counter_filter_mode = andes_hw_counter_filter_mode
+	.hw_counter_filter_mode = andes_hw_counter_filter_mode,
+	.hw_counter_overflow_status = andes_hw_counter_overflow_status,
 };
 
 int andes_pmu_extensions_init(const struct fdt_match *match,
@@ -1,9 +1,18 @@
+#include <libfdt.h>
 #include <platform_override.h>
 #include <sbi_utils/fdt/fdt_helper.h>
 #include <sbi_utils/serial/uart8250.h>
+#include <sbi_utils/timer/aclint_mtimer.h>
+#include <sbi/riscv_asm.h>
 #include <sbi/riscv_locks.h>
 #include <sbi/riscv_io.h>
+#include <sbi/sbi_cppc.h>
+#include <sbi/sbi_domain.h>
 #include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_pmu.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
 #include <sbi/sbi_system.h>
 #include <sbi/sbi_timer.h>
 
@@ -15,6 +24,9 @@
 /* Full tlb flush always */
 #define EIC770X_TLB_RANGE_FLUSH_LIMIT	0
 
+/* Period of MTIME resync between the two dies */
+#define EIC770X_MTIME_SYNC_PERIOD_MS	1000
+
 #ifdef BR2_CHIPLET_1
 #ifdef BR2_CHIPLET_1_DIE0_AVAILABLE
 #define	DIE_REG_OFFSET				0
@@ -64,53 +76,321 @@ typedef enum {
 	CMD_BOARD_STATUS,
 	CMD_POWER_INFO,
 	CMD_RESTART,    //cold reboot with power off/on
+	CMD_CPU_OPP,    //set cpu cluster frequency and voltage
 	// You can continue adding other command types
 } CommandType;
 
-struct uart8250_device mcu_uart_dev;
-static spinlock_t mcu_uart_lock = SPIN_LOCK_INITIALIZER;
-
-static int transmit_message(Message *msg)
-{
-	static int inited = 0;
-	unsigned char checksum = 0;
-	char *p = (char*)msg;
-	unsigned len = sizeof(*msg);
-
-	if (!inited) {
-		writeb(0x1B, (volatile void *)EIC770X_UART_RESET_ADDR);
-		writeb(0x1F, (volatile void *)EIC770X_UART_RESET_ADDR);
-		uart8250_init(&mcu_uart_dev,
-				EIC770X_UART2_ADDR,
-				EIC770X_UART_CLK,
-				EIC770X_UART_BAUDRATE,
-				2, 2, 0);
-		inited = 1;
+#define MCU_FRAME_HEADER	0xA55AAA55
+#define MCU_FRAME_TAIL		0xBDBABDBA
+
+/* Number of frames queued for transmit or waiting for a reply */
+#define MCU_REQUEST_SLOTS	8
+/* Period of UART polling while the mailbox is busy */
+#define MCU_POLL_US		1000
+/* Time the MCU has to reply to a request */
+#define MCU_REPLY_TIMEOUT_MS	100
+/* Longest time to wait for queued frames before a reset */
+#define MCU_FLUSH_TIMEOUT_MS	500
+
+/*
+ * Completion of a request. The reply is valid only when ret is zero and
+ * holds the command result reported by the MCU.
+ */
+typedef void (*mcu_done_t)(int ret, const Message *reply);
+
+enum mcu_slot_state {
+	MCU_SLOT_FREE = 0,
+	MCU_SLOT_TX,
+	MCU_SLOT_WAIT,
+	MCU_SLOT_DONE,
+};
+
+struct mcu_slot {
+	Message msg;
+	mcu_done_t done;
+	u64 deadline;
+	int ret;
+	enum mcu_slot_state state;
+};
+
+/*
+ * Asynchronous mailbox to the board MCU over UART2. Frames are queued in
+ * a ring, drained as far as the TX FIFO allows from the caller and from a
+ * polling timer event, and replies are matched to the oldest request
+ * waiting with the same command type.
+ */
+static struct {
+	struct uart8250_device uart;
+	bool inited;
+	struct mcu_slot slots[MCU_REQUEST_SLOTS];
+	/* Ring of slot indexes in transmit order */
+	u8 tx_ring[MCU_REQUEST_SLOTS];
+	u32 tx_head;
+	u32 tx_count;
+	/* Bytes of the frame at tx_head already written to the UART */
+	u32 tx_pos;
+	Message rx;
+	u32 rx_pos;
+	struct sbi_timer_event ev;
+} mcu;
+
+static spinlock_t mcu_lock = SPIN_LOCK_INITIALIZER;
+
+static u8 mcu_frame_checksum(const Message *msg)
+{
+	u8 checksum = msg->msg_type ^ msg->cmd_type ^ msg->data_len;
+	int i;
+
+	for (i = 0; i < msg->data_len && i < FRAME_DATA_MAX; i++)
+		checksum ^= msg->data[i];
+
+	return checksum;
+}
+
+static void mcu_uart_init(void)
+{
+	if (mcu.inited)
+		return;
+
+	writeb(0x1B, (volatile void *)EIC770X_UART_RESET_ADDR);
+	writeb(0x1F, (volatile void *)EIC770X_UART_RESET_ADDR);
+	uart8250_init(&mcu.uart,
+			EIC770X_UART2_ADDR,
+			EIC770X_UART_CLK,
+			EIC770X_UART_BAUDRATE,
+			2, 2, 0);
+	mcu.inited = true;
+}
+
+static u64 mcu_ms_to_ticks(u64 ms)
+{
+	return ms * sbi_timer_get_device()->timer_freq / 1000;
+}
+
+/* Write queued frames until the TX FIFO is full, with mcu_lock held */
+static void mcu_tx_pump(void)
+{
+	struct mcu_slot *slot;
+	unsigned long n;
+
+	while (mcu.tx_count) {
+		slot = &mcu.slots[mcu.tx_ring[mcu.tx_head]];
+		n = uart8250_write_nonblock(&mcu.uart,
+					    (const char *)&slot->msg + mcu.tx_pos,
+					    sizeof(slot->msg) - mcu.tx_pos);
+		if (!n)
+			break;
+
+		mcu.tx_pos += n;
+		if (mcu.tx_pos < sizeof(slot->msg))
+			continue;
+
+		if (slot->done) {
+			slot->deadline = sbi_timer_value() +
+					 mcu_ms_to_ticks(MCU_REPLY_TIMEOUT_MS);
+			slot->state = MCU_SLOT_WAIT;
+		} else {
+			slot->state = MCU_SLOT_FREE;
+		}
+		mcu.tx_head = (mcu.tx_head + 1) % MCU_REQUEST_SLOTS;
+		mcu.tx_count--;
+		mcu.tx_pos = 0;
 	}
+}
 
-	msg->header = 0xA55AAA55;
-	msg->tail = 0xBDBABDBA;
-	checksum ^= msg->msg_type;
-	checksum ^= msg->cmd_type;
-	checksum ^= msg->data_len;
-	for (int i = 0; i < FRAME_DATA_MAX; ++i) {
-		if (i < msg->data_len)
-			checksum ^= msg->data[i];
-		else
-			msg->data[i] = 0;
+static void mcu_rx_frame(void)
+{
+	struct mcu_slot *slot, *match = NULL;
+	int i;
+
+	if (mcu.rx.tail != MCU_FRAME_TAIL || mcu.rx.msg_type != MSG_REPLY ||
+	    mcu.rx.checksum != mcu_frame_checksum(&mcu.rx))
+		return;
+
+	for (i = 0; i < MCU_REQUEST_SLOTS; i++) {
+		slot = &mcu.slots[i];
+		if (slot->state != MCU_SLOT_WAIT ||
+		    slot->msg.cmd_type != mcu.rx.cmd_type)
+			continue;
+		if (!match || slot->deadline < match->deadline)
+			match = slot;
 	}
-	msg->checksum = checksum;
+	if (!match)
+		return;
+
+	sbi_memcpy(&match->msg, &mcu.rx, sizeof(match->msg));
+	match->ret = 0;
+	match->state = MCU_SLOT_DONE;
+}
 
-	spin_lock(&mcu_uart_lock);
-	while (len--) {
-		uart8250_putc(&mcu_uart_dev, *p);
-		p++;
+/* Parse received bytes and expire requests, with mcu_lock held */
+static void mcu_rx_pump(void)
+{
+	u8 *buf = (u8 *)&mcu.rx;
+	u64 now = sbi_timer_value();
+	int i, ch;
+
+	while ((ch = uart8250_getc(&mcu.uart)) >= 0) {
+		/* Resynchronize on the frame header byte by byte */
+		if (mcu.rx_pos < sizeof(mcu.rx.header) &&
+		    ch != ((MCU_FRAME_HEADER >> (8 * mcu.rx_pos)) & 0xff)) {
+			mcu.rx_pos = (ch == (MCU_FRAME_HEADER & 0xff)) ? 1 : 0;
+			continue;
+		}
+
+		buf[mcu.rx_pos++] = ch;
+		if (mcu.rx_pos == sizeof(mcu.rx)) {
+			mcu_rx_frame();
+			mcu.rx_pos = 0;
+		}
+	}
+
+	for (i = 0; i < MCU_REQUEST_SLOTS; i++) {
+		if (mcu.slots[i].state == MCU_SLOT_WAIT &&
+		    mcu.slots[i].deadline <= now) {
+			mcu.slots[i].ret = SBI_ETIMEDOUT;
+			mcu.slots[i].state = MCU_SLOT_DONE;
+		}
+	}
+}
+
+static bool mcu_busy(void)
+{
+	int i;
+
+	if (mcu.tx_count)
+		return true;
+
+	for (i = 0; i < MCU_REQUEST_SLOTS; i++) {
+		if (mcu.slots[i].state != MCU_SLOT_FREE)
+			return true;
 	}
-	spin_unlock(&mcu_uart_lock);
+
+	return false;
+}
+
+/*
+ * Run completions without mcu_lock held so that they can take their own
+ * locks and queue further frames.
+ */
+static void mcu_complete(void)
+{
+	Message reply;
+	mcu_done_t done;
+	int i, ret;
+
+	for (i = 0; i < MCU_REQUEST_SLOTS; i++) {
+		spin_lock(&mcu_lock);
+		if (mcu.slots[i].state != MCU_SLOT_DONE) {
+			spin_unlock(&mcu_lock);
+			continue;
+		}
+		done = mcu.slots[i].done;
+		ret = mcu.slots[i].ret;
+		sbi_memcpy(&reply, &mcu.slots[i].msg, sizeof(reply));
+		mcu.slots[i].state = MCU_SLOT_FREE;
+		spin_unlock(&mcu_lock);
+
+		done(ret, &reply);
+	}
+}
+
+static void mcu_poll_callback(struct sbi_timer_event *ev);
+
+static int mcu_poll_arm(void)
+{
+	if (mcu.ev.queued)
+		return 0;
+
+	mcu.ev.callback = mcu_poll_callback;
+	mcu.ev.deadline = sbi_timer_value() +
+		(u64)sbi_timer_get_device()->timer_freq * MCU_POLL_US / 1000000;
+	return sbi_timer_event_add(&mcu.ev);
+}
+
+static void mcu_poll_callback(struct sbi_timer_event *ev)
+{
+	spin_lock(&mcu_lock);
+	mcu_tx_pump();
+	mcu_rx_pump();
+	spin_unlock(&mcu_lock);
+
+	mcu_complete();
+
+	spin_lock(&mcu_lock);
+	if (mcu_busy())
+		mcu_poll_arm();
+	spin_unlock(&mcu_lock);
+}
+
+/*
+ * Queue a frame for the MCU. When done is set the frame is kept until the
+ * MCU replies with the same command type or the reply times out. Returns
+ * SBI_ENOSPC when all slots are busy.
+ */
+static int mcu_send(const Message *msg, mcu_done_t done)
+{
+	struct mcu_slot *slot = NULL;
+	int i;
+
+	spin_lock(&mcu_lock);
+	mcu_uart_init();
+
+	for (i = 0; i < MCU_REQUEST_SLOTS; i++) {
+		if (mcu.slots[i].state == MCU_SLOT_FREE) {
+			slot = &mcu.slots[i];
+			break;
+		}
+	}
+	if (!slot) {
+		spin_unlock(&mcu_lock);
+		return SBI_ENOSPC;
+	}
+
+	sbi_memcpy(&slot->msg, msg, sizeof(slot->msg));
+	slot->msg.header = MCU_FRAME_HEADER;
+	slot->msg.tail = MCU_FRAME_TAIL;
+	if (slot->msg.data_len < FRAME_DATA_MAX)
+		sbi_memset(&slot->msg.data[slot->msg.data_len], 0,
+			   FRAME_DATA_MAX - slot->msg.data_len);
+	slot->msg.checksum = mcu_frame_checksum(&slot->msg);
+	slot->done = done;
+	slot->state = MCU_SLOT_TX;
+
+	mcu.tx_ring[(mcu.tx_head + mcu.tx_count) % MCU_REQUEST_SLOTS] = i;
+	mcu.tx_count++;
+
+	if (mcu_poll_arm()) {
+		/* Without firmware timer events frames are sent synchronously */
+		slot->done = NULL;
+		while (mcu.tx_count)
+			mcu_tx_pump();
+	} else {
+		mcu_tx_pump();
+	}
+	spin_unlock(&mcu_lock);
 
 	return 0;
 }
 
+/* Busy-wait until all queued frames are on the wire, used before resets */
+static void mcu_flush(void)
+{
+	u64 deadline = sbi_timer_value() +
+		       mcu_ms_to_ticks(MCU_FLUSH_TIMEOUT_MS);
+	bool pending = true;
+
+	while (pending && sbi_timer_value() < deadline) {
+		spin_lock(&mcu_lock);
+		mcu_tx_pump();
+		mcu_rx_pump();
+		pending = mcu.tx_count != 0;
+		spin_unlock(&mcu_lock);
+
+		mcu_complete();
+	}
+}
+
 static int eic770x_core_shutdown(void)
 {
 	Message shutdown_reply = {
@@ -118,7 +398,8 @@ static int eic770x_core_shutdown(void)
 		.cmd_type = CMD_POWER_OFF,
 		.data_len = 0x0,
 	};
-	transmit_message(&shutdown_reply);
+	mcu_send(&shutdown_reply, NULL);
+	mcu_flush();
 	return 0;
 };
 
@@ -129,13 +410,468 @@ static int eic770x_cold_reset(void)
 		.cmd_type = CMD_RESTART,
 		.data_len = 0x0,
 	};
-	transmit_message(&shutdown_reply);
+	mcu_send(&shutdown_reply, NULL);
+	mcu_flush();
 	sbi_timer_mdelay(3000);
 	/*When it is not a DVB board, reboot can still be done, but there is no real power off/power on action at that time.*/
 	writel(EIC770X_SYS_RESET_VALUE, (volatile void *)EIC770X_SYS_RESET_ADDR);
 	return 0;
 };
 
+#ifdef CONFIG_PLATFORM_ESWIN_EIC7700_CPPC
+/*
+ * All cores of the EIC7700 share one clock and supply so the cluster runs
+ * at the highest performance level requested by any HART. Performance
+ * levels are expressed in MHz.
+ */
+struct eic770x_opp {
+	u32 freq_mhz;
+	u32 microvolt;
+};
+
+static const struct eic770x_opp eic770x_opps[] = {
+	{ 400, 800000 },
+	{ 600, 800000 },
+	{ 800, 800000 },
+	{ 1000, 800000 },
+	{ 1200, 800000 },
+	{ 1400, 800000 },
+};
+
+#define EIC770X_OPP_COUNT	array_size(eic770x_opps)
+#define EIC770X_PERF_LOWEST	eic770x_opps[0].freq_mhz
+#define EIC770X_PERF_HIGHEST	eic770x_opps[EIC770X_OPP_COUNT - 1].freq_mhz
+
+/* Requests arriving within this window are applied at once */
+#define EIC770X_CPPC_BATCH_US	1000
+
+/* Worst case time of one MCU message at the UART baudrate */
+#define EIC770X_CPPC_LATENCY_NS	25000000
+
+struct eic770x_cppc_hart {
+	u32 desired_perf;
+	u32 min_perf;
+	u32 max_perf;
+	bool enable;
+};
+
+static SBI_SCRATCH_DEFINE(struct eic770x_cppc_hart, eic770x_cppc_hart);
+
+static spinlock_t eic770x_cppc_lock = SPIN_LOCK_INITIALIZER;
+static struct sbi_timer_event eic770x_cppc_ev;
+/* Index of the operating point last sent to the MCU or -1 if none */
+static int eic770x_cppc_applied = -1;
+
+static u32 eic770x_cppc_hart_perf(const struct eic770x_cppc_hart *ch)
+{
+	u32 perf = ch->desired_perf;
+
+	if (perf < ch->min_perf)
+		perf = ch->min_perf;
+	if (perf > ch->max_perf)
+		perf = ch->max_perf;
+
+	return perf;
+}
+
+/* Lowest operating point satisfying all HARTs with CPPC enabled */
+static int eic770x_cppc_target_opp(void)
+{
+	struct eic770x_cppc_hart *ch;
+	struct sbi_scratch *scratch;
+	u32 i, perf = 0;
+
+	for (i = 0; i <= sbi_scratch_last_hartindex(); i++) {
+		scratch = sbi_hartindex_to_scratch(i);
+		if (!scratch)
+			continue;
+
+		ch = sbi_scratch_var_ptr(scratch, eic770x_cppc_hart);
+		if (!ch->enable)
+			continue;
+		if (perf < eic770x_cppc_hart_perf(ch))
+			perf = eic770x_cppc_hart_perf(ch);
+	}
+
+	/* Without any request the cluster stays at the nominal level */
+	if (!perf)
+		return EIC770X_OPP_COUNT - 1;
+
+	for (i = 0; i < EIC770X_OPP_COUNT - 1; i++) {
+		if (perf <= eic770x_opps[i].freq_mhz)
+			break;
+	}
+
+	return i;
+}
+
+/* Send the operating point again on the next request if the MCU failed */
+static void eic770x_cppc_done(int ret, const Message *reply)
+{
+	if (!ret && !reply->cmd_result)
+		return;
+
+	spin_lock(&eic770x_cppc_lock);
+	eic770x_cppc_applied = -1;
+	spin_unlock(&eic770x_cppc_lock);
+}
+
+static void eic770x_cppc_apply(void)
+{
+	const struct eic770x_opp *opp;
+	Message msg = {
+		.msg_type = MSG_REQUEST,
+		.cmd_type = CMD_CPU_OPP,
+		.data_len = 6,
+	};
+	int target = eic770x_cppc_target_opp();
+
+	if (target == eic770x_cppc_applied)
+		return;
+
+	opp = &eic770x_opps[target];
+	msg.data[0] = opp->freq_mhz & 0xff;
+	msg.data[1] = (opp->freq_mhz >> 8) & 0xff;
+	msg.data[2] = opp->microvolt & 0xff;
+	msg.data[3] = (opp->microvolt >> 8) & 0xff;
+	msg.data[4] = (opp->microvolt >> 16) & 0xff;
+	msg.data[5] = (opp->microvolt >> 24) & 0xff;
+	if (mcu_send(&msg, eic770x_cppc_done))
+		return;
+
+	eic770x_cppc_applied = target;
+}
+
+static void eic770x_cppc_event_callback(struct sbi_timer_event *ev)
+{
+	spin_lock(&eic770x_cppc_lock);
+	eic770x_cppc_apply();
+	spin_unlock(&eic770x_cppc_lock);
+}
+
+/*
+ * Sending a message to the MCU takes milliseconds so the first change
+ * arms a timer event and later changes within the window are merged
+ * into the same message.
+ */
+static void eic770x_cppc_update(void)
+{
+	const struct sbi_timer_device *tdev = sbi_timer_get_device();
+
+	spin_lock(&eic770x_cppc_lock);
+	if (!eic770x_cppc_ev.queued) {
+		eic770x_cppc_ev.callback = eic770x_cppc_event_callback;
+		eic770x_cppc_ev.deadline = sbi_timer_value() +
+			(u64)tdev->timer_freq * EIC770X_CPPC_BATCH_US / 1000000;
+		if (sbi_timer_event_add(&eic770x_cppc_ev))
+			eic770x_cppc_apply();
+	}
+	spin_unlock(&eic770x_cppc_lock);
+}
+
+static int eic770x_cppc_probe(unsigned long reg)
+{
+	switch (reg) {
+	case SBI_CPPC_HIGHEST_PERF:
+	case SBI_CPPC_NOMINAL_PERF:
+	case SBI_CPPC_LOW_NON_LINEAR_PERF:
+	case SBI_CPPC_LOWEST_PERF:
+	case SBI_CPPC_GUARANTEED_PERF:
+	case SBI_CPPC_DESIRED_PERF:
+	case SBI_CPPC_MIN_PERF:
+	case SBI_CPPC_MAX_PERF:
+	case SBI_CPPC_REFERENCE_PERF:
+	case SBI_CPPC_LOWEST_FREQ:
+	case SBI_CPPC_NOMINAL_FREQ:
+	case SBI_CPPC_ENABLE:
+	case SBI_CPPC_TRANSITION_LATENCY:
+		return 32;
+	case SBI_CPPC_REFERENCE_CTR:
+	case SBI_CPPC_DELIVERED_CTR:
+		return 64;
+	}
+
+	return 0;
+}
+
+static int eic770x_cppc_read(unsigned long reg, uint64_t *val)
+{
+	struct eic770x_cppc_hart *ch =
+			sbi_scratch_thishart_var_ptr(eic770x_cppc_hart);
+	const struct sbi_timer_device *tdev = sbi_timer_get_device();
+
+	switch (reg) {
+	case SBI_CPPC_HIGHEST_PERF:
+	case SBI_CPPC_NOMINAL_PERF:
+	case SBI_CPPC_GUARANTEED_PERF:
+	case SBI_CPPC_NOMINAL_FREQ:
+		*val = EIC770X_PERF_HIGHEST;
+		break;
+	case SBI_CPPC_LOW_NON_LINEAR_PERF:
+	case SBI_CPPC_LOWEST_PERF:
+	case SBI_CPPC_LOWEST_FREQ:
+		*val = EIC770X_PERF_LOWEST;
+		break;
+	case SBI_CPPC_DESIRED_PERF:
+		*val = ch->desired_perf;
+		break;
+	case SBI_CPPC_MIN_PERF:
+		*val = ch->min_perf;
+		break;
+	case SBI_CPPC_MAX_PERF:
+		*val = ch->max_perf;
+		break;
+	case SBI_CPPC_ENABLE:
+		*val = ch->enable;
+		break;
+	case SBI_CPPC_TRANSITION_LATENCY:
+		*val = EIC770X_CPPC_LATENCY_NS;
+		break;
+	case SBI_CPPC_REFERENCE_PERF:
+		/* The reference counter runs at the timer frequency */
+		*val = tdev->timer_freq / 1000000;
+		break;
+	case SBI_CPPC_REFERENCE_CTR:
+		*val = sbi_timer_value();
+		break;
+	case SBI_CPPC_DELIVERED_CTR:
+		*val = csr_read(CSR_MCYCLE);
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	}
+
+	return 0;
+}
+
+static int eic770x_cppc_write(unsigned long reg, uint64_t val)
+{
+	struct eic770x_cppc_hart *ch =
+			sbi_scratch_thishart_var_ptr(eic770x_cppc_hart);
+	u32 *field;
+
+	switch (reg) {
+	case SBI_CPPC_DESIRED_PERF:
+		field = &ch->desired_perf;
+		break;
+	case SBI_CPPC_MIN_PERF:
+		field = &ch->min_perf;
+		break;
+	case SBI_CPPC_MAX_PERF:
+		field = &ch->max_perf;
+		break;
+	case SBI_CPPC_ENABLE:
+		if (val > 1)
+			return SBI_EINVAL;
+		if (ch->enable == !!val)
+			return 0;
+		ch->enable = val;
+		eic770x_cppc_update();
+		return 0;
+	default:
+		return SBI_ENOTSUPP;
+	}
+
+	if (val < EIC770X_PERF_LOWEST || val > EIC770X_PERF_HIGHEST)
+		return SBI_EINVAL;
+
+	/* Identical requests don't touch the MCU */
+	if (*field == val)
+		return 0;
+
+	*field = val;
+	if (ch->enable)
+		eic770x_cppc_update();
+
+	return 0;
+}
+
+static struct sbi_cppc_device eic770x_cppc = {
+	.name = "eswin_eic770x_cppc",
+	.cppc_probe = eic770x_cppc_probe,
+	.cppc_read = eic770x_cppc_read,
+	.cppc_write = eic770x_cppc_write,
+};
+
+static void eic770x_cppc_init(void)
+{
+	struct eic770x_cppc_hart *ch;
+	struct sbi_scratch *scratch;
+	u32 i;
+
+	for (i = 0; i <= sbi_scratch_last_hartindex(); i++) {
+		scratch = sbi_hartindex_to_scratch(i);
+		if (!scratch)
+			continue;
+
+		ch = sbi_scratch_var_ptr(scratch, eic770x_cppc_hart);
+		ch->desired_perf = EIC770X_PERF_HIGHEST;
+		ch->min_perf = EIC770X_PERF_LOWEST;
+		ch->max_perf = EIC770X_PERF_HIGHEST;
+	}
+
+	sbi_cppc_set_device(&eic770x_cppc);
+}
+#endif
+
+#ifdef CONFIG_PLATFORM_ESWIN_EIC7700_UNCORE_PMU
+/*
+ * The cache, memory controller and die-to-die link counters of the SoC
+ * are free-running 64-bit MMIO counters, one per "reg" entry of the
+ * uncore PMU node. S-mode counts them as SBI_PMU_FW_PLATFORM events with
+ * the event data giving the index of the counter. Each firmware counter
+ * of a HART accumulates the delta of the uncore counter since it was
+ * started, so the counters can be read together with a PMU snapshot.
+ */
+#define EIC770X_UNCORE_MAX		16
+
+static volatile u64 *eic770x_uncore_ctrs[EIC770X_UNCORE_MAX];
+static u32 eic770x_uncore_count;
+
+struct eic770x_uncore_hart {
+	u64 base[SBI_PMU_FW_CTR_MAX];
+	u64 value[SBI_PMU_FW_CTR_MAX];
+	u8 event[SBI_PMU_FW_CTR_MAX];
+	unsigned long started;
+};
+
+static SBI_SCRATCH_DEFINE(struct eic770x_uncore_hart, eic770x_uncore_hart);
+
+static struct eic770x_uncore_hart *eic770x_uncore_thishart(void)
+{
+	return sbi_scratch_var_ptr(sbi_scratch_thishart_ptr(),
+				   eic770x_uncore_hart);
+}
+
+static int eic770x_uncore_validate(uint32_t hartid, uint64_t event_data)
+{
+	if (event_data >= eic770x_uncore_count)
+		return SBI_EINVAL;
+
+	return SBI_PMU_EVENT_TYPE_FW;
+}
+
+static bool eic770x_uncore_match(uint32_t hartid, uint32_t counter_index,
+				 uint64_t event_data)
+{
+	/* Any firmware counter can count any uncore counter */
+	return event_data < eic770x_uncore_count;
+}
+
+static int eic770x_uncore_width(void)
+{
+	return 64;
+}
+
+static uint64_t eic770x_uncore_read(uint32_t hartid, uint32_t counter_index)
+{
+	struct eic770x_uncore_hart *uh = eic770x_uncore_thishart();
+	u32 i = counter_index;
+
+	if (!(uh->started & BIT(i)))
+		return uh->value[i];
+
+	return uh->value[i] +
+	       (readq(eic770x_uncore_ctrs[uh->event[i]]) - uh->base[i]);
+}
+
+static void eic770x_uncore_write(uint32_t hartid, uint32_t counter_index,
+				 uint64_t value)
+{
+	struct eic770x_uncore_hart *uh = eic770x_uncore_thishart();
+	u32 i = counter_index;
+
+	uh->value[i] = value;
+	if (uh->started & BIT(i))
+		uh->base[i] = readq(eic770x_uncore_ctrs[uh->event[i]]);
+}
+
+static int eic770x_uncore_start(uint32_t hartid, uint32_t counter_index,
+				uint64_t event_data)
+{
+	struct eic770x_uncore_hart *uh = eic770x_uncore_thishart();
+	u32 i = counter_index;
+
+	if (event_data >= eic770x_uncore_count)
+		return SBI_EINVAL;
+
+	uh->event[i] = event_data;
+	uh->base[i] = readq(eic770x_uncore_ctrs[event_data]);
+	uh->started |= BIT(i);
+
+	return 0;
+}
+
+static int eic770x_uncore_stop(uint32_t hartid, uint32_t counter_index)
+{
+	struct eic770x_uncore_hart *uh = eic770x_uncore_thishart();
+	u32 i = counter_index;
+
+	if (!(uh->started & BIT(i)))
+		return 0;
+
+	uh->value[i] += readq(eic770x_uncore_ctrs[uh->event[i]]) -
+			uh->base[i];
+	uh->started &= ~BIT(i);
+
+	return 0;
+}
+
+static const struct sbi_pmu_device eic770x_uncore_pmu = {
+	.name = "eic770x_uncore_pmu",
+	.fw_event_validate_encoding = eic770x_uncore_validate,
+	.fw_counter_match_encoding = eic770x_uncore_match,
+	.fw_counter_width = eic770x_uncore_width,
+	.fw_counter_read_value = eic770x_uncore_read,
+	.fw_counter_write_value = eic770x_uncore_write,
+	.fw_counter_start = eic770x_uncore_start,
+	.fw_counter_stop = eic770x_uncore_stop,
+};
+
+static int eic770x_pmu_init(const struct fdt_match *match)
+{
+	struct sbi_domain_memregion reg;
+	void *fdt = fdt_get_address();
+	uint64_t addr, size;
+	int nodeoff, rc;
+	u32 i;
+
+	if (eic770x_uncore_count)
+		goto done;
+
+	nodeoff = fdt_node_offset_by_compatible(fdt, -1,
+						"eswin,eic7700-uncore-pmu");
+	if (nodeoff < 0 || !fdt_node_is_enabled(fdt, nodeoff))
+		return 0;
+
+	for (i = 0; i < EIC770X_UNCORE_MAX; i++) {
+		rc = fdt_get_node_addr_size(fdt, nodeoff, i, &addr, &size);
+		if (rc)
+			break;
+		if ((addr & 7) || size < sizeof(u64))
+			return SBI_EINVAL;
+
+		sbi_domain_memregion_init(addr, size,
+					  (SBI_DOMAIN_MEMREGION_MMIO |
+					   SBI_DOMAIN_MEMREGION_M_READABLE),
+					  &reg);
+		rc = sbi_domain_root_add_memregion(&reg);
+		if (rc)
+			return rc;
+
+		eic770x_uncore_ctrs[i] = (volatile u64 *)(unsigned long)addr;
+	}
+	eic770x_uncore_count = i;
+	if (!eic770x_uncore_count)
+		return 0;
+
+done:
+	sbi_pmu_set_device(&eic770x_uncore_pmu);
+
+	return 0;
+}
+#endif
+
 static int eic770x_core_reset(void)
 {
 	writel(EIC770X_SYS_RESET_VALUE, (volatile void *)EIC770X_SYS_RESET_ADDR);
@@ -216,8 +952,85 @@ static int eic770x_nascent_init(void)
 }
 
 
+/* Platform FWFT feature selecting the hardware prefetcher profile */
+#define EIC770X_FWFT_PREFETCH_PROFILE	SBI_FWFT_LOCAL_PLATFORM_START
+
+enum eic770x_prefetch_profile {
+	EIC770X_PREFETCH_DEFAULT = 0,
+	EIC770X_PREFETCH_STREAMING,
+	EIC770X_PREFETCH_LATENCY,
+	EIC770X_PREFETCH_PROFILE_MAX,
+};
+
+/* Values of the prefetcher CSRs 0x7c3 and 0x7c4 for each profile */
+static const unsigned long eic770x_prefetch_profiles[][2] = {
+	[EIC770X_PREFETCH_DEFAULT]	= { 0x5c1be649UL, 0x929FUL },
+	/* Boot time settings with deeper prefetch for sequential access */
+	[EIC770X_PREFETCH_STREAMING]	= { 0x104095C1BE241UL, 0x38c84eUL },
+	/* Hardware prefetchers off for latency sensitive workloads */
+	[EIC770X_PREFETCH_LATENCY]	= { 0x0UL, 0x0UL },
+};
+
+struct eic770x_prefetch_hart {
+	unsigned long profile;
+	bool locked;
+};
+
+static SBI_SCRATCH_DEFINE(struct eic770x_prefetch_hart, eic770x_prefetch_hart);
+
+static void eic770x_prefetch_apply(unsigned long profile)
+{
+	unsigned long hwpf;
+
+	hwpf = eic770x_prefetch_profiles[profile][0];
+	__asm__ volatile("csrw 0x7c3 , %0" : : "r"(hwpf));
+
+	hwpf = eic770x_prefetch_profiles[profile][1];
+	__asm__ volatile("csrw 0x7c4 , %0" : : "r"(hwpf));
+}
+
+static int eic770x_fwft_set(u32 feature, unsigned long value,
+			    unsigned long flags, const struct fdt_match *match)
+{
+	struct eic770x_prefetch_hart *ph =
+			sbi_scratch_thishart_var_ptr(eic770x_prefetch_hart);
+
+	if (feature != EIC770X_FWFT_PREFETCH_PROFILE)
+		return SBI_EDENIED;
+
+	if (ph->locked)
+		return SBI_EDENIED;
+
+	if (value >= EIC770X_PREFETCH_PROFILE_MAX)
+		return SBI_EINVAL;
+
+	if (ph->profile != value) {
+		eic770x_prefetch_apply(value);
+		ph->profile = value;
+	}
+	ph->locked = flags & SBI_FWFT_SET_FLAG_LOCK;
+
+	return 0;
+}
+
+static int eic770x_fwft_get(u32 feature, unsigned long *value,
+			    const struct fdt_match *match)
+{
+	struct eic770x_prefetch_hart *ph =
+			sbi_scratch_thishart_var_ptr(eic770x_prefetch_hart);
+
+	if (feature != EIC770X_FWFT_PREFETCH_PROFILE)
+		return SBI_EDENIED;
+
+	*value = ph->profile;
+
+	return 0;
+}
+
 static void init_fcsr(void)
 {
+	struct eic770x_prefetch_hart *ph =
+			sbi_scratch_thishart_var_ptr(eic770x_prefetch_hart);
 	unsigned long hwpf;
 
 	/* enable speculative icache refill */
@@ -227,11 +1040,8 @@ static void init_fcsr(void)
 	hwpf = 0x80UL;	// [7]	Force Noisy Evict to send release message from any valid coherence permission state
 	__asm__ volatile("csrw 0x7c2 , %0" : : "r"(hwpf));
 
-	hwpf = 0x5c1be649UL;
-	__asm__ volatile("csrw 0x7c3 , %0" : : "r"(hwpf));
-
-	hwpf = 0x929FUL;
-	__asm__ volatile("csrw 0x7c4 , %0" : : "r"(hwpf));
+	/* The profile selected by S-mode survives suspend */
+	eic770x_prefetch_apply(ph->profile);
 }
 
 #ifndef BR2_CHIPLET_2
@@ -275,6 +1085,9 @@ static int eic770x_early_init(bool cold_boot, const struct fdt_match *match)
 	struct sbi_domain_memregion reg;
 	if (cold_boot) {
 		sbi_system_reset_add_device(&eic770x_reset);
+#ifdef CONFIG_PLATFORM_ESWIN_EIC7700_CPPC
+		eic770x_cppc_init();
+#endif
 
 #if defined(BR2_CHIPLET_1_DIE0_AVAILABLE) && defined(BR2_CHIPLET_1)
 		sbi_domain_memregion_init(0x2000000UL, 0xbfffUL, (SBI_DOMAIN_MEMREGION_MMIO |
@@ -313,7 +1126,20 @@ static int eic770x_early_init(bool cold_boot, const struct fdt_match *match)
 static int eic770x_final_init(int clod_boot, const struct fdt_match *match)
 {
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct eic770x_prefetch_hart *ph =
+			sbi_scratch_var_ptr(scratch, eic770x_prefetch_hart);
+
+	/* FWFT features are reset whenever a HART is started */
+	ph->profile = EIC770X_PREFETCH_DEFAULT;
+	ph->locked = false;
 	sbi_hart_blocker_fscr_configure(scratch);
+
+#ifdef BR2_CHIPLET_2
+	/* The MTIME of both dies drift apart so resync them periodically */
+	if (clod_boot)
+		aclint_mtimer_sync_start(EIC770X_MTIME_SYNC_PERIOD_MS);
+#endif
+
 	return 0;
 }
 
@@ -340,4 +1166,9 @@ const struct platform_override eic770x = {
 	.early_init		= eic770x_early_init,
 	.final_init		= eic770x_final_init,
 	.resume_finish		= eic770x_resume_finish,
+	.fwft_set		= eic770x_fwft_set,
+	.fwft_get		= eic770x_fwft_get,
+#ifdef CONFIG_PLATFORM_ESWIN_EIC7700_UNCORE_PMU
+	.pmu_init		= eic770x_pmu_init,
+#endif
 };
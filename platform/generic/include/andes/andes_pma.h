@@ -44,7 +44,14 @@ struct andes_pma_region {
 	bool dma_default;
 };
 
+/**
+ * Compute the PMA CSR image of the regions, program it on current HART
+ * and add the reserved memory DT nodes. Called once by the cold boot HART.
+ */
 int andes_pma_setup_regions(const struct andes_pma_region *pma_regions,
 			    unsigned int pma_regions_count);
 
+/** Program the PMA CSR image computed at cold boot on current HART */
+void andes_pma_apply(void);
+
 #endif /* _ANDES_PMA_H_ */
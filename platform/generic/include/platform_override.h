@@ -36,6 +36,10 @@ struct platform_override {
 				   struct sbi_trap_regs *regs,
 				   struct sbi_ecall_return *out,
 				   const struct fdt_match *match);
+	int (*fwft_set)(u32 feature, unsigned long value, unsigned long flags,
+			const struct fdt_match *match);
+	int (*fwft_get)(u32 feature, unsigned long *value,
+			const struct fdt_match *match);
 };
 
 #endif
@@ -0,0 +1,15 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SIFIVE_CCACHE_H__
+#define __SIFIVE_CCACHE_H__
+
+#ifdef CONFIG_SIFIVE_CCACHE
+/** Register the composable cache found in the DT as cache device */
+int sifive_ccache_init(void *fdt);
+#else
+static inline int sifive_ccache_init(void *fdt) { return 0; }
+#endif
+
+#endif
@@ -0,0 +1,11 @@
+
+#ifndef __RISCV_THEAD_C9XX_CACHE_H____
+#define __RISCV_THEAD_C9XX_CACHE_H____
+
+#ifdef CONFIG_THEAD_C9XX_CACHE
+void thead_c9xx_register_cache_device(void);
+#else
+static inline void thead_c9xx_register_cache_device(void) { }
+#endif
+
+#endif // __RISCV_THEAD_C9XX_CACHE_H____
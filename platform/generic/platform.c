@@ -9,10 +9,14 @@
 
 #include <libfdt.h>
 #include <platform_override.h>
+#include <sbi/fw_dynamic.h>
 #include <sbi/riscv_asm.h>
 #include <sbi/sbi_bitops.h>
+#include <sbi/sbi_domain.h>
 #include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_heap.h>
+#include <sbi/sbi_ipi.h>
+#include <sbi/sbi_math.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_string.h>
 #include <sbi/sbi_system.h>
@@ -61,7 +65,7 @@ static u32 fw_platform_calculate_heap_size(u32 hart_count)
 {
 	u32 heap_size;
 
-	heap_size = SBI_PLATFORM_DEFAULT_HEAP_SIZE(hart_count);
+	heap_size = sbi_heap_size_estimate(hart_count);
 
 	/* For TLB fifo */
 	heap_size += SBI_TLB_INFO_SIZE * (hart_count) * (hart_count);
@@ -69,11 +73,19 @@ static u32 fw_platform_calculate_heap_size(u32 hart_count)
 	return BIT_ALIGN(heap_size, HEAP_BASE_ALIGN);
 }
 
+#ifdef CONFIG_PLATFORM_GENERIC_SPECIALIZED
+/* A specialized build only knows the HARTs of its SoC */
+#define GENERIC_HART_MAX	CONFIG_PLATFORM_GENERIC_SPECIALIZED_HART_COUNT
+#else
+#define GENERIC_HART_MAX	SBI_HARTMASK_MAX_BITS
+#endif
+
 extern struct sbi_platform platform;
 static bool platform_has_mlevel_imsic = false;
-static u32 generic_hart_index2id[SBI_HARTMASK_MAX_BITS] = { 0 };
+static u32 generic_hart_index2id[GENERIC_HART_MAX] = { 0 };
 
 static DECLARE_BITMAP(generic_coldboot_harts, SBI_HARTMASK_MAX_BITS);
+static u32 generic_coldboot_hart = -1U;
 
 /*
  * The fw_platform_coldboot_harts_init() function is called by fw_platform_init() 
@@ -97,6 +109,15 @@ static void fw_platform_coldboot_harts_init(void *fdt)
 	if (config_offset < 0)
 		goto default_config;
 
+	val = fdt_getprop(fdt, config_offset, "cold-boot-hart", &len);
+	if (val && len >= sizeof(u32)) {
+		cpu_offset = fdt_node_offset_by_phandle(fdt,
+							fdt32_to_cpu(*val));
+		if (cpu_offset >= 0 && fdt_node_is_enabled(fdt, cpu_offset) &&
+		    !fdt_parse_hart_id(fdt, cpu_offset, &val32))
+			generic_coldboot_hart = val32;
+	}
+
 	val = fdt_getprop(fdt, config_offset, "cold-boot-harts", &len);
 	len = len / sizeof(u32);
 	if (val && len) {
@@ -128,6 +149,407 @@ default_config:
 	return;
 }
 
+/*
+ * Use the platform info passed by the previous booting stage instead of
+ * parsing the HART list, the cold boot HARTs and the M-level IMSIC from
+ * the DT. Returns false if there is no valid platform info in which case
+ * the DT is parsed as usual.
+ */
+static bool fw_platform_prev_info_init(
+				const struct fw_dynamic_platform_info *info)
+{
+	u32 i, j, hartid, count;
+
+	if (!info ||
+	    info->magic != FW_DYNAMIC_PLATFORM_INFO_MAGIC_VALUE ||
+	    !info->version ||
+	    info->version > FW_DYNAMIC_PLATFORM_INFO_VERSION_MAX ||
+	    !info->hart_count || GENERIC_HART_MAX < info->hart_count ||
+	    SBI_HARTMASK_MAX_BITS < info->coldboot_hart_count)
+		return false;
+
+	count = info->hart_count + info->coldboot_hart_count;
+	if (info->size < sizeof(*info) + count * sizeof(info->hart_ids[0]))
+		return false;
+
+	for (i = 0; i < info->hart_count; i++) {
+		if (SBI_HARTMASK_MAX_BITS <= info->hart_ids[i])
+			return false;
+		generic_hart_index2id[i] = info->hart_ids[i];
+	}
+
+	bitmap_zero(generic_coldboot_harts, SBI_HARTMASK_MAX_BITS);
+	if (!info->coldboot_hart_count)
+		bitmap_fill(generic_coldboot_harts, SBI_HARTMASK_MAX_BITS);
+	for (i = info->hart_count; i < count; i++) {
+		hartid = info->hart_ids[i];
+		for (j = 0; j < info->hart_count; j++) {
+			if (hartid == generic_hart_index2id[j])
+				bitmap_set(generic_coldboot_harts, j, 1);
+		}
+	}
+
+	platform.hart_count = info->hart_count;
+	platform.heap_size = fw_platform_calculate_heap_size(info->hart_count);
+	platform_has_mlevel_imsic =
+		!!(info->flags & FW_DYNAMIC_PLATFORM_INFO_FLAG_MLEVEL_IMSIC);
+
+	return true;
+}
+
+#ifdef CONFIG_PLATFORM_GENERIC_BOOT_SNAPSHOT
+/* Expected value of snapshot magic ('OSBS' ascii string in hex) */
+#define GENERIC_BOOT_SNAPSHOT_MAGIC	0x5342534f
+
+/**
+ * Header of the boot snapshot
+ *
+ * The header is followed by a struct fw_dynamic_platform_info which
+ * holds the platform details parsed from the DT on the first cold boot.
+ * The snapshot is only used when the DT passed on a later cold boot has
+ * the same size and checksum.
+ */
+struct generic_boot_snapshot {
+	u32 magic;
+	u32 fdt_size;
+	u32 fdt_sum;
+	u32 info_sum;
+};
+
+static u32 generic_checksum(const void *ptr, u32 size)
+{
+	const u8 *p = ptr;
+	u32 i, w, sum = 2166136261U;
+
+	for (i = 0; i + 4 <= size; i += 4) {
+		w = p[i] | (p[i + 1] << 8) | (p[i + 2] << 16) |
+		    ((u32)p[i + 3] << 24);
+		sum = (sum ^ w) * 16777619U;
+	}
+	for (; i < size; i++)
+		sum = (sum ^ p[i]) * 16777619U;
+
+	return sum;
+}
+
+/*
+ * Find the memory region preserved across warm resets which is given by
+ * the "boot-snapshot" DT property of the OpenSBI configuration DT node.
+ */
+static struct generic_boot_snapshot *fw_platform_snapshot_region(void *fdt,
+								  u32 *size)
+{
+	int chosen_offset, config_offset, len;
+	const fdt32_t *val;
+	u64 addr, sz;
+
+	chosen_offset = fdt_path_offset(fdt, "/chosen");
+	if (chosen_offset < 0)
+		return NULL;
+
+	config_offset = fdt_node_offset_by_compatible(fdt, chosen_offset,
+						      "opensbi,config");
+	if (config_offset < 0)
+		return NULL;
+
+	val = fdt_getprop(fdt, config_offset, "boot-snapshot", &len);
+	if (!val || len != 4 * sizeof(*val))
+		return NULL;
+
+	addr = ((u64)fdt32_to_cpu(val[0]) << 32) | fdt32_to_cpu(val[1]);
+	sz = ((u64)fdt32_to_cpu(val[2]) << 32) | fdt32_to_cpu(val[3]);
+	if (!addr || (addr & (sizeof(u32) - 1)) || (unsigned long)addr != addr ||
+	    sz < sizeof(struct generic_boot_snapshot) +
+		 sizeof(struct fw_dynamic_platform_info) ||
+	    sz > -1U)
+		return NULL;
+
+	*size = sz;
+	return (void *)(unsigned long)addr;
+}
+
+static bool fw_platform_snapshot_restore(void *fdt)
+{
+	struct generic_boot_snapshot *snap;
+	const struct fw_dynamic_platform_info *info;
+	u32 size;
+
+	snap = fw_platform_snapshot_region(fdt, &size);
+	if (!snap || snap->magic != GENERIC_BOOT_SNAPSHOT_MAGIC ||
+	    snap->fdt_size != fdt_totalsize(fdt))
+		return false;
+
+	info = (const void *)(snap + 1);
+	if (info->size > size - sizeof(*snap) ||
+	    snap->info_sum != generic_checksum(info, info->size) ||
+	    snap->fdt_sum != generic_checksum(fdt, fdt_totalsize(fdt)))
+		return false;
+
+	return fw_platform_prev_info_init(info);
+}
+
+static void fw_platform_snapshot_save(void *fdt)
+{
+	struct generic_boot_snapshot *snap;
+	struct fw_dynamic_platform_info *info;
+	u32 i, count = 0, size;
+
+	snap = fw_platform_snapshot_region(fdt, &size);
+	if (!snap)
+		return;
+
+	info = (void *)(snap + 1);
+	size -= sizeof(*snap);
+	if (size < sizeof(*info) +
+		   2 * platform.hart_count * sizeof(info->hart_ids[0]))
+		return;
+
+	snap->magic = 0;
+	info->magic = FW_DYNAMIC_PLATFORM_INFO_MAGIC_VALUE;
+	info->version = FW_DYNAMIC_PLATFORM_INFO_VERSION_1;
+	info->flags = platform_has_mlevel_imsic ?
+		      FW_DYNAMIC_PLATFORM_INFO_FLAG_MLEVEL_IMSIC : 0;
+	info->hart_count = platform.hart_count;
+	for (i = 0; i < platform.hart_count; i++)
+		info->hart_ids[i] = generic_hart_index2id[i];
+	for (i = 0; i < platform.hart_count; i++) {
+		if (bitmap_test(generic_coldboot_harts, i))
+			info->hart_ids[platform.hart_count + count++] =
+						generic_hart_index2id[i];
+	}
+	/* All HARTs allowed is encoded as no cold boot HART */
+	info->coldboot_hart_count = (count == platform.hart_count) ? 0 : count;
+	info->size = sizeof(*info) + (platform.hart_count +
+		     info->coldboot_hart_count) * sizeof(info->hart_ids[0]);
+
+	snap->fdt_size = fdt_totalsize(fdt);
+	snap->fdt_sum = generic_checksum(fdt, snap->fdt_size);
+	snap->info_sum = generic_checksum(info, info->size);
+	snap->magic = GENERIC_BOOT_SNAPSHOT_MAGIC;
+}
+#else
+static bool fw_platform_snapshot_restore(void *fdt) { return false; }
+static void fw_platform_snapshot_save(void *fdt) { }
+#endif
+
+/*
+ * Override the per-HART stack and scratch space sizes with the DT
+ * properties "hart-stack-size" and "hart-scratch-size" of the OpenSBI
+ * configuration DT node. Both must be multiples of SBI_SCRATCH_SIZE and
+ * the stack must have room left after the scratch space.
+ */
+static void fw_platform_hart_sizes_init(void *fdt)
+{
+	u32 stack_size = platform.hart_stack_size, scratch_size = 0;
+	int chosen_offset, config_offset, len;
+	const fdt32_t *val;
+
+	chosen_offset = fdt_path_offset(fdt, "/chosen");
+	if (chosen_offset < 0)
+		return;
+
+	config_offset = fdt_node_offset_by_compatible(fdt, chosen_offset,
+						      "opensbi,config");
+	if (config_offset < 0)
+		return;
+
+	val = fdt_getprop(fdt, config_offset, "hart-stack-size", &len);
+	if (val && len >= sizeof(*val))
+		stack_size = fdt32_to_cpu(*val);
+
+	val = fdt_getprop(fdt, config_offset, "hart-scratch-size", &len);
+	if (val && len >= sizeof(*val))
+		scratch_size = fdt32_to_cpu(*val);
+
+	if ((stack_size & (SBI_SCRATCH_SIZE - 1)) ||
+	    (scratch_size & (SBI_SCRATCH_SIZE - 1)))
+		return;
+	if (stack_size <= (scratch_size ? scratch_size : SBI_SCRATCH_SIZE))
+		return;
+
+	platform.hart_stack_size = stack_size;
+	platform.hart_scratch_size = scratch_size;
+}
+
+/*
+ * Per-HART heap data is kept on separate cache lines using the largest
+ * "riscv,cbom-block-size" DT property of the CPU DT nodes.
+ */
+static void fw_platform_cacheline_init(void *fdt)
+{
+	int cpus_offset, cpu_offset, len;
+	const fdt32_t *val;
+
+	cpus_offset = fdt_path_offset(fdt, "/cpus");
+	if (cpus_offset < 0)
+		return;
+
+	fdt_for_each_subnode(cpu_offset, fdt, cpus_offset) {
+		val = fdt_getprop(fdt, cpu_offset, "riscv,cbom-block-size",
+				  &len);
+		if (val && len >= sizeof(*val))
+			sbi_heap_set_cacheline_size(fdt32_to_cpu(*val));
+	}
+}
+
+#ifdef CONFIG_PLATFORM_GENERIC_NUMA_STACKS
+#define GENERIC_NUMA_NODES_MAX		8
+
+static unsigned long generic_hart_index2stack[GENERIC_HART_MAX];
+
+/* Memory holding the HART stacks of each NUMA node */
+static struct {
+	unsigned long base;
+	unsigned long size;
+} generic_numa_stacks[GENERIC_NUMA_NODES_MAX];
+
+static int fw_platform_numa_node_id(void *fdt, int nodeoff)
+{
+	const fdt32_t *val;
+	int len;
+	u32 id;
+
+	val = fdt_getprop(fdt, nodeoff, "numa-node-id", &len);
+	if (!val || len < sizeof(*val))
+		return -1;
+
+	id = fdt32_to_cpu(*val);
+	return (id < GENERIC_NUMA_NODES_MAX) ? id : -1;
+}
+
+static int fw_platform_next_memory(void *fdt, int offset)
+{
+	return fdt_node_offset_by_prop_value(fdt, offset, "device_type",
+					     "memory", sizeof("memory"));
+}
+
+static int fw_platform_hart_numa_node(void *fdt, int cpu_offset,
+				      u32 *hart_index)
+{
+	u32 i, hartid;
+
+	if (fdt_parse_hart_id(fdt, cpu_offset, &hartid))
+		return -1;
+
+	for (i = 0; i < platform.hart_count; i++) {
+		if (generic_hart_index2id[i] == hartid) {
+			*hart_index = i;
+			return fw_platform_numa_node_id(fdt, cpu_offset);
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Carve the stacks of a NUMA node from the top of the first memory DT
+ * node of that NUMA node. The NUMA node of the firmware keeps using the
+ * stacks placed right after the firmware.
+ */
+static void fw_platform_numa_stacks_place(void *fdt, int node, u32 nharts)
+{
+	unsigned long size, base;
+	uint64_t addr, msize;
+	int offset;
+
+	size = 1UL << log2roundup(nharts * platform.hart_stack_size);
+
+	for (offset = fw_platform_next_memory(fdt, -1); offset >= 0;
+	     offset = fw_platform_next_memory(fdt, offset)) {
+		if (fw_platform_numa_node_id(fdt, offset) != node)
+			continue;
+		if (fdt_get_node_addr_size(fdt, offset, 0, &addr, &msize))
+			continue;
+		if (msize < size || (addr + msize - 1) > -1UL)
+			continue;
+
+		base = (addr + msize - size) & ~(size - 1);
+		if (base < addr)
+			continue;
+
+		generic_numa_stacks[node].base = base;
+		generic_numa_stacks[node].size = size;
+		return;
+	}
+}
+
+static void fw_platform_numa_stacks_init(void *fdt)
+{
+	u32 nharts[GENERIC_NUMA_NODES_MAX] = { 0 };
+	unsigned long fw_addr = (unsigned long)&platform;
+	int cpus_offset, cpu_offset, offset, node, fw_node = -1;
+	uint64_t addr, size;
+	bool placed = false;
+	u32 hart_index;
+
+	for (offset = fw_platform_next_memory(fdt, -1); offset >= 0;
+	     offset = fw_platform_next_memory(fdt, offset)) {
+		if (fdt_get_node_addr_size(fdt, offset, 0, &addr, &size))
+			continue;
+		if (addr <= fw_addr && fw_addr - addr < size) {
+			fw_node = fw_platform_numa_node_id(fdt, offset);
+			break;
+		}
+	}
+	if (fw_node < 0)
+		return;
+
+	cpus_offset = fdt_path_offset(fdt, "/cpus");
+	if (cpus_offset < 0)
+		return;
+
+	fdt_for_each_subnode(cpu_offset, fdt, cpus_offset) {
+		node = fw_platform_hart_numa_node(fdt, cpu_offset, &hart_index);
+		if (node >= 0)
+			nharts[node]++;
+	}
+
+	for (node = 0; node < GENERIC_NUMA_NODES_MAX; node++) {
+		if (node != fw_node && nharts[node])
+			fw_platform_numa_stacks_place(fdt, node, nharts[node]);
+		nharts[node] = 0;
+	}
+
+	fdt_for_each_subnode(cpu_offset, fdt, cpus_offset) {
+		node = fw_platform_hart_numa_node(fdt, cpu_offset, &hart_index);
+		if (node < 0 || !generic_numa_stacks[node].size)
+			continue;
+
+		nharts[node]++;
+		generic_hart_index2stack[hart_index] =
+			generic_numa_stacks[node].base +
+			nharts[node] * platform.hart_stack_size;
+		placed = true;
+	}
+
+	if (placed)
+		platform.hart_index2stack = generic_hart_index2stack;
+}
+
+static int generic_numa_stacks_reserve(void)
+{
+	int i, rc;
+
+	for (i = 0; i < GENERIC_NUMA_NODES_MAX; i++) {
+		if (!generic_numa_stacks[i].size)
+			continue;
+
+		rc = sbi_domain_root_add_memrange(generic_numa_stacks[i].base,
+						  generic_numa_stacks[i].size,
+						  generic_numa_stacks[i].size,
+						  SBI_DOMAIN_MEMREGION_M_READABLE |
+						  SBI_DOMAIN_MEMREGION_M_WRITABLE);
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
+#else
+static void fw_platform_numa_stacks_init(void *fdt) { }
+static int generic_numa_stacks_reserve(void) { return 0; }
+#endif
+
 /*
  * The fw_platform_init() function is called very early on the boot HART
  * OpenSBI reference firmwares so that platform specific code get chance
@@ -150,6 +572,9 @@ unsigned long fw_platform_init(unsigned long arg0, unsigned long arg1,
 	u32 hartid, hart_count = 0;
 	int rc, root_offset, cpus_offset, cpu_offset, len;
 
+	if (fw_boot_options() & SBI_SCRATCH_FDT_TRUSTED)
+		fdt_set_trusted(1);
+
 	root_offset = fdt_path_offset(fdt, "/");
 	if (root_offset < 0)
 		goto fail;
@@ -166,6 +591,12 @@ unsigned long fw_platform_init(unsigned long arg0, unsigned long arg1,
 	if (generic_plat && generic_plat->features)
 		platform.features = generic_plat->features(generic_plat_match);
 
+	if (fw_platform_prev_info_init((const void *)fw_prev_platform_info()))
+		goto done;
+
+	if (fw_platform_snapshot_restore(fdt))
+		goto done;
+
 	cpus_offset = fdt_path_offset(fdt, "/cpus");
 	if (cpus_offset < 0)
 		goto fail;
@@ -181,6 +612,9 @@ unsigned long fw_platform_init(unsigned long arg0, unsigned long arg1,
 		if (!fdt_node_is_enabled(fdt, cpu_offset))
 			continue;
 
+		if (hart_count == GENERIC_HART_MAX)
+			break;
+
 		generic_hart_index2id[hart_count++] = hartid;
 	}
 
@@ -190,6 +624,13 @@ unsigned long fw_platform_init(unsigned long arg0, unsigned long arg1,
 
 	fw_platform_coldboot_harts_init(fdt);
 
+	fw_platform_snapshot_save(fdt);
+
+done:
+	fw_platform_hart_sizes_init(fdt);
+	fw_platform_cacheline_init(fdt);
+	fw_platform_numa_stacks_init(fdt);
+
 	/* Return original FDT pointer */
 	return arg1;
 
@@ -212,6 +653,11 @@ static bool generic_cold_boot_allowed(u32 hartid)
 	return false;
 }
 
+static u32 generic_cold_boot_hart(void)
+{
+	return generic_coldboot_hart;
+}
+
 static int generic_nascent_init(void)
 {
 	if (platform_has_mlevel_imsic)
@@ -221,10 +667,42 @@ static int generic_nascent_init(void)
 	return 0;
 }
 
+#ifdef CONFIG_SBI_IPI_FORWARD
+static void generic_ipi_forward_init(void)
+{
+	u32 cluster_harts;
+
+	if (!fdt_parse_cpu_map_cluster_harts(fdt_get_address(),
+					     &cluster_harts))
+		sbi_ipi_set_forward_cluster(cluster_harts);
+}
+#else
+static void generic_ipi_forward_init(void) { }
+#endif
+
 static int generic_early_init(bool cold_boot)
 {
-	if (cold_boot)
+	int rc;
+
+	if (cold_boot) {
+		rc = fdt_apply_overlays(fdt_get_address(),
+				(const void *)fw_embedded_fdt_overlays());
+		if (rc)
+			return rc;
+
+		rc = fdt_apply_overlays(fdt_get_address(),
+				(const void *)fw_prev_fdt_overlays());
+		if (rc)
+			return rc;
+
 		fdt_reset_init();
+		/* Platform overrides may still change this below */
+		generic_ipi_forward_init();
+
+		rc = generic_numa_stacks_reserve();
+		if (rc)
+			return rc;
+	}
 
 	if (!generic_plat || !generic_plat->early_init)
 		return 0;
@@ -282,6 +760,23 @@ static int generic_vendor_ext_provider(long funcid,
 						 generic_plat_match);
 }
 
+static int generic_fwft_set(u32 feature, unsigned long value,
+			    unsigned long flags)
+{
+	if (generic_plat && generic_plat->fwft_set)
+		return generic_plat->fwft_set(feature, value, flags,
+					      generic_plat_match);
+	return SBI_EDENIED;
+}
+
+static int generic_fwft_get(u32 feature, unsigned long *value)
+{
+	if (generic_plat && generic_plat->fwft_get)
+		return generic_plat->fwft_get(feature, value,
+					      generic_plat_match);
+	return SBI_EDENIED;
+}
+
 static void generic_early_exit(void)
 {
 	if (generic_plat && generic_plat->early_exit)
@@ -397,6 +892,7 @@ static int generic_console_init(void)
 
 const struct sbi_platform_operations platform_ops = {
 	.cold_boot_allowed	= generic_cold_boot_allowed,
+	.cold_boot_hart		= generic_cold_boot_hart,
 	.nascent_init		= generic_nascent_init,
 	.early_init		= generic_early_init,
 	.final_init		= generic_final_init,
@@ -418,6 +914,8 @@ const struct sbi_platform_operations platform_ops = {
 	.timer_exit		= fdt_timer_exit,
 	.vendor_ext_check	= generic_vendor_ext_check,
 	.vendor_ext_provider	= generic_vendor_ext_provider,
+	.fwft_set		= generic_fwft_set,
+	.fwft_get		= generic_fwft_get,
 };
 
 struct sbi_platform platform = {
@@ -427,7 +925,7 @@ struct sbi_platform platform = {
 				     CONFIG_PLATFORM_GENERIC_MINOR_VER),
 	.name			= CONFIG_PLATFORM_GENERIC_NAME,
 	.features		= SBI_PLATFORM_DEFAULT_FEATURES,
-	.hart_count		= SBI_HARTMASK_MAX_BITS,
+	.hart_count		= GENERIC_HART_MAX,
 	.hart_index2id		= generic_hart_index2id,
 	.hart_stack_size	= SBI_PLATFORM_DEFAULT_HART_STACK_SIZE,
 	.heap_size		= SBI_PLATFORM_DEFAULT_HEAP_SIZE(0),
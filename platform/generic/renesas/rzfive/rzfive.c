@@ -26,10 +26,22 @@ static const struct andes_pma_region renesas_rzfive_pma_regions[] = {
 
 static int renesas_rzfive_final_init(bool cold_boot, const struct fdt_match *match)
 {
+	if (!cold_boot) {
+		andes_pma_apply();
+		return 0;
+	}
+
 	return andes_pma_setup_regions(renesas_rzfive_pma_regions,
 				       array_size(renesas_rzfive_pma_regions));
 }
 
+static int renesas_rzfive_resume_finish(struct sbi_scratch *scratch)
+{
+	/* The PMA CSRs are lost in non-retentive suspend */
+	andes_pma_apply();
+	return 0;
+}
+
 static int renesas_rzfive_early_init(bool cold_boot, const struct fdt_match *match)
 {
 	/*
@@ -57,6 +69,7 @@ const struct platform_override renesas_rzfive = {
 	.match_table = renesas_rzfive_match,
 	.early_init = renesas_rzfive_early_init,
 	.final_init = renesas_rzfive_final_init,
+	.resume_finish = renesas_rzfive_resume_finish,
 	.vendor_ext_provider = andes_sbi_vendor_ext_provider,
 	.extensions_init = andes_pmu_extensions_init,
 	.pmu_init = andes_pmu_init,
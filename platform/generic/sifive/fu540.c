@@ -8,6 +8,7 @@
  */
 
 #include <platform_override.h>
+#include <sifive/ccache.h>
 #include <sbi_utils/fdt/fdt_helper.h>
 #include <sbi_utils/fdt/fdt_fixup.h>
 
@@ -20,6 +21,15 @@ static u64 sifive_fu540_tlbr_flush_limit(const struct fdt_match *match)
 	return 0;
 }
 
+static int sifive_fu540_final_init(bool cold_boot,
+				   const struct fdt_match *match)
+{
+	if (cold_boot)
+		sifive_ccache_init(fdt_get_address());
+
+	return 0;
+}
+
 static const struct fdt_match sifive_fu540_match[] = {
 	{ .compatible = "sifive,fu540" },
 	{ .compatible = "sifive,fu540g" },
@@ -31,4 +41,5 @@ static const struct fdt_match sifive_fu540_match[] = {
 const struct platform_override sifive_fu540 = {
 	.match_table = sifive_fu540_match,
 	.tlbr_flush_limit = sifive_fu540_tlbr_flush_limit,
+	.final_init = sifive_fu540_final_init,
 };
@@ -10,6 +10,7 @@
  */
 
 #include <platform_override.h>
+#include <sifive/ccache.h>
 #include <libfdt.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
@@ -237,6 +238,8 @@ static int sifive_fu740_final_init(bool cold_boot,
 		if (rc)
 			sbi_printf("%s: failed to find da9063 for reset\n",
 				   __func__);
+
+		sifive_ccache_init(fdt);
 	}
 
 	return 0;
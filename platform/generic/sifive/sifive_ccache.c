@@ -0,0 +1,86 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <libfdt.h>
+#include <sifive/ccache.h>
+#include <sbi/riscv_io.h>
+#include <sbi/sbi_cache.h>
+#include <sbi/sbi_error.h>
+#include <sbi_utils/fdt/fdt_helper.h>
+
+#define SIFIVE_CCACHE_WAYENABLE		0x008
+#define SIFIVE_CCACHE_FLUSH64		0x200
+#define SIFIVE_CCACHE_WAYMASK(__master)	(0x800 + 8 * (__master))
+#define SIFIVE_CCACHE_LINE_SIZE		64
+
+/* Each HART is the data cache master 2 * hartid and the icache master next */
+#define SIFIVE_CCACHE_HART_MASTER(__hartid)	(2 * (__hartid))
+
+static volatile void *ccache_base;
+
+/*
+ * The composable cache is inclusive and only has a flush by address
+ * register so all operations write back and evict the lines, the same
+ * as Linux does for non-coherent DMA on these SoCs.
+ */
+static int sifive_ccache_range_op(enum sbi_cache_op op, unsigned long addr,
+				  unsigned long size)
+{
+	unsigned long end = addr + size;
+
+	addr &= ~(SIFIVE_CCACHE_LINE_SIZE - 1UL);
+	mb();
+	for (; addr < end; addr += SIFIVE_CCACHE_LINE_SIZE)
+		writeq(addr, ccache_base + SIFIVE_CCACHE_FLUSH64);
+	mb();
+
+	return 0;
+}
+
+static void sifive_ccache_set_way_mask(u32 hartid, unsigned long mask)
+{
+	unsigned long master = SIFIVE_CCACHE_HART_MASTER(hartid);
+	unsigned long ways;
+
+	/* WayEnable holds the index of the last way enabled by the boot loader */
+	ways = (2UL << readl(ccache_base + SIFIVE_CCACHE_WAYENABLE)) - 1;
+	mask &= ways;
+	if (!mask)
+		mask = ways;
+
+	writeq(mask, ccache_base + SIFIVE_CCACHE_WAYMASK(master));
+	writeq(mask, ccache_base + SIFIVE_CCACHE_WAYMASK(master + 1));
+}
+
+static const struct sbi_cache_device sifive_ccache = {
+	.name = "sifive,ccache",
+	.cache_range_op = sifive_ccache_range_op,
+	.set_way_mask = sifive_ccache_set_way_mask,
+};
+
+static const char *const sifive_ccache_compat[] = {
+	"sifive,fu540-c000-ccache",
+	"sifive,fu740-c000-ccache",
+};
+
+int sifive_ccache_init(void *fdt)
+{
+	uint64_t addr, size;
+	int i, node = -1, rc;
+
+	for (i = 0; i < array_size(sifive_ccache_compat) && node < 0; i++)
+		node = fdt_node_offset_by_compatible(fdt, -1,
+						     sifive_ccache_compat[i]);
+	if (node < 0)
+		return SBI_ENODEV;
+
+	rc = fdt_get_node_addr_size(fdt, node, 0, &addr, &size);
+	if (rc)
+		return rc;
+
+	ccache_base = (volatile void *)(unsigned long)addr;
+	sbi_cache_set_device(&sifive_ccache);
+
+	return 0;
+}
@@ -11,6 +11,7 @@
 #include <thead/c9xx_pmu.h>
 #include <sbi/sbi_const.h>
 #include <sbi/sbi_domain.h>
+#include <sbi/sbi_ipi.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_string.h>
@@ -20,12 +21,20 @@
 #define SOPHGO_SG2042_TIMER_BASE	0x70ac000000ULL
 #define SOPHGO_SG2042_TIMER_SIZE	0x10000UL
 #define SOPHGO_SG2042_TIMER_NUM		16
+#define SOPHGO_SG2042_CLUSTER_HARTS	4
 
 static int sophgo_sg2042_early_init(bool cold_boot,
 				    const struct fdt_match *match)
 {
 	thead_register_tlb_flush_trap_handler();
 
+	/*
+	 * Cores of a cluster share the path to the mesh so let the first
+	 * core of each cluster forward the IPIs of the others.
+	 */
+	if (cold_boot)
+		sbi_ipi_set_forward_cluster(SOPHGO_SG2042_CLUSTER_HARTS);
+
 	/*
 	 * Sophgo sg2042 soc use separate 16 timers while initiating,
 	 * merge them as a single domain to avoid wasting.
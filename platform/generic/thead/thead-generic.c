@@ -7,6 +7,7 @@
  */
 
 #include <platform_override.h>
+#include <thead/c9xx_cache.h>
 #include <thead/c9xx_errata.h>
 #include <thead/c9xx_pmu.h>
 #include <sbi/sbi_const.h>
@@ -27,6 +28,9 @@ static int thead_generic_early_init(bool cold_boot,
 	if (quirks->errata & THEAD_QUIRK_ERRATA_TLB_FLUSH)
 		thead_register_tlb_flush_trap_handler();
 
+	if (cold_boot)
+		thead_c9xx_register_cache_device();
+
 	return 0;
 }
 
@@ -0,0 +1,56 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <thead/c9xx_cache.h>
+#include <sbi/sbi_cache.h>
+
+#define THEAD_C9XX_DCACHE_LINE	64
+
+/*
+ * The XTheadCmo dcache.cpa, dcache.ipa and dcache.cipa instructions
+ * operate on physical addresses and take effect on the whole cache
+ * hierarchy once followed by sync.s.
+ */
+#define THEAD_DCACHE_PA_INSN(__rs2, __addr)				\
+	__asm__ __volatile__(".insn r 0x0b, 0, 1, x0, %0, " #__rs2	\
+			     : : "r"(__addr) : "memory")
+
+#define THEAD_SYNC_S()							\
+	__asm__ __volatile__(".insn r 0x0b, 0, 0, x0, x0, x25"		\
+			     : : : "memory")
+
+static int thead_c9xx_cache_range_op(enum sbi_cache_op op, unsigned long addr,
+				     unsigned long size)
+{
+	unsigned long end = addr + size;
+
+	addr &= ~(THEAD_C9XX_DCACHE_LINE - 1UL);
+	switch (op) {
+	case SBI_CACHE_OP_CLEAN:
+		for (; addr < end; addr += THEAD_C9XX_DCACHE_LINE)
+			THEAD_DCACHE_PA_INSN(x9, addr);
+		break;
+	case SBI_CACHE_OP_INVAL:
+		for (; addr < end; addr += THEAD_C9XX_DCACHE_LINE)
+			THEAD_DCACHE_PA_INSN(x10, addr);
+		break;
+	default:
+		for (; addr < end; addr += THEAD_C9XX_DCACHE_LINE)
+			THEAD_DCACHE_PA_INSN(x11, addr);
+		break;
+	}
+	THEAD_SYNC_S();
+
+	return 0;
+}
+
+static const struct sbi_cache_device thead_c9xx_cache = {
+	.name = "thead,c9xx-cache",
+	.cache_range_op = thead_c9xx_cache_range_op,
+};
+
+void thead_c9xx_register_cache_device(void)
+{
+	sbi_cache_set_device(&thead_c9xx_cache);
+}
@@ -56,11 +56,17 @@ static int thead_c9xx_pmu_irq_bit(void)
 	return THEAD_C9XX_MIP_MOIP;
 }
 
+static unsigned long thead_c9xx_pmu_ctr_overflow_status(void)
+{
+	return csr_read(THEAD_C9XX_CSR_MCOUNTEROF);
+}
+
 static const struct sbi_pmu_device thead_c9xx_pmu_device = {
 	.name = "thead,c900-pmu",
 	.hw_counter_enable_irq = thead_c9xx_pmu_ctr_enable_irq,
 	.hw_counter_disable_irq = thead_c9xx_pmu_ctr_disable_irq,
 	.hw_counter_irq_bit = thead_c9xx_pmu_irq_bit,
+	.hw_counter_overflow_status = thead_c9xx_pmu_ctr_overflow_status,
 };
 
 void thead_c9xx_register_pmu_device(void)